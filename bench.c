@@ -0,0 +1,780 @@
+/*
+ * bench.c: Benchmark for the TS receive path
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "cutter.h"
+#include "device.h"
+#include "libsi/section.h"
+#include "receiver.h"
+#include "recorder.h"
+#include "remux.h"
+#include "tools.h"
+#include "videodir.h"
+
+// vdr-bench feeds a captured Transport Stream file through a cDevice, exactly
+// the way a DVB device's data would be handled, and attaches the given number
+// of recorders and simple receivers to the services found in it. The file is
+// held in memory and played in a loop (without any timing, unless a rate is
+// given), so that the result shows how many TS packets per second VDR's
+// receive path can handle, how much CPU time that costs per packet, and how
+// long it takes from the moment a batch of packets is delivered by the device
+// until each receiver gets its data.
+
+#define DEFAULTDURATION   10 // seconds
+#define BENCHPRIORITY     50
+#define MAXBENCHSERVICES  64
+
+// --- cBenchDevice ----------------------------------------------------------
+
+class cBenchDevice : public cDevice {
+private:
+  const uchar *data;
+  int length;
+  int offset;
+  int64_t rate; // bytes per second, 0 = unlimited
+  bool feeding;
+  uint64_t startTime;
+  int64_t delivered;
+  uint64_t batchTime;
+  cMutex mutex;
+protected:
+  virtual bool SetPid(cPidHandle *Handle, int Type, bool On) override { return true; }
+  virtual bool OpenDvr(void) override { return true; }
+  virtual bool GetTSPackets(uchar *&Data, int &Count) override;
+public:
+  cBenchDevice(const uchar *Data, int Length, int Rate);
+  virtual ~cBenchDevice() override;
+  void SetFeeding(bool On);
+  uint64_t BatchTime(void) const { return batchTime; }
+       ///< Returns the time (in microseconds) at which the batch of TS packets
+       ///< that is currently being distributed was delivered.
+  };
+
+cBenchDevice::cBenchDevice(const uchar *Data, int Length, int Rate)
+{
+  data = Data;
+  length = Length;
+  offset = 0;
+  rate = int64_t(Rate) * 1000000 / 8;
+  feeding = false;
+  startTime = 0;
+  delivered = 0;
+  batchTime = 0;
+}
+
+cBenchDevice::~cBenchDevice()
+{
+  DetachAllReceivers();
+  Cancel(3);
+}
+
+void cBenchDevice::SetFeeding(bool On)
+{
+  cMutexLock MutexLock(&mutex);
+  feeding = On;
+  startTime = cTimeMs::NowUs();
+  delivered = 0;
+}
+
+bool cBenchDevice::GetTSPackets(uchar *&Data, int &Count)
+{
+  Data = NULL;
+  Count = 0;
+  {
+    cMutexLock MutexLock(&mutex);
+    if (feeding && (!rate || delivered <= int64_t((cTimeMs::NowUs() - startTime) * rate / 1000000))) {
+       Count = min(length - offset, MAXTSBATCH * TS_SIZE);
+       Data = (uchar *)data + offset;
+       offset += Count;
+       if (offset >= length)
+          offset = 0; // start over at the beginning of the file
+       delivered += Count;
+       batchTime = cTimeMs::NowUs();
+       return true;
+       }
+  }
+  cCondWait::SleepMs(1);
+  return true;
+}
+
+// --- cBenchLatency ---------------------------------------------------------
+
+class cBenchLatency {
+private:
+  const cBenchDevice *device;
+  int64_t calls;
+  int64_t packets;
+  uint64_t total;
+  uint64_t max;
+public:
+  cBenchLatency(const cBenchDevice *Device);
+  void Measure(int Length);
+  void Report(const char *Name);
+  };
+
+cBenchLatency::cBenchLatency(const cBenchDevice *Device)
+{
+  device = Device;
+  calls = 0;
+  packets = 0;
+  total = 0;
+  max = 0;
+}
+
+void cBenchLatency::Measure(int Length)
+{
+  uint64_t Latency = cTimeMs::NowUs() - device->BatchTime();
+  calls++;
+  packets += Length / TS_SIZE;
+  total += Latency;
+  if (Latency > max)
+     max = Latency;
+}
+
+void cBenchLatency::Report(const char *Name)
+{
+  printf("  %-28s %10" PRId64 " packets, latency avg %4" PRIu64 " us, max %6" PRIu64 " us\n", Name, packets, calls ? total / calls : 0, max);
+}
+
+// --- cBenchReceiver --------------------------------------------------------
+
+class cBenchReceiver : public cReceiver, public cBenchLatency {
+protected:
+  virtual void Receive(const uchar *Data, int Length) override { Measure(Length); }
+public:
+  cBenchReceiver(const cBenchDevice *Device, const cChannel *Channel, bool MultiPacket);
+  virtual ~cBenchReceiver() override { Detach(); }
+  };
+
+cBenchReceiver::cBenchReceiver(const cBenchDevice *Device, const cChannel *Channel, bool MultiPacket)
+:cReceiver(Channel, BENCHPRIORITY)
+,cBenchLatency(Device)
+{
+  SetMultiPacket(MultiPacket);
+}
+
+// --- cBenchRecorder --------------------------------------------------------
+
+class cBenchRecorder : public cRecorder, public cBenchLatency {
+protected:
+  virtual void Receive(const uchar *Data, int Length) override { Measure(Length); cRecorder::Receive(Data, Length); }
+public:
+  cBenchRecorder(const cBenchDevice *Device, const char *FileName, const cChannel *Channel);
+  };
+
+cBenchRecorder::cBenchRecorder(const cBenchDevice *Device, const char *FileName, const cChannel *Channel)
+:cRecorder(FileName, Channel, BENCHPRIORITY)
+,cBenchLatency(Device)
+{
+}
+
+// --- cBenchReplay ----------------------------------------------------------
+
+// Like cDvbPlayer, a replay reads the recording frame by frame through its index,
+// at the speed it would be played, starting REPLAYDELAY seconds behind the
+// recorder (which is what happens with "time shift").
+
+#define REPLAYDELAY  5 // seconds
+
+class cBenchReplay : public cThread {
+private:
+  cString recordingName;
+  cLatencyHistogram readLatency;
+  int frames;
+  uint64_t maxLag;
+protected:
+  virtual void Action(void) override;
+public:
+  cBenchReplay(const char *RecordingName);
+  virtual ~cBenchReplay() override;
+  void Report(const char *Name);
+  };
+
+cBenchReplay::cBenchReplay(const char *RecordingName)
+:cThread("bench replay")
+{
+  recordingName = RecordingName;
+  frames = 0;
+  maxLag = 0;
+}
+
+cBenchReplay::~cBenchReplay()
+{
+  Cancel(3);
+}
+
+void cBenchReplay::Action(void)
+{
+  for (int i = 0; i < REPLAYDELAY * 10 && Running(); i++)
+      cCondWait::SleepMs(100);
+  if (!Running())
+     return;
+  cRecordingInfo RecordingInfo(recordingName);
+  RecordingInfo.Read();
+  double FramesPerSecond = RecordingInfo.FramesPerSecond();
+  cIndexFile Index(recordingName, false);
+  cFileName FileName(recordingName, false);
+  uchar *Buffer = MALLOC(uchar, MAXFRAMESIZE);
+  uint64_t Start = cTimeMs::NowUs();
+  for (int i = 0; Running(); ) {
+      uint16_t FileNumber;
+      off_t FileOffset;
+      int Length;
+      if (i >= Index.Last() || !Index.Get(i, &FileNumber, &FileOffset, NULL, &Length)) {
+         // The replay has caught up with the recording:
+         cCondWait::SleepMs(10);
+         Start += 10000;
+         continue;
+         }
+      uint64_t Due = Start + uint64_t(i * 1000000 / FramesPerSecond);
+      uint64_t Now = cTimeMs::NowUs();
+      if (Now < Due)
+         cCondWait::SleepMs(int((Due - Now) / 1000));
+      else
+         maxLag = max(maxLag, Now - Due);
+      uint64_t t = cTimeMs::NowUs();
+      cUnbufferedFile *f = FileName.SetOffset(FileNumber, FileOffset);
+      if (!f || ReadFrame(f, Buffer, Length, MAXFRAMESIZE) < 0)
+         break;
+      readLatency.Add(cTimeMs::NowUs() - t);
+      frames++;
+      i++;
+      }
+  free(Buffer);
+}
+
+static cString Latency(uint64_t Us)
+{
+  if (Us < 10000)
+     return cString::sprintf("%" PRIu64 " us", Us);
+  return cString::sprintf("%.1f ms", Us / 1000.0);
+}
+
+void cBenchReplay::Report(const char *Name)
+{
+  printf("  %-28s %10d frames, read latency p99 %s, max %s, max lag %s\n", Name, frames, *Latency(readLatency.Percentile(99)), *Latency(readLatency.Max()), *Latency(maxLag));
+}
+
+// --- cBenchCutter ----------------------------------------------------------
+
+#define MINCUTFRAMES  100
+
+class cBenchCutter {
+private:
+  cString recordingName;
+  cCutter *cutter;
+  int cuts;
+  int errors;
+public:
+  cBenchCutter(const char *RecordingName);
+  ~cBenchCutter();
+  void Process(void);
+       ///< Starts cutting everything that has been recorded so far, unless the
+       ///< previous cut is still running.
+  void Report(void);
+  };
+
+cBenchCutter::cBenchCutter(const char *RecordingName)
+{
+  recordingName = RecordingName;
+  cutter = NULL;
+  cuts = 0;
+  errors = 0;
+}
+
+cBenchCutter::~cBenchCutter()
+{
+  delete cutter;
+  RemoveFileOrDir(cCutter::EditedFileName(recordingName));
+}
+
+void cBenchCutter::Process(void)
+{
+  if (cutter) {
+     if (cutter->Active())
+        return;
+     if (cutter->Error())
+        errors++;
+     else
+        cuts++;
+     DELETENULL(cutter);
+     }
+  cIndexFile Index(recordingName, false);
+  int Last = Index.Last();
+  if (Last < MINCUTFRAMES)
+     return; // not enough recorded yet
+  cMarks Marks;
+  Marks.Load(recordingName);
+  while (cMark *Mark = Marks.First())
+        Marks.Del(Mark);
+  Marks.Add(0);
+  Marks.Add(Last);
+  if (Marks.Save()) {
+     cutter = new cCutter(recordingName);
+     if (!cutter->Start()) {
+        errors++;
+        DELETENULL(cutter);
+        }
+     }
+}
+
+void cBenchCutter::Report(void)
+{
+  printf("  %-28s %10d cuts completed, %d failed\n", "cutting", cuts, errors);
+}
+
+// --- Services --------------------------------------------------------------
+
+static int GetServices(const uchar *Data, int Length, cChannel **Channels)
+{
+  // Find the PAT:
+  SI::PAT::Association Assoc[MAXBENCHSERVICES];
+  int NumServices = 0;
+  const uchar *Pat = NULL;
+  for (const uchar *p = Data; p < Data + Length && !Pat; p += TS_SIZE) {
+      if (TsPid(p) == PATPID && TsPayloadStart(p)) {
+         const uchar *Payload = p + TsPayloadOffset(p);
+         if (Payload + *Payload + 1 >= p + TS_SIZE)
+            continue;
+         SI::PAT PatSection(Payload + *Payload + 1, false);
+         if (PatSection.CheckCRCAndParse()) {
+            for (SI::Loop::Iterator it; NumServices < MAXBENCHSERVICES && PatSection.associationLoop.getNext(Assoc[NumServices], it); ) {
+                if (!Assoc[NumServices].isNITPid())
+                   NumServices++;
+                }
+            Pat = p;
+            }
+         }
+      }
+  // Parse the PMT of every service:
+  int NumChannels = 0;
+  for (int i = 0; i < NumServices; i++) {
+      cPatPmtParser PatPmtParser;
+      PatPmtParser.ParsePat(Pat, TS_SIZE);
+      int PmtPid = Assoc[i].getPid();
+      for (const uchar *p = Data; p < Data + Length; p += TS_SIZE) {
+          if (TsPid(p) == PmtPid) {
+             PatPmtParser.ParsePmt(p, TS_SIZE);
+             int PatVersion, PmtVersion;
+             if (PatPmtParser.GetVersions(PatVersion, PmtVersion))
+                break;
+             }
+          }
+      if (!PatPmtParser.Vpid() && !PatPmtParser.Apid(0) && !PatPmtParser.Dpid(0))
+         continue; // not a TV or radio service
+      int Apids[MAXAPIDS + 1] = { 0 };
+      int Atypes[MAXAPIDS + 1] = { 0 };
+      char ALangs[MAXAPIDS][MAXLANGCODE2] = { "" };
+      int Dpids[MAXDPIDS + 1] = { 0 };
+      int Dtypes[MAXDPIDS + 1] = { 0 };
+      char DLangs[MAXDPIDS][MAXLANGCODE2] = { "" };
+      int Spids[MAXSPIDS + 1] = { 0 };
+      char SLangs[MAXSPIDS][MAXLANGCODE2] = { "" };
+      for (int n = 0; n < MAXAPIDS; n++) {
+          Apids[n] = PatPmtParser.Apid(n);
+          Atypes[n] = PatPmtParser.Atype(n);
+          strn0cpy(ALangs[n], PatPmtParser.Alang(n), MAXLANGCODE2);
+          }
+      for (int n = 0; n < MAXDPIDS; n++) {
+          Dpids[n] = PatPmtParser.Dpid(n);
+          Dtypes[n] = PatPmtParser.Dtype(n);
+          strn0cpy(DLangs[n], PatPmtParser.Dlang(n), MAXLANGCODE2);
+          }
+      for (int n = 0; n < MAXSPIDS; n++) {
+          Spids[n] = PatPmtParser.Spid(n);
+          strn0cpy(SLangs[n], PatPmtParser.Slang(n), MAXLANGCODE2);
+          }
+      cChannel *Channel = new cChannel;
+      Channel->SetId(NULL, 1, 1, Assoc[i].getServiceId());
+      Channel->SetName(cString::sprintf("Service %d", Assoc[i].getServiceId()), "", "");
+      Channel->SetPids(PatPmtParser.Vpid(), PatPmtParser.Ppid(), PatPmtParser.Vtype(), Apids, Atypes, ALangs, Dpids, Dtypes, DLangs, Spids, SLangs, 0);
+      Channels[NumChannels++] = Channel;
+      }
+  return NumChannels;
+}
+
+// --- cBench ----------------------------------------------------------------
+
+static double CpuTime(const struct timeval &tv)
+{
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+class cBench {
+private:
+  const uchar *data;
+  int length;
+  int rate;
+  bool multiPacket;
+  cChannel **channels;
+  int numChannels;
+  cChannel *copies[MAXDEVICES * MAXRECEIVERS];
+  cBenchDevice *devices[MAXDEVICES];
+  const char *videoDirectory;
+  bool temporary;
+  int round;
+  cBenchDevice *Device(int Index);
+  const cChannel *Copy(int Index);
+  cString RecordingName(int Index);
+public:
+  cBench(const uchar *Data, int Length, int Rate, bool MultiPacket, cChannel **Channels, int NumChannels, const char *VideoDirectory, bool Temporary);
+  ~cBench();
+  bool Run(int Duration, int NumRecorders, int NumReceivers, int NumReplays, bool Cut, bool Qualify, int &Overflows);
+       ///< Runs one round of the benchmark for Duration seconds and reports the
+       ///< results. If Qualify is true, each recorder records its own copy of the
+       ///< first service, the recorders are spread over as many devices as
+       ///< necessary, and the results are reported in a single line.
+       ///< Overflows returns the total number of ring buffer overflows of all
+       ///< recorders.
+  };
+
+cBench::cBench(const uchar *Data, int Length, int Rate, bool MultiPacket, cChannel **Channels, int NumChannels, const char *VideoDirectory, bool Temporary)
+{
+  data = Data;
+  length = Length;
+  rate = Rate;
+  multiPacket = MultiPacket;
+  channels = Channels;
+  numChannels = NumChannels;
+  memset(copies, 0, sizeof(copies));
+  memset(devices, 0, sizeof(devices));
+  videoDirectory = VideoDirectory;
+  temporary = Temporary;
+  round = 0;
+}
+
+cBench::~cBench()
+{
+  for (int i = 0; i < MAXDEVICES; i++)
+      delete devices[i];
+  for (int i = 0; i < MAXDEVICES * MAXRECEIVERS; i++)
+      delete copies[i];
+}
+
+cBenchDevice *cBench::Device(int Index)
+{
+  // Devices can't be removed once they have been created, so they are kept
+  // for all rounds:
+  if (!devices[Index])
+     devices[Index] = new cBenchDevice(data, length, rate);
+  return devices[Index];
+}
+
+const cChannel *cBench::Copy(int Index)
+{
+  // Each copy has its own channel ID, so that the recorders don't share their
+  // streams and every one of them writes its own data:
+  if (!copies[Index]) {
+     copies[Index] = new cChannel(*channels[0]);
+     copies[Index]->SetId(NULL, 1, 1, channels[0]->Sid(), Index + 1);
+     copies[Index]->SetName(cString::sprintf("%s/%d", channels[0]->Name(), Index + 1), "", "");
+     }
+  return copies[Index];
+}
+
+cString cBench::RecordingName(int Index)
+{
+  return cString::sprintf("%s/Bench_%d/2000-01-01.%02d.%02d.%d-0.rec", videoDirectory, Index + 1, round / 60, round % 60, BENCHPRIORITY);
+}
+
+bool cBench::Run(int Duration, int NumRecorders, int NumReceivers, int NumReplays, bool Cut, bool Qualify, int &Overflows)
+{
+  Overflows = 0;
+  // Set up the recorders and receivers:
+  int NumDevices = Qualify ? (NumRecorders + MAXRECEIVERS - 1) / MAXRECEIVERS : 1;
+  cBenchRecorder *Recorders[MAXDEVICES * MAXRECEIVERS];
+  cBenchReceiver *Receivers[MAXRECEIVERS];
+  cBenchReplay *Replays[MAXDEVICES * MAXRECEIVERS];
+  for (int i = 0; i < NumRecorders; i++) {
+      cString Name = RecordingName(i);
+      if (!MakeDirs(Name, true)) {
+         perror(Name);
+         return false;
+         }
+      cBenchDevice *d = Device(Qualify ? i / MAXRECEIVERS : 0);
+      Recorders[i] = new cBenchRecorder(d, Name, Qualify ? Copy(i) : channels[i % numChannels]);
+      d->AttachReceiver(Recorders[i]);
+      }
+  for (int i = 0; i < NumReceivers; i++) {
+      Receivers[i] = new cBenchReceiver(Device(0), channels[(NumRecorders + i) % numChannels], multiPacket);
+      Device(0)->AttachReceiver(Receivers[i]);
+      }
+  for (int i = 0; i < NumReplays; i++) {
+      Replays[i] = new cBenchReplay(RecordingName(i));
+      Replays[i]->Start();
+      }
+  cBenchCutter *Cutter = Cut ? new cBenchCutter(RecordingName(0)) : NULL;
+  // Run the benchmark:
+  if (!Qualify)
+     printf("%d recorder%s, %d receiver%s, %d replay%s%s, %d seconds%s\n", NumRecorders, NumRecorders != 1 ? "s" : "", NumReceivers, NumReceivers != 1 ? "s" : "", NumReplays, NumReplays != 1 ? "s" : "", Cut ? ", cutting" : "", Duration, rate ? *cString::sprintf(" at %d MBit/s", rate) : "");
+  cRecorder::WriteLatency().Reset();
+  struct rusage Ru0, Ru1;
+  getrusage(RUSAGE_SELF, &Ru0);
+  uint64_t Packets0 = 0;
+  for (int i = 0; i < NumDevices; i++)
+      Packets0 += Device(i)->TsPackets();
+  uint64_t t0 = cTimeMs::NowUs();
+  for (int i = 0; i < NumDevices; i++)
+      Device(i)->SetFeeding(true);
+  for (cTimeMs Timer(Duration * 1000); !Timer.TimedOut(); ) {
+      if (Cutter)
+         Cutter->Process();
+      cCondWait::SleepMs(100);
+      }
+  for (int i = 0; i < NumDevices; i++)
+      Device(i)->SetFeeding(false);
+  uint64_t Elapsed = cTimeMs::NowUs() - t0;
+  uint64_t Packets = 0;
+  int ContinuityErrors = 0;
+  for (int i = 0; i < NumDevices; i++) {
+      Packets += Device(i)->TsPackets();
+      ContinuityErrors += Device(i)->ContinuityErrors();
+      }
+  Packets -= Packets0;
+  getrusage(RUSAGE_SELF, &Ru1);
+  // Report the results:
+  double User = CpuTime(Ru1.ru_utime) - CpuTime(Ru0.ru_utime);
+  double System = CpuTime(Ru1.ru_stime) - CpuTime(Ru0.ru_stime);
+  double Seconds = Elapsed / 1e6;
+  const cLatencyHistogram &WriteLatency = cRecorder::WriteLatency();
+  int64_t BytesWritten = 0;
+  int MaxFill = 0;
+  for (int i = 0; i < NumRecorders; i++) {
+      int BufferSize, Fill, o;
+      int64_t OverflowBytes;
+      if (Recorders[i]->GetBufferStats(BufferSize, Fill, o, OverflowBytes)) {
+         MaxFill = max(MaxFill, BufferSize ? int(int64_t(Fill) * 100 / BufferSize) : 0);
+         Overflows += o;
+         }
+      BytesWritten += Recorders[i]->BytesWritten();
+      }
+  if (Qualify)
+     printf("%3d recordings: %7.1f MB/s written, write latency p99 %s, max %s, buffer max %3d%%, %d overflows\n", NumRecorders, BytesWritten / Seconds / MEGABYTE(1), *Latency(WriteLatency.Percentile(99)), *Latency(WriteLatency.Max()), MaxFill, Overflows);
+  else {
+     printf("\n%" PRIu64 " packets in %.2f s: %.0f packets/s (%.1f MBit/s)\n", Packets, Seconds, Packets / Seconds, Packets * TS_SIZE * 8 / Seconds / 1e6);
+     printf("CPU time: %.2f s user, %.2f s system, %.0f ns per packet\n", User, System, Packets ? (User + System) * 1e9 / Packets : 0);
+     printf("continuity errors: %d\n", ContinuityErrors);
+     if (NumRecorders) {
+        printf("written: %.1f MB/s in %" PRIu64 " writes, latency p50 %s, p90 %s, p99 %s, p99.9 %s, max %s\n", BytesWritten / Seconds / MEGABYTE(1), WriteLatency.Count(),
+          *Latency(WriteLatency.Percentile(50)), *Latency(WriteLatency.Percentile(90)), *Latency(WriteLatency.Percentile(99)), *Latency(WriteLatency.Percentile(99.9)), *Latency(WriteLatency.Max()));
+        }
+     printf("\n");
+     for (int i = 0; i < NumRecorders; i++) {
+         Recorders[i]->Report(cString::sprintf("recorder %d (%s)", i + 1, channels[i % numChannels]->Name()));
+         int BufferSize, Fill, o;
+         int64_t OverflowBytes;
+         if (Recorders[i]->GetBufferStats(BufferSize, Fill, o, OverflowBytes))
+            printf("  %-28s %10" PRId64 " bytes written, buffer max %d%%, %d overflows (%" PRId64 " bytes)\n", "", Recorders[i]->BytesWritten(), BufferSize ? int(int64_t(Fill) * 100 / BufferSize) : 0, o, OverflowBytes);
+         }
+     for (int i = 0; i < NumReceivers; i++)
+         Receivers[i]->Report(cString::sprintf("receiver %d (%s)", i + 1, channels[(NumRecorders + i) % numChannels]->Name()));
+     }
+  if (Cutter && !Qualify)
+     Cutter->Report();
+  // Clean up:
+  delete Cutter;
+  for (int i = 0; i < NumReplays; i++) {
+      if (!Qualify)
+         Replays[i]->Report(cString::sprintf("replay %d", i + 1));
+      delete Replays[i];
+      }
+  for (int i = 0; i < NumRecorders; i++) {
+      delete Recorders[i];
+      if (temporary)
+         RemoveFileOrDir(RecordingName(i));
+      }
+  for (int i = 0; i < NumReceivers; i++)
+      delete Receivers[i];
+  round++;
+  return true;
+}
+
+// --- main ------------------------------------------------------------------
+
+static void Usage(void)
+{
+  printf("Usage: vdr-bench [OPTIONS] FILE\n\n"
+         "  -c,       --cut           repeatedly cut the first recording while it is\n"
+         "                            being recorded\n"
+         "  -d SEC,   --duration=SEC  run the benchmark for SEC seconds (default: %d)\n"
+         "  -l LEVEL, --log=LEVEL     set the log level (default: 1, see 'vdr --help')\n"
+         "  -n NUM,   --receivers=NUM attach NUM receivers (default: 0)\n"
+         "  -p NUM,   --replays=NUM   replay the first NUM recordings while they are being\n"
+         "                            recorded (default: 0)\n"
+         "  -q,       --qualify       qualify the disk: start with the number of recorders\n"
+         "                            given with -r and add one more each round of -d\n"
+         "                            seconds, until a recorder's buffer overflows\n"
+         "  -r NUM,   --recorders=NUM attach NUM recorders (default: 1)\n"
+         "  -R MBIT,  --rate=MBIT     deliver the data with MBIT MBit/s (default: as fast\n"
+         "                            as possible)\n"
+         "  -s,       --single        have the receivers get one TS packet at a time\n"
+         "  -v DIR,   --video=DIR     record into DIR (default: a temporary directory,\n"
+         "                            which is removed at the end)\n\n"
+         "FILE must contain a Transport Stream with a PAT and the PMTs of its services.\n"
+         "The recorders and receivers are distributed over the services in turn.\n"
+         "With --qualify each recorder records a separate copy of the first service,\n"
+         "and each device of up to %d recorders delivers the data with the given rate.\n",
+         DEFAULTDURATION, MAXRECEIVERS);
+}
+
+int main(int argc, char *argv[])
+{
+  int Duration = DEFAULTDURATION;
+  int NumReceivers = 0;
+  int NumRecorders = 1;
+  int NumReplays = 0;
+  int Rate = 0;
+  bool Cut = false;
+  bool Qualify = false;
+  bool MultiPacket = true;
+  const char *VideoDirectory = NULL;
+  SysLogLevel = 1;
+
+  static struct option long_options[] = {
+      { "cut",       no_argument,       NULL, 'c' },
+      { "duration",  required_argument, NULL, 'd' },
+      { "help",      no_argument,       NULL, 'h' },
+      { "log",       required_argument, NULL, 'l' },
+      { "receivers", required_argument, NULL, 'n' },
+      { "replays",   required_argument, NULL, 'p' },
+      { "qualify",   no_argument,       NULL, 'q' },
+      { "recorders", required_argument, NULL, 'r' },
+      { "rate",      required_argument, NULL, 'R' },
+      { "single",    no_argument,       NULL, 's' },
+      { "video",     required_argument, NULL, 'v' },
+      { NULL,        no_argument,       NULL,  0  }
+    };
+  int c;
+  while ((c = getopt_long(argc, argv, "cd:hl:n:p:qr:R:sv:", long_options, NULL)) != -1) {
+        switch (c) {
+          case 'c': Cut = true;
+                    break;
+          case 'd': Duration = atoi(optarg);
+                    break;
+          case 'h': Usage();
+                    return 0;
+          case 'l': SysLogLevel = atoi(optarg);
+                    break;
+          case 'n': NumReceivers = atoi(optarg);
+                    break;
+          case 'p': NumReplays = atoi(optarg);
+                    break;
+          case 'q': Qualify = true;
+                    break;
+          case 'r': NumRecorders = atoi(optarg);
+                    break;
+          case 'R': Rate = atoi(optarg);
+                    break;
+          case 's': MultiPacket = false;
+                    break;
+          case 'v': VideoDirectory = optarg;
+                    break;
+          default:  return 2;
+          }
+        }
+  if (optind != argc - 1) {
+     Usage();
+     return 2;
+     }
+  if (Duration <= 0 || NumReceivers < 0 || NumRecorders < 0 || NumReceivers + NumRecorders == 0) {
+     fprintf(stderr, "vdr-bench: there must be at least one receiver or recorder\n");
+     return 2;
+     }
+  if (NumReplays < 0 || NumReplays > NumRecorders || Cut && !NumRecorders) {
+     fprintf(stderr, "vdr-bench: only recordings can be replayed or cut\n");
+     return 2;
+     }
+  if (Qualify) {
+     if (NumReceivers || NumRecorders < 1 || NumRecorders > MAXDEVICES * MAXRECEIVERS) {
+        fprintf(stderr, "vdr-bench: --qualify needs between 1 and %d recorders and no receivers\n", MAXDEVICES * MAXRECEIVERS);
+        return 2;
+        }
+     }
+  else if (NumReceivers + NumRecorders > MAXRECEIVERS) {
+     fprintf(stderr, "vdr-bench: a device can't have more than %d receivers\n", MAXRECEIVERS);
+     return 2;
+     }
+  // Load the file:
+  const char *FileName = argv[optind];
+  int f = open(FileName, O_RDONLY);
+  if (f < 0) {
+     perror(FileName);
+     return 1;
+     }
+  off_t Size = lseek(f, 0, SEEK_END);
+  if (Size < 0 || Size > INT_MAX) {
+     fprintf(stderr, "vdr-bench: %s: invalid file size\n", FileName);
+     close(f);
+     return 1;
+     }
+  uchar *Buffer = MALLOC(uchar, Size);
+  if (!Buffer || pread(f, Buffer, Size, 0) != Size) {
+     perror(FileName);
+     close(f);
+     return 1;
+     }
+  close(f);
+  int Offset = 0;
+  while (Offset < Size && Buffer[Offset] != TS_SYNC_BYTE)
+        Offset++;
+  int Length = (Size - Offset) / TS_SIZE * TS_SIZE;
+  uchar *Data = Buffer + Offset;
+  for (uchar *p = Data; p < Data + Length; p += TS_SIZE) {
+      if (*p != TS_SYNC_BYTE) {
+         Length = p - Data; // we don't resync - the file should be a clean capture
+         break;
+         }
+      }
+  cChannel *Channels[MAXBENCHSERVICES];
+  int NumChannels = GetServices(Data, Length, Channels);
+  if (!NumChannels) {
+     fprintf(stderr, "vdr-bench: %s: no services found\n", FileName);
+     return 1;
+     }
+  printf("%s: %d MB, %d services\n", FileName, int(Length / MEGABYTE(1)), NumChannels);
+  char TempDir[] = "/tmp/vdr-bench-XXXXXX";
+  if (!VideoDirectory) {
+     if (!mkdtemp(TempDir)) {
+        perror(TempDir);
+        return 1;
+        }
+     VideoDirectory = TempDir;
+     }
+  cVideoDirectory::SetName(VideoDirectory);
+  cBench *Bench = new cBench(Data, Length, Rate, MultiPacket, Channels, NumChannels, VideoDirectory, VideoDirectory == TempDir);
+  int Overflows = 0;
+  if (Qualify) {
+     printf("qualifying %s at %s per device, %d replay%s%s, %d seconds per round\n\n", VideoDirectory, Rate ? *cString::sprintf("%d MBit/s", Rate) : "full speed", NumReplays, NumReplays != 1 ? "s" : "", Cut ? ", cutting" : "", Duration);
+     int Sustained = 0;
+     for (int n = NumRecorders; n <= MAXDEVICES * MAXRECEIVERS; n++) {
+         if (!Bench->Run(Duration, n, 0, NumReplays, Cut, true, Overflows))
+            break;
+         if (Overflows)
+            break;
+         Sustained = n;
+         }
+     if (Overflows)
+        printf("\n%s sustained %d recordings, buffers overflowed with %d\n", VideoDirectory, Sustained, Sustained + 1);
+     else
+        printf("\n%s sustained %d recordings without any buffer overflows\n", VideoDirectory, Sustained);
+     }
+  else
+     Bench->Run(Duration, NumRecorders, NumReceivers, NumReplays, Cut, false, Overflows);
+  delete Bench;
+  if (VideoDirectory == TempDir)
+     RemoveEmptyDirectories(TempDir, true);
+  for (int i = 0; i < NumChannels; i++)
+      delete Channels[i];
+  free(Buffer);
+  return 0;
+}
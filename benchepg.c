@@ -0,0 +1,288 @@
+/*
+ * benchepg.c: Benchmark for EPG processing
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <limits.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "channels.h"
+#include "eit.h"
+#include "epg.h"
+#include "libsi/util.h"
+#include "tools.h"
+
+// vdr-benchepg replays a dump of EIT sections, as written by 'vdr --eitdump',
+// through cEitFilter into the schedules (which are either empty or read from
+// an existing EPG data file), and reports the number of sections processed per
+// second, the CPU time, the time the schedules and channels have been locked
+// for writing, and how much memory the resulting EPG data uses.
+// Since cEIT drops events that have already ended, the dates of all events are
+// moved forward by the number of days that have passed since the dump has been
+// taken, so that replaying the same dump later gives the same results.
+
+#define MAXSECTIONSIZE  4096
+
+// --- cEitDump --------------------------------------------------------------
+
+class cEitDump {
+private:
+  uchar *data;
+  int length;
+  int numSections;
+  time_t captured;
+public:
+  cEitDump(void);
+  ~cEitDump();
+  bool Load(const char *FileName);
+  void ShiftDays(int Days);
+       ///< Moves the start dates of all events by the given number of Days.
+  bool Get(int &Offset, int &Source, const uchar *&Section, int &Length) const;
+       ///< Gets the section at the given Offset and advances Offset to the next one.
+       ///< Returns false if there are no more sections.
+  int NumSections(void) const { return numSections; }
+  time_t Captured(void) const { return captured; }
+       ///< Returns the time the first section in the dump has been received.
+  };
+
+cEitDump::cEitDump(void)
+{
+  data = NULL;
+  length = 0;
+  numSections = 0;
+  captured = 0;
+}
+
+cEitDump::~cEitDump()
+{
+  free(data);
+}
+
+static int SectionLength(const uchar *Data)
+{
+  return (((Data[1] & 0x0F) << 8) | Data[2]) + 3;
+}
+
+bool cEitDump::Load(const char *FileName)
+{
+  int f = open(FileName, O_RDONLY);
+  if (f < 0) {
+     perror(FileName);
+     return false;
+     }
+  off_t Size = lseek(f, 0, SEEK_END);
+  if (Size <= 0 || Size > INT_MAX) {
+     fprintf(stderr, "vdr-benchepg: %s: invalid file size\n", FileName);
+     close(f);
+     return false;
+     }
+  data = MALLOC(uchar, Size);
+  if (!data || pread(f, data, Size, 0) != Size) {
+     perror(FileName);
+     close(f);
+     return false;
+     }
+  close(f);
+  // Check the dump and drop an incomplete section at the end:
+  int Offset = 0;
+  while (Offset + 8 + 3 <= Size) {
+        int l = SectionLength(data + Offset + 8);
+        if (l < 3 || l > MAXSECTIONSIZE || Offset + 8 + l > Size)
+           break;
+        if (!numSections)
+           captured = ntohl(*(uint32_t *)(data + Offset + 4));
+        numSections++;
+        Offset += 8 + l;
+        }
+  length = Offset;
+  if (Offset < Size)
+     fprintf(stderr, "vdr-benchepg: %s: ignoring %d bytes of invalid data at offset %d\n", FileName, int(Size - Offset), Offset);
+  return numSections > 0;
+}
+
+void cEitDump::ShiftDays(int Days)
+{
+  for (int Offset = 0; Offset < length; ) {
+      uchar *Section = data + Offset + 8;
+      int Length = SectionLength(Section);
+      Offset += 8 + Length;
+      if (Section[0] < 0x4E || Section[0] > 0x6F || Length < 18)
+         continue;
+      if (!SI::CRC32::isValid((const char *)Section, Length))
+         continue; // we don't want to make broken sections valid
+      // The events start after the 14 byte header and end before the CRC:
+      for (uchar *e = Section + 14; e + 12 <= Section + Length - 4; ) {
+          int Mjd = ((e[2] << 8) | e[3]) + Days;
+          e[2] = Mjd >> 8;
+          e[3] = Mjd & 0xFF;
+          e += 12 + (((e[10] & 0x0F) << 8) | e[11]);
+          }
+      uint32_t Crc = SI::CRC32::crc32((const char *)Section, Length - 4, 0xFFFFFFFF);
+      Section[Length - 4] = Crc >> 24;
+      Section[Length - 3] = Crc >> 16;
+      Section[Length - 2] = Crc >> 8;
+      Section[Length - 1] = Crc;
+      }
+}
+
+bool cEitDump::Get(int &Offset, int &Source, const uchar *&Section, int &Length) const
+{
+  if (Offset >= length)
+     return false;
+  Source = ntohl(*(uint32_t *)(data + Offset));
+  Section = data + Offset + 8;
+  Length = SectionLength(Section);
+  Offset += 8 + Length;
+  return true;
+}
+
+// --- main ------------------------------------------------------------------
+
+static int64_t MemoryRss(void)
+{
+  int64_t Rss = 0;
+  if (FILE *f = fopen("/proc/self/status", "r")) {
+     char Line[256];
+     while (fgets(Line, sizeof(Line), f)) {
+           if (startswith(Line, "VmRSS:")) {
+              Rss = strtoll(Line + 6, NULL, 10) * 1024;
+              break;
+              }
+           }
+     fclose(f);
+     }
+  return Rss;
+}
+
+static int64_t MemoryHeap(void)
+{
+  struct mallinfo2 mi = mallinfo2();
+  return mi.uordblks + mi.hblkhd;
+}
+
+static double CpuTime(const struct timeval &tv)
+{
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void Usage(void)
+{
+  printf("Usage: vdr-benchepg [OPTIONS] FILE\n\n"
+         "  -c FILE,  --channels=FILE read the channels from FILE (mandatory, since EPG\n"
+         "                            data is only stored for known channels)\n"
+         "  -E FILE,  --epgfile=FILE  read existing EPG data from FILE before replaying\n"
+         "                            the dump\n"
+         "  -l LEVEL, --log=LEVEL     set the log level (default: 1, see 'vdr --help')\n"
+         "  -n,       --noshift       don't move the events to today's date\n\n"
+         "FILE must be a dump of EIT sections, as written by 'vdr --eitdump=FILE'.\n");
+}
+
+int main(int argc, char *argv[])
+{
+  const char *ChannelsFileName = NULL;
+  const char *EpgDataFileName = NULL;
+  bool Shift = true;
+  SysLogLevel = 1;
+
+  static struct option long_options[] = {
+      { "channels", required_argument, NULL, 'c' },
+      { "epgfile",  required_argument, NULL, 'E' },
+      { "help",     no_argument,       NULL, 'h' },
+      { "log",      required_argument, NULL, 'l' },
+      { "noshift",  no_argument,       NULL, 'n' },
+      { NULL,       no_argument,       NULL,  0  }
+    };
+  int c;
+  while ((c = getopt_long(argc, argv, "c:E:hl:n", long_options, NULL)) != -1) {
+        switch (c) {
+          case 'c': ChannelsFileName = optarg;
+                    break;
+          case 'E': EpgDataFileName = optarg;
+                    break;
+          case 'h': Usage();
+                    return 0;
+          case 'l': SysLogLevel = atoi(optarg);
+                    break;
+          case 'n': Shift = false;
+                    break;
+          default:  return 2;
+          }
+        }
+  if (optind != argc - 1 || !ChannelsFileName) {
+     Usage();
+     return 2;
+     }
+  if (!cChannels::Load(ChannelsFileName, false, true)) {
+     fprintf(stderr, "vdr-benchepg: can't read channels from %s\n", ChannelsFileName);
+     return 1;
+     }
+  if (EpgDataFileName) {
+     FILE *f = fopen(EpgDataFileName, "r");
+     if (!f) {
+        perror(EpgDataFileName);
+        return 1;
+        }
+     bool Ok = cSchedules::Read(f);
+     fclose(f);
+     if (!Ok) {
+        fprintf(stderr, "vdr-benchepg: can't read EPG data from %s\n", EpgDataFileName);
+        return 1;
+        }
+     }
+  cEitDump Dump;
+  if (!Dump.Load(argv[optind])) {
+     fprintf(stderr, "vdr-benchepg: %s: no EIT sections found\n", argv[optind]);
+     return 1;
+     }
+  int Days = Shift ? int((time(NULL) - Dump.Captured()) / SECSINDAY) : 0;
+  if (Days > 0)
+     Dump.ShiftDays(Days);
+  printf("%s: %d sections, captured %s, moved by %d days\n", argv[optind], Dump.NumSections(), *DayDateTime(Dump.Captured()), Days);
+  // Replay the dump:
+  int64_t Rss0 = MemoryRss();
+  int64_t Heap0 = MemoryHeap();
+  uint64_t SchedulesHold0 = cStateLock::WriteHoldTime("5 Schedules");
+  uint64_t ChannelsHold0 = cStateLock::WriteHoldTime("2 Channels");
+  struct rusage Ru0, Ru1;
+  getrusage(RUSAGE_SELF, &Ru0);
+  uint64_t t0 = cTimeMs::NowUs();
+  cEitFilter EitFilter;
+  int Offset = 0;
+  int Source;
+  const uchar *Section;
+  int Length;
+  while (Dump.Get(Offset, Source, Section, Length))
+        EitFilter.ProcessEit(Source, Section[0], Section, Length);
+  uint64_t Elapsed = max(cTimeMs::NowUs() - t0, uint64_t(1));
+  getrusage(RUSAGE_SELF, &Ru1);
+  uint64_t SchedulesHold = cStateLock::WriteHoldTime("5 Schedules") - SchedulesHold0;
+  uint64_t ChannelsHold = cStateLock::WriteHoldTime("2 Channels") - ChannelsHold0;
+  int64_t Rss = MemoryRss() - Rss0;
+  int64_t Heap = MemoryHeap() - Heap0;
+  // Report the results:
+  double Seconds = Elapsed / 1e6;
+  double Cpu = CpuTime(Ru1.ru_utime) - CpuTime(Ru0.ru_utime) + CpuTime(Ru1.ru_stime) - CpuTime(Ru0.ru_stime);
+  printf("\n%d sections in %.3f s: %.0f sections/s, %.1f us CPU per section\n", Dump.NumSections(), Seconds, Dump.NumSections() / Seconds, Cpu * 1e6 / Dump.NumSections());
+  printf("Schedules write locked: %.3f s (%.1f%%)\n", SchedulesHold / 1e6, SchedulesHold * 100.0 / Elapsed);
+  printf("Channels write locked:  %.3f s (%.1f%%)\n", ChannelsHold / 1e6, ChannelsHold * 100.0 / Elapsed);
+  printf("memory: %+.1f MB heap, %+.1f MB resident\n", Heap / double(MEGABYTE(1)), Rss / double(MEGABYTE(1)));
+  int NumSchedules = 0;
+  int NumEvents = 0;
+  {
+    LOCK_SCHEDULES_READ;
+    for (const cSchedule *Schedule = Schedules->First(); Schedule; Schedule = Schedules->Next(Schedule)) {
+        NumSchedules++;
+        NumEvents += Schedule->Events()->Count();
+        }
+  }
+  printf("EPG data: %d schedules, %d events\n", NumSchedules, NumEvents);
+  return 0;
+}
@@ -0,0 +1,418 @@
+/*
+ * benchosd.c: Benchmark for OSD rendering
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "device.h"
+#include "epg.h"
+#include "osd.h"
+#include "osdbase.h"
+#include "recording.h"
+#include "skinclassic.h"
+#include "skinlcars.h"
+#include "skins.h"
+#include "skinsttng.h"
+#include "tools.h"
+
+// vdr-benchosd runs the built-in skins through a few scripted scenarios (the
+// schedule of a channel, the list of recordings and the progress display of a
+// replay) on a "headless" OSD, which does exactly what the OSD of an actual
+// output device does, except that the rendered areas are only copied into a
+// frame buffer in memory. For every skin and scenario it reports the time
+// needed for drawing and for composing the pixmaps per frame (i.e. per call to
+// Flush()), the number of pixels alpha blended onto the pixmaps and how much
+// data would have to be transferred to the output device. This allows to
+// benchmark changes to blending, glyph caching or dirty area handling without
+// any display hardware.
+
+#define DEFAULTOSDWIDTH   1920
+#define DEFAULTOSDHEIGHT  1080
+#define DEFAULTITEMS      100
+#define DEFAULTPASSES     3
+
+// --- cBenchOsd -------------------------------------------------------------
+
+class cBenchOsd : public cOsd {
+private:
+  bool trueColor;
+  tColor *frameBuffer;
+  int frameBufferSize;
+public:
+  static int flushes;
+  static int areas;
+  static int64_t bytes;
+  static uint64_t composeTime;
+  cBenchOsd(int Left, int Top, uint Level, bool TrueColor);
+  virtual ~cBenchOsd() override;
+  virtual eOsdError CanHandleAreas(const tArea *Areas, int NumAreas) override;
+  virtual void Flush(void) override;
+  static void ResetStatistics(void);
+  };
+
+int cBenchOsd::flushes = 0;
+int cBenchOsd::areas = 0;
+int64_t cBenchOsd::bytes = 0;
+uint64_t cBenchOsd::composeTime = 0;
+
+cBenchOsd::cBenchOsd(int Left, int Top, uint Level, bool TrueColor)
+:cOsd(Left, Top, Level)
+{
+  trueColor = TrueColor;
+  frameBuffer = NULL;
+  frameBufferSize = 0;
+}
+
+cBenchOsd::~cBenchOsd()
+{
+  SetActive(false);
+  free(frameBuffer);
+}
+
+void cBenchOsd::ResetStatistics(void)
+{
+  flushes = areas = 0;
+  bytes = 0;
+  composeTime = 0;
+}
+
+eOsdError cBenchOsd::CanHandleAreas(const tArea *Areas, int NumAreas)
+{
+  eOsdError Result = cOsd::CanHandleAreas(Areas, NumAreas);
+  if (Result == oeOk && !trueColor) {
+     for (int i = 0; i < NumAreas; i++) {
+         if (Areas[i].bpp == 32)
+            return oeBppNotSupported;
+         }
+     }
+  return Result;
+}
+
+void cBenchOsd::Flush(void)
+{
+  if (!Active())
+     return;
+  uint64_t t = cTimeMs::NowUs();
+  if (IsTrueColor()) {
+     if (Width() * Height() > frameBufferSize) {
+        frameBufferSize = Width() * Height();
+        free(frameBuffer);
+        frameBuffer = MALLOC(tColor, frameBufferSize);
+        }
+     LOCK_PIXMAPS;
+     while (cPixmapMemory *pm = dynamic_cast<cPixmapMemory *>(RenderPixmaps())) {
+           // "Transfer" the rendered area to the output device:
+           cRect r = pm->ViewPort().Intersected(cRect(0, 0, Width(), Height()));
+           if (!r.IsEmpty()) {
+              const tColor *s = (const tColor *)pm->Data() + (r.Top() - pm->ViewPort().Top()) * pm->ViewPort().Width() + r.Left() - pm->ViewPort().Left();
+              tColor *d = frameBuffer + r.Top() * Width() + r.Left();
+              for (int y = r.Height(); y-- > 0; ) {
+                  memcpy(d, s, r.Width() * sizeof(tColor));
+                  s += pm->ViewPort().Width();
+                  d += Width();
+                  }
+              areas++;
+              bytes += r.Width() * r.Height() * sizeof(tColor);
+              }
+           DestroyPixmap(pm);
+           }
+     }
+  else {
+     for (int i = 0; cBitmap *Bitmap = GetBitmap(i); i++) {
+         int x1, y1, x2, y2;
+         if (Bitmap->Dirty(x1, y1, x2, y2)) {
+            areas++;
+            bytes += (x2 - x1 + 1) * (y2 - y1 + 1); // one byte per pixel, plus the palette, which we ignore
+            Bitmap->Clean();
+            }
+         }
+     }
+  composeTime += cTimeMs::NowUs() - t;
+  flushes++;
+}
+
+// --- cBenchOsdProvider -----------------------------------------------------
+
+class cBenchOsdProvider : public cOsdProvider {
+private:
+  bool trueColor;
+protected:
+  virtual cOsd *CreateOsd(int Left, int Top, uint Level) override { return new cBenchOsd(Left, Top, Level, trueColor); }
+  virtual bool ProvidesTrueColor(void) override { return trueColor; }
+public:
+  cBenchOsdProvider(bool TrueColor) { trueColor = TrueColor; }
+  };
+
+// --- cBenchOsdDevice -------------------------------------------------------
+
+class cBenchOsdDevice : public cDevice {
+private:
+  int width;
+  int height;
+  bool trueColor;
+protected:
+  virtual void MakePrimaryDevice(bool On) override;
+public:
+  cBenchOsdDevice(int Width, int Height, bool TrueColor);
+  virtual bool HasDecoder(void) const override { return true; }
+  virtual void GetOsdSize(int &Width, int &Height, double &PixelAspect) override;
+  };
+
+cBenchOsdDevice::cBenchOsdDevice(int Width, int Height, bool TrueColor)
+{
+  width = Width;
+  height = Height;
+  trueColor = TrueColor;
+}
+
+void cBenchOsdDevice::MakePrimaryDevice(bool On)
+{
+  if (On)
+     new cBenchOsdProvider(trueColor);
+  cDevice::MakePrimaryDevice(On);
+}
+
+void cBenchOsdDevice::GetOsdSize(int &Width, int &Height, double &PixelAspect)
+{
+  Width = width;
+  Height = height;
+  PixelAspect = 1.0;
+}
+
+// --- cBenchMenu ------------------------------------------------------------
+
+class cBenchMenu : public cOsdMenu {
+public:
+  cBenchMenu(const char *Title, eMenuCategory MenuCategory, int c0, int c1, int c2);
+  };
+
+cBenchMenu::cBenchMenu(const char *Title, eMenuCategory MenuCategory, int c0, int c1, int c2)
+:cOsdMenu(Title, c0, c1, c2)
+{
+  SetMenuCategory(MenuCategory);
+  SetHelp("Record", "Now", "Next", "Switch");
+}
+
+// --- Scenarios -------------------------------------------------------------
+
+static const char *Titles[] = {
+  "Tagesschau",
+  "The Weather",
+  "Late Night Talk with a Rather Long Title That Needs to Be Truncated",
+  "Documentary: Life in the Deep Sea",
+  "News",
+  "Football - Round of Sixteen, Second Leg",
+  "Movie: The Adventures of Somebody Somewhere",
+  "Cooking Show",
+  "Quiz Night",
+  "Crime Series, Episode 12",
+  NULL
+  };
+
+static const char *SampleTitle(int i)
+{
+  static int NumTitles = 0;
+  if (!NumTitles) {
+     while (Titles[NumTitles])
+           NumTitles++;
+     }
+  return Titles[i % NumTitles];
+}
+
+static void ScrollMenu(cOsdMenu *Menu, int NumItems)
+{
+  // Like cMenuSchedule and cMenuRecordings, and like the main loop, which
+  // calls Skins.Flush() after every key:
+  Menu->Display();
+  Skins.Flush();
+  for (int i = 1; i < NumItems; i++) {
+      Menu->ProcessKey(kDown);
+      Skins.Flush();
+      }
+  while (Menu->Current() > 0) {
+        Menu->ProcessKey(kLeft); // page up
+        Skins.Flush();
+        }
+}
+
+static void Schedule(int Steps)
+{
+  cList<cEvent> Events;
+  time_t t = time(NULL) / 3600 * 3600;
+  cBenchMenu *Menu = new cBenchMenu("Schedule - 1 Das Erste HD", mcSchedule, 7, 6, 4);
+  for (int i = 0; i < Steps; i++) {
+      cEvent *Event = new cEvent(i);
+      Event->SetTitle(SampleTitle(i));
+      Event->SetStartTime(t);
+      Event->SetDuration(((i % 4) + 1) * 15 * 60);
+      t += Event->Duration();
+      Events.Add(Event);
+      cString eds = Event->GetDateString();
+      Menu->Add(new cOsdItem(cString::sprintf("%.*s\t%s\t%c%c%c\t%s", Utf8SymChars(eds, 6), *eds, *Event->GetTimeString(), i % 7 ? ' ' : 'T', ' ', i ? ' ' : '*', Event->Title())));
+      }
+  ScrollMenu(Menu, Steps);
+  delete Menu;
+}
+
+static void Recordings(int Steps)
+{
+  time_t t = time(NULL);
+  cBenchMenu *Menu = new cBenchMenu("Recordings", mcRecording, 9, 6, 6);
+  for (int i = 0; i < Steps; i++) {
+      if (i % 10 == 0)
+         Menu->Add(new cOsdItem(cString::sprintf("%d\t\t%d\t%s", 10 + i, i % 3, SampleTitle(i))));
+      else {
+         int Length = 30 + (i * 7) % 120;
+         Menu->Add(new cOsdItem(cString::sprintf("%s\t%s\t%d:%02d'%c\t%s", *ShortDateString(t), *TimeString(t), Length / 60, Length % 60, i % 3 ? ' ' : '*', SampleTitle(i))));
+         }
+      t -= SECSINDAY / 3;
+      }
+  ScrollMenu(Menu, Steps);
+  delete Menu;
+}
+
+static void Replay(int Steps)
+{
+  // Like cReplayControl::ShowProgress(), updating the display once per second:
+  double Fps = DEFAULTFRAMESPERSECOND;
+  int Total = int(Steps * Fps * 10);
+  cMarks Marks;
+  for (int i = 1; i < 8; i++)
+      Marks.Add(Total * i / 8);
+  cSkinDisplayReplay *DisplayReplay = Skins.Current()->DisplayReplay(false);
+  DisplayReplay->SetMarks(&Marks);
+  DisplayReplay->SetTitle(SampleTitle(6));
+  DisplayReplay->SetMode(true, true, -1);
+  DisplayReplay->SetTotal(IndexToHMSF(Total, false, Fps));
+  for (int i = 0; i < Steps; i++) {
+      int Current = int(i * Fps);
+      DisplayReplay->SetProgress(Current, Total);
+      DisplayReplay->SetCurrent(IndexToHMSF(Current, false, Fps));
+      DisplayReplay->Flush();
+      }
+  delete DisplayReplay;
+}
+
+// --- main ------------------------------------------------------------------
+
+typedef void (*tScenario)(int Steps);
+
+static void Run(const char *Name, tScenario Scenario, int Steps, int Passes)
+{
+  Scenario(Steps); // warms up the font and image caches
+  cBenchOsd::ResetStatistics();
+  uint64_t Blended = cPixmapMemory::PixelsBlended();
+  uint64_t t = cTimeMs::NowUs();
+  for (int i = 0; i < Passes; i++)
+      Scenario(Steps);
+  t = cTimeMs::NowUs() - t;
+  Blended = cPixmapMemory::PixelsBlended() - Blended;
+  int Frames = max(cBenchOsd::flushes, 1);
+  printf("  %-12s %8d %10.3f %10.3f %10.1f %10.1f %8.1f\n", Name, cBenchOsd::flushes,
+    (t - cBenchOsd::composeTime) / 1000.0 / Frames,
+    cBenchOsd::composeTime / 1000.0 / Frames,
+    Blended / 1000.0 / Frames,
+    cBenchOsd::bytes / double(KILOBYTE(1)) / Frames,
+    double(cBenchOsd::areas) / Frames);
+}
+
+static void Usage(void)
+{
+  printf("Usage: vdr-benchosd [OPTIONS]\n\n"
+         "  -b,       --bitmaps       use an OSD without true color support, so that the\n"
+         "                            skins draw into bitmaps instead of pixmaps\n"
+         "  -k NAME,  --skin=NAME     only run the skin with the given NAME (default: all\n"
+         "                            built-in skins)\n"
+         "  -l LEVEL, --log=LEVEL     set the log level (default: 1, see 'vdr --help')\n"
+         "  -n NUM,   --items=NUM     use NUM menu items or progress updates (default: %d)\n"
+         "  -p NUM,   --passes=NUM    run every scenario NUM times (default: %d)\n"
+         "  -s WxH,   --size=WxH      set the size of the screen (default: %dx%d)\n\n"
+         "Every scenario is run once more before it is measured, to fill the font and\n"
+         "image caches. The results are given per frame, i.e. per call to Flush().\n"
+         "\"Drawing\" is the time the skin needs to draw into the OSD, \"composing\" the\n"
+         "time needed to render the pixmaps and copy the result to the frame buffer.\n",
+         DEFAULTITEMS, DEFAULTPASSES, DEFAULTOSDWIDTH, DEFAULTOSDHEIGHT);
+}
+
+int main(int argc, char *argv[])
+{
+  bool TrueColor = true;
+  const char *SkinName = NULL;
+  int Steps = DEFAULTITEMS;
+  int Passes = DEFAULTPASSES;
+  int Width = DEFAULTOSDWIDTH;
+  int Height = DEFAULTOSDHEIGHT;
+  SysLogLevel = 1;
+
+  static struct option long_options[] = {
+      { "bitmaps", no_argument,       NULL, 'b' },
+      { "help",    no_argument,       NULL, 'h' },
+      { "items",   required_argument, NULL, 'n' },
+      { "log",     required_argument, NULL, 'l' },
+      { "passes",  required_argument, NULL, 'p' },
+      { "size",    required_argument, NULL, 's' },
+      { "skin",    required_argument, NULL, 'k' },
+      { NULL,      no_argument,       NULL,  0  }
+    };
+  int c;
+  while ((c = getopt_long(argc, argv, "bhk:l:n:p:s:", long_options, NULL)) != -1) {
+        switch (c) {
+          case 'b': TrueColor = false;
+                    break;
+          case 'h': Usage();
+                    return 0;
+          case 'k': SkinName = optarg;
+                    break;
+          case 'l': SysLogLevel = atoi(optarg);
+                    break;
+          case 'n': Steps = max(atoi(optarg), 1);
+                    break;
+          case 'p': Passes = max(atoi(optarg), 1);
+                    break;
+          case 's': if (sscanf(optarg, "%dx%d", &Width, &Height) != 2 || Width < 320 || Height < 240) {
+                       fprintf(stderr, "vdr-benchosd: invalid size: %s\n", optarg);
+                       return 2;
+                       }
+                    break;
+          default:  return 2;
+          }
+        }
+  if (optind < argc) {
+     Usage();
+     return 2;
+     }
+  new cBenchOsdDevice(Width, Height, TrueColor);
+  cDevice::SetPrimaryDevice(1);
+  cOsdProvider::UpdateOsdSize(true);
+  if (!*cFont::GetFontFileName(Setup.FontOsd))
+     fprintf(stderr, "vdr-benchosd: no fonts available - text will not be drawn!\n");
+  new cSkinLCARS;
+  new cSkinSTTNG;
+  new cSkinClassic;
+  printf("OSD %dx%d, %s, %d items, %d passes\n", Setup.OSDWidth, Setup.OSDHeight, TrueColor ? "true color" : "bitmaps", Steps, Passes);
+  printf("  %-12s %8s %10s %10s %10s %10s %8s\n", "", "frames", "drawing", "composing", "blended", "flushed", "areas");
+  printf("  %-12s %8s %10s %10s %10s %10s %8s\n", "", "", "ms/frame", "ms/frame", "kpx/frame", "KB/frame", "/frame");
+  bool Found = false;
+  for (cSkin *Skin = Skins.First(); Skin; Skin = Skins.Next(Skin)) {
+      if (SkinName && strcmp(Skin->Name(), SkinName) != 0)
+         continue;
+      Found = true;
+      Skins.SetCurrent(Skin->Name());
+      printf("%s:\n", Skin->Name());
+      Run("schedule", Schedule, Steps, Passes);
+      Run("recordings", Recordings, Steps, Passes);
+      Run("replay", Replay, Steps, Passes);
+      }
+  if (!Found)
+     fprintf(stderr, "vdr-benchosd: unknown skin: %s\n", SkinName);
+  Skins.Clear();
+  cOsdProvider::Shutdown();
+  cDevice::Shutdown();
+  return Found ? 0 : 1;
+}
@@ -0,0 +1,296 @@
+/*
+ * benchparsers.c: Benchmark for the frame detector and remux parsers
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "remux.h"
+#include "tools.h"
+
+// vdr-benchparsers runs the parsers that do the actual work when recording
+// and generating index files over a number of Transport Stream files (a corpus
+// of, say, an SD MPEG-2, an HD H.264, a UHD HEVC and a radio recording) and
+// reports their throughput in MB/s and the time they need per frame. The
+// stream parsers for MPEG-2, H.264, H.265 and audio are used through
+// cFrameDetector, which selects them according to the stream type. Every
+// benchmark is repeated for at least the given time, and the fastest pass is
+// reported, so that the results of different builds can be compared.
+
+#define DEFAULTMINTIME  1 // seconds each benchmark is repeated for
+#define MINPASSES       3
+
+// --- cBenchStream ----------------------------------------------------------
+
+class cBenchStream {
+private:
+  uchar *buffer;
+  uchar *data;
+  int length;
+  int vpid;
+  int vtype;
+  int apid;
+  int atype;
+public:
+  cBenchStream(void);
+  ~cBenchStream();
+  bool Load(const char *FileName);
+  uchar *Data(void) const { return data; }
+  int Length(void) const { return length; }
+  int Vpid(void) const { return vpid; }
+  int Vtype(void) const { return vtype; }
+  int Apid(void) const { return apid; }
+  int Atype(void) const { return atype; }
+  };
+
+cBenchStream::cBenchStream(void)
+{
+  buffer = data = NULL;
+  length = 0;
+  vpid = vtype = apid = atype = 0;
+}
+
+cBenchStream::~cBenchStream()
+{
+  free(buffer);
+}
+
+bool cBenchStream::Load(const char *FileName)
+{
+  int f = open(FileName, O_RDONLY);
+  if (f < 0) {
+     perror(FileName);
+     return false;
+     }
+  off_t Size = lseek(f, 0, SEEK_END);
+  if (Size <= 0 || Size > INT_MAX) {
+     fprintf(stderr, "vdr-benchparsers: %s: invalid file size\n", FileName);
+     close(f);
+     return false;
+     }
+  buffer = MALLOC(uchar, Size);
+  if (!buffer || pread(f, buffer, Size, 0) != Size) {
+     perror(FileName);
+     close(f);
+     return false;
+     }
+  close(f);
+  int Offset = 0;
+  while (Offset < Size && buffer[Offset] != TS_SYNC_BYTE)
+        Offset++;
+  data = buffer + Offset;
+  length = (Size - Offset) / TS_SIZE * TS_SIZE;
+  // Use the first service, just like a recording contains only one:
+  cPatPmtParser PatPmtParser;
+  for (int i = 0; i < length; i += TS_SIZE) {
+      if (PatPmtParser.ParsePatPmt(data + i, TS_SIZE))
+         break;
+      }
+  vpid = PatPmtParser.Vpid();
+  vtype = PatPmtParser.Vtype();
+  // The frame detector handles all kinds of audio the same way, so we use
+  // the types a cRecorder would use:
+  if ((apid = PatPmtParser.Apid(0)) != 0)
+     atype = 0x04;
+  else if ((apid = PatPmtParser.Dpid(0)) != 0)
+     atype = 0x06;
+  if (!vpid && !apid) {
+     fprintf(stderr, "vdr-benchparsers: %s: no video or audio stream found\n", FileName);
+     return false;
+     }
+  return true;
+}
+
+// --- Benchmarks ------------------------------------------------------------
+
+static int DetectFrames(const cBenchStream &Stream, int Pid, int Type)
+{
+  cFrameDetector FrameDetector(Pid, Type);
+  const uchar *p = Stream.Data();
+  int Length = Stream.Length();
+  int Frames = 0;
+  while (Length > 0) {
+        int n = FrameDetector.Analyze(p, Length);
+        if (n <= 0)
+           break; // not enough data left for the frame detector
+        bool PreviousErrors, MissingFrames;
+        if (FrameDetector.NewFrame(PreviousErrors, MissingFrames))
+           Frames++;
+        p += n;
+        Length -= n;
+        }
+  return Frames;
+}
+
+static int TsToPes(const cBenchStream &Stream, int Pid, int Type)
+{
+  cTsToPes TsToPes;
+  int Packets = 0;
+  const uchar *End = Stream.Data() + Stream.Length();
+  for (const uchar *p = Stream.Data(); p <= End; p += TS_SIZE) {
+      if (p == End || TsPid(p) == Pid && TsPayloadStart(p)) {
+         int l;
+         while (TsToPes.GetPes(l))
+               Packets++;
+         if (p == End)
+            break;
+         TsToPes.Reset();
+         }
+      if (TsPid(p) == Pid)
+         TsToPes.PutTs(p, TS_SIZE);
+      }
+  return Packets;
+}
+
+static int ParsePatPmt(const cBenchStream &Stream, int Pid, int Type)
+{
+  cPatPmtParser PatPmtParser;
+  int Completed = 0;
+  for (int i = 0; i < Stream.Length(); i += TS_SIZE) {
+      if (PatPmtParser.ParsePatPmt(Stream.Data() + i, TS_SIZE))
+         Completed++;
+      }
+  return Completed;
+}
+
+static int ScanPayload(const cBenchStream &Stream, int Pid, int Type)
+{
+  // Like the parsers, we scan every payload unit separately:
+  cTsPayload TsPayload;
+  int StartCodes = 0;
+  for (int i = 0; i < Stream.Length(); i += TS_SIZE) {
+      uchar *p = Stream.Data() + i;
+      if (TsPid(p) == Pid && TsPayloadStart(p)) {
+         TsPayload.Setup(p, Stream.Length() - i, Pid);
+         uint32_t Scanner = 0xFFFFFFFF;
+         while (!TsPayload.Eof()) {
+               TsPayload.ScanStartCode(Scanner);
+               if ((Scanner & 0xFFFFFF00) == 0x00000100)
+                  StartCodes++;
+               }
+         }
+      }
+  return StartCodes;
+}
+
+// --- cBenchmark ------------------------------------------------------------
+
+typedef int (*tBenchFunction)(const cBenchStream &Stream, int Pid, int Type);
+
+class cBenchmark {
+private:
+  int minTime;
+  const cBenchStream &stream;
+  int frames;
+public:
+  cBenchmark(int MinTime, const cBenchStream &Stream, int Frames);
+  void Run(const char *Name, tBenchFunction Function, int Pid, int Type = 0);
+       ///< Repeatedly calls Function() for the given Pid and Type and reports
+       ///< the fastest pass.
+  };
+
+cBenchmark::cBenchmark(int MinTime, const cBenchStream &Stream, int Frames)
+:stream(Stream)
+{
+  minTime = MinTime;
+  frames = Frames;
+}
+
+void cBenchmark::Run(const char *Name, tBenchFunction Function, int Pid, int Type)
+{
+  uint64_t Best = 0;
+  int Result = 0;
+  uint64_t Start = cTimeMs::NowUs();
+  for (int Pass = 0; Pass < MINPASSES || cTimeMs::NowUs() - Start < uint64_t(minTime) * 1000000; Pass++) {
+      uint64_t t = cTimeMs::NowUs();
+      Result = Function(stream, Pid, Type);
+      t = cTimeMs::NowUs() - t;
+      if (!Pass || t < Best)
+         Best = t;
+      }
+  Best = max(Best, uint64_t(1));
+  printf("  %-24s %10.1f MB/s %10.0f ns/frame %10d results\n", Name, stream.Length() / double(MEGABYTE(1)) * 1000000 / Best, frames ? Best * 1000.0 / frames : 0, Result);
+}
+
+// --- main ------------------------------------------------------------------
+
+static const char *StreamTypeName(int Type)
+{
+  switch (Type) {
+    case 0x01:
+    case 0x02: return "MPEG-2";
+    case 0x1B: return "H.264";
+    case 0x24: return "H.265";
+    case 0x04: return "audio";
+    case 0x06: return "AC-3";
+    default:   return "unknown";
+    }
+}
+
+static void Usage(void)
+{
+  printf("Usage: vdr-benchparsers [OPTIONS] FILE...\n\n"
+         "  -l LEVEL, --log=LEVEL     set the log level (default: 1, see 'vdr --help')\n"
+         "  -t SEC,   --time=SEC      repeat each benchmark for at least SEC seconds\n"
+         "                            (default: %d)\n\n"
+         "Every FILE must contain a Transport Stream with a PAT and a PMT, like the\n"
+         "files of a VDR recording. The first service is used.\n"
+         "The time per frame refers to the frames of the video stream, or the audio\n"
+         "stream in case of radio. The \"results\" column shows the number of frames,\n"
+         "PES packets, completed PAT/PMT parses or start codes found, which must be\n"
+         "the same for builds that are to be compared.\n",
+         DEFAULTMINTIME);
+}
+
+int main(int argc, char *argv[])
+{
+  int MinTime = DEFAULTMINTIME;
+  SysLogLevel = 1;
+
+  static struct option long_options[] = {
+      { "help", no_argument,       NULL, 'h' },
+      { "log",  required_argument, NULL, 'l' },
+      { "time", required_argument, NULL, 't' },
+      { NULL,   no_argument,       NULL,  0  }
+    };
+  int c;
+  while ((c = getopt_long(argc, argv, "hl:t:", long_options, NULL)) != -1) {
+        switch (c) {
+          case 'h': Usage();
+                    return 0;
+          case 'l': SysLogLevel = atoi(optarg);
+                    break;
+          case 't': MinTime = atoi(optarg);
+                    break;
+          default:  return 2;
+          }
+        }
+  if (optind >= argc) {
+     Usage();
+     return 2;
+     }
+  for (int i = optind; i < argc; i++) {
+      cBenchStream Stream;
+      if (!Stream.Load(argv[i]))
+         return 1;
+      int Pid = Stream.Vpid() ? Stream.Vpid() : Stream.Apid();
+      int Type = Stream.Vpid() ? Stream.Vtype() : Stream.Atype();
+      int Frames = DetectFrames(Stream, Pid, Type);
+      printf("%s: %d MB, %s, %d frames\n", argv[i], int(Stream.Length() / MEGABYTE(1)), StreamTypeName(Type), Frames);
+      cBenchmark Benchmark(MinTime, Stream, Frames);
+      if (Stream.Vpid())
+         Benchmark.Run(cString::sprintf("cFrameDetector (%s)", StreamTypeName(Stream.Vtype())), DetectFrames, Stream.Vpid(), Stream.Vtype());
+      if (Stream.Apid())
+         Benchmark.Run(cString::sprintf("cFrameDetector (%s)", StreamTypeName(Stream.Atype())), DetectFrames, Stream.Apid(), Stream.Atype());
+      Benchmark.Run("cTsToPes", TsToPes, Pid);
+      Benchmark.Run("cPatPmtParser", ParsePatPmt, Pid);
+      Benchmark.Run("cTsPayload", ScanPayload, Pid);
+      }
+  return 0;
+}
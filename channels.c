@@ -51,14 +51,112 @@ tChannelID &tChannelID::ClrPolarization(void)
   return *this;
 }
 
+// --- tChannelPids ----------------------------------------------------------
+
+// The pid lists of a channel are stored in a single block of memory, which only
+// has room for the pids that are actually used (most channels have only one or
+// two audio pids, no dolby or subtitle pids and only a few CA ids). The block
+// consists of this header, followed by the zero-terminated lists apids, atypes,
+// dpids, dtypes, spids and caids, the composition and ancillary page ids of the
+// subtitles, the language codes of the audio, dolby and subtitle pids and the
+// subtitling types.
+
+struct tChannelPids {
+  uchar numApids;
+  uchar numDpids;
+  uchar numSpids;
+  uchar numCaids;
+  int *Apids(void) { return (int *)(this + 1); }
+  int *Atypes(void) { return Apids() + numApids + 1; }
+  int *Dpids(void) { return Atypes() + numApids + 1; }
+  int *Dtypes(void) { return Dpids() + numDpids + 1; }
+  int *Spids(void) { return Dtypes() + numDpids + 1; }
+  int *Caids(void) { return Spids() + numSpids + 1; }
+  uint16_t *CompositionPageIds(void) { return (uint16_t *)(Caids() + numCaids + 1); }
+  uint16_t *AncillaryPageIds(void) { return CompositionPageIds() + numSpids; }
+  char (*Alangs(void))[MAXLANGCODE2] { return (char (*)[MAXLANGCODE2])(AncillaryPageIds() + numSpids); }
+  char (*Dlangs(void))[MAXLANGCODE2] { return Alangs() + numApids; }
+  char (*Slangs(void))[MAXLANGCODE2] { return Dlangs() + numDpids; }
+  uchar *SubtitlingTypes(void) { return (uchar *)(Slangs() + numSpids); }
+  int Size(void) { return Size(numApids, numDpids, numSpids, numCaids); }
+  static int Size(int NumApids, int NumDpids, int NumSpids, int NumCaids)
+  {
+    return sizeof(tChannelPids) + (2 * (NumApids + 1) + 2 * (NumDpids + 1) + NumSpids + 1 + NumCaids + 1) * sizeof(int) + 2 * NumSpids * sizeof(uint16_t) + (NumApids + NumDpids + NumSpids) * MAXLANGCODE2 + NumSpids;
+  }
+  };
+
+// The expanded form of the pid lists, used to modify them:
+
+struct tChannelPidLists {
+  int apids[MAXAPIDS + 1]; // list is zero-terminated
+  int atypes[MAXAPIDS + 1]; // list is zero-terminated
+  char alangs[MAXAPIDS][MAXLANGCODE2];
+  int dpids[MAXDPIDS + 1]; // list is zero-terminated
+  int dtypes[MAXDPIDS + 1]; // list is zero-terminated
+  char dlangs[MAXDPIDS][MAXLANGCODE2];
+  int spids[MAXSPIDS + 1]; // list is zero-terminated
+  char slangs[MAXSPIDS][MAXLANGCODE2];
+  uchar subtitlingTypes[MAXSPIDS];
+  uint16_t compositionPageIds[MAXSPIDS];
+  uint16_t ancillaryPageIds[MAXSPIDS];
+  int caids[MAXCAIDS + 1]; // list is zero-terminated
+  };
+
+static int EmptyPidsData[7] = { 0 }; // the header and the six terminating zeros
+#define EmptyPids ((tChannelPids *)EmptyPidsData) // shared by all channels without any pids
+
+static int IntListLength(const int *a, int Max)
+{
+  int n = 0;
+  while (n < Max && a[n])
+        n++;
+  return n;
+}
+
+static tChannelPids *NewChannelPids(int NumApids, int NumDpids, int NumSpids, int NumCaids)
+{
+  if (!NumApids && !NumDpids && !NumSpids && !NumCaids)
+     return EmptyPids;
+  int Size = tChannelPids::Size(NumApids, NumDpids, NumSpids, NumCaids);
+  tChannelPids *Pids = (tChannelPids *)calloc(1, Size);
+  if (!Pids) {
+     esyslog("ERROR: can't allocate %d bytes for channel pids", Size);
+     return EmptyPids;
+     }
+  Pids->numApids = NumApids;
+  Pids->numDpids = NumDpids;
+  Pids->numSpids = NumSpids;
+  Pids->numCaids = NumCaids;
+  return Pids;
+}
+
+static void DeleteChannelPids(tChannelPids *Pids)
+{
+  if (Pids && Pids != EmptyPids)
+     free(Pids);
+}
+
+static tChannelPids *CopyChannelPids(tChannelPids *Pids)
+{
+  if (Pids == EmptyPids)
+     return EmptyPids;
+  int Size = Pids->Size();
+  tChannelPids *p = (tChannelPids *)malloc(Size);
+  if (!p) {
+     esyslog("ERROR: can't allocate %d bytes for channel pids", Size);
+     return EmptyPids;
+     }
+  memcpy(p, Pids, Size);
+  return p;
+}
+
 // --- cChannel --------------------------------------------------------------
 
 cChannel::cChannel(void)
 {
-  name = strdup("");
-  shortName = strdup("");
-  provider = strdup("");
-  portalName = strdup("");
+  names = NULL;
+  pids = EmptyPids;
+  SetNames("", "", "", "");
   memset(&__BeginData__, 0, (char *)&__EndData__ - (char *)&__BeginData__);
   parameters = "";
   modification = CHANNELMOD_NONE;
@@ -66,17 +164,18 @@ cChannel::cChannel(void)
   schedule     = NULL;
   linkChannels = NULL;
   refChannel   = NULL;
+  hashedIn     = NULL;
 }
 
 cChannel::cChannel(const cChannel &Channel)
 {
-  name = NULL;
-  shortName = NULL;
-  provider = NULL;
-  portalName = NULL;
+  names = NULL;
+  name = shortName = provider = portalName = NULL;
+  pids = EmptyPids;
   schedule     = NULL;
   linkChannels = NULL;
   refChannel   = NULL;
+  hashedIn     = NULL;
   seen         = 0;
   *this = Channel;
 }
@@ -84,24 +183,126 @@ cChannel::cChannel(const cChannel &Channel)
 cChannel::~cChannel()
 {
   delete linkChannels; // any links from other channels pointing to this one have been deleted in cChannels::Del()
-  free(name);
-  free(shortName);
-  free(provider);
-  free(portalName);
+  free(names);
+  DeleteChannelPids(pids);
 }
 
 cChannel& cChannel::operator= (const cChannel &Channel)
 {
-  name = strcpyrealloc(name, Channel.name);
-  shortName = strcpyrealloc(shortName, Channel.shortName);
-  provider = strcpyrealloc(provider, Channel.provider);
-  portalName = strcpyrealloc(portalName, Channel.portalName);
+  cChannels *Channels = hashedIn;
+  if (Channels)
+     Channels->UnhashChannel(this);
+  if (&Channel != this) {
+     SetNames(Channel.name, Channel.shortName, Channel.provider, Channel.portalName);
+     DeleteChannelPids(pids);
+     pids = CopyChannelPids(Channel.pids);
+     }
   memcpy(&__BeginData__, &Channel.__BeginData__, (char *)&Channel.__EndData__ - (char *)&Channel.__BeginData__);
   UpdateNameSource();
   parameters = Channel.parameters;
+  if (Channels)
+     Channels->HashChannel(this);
   return *this;
 }
 
+void cChannel::SetNames(const char *Name, const char *ShortName, const char *Provider, const char *PortalName)
+{
+  // The given strings may point into the current block, so they are copied before it is freed:
+  int ln = strlen(Name) + 1;
+  int ls = strlen(ShortName) + 1;
+  int lp = strlen(Provider) + 1;
+  int lo = strlen(PortalName) + 1;
+  char *p = MALLOC(char, ln + ls + lp + lo);
+  memcpy(p, Name, ln);
+  memcpy(p + ln, ShortName, ls);
+  memcpy(p + ln + ls, Provider, lp);
+  memcpy(p + ln + ls + lp, PortalName, lo);
+  free(names);
+  names = p;
+  name = p;
+  shortName = p + ln;
+  provider = p + ln + ls;
+  portalName = p + ln + ls + lp;
+}
+
+void cChannel::GetPidLists(tChannelPidLists &Lists) const
+{
+  memset(&Lists, 0, sizeof(Lists));
+  memcpy(Lists.apids, pids->Apids(), pids->numApids * sizeof(int));
+  memcpy(Lists.atypes, pids->Atypes(), pids->numApids * sizeof(int));
+  memcpy(Lists.alangs, pids->Alangs(), pids->numApids * MAXLANGCODE2);
+  memcpy(Lists.dpids, pids->Dpids(), pids->numDpids * sizeof(int));
+  memcpy(Lists.dtypes, pids->Dtypes(), pids->numDpids * sizeof(int));
+  memcpy(Lists.dlangs, pids->Dlangs(), pids->numDpids * MAXLANGCODE2);
+  memcpy(Lists.spids, pids->Spids(), pids->numSpids * sizeof(int));
+  memcpy(Lists.slangs, pids->Slangs(), pids->numSpids * MAXLANGCODE2);
+  memcpy(Lists.subtitlingTypes, pids->SubtitlingTypes(), pids->numSpids);
+  memcpy(Lists.compositionPageIds, pids->CompositionPageIds(), pids->numSpids * sizeof(uint16_t));
+  memcpy(Lists.ancillaryPageIds, pids->AncillaryPageIds(), pids->numSpids * sizeof(uint16_t));
+  memcpy(Lists.caids, pids->Caids(), pids->numCaids * sizeof(int));
+}
+
+void cChannel::SetPidLists(const tChannelPidLists &Lists)
+{
+  int na = IntListLength(Lists.apids, MAXAPIDS);
+  int nd = IntListLength(Lists.dpids, MAXDPIDS);
+  int ns = IntListLength(Lists.spids, MAXSPIDS);
+  int nc = IntListLength(Lists.caids, MAXCAIDS);
+  tChannelPids *p = NewChannelPids(na, nd, ns, nc);
+  if (p != EmptyPids) {
+     memcpy(p->Apids(), Lists.apids, na * sizeof(int));
+     memcpy(p->Atypes(), Lists.atypes, na * sizeof(int));
+     memcpy(p->Alangs(), Lists.alangs, na * MAXLANGCODE2);
+     memcpy(p->Dpids(), Lists.dpids, nd * sizeof(int));
+     memcpy(p->Dtypes(), Lists.dtypes, nd * sizeof(int));
+     memcpy(p->Dlangs(), Lists.dlangs, nd * MAXLANGCODE2);
+     memcpy(p->Spids(), Lists.spids, ns * sizeof(int));
+     memcpy(p->Slangs(), Lists.slangs, ns * MAXLANGCODE2);
+     memcpy(p->SubtitlingTypes(), Lists.subtitlingTypes, ns);
+     memcpy(p->CompositionPageIds(), Lists.compositionPageIds, ns * sizeof(uint16_t));
+     memcpy(p->AncillaryPageIds(), Lists.ancillaryPageIds, ns * sizeof(uint16_t));
+     memcpy(p->Caids(), Lists.caids, nc * sizeof(int));
+     }
+  DeleteChannelPids(pids);
+  pids = p;
+}
+
+void cChannel::SetEditablePids(const int *Apids, const int *Dpids, const int *Spids, int Ca)
+{
+  tChannelPidLists Lists;
+  GetPidLists(Lists);
+  for (int i = 0; i < 2; i++) {
+      Lists.apids[i] = Apids[i];
+      Lists.dpids[i] = Dpids[i];
+      Lists.spids[i] = Spids[i];
+      }
+  // a pid that has been set to 0 in the menu terminates its list:
+  Lists.apids[IntListLength(Lists.apids, MAXAPIDS)] = 0;
+  Lists.dpids[IntListLength(Lists.dpids, MAXDPIDS)] = 0;
+  Lists.spids[IntListLength(Lists.spids, MAXSPIDS)] = 0;
+  Lists.caids[0] = Ca;
+  if (!Ca)
+     Lists.caids[1] = 0;
+  SetPidLists(Lists);
+}
+
+const int *cChannel::Apids(void) const { return pids->Apids(); }
+const int *cChannel::Dpids(void) const { return pids->Dpids(); }
+const int *cChannel::Spids(void) const { return pids->Spids(); }
+const int *cChannel::Caids(void) const { return pids->Caids(); }
+int cChannel::Apid(int i) const { return (0 <= i && i < pids->numApids) ? pids->Apids()[i] : 0; }
+int cChannel::Dpid(int i) const { return (0 <= i && i < pids->numDpids) ? pids->Dpids()[i] : 0; }
+int cChannel::Spid(int i) const { return (0 <= i && i < pids->numSpids) ? pids->Spids()[i] : 0; }
+const char *cChannel::Alang(int i) const { return (0 <= i && i < pids->numApids) ? pids->Alangs()[i] : ""; }
+const char *cChannel::Dlang(int i) const { return (0 <= i && i < pids->numDpids) ? pids->Dlangs()[i] : ""; }
+const char *cChannel::Slang(int i) const { return (0 <= i && i < pids->numSpids) ? pids->Slangs()[i] : ""; }
+int cChannel::Atype(int i) const { return (0 <= i && i < pids->numApids) ? pids->Atypes()[i] : 0; }
+int cChannel::Dtype(int i) const { return (0 <= i && i < pids->numDpids) ? pids->Dtypes()[i] : 0; }
+uchar cChannel::SubtitlingType(int i) const { return (0 <= i && i < pids->numSpids) ? pids->SubtitlingTypes()[i] : uchar(0); }
+uint16_t cChannel::CompositionPageId(int i) const { return (0 <= i && i < pids->numSpids) ? pids->CompositionPageIds()[i] : uint16_t(0); }
+uint16_t cChannel::AncillaryPageId(int i) const { return (0 <= i && i < pids->numSpids) ? pids->AncillaryPageIds()[i] : uint16_t(0); }
+int cChannel::Ca(int Index) const { return (0 <= Index && Index < pids->numCaids) ? pids->Caids()[Index] : 0; }
+
 void cChannel::UpdateNameSource(void)
 {
   if (Setup.ShowChannelNamesWithSource == 0) {
@@ -205,12 +406,17 @@ bool cChannel::SetTransponderData(int Source, int Frequency, int Srate, const ch
 
   if (source != Source || frequency != Frequency || srate != Srate || strcmp(parameters, Parameters)) {
      cString OldTransponderData = TransponderDataToString();
+     cChannels *Channels = hashedIn;
+     if (Channels)
+        Channels->UnhashChannel(this); // the channel id may depend on the transponder
      source = Source;
      frequency = Frequency;
      transponder = 0;
      srate = Srate;
      parameters = Parameters;
      schedule = NULL;
+     if (Channels)
+        Channels->HashChannel(this);
      UpdateNameSource();
      if (Number() && !Quiet) {
         dsyslog("changing transponder data of channel %d (%s) from %s to %s", Number(), name, *OldTransponderData, *TransponderDataToString());
@@ -228,7 +434,12 @@ bool cChannel::SetSource(int Source)
         dsyslog("changing source of channel %d (%s) from %s to %s", Number(), name, *cSource::ToString(source), *cSource::ToString(Source));
         modification |= CHANNELMOD_TRANSP;
         }
+     cChannels *Channels = hashedIn;
+     if (Channels)
+        Channels->UnhashChannel(this);
      source = Source;
+     if (Channels)
+        Channels->HashChannel(this);
      return true;
      }
   return false;
@@ -240,8 +451,11 @@ bool cChannel::SetId(cChannels *Channels, int Nid, int Tid, int Sid, int Rid)
      if (Channels && Number()) {
         dsyslog("changing id of channel %d (%s) from %d-%d-%d-%d to %d-%d-%d-%d", Number(), name, nid, tid, sid, rid, Nid, Tid, Sid, Rid);
         modification |= CHANNELMOD_ID;
-        Channels->UnhashChannel(this);
         }
+     if (!Channels)
+        Channels = hashedIn;
+     if (Channels)
+        Channels->UnhashChannel(this);
      nid = Nid;
      tid = Tid;
      sid = Sid;
@@ -276,14 +490,9 @@ bool cChannel::SetName(const char *Name, const char *ShortName, const char *Prov
            dsyslog("changing name of channel %d from '%s,%s;%s' to '%s,%s;%s'", Number(), name, shortName, provider, Name, ShortName, Provider);
            modification |= CHANNELMOD_NAME;
            }
-        if (nn)
-           name = strcpyrealloc(name, Name);
-        if (ns)
-           shortName = strcpyrealloc(shortName, ShortName);
+        SetNames(Name, ShortName, Provider, portalName);
         if (nn || ns)
            UpdateNameSource();
-        if (np)
-           provider = strcpyrealloc(provider, Provider);
         return true;
         }
      }
@@ -297,7 +506,7 @@ bool cChannel::SetPortalName(const char *PortalName)
         dsyslog("changing portal name of channel %d (%s) from '%s' to '%s'", Number(), name, portalName, PortalName);
         modification |= CHANNELMOD_NAME;
         }
-     portalName = strcpyrealloc(portalName, PortalName);
+     SetNames(name, shortName, provider, PortalName);
      return true;
      }
   return false;
@@ -352,7 +561,7 @@ bool cChannel::SetPids(int Vpid, int Ppid, int Vtype, int *Apids, int *Atypes, c
      mod |= CHANNELMOD_PIDS;
   if (tpid != Tpid)
      mod |= CHANNELMOD_AUX;
-  int m = IntArraysDiffer(apids, Apids, alangs, ALangs) | IntArraysDiffer(atypes, Atypes) | IntArraysDiffer(dpids, Dpids, dlangs, DLangs) | IntArraysDiffer(dtypes, Dtypes) | IntArraysDiffer(spids, Spids, slangs, SLangs);
+  int m = IntArraysDiffer(pids->Apids(), Apids, pids->Alangs(), ALangs) | IntArraysDiffer(pids->Atypes(), Atypes) | IntArraysDiffer(pids->Dpids(), Dpids, pids->Dlangs(), DLangs) | IntArraysDiffer(pids->Dtypes(), Dtypes) | IntArraysDiffer(pids->Spids(), Spids, pids->Slangs(), SLangs);
   if (m & STRDIFF)
      mod |= CHANNELMOD_LANGS;
   if (m & VALDIFF)
@@ -362,10 +571,10 @@ bool cChannel::SetPids(int Vpid, int Ppid, int Vtype, int *Apids, int *Atypes, c
      char OldApidsBuf[BufferSize];
      char NewApidsBuf[BufferSize];
      char *q = OldApidsBuf;
-     q += IntArrayToString(q, apids, 10, alangs, atypes);
-     if (dpids[0]) {
+     q += IntArrayToString(q, pids->Apids(), 10, pids->Alangs(), pids->Atypes());
+     if (pids->numDpids) {
         *q++ = ';';
-        q += IntArrayToString(q, dpids, 10, dlangs, dtypes);
+        q += IntArrayToString(q, pids->Dpids(), 10, pids->Dlangs(), pids->Dtypes());
         }
      *q = 0;
      q = NewApidsBuf;
@@ -379,7 +588,7 @@ bool cChannel::SetPids(int Vpid, int Ppid, int Vtype, int *Apids, int *Atypes, c
      char OldSpidsBuf[SBufferSize];
      char NewSpidsBuf[SBufferSize];
      q = OldSpidsBuf;
-     q += IntArrayToString(q, spids, 10, slangs);
+     q += IntArrayToString(q, pids->Spids(), 10, pids->Slangs());
      *q = 0;
      q = NewSpidsBuf;
      q += IntArrayToString(q, Spids, 10, SLangs);
@@ -389,23 +598,23 @@ bool cChannel::SetPids(int Vpid, int Ppid, int Vtype, int *Apids, int *Atypes, c
      vpid = Vpid;
      ppid = Ppid;
      vtype = Vtype;
+     tChannelPidLists l;
+     GetPidLists(l);
      for (int i = 0; i < MAXAPIDS; i++) {
-         apids[i] = Apids[i];
-         atypes[i] = Atypes[i];
-         strn0cpy(alangs[i], ALangs[i], MAXLANGCODE2);
+         l.apids[i] = Apids[i];
+         l.atypes[i] = Atypes[i];
+         strn0cpy(l.alangs[i], ALangs[i], MAXLANGCODE2);
          }
-     apids[MAXAPIDS] = 0;
      for (int i = 0; i < MAXDPIDS; i++) {
-         dpids[i] = Dpids[i];
-         dtypes[i] = Dtypes[i];
-         strn0cpy(dlangs[i], DLangs[i], MAXLANGCODE2);
+         l.dpids[i] = Dpids[i];
+         l.dtypes[i] = Dtypes[i];
+         strn0cpy(l.dlangs[i], DLangs[i], MAXLANGCODE2);
          }
-     dpids[MAXDPIDS] = 0;
      for (int i = 0; i < MAXSPIDS; i++) {
-         spids[i] = Spids[i];
-         strn0cpy(slangs[i], SLangs[i], MAXLANGCODE2);
+         l.spids[i] = Spids[i];
+         strn0cpy(l.slangs[i], SLangs[i], MAXLANGCODE2);
          }
-     spids[MAXSPIDS] = 0;
+     SetPidLists(l);
      tpid = Tpid;
      modification |= mod;
      return true;
@@ -415,24 +624,23 @@ bool cChannel::SetPids(int Vpid, int Ppid, int Vtype, int *Apids, int *Atypes, c
 
 bool cChannel::SetSubtitlingDescriptors(uchar *SubtitlingTypes, uint16_t *CompositionPageIds, uint16_t *AncillaryPageIds)
 {
+  // Only the entries of the actual subtitle pids are stored, so only those are compared:
+  int n = pids->numSpids;
   bool Modified = false;
-  if (SubtitlingTypes) {
-     for (int i = 0; i < MAXSPIDS; i++) {
-         Modified = subtitlingTypes[i] != SubtitlingTypes[i];
-         subtitlingTypes[i] = SubtitlingTypes[i];
-         }
-     }
-  if (CompositionPageIds) {
-     for (int i = 0; i < MAXSPIDS; i++) {
-         Modified = compositionPageIds[i] != CompositionPageIds[i];
-         compositionPageIds[i] = CompositionPageIds[i];
-         }
-     }
-  if (AncillaryPageIds) {
-     for (int i = 0; i < MAXSPIDS; i++) {
-         Modified = ancillaryPageIds[i] != AncillaryPageIds[i];
-         ancillaryPageIds[i] = AncillaryPageIds[i];
-         }
+  if (SubtitlingTypes && memcmp(pids->SubtitlingTypes(), SubtitlingTypes, n) != 0)
+     Modified = true;
+  if (CompositionPageIds && memcmp(pids->CompositionPageIds(), CompositionPageIds, n * sizeof(uint16_t)) != 0)
+     Modified = true;
+  if (AncillaryPageIds && memcmp(pids->AncillaryPageIds(), AncillaryPageIds, n * sizeof(uint16_t)) != 0)
+     Modified = true;
+  if (Modified) {
+     // the block has exactly the right size, so the entries can be modified in place:
+     if (SubtitlingTypes)
+        memcpy(pids->SubtitlingTypes(), SubtitlingTypes, n);
+     if (CompositionPageIds)
+        memcpy(pids->CompositionPageIds(), CompositionPageIds, n * sizeof(uint16_t));
+     if (AncillaryPageIds)
+        memcpy(pids->AncillaryPageIds(), AncillaryPageIds, n * sizeof(uint16_t));
      }
   return Modified;
 }
@@ -460,6 +668,7 @@ void cChannel::DelLinkChannel(cChannel *LinkChannel)
 
 bool cChannel::SetCaIds(const int *CaIds)
 {
+  const int *caids = pids->Caids();
   if (caids[0] && caids[0] <= CA_USER_MAX)
      return false; // special values will not be overwritten
   if (IntArraysDiffer(caids, CaIds)) {
@@ -469,11 +678,15 @@ bool cChannel::SetCaIds(const int *CaIds)
      IntArrayToString(NewCaIdsBuf, CaIds, 16);
      if (Number())
         dsyslog("changing caids of channel %d (%s) from %s to %s", Number(), name, OldCaIdsBuf, NewCaIdsBuf);
+     tChannelPidLists l;
+     GetPidLists(l);
      for (int i = 0; i <= MAXCAIDS; i++) { // <= to copy the terminating 0
-         caids[i] = CaIds[i];
+         l.caids[i] = CaIds[i];
          if (!CaIds[i])
             break;
          }
+     l.caids[MAXCAIDS] = 0;
+     SetPidLists(l);
      modification |= CHANNELMOD_CA;
      return true;
      }
@@ -585,23 +798,24 @@ cString cChannel::ToText(const cChannel *Channel)
      const int ABufferSize = (MAXAPIDS + MAXDPIDS) * (5 + 1 + MAXLANGCODE2 + 5) + 10; // 5 digits plus delimiting ',' or ';' plus optional '=cod+cod@type', +10: paranoia
      char apidbuf[ABufferSize];
      q = apidbuf;
-     q += IntArrayToString(q, Channel->apids, 10, Channel->alangs, Channel->atypes);
-     if (Channel->dpids[0]) {
+     tChannelPids *p = Channel->pids;
+     q += IntArrayToString(q, p->Apids(), 10, p->Alangs(), p->Atypes());
+     if (p->numDpids) {
         *q++ = ';';
-        q += IntArrayToString(q, Channel->dpids, 10, Channel->dlangs, Channel->dtypes);
+        q += IntArrayToString(q, p->Dpids(), 10, p->Dlangs(), p->Dtypes());
         }
      *q = 0;
      const int TBufferSize = MAXSPIDS * (5 + 1 + MAXLANGCODE2) + 10; // 5 digits plus delimiting ',' or ';' plus optional '=cod+cod', +10: paranoia and tpid
      char tpidbuf[TBufferSize];
      q = tpidbuf;
      q += snprintf(q, sizeof(tpidbuf), "%d", Channel->tpid);
-     if (Channel->spids[0]) {
+     if (p->numSpids) {
         *q++ = ';';
-        q += IntArrayToString(q, Channel->spids, 10, Channel->slangs);
+        q += IntArrayToString(q, p->Spids(), 10, p->Slangs());
         }
      char caidbuf[MAXCAIDS * 5 + 10]; // 5: 4 digits plus delimiting ',', 10: paranoia
      q = caidbuf;
-     q += IntArrayToString(q, Channel->caids, 16);
+     q += IntArrayToString(q, p->Caids(), 16);
      *q = 0;
      buffer = cString::sprintf("%s:%d:%s:%s:%d:%s:%s:%s:%s:%d:%d:%d:%d", FullName, Channel->frequency, *Channel->parameters, *cSource::ToString(Channel->source), Channel->srate, vpidbuf, apidbuf, tpidbuf, caidbuf, Channel->sid, Channel->nid, Channel->tid, Channel->rid);
      }
@@ -627,8 +841,10 @@ bool cChannel::Parse(const char *s)
            s = p;
            }
         }
-     name = strcpyrealloc(name, skipspace(s));
-     strreplace(name, '|', ':');
+     char *namebuf = strdup(skipspace(s));
+     strreplace(namebuf, '|', ':');
+     SetNames(namebuf, shortName, provider, portalName);
+     free(namebuf);
      }
   else {
      groupSep = false;
@@ -641,6 +857,10 @@ bool cChannel::Parse(const char *s)
      char *caidbuf = NULL;
      int fields = sscanf(s, "%m[^:]:%d :%m[^:]:%m[^:] :%d :%m[^:]:%m[^:]:%m[^:]:%m[^:]:%d :%d :%d :%d ", &namebuf, &frequency, &parambuf, &sourcebuf, &srate, &vpidbuf, &apidbuf, &tpidbuf, &caidbuf, &sid, &nid, &tid, &rid);
      if (fields >= 9) {
+        tChannelPidLists l;
+        GetPidLists(l);
+        int *apids = l.apids, *atypes = l.atypes, *dpids = l.dpids, *dtypes = l.dtypes, *spids = l.spids, *caids = l.caids;
+        char (*alangs)[MAXLANGCODE2] = l.alangs, (*dlangs)[MAXLANGCODE2] = l.dlangs, (*slangs)[MAXLANGCODE2] = l.slangs;
         if (fields == 9) {
            // allow reading of old format
            sid = atoi(caidbuf);
@@ -786,19 +1006,22 @@ bool cChannel::Parse(const char *s)
               caids[NumCaIds] = 0;
               }
            }
+        SetPidLists(l);
         strreplace(namebuf, '|', ':');
 
+        const char *Provider = provider;
+        const char *ShortName = shortName;
         char *p = strchr(namebuf, ';');
         if (p) {
            *p++ = 0;
-           provider = strcpyrealloc(provider, p);
+           Provider = p;
            }
         p = strrchr(namebuf, ','); // long name might contain a ',', so search for the rightmost one
         if (p) {
            *p++ = 0;
-           shortName = strcpyrealloc(shortName, p);
+           ShortName = p;
            }
-        name = strcpyrealloc(name, namebuf);
+        SetNames(namebuf, ShortName, Provider, portalName);
 
         free(parambuf);
         free(sourcebuf);
@@ -851,6 +1074,8 @@ cChannels::cChannels(void)
 :cConfig<cChannel>("2 Channels")
 {
   modifiedByUser = 0;
+  snapshotUsers = 0;
+  SetSaveInBackground(true);
 }
 
 const cChannels *cChannels::GetChannelsRead(cStateKey &StateKey, int TimeoutMs)
@@ -882,25 +1107,441 @@ void cChannels::DeleteDuplicateChannels(void)
         }
 }
 
+// The binary cache of the channels file contains the raw data of all channels,
+// which can be read considerably faster than parsing the text file. It is only
+// used if the channels file has the same modification time and size as when the
+// cache was written, and if its checksum is correct. Since it contains the raw
+// data of cChannel, it may only be read by the same version of VDR that has
+// written it.
+
+#define CHANNELSCACHEMAGIC   0x43484356 // 'VCHC'
+#define CHANNELSCACHEVERSION 2
+
+struct tChannelsCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t dataSize; // size of the data block of a cChannel
+  uint32_t numChannels;
+  int64_t mtime;     // modification time of the channels file
+  int64_t size;      // size of the channels file
+  };
+
+static cString ChannelsCacheFileName(const char *FileName)
+{
+  return cString::sprintf("%s.bin", FileName);
+}
+
+static void PutCacheString(FILE *f, const char *s, uint32_t &Crc)
+{
+  uint32_t Length = s ? strlen(s) : 0;
+  fwrite(&Length, sizeof(Length), 1, f);
+  fwrite(s, 1, Length, f);
+  Crc = SI::CRC32::crc32((const char *)&Length, sizeof(Length), Crc);
+  Crc = SI::CRC32::crc32(s, Length, Crc);
+}
+
+// The data block of a channel consists mostly of zeros (unused pids, parameters etc.),
+// so it is stored as a sequence of (number of zeros, number of literal bytes,
+// literal bytes) with 16 bit counts.
+
+static void PutCacheData(FILE *f, const uchar *Data, int Length, uint32_t &Crc)
+{
+  const uchar *End = Data + Length;
+  while (Data < End) {
+        const uchar *p = Data;
+        while (p < End && !*p && p - Data < 0xFFFF)
+              p++;
+        uint16_t Counts[2] = { uint16_t(p - Data), 0 };
+        Data = p;
+        while (p < End && (*p || (p + 1 < End && p[1])) && p - Data < 0xFFFF)
+              p++; // isolated zeros are stored as literals
+        Counts[1] = uint16_t(p - Data);
+        fwrite(Counts, sizeof(Counts), 1, f);
+        fwrite(Data, 1, Counts[1], f);
+        Crc = SI::CRC32::crc32((const char *)Counts, sizeof(Counts), Crc);
+        Crc = SI::CRC32::crc32((const char *)Data, Counts[1], Crc);
+        Data = p;
+        }
+}
+
+static bool GetCacheData(const uchar *&p, const uchar *End, uchar *Data, int Length)
+{
+  uchar *DataEnd = Data + Length;
+  while (Data < DataEnd) {
+        uint16_t Counts[2];
+        if (End - p < int(sizeof(Counts)))
+           return false;
+        memcpy(Counts, p, sizeof(Counts));
+        p += sizeof(Counts);
+        if (DataEnd - Data < Counts[0] + Counts[1] || End - p < Counts[1])
+           return false;
+        memset(Data, 0, Counts[0]);
+        Data += Counts[0];
+        memcpy(Data, p, Counts[1]);
+        Data += Counts[1];
+        p += Counts[1];
+        }
+  return true;
+}
+
+// The pids are stored as the header of their block, followed by the rest of the
+// block, the size of which follows from the counts in the header.
+
+static void PutCachePids(FILE *f, tChannelPids *Pids, uint32_t &Crc)
+{
+  fwrite(Pids, sizeof(tChannelPids), 1, f);
+  Crc = SI::CRC32::crc32((const char *)Pids, sizeof(tChannelPids), Crc);
+  if (Pids != EmptyPids)
+     PutCacheData(f, (const uchar *)(Pids + 1), Pids->Size() - sizeof(tChannelPids), Crc);
+}
+
+static bool GetCachePids(const uchar *&p, const uchar *End, tChannelPids **Pids)
+{
+  tChannelPids Header;
+  if (End - p < int(sizeof(Header)))
+     return false;
+  memcpy(&Header, p, sizeof(Header));
+  p += sizeof(Header);
+  if (Header.numApids > MAXAPIDS || Header.numDpids > MAXDPIDS || Header.numSpids > MAXSPIDS || Header.numCaids > MAXCAIDS)
+     return false;
+  tChannelPids *Result = NewChannelPids(Header.numApids, Header.numDpids, Header.numSpids, Header.numCaids);
+  if (Result != EmptyPids && !GetCacheData(p, End, (uchar *)(Result + 1), Result->Size() - sizeof(tChannelPids))) {
+     DeleteChannelPids(Result);
+     return false;
+     }
+  DeleteChannelPids(*Pids);
+  *Pids = Result;
+  return true;
+}
+
+static bool GetCacheString(const uchar *&p, const uchar *End, char **s)
+{
+  uint32_t Length;
+  if (End - p < int(sizeof(Length)))
+     return false;
+  memcpy(&Length, p, sizeof(Length));
+  p += sizeof(Length);
+  if (End - p < int64_t(Length))
+     return false;
+  free(*s);
+  *s = strndup((const char *)p, Length);
+  p += Length;
+  return true;
+}
+
+bool cChannels::LoadCache(const char *FileName, bool AllowComments)
+{
+  struct stat sf;
+  if (!FileName || stat(FileName, &sf) != 0)
+     return false;
+  cString CacheFileName = ChannelsCacheFileName(FileName);
+  int fd = open(CacheFileName, O_RDONLY);
+  if (fd < 0)
+     return false;
+  struct stat sc;
+  uchar *Buffer = NULL;
+  ssize_t Size = 0;
+  if (fstat(fd, &sc) == 0 && sc.st_size >= int(sizeof(tChannelsCacheHeader) + sizeof(uint32_t))) {
+     Size = sc.st_size;
+     Buffer = MALLOC(uchar, Size);
+     if (Buffer && safe_read(fd, Buffer, Size) != Size) {
+        free(Buffer);
+        Buffer = NULL;
+        }
+     }
+  close(fd);
+  if (!Buffer)
+     return false;
+  bool result = false;
+  cChannel *Dummy = new cChannel;
+  int DataSize = (char *)&Dummy->__EndData__ - (char *)&Dummy->__BeginData__;
+  delete Dummy;
+  tChannelsCacheHeader Header;
+  memcpy(&Header, Buffer, sizeof(Header));
+  uint32_t Crc;
+  memcpy(&Crc, Buffer + Size - sizeof(Crc), sizeof(Crc));
+  if (Header.magic == CHANNELSCACHEMAGIC && Header.version == CHANNELSCACHEVERSION && Header.dataSize == uint32_t(DataSize) &&
+      Header.mtime == sf.st_mtime && Header.size == sf.st_size &&
+      SI::CRC32::crc32((const char *)Buffer, Size - sizeof(Crc), 0xFFFFFFFF) == Crc) {
+     isyslog("loading %s", *CacheFileName);
+     SetFileName(FileName, AllowComments);
+     const uchar *p = Buffer + sizeof(Header);
+     const uchar *End = Buffer + Size - sizeof(Crc);
+     result = true;
+     for (uint32_t i = 0; i < Header.numChannels; i++) {
+         cChannel *Channel = new cChannel;
+         Add(Channel);
+         if (!GetCacheData(p, End, (uchar *)&Channel->__BeginData__, DataSize)) {
+            result = false;
+            break;
+            }
+         char *s[5] = { NULL };
+         bool ok = GetCachePids(p, End, &Channel->pids);
+         for (int j = 0; ok && j < 5; j++)
+             ok = GetCacheString(p, End, &s[j]);
+         if (ok) {
+            Channel->SetNames(s[0], s[1], s[2], s[3]);
+            Channel->parameters = cString(s[4], true);
+            s[4] = NULL;
+            }
+         for (int j = 0; j < 4; j++)
+             free(s[j]);
+         if (!ok) {
+            free(s[4]);
+            result = false;
+            break;
+            }
+         Channel->UpdateNameSource();
+         }
+     if (!result || p != End) {
+        esyslog("ERROR: invalid channels cache %s", *CacheFileName);
+        SetFileName(FileName, AllowComments); // clears the list
+        result = false;
+        }
+     }
+  else
+     dsyslog("channels cache %s is outdated - ignored", *CacheFileName);
+  free(Buffer);
+  return result;
+}
+
+bool cChannels::WriteCache(FILE *f, int64_t MTime, int64_t Size) const
+{
+  tChannelsCacheHeader Header;
+  memset(&Header, 0, sizeof(Header));
+  Header.magic = CHANNELSCACHEMAGIC;
+  Header.version = CHANNELSCACHEVERSION;
+  Header.numChannels = Count();
+  Header.mtime = MTime;
+  Header.size = Size;
+  int DataSize = 0;
+  if (const cChannel *Channel = First())
+     DataSize = (char *)&Channel->__EndData__ - (char *)&Channel->__BeginData__;
+  Header.dataSize = DataSize;
+  fwrite(&Header, sizeof(Header), 1, f);
+  uint32_t Crc = SI::CRC32::crc32((const char *)&Header, sizeof(Header), 0xFFFFFFFF);
+  for (const cChannel *Channel = First(); Channel; Channel = Next(Channel)) {
+      PutCacheData(f, (const uchar *)&Channel->__BeginData__, DataSize, Crc);
+      PutCachePids(f, Channel->pids, Crc);
+      PutCacheString(f, Channel->name, Crc);
+      PutCacheString(f, Channel->shortName, Crc);
+      PutCacheString(f, Channel->provider, Crc);
+      PutCacheString(f, Channel->portalName, Crc);
+      PutCacheString(f, Channel->parameters, Crc);
+      }
+  fwrite(&Crc, sizeof(Crc), 1, f);
+  return !ferror(f);
+}
+
+void cChannels::SaveCache(void) const
+{
+  if (!FileName())
+     return;
+  struct stat sf;
+  if (stat(FileName(), &sf) != 0)
+     return;
+  cString CacheFileName = ChannelsCacheFileName(FileName());
+  cSafeFile f(CacheFileName);
+  if (f.Open()) {
+     if (!WriteCache(f, sf.st_mtime, sf.st_size)) {
+        LOG_ERROR_STR(*CacheFileName);
+        f.Close();
+        unlink(CacheFileName);
+        }
+     else if (!f.Close())
+        unlink(CacheFileName);
+     }
+}
+
+// --- cChannelsSaveData -----------------------------------------------------
+
+class cChannelsSaveData : public cConfigSaveData {
+private:
+  char *cache;
+  size_t cacheLength;
+protected:
+  virtual void Saved(void) override;
+public:
+  cChannelsSaveData(const char *FileName, char *Data, size_t Length, char *Cache, size_t CacheLength);
+  virtual ~cChannelsSaveData() override;
+  };
+
+cChannelsSaveData::cChannelsSaveData(const char *FileName, char *Data, size_t Length, char *Cache, size_t CacheLength)
+:cConfigSaveData(FileName, Data, Length)
+{
+  cache = Cache;
+  cacheLength = CacheLength;
+}
+
+cChannelsSaveData::~cChannelsSaveData()
+{
+  free(cache);
+}
+
+void cChannelsSaveData::Saved(void)
+{
+  // The cache has to contain the modification time and size of the channels
+  // file, which are only known now that it has been written:
+  tChannelsCacheHeader Header;
+  uint32_t Crc;
+  struct stat sf;
+  if (!cache || cacheLength < sizeof(Header) + sizeof(Crc) || stat(FileName(), &sf) != 0)
+     return;
+  memcpy(&Header, cache, sizeof(Header));
+  Header.mtime = sf.st_mtime;
+  Header.size = sf.st_size;
+  memcpy(cache, &Header, sizeof(Header));
+  Crc = SI::CRC32::crc32(cache, cacheLength - sizeof(Crc), 0xFFFFFFFF);
+  memcpy(cache + cacheLength - sizeof(Crc), &Crc, sizeof(Crc));
+  cString CacheFileName = ChannelsCacheFileName(FileName());
+  cSafeFile f(CacheFileName);
+  if (f.Open()) {
+     if (fwrite(cache, cacheLength, 1, f) != 1) {
+        LOG_ERROR_STR(*CacheFileName);
+        f.Close();
+        unlink(CacheFileName);
+        }
+     else if (!f.Close())
+        unlink(CacheFileName);
+     }
+}
+
+cConfigSaveData *cChannels::SaveData(char *Data, size_t Length) const
+{
+  char *Cache = NULL;
+  size_t CacheLength = 0;
+  if (FILE *f = open_memstream(&Cache, &CacheLength)) {
+     bool Ok = WriteCache(f, 0, 0);
+     if (fclose(f) != 0 || !Ok) {
+        free(Cache); // the cache will simply not be updated
+        Cache = NULL;
+        CacheLength = 0;
+        }
+     }
+  return new cChannelsSaveData(FileName(), Data, Length, Cache, CacheLength);
+}
+
+// --- Channels snapshot -----------------------------------------------------
+
+#define CHANNELSSNAPSHOTTIMEOUT 1 // ms to wait for the channels lock to make a new snapshot
+
+cMutex cChannels::snapshotMutex;
+cMutex cChannels::snapshotBuildMutex;
+cChannels *cChannels::snapshot = NULL;
+cStateKey cChannels::snapshotStateKey;
+bool cChannels::snapshotBuilding = false;
+
+cChannels *cChannels::AcquireSnapshot(void)
+{
+  cMutexLock MutexLock(&snapshotMutex);
+  if (snapshot)
+     snapshot->snapshotUsers++;
+  return snapshot;
+}
+
+void cChannels::ReleaseSnapshot(cChannels *Snapshot)
+{
+  if (Snapshot) {
+     snapshotMutex.Lock();
+     bool Delete = --Snapshot->snapshotUsers == 0;
+     snapshotMutex.Unlock();
+     if (Delete)
+        delete Snapshot;
+     }
+}
+
+cChannels *cChannels::GetSnapshot(void)
+{
+  snapshotMutex.Lock();
+  cChannels *Snapshot = snapshot;
+  if (Snapshot)
+     Snapshot->snapshotUsers++;
+  if (Snapshot && snapshotBuilding) {
+     snapshotMutex.Unlock();
+     return Snapshot; // some other thread is already making a new snapshot
+     }
+  snapshotBuilding = true;
+  snapshotMutex.Unlock();
+  cMutexLock BuildLock(&snapshotBuildMutex); // only waits if there is no snapshot, yet
+  if (const cChannels *Channels = GetChannelsRead(snapshotStateKey, Snapshot ? CHANNELSSNAPSHOTTIMEOUT : 0)) {
+     cChannels *NewSnapshot = new cChannels;
+     for (const cChannel *Channel = Channels->First(); Channel; Channel = Channels->Next(Channel)) {
+         cChannel *c = new cChannel(*Channel);
+         NewSnapshot->Add(c);
+         if (!c->GroupSep())
+            NewSnapshot->HashChannel(c);
+         }
+     snapshotStateKey.Remove(false);
+     NewSnapshot->snapshotUsers = 1; // the reference held by 'snapshot'
+     snapshotMutex.Lock();
+     cChannels *OldSnapshot = snapshot;
+     snapshot = NewSnapshot;
+     snapshotMutex.Unlock();
+     ReleaseSnapshot(OldSnapshot);
+     }
+  snapshotMutex.Lock();
+  snapshotBuilding = false;
+  snapshotMutex.Unlock();
+  ReleaseSnapshot(Snapshot);
+  return AcquireSnapshot();
+}
+
+cChannelsSnapshot::cChannelsSnapshot(void)
+{
+  channels = cChannels::GetSnapshot();
+}
+
+cChannelsSnapshot::~cChannelsSnapshot()
+{
+  cChannels::ReleaseSnapshot(channels);
+}
+
 bool cChannels::Load(const char *FileName, bool AllowComments, bool MustExist)
 {
   LOCK_CHANNELS_WRITE;
+  if (channels.LoadCache(FileName, AllowComments)) {
+     channels.ReNumber();
+     return true;
+     }
   if (channels.cConfig<cChannel>::Load(FileName, AllowComments, MustExist)) {
      channels.DeleteDuplicateChannels();
      channels.ReNumber();
+     channels.SaveCache();
      return true;
      }
   return false;
 }
 
+bool cChannels::Save(void) const
+{
+  // The binary cache is updated by cChannelsSaveData::Saved(), once the
+  // channels file has actually been written:
+  return cConfig<cChannel>::Save();
+}
+
 void cChannels::HashChannel(cChannel *Channel)
 {
-  channelsHashSid.Add(Channel, Channel->Sid());
+  if (Channel->hashedIn)
+     Channel->hashedIn->UnhashChannel(Channel);
+  tChannelID ChannelID = Channel->GetChannelID();
+  channelsHashSid.Add(Channel, ChannelID.Sid());
+  channelsHashId.Add(Channel, ChannelID.Hash());
+  channelsHashIdNoRid.Add(Channel, tChannelID(ChannelID).ClrRid().Hash());
+  channelsHashIdNoPol.Add(Channel, tChannelID(ChannelID).ClrPolarization().Hash());
+  Channel->hashedIn = this;
+  Channel->hashedID = ChannelID;
 }
 
 void cChannels::UnhashChannel(cChannel *Channel)
 {
-  channelsHashSid.Del(Channel, Channel->Sid());
+  if (Channel->hashedIn != this)
+     return;
+  tChannelID ChannelID = Channel->hashedID;
+  channelsHashSid.Del(Channel, ChannelID.Sid());
+  channelsHashId.Del(Channel, ChannelID.Hash());
+  channelsHashIdNoRid.Del(Channel, tChannelID(ChannelID).ClrRid().Hash());
+  channelsHashIdNoPol.Del(Channel, tChannelID(ChannelID).ClrPolarization().Hash());
+  Channel->hashedIn = NULL;
 }
 
 int cChannels::GetNextGroup(int Idx) const
@@ -938,9 +1579,13 @@ int cChannels::GetPrevNormal(int Idx) const
 void cChannels::ReNumber(void)
 {
   channelsHashSid.Clear();
+  channelsHashId.Clear();
+  channelsHashIdNoRid.Clear();
+  channelsHashIdNoPol.Clear();
   maxNumber = 0;
   int Number = 1;
   for (cChannel *Channel = First(); Channel; Channel = Next(Channel)) {
+      Channel->hashedIn = NULL;
       if (Channel->GroupSep()) {
          if (Channel->Number() > Number)
             Number = Channel->Number();
@@ -997,43 +1642,35 @@ const cChannel *cChannels::GetByNumber(int Number, int SkipGap) const
 
 const cChannel *cChannels::GetByServiceID(int Source, int Transponder, unsigned short ServiceID) const
 {
-  cList<cHashObject> *list = channelsHashSid.GetList(ServiceID);
-  if (list) {
-     for (cHashObject *hobj = list->First(); hobj; hobj = list->Next(hobj)) {
-         cChannel *Channel = (cChannel *)hobj->Object();
-         if (Channel->Sid() == ServiceID && Channel->Source() == Source && ISTRANSPONDER(Channel->Transponder(), Transponder))
-            return Channel;
-         }
-     }
+  for (cChannel *Channel = channelsHashSid.Get(ServiceID); Channel; Channel = channelsHashSid.GetNext(ServiceID, Channel)) {
+      if (Channel->Sid() == ServiceID && Channel->Source() == Source && ISTRANSPONDER(Channel->Transponder(), Transponder))
+         return Channel;
+      }
   return NULL;
 }
 
 const cChannel *cChannels::GetByChannelID(tChannelID ChannelID, bool TryWithoutRid, bool TryWithoutPolarization) const
 {
-  int sid = ChannelID.Sid();
-  cList<cHashObject> *list = channelsHashSid.GetList(sid);
-  if (list) {
-     for (cHashObject *hobj = list->First(); hobj; hobj = list->Next(hobj)) {
-         cChannel *Channel = (cChannel *)hobj->Object();
-         if (Channel->Sid() == sid && Channel->GetChannelID() == ChannelID)
+  unsigned int Hash = ChannelID.Hash();
+  for (cChannel *Channel = channelsHashId.Get(Hash); Channel; Channel = channelsHashId.GetNext(Hash, Channel)) {
+      if (Channel->GetChannelID() == ChannelID)
+         return Channel;
+      }
+  if (TryWithoutRid) {
+     ChannelID.ClrRid();
+     Hash = ChannelID.Hash();
+     for (cChannel *Channel = channelsHashIdNoRid.Get(Hash); Channel; Channel = channelsHashIdNoRid.GetNext(Hash, Channel)) {
+         if (Channel->GetChannelID().ClrRid() == ChannelID)
+            return Channel;
+         }
+     }
+  if (TryWithoutPolarization) {
+     ChannelID.ClrPolarization();
+     Hash = ChannelID.Hash();
+     for (cChannel *Channel = channelsHashIdNoPol.Get(Hash); Channel; Channel = channelsHashIdNoPol.GetNext(Hash, Channel)) {
+         if (Channel->GetChannelID().ClrPolarization() == ChannelID)
             return Channel;
          }
-     if (TryWithoutRid) {
-        ChannelID.ClrRid();
-        for (cHashObject *hobj = list->First(); hobj; hobj = list->Next(hobj)) {
-            cChannel *Channel = (cChannel *)hobj->Object();
-            if (Channel->Sid() == sid && Channel->GetChannelID().ClrRid() == ChannelID)
-               return Channel;
-            }
-        }
-     if (TryWithoutPolarization) {
-        ChannelID.ClrPolarization();
-        for (cHashObject *hobj = list->First(); hobj; hobj = list->Next(hobj)) {
-            cChannel *Channel = (cChannel *)hobj->Object();
-            if (Channel->Sid() == sid && Channel->GetChannelID().ClrPolarization() == ChannelID)
-               return Channel;
-            }
-        }
      }
   return NULL;
 }
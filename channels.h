@@ -58,6 +58,7 @@ public:
   bool Valid(void) const { return (nid || tid) && sid; } // rid is optional and source may be 0//XXX source may not be 0???
   tChannelID &ClrRid(void) { rid = 0; return *this; }
   tChannelID &ClrPolarization(void);
+  unsigned int Hash(void) const { return (((source * 31u + nid) * 31u + tid) * 31u + sid) * 31u + rid; }
   int Source(void)  const { return source; }
   int Nid(void)  const { return nid; }
   int Tid(void)  const { return tid; }
@@ -83,18 +84,23 @@ class cLinkChannels : public cList<cLinkChannel> {
 
 class cSchedule;
 class cChannels;
+struct tChannelPids;
+struct tChannelPidLists;
 
 class cChannel : public cListObject {
+  friend class cChannels;
   friend class cSchedules;
   friend class cMenuEditChannel;
   friend class cMenuSetupMisc;
   friend class cDvbSourceParam;
 private:
   static cString ToText(const cChannel *Channel);
-  char *name;
-  char *shortName;
-  char *provider;
-  char *portalName;
+  char *names; // name, short name, provider and portal name, one after the other
+  const char *name;
+  const char *shortName;
+  const char *provider;
+  const char *portalName;
+  tChannelPids *pids; // the audio, dolby and subtitle pids, their languages and types, and the CA ids
   int __BeginData__;
   int frequency; // MHz
   mutable int transponder; // cached value
@@ -103,19 +109,7 @@ private:
   int vpid;
   int ppid;
   int vtype;
-  int apids[MAXAPIDS + 1]; // list is zero-terminated
-  int atypes[MAXAPIDS + 1]; // list is zero-terminated
-  char alangs[MAXAPIDS][MAXLANGCODE2];
-  int dpids[MAXDPIDS + 1]; // list is zero-terminated
-  int dtypes[MAXDPIDS + 1]; // list is zero-terminated
-  char dlangs[MAXDPIDS][MAXLANGCODE2];
-  int spids[MAXSPIDS + 1]; // list is zero-terminated
-  char slangs[MAXSPIDS][MAXLANGCODE2];
-  uchar subtitlingTypes[MAXSPIDS];
-  uint16_t compositionPageIds[MAXSPIDS];
-  uint16_t ancillaryPageIds[MAXSPIDS];
   int tpid;
-  int caids[MAXCAIDS + 1]; // list is zero-terminated
   int nid;
   int tid;
   int sid;
@@ -132,8 +126,19 @@ private:
   mutable const cSchedule *schedule;
   cLinkChannels *linkChannels;
   cChannel *refChannel;
+  cChannels *hashedIn; // the cChannels this channel has been hashed in (if any)
+  tChannelID hashedID; // the channel id this channel has been hashed with
   cString TransponderDataToString(void) const;
   void UpdateNameSource(void);
+  void SetNames(const char *Name, const char *ShortName, const char *Provider, const char *PortalName);
+  void GetPidLists(tChannelPidLists &Lists) const;
+  void SetPidLists(const tChannelPidLists &Lists);
+       ///< The pids are stored in a compact block that only has room for the pids
+       ///< that are actually used. To modify them, they are expanded into a
+       ///< tChannelPidLists with the full size lists, and then compacted again.
+  void SetEditablePids(const int *Apids, const int *Dpids, const int *Spids, int Ca);
+       ///< Sets the first two audio, dolby and subtitle pids and the first CA id,
+       ///< as edited in cMenuEditChannel.
 public:
   cChannel(void);
   cChannel(const cChannel &Channel);
@@ -154,23 +159,23 @@ public:
   int Vpid(void) const { return vpid; }
   int Ppid(void) const { return ppid; }
   int Vtype(void) const { return vtype; }
-  const int *Apids(void) const { return apids; }
-  const int *Dpids(void) const { return dpids; }
-  const int *Spids(void) const { return spids; }
-  int Apid(int i) const { return (0 <= i && i < MAXAPIDS) ? apids[i] : 0; }
-  int Dpid(int i) const { return (0 <= i && i < MAXDPIDS) ? dpids[i] : 0; }
-  int Spid(int i) const { return (0 <= i && i < MAXSPIDS) ? spids[i] : 0; }
-  const char *Alang(int i) const { return (0 <= i && i < MAXAPIDS) ? alangs[i] : ""; }
-  const char *Dlang(int i) const { return (0 <= i && i < MAXDPIDS) ? dlangs[i] : ""; }
-  const char *Slang(int i) const { return (0 <= i && i < MAXSPIDS) ? slangs[i] : ""; }
-  int Atype(int i) const { return (0 <= i && i < MAXAPIDS) ? atypes[i] : 0; }
-  int Dtype(int i) const { return (0 <= i && i < MAXDPIDS) ? dtypes[i] : 0; }
-  uchar SubtitlingType(int i) const { return (0 <= i && i < MAXSPIDS) ? subtitlingTypes[i] : uchar(0); }
-  uint16_t CompositionPageId(int i) const { return (0 <= i && i < MAXSPIDS) ? compositionPageIds[i] : uint16_t(0); }
-  uint16_t AncillaryPageId(int i) const { return (0 <= i && i < MAXSPIDS) ? ancillaryPageIds[i] : uint16_t(0); }
+  const int *Apids(void) const; ///< list is zero-terminated
+  const int *Dpids(void) const; ///< list is zero-terminated
+  const int *Spids(void) const; ///< list is zero-terminated
+  int Apid(int i) const;
+  int Dpid(int i) const;
+  int Spid(int i) const;
+  const char *Alang(int i) const;
+  const char *Dlang(int i) const;
+  const char *Slang(int i) const;
+  int Atype(int i) const;
+  int Dtype(int i) const;
+  uchar SubtitlingType(int i) const;
+  uint16_t CompositionPageId(int i) const;
+  uint16_t AncillaryPageId(int i) const;
   int Tpid(void) const { return tpid; }
-  const int *Caids(void) const { return caids; }
-  int Ca(int Index = 0) const { return Index < MAXCAIDS ? caids[Index] : 0; }
+  const int *Caids(void) const; ///< list is zero-terminated
+  int Ca(int Index = 0) const;
   int Nid(void) const { return nid; }
   int Tid(void) const { return tid; }
   int Sid(void) const { return sid; }
@@ -209,14 +214,31 @@ public:
   };
 
 class cChannels : public cConfig<cChannel> {
+  friend class cChannelsSnapshot;
 private:
   static cChannels channels;
+  static cMutex snapshotMutex;
+  static cMutex snapshotBuildMutex;
+  static cChannels *snapshot;
+  static cStateKey snapshotStateKey;
+  static bool snapshotBuilding;
+  int snapshotUsers;
   static int maxNumber;
   static int maxChannelNameLength;
   static int maxShortChannelNameLength;
   int modifiedByUser;
   cHash<cChannel> channelsHashSid;
+  cHash<cChannel> channelsHashId;            // full channel id
+  cHash<cChannel> channelsHashIdNoRid;       // channel id without rid
+  cHash<cChannel> channelsHashIdNoPol;       // channel id without polarization
   void DeleteDuplicateChannels(void);
+  bool LoadCache(const char *FileName, bool AllowComments);
+  bool WriteCache(FILE *f, int64_t MTime, int64_t Size) const;
+  void SaveCache(void) const;
+  virtual cConfigSaveData *SaveData(char *Data, size_t Length) const override;
+  static cChannels *AcquireSnapshot(void);
+  static void ReleaseSnapshot(cChannels *Snapshot);
+  static cChannels *GetSnapshot(void);
 public:
   cChannels(void);
   static const cChannels *GetChannelsRead(cStateKey &StateKey, int TimeoutMs = 0);
@@ -226,6 +248,12 @@ public:
       ///< Gets the list of channels for write access.
       ///< See cTimers::GetTimersWrite() for details.
   static bool Load(const char *FileName, bool AllowComments = false, bool MustExist = false);
+      ///< Loads the channels from the given FileName. If there is an up to date
+      ///< binary cache of this file (see SaveCache()), the channels are taken
+      ///< from there, which avoids parsing every line of the file.
+  bool Save(void) const;
+      ///< Saves the channels and updates the binary cache. The files are
+      ///< written in the background by ConfigSaver.
   void HashChannel(cChannel *Channel);
   void UnhashChannel(cChannel *Channel);
   int GetNextGroup(int Idx) const;   ///< Get next channel group
@@ -269,6 +297,30 @@ DEF_LIST_LOCK(Channels);
 #define LOCK_CHANNELS_READ  USE_LIST_LOCK_READ(Channels)
 #define LOCK_CHANNELS_WRITE USE_LIST_LOCK_WRITE(Channels)
 
+// A snapshot of the channels list is a read only copy of it, which can be used
+// by readers that need to access the channels for a longer time, or that don't
+// want to wait while some other thread holds a write lock on the channels:
+
+class cChannelsSnapshot {
+private:
+  cChannels *channels;
+public:
+  cChannelsSnapshot(void);
+       ///< Gets the most recent snapshot of the channels. If the channels have been
+       ///< modified since that snapshot was made, a new one is made, unless another
+       ///< thread currently holds a write lock on the channels, in which case the
+       ///< previous snapshot is used. So this only waits for the channels lock if
+       ///< there is no snapshot at all, yet.
+       ///< The snapshot never changes and remains valid as long as this object
+       ///< exists, without holding any lock. Note, though, that the channels in a
+       ///< snapshot are copies, which must never be used with the actual channels
+       ///< list, and that they contain no link or reference channels.
+  ~cChannelsSnapshot();
+  const cChannels *Channels(void) const { return channels; }
+  };
+
+#define USE_CHANNELS_SNAPSHOT cChannelsSnapshot ChannelsSnapshot; const cChannels *Channels = ChannelsSnapshot.Channels();
+
 cString ChannelString(const cChannel *Channel, int Number);
 
 #endif //__CHANNELS_H
@@ -635,6 +635,7 @@ public:
   virtual ~cCiTransportConnection();
   void SetTsPostProcessor(cCiSession *CiSession);
   bool TsPostProcess(uint8_t *TsPacket);
+  bool TsPostProcess(uint8_t *Data, int Count);
   cCamSlot *CamSlot(void) { return camSlot; }
   uint8_t Tcid(void) const { return tcid; }
   void CreateConnection(void) { createConnectionRequested = true; }
@@ -642,6 +643,7 @@ public:
   const char *GetCamName(void);
   bool Ready(void);
   bool HasUserIO(void) { return hasUserIO; }
+  bool Busy(void);
   void SendData(int Length, const uint8_t *Data);
   bool Process(cTPDU *TPDU = NULL);
   cCiSession *GetSessionByResourceId(uint32_t ResourceId);
@@ -1121,6 +1123,7 @@ public:
   const int *GetCaSystemIds(void) { return caSystemIds; }
   void SendPMT(cCiCaPmt *CaPmt);
   bool RepliesToQuery(void) { return repliesToQuery; }
+  virtual bool Busy(void) override { return state < 4; }
   bool Ready(void) { return state >= 4; }
   bool ReceivedReply(void) { return state >= 5; }
   bool CanDecrypt(void) { return state == 6; }
@@ -1402,16 +1405,23 @@ void cCiDateTime::Process(int Length, const uint8_t *Data)
 #define AI_CANCEL  0x00
 #define AI_ANSWER  0x01
 
+#define CAM_RESPONSE_DELAY 100 // ms to wait before automatically responding to a CAM menu
+
 class cCiMMI : public cCiSession {
 private:
   char *GetText(int &Length, const uint8_t **Data);
   cCiMenu *menu, *fetchedMenu;
   cCiEnquiry *enquiry, *fetchedEnquiry;
+  int responseAction;
+  int responseSelect;
+  cTimeMs responseTimer;
+  void SendResponse(void);
 public:
   cCiMMI(uint16_t SessionId, cCiTransportConnection *Tc);
   virtual ~cCiMMI() override;
   virtual void Process(int Length = 0, const uint8_t *Data = NULL) override;
   virtual bool HasUserIO(void) { return menu || enquiry; }
+  virtual bool Busy(void) override { return responseAction != CRA_NONE; }
   cCiMenu *Menu(bool Clear = false);
   cCiEnquiry *Enquiry(bool Clear = false);
   void SendMenuAnswer(uint8_t Selection);
@@ -1425,6 +1435,8 @@ cCiMMI::cCiMMI(uint16_t SessionId, cCiTransportConnection *Tc)
   dbgprotocol("Slot %d: new MMI (session id %d)\n", CamSlot()->SlotNumber(), SessionId);
   menu = fetchedMenu = NULL;
   enquiry = fetchedEnquiry = NULL;
+  responseAction = CRA_NONE;
+  responseSelect = -1;
 }
 
 cCiMMI::~cCiMMI()
@@ -1516,19 +1528,10 @@ void cCiMMI::Process(int Length, const uint8_t *Data)
                if (Action != CRA_NONE) {
                   delete menu;
                   menu = NULL;
-                  cCondWait::SleepMs(100);
-                  if (Action == CRA_DISCARD) {
-                     SendCloseMMI();
-                     dsyslog("CAM %d: DISCARD", CamSlot()->SlotNumber());
-                     }
-                  else if (Action == CRA_CONFIRM) {
-                     SendMenuAnswer(1);
-                     dsyslog("CAM %d: CONFIRM", CamSlot()->SlotNumber());
-                     }
-                  else if (Action == CRA_SELECT) {
-                     SendMenuAnswer(Select + 1);
-                     dsyslog("CAM %d: SELECT %d", CamSlot()->SlotNumber(), Select + 1);
-                     }
+                  // the response is sent by a later call to Process(), without blocking the CI adapter in the meantime:
+                  responseAction = Action;
+                  responseSelect = Select;
+                  responseTimer.Set(CAM_RESPONSE_DELAY);
                   }
                }
             }
@@ -1580,6 +1583,26 @@ void cCiMMI::Process(int Length, const uint8_t *Data)
        default: esyslog("ERROR: CAM %d: MMI: unknown tag %06X", CamSlot()->SlotNumber(), Tag);
        }
      }
+  else if (responseAction != CRA_NONE && responseTimer.TimedOut())
+     SendResponse();
+}
+
+void cCiMMI::SendResponse(void)
+{
+  int Action = responseAction;
+  responseAction = CRA_NONE;
+  if (Action == CRA_DISCARD) {
+     SendCloseMMI();
+     dsyslog("CAM %d: DISCARD", CamSlot()->SlotNumber());
+     }
+  else if (Action == CRA_CONFIRM) {
+     SendMenuAnswer(1);
+     dsyslog("CAM %d: CONFIRM", CamSlot()->SlotNumber());
+     }
+  else if (Action == CRA_SELECT) {
+     SendMenuAnswer(responseSelect + 1);
+     dsyslog("CAM %d: SELECT %d", CamSlot()->SlotNumber(), responseSelect + 1);
+     }
 }
 
 cCiMenu *cCiMMI::Menu(bool Clear)
@@ -1842,6 +1865,30 @@ bool cCiTransportConnection::TsPostProcess(uint8_t *TsPacket)
   return false;
 }
 
+bool cCiTransportConnection::TsPostProcess(uint8_t *Data, int Count)
+{
+  cMutexLock MutexLock(&mutex);
+  bool Modified = false;
+  if (tsPostProcessor) {
+     for (int i = 0; i + TS_SIZE <= Count; i += TS_SIZE) {
+         if (tsPostProcessor->TsPostProcess(Data + i))
+            Modified = true;
+         }
+     }
+  return Modified;
+}
+
+bool cCiTransportConnection::Busy(void)
+{
+  if (createConnectionRequested || deleteConnectionRequested || state == stCREATION || state == stDELETION)
+     return true;
+  for (int i = 1; i <= MAX_SESSIONS_PER_TC; i++) {
+      if (sessions[i] && sessions[i]->Busy())
+         return true;
+      }
+  return false;
+}
+
 bool cCiTransportConnection::Ready(void)
 {
   cCiConditionalAccessSupport *cas = (cCiConditionalAccessSupport *)GetSessionByResourceId(RI_CONDITIONAL_ACCESS_SUPPORT);
@@ -2117,6 +2164,7 @@ cCiAdapter::cCiAdapter(void)
 {
   for (int i = 0; i < MAX_CAM_SLOTS_PER_ADAPTER; i++)
       camSlots[i] = NULL;
+  readTimeout = CAM_READ_TIMEOUT;
 }
 
 cCiAdapter::~cCiAdapter()
@@ -2156,6 +2204,7 @@ void cCiAdapter::Action(void)
   cTPDU TPDU;
   while (Running()) {
         int n = Read(TPDU.Buffer(), TPDU.MaxSize());
+        bool Busy = n > 0;
         if (n > 0 && TPDU.Slot() < MAX_CAM_SLOTS_PER_ADAPTER) {
            TPDU.SetSize(n);
            cCamSlot *cs = camSlots[TPDU.Slot()];
@@ -2164,9 +2213,15 @@ void cCiAdapter::Action(void)
               cs->Process(&TPDU);
            }
         for (int i = 0; i < MAX_CAM_SLOTS_PER_ADAPTER; i++) {
-            if (camSlots[i])
+            if (camSlots[i]) {
                camSlots[i]->Process();
+               if (camSlots[i]->Busy())
+                  Busy = true;
+               }
             }
+        // Replies from the CAMs wake up Read() anyway, so while nothing is
+        // going on there is no need to come back here every CAM_READ_TIMEOUT:
+        readTimeout = Busy ? CAM_READ_TIMEOUT : min(readTimeout * 2, CAM_IDLE_TIMEOUT);
         }
 }
 
@@ -2357,6 +2412,18 @@ void cCamSlot::Process(cTPDU *TPDU)
   processed.Broadcast();
 }
 
+bool cCamSlot::Busy(void)
+{
+  cMutexLock MutexLock(&mutex);
+  if (resendPmt && (mtdHandler || caProgramList.Count()))
+     return true;
+  for (int i = 1; i <= MAX_CONNECTIONS_PER_CAM_SLOT; i++) {
+      if (tc[i] && tc[i]->Busy())
+         return true;
+      }
+  return false;
+}
+
 cCiSession *cCamSlot::GetSessionByResourceId(uint32_t ResourceId)
 {
   cMutexLock MutexLock(&mutex);
@@ -2817,11 +2884,23 @@ uchar *cCamSlot::Decrypt(uchar *Data, int &Count)
   return Data;
 }
 
+uchar *cCamSlot::Decrypt(uchar *Data, int &Count, int &Length)
+{
+  Data = Decrypt(Data, Count);
+  Length = Data ? TS_SIZE : 0;
+  return Data;
+}
+
 bool cCamSlot::TsPostProcess(uchar *Data)
 {
   return tc[1] ? tc[1]->TsPostProcess(Data) : false;
 }
 
+bool cCamSlot::TsPostProcess(uchar *Data, int Count)
+{
+  return tc[1] ? tc[1]->TsPostProcess(Data, Count) : false;
+}
+
 bool cCamSlot::Inject(uchar *Data, int Count)
 {
   return true;
@@ -2869,6 +2948,7 @@ bool cCamSlots::WaitForAllCamSlotsReady(int Timeout)
 // --- cChannelCamRelation ---------------------------------------------------
 
 #define CAM_CHECKED_TIMEOUT  15 // seconds before a CAM that has been checked for a particular channel will be checked again
+#define CAM_DECRYPT_TIMEOUT  (30 * SECSINDAY) // seconds after which a CAM that hasn't decrypted a particular channel is no longer assumed to decrypt it
 
 class cChannelCamRelation : public cListObject {
 private:
@@ -2876,10 +2956,13 @@ private:
   uint32_t camSlotsChecked;
   uint32_t camSlotsDecrypt;
   time_t lastChecked;
+  time_t lastDecrypt;
 public:
   cChannelCamRelation(tChannelID ChannelID);
   bool TimedOut(void);
   tChannelID ChannelID(void) { return channelID; }
+  time_t LastDecrypt(void) { return lastDecrypt; }
+  void SetLastDecrypt(time_t LastDecrypt) { lastDecrypt = LastDecrypt; }
   bool CamChecked(int CamSlotNumber);
   bool CamDecrypt(int CamSlotNumber);
   void SetChecked(int CamSlotNumber);
@@ -2894,10 +2977,13 @@ cChannelCamRelation::cChannelCamRelation(tChannelID ChannelID)
   camSlotsChecked = 0;
   camSlotsDecrypt = 0;
   lastChecked = 0;
+  lastDecrypt = 0;
 }
 
 bool cChannelCamRelation::TimedOut(void)
 {
+  if (camSlotsDecrypt && time(NULL) - lastDecrypt > CAM_DECRYPT_TIMEOUT)
+     camSlotsDecrypt = 0;
   return !camSlotsDecrypt && time(NULL) - lastChecked > CAM_CHECKED_TIMEOUT;
 }
 
@@ -2912,6 +2998,8 @@ bool cChannelCamRelation::CamChecked(int CamSlotNumber)
 
 bool cChannelCamRelation::CamDecrypt(int CamSlotNumber)
 {
+  if (camSlotsDecrypt && time(NULL) - lastDecrypt > CAM_DECRYPT_TIMEOUT)
+     camSlotsDecrypt = 0;
   return camSlotsDecrypt & (1 << (CamSlotNumber - 1));
 }
 
@@ -2925,6 +3013,7 @@ void cChannelCamRelation::SetChecked(int CamSlotNumber)
 void cChannelCamRelation::SetDecrypt(int CamSlotNumber)
 {
   camSlotsDecrypt |= (1 << (CamSlotNumber - 1));
+  lastDecrypt = time(NULL);
   ClrChecked(CamSlotNumber);
 }
 
@@ -2941,7 +3030,6 @@ void cChannelCamRelation::ClrDecrypt(int CamSlotNumber)
 
 // --- cChannelCamRelations --------------------------------------------------
 
-#define MAX_CAM_NUMBER 32
 #define CHANNEL_CAM_RELATIONS_CLEANUP_INTERVAL 3600 // seconds between cleanups
 
 cChannelCamRelations ChannelCamRelations;
@@ -2988,10 +3076,19 @@ cChannelCamRelation *cChannelCamRelations::AddEntry(tChannelID ChannelID)
 void cChannelCamRelations::Reset(int CamSlotNumber)
 {
   cMutexLock MutexLock(&mutex);
-  for (cChannelCamRelation *ccr = First(); ccr; ccr = Next(ccr)) {
+  for (cChannelCamRelation *ccr = First(); ccr; ccr = Next(ccr))
       ccr->ClrChecked(CamSlotNumber);
-      ccr->ClrDecrypt(CamSlotNumber);
-      }
+}
+
+void cChannelCamRelations::AddCaids(int CamSlotNumber, const int *Caids)
+{
+  if (CamSlotNumber >= 1 && CamSlotNumber <= MAX_CAM_NUMBER) {
+     cVector<int> &c = decryptedCaids[CamSlotNumber - 1];
+     for ( ; *Caids; Caids++) {
+         if (*Caids >= CA_ENCRYPTED_MIN && c.IndexOf(*Caids) < 0)
+            c.Append(*Caids);
+         }
+     }
 }
 
 bool cChannelCamRelations::CamChecked(tChannelID ChannelID, int CamSlotNumber)
@@ -3008,6 +3105,27 @@ bool cChannelCamRelations::CamDecrypt(tChannelID ChannelID, int CamSlotNumber)
   return ccr ? ccr->CamDecrypt(CamSlotNumber) : false;
 }
 
+bool cChannelCamRelations::CamPredicted(const cChannel *Channel, int CamSlotNumber)
+{
+  cMutexLock MutexLock(&mutex);
+  if (cChannelCamRelation *ccr = GetEntry(Channel->GetChannelID())) {
+     if (ccr->CamDecrypt(CamSlotNumber)) {
+        AddCaids(CamSlotNumber, Channel->Caids());
+        return true;
+        }
+     if (ccr->CamChecked(CamSlotNumber))
+        return false;
+     }
+  if (CamSlotNumber >= 1 && CamSlotNumber <= MAX_CAM_NUMBER) {
+     cVector<int> &c = decryptedCaids[CamSlotNumber - 1];
+     for (const int *Caids = Channel->Caids(); *Caids; Caids++) {
+         if (c.IndexOf(*Caids) >= 0)
+            return true;
+         }
+     }
+  return false;
+}
+
 void cChannelCamRelations::SetChecked(tChannelID ChannelID, int CamSlotNumber)
 {
   cMutexLock MutexLock(&mutex);
@@ -3042,7 +3160,6 @@ void cChannelCamRelations::ClrDecrypt(tChannelID ChannelID, int CamSlotNumber)
 
 void cChannelCamRelations::Load(const char *FileName)
 {
-  cMutexLock MutexLock(&mutex);
   fileName = FileName;
   if (access(fileName, R_OK) == 0) {
      dsyslog("loading %s", *fileName);
@@ -3057,17 +3174,37 @@ void cChannelCamRelations::Load(const char *FileName)
                     if (ChannelID.Valid()) {
                        char *q;
                        char *strtok_next;
+                       time_t LastDecrypt = 0;
                        while ((q = strtok_r(p, " ", &strtok_next)) != NULL) {
-                             int CamSlotNumber = atoi(q);
-                             if (CamSlotNumber >= 1 && CamSlotNumber <= MAX_CAM_NUMBER)
-                                SetDecrypt(ChannelID, CamSlotNumber);
+                             if (*q == '@')
+                                LastDecrypt = strtol(q + 1, NULL, 10);
+                             else {
+                                int CamSlotNumber = atoi(q);
+                                if (CamSlotNumber >= 1 && CamSlotNumber <= MAX_CAM_NUMBER)
+                                   SetDecrypt(ChannelID, CamSlotNumber);
+                                }
                              p = NULL;
                              }
+                       if (LastDecrypt) {
+                          if (cChannelCamRelation *ccr = GetEntry(ChannelID))
+                             ccr->SetLastDecrypt(LastDecrypt);
+                          }
                        }
                     }
                  }
               }
         fclose(f);
+        // Learn which CA system ids the CAMs are known to decrypt:
+        LOCK_CHANNELS_READ; // must be locked before our own mutex, as in cDevice::GetDevice()
+        cMutexLock MutexLock(&mutex);
+        for (cChannelCamRelation *ccr = First(); ccr; ccr = Next(ccr)) {
+            if (const cChannel *Channel = Channels->GetByChannelID(ccr->ChannelID())) {
+               for (int i = 1; i <= MAX_CAM_NUMBER; i++) {
+                   if (ccr->CamDecrypt(i))
+                      AddCaids(i, Channel->Caids());
+                   }
+               }
+            }
         }
      else
         LOG_ERROR_STR(*fileName);
@@ -3097,7 +3234,7 @@ void cChannelCamRelations::Save(void)
                    s = cString::sprintf("%s%s%d", *s ? *s : "", *s ? " " : "", i);
                 }
             if (*s)
-               fprintf(f, "%s %s\n", *ccr->ChannelID().ToString(), *s);
+               fprintf(f, "%s %s @%jd\n", *ccr->ChannelID().ToString(), *s, intmax_t(ccr->LastDecrypt()));
             }
          }
      f.Close();
@@ -20,6 +20,7 @@
 #define MAX_CAM_SLOTS_PER_ADAPTER    16 // maximum possible value is 255 (same value as MAXDEVICES!)
 #define MAX_CONNECTIONS_PER_CAM_SLOT  8 // maximum possible value is 254
 #define CAM_READ_TIMEOUT  50 // ms
+#define CAM_IDLE_TIMEOUT 200 // ms
 
 class cCiTransportConnection;
 class cCamSlot;
@@ -53,6 +54,9 @@ public:
   uint32_t ResourceId(void) { return resourceId; }
   cCamSlot *CamSlot(void);
   virtual bool HasUserIO(void) { return false; }
+  virtual bool Busy(void) { return false; }
+       ///< Returns true if this session expects to do something in the near
+       ///< future, so that the CI adapter shall call Process() more often.
   virtual void Process(int Length = 0, const uint8_t *Data = NULL);
   virtual bool TsPostProcess(uint8_t *TsPacket) { return false; }
        ///< If this cCiSession needs to do additional processing on TS packets (after
@@ -173,9 +177,14 @@ class cCiAdapter : public cThread {
   friend class cCamSlot;
 private:
   cCamSlot *camSlots[MAX_CAM_SLOTS_PER_ADAPTER];
+  int readTimeout;
   void AddCamSlot(cCamSlot *CamSlot);
        ///< Adds the given CamSlot to this CI adapter.
 protected:
+  int ReadTimeout(void) const { return readTimeout; }
+       ///< Returns the time (in ms) Read() shall wait for data. This is
+       ///< CAM_READ_TIMEOUT while there is activity on any of the CAM slots,
+       ///< and grows up to CAM_IDLE_TIMEOUT while they are idle.
   cCamSlot *ItCamSlot(int &Iter);
        ///< Iterates over all added CAM slots of this adapter. Iter has to be
        ///< initialized to 0 and is required to store the iteration state.
@@ -186,7 +195,8 @@ protected:
        ///< actually start CAM handling.
   virtual int Read(uint8_t *Buffer, int MaxLength) { return 0; }
        ///< Reads one chunk of data into the given Buffer, up to MaxLength bytes.
-       ///< If no data is available immediately, wait for up to CAM_READ_TIMEOUT.
+       ///< If no data is available immediately, wait for up to ReadTimeout() ms
+       ///< (a derived class may also use the fixed CAM_READ_TIMEOUT).
        ///< Returns the number of bytes read (in case of an error it will also
        ///< return 0).
   virtual void Write(const uint8_t *Buffer, int Length) {}
@@ -258,6 +268,9 @@ private:
   void NewConnection(void);
   void DeleteAllConnections(void);
   void Process(cTPDU *TPDU = NULL);
+  bool Busy(void);
+       ///< Returns true if this CAM slot expects to do something in the near
+       ///< future (like creating a connection or sending a CA PMT).
   void Write(cTPDU *TPDU);
   cCiSession *GetSessionByResourceId(uint32_t ResourceId);
   void MtdActivate(bool On);
@@ -470,12 +483,27 @@ public:
        ///< A derived class that implements this function will also need
        ///< to set the WantsTsData parameter in the call to the base class
        ///< constructor to true in order to receive the TS data.
+  virtual uchar *Decrypt(uchar *Data, int &Count, int &Length);
+       ///< Same as Decrypt(Data, Count), but may deliver more than one decrypted
+       ///< TS packet at a time. Data and Count are handled as described above,
+       ///< and Length is set to the number of bytes of decrypted TS data (a
+       ///< multiple of TS_SIZE) at the returned pointer. These bytes are only
+       ///< valid until the next call to Decrypt().
+       ///< The default implementation calls Decrypt(Data, Count) and returns a
+       ///< single TS packet, so a derived class only needs to reimplement this
+       ///< function if it can actually handle several TS packets in one go.
   virtual bool TsPostProcess(uchar *Data);
        ///< If there is a cCiSession that needs to do additional processing on TS packets
        ///< (after the CAM has done the decryption), this function will call its
        ///< TsPostProcess() function to have it do whatever operations are necessary on
        ///< the given TsPacket.
        ///< Returns true if the TsPacket was in any way modified.
+  virtual bool TsPostProcess(uchar *Data, int Count);
+       ///< Same as TsPostProcess(Data), but for Count bytes of TS packets, which
+       ///< avoids calling TsPostProcess() for each individual TS packet.
+       ///< Returns true if any of the TS packets was in any way modified.
+       ///< A derived class that reimplements TsPostProcess(Data) must also
+       ///< reimplement this function.
   virtual bool Inject(uchar *Data, int Count);
        ///< Sends all Count bytes of the given Data to the CAM, and returns true
        ///< if this was possible. If the data can't be sent to the CAM completely,
@@ -507,19 +535,30 @@ extern cCamSlots CamSlots;
 
 class cChannelCamRelation;
 
+#define MAX_CAM_NUMBER 32
+
 class cChannelCamRelations : public cList<cChannelCamRelation> {
 private:
   cMutex mutex;
   cString fileName;
+  cVector<int> decryptedCaids[MAX_CAM_NUMBER]; // the CA system ids of channels the CAMs are known to decrypt
   cChannelCamRelation *GetEntry(tChannelID ChannelID);
   cChannelCamRelation *AddEntry(tChannelID ChannelID);
   time_t lastCleanup;
   void Cleanup(void);
+  void AddCaids(int CamSlotNumber, const int *Caids);
 public:
   cChannelCamRelations(void);
   void Reset(int CamSlotNumber);
+       ///< Clears the information which channels the CAM in the given slot
+       ///< has been checked for. The information which channels it is known
+       ///< to decrypt is kept, because it's the same smart card after a reset.
   bool CamChecked(tChannelID ChannelID, int CamSlotNumber);
   bool CamDecrypt(tChannelID ChannelID, int CamSlotNumber);
+  bool CamPredicted(const cChannel *Channel, int CamSlotNumber);
+       ///< Returns true if the CAM in the given slot is known to decrypt the
+       ///< given Channel, or if it hasn't been checked for this Channel, yet,
+       ///< but is known to decrypt other channels with the same CA system ids.
   void SetChecked(tChannelID ChannelID, int CamSlotNumber);
   void SetDecrypt(tChannelID ChannelID, int CamSlotNumber);
   void ClrChecked(tChannelID ChannelID, int CamSlotNumber);
@@ -9,7 +9,11 @@
 
 #include "config.h"
 #include <ctype.h>
+#include <fnmatch.h>
+#include <pthread.h>
 #include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include "device.h"
 #include "i18n.h"
 #include "interface.h"
@@ -64,6 +68,148 @@ bool cSVDRPhost::Accepts(in_addr_t Address)
   return (Address & mask) == (addr.s_addr & mask);
 }
 
+// --- cThreadProfile --------------------------------------------------------
+
+#define IOPRIO_CLASS_SHIFT  13
+
+cThreadProfile::cThreadProfile(void)
+{
+  pattern = NULL;
+  CPU_ZERO(&cpus);
+  hasCpus = false;
+  policy = -1;
+  schedPriority = 0;
+  nice = 0;
+  hasNice = false;
+  ioClass = -1;
+  ioPriority = 0;
+}
+
+cThreadProfile::~cThreadProfile()
+{
+  free(pattern);
+}
+
+static bool ParseCpuList(const char *s, cpu_set_t *Cpus)
+{
+  CPU_ZERO(Cpus);
+  while (*s) {
+        char *t;
+        int First = strtol(s, &t, 10);
+        if (t == s || First < 0)
+           return false;
+        int Last = First;
+        s = t;
+        if (*s == '-') {
+           s++;
+           Last = strtol(s, &t, 10);
+           if (t == s || Last < First)
+              return false;
+           s = t;
+           }
+        for (int i = First; i <= Last && i < CPU_SETSIZE; i++)
+            CPU_SET(i, Cpus);
+        if (*s == ',')
+           s++;
+        else if (*s)
+           return false;
+        }
+  return CPU_COUNT(Cpus) > 0;
+}
+
+bool cThreadProfile::Parse(const char *s)
+{
+  const char *p = strchr(s, ':');
+  if (!p)
+     return false;
+  pattern = strdup(cString(s, p));
+  stripspace(pattern);
+  if (!*pattern)
+     return false;
+  char *Settings = strdup(p + 1);
+  bool result = true;
+  char *strtok_next;
+  for (char *q = strtok_r(Settings, " \t", &strtok_next); q && result; q = strtok_r(NULL, " \t", &strtok_next)) {
+      char *v = strchr(q, '=');
+      if (!v) {
+         result = false;
+         break;
+         }
+      *v++ = 0;
+      char *t;
+      if (strcmp(q, "cpus") == 0)
+         result = hasCpus = ParseCpuList(v, &cpus);
+      else if (strcmp(q, "policy") == 0) {
+         if      (strcmp(v, "other") == 0) policy = SCHED_OTHER;
+         else if (strcmp(v, "batch") == 0) policy = SCHED_BATCH;
+         else if (strcmp(v, "idle")  == 0) policy = SCHED_IDLE;
+         else if (strcmp(v, "fifo")  == 0) policy = SCHED_FIFO;
+         else if (strcmp(v, "rr")    == 0) policy = SCHED_RR;
+         else
+            result = false;
+         }
+      else if (strcmp(q, "priority") == 0) {
+         schedPriority = strtol(v, &t, 10);
+         result = *v && !*t && schedPriority >= 0 && schedPriority <= 99;
+         }
+      else if (strcmp(q, "nice") == 0) {
+         nice = strtol(v, &t, 10);
+         result = hasNice = *v && !*t && nice >= -20 && nice <= 19;
+         }
+      else if (strcmp(q, "io") == 0) {
+         if ((t = strchr(v, ',')) != NULL) {
+            *t++ = 0;
+            char *e;
+            ioPriority = strtol(t, &e, 10);
+            if (!*t || *e || ioPriority < 0 || ioPriority > 7)
+               result = false;
+            }
+         if      (strcmp(v, "rt")   == 0) ioClass = 1;
+         else if (strcmp(v, "be")   == 0) ioClass = 2;
+         else if (strcmp(v, "idle") == 0) ioClass = 3;
+         else
+            result = false;
+         }
+      else
+         result = false;
+      }
+  free(Settings);
+  if ((policy == SCHED_FIFO || policy == SCHED_RR) != (schedPriority > 0))
+     result = false; // only the real-time policies have a priority
+  return result;
+}
+
+bool cThreadProfile::Matches(const char *Description) const
+{
+  return fnmatch(pattern, Description, 0) == 0;
+}
+
+void cThreadProfile::Apply(const char *Description) const
+{
+  dsyslog("applying thread profile '%s' to %s thread", pattern, Description);
+  if (hasCpus) {
+     if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0)
+        LOG_ERROR_STR(Description);
+     }
+  if (policy >= 0) {
+     struct sched_param Param;
+     memset(&Param, 0, sizeof(Param));
+     Param.sched_priority = schedPriority;
+     if (int e = pthread_setschedparam(pthread_self(), policy, &Param)) {
+        errno = e;
+        LOG_ERROR_STR(Description);
+        }
+     }
+  if (hasNice) {
+     if (setpriority(PRIO_PROCESS, 0, nice) < 0)
+        LOG_ERROR_STR(Description);
+     }
+  if (ioClass >= 0) {
+     if (syscall(SYS_ioprio_set, 1, 0, (ioPriority & 0xff) | (ioClass << IOPRIO_CLASS_SHIFT)) < 0)
+        LOG_ERROR_STR(Description);
+     }
+}
+
 // --- cSatCableNumbers ------------------------------------------------------
 
 cSatCableNumbers::cSatCableNumbers(int Size, const char *s)
@@ -126,6 +272,105 @@ int cSatCableNumbers::FirstDeviceIndex(int DeviceIndex) const
   return -1;
 }
 
+// --- cConfigSaveData ------------------------------------------------------
+
+cConfigSaveData::cConfigSaveData(const char *FileName, char *Data, size_t Length)
+{
+  fileName = strdup(FileName);
+  data = Data;
+  length = Length;
+}
+
+cConfigSaveData::~cConfigSaveData()
+{
+  free(fileName);
+  free(data);
+}
+
+// --- cConfigSaver ----------------------------------------------------------
+
+cConfigSaver ConfigSaver;
+
+cConfigSaver::cConfigSaver(void)
+:cThread("config saver")
+{
+  writing = 0;
+}
+
+cConfigSaver::~cConfigSaver()
+{
+  Flush();
+  Cancel(-1);
+  mutex.Lock();
+  changed.Broadcast();
+  mutex.Unlock();
+  Cancel(3);
+}
+
+void cConfigSaver::Save(cConfigSaveData *SaveData)
+{
+  cMutexLock MutexLock(&mutex);
+  for (cConfigSaveData *sd = pending.First(); sd; sd = pending.Next(sd)) {
+      if (strcmp(sd->fileName, SaveData->fileName) == 0) {
+         pending.Add(SaveData, sd); // keeps the order in which different files are written
+         pending.Del(sd);
+         return;
+         }
+      }
+  pending.Add(SaveData);
+  changed.Broadcast();
+  if (!Active())
+     Start();
+}
+
+void cConfigSaver::Flush(void)
+{
+  cMutexLock MutexLock(&mutex);
+  while (pending.First() || writing) {
+        if (!Active()) {
+           // the thread is not running (any more), so we write the data ourselves:
+           while (cConfigSaveData *SaveData = pending.First()) {
+                 pending.Del(SaveData, false);
+                 Write(SaveData);
+                 delete SaveData;
+                 }
+           break;
+           }
+        changed.TimedWait(mutex, 100);
+        }
+}
+
+void cConfigSaver::Write(cConfigSaveData *SaveData)
+{
+  cSafeFile f(SaveData->fileName);
+  if (f.Open()) {
+     if (SaveData->length && fwrite(SaveData->data, SaveData->length, 1, f) != 1)
+        LOG_ERROR_STR(SaveData->fileName);
+     if (f.Close())
+        SaveData->Saved();
+     }
+}
+
+void cConfigSaver::Action(void)
+{
+  mutex.Lock();
+  while (Running()) {
+        if (cConfigSaveData *SaveData = pending.First()) {
+           pending.Del(SaveData, false);
+           writing++;
+           mutex.Unlock();
+           Write(SaveData);
+           delete SaveData;
+           mutex.Lock();
+           writing--;
+           changed.Broadcast();
+           }
+        else
+           changed.Wait(mutex);
+        }
+  mutex.Unlock();
+}
+
 // --- cNestedItem -----------------------------------------------------------
 
 cNestedItem::cNestedItem(const char *Text, bool WithSubItems)
@@ -301,6 +546,20 @@ bool cSVDRPhosts::Acceptable(in_addr_t Address)
   return false;
 }
 
+// --- cThreadProfiles -------------------------------------------------------
+
+cThreadProfiles ThreadProfiles;
+
+void cThreadProfiles::Apply(const char *Description) const
+{
+  for (const cThreadProfile *p = First(); p; p = Next(p)) {
+      if (p->Matches(Description)) {
+         p->Apply(Description);
+         break;
+         }
+      }
+}
+
 // --- cSetupLine ------------------------------------------------------------
 
 cSetupLine::cSetupLine(void)
@@ -413,21 +672,25 @@ cSetup::cSetup(void)
   EPGPauseAfterScan = 0;
   EPGBugfixLevel = 3;
   EPGLinger = 0;
+  EPGSearchIndex = 0;
   SVDRPTimeout = 300;
   SVDRPPeering = 0;
   strn0cpy(SVDRPHostName, GetHostName(), sizeof(SVDRPHostName));
   strcpy(SVDRPDefaultHost, "");
   ZapTimeout = 3;
   ChannelEntryTimeout = 1000;
+  ZapAhead = 0;
   RcRepeatDelay = 300;
   RcRepeatDelta = 100;
   DeleteRetention = DEFRETENTIONTIME;
+  RemoveStepSize = 256;
   DefaultPriority = 50;
   DefaultLifetime = MAXLIFETIME;
   RecordKeyHandling = 2;
   PauseKeyHandling = 2;
   PausePriority = 10;
   PauseLifetime = 1;
+  PauseBufferSize = 0;
   UseSubtitle = 1;
   UseVps = 0;
   VpsMargin = 120;
@@ -444,6 +707,8 @@ cSetup::cSetup(void)
   VideoDisplayFormat = 1;
   VideoFormat = 0;
   UpdateChannels = 5;
+  SectionFilters = 0;
+  SignalStatsInterval = 500;
   UseDolbyDigital = 1;
   ChannelInfoPos = 0;
   ChannelInfoTime = 5;
@@ -471,6 +736,11 @@ cSetup::cSetup(void)
   MaxVideoFileSize = MAXVIDEOFILESIZEDEFAULT;
   SplitEditedFiles = 0;
   DelTimeshiftRec = 0;
+  UseIoUring = 0;
+  UseDirectIo = 0;
+  PreallocateMB = 0;
+  JobsPerDisk = 1;
+  JobBandwidth = 0;
   MinEventTimeout = 30;
   MinUserInactivity = 300;
   NextWakeupTime = 0;
@@ -500,6 +770,7 @@ cSetup::cSetup(void)
   ChannelsWrap = 0;
   ShowChannelNamesWithSource = 0;
   EmergencyExit = 1;
+  MemoryBudget = 0;
 }
 
 cSetup& cSetup::operator= (const cSetup &s)
@@ -644,21 +915,25 @@ bool cSetup::Parse(const char *Name, const char *Value)
   else if (!strcasecmp(Name, "EPGPauseAfterScan"))   EPGPauseAfterScan  = atoi(Value);
   else if (!strcasecmp(Name, "EPGBugfixLevel"))      EPGBugfixLevel     = atoi(Value);
   else if (!strcasecmp(Name, "EPGLinger"))           EPGLinger          = atoi(Value);
+  else if (!strcasecmp(Name, "EPGSearchIndex"))      EPGSearchIndex     = atoi(Value);
   else if (!strcasecmp(Name, "SVDRPTimeout"))        SVDRPTimeout       = atoi(Value);
   else if (!strcasecmp(Name, "SVDRPPeering"))        SVDRPPeering       = atoi(Value);
   else if (!strcasecmp(Name, "SVDRPHostName"))     { if (*Value) strn0cpy(SVDRPHostName, Value, sizeof(SVDRPHostName)); }
   else if (!strcasecmp(Name, "SVDRPDefaultHost"))    strn0cpy(SVDRPDefaultHost, Value, sizeof(SVDRPDefaultHost));
   else if (!strcasecmp(Name, "ZapTimeout"))          ZapTimeout         = atoi(Value);
   else if (!strcasecmp(Name, "ChannelEntryTimeout")) ChannelEntryTimeout= atoi(Value);
+  else if (!strcasecmp(Name, "ZapAhead"))            ZapAhead           = atoi(Value);
   else if (!strcasecmp(Name, "RcRepeatDelay"))       RcRepeatDelay      = atoi(Value);
   else if (!strcasecmp(Name, "RcRepeatDelta"))       RcRepeatDelta      = atoi(Value);
   else if (!strcasecmp(Name, "DeleteRetention"))     DeleteRetention    = atoi(Value);
+  else if (!strcasecmp(Name, "RemoveStepSize"))      RemoveStepSize     = atoi(Value);
   else if (!strcasecmp(Name, "DefaultPriority"))     DefaultPriority    = atoi(Value);
   else if (!strcasecmp(Name, "DefaultLifetime"))     DefaultLifetime    = atoi(Value);
   else if (!strcasecmp(Name, "RecordKeyHandling"))   RecordKeyHandling  = atoi(Value);
   else if (!strcasecmp(Name, "PauseKeyHandling"))    PauseKeyHandling   = atoi(Value);
   else if (!strcasecmp(Name, "PausePriority"))       PausePriority      = atoi(Value);
   else if (!strcasecmp(Name, "PauseLifetime"))       PauseLifetime      = atoi(Value);
+  else if (!strcasecmp(Name, "PauseBufferSize"))     PauseBufferSize    = atoi(Value);
   else if (!strcasecmp(Name, "UseSubtitle"))         UseSubtitle        = atoi(Value);
   else if (!strcasecmp(Name, "UseVps"))              UseVps             = atoi(Value);
   else if (!strcasecmp(Name, "VpsMargin"))           VpsMargin          = atoi(Value);
@@ -675,6 +950,8 @@ bool cSetup::Parse(const char *Name, const char *Value)
   else if (!strcasecmp(Name, "VideoDisplayFormat"))  VideoDisplayFormat = atoi(Value);
   else if (!strcasecmp(Name, "VideoFormat"))         VideoFormat        = atoi(Value);
   else if (!strcasecmp(Name, "UpdateChannels"))      UpdateChannels     = atoi(Value);
+  else if (!strcasecmp(Name, "SectionFilters"))      SectionFilters     = atoi(Value);
+  else if (!strcasecmp(Name, "SignalStatsInterval")) SignalStatsInterval= atoi(Value);
   else if (!strcasecmp(Name, "UseDolbyDigital"))     UseDolbyDigital    = atoi(Value);
   else if (!strcasecmp(Name, "ChannelInfoPos"))      ChannelInfoPos     = atoi(Value);
   else if (!strcasecmp(Name, "ChannelInfoTime"))     ChannelInfoTime    = atoi(Value);
@@ -702,6 +979,11 @@ bool cSetup::Parse(const char *Name, const char *Value)
   else if (!strcasecmp(Name, "MaxVideoFileSize"))    MaxVideoFileSize   = atoi(Value);
   else if (!strcasecmp(Name, "SplitEditedFiles"))    SplitEditedFiles   = atoi(Value);
   else if (!strcasecmp(Name, "DelTimeshiftRec"))     DelTimeshiftRec    = atoi(Value);
+  else if (!strcasecmp(Name, "UseIoUring"))          UseIoUring         = atoi(Value);
+  else if (!strcasecmp(Name, "UseDirectIo"))         UseDirectIo        = atoi(Value);
+  else if (!strcasecmp(Name, "PreallocateMB"))       PreallocateMB      = atoi(Value);
+  else if (!strcasecmp(Name, "JobsPerDisk"))         JobsPerDisk        = atoi(Value);
+  else if (!strcasecmp(Name, "JobBandwidth"))        JobBandwidth       = atoi(Value);
   else if (!strcasecmp(Name, "MinEventTimeout"))     MinEventTimeout    = atoi(Value);
   else if (!strcasecmp(Name, "MinUserInactivity"))   MinUserInactivity  = atoi(Value);
   else if (!strcasecmp(Name, "NextWakeupTime"))      NextWakeupTime     = atoi(Value);
@@ -731,6 +1013,7 @@ bool cSetup::Parse(const char *Name, const char *Value)
   else if (!strcasecmp(Name, "ChannelsWrap"))        ChannelsWrap       = atoi(Value);
   else if (!strcasecmp(Name, "ShowChannelNamesWithSource")) ShowChannelNamesWithSource = atoi(Value);
   else if (!strcasecmp(Name, "EmergencyExit"))       EmergencyExit      = atoi(Value);
+  else if (!strcasecmp(Name, "MemoryBudget"))        MemoryBudget       = atoi(Value);
   else if (!strcasecmp(Name, "LastReplayed"))        cReplayControl::SetRecording(Value);
   else
      return false;
@@ -779,21 +1062,25 @@ bool cSetup::Save(void)
   Store("EPGPauseAfterScan",  EPGPauseAfterScan);
   Store("EPGBugfixLevel",     EPGBugfixLevel);
   Store("EPGLinger",          EPGLinger);
+  Store("EPGSearchIndex",     EPGSearchIndex);
   Store("SVDRPTimeout",       SVDRPTimeout);
   Store("SVDRPPeering",       SVDRPPeering);
   Store("SVDRPHostName",      strcmp(SVDRPHostName, GetHostName()) ? SVDRPHostName : "");
   Store("SVDRPDefaultHost",   SVDRPDefaultHost);
   Store("ZapTimeout",         ZapTimeout);
   Store("ChannelEntryTimeout",ChannelEntryTimeout);
+  Store("ZapAhead",           ZapAhead);
   Store("RcRepeatDelay",      RcRepeatDelay);
   Store("RcRepeatDelta",      RcRepeatDelta);
   Store("DeleteRetention",    DeleteRetention);
+  Store("RemoveStepSize",     RemoveStepSize);
   Store("DefaultPriority",    DefaultPriority);
   Store("DefaultLifetime",    DefaultLifetime);
   Store("RecordKeyHandling",  RecordKeyHandling);
   Store("PauseKeyHandling",   PauseKeyHandling);
   Store("PausePriority",      PausePriority);
   Store("PauseLifetime",      PauseLifetime);
+  Store("PauseBufferSize",    PauseBufferSize);
   Store("UseSubtitle",        UseSubtitle);
   Store("UseVps",             UseVps);
   Store("VpsMargin",          VpsMargin);
@@ -810,6 +1097,8 @@ bool cSetup::Save(void)
   Store("VideoDisplayFormat", VideoDisplayFormat);
   Store("VideoFormat",        VideoFormat);
   Store("UpdateChannels",     UpdateChannels);
+  Store("SectionFilters",     SectionFilters);
+  Store("SignalStatsInterval",SignalStatsInterval);
   Store("UseDolbyDigital",    UseDolbyDigital);
   Store("ChannelInfoPos",     ChannelInfoPos);
   Store("ChannelInfoTime",    ChannelInfoTime);
@@ -837,6 +1126,11 @@ bool cSetup::Save(void)
   Store("MaxVideoFileSize",   MaxVideoFileSize);
   Store("SplitEditedFiles",   SplitEditedFiles);
   Store("DelTimeshiftRec",    DelTimeshiftRec);
+  Store("UseIoUring",         UseIoUring);
+  Store("UseDirectIo",        UseDirectIo);
+  Store("PreallocateMB",      PreallocateMB);
+  Store("JobsPerDisk",        JobsPerDisk);
+  Store("JobBandwidth",       JobBandwidth);
   Store("MinEventTimeout",    MinEventTimeout);
   Store("MinUserInactivity",  MinUserInactivity);
   Store("NextWakeupTime",     NextWakeupTime);
@@ -866,6 +1160,7 @@ bool cSetup::Save(void)
   Store("ChannelsWrap",       ChannelsWrap);
   Store("ShowChannelNamesWithSource", ShowChannelNamesWithSource);
   Store("EmergencyExit",      EmergencyExit);
+  Store("MemoryBudget",       MemoryBudget);
   Store("LastReplayed",       cReplayControl::LastReplayed());
 
   Sort();
@@ -11,6 +11,7 @@
 #define __CONFIG_H
 
 #include <arpa/inet.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -100,6 +101,25 @@ public:
   bool Accepts(in_addr_t Address);
   };
 
+class cThreadProfile : public cListObject {
+private:
+  char *pattern;
+  cpu_set_t cpus;
+  bool hasCpus;
+  int policy;
+  int schedPriority;
+  int nice;
+  bool hasNice;
+  int ioClass;
+  int ioPriority;
+public:
+  cThreadProfile(void);
+  virtual ~cThreadProfile() override;
+  bool Parse(const char *s);
+  bool Matches(const char *Description) const;
+  void Apply(const char *Description) const;
+  };
+
 class cSatCableNumbers {
 private:
   int size;
@@ -119,20 +139,93 @@ public:
       ///< or if DeviceIndex is out of range, -1 is returned.
   };
 
+// Writing a configuration file may take quite a while on slow media, and it is
+// typically done while the list is locked. So lists that are saved frequently
+// can have cConfig::Save() merely render the contents of the file into memory,
+// and leave the actual writing to cConfigSaver, which does it in a thread of
+// its own. If a file is saved again before its previous contents have been
+// written, only the most recent contents are written.
+
+class cConfigSaveData : public cListObject {
+  friend class cConfigSaver;
+private:
+  char *fileName;
+  char *data;
+  size_t length;
+protected:
+  virtual void Saved(void) {}
+       ///< Is called from the saver's thread after the data has been written
+       ///< successfully.
+public:
+  cConfigSaveData(const char *FileName, char *Data, size_t Length);
+       ///< Creates an object that will write the given Data, which has Length
+       ///< bytes, to the file with the given FileName. Takes ownership of Data,
+       ///< which must have been allocated with malloc().
+  virtual ~cConfigSaveData() override;
+  const char *FileName(void) const { return fileName; }
+  };
+
+class cConfigSaver : public cThread {
+private:
+  cMutex mutex;
+  cCondVar changed;
+  cList<cConfigSaveData> pending;
+  int writing;
+  void Write(cConfigSaveData *SaveData);
+protected:
+  virtual void Action(void) override;
+public:
+  cConfigSaver(void);
+  virtual ~cConfigSaver() override;
+  void Save(cConfigSaveData *SaveData);
+       ///< Queues the given SaveData for writing, replacing any data for the same
+       ///< file that hasn't been written yet. Takes ownership of SaveData.
+  void Flush(void);
+       ///< Waits until all data that has been queued so far has been written.
+  };
+
+extern cConfigSaver ConfigSaver;
+
 template<class T> class cConfig : public cList<T> {
 private:
   char *fileName;
   bool allowComments;
+  bool saveInBackground;
   void Clear(void)
   {
     free(fileName);
     fileName = NULL;
     cList<T>::Clear();
   }
+  bool Write(FILE *f) const
+  {
+    for (T *l = (T *)this->First(); l; l = (T *)l->Next()) {
+        if (!l->Save(f))
+           return false;
+        }
+    return true;
+  }
+protected:
+  void SetFileName(const char *FileName, bool AllowComments)
+  {
+    cConfig<T>::Clear();
+    fileName = FileName ? strdup(FileName) : NULL;
+    allowComments = AllowComments;
+  }
+       ///< Clears this list and sets the file name, without loading anything.
+       ///< This is for derived classes that fill the list by other means.
+  void SetSaveInBackground(bool On) { saveInBackground = On; }
+       ///< If On is true, Save() only renders the file into memory and has
+       ///< ConfigSaver write it.
+  virtual cConfigSaveData *SaveData(char *Data, size_t Length) const { return new cConfigSaveData(fileName, Data, Length); }
+       ///< Returns the object that is handed to ConfigSaver in order to write
+       ///< the given Data. Derived classes can return an object derived from
+       ///< cConfigSaveData if they need to do anything after the file has been
+       ///< written.
 public:
-  cConfig(const char *NeedsLocking = NULL): cList<T>(NeedsLocking) { fileName = NULL; }
+  cConfig(const char *NeedsLocking = NULL): cList<T>(NeedsLocking) { fileName = NULL; allowComments = false; saveInBackground = false; }
   virtual ~cConfig() override { free(fileName); }
-  const char *FileName(void) { return fileName; }
+  const char *FileName(void) const { return fileName; }
   bool Load(const char *FileName = NULL, bool AllowComments = false, bool MustExist = false)
   {
     cConfig<T>::Clear();
@@ -183,16 +276,27 @@ public:
   bool Save(void) const
   {
     bool result = true;
-    T *l = (T *)this->First();
+    if (saveInBackground && fileName) {
+       char *Data = NULL;
+       size_t Length = 0;
+       if (FILE *f = open_memstream(&Data, &Length)) {
+          result = Write(f);
+          if (fclose(f) != 0)
+             result = false;
+          }
+       else
+          result = false;
+       if (result)
+          ConfigSaver.Save(SaveData(Data, Length));
+       else {
+          esyslog("ERROR: can't render %s", fileName);
+          free(Data);
+          }
+       return result;
+       }
     cSafeFile f(fileName);
     if (f.Open()) {
-       while (l) {
-             if (!l->Save(f)) {
-                result = false;
-                break;
-                }
-             l = (T *)l->Next();
-             }
+       result = Write(f);
        if (!f.Close())
           result = false;
        }
@@ -239,7 +343,15 @@ public:
 extern cNestedItemList Folders;
 extern cNestedItemList Commands;
 extern cNestedItemList RecordingCommands;
+class cThreadProfiles : public cConfig<cThreadProfile> {
+public:
+  void Apply(const char *Description) const;
+       ///< Applies the first profile that matches the given thread Description
+       ///< to the calling thread.
+  };
+
 extern cSVDRPhosts SVDRPhosts;
+extern cThreadProfiles ThreadProfiles;
 
 class cSetupLine : public cListObject {
 private:
@@ -309,19 +421,23 @@ public:
   int EPGScanTimeout;
   int EPGBugfixLevel;
   int EPGLinger;
+  int EPGSearchIndex;
   int SVDRPTimeout;
   int SVDRPPeering;
   char SVDRPHostName[HOST_NAME_MAX];
   char SVDRPDefaultHost[HOST_NAME_MAX];
   int ZapTimeout;
   int ChannelEntryTimeout;
+  int ZapAhead;
   int RcRepeatDelay;
   int RcRepeatDelta;
   int DeleteRetention;
+  int RemoveStepSize;
   int DefaultPriority, DefaultLifetime;
   int RecordKeyHandling;
   int PauseKeyHandling;
   int PausePriority, PauseLifetime;
+  int PauseBufferSize;
   int UseSubtitle;
   int UseVps;
   int VpsMargin;
@@ -335,6 +451,8 @@ public:
   int VideoDisplayFormat;
   int VideoFormat;
   int UpdateChannels;
+  int SectionFilters;
+  int SignalStatsInterval;
   int UseDolbyDigital;
   int ChannelInfoPos;
   int ChannelInfoTime;
@@ -356,6 +474,11 @@ public:
   int MaxVideoFileSize;
   int SplitEditedFiles;
   int DelTimeshiftRec;
+  int UseIoUring;
+  int UseDirectIo;
+  int PreallocateMB;
+  int JobsPerDisk;
+  int JobBandwidth;
   int MinEventTimeout, MinUserInactivity;
   time_t NextWakeupTime;
   int MultiSpeedMode;
@@ -382,6 +505,7 @@ public:
   int ChannelsWrap;
   int ShowChannelNamesWithSource;
   int EmergencyExit;
+  int MemoryBudget;
   int __EndData__;
   cString InitialChannel;
   cString DeviceBondings;
@@ -256,6 +256,12 @@ private:
        // payloads that started before Index, or have a PTS that is before lastVidPts,
        // and add them to the end of the given Data.
   bool FixFrame(uchar *Data, int &Length, bool Independent, int Index, bool CutIn, bool CutOut);
+  int CopyFrames(int Index, int EndIndex, int &Errors);
+       // Copies whole GOPs, starting with the independent frame at Index and ending
+       // before EndIndex, directly from the input to the output file, without loading
+       // them into memory. Returns the number of frames copied, which is 0 if there is
+       // no complete GOP to copy at Index, or -1 in case of an error. Errors is
+       // incremented by the number of copied frames that have errors or are missing.
   bool ProcessSequence(int LastEndIndex, int BeginIndex, int EndIndex, int NextBeginIndex);
   void HandleErrors(bool Force = false);
 protected:
@@ -337,7 +343,7 @@ bool cCuttingThread::Throttled(void)
      dsyslog("resuming cutter thread");
      suspensionLogged = false;
      }
-  return false;
+  return cIoBudget::Exhausted();
 }
 
 bool cCuttingThread::LoadFrame(int Index, uchar *Buffer, bool &Independent, int &Length)
@@ -553,6 +559,65 @@ bool cCuttingThread::FixFrame(uchar *Data, int &Length, bool Independent, int In
   return DeletedFrame;
 }
 
+#define MAXCOPYSIZE MEGABYTE(16) // max. number of bytes copied in one go by CopyFrames()
+
+int cCuttingThread::CopyFrames(int Index, int EndIndex, int &Errors)
+{
+  uint16_t FileNumber;
+  off_t FileOffset;
+  bool Independent;
+  int Length;
+  if (!fromIndex->Get(Index, &FileNumber, &FileOffset, &Independent, &Length) || !Independent)
+     return 0;
+  // Determine the complete GOPs that are stored contiguously in the same file:
+  int End = Index;
+  off_t Size = 0;
+  off_t GopsSize = 0;
+  for (int i = Index; i < EndIndex; i++) {
+      uint16_t fn;
+      off_t fo;
+      if (!fromIndex->Get(i, &fn, &fo, &Independent, &Length) || fn != FileNumber || Length <= 0)
+         break;
+      if (Independent && i > Index) {
+         End = i;
+         GopsSize = Size;
+         if (GopsSize >= MAXCOPYSIZE || fileSize + GopsSize > maxVideoFileSize)
+            break; // the next file shall also start with an independent frame
+         }
+      Size += Length;
+      }
+  if (End == Index)
+     return 0;
+  // Every file shall start with an independent frame:
+  if (!SwitchFile())
+     return -1;
+  fromFile = fromFileName->SetOffset(FileNumber, FileOffset);
+  if (!fromFile) {
+     error = "fromFile";
+     return -1;
+     }
+  if (toFile->Copy(fromFile, FileOffset, GopsSize) < 0) {
+     error = "copy";
+     return -1;
+     }
+  // Write index:
+  for (int i = Index; i < End; i++) {
+      bool FrameErrors;
+      bool FrameMissing;
+      off_t Offset;
+      fromIndex->Get(i, &FileNumber, &Offset, &Independent, NULL, &FrameErrors, &FrameMissing);
+      if (!toIndex->Write(Independent, toFileName->Number(), fileSize + Offset - FileOffset, FrameErrors, FrameMissing)) {
+         error = "toIndex";
+         return -1;
+         }
+      Errors += FrameErrors + FrameMissing;
+      }
+  fileSize += GopsSize;
+  cVideoDiskUsage::Written(GopsSize);
+  cIoBudget::Consumed(GopsSize);
+  return End - Index;
+}
+
 bool cCuttingThread::ProcessSequence(int LastEndIndex, int BeginIndex, int EndIndex, int NextBeginIndex)
 {
   // Check for seamless connections:
@@ -566,7 +631,28 @@ bool cCuttingThread::ProcessSequence(int LastEndIndex, int BeginIndex, int EndIn
      }
   cPatPmtParser PatPmtParser;
   cFrameChecker FrameChecker;
+  int CopiedErrors = 0;
   for (int Index = BeginIndex; Running() && Index < EndIndex; Index++) {
+      // Stay within the I/O budget for background jobs:
+      while (cIoBudget::Exhausted() && Running())
+            cCondWait::SleepMs(10);
+      // The frames between the cut-in and cut-out GOPs can be copied as they are, if
+      // they don't need any fixing (which in TS recordings is only the case in the first
+      // sequence, and only if there is no further sequence that would need to continue
+      // the TS continuity counters and timestamps):
+      if (Index > BeginIndex && (isPesRecording || sequence == 1 && NextBeginIndex < 0 && numIFrames >= 2)) {
+         AssertFreeDiskSpace(-1);
+         int Copied = CopyFrames(Index, EndIndex - 1, CopiedErrors);
+         if (Copied < 0)
+            return false;
+         if (Copied > 0) {
+            FrameChecker.Resync();
+            frameErrors = CopiedErrors + FrameChecker.TotalErrors();
+            HandleErrors();
+            Index += Copied - 1;
+            continue;
+            }
+         }
       bool Independent;
       int Length;
       if (LoadFrame(Index, Buffer, Independent, Length)) {
@@ -609,7 +695,7 @@ bool cCuttingThread::ProcessSequence(int LastEndIndex, int BeginIndex, int EndIn
             error = "toIndex";
             return false;
             }
-         frameErrors = FrameChecker.TotalErrors();
+         frameErrors = CopiedErrors + FrameChecker.TotalErrors();
          HandleErrors();
          // Write data:
          if (toFile->Write(Buffer, Length) < 0) {
@@ -617,6 +703,8 @@ bool cCuttingThread::ProcessSequence(int LastEndIndex, int BeginIndex, int EndIn
             return false;
             }
          fileSize += Length;
+         cVideoDiskUsage::Written(Length);
+         cIoBudget::Consumed(Length);
          // Generate marks at the editing points in the edited recording:
          if (numSequences > 1 && Index == BeginIndex) {
             if (toMarks.Count() > 0)
@@ -15,9 +15,11 @@
 #include "audio.h"
 #include "channels.h"
 #include "i18n.h"
+#include "membudget.h"
 #include "player.h"
 #include "receiver.h"
 #include "status.h"
+#include "trace.h"
 #include "transfer.h"
 
 // --- cLiveSubtitle ---------------------------------------------------------
@@ -88,6 +90,7 @@ cDevice::cDevice(void)
   volume = Setup.CurrentVolume;
 
   sectionHandler = NULL;
+  sectionDemux = NULL;
   eitFilter = NULL;
   patFilter = NULL;
   sdtFilter = NULL;
@@ -101,6 +104,7 @@ cDevice::cDevice(void)
 
   player = NULL;
   isPlayingVideo = false;
+  multiPacketPlay = false;
   keepTracks = false; // used in ClrAvailableTracks()!
   ClrAvailableTracks();
   currentAudioTrack = ttNone;
@@ -112,6 +116,10 @@ cDevice::cDevice(void)
 
   for (int i = 0; i < MAXRECEIVERS; i++)
       receiver[i] = NULL;
+  memset(receiverMask, 0, sizeof(receiverMask));
+  memset(lastCc, 0xFF, sizeof(lastCc));
+  tsPackets = 0;
+  continuityErrors = 0;
 
   if (numDevices < MAXDEVICES)
      device[numDevices++] = this;
@@ -128,6 +136,7 @@ cDevice::~cDevice()
   if (this == primaryDevice)
      primaryDevice = NULL;
   Cancel(3);
+  delete sectionDemux;
 }
 
 bool cDevice::WaitForAllDevicesReady(int Timeout)
@@ -274,6 +283,14 @@ cDevice *cDevice::GetDevice(const cChannel *Channel, int Priority, bool LiveView
   cDevice *d = NULL;
   cCamSlot *s = NULL;
 
+  // Whether a device is able to provide the channel doesn't depend on the CAM slot,
+  // so this is determined only once per device (and only if actually needed):
+  int DeviceProvides[numDevices + 1]; // -1 = not yet checked, 0 = no, 1 = yes
+  bool DeviceTuned[numDevices + 1];
+  bool DeviceNdr[numDevices + 1];
+  for (int i = 0; i < numDevices; i++)
+      DeviceProvides[i] = -1;
+
   uint32_t Impact = 0xFFFFFFFF; // we're looking for a device with the least impact
   for (int j = 0; j < NumCamSlots || !NumUsableSlots; j++) {
       if (NumUsableSlots && SlotPriority[j] > MAXPRIORITY)
@@ -286,9 +303,14 @@ cDevice *cDevice::GetDevice(const cChannel *Channel, int Priority, bool LiveView
              continue; // no CAM is able to decrypt this channel and the device uses vdr handled CAMs
           if (NumUsableSlots && !HasInternalCam && !CamSlots.Get(j)->Assign(device[i], true))
              continue; // CAM slot can't be used with this device
-          bool ndr = false;
-          bool TunedToTransponder = device[i]->IsTunedToTransponder(Channel);
-          if (TunedToTransponder || device[i]->ProvidesChannel(Channel, Priority, &ndr)) { // this device is basically able to do the job
+          if (DeviceProvides[i] < 0) {
+             DeviceNdr[i] = false;
+             DeviceTuned[i] = device[i]->IsTunedToTransponder(Channel);
+             DeviceProvides[i] = DeviceTuned[i] || device[i]->ProvidesChannel(Channel, Priority, &DeviceNdr[i]);
+             }
+          bool ndr = DeviceNdr[i];
+          bool TunedToTransponder = DeviceTuned[i];
+          if (DeviceProvides[i]) { // this device is basically able to do the job
              bool OccupiedOtherTransponder = !TunedToTransponder && device[i]->Occupied();
              if (OccupiedOtherTransponder)
                 ndr = true;
@@ -306,16 +328,17 @@ cDevice *cDevice::GetDevice(const cChannel *Channel, int Priority, bool LiveView
              // to their individual severity, where the one listed first will make the most
              // difference, because it results in the most significant bit of the result.
              uint32_t imp = 0;
-             imp <<= 1; imp |= (LiveView && NumUsableSlots && !HasInternalCam) ? !ChannelCamRelations.CamDecrypt(Channel->GetChannelID(), CamSlots.Get(j)->MasterSlotNumber()) || ndr : 0; // prefer CAMs that are known to decrypt this channel for live viewing, if we don't need to detach existing receivers
+             imp <<= 1; imp |= (LiveView && NumUsableSlots && !HasInternalCam) ? !ChannelCamRelations.CamPredicted(Channel, CamSlots.Get(j)->MasterSlotNumber()) || ndr : 0; // prefer CAMs that are known (or predicted) to decrypt this channel for live viewing, if we don't need to detach existing receivers
              imp <<= 1; imp |= LiveView ? !device[i]->IsPrimaryDevice() || ndr : 0;                                  // prefer the primary device for live viewing if we don't need to detach existing receivers
              imp <<= 1; imp |= !(device[i]->Receiving() && (!device[i]->IsPrimaryDevice() || device[i]->Transferring()) && !ndr); // prefer receiving devices if we don't need to detach existing receivers
              imp <<= 1; imp |= ndr;                                                                                  // avoid devices if we need to detach existing receivers
+             imp <<= 1; imp |= LiveView ? !TunedToTransponder : 0;                                                   // prefer devices that are already tuned to the transponder (like by zap ahead) for live viewing
              imp <<= 8; imp |= device[i]->Priority() - IDLEPRIORITY;                                                 // use the device with the lowest priority (- IDLEPRIORITY to assure that values -100..99 can be used)
              imp <<= 8; imp |= ((NumUsableSlots && !HasInternalCam) ? SlotPriority[j] : IDLEPRIORITY) - IDLEPRIORITY;// use the CAM slot with the lowest priority (- IDLEPRIORITY to assure that values -100..99 can be used)
              imp <<= 5; imp |= GetClippedNumProvidedSystems(5, device[i]) - 1;                                       // avoid cards which support multiple delivery systems
              imp <<= 1; imp |= (NumUsableSlots || InternalCamNeeded) ? 0 : device[i]->HasCi();                       // avoid cards with Common Interface for FTA channels
              imp <<= 1; imp |= device[i]->AvoidRecording();                                                          // avoid SD full featured cards
-             imp <<= 1; imp |= (NumUsableSlots && !HasInternalCam) ? !ChannelCamRelations.CamDecrypt(Channel->GetChannelID(), CamSlots.Get(j)->MasterSlotNumber()) : 0; // prefer CAMs that are known to decrypt this channel
+             imp <<= 1; imp |= (NumUsableSlots && !HasInternalCam) ? !ChannelCamRelations.CamPredicted(Channel, CamSlots.Get(j)->MasterSlotNumber()) : 0; // prefer CAMs that are known (or predicted) to decrypt this channel
              imp <<= 1; imp |= device[i]->IsPrimaryDevice();                                                         // avoid the primary device
              if (imp < Impact) {
                 // This device has less impact than any previous one, so we take it.
@@ -474,6 +497,11 @@ uchar *cDevice::GrabImage(int &Size, bool Jpeg, int Quality, int SizeX, int Size
   return NULL;
 }
 
+uchar *cDevice::DecodeImage(const uchar *Data, int Length, int &Size, bool Jpeg, int Quality, int SizeX, int SizeY)
+{
+  return NULL;
+}
+
 bool cDevice::GrabImageFile(const char *FileName, bool Jpeg, int Quality, int SizeX, int SizeY)
 {
   int result = 0;
@@ -668,11 +696,16 @@ void cDevice::DelLivePids(void)
 void cDevice::StartSectionHandler(void)
 {
   if (!sectionHandler) {
+     if (!sectionDemux)
+        sectionDemux = new cSectionDemux; // must exist before any filter is opened, and is only deleted together with the device
      sectionHandler = new cSectionHandler(this);
-     AttachFilter(eitFilter = new cEitFilter);
+     // The EIT and NIT only need to be collected by one device per transponder.
+     // The SDT is needed on every device to verify the transponder, but only
+     // updates the channels when triggered by the NIT.
+     sectionHandler->Attach(eitFilter = new cEitFilter, true);
      AttachFilter(patFilter = new cPatFilter);
      AttachFilter(sdtFilter = new cSdtFilter(patFilter));
-     AttachFilter(nitFilter = new cNitFilter(sdtFilter));
+     sectionHandler->Attach(nitFilter = new cNitFilter(sdtFilter), true);
      }
 }
 
@@ -694,6 +727,16 @@ void cDevice::StopSectionHandler(void)
 
 int cDevice::OpenFilter(u_short Pid, u_char Tid, u_char Mask)
 {
+  if (sectionDemux) {
+     int Handle = sectionDemux->Open(Pid, Tid, Mask);
+     if (Handle >= 0) {
+        if (AddPid(Pid)) {
+           Start(); // the sections come from the TS packets received in Action()
+           return Handle;
+           }
+        sectionDemux->Close(Handle);
+        }
+     }
   return -1;
 }
 
@@ -704,7 +747,14 @@ int cDevice::ReadFilter(int Handle, void *Buffer, size_t Length)
 
 void cDevice::CloseFilter(int Handle)
 {
-  close(Handle);
+  int Pid = sectionDemux ? sectionDemux->Close(Handle) : -1;
+  if (Pid >= 0) {
+     DelPid(Pid);
+     if (!Receiving() && !sectionDemux->Active())
+        Cancel(-1);
+     }
+  else
+     close(Handle);
 }
 
 void cDevice::AttachFilter(cFilter *Filter)
@@ -795,6 +845,11 @@ int cDevice::SignalQuality(void) const
   return -1;
 }
 
+uint64_t cDevice::SignalStatsTime(void) const
+{
+  return 0;
+}
+
 const cChannel *cDevice::GetCurrentlyTunedTransponder(void) const
 {
   return NULL;
@@ -878,6 +933,7 @@ eSetChannelResult cDevice::SetChannel(const cChannel *Channel, bool LiveView)
 {
   cMutexLock MutexLock(&mutexChannel); // to avoid a race between SVDRP CHAN and HasProgramme()
   cStatus::MsgChannelSwitch(this, 0, LiveView);
+  memset(lastCc, 0xFF, sizeof(lastCc)); // the new transponder's counters are unrelated to the old ones
 
   if (LiveView) {
      if (IsPrimaryDevice() && !Replaying() && !Transferring()) { // this is only for FF DVB cards!
@@ -1626,6 +1682,12 @@ int cDevice::PlayTsAudio(const uchar *Data, int Length)
         }
      tsToPesAudio.Reset();
      }
+  // A PES packet that fits into this TS packet is played without copying it:
+  if (const uchar *p = cTsToPes::PesInTs(Data, l)) {
+     tsToPesAudio.Reset(); // drops an incomplete PES packet, just like PutTs() would
+     int w = PlayAudio(p, l, p[3]);
+     return w <= 0 ? w : Length;
+     }
   tsToPesAudio.PutTs(Data, Length);
   return Length;
 }
@@ -1637,8 +1699,13 @@ int cDevice::PlayTsSubtitle(const uchar *Data, int Length)
      if (Replaying() && !Transferring())
         dvbSubtitleConverter->SetVisible(Setup.DisplaySubtitles != SUBTITLES_REWIND);
      }
-  tsToPesSubtitle.PutTs(Data, Length);
   int l;
+  if (const uchar *p = cTsToPes::PesInTs(Data, l)) {
+     tsToPesSubtitle.Reset();
+     dvbSubtitleConverter->Convert(p, l);
+     return Length;
+     }
+  tsToPesSubtitle.PutTs(Data, Length);
   if (const uchar *p = tsToPesSubtitle.GetPes(l)) {
      dvbSubtitleConverter->Convert(p, l);
      tsToPesSubtitle.Reset();
@@ -1646,6 +1713,21 @@ int cDevice::PlayTsSubtitle(const uchar *Data, int Length)
   return Length;
 }
 
+int cDevice::TsRunLength(const uchar *Data, int Length)
+{
+  int l = TS_SIZE;
+  if (multiPacketPlay) {
+     int Pid = TsPid(Data);
+     while (l + TS_SIZE <= Length) {
+           const uchar *p = Data + l;
+           if (p[0] != TS_SYNC_BYTE || TsPid(p) != Pid || !TsHasPayload(p) || TsPayloadOffset(p) >= TS_SIZE)
+              break;
+           l += TS_SIZE;
+           }
+     }
+  return l;
+}
+
 int cDevice::PlayTs(const uchar *Data, int Length, bool VideoOnly)
 {
   int Played = 0;
@@ -1663,6 +1745,7 @@ int cDevice::PlayTs(const uchar *Data, int Length, bool VideoOnly)
            if (int Skipped = TS_SYNC(Data, Length))
               return Played + Skipped;
            int Pid = TsPid(Data);
+           int Count = TS_SIZE; // the number of bytes handled in this turn
            if (TsHasPayload(Data)) { // silently ignore TS packets w/o payload
               int PayloadOffset = TsPayloadOffset(Data);
               if (PayloadOffset < TS_SIZE) {
@@ -1672,25 +1755,28 @@ int cDevice::PlayTs(const uchar *Data, int Length, bool VideoOnly)
                     patPmtParser.ParsePmt(Data, TS_SIZE);
                  else if (Pid == patPmtParser.Vpid()) {
                     isPlayingVideo = true;
-                    int w = PlayTsVideo(Data, TS_SIZE);
+                    int w = PlayTsVideo(Data, TsRunLength(Data, Length));
                     if (w < 0)
                        return Played ? Played : w;
                     if (w == 0)
                        break;
+                    Count = w;
                     }
                  else if (Pid == availableTracks[currentAudioTrack].id) {
                     if (!VideoOnly || HasIBPTrickSpeed()) {
-                       int w = PlayTsAudio(Data, TS_SIZE);
+                       int w = PlayTsAudio(Data, TsRunLength(Data, Length));
                        if (w < 0)
                           return Played ? Played : w;
                        if (w == 0)
                           break;
-                       Audios.PlayTsAudio(Data, TS_SIZE);
+                       Count = w;
+                       for (int i = 0; i < Count; i += TS_SIZE)
+                           Audios.PlayTsAudio(Data + i, TS_SIZE);
                        }
                     }
                  else if (Pid == availableTracks[currentSubtitleTrack].id) {
                     if (!VideoOnly || HasIBPTrickSpeed())
-                       PlayTsSubtitle(Data, TS_SIZE);
+                       PlayTsSubtitle(Data, Count = TsRunLength(Data, Length));
                     }
                  }
               }
@@ -1701,9 +1787,9 @@ int cDevice::PlayTs(const uchar *Data, int Length, bool VideoOnly)
               if (w == 0)
                  break;
               }
-           Played += TS_SIZE;
-           Length -= TS_SIZE;
-           Data += TS_SIZE;
+           Played += Count;
+           Length -= Count;
+           Data += Count;
            }
      }
   return Played;
@@ -1749,60 +1835,104 @@ void cDevice::Action(void)
      while (Running()) {
            // Read data from the DVR device:
            uchar *b = NULL;
-           if (GetTSPacket(b)) {
+           int Count = 0;
+           if (GetTSPackets(b, Count)) {
               if (b) {
-                 // Distribute the packet to all attached receivers:
+                 // Distribute the packets to all attached receivers:
                  Lock();
                  cCamSlot *cs = CamSlot();
                  if (cs)
-                    cs->TsPostProcess(b);
-                 int Pid = TsPid(b);
-                 bool IsScrambled = TsIsScrambled(b);
-                 for (int i = 0; i < MAXRECEIVERS; i++) {
-                     cMutexLock MutexLock(&mutexReceiver);
+                    cs->TsPostProcess(b, Count);
+                 if (sectionDemux)
+                    sectionDemux->Process(b, Count);
+                 cMutexLock MutexLock(&mutexReceiver);
+                 uint16_t Wanted = 0;
+                 for (uchar *p = b; p < b + Count; p += TS_SIZE) {
+                     int Pid = TsPid(p);
+                     Wanted |= receiverMask[Pid];
+                     if (TsHasPayload(p)) {
+                        uchar Cc = TsContinuityCounter(p);
+                        uchar LastCc = lastCc[Pid];
+                        if (LastCc != 0xFF && Cc != ((LastCc + 1) & TS_CONT_CNT_MASK) && Cc != LastCc) // a repeated counter marks a duplicate packet
+                           continuityErrors++;
+                        lastCc[Pid] = Cc;
+                        }
+                     }
+                 tsPackets += Count / TS_SIZE;
+                 VDR_TRACE(device_batch, DeviceNumber(), Count / TS_SIZE, Wanted);
+                 for (int i = 0; Wanted && i < MAXRECEIVERS; i++) {
+                     uint16_t Bit = 1 << i;
+                     if (!(Wanted & Bit))
+                        continue;
+                     Wanted &= ~Bit;
                      cReceiver *Receiver = receiver[i];
-                     if (Receiver && Receiver->WantsPid(Pid)) {
-                        Receiver->Receive(b, TS_SIZE);
-                        // Check whether the TS packet is scrambled:
-                        if (Receiver->startScrambleDetection) {
-                           if (cs) {
-                              int CamSlotNumber = cs->MasterSlotNumber();
-                              if (Receiver->lastScrambledPacket < Receiver->startScrambleDetection)
-                                 Receiver->lastScrambledPacket = Receiver->startScrambleDetection;
-                              time_t Now = time(NULL);
-                              if (IsScrambled) {
-                                 Receiver->lastScrambledPacket = Now;
-                                 if (Now - Receiver->startScrambleDetection > Receiver->scramblingTimeout) {
-                                    if (!cs->IsActivating() || Receiver->Priority() >= LIVEPRIORITY) {
-                                       if (Receiver->ChannelID().Valid()) {
-                                          dsyslog("CAM %d: won't decrypt channel %s, detaching receiver", CamSlotNumber, *Receiver->ChannelID().ToString());
-                                          ChannelCamRelations.SetChecked(Receiver->ChannelID(), CamSlotNumber);
-                                          }
-                                       Detach(Receiver);
+                     if (!Receiver)
+                        continue;
+                     bool Received = false;
+                     bool IsScrambled = false;
+                     uchar *Run = NULL; // start of a run of consecutive packets for a multi packet receiver
+                     for (uchar *p = b; p < b + Count; p += TS_SIZE) {
+                         if (receiverMask[TsPid(p)] & Bit) {
+                            Received = true;
+                            if (TsIsScrambled(p))
+                               IsScrambled = true;
+                            if (!Receiver->multiPacket)
+                               Receiver->Receive(p, TS_SIZE);
+                            else if (!Run)
+                               Run = p;
+                            }
+                         else if (Run) {
+                            Receiver->Receive(Run, p - Run);
+                            Run = NULL;
+                            }
+                         if (receiver[i] != Receiver)
+                            break; // the receiver has detached itself
+                         }
+                     if (Run && receiver[i] == Receiver)
+                        Receiver->Receive(Run, b + Count - Run);
+                     VDR_TRACE(receiver_receive, DeviceNumber(), i, Receiver, Received, IsScrambled);
+                     if (!Received || receiver[i] != Receiver)
+                        continue;
+                     // Check whether the TS packets are scrambled:
+                     if (Receiver->startScrambleDetection) {
+                        if (cs) {
+                           int CamSlotNumber = cs->MasterSlotNumber();
+                           if (Receiver->lastScrambledPacket < Receiver->startScrambleDetection)
+                              Receiver->lastScrambledPacket = Receiver->startScrambleDetection;
+                           time_t Now = time(NULL);
+                           if (IsScrambled) {
+                              Receiver->lastScrambledPacket = Now;
+                              if (Now - Receiver->startScrambleDetection > Receiver->scramblingTimeout) {
+                                 if (!cs->IsActivating() || Receiver->Priority() >= LIVEPRIORITY) {
+                                    if (Receiver->ChannelID().Valid()) {
+                                       dsyslog("CAM %d: won't decrypt channel %s, detaching receiver", CamSlotNumber, *Receiver->ChannelID().ToString());
+                                       ChannelCamRelations.SetChecked(Receiver->ChannelID(), CamSlotNumber);
                                        }
+                                    Detach(Receiver);
+                                    continue;
                                     }
                                  }
-                              else if (Now - Receiver->lastScrambledPacket > TS_SCRAMBLING_TIME_OK) {
-                                 if (Receiver->ChannelID().Valid()) {
-                                    dsyslog("CAM %d: decrypts channel %s", CamSlotNumber, *Receiver->ChannelID().ToString());
-                                    ChannelCamRelations.SetDecrypt(Receiver->ChannelID(), CamSlotNumber);
-                                    }
-                                 Receiver->startScrambleDetection = 0;
+                              }
+                           else if (Now - Receiver->lastScrambledPacket > TS_SCRAMBLING_TIME_OK) {
+                              if (Receiver->ChannelID().Valid()) {
+                                 dsyslog("CAM %d: decrypts channel %s", CamSlotNumber, *Receiver->ChannelID().ToString());
+                                 ChannelCamRelations.SetDecrypt(Receiver->ChannelID(), CamSlotNumber);
                                  }
+                              Receiver->startScrambleDetection = 0;
                               }
                            }
-                        // Inject EIT event to avoid the CAMs parental rating prompt:
-                        if (Receiver->startEitInjection) {
-                           time_t Now = time(NULL);
-                           if (cCamSlot *cs = CamSlot()) {
-                              if (Now != Receiver->lastEitInjection) { // once per second
-                                 cs->InjectEit(Receiver->ChannelID().Sid());
-                                 Receiver->lastEitInjection = Now;
-                                 }
+                        }
+                     // Inject EIT event to avoid the CAMs parental rating prompt:
+                     if (Receiver->startEitInjection) {
+                        time_t Now = time(NULL);
+                        if (cCamSlot *cs = CamSlot()) {
+                           if (Now != Receiver->lastEitInjection) { // once per second
+                              cs->InjectEit(Receiver->ChannelID().Sid());
+                              Receiver->lastEitInjection = Now;
                               }
-                           if (Now - Receiver->startEitInjection > EIT_INJECTION_TIME)
-                              Receiver->startEitInjection = 0;
                            }
+                        if (Now - Receiver->startEitInjection > EIT_INJECTION_TIME)
+                           Receiver->startEitInjection = 0;
                         }
                      }
                  Unlock();
@@ -1829,6 +1959,28 @@ bool cDevice::GetTSPacket(uchar *&Data)
   return false;
 }
 
+bool cDevice::GetTSPackets(uchar *&Data, int &Count)
+{
+  Data = NULL;
+  bool Result = GetTSPacket(Data);
+  Count = Data ? TS_SIZE : 0;
+  return Result;
+}
+
+void cDevice::SetReceiverPid(cReceiver *Receiver, int Pid, bool On)
+{
+  cMutexLock MutexLock(&mutexReceiver);
+  for (int i = 0; i < MAXRECEIVERS; i++) {
+      if (receiver[i] == Receiver) {
+         if (On)
+            receiverMask[Pid & (MAXPID - 1)] |= 1 << i;
+         else
+            receiverMask[Pid & (MAXPID - 1)] &= ~(1 << i);
+         break;
+         }
+      }
+}
+
 bool cDevice::AttachReceiver(cReceiver *Receiver)
 {
   if (!Receiver)
@@ -1857,6 +2009,8 @@ bool cDevice::AttachReceiver(cReceiver *Receiver)
          Receiver->Activate(true);
          Receiver->device = this;
          receiver[i] = Receiver;
+         for (int n = 0; n < Receiver->numPids; n++)
+             receiverMask[Receiver->pids[n] & (MAXPID - 1)] |= 1 << i;
          if (camSlot && Receiver->priority > MINPRIORITY) { // priority check to avoid an infinite loop with the CAM slot's caPidReceiver
             camSlot->StartDecrypting();
             if (camSlot->WantsTsData()) {
@@ -1890,8 +2044,11 @@ void cDevice::Detach(cReceiver *Receiver, bool ReleaseCam)
   bool receiversLeft = false;
   mutexReceiver.Lock();
   for (int i = 0; i < MAXRECEIVERS; i++) {
-      if (receiver[i] == Receiver)
+      if (receiver[i] == Receiver) {
+         for (int n = 0; n < Receiver->numPids; n++)
+             receiverMask[Receiver->pids[n] & (MAXPID - 1)] &= ~(1 << i);
          receiver[i] = NULL;
+         }
       else if (receiver[i])
          receiversLeft = true;
       }
@@ -1909,7 +2066,7 @@ void cDevice::Detach(cReceiver *Receiver, bool ReleaseCam)
            ReleaseCamSlot();
         }
      }
-  if (!receiversLeft)
+  if (!receiversLeft && !(sectionDemux && sectionDemux->Active()))
      Cancel(-1);
 }
 
@@ -1919,7 +2076,7 @@ void cDevice::DetachAll(int Pid)
      cMutexLock MutexLock(&mutexReceiver);
      for (int i = 0; i < MAXRECEIVERS; i++) {
          cReceiver *Receiver = receiver[i];
-         if (Receiver && Receiver->WantsPid(Pid))
+         if (Receiver && (receiverMask[Pid & (MAXPID - 1)] & (1 << i)))
             Detach(Receiver, false);
          }
      ReleaseCamSlot();
@@ -1936,22 +2093,37 @@ void cDevice::DetachAllReceivers(void)
 
 // --- cTSBuffer -------------------------------------------------------------
 
-cTSBuffer::cTSBuffer(int File, int Size, int DeviceNumber)
+cTSBuffer::cTSBuffer(int File, int Size, int DeviceNumber, int NumaNode)
 {
   SetDescription("device %d TS buffer", DeviceNumber);
   f = File;
   deviceNumber = DeviceNumber;
   delivered = 0;
-  ringBuffer = new cRingBufferLinear(Size, TS_SIZE, true, "TS");
+  cString Name = cString::sprintf("TS device %d", DeviceNumber);
+  memory = new cMemoryClient(Name, mpRecording, Size / 4, Size, Size);
+  ringBuffer = new cRingBufferLinear(memory->Size(), TS_SIZE, true, Name);
+  ringBuffer->SetNumaNode(NumaNode);
   ringBuffer->SetTimeouts(100, 100);
+  ringBuffer->SetSpsc();
   ringBuffer->SetIoThrottle();
   Start();
 }
 
+cTSBuffer::cTSBuffer(int File, int DeviceNumber)
+{
+  SetDescription("device %d TS buffer", DeviceNumber);
+  f = File;
+  deviceNumber = DeviceNumber;
+  delivered = 0;
+  memory = NULL;
+  ringBuffer = NULL;
+}
+
 cTSBuffer::~cTSBuffer()
 {
   Cancel(3);
   delete ringBuffer;
+  delete memory;
 }
 
 void cTSBuffer::Action(void)
@@ -1989,12 +2161,7 @@ uchar *cTSBuffer::Get(int *Available, bool CheckAvailable)
   uchar *p = ringBuffer->Get(Count);
   if (p && Count >= TS_SIZE) {
      if (*p != TS_SYNC_BYTE) {
-        for (int i = 1; i < Count; i++) {
-            if (p[i] == TS_SYNC_BYTE) {
-               Count = i;
-               break;
-               }
-            }
+        Count = TsFindSync(p, Count);
         ringBuffer->Del(Count);
         esyslog("ERROR: skipped %d bytes to sync on TS packet on device %d", Count, deviceNumber);
         return NULL;
@@ -29,6 +29,7 @@
 #define MAXDEVICES         16 // the maximum number of devices in the system
 #define MAXPIDHANDLES      64 // the maximum number of different PIDs per device
 #define MAXRECEIVERS       16 // the maximum number of receivers per device
+#define MAXTSBATCH         64 // the maximum number of TS packets distributed to the receivers in one go
 #define MAXVOLUME         255
 #define VOLUMEDELTA       (MAXVOLUME / Setup.VolumeSteps) // used to increase/decrease the volume
 #define MAXOCCUPIEDTIMEOUT 99 // max. time (in seconds) a device may be occupied
@@ -83,6 +84,7 @@ struct tTrackId {
   char description[32];         // something like "Dolby Digital 5.1"
   };
 
+class cMemoryClient;
 class cPlayer;
 class cReceiver;
 class cLiveSubtitle;
@@ -234,6 +236,10 @@ public:
   virtual cString DeviceName(void) const;
          ///< Returns a string identifying the name of this device.
          ///< The default implementation returns an empty string.
+  virtual int NumaNode(void) const { return -1; }
+         ///< Returns the NUMA node this device is attached to, so that the buffers
+         ///< that receive its data can be placed in that node's memory. The default
+         ///< implementation returns -1, which means the node is unknown.
   virtual bool HasDecoder(void) const;
          ///< Tells whether this device has an MPEG decoder.
   virtual bool AvoidRecording(void) const { return false; }
@@ -333,6 +339,14 @@ public:
          ///< This is a value in the range 0 (worst quality) through
          ///< 100 (best possible quality). A value of -1 indicates that this
          ///< device has no concept of a "signal quality".
+  virtual uint64_t SignalStatsTime(void) const;
+         ///< Returns the time (as given by cTimeMs::Now()) at which the values
+         ///< returned by SignalStats(), SignalStrength() and SignalQuality() have
+         ///< been read from the hardware. Devices that sample these values in the
+         ///< background (see Setup.SignalStatsInterval) may return values that are
+         ///< somewhat older than the time of the call.
+         ///< A value of 0 means the time is unknown (the default implementation
+         ///< always returns 0).
   virtual const cChannel *GetCurrentlyTunedTransponder(void) const;
          ///< Returns a pointer to the currently tuned transponder.
          ///< This is not one of the channels in the global cChannels list, but rather
@@ -439,6 +453,7 @@ public:
 
 private:
   cSectionHandler *sectionHandler;
+  cSectionDemux *sectionDemux;
   cEitFilter *eitFilter;
   cPatFilter *patFilter;
   cSdtFilter *sdtFilter;
@@ -456,7 +471,12 @@ public:
   virtual int OpenFilter(u_short Pid, u_char Tid, u_char Mask);
        ///< Opens a file handle for the given filter data.
        ///< A derived device that provides section data must
-       ///< implement this function.
+       ///< implement this function. The default implementation
+       ///< assembles the sections from the TS packets delivered by
+       ///< GetTSPackets(), so a derived device that can provide the TS
+       ///< of the PIDs set with SetPid() doesn't need to implement this
+       ///< function to get section data (it can also call the default
+       ///< implementation instead of using kernel section filters).
   virtual int ReadFilter(int Handle, void *Buffer, size_t Length);
        ///< Reads data from a handle for the given filter.
        ///< A derived class need not implement this function, because this
@@ -465,12 +485,15 @@ public:
        ///< Closes a file handle that has previously been opened
        ///< by OpenFilter(). If this is as simple as calling close(Handle),
        ///< a derived class need not implement this function, because this
-       ///< is done by the default implementation.
+       ///< is done by the default implementation. A derived device that
+       ///< implements this function must call the default implementation
+       ///< for any Handle it got from cDevice::OpenFilter().
   void AttachFilter(cFilter *Filter);
        ///< Attaches the given filter to this device.
   void Detach(cFilter *Filter);
        ///< Detaches the given filter from this device.
   const cSdtFilter *SdtFilter(void) const { return sdtFilter; }
+  const cEitFilter *EitFilter(void) const { return eitFilter; }
   cSectionHandler *SectionHandler(void) const { return sectionHandler; }
 
 // Common Interface facilities:
@@ -514,6 +537,16 @@ public:
          ///< Returns true if all went well.
          ///< The caller is responsible for making sure that the given file name
          ///< doesn't lead to overwriting any important other file.
+  virtual uchar *DecodeImage(const uchar *Data, int Length, int &Size, bool Jpeg = true, int Quality = -1, int SizeX = -1, int SizeY = -1);
+         ///< Decodes the independent frame in the given TS Data (which starts with
+         ///< the PAT and PMT, as stored in a recording) and returns the resulting image
+         ///< in the same way as GrabImage(). If SizeX and SizeY are given, the image is
+         ///< scaled to that size.
+         ///< This is used to generate thumbnails of recordings in the background, so it
+         ///< may be called from any thread, and must not affect what is currently being
+         ///< displayed.
+         ///< The default implementation returns NULL, meaning that this device can't
+         ///< decode images.
 
 // Video format facilities
 
@@ -656,10 +689,22 @@ private:
   cTsToPes tsToPesAudio;
   cTsToPes tsToPesSubtitle;
   bool isPlayingVideo;
+  bool multiPacketPlay;
+  int TsRunLength(const uchar *Data, int Length);
+       ///< Returns the length of the run of TS packets at the beginning of Data that
+       ///< can be handed to PlayTsVideo(), PlayTsAudio() or PlayTsSubtitle() in one call.
 protected:
   const cPatPmtParser *PatPmtParser(void) const { return &patPmtParser; }
        ///< Returns a pointer to the patPmtParser, so that a derived device
        ///< can use the stream information from it.
+  void SetMultiPacketPlay(bool On) { multiPacketPlay = On; }
+       ///< If a derived device's PlayTsVideo(), PlayTsAudio() and PlayTsSubtitle() are
+       ///< able to handle several consecutive TS packets in a single call, it can call
+       ///< SetMultiPacketPlay(true) (typically in its constructor). PlayTs() will then
+       ///< hand over each run of consecutive packets of the same PID in one call, which
+       ///< reduces the per packet overhead during replay and Transfer Mode.
+       ///< Note that the default implementations of these functions can only handle
+       ///< one TS packet at a time.
   virtual bool CanReplay(void) const;
        ///< Returns true if this device can currently start a replay session.
   virtual bool SetPlayMode(ePlayMode PlayMode);
@@ -695,25 +740,27 @@ protected:
   virtual int PlayTsVideo(const uchar *Data, int Length);
        ///< Plays the given data block as video.
        ///< Data points to exactly one complete TS packet of the given Length
-       ///< (which is always TS_SIZE).
-       ///< PlayTsVideo() shall process the packet either as a whole (returning
-       ///< Length) or not at all (returning 0 or -1 and setting 'errno' accordingly).
+       ///< (which is always TS_SIZE), or, if SetMultiPacketPlay(true) has been called,
+       ///< to several consecutive TS packets of the same PID, and Length is a multiple
+       ///< of TS_SIZE.
+       ///< PlayTsVideo() shall process each packet either as a whole or not at all,
+       ///< and return the number of bytes taken (or 0 or -1, setting 'errno' accordingly).
        ///< The default implementation collects all incoming TS payload belonging
        ///< to one PES packet and calls PlayVideo() with the resulting packet.
   virtual int PlayTsAudio(const uchar *Data, int Length);
        ///< Plays the given data block as audio.
        ///< Data points to exactly one complete TS packet of the given Length
-       ///< (which is always TS_SIZE).
-       ///< PlayTsAudio() shall process the packet either as a whole (returning
-       ///< Length) or not at all (returning 0 or -1 and setting 'errno' accordingly).
+       ///< (which is always TS_SIZE), or to several of them (see PlayTsVideo()).
+       ///< PlayTsAudio() shall process each packet either as a whole or not at all,
+       ///< and return the number of bytes taken (or 0 or -1, setting 'errno' accordingly).
        ///< The default implementation collects all incoming TS payload belonging
        ///< to one PES packet and calls PlayAudio() with the resulting packet.
   virtual int PlayTsSubtitle(const uchar *Data, int Length);
        ///< Plays the given data block as a subtitle.
        ///< Data points to exactly one complete TS packet of the given Length
-       ///< (which is always TS_SIZE).
-       ///< PlayTsSubtitle() shall process the packet either as a whole (returning
-       ///< Length) or not at all (returning 0 or -1 and setting 'errno' accordingly).
+       ///< (which is always TS_SIZE), or to several of them (see PlayTsVideo()).
+       ///< PlayTsSubtitle() shall process each packet either as a whole or not at all,
+       ///< and return the number of bytes taken (or 0 or -1, setting 'errno' accordingly).
        ///< The default implementation collects all incoming TS payload belonging
        ///< to one PES packet and displays the resulting subtitle via the OSD.
 public:
@@ -762,7 +809,8 @@ public:
        ///< To restore full screen video, call this function with a Null rectangle.
   virtual bool HasIBPTrickSpeed(void) { return false; }
        ///< Returns true if this device can handle all frames in 'fast forward'
-       ///< trick speeds.
+       ///< trick speeds. In reverse trick speeds such a device is given the GOPs
+       ///< in reverse order, each of them with all its frames in decoding order.
   virtual void TrickSpeed(int Speed, bool Forward);
        ///< Sets the device into a mode where replay is done slower.
        ///< Every single frame shall then be displayed the given number of
@@ -846,7 +894,19 @@ public:
 private:
   mutable cMutex mutexReceiver;
   cReceiver *receiver[MAXRECEIVERS];
+  uint16_t receiverMask[MAXPID]; // for each PID the bit mask of the receiver slots that want it (must hold MAXRECEIVERS bits!)
+  uchar lastCc[MAXPID]; // the continuity counter of the last TS packet with payload for each PID (0xFF = none)
+  uint64_t tsPackets;
+  int continuityErrors;
+  void SetReceiverPid(cReceiver *Receiver, int Pid, bool On);
+       ///< Sets (On == true) or clears the bit for the given Receiver in the
+       ///< receiverMask of the given Pid.
 public:
+  uint64_t TsPackets(void) const { return tsPackets; }
+      ///< Returns the number of TS packets this device has received so far.
+  int ContinuityErrors(void) const { return continuityErrors; }
+      ///< Returns the number of continuity counter errors (i.e. lost TS packets)
+      ///< this device has detected so far.
   int Priority(bool IgnoreOccupied = false) const;
       ///< Returns the priority of the current receiving session (-MAXPRIORITY..MAXPRIORITY),
       ///< or IDLEPRIORITY if no receiver is currently active.
@@ -864,6 +924,17 @@ protected:
       ///< new data available, Data will be set to NULL. The function returns
       ///< false in case of a non recoverable error, otherwise it returns true,
       ///< even if Data is NULL.
+  virtual bool GetTSPackets(uchar *&Data, int &Count);
+      ///< Gets as many consecutive TS packets as are currently available (up to
+      ///< MAXTSBATCH) from the DVR of this device and returns a pointer to the
+      ///< first one in Data. Count is set to the total number of bytes Data points
+      ///< to, which is always a multiple of TS_SIZE. Every packet is guaranteed
+      ///< to start with a TS_SYNC_BYTE. If there is currently no new data available,
+      ///< Data will be set to NULL and Count to 0. The return value has the same
+      ///< meaning as in GetTSPacket().
+      ///< The default implementation calls GetTSPacket() and thus delivers a single
+      ///< TS packet. Derived devices can reimplement this function to allow cDevice::Action()
+      ///< to distribute the data to the receivers in larger blocks.
 public:
   bool Receiving(bool Dummy = false) const;
        ///< Returns true if we are currently receiving. The parameter has no meaning (for backwards compatibility only).
@@ -890,15 +961,25 @@ public:
 
 class cTSBuffer : public cThread {
 private:
+  cMemoryClient *memory;
+  cRingBufferLinear *ringBuffer;
+  virtual void Action(void) override;
+protected:
   int f;
   int deviceNumber;
   int delivered;
-  cRingBufferLinear *ringBuffer;
-  virtual void Action(void) override;
+  cTSBuffer(int File, int DeviceNumber);
+     ///< Derived classes that get their data directly from the driver, rather than
+     ///< reading it into a ring buffer, use this constructor, which doesn't start
+     ///< the reading thread. They need to reimplement Get() and Skip().
 public:
-  cTSBuffer(int File, int Size, int DeviceNumber);
+  cTSBuffer(int File, int Size, int DeviceNumber, int NumaNode = -1);
+     ///< Creates a buffer of the given Size that reads TS data from File. If NumaNode
+     ///< is given, the buffer's memory is preferably taken from that NUMA node.
+     ///< If the memory budget is tight, the buffer may be smaller than Size, but
+     ///< at least a quarter of it.
   virtual ~cTSBuffer() override;
-  uchar *Get(int *Available = NULL, bool CheckAvailable = false);
+  virtual uchar *Get(int *Available = NULL, bool CheckAvailable = false);
      ///< Returns a pointer to the first TS packet in the buffer. If Available is given,
      ///< it will return the total number of consecutive bytes pointed to in the buffer.
      ///< It is guaranteed that the returned pointer points to a TS_SYNC_BYTE and that
@@ -909,7 +990,7 @@ public:
      ///< at least TS_SIZE bytes before trying to get any data from it. Otherwise, if
      ///< the buffer is empty, this function will wait a little while for the buffer
      ///< to be filled again.
-  void Skip(int Count);
+  virtual void Skip(int Count);
      ///< If after a call to Get() more or less than TS_SIZE of the available data
      ///< has been processed, a call to Skip() with the number of processed bytes
      ///< will disable the automatic incrementing of the data pointer as described
@@ -49,7 +49,7 @@ int cDvbCiAdapter::Read(uint8_t *Buffer, int MaxLength)
      struct pollfd pfd[1];
      pfd[0].fd = fd;
      pfd[0].events = POLLIN;
-     if (poll(pfd, 1, CAM_READ_TIMEOUT) > 0 && (pfd[0].revents & POLLIN)) {
+     if (poll(pfd, 1, ReadTimeout()) > 0 && (pfd[0].revents & POLLIN)) {
         int n = safe_read(fd, Buffer, MaxLength);
         if (n >= 0)
            return n;
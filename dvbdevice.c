@@ -20,6 +20,9 @@
 #include "dvbci.h"
 #include "menuitems.h"
 #include "sourceparams.h"
+#include "startup.h"
+#include "taskpool.h"
+#include "trace.h"
 
 static int DvbApiVersion = 0x0000; // the version of the DVB driver actually in use (will be determined by the first device created)
 
@@ -36,8 +39,17 @@ static int DvbApiVersion = 0x0000; // the version of the DVB driver actually in
 
 #define SCR_RANDOM_TIMEOUT  500 // ms (add random value up to this when tuning SCR device to avoid lockups)
 
+#define SIGNALSTATS_REQUEST_TIMEOUT  5000 // ms after the last request for signal statistics until the tuner thread stops sampling them
+
 #define TSBUFFERSIZE MEGABYTE(16)
 
+// Initial demux buffer sizes (in sections) for the various kinds of section filters:
+#define SB_DEFAULT_SECTIONS  2 // what the driver uses if the size isn't set (8192 bytes)
+#define SB_SMALL_SECTIONS    SB_DEFAULT_SECTIONS
+#define SB_MEDIUM_SECTIONS   4
+#define SB_LARGE_SECTIONS    8
+#define SB_MAX_SECTIONS     64 // the limit up to which a buffer grows in case of overflows
+
 // --- DVB Parameter Maps ----------------------------------------------------
 
 const tDvbParameterMap PilotValues[] = {
@@ -511,8 +523,6 @@ bool cDvbFrontend::QueryDeliverySystems(void)
 
 // --- cDvbTuner -------------------------------------------------------------
 
-#define TUNER_POLL_TIMEOUT  10 // ms
-
 static int GetRequiredDeliverySystem(const cChannel *Channel, const cDvbTransponderParameters *Dtp)
 {
   int ds = SYS_UNDEFINED;
@@ -552,13 +562,28 @@ private:
   mutable const cDiseqc *lastDiseqc;
   int diseqcOffset;
   mutable int lastSource;
+  mutable cString diseqcState; // the switch commands last sent with DiSEqC (NULL if unknown)
+  int lastTone;
+  int lastVoltage;
   cPositioner *positioner;
   const cScr *scr;
   mutable bool lnbPowerTurnedOn;
   eTunerStatus tunerStatus;
+  struct tSignalStats {
+    bool ok;
+    int valid;
+    double strength, cnr, berPre, berPost, per;
+    int status;
+    int signalStrength;
+    int signalQuality;
+    };
+  mutable cMutex statsMutex;
+  mutable tSignalStats signalStats;
+  mutable uint64_t statsRequested; // the time the signal statistics were last asked for
+  mutable uint64_t statsSampled;   // the time the signal statistics were last read from the frontend
   mutable cMutex mutex;
   cCondVar locked;
-  cCondVar newSet;
+  mutable cWakeup newSet; // wakes up the tuner thread, which also waits for frontend events
   cDvbTuner *bondedTuner;
   bool bondedMaster;
   cString GetBondingParams(const cChannel *Channel = NULL) const;
@@ -566,7 +591,14 @@ private:
   bool IsBondedMaster(void) const { return !bondedTuner || bondedMaster; }
   void ClearEventQueue(void) const;
   bool GetFrontendStatus(fe_status_t &Status) const;
+  bool ReadSignalStats(int &Valid, double *Strength = NULL, double *Cnr = NULL, double *BerPre = NULL, double *BerPost = NULL, double *Per = NULL, int *Status = NULL) const;
+  int ReadSignalStrength(void) const;
+  int ReadSignalQuality(void) const;
+  void SampleSignalStats(void) const;
+  void UpdateSignalStats(void) const;
+  int SignalStatsDue(void) const;
   cPositioner *GetPositioner(void);
+  cString DiseqcState(const cDiseqc *Diseqc, int *Frequency, int *Tone, int *Voltage) const;
   void ExecuteDiseqc(const cDiseqc *Diseqc, int *Frequency);
   void ResetToneAndVoltage(void);
   bool SetFrontend(void);
@@ -593,6 +625,7 @@ public:
   bool GetSignalStats(int &Valid, double *Strength = NULL, double *Cnr = NULL, double *BerPre = NULL, double *BerPost = NULL, double *Per = NULL, int *Status = NULL) const;
   int GetSignalStrength(void) const;
   int GetSignalQuality(void) const;
+  uint64_t SignalStatsTime(void) const;
   void SetPowerSaveMode(bool On);
   };
 
@@ -615,10 +648,15 @@ cDvbTuner::cDvbTuner(const cDvbDevice *Device, int Adapter, int Frontend)
   lastDiseqc = NULL;
   diseqcOffset = 0;
   lastSource = 0;
+  lastTone = -1;
+  lastVoltage = -1;
   positioner = NULL;
   scr = NULL;
   lnbPowerTurnedOn = false;
   tunerStatus = tsIdle;
+  memset(&signalStats, 0, sizeof(signalStats));
+  statsRequested = 0;
+  statsSampled = 0;
   bondedTuner = NULL;
   bondedMaster = false;
   cDvbFrontend *fe = new cDvbFrontend(adapter, frontend);
@@ -652,7 +690,7 @@ cDvbTuner::cDvbTuner(const cDvbDevice *Device, int Adapter, int Frontend)
 cDvbTuner::~cDvbTuner()
 {
   tunerStatus = tsIdle;
-  newSet.Broadcast();
+  newSet.Signal();
   locked.Broadcast();
   Cancel(3);
   UnBond();
@@ -699,10 +737,12 @@ bool cDvbTuner::ProvidesFrontend(const cChannel *Channel, bool Activate) const
             dsyslog("using frontend %d/%d", adapter, frontend);
             lastDiseqc = NULL;
             lastSource = 0;
+            diseqcState = NULL;
             lastUncValue = 0;
             lastUncDelta = 0;
             lastUncChange = 0;
             lnbPowerTurnedOn = false;
+            newSet.Signal(); // the tuner thread may be waiting for events from the previous frontend
             }
          return true;
          }
@@ -823,12 +863,15 @@ void cDvbTuner::SetChannel(const cChannel *Channel)
            BondedMaster->SetChannel(Channel);
         }
      cMutexLock MutexLock(&mutex);
-     if (!IsTunedTo(Channel))
+     if (!IsTunedTo(Channel)) {
         tunerStatus = tsSet;
+        cMutexLock MutexLock(&statsMutex);
+        statsSampled = 0; // the statistics of the previous transponder are no longer valid
+        }
      diseqcOffset = 0;
      channel = *Channel;
      lastTimeoutReport = 0;
-     newSet.Broadcast();
+     newSet.Signal();
      }
   else {
      cMutexLock MutexLock(&mutex);
@@ -853,12 +896,10 @@ bool cDvbTuner::Locked(int TimeoutMs)
 
 void cDvbTuner::ClearEventQueue(void) const
 {
-  cPoller Poller(fd_frontend);
-  if (Poller.Poll(TUNER_POLL_TIMEOUT)) {
-     dvb_frontend_event Event;
-     while (ioctl(fd_frontend, FE_GET_EVENT, &Event) == 0)
-           ; // just to clear the event queue - we'll read the actual status below
-     }
+  // The frontend is opened with O_NONBLOCK, so this returns as soon as the queue is empty:
+  dvb_frontend_event Event;
+  while (ioctl(fd_frontend, FE_GET_EVENT, &Event) == 0)
+        ; // just to clear the event queue - we'll read the actual status below
 }
 
 bool cDvbTuner::GetFrontendStatus(fe_status_t &Status) const
@@ -880,7 +921,7 @@ bool cDvbTuner::GetFrontendStatus(fe_status_t &Status) const
 //#define DEBUG_SIGNALSTRENGTH
 //#define DEBUG_SIGNALQUALITY
 
-bool cDvbTuner::GetSignalStats(int &Valid, double *Strength, double *Cnr, double *BerPre, double *BerPost, double *Per, int *Status) const
+bool cDvbTuner::ReadSignalStats(int &Valid, double *Strength, double *Cnr, double *BerPre, double *BerPost, double *Per, int *Status) const
 {
   if (fd_frontend == -1)
      return false;
@@ -1232,7 +1273,7 @@ int SignalToSQI(const cChannel *Channel, int Signal, int Ber, int FeModulation,
   return sqi;
 }
 
-int cDvbTuner::GetSignalStrength(void) const
+int cDvbTuner::ReadSignalStrength(void) const
 {
   if (fd_frontend == -1)
      return 0;
@@ -1299,7 +1340,7 @@ int cDvbTuner::GetSignalStrength(void) const
 
 #define LOCK_THRESHOLD 5 // indicates that all 5 FE_HAS_* flags are set
 
-int cDvbTuner::GetSignalQuality(void) const
+int cDvbTuner::ReadSignalQuality(void) const
 {
   if (fd_frontend == -1)
      return 0;
@@ -1473,6 +1514,88 @@ int cDvbTuner::GetSignalQuality(void) const
   return -1;
 }
 
+void cDvbTuner::SampleSignalStats(void) const
+{
+  // The frontend is read without holding statsMutex, so that callers
+  // don't have to wait while a slow driver is being accessed:
+  tSignalStats Stats;
+  memset(&Stats, 0, sizeof(Stats));
+  Stats.ok = ReadSignalStats(Stats.valid, &Stats.strength, &Stats.cnr, &Stats.berPre, &Stats.berPost, &Stats.per, &Stats.status);
+  Stats.signalStrength = ReadSignalStrength();
+  Stats.signalQuality = ReadSignalQuality();
+  cMutexLock MutexLock(&statsMutex);
+  signalStats = Stats;
+  statsSampled = cTimeMs::Now();
+}
+
+void cDvbTuner::UpdateSignalStats(void) const
+{
+  uint64_t Now = cTimeMs::Now();
+  {
+    cMutexLock MutexLock(&statsMutex);
+    if (Now - statsRequested >= SIGNALSTATS_REQUEST_TIMEOUT)
+       newSet.Signal(); // lets the tuner thread start sampling
+    statsRequested = Now;
+    // The tuner thread keeps the values up to date, so we only need to read them
+    // here if sampling is turned off, or the tuner thread hasn't done so lately
+    // (which is the case with the first request, or while the tuner is idle):
+    if (Setup.SignalStatsInterval && Now - statsSampled < uint64_t(2 * Setup.SignalStatsInterval))
+       return;
+  }
+  SampleSignalStats();
+}
+
+int cDvbTuner::SignalStatsDue(void) const
+{
+  cMutexLock MutexLock(&statsMutex);
+  uint64_t Now = cTimeMs::Now();
+  if (!Setup.SignalStatsInterval || Now - statsRequested >= SIGNALSTATS_REQUEST_TIMEOUT)
+     return -1; // nobody is interested in the signal statistics
+  return max(0, Setup.SignalStatsInterval - int(Now - statsSampled));
+}
+
+bool cDvbTuner::GetSignalStats(int &Valid, double *Strength, double *Cnr, double *BerPre, double *BerPost, double *Per, int *Status) const
+{
+  if (fd_frontend == -1)
+     return false;
+  UpdateSignalStats();
+  cMutexLock MutexLock(&statsMutex);
+  if (!signalStats.ok)
+     return false;
+  Valid = DTV_STAT_VALID_NONE;
+  if (Strength) { *Strength = signalStats.strength; Valid |= signalStats.valid & DTV_STAT_VALID_STRENGTH; }
+  if (Cnr)      { *Cnr      = signalStats.cnr;      Valid |= signalStats.valid & DTV_STAT_VALID_CNR; }
+  if (BerPre)   { *BerPre   = signalStats.berPre;   Valid |= signalStats.valid & DTV_STAT_VALID_BERPRE; }
+  if (BerPost)  { *BerPost  = signalStats.berPost;  Valid |= signalStats.valid & DTV_STAT_VALID_BERPOST; }
+  if (Per)      { *Per      = signalStats.per;      Valid |= signalStats.valid & DTV_STAT_VALID_PER; }
+  if (Status)   { *Status   = signalStats.status;   Valid |= signalStats.valid & DTV_STAT_VALID_STATUS; }
+  return Valid != DTV_STAT_VALID_NONE;
+}
+
+int cDvbTuner::GetSignalStrength(void) const
+{
+  if (fd_frontend == -1)
+     return 0;
+  UpdateSignalStats();
+  cMutexLock MutexLock(&statsMutex);
+  return signalStats.signalStrength;
+}
+
+int cDvbTuner::GetSignalQuality(void) const
+{
+  if (fd_frontend == -1)
+     return 0;
+  UpdateSignalStats();
+  cMutexLock MutexLock(&statsMutex);
+  return signalStats.signalQuality;
+}
+
+uint64_t cDvbTuner::SignalStatsTime(void) const
+{
+  cMutexLock MutexLock(&statsMutex);
+  return statsSampled;
+}
+
 static unsigned int FrequencyToHz(unsigned int f)
 {
   while (f && f < 1000000)
@@ -1489,12 +1612,61 @@ cPositioner *cDvbTuner::GetPositioner(void)
   return positioner;
 }
 
+cString cDvbTuner::DiseqcState(const cDiseqc *Diseqc, int *Frequency, int *Tone, int *Voltage) const
+{
+  char State[256] = "";
+  int l = 0;
+  struct dvb_diseqc_master_cmd cmd;
+  const char *CurrentAction = NULL;
+  for (;;) {
+      cmd.msg_len = sizeof(cmd.msg);
+      switch (Diseqc->Execute(&CurrentAction, cmd.msg, &cmd.msg_len, scr, Frequency)) {
+        case cDiseqc::daNone:      return State;
+        case cDiseqc::daToneOff:   *Tone = SEC_TONE_OFF; break;
+        case cDiseqc::daToneOn:    *Tone = SEC_TONE_ON; break;
+        case cDiseqc::daVoltage13: *Voltage = SEC_VOLTAGE_13; break;
+        case cDiseqc::daVoltage18: *Voltage = SEC_VOLTAGE_18; break;
+        case cDiseqc::daMiniA:     l += snprintf(State + l, sizeof(State) - l, "A "); break;
+        case cDiseqc::daMiniB:     l += snprintf(State + l, sizeof(State) - l, "B "); break;
+        case cDiseqc::daCodes:     for (int i = 0; i < cmd.msg_len; i++)
+                                       l += snprintf(State + l, sizeof(State) - l, "%02X", cmd.msg[i]);
+                                   l += snprintf(State + l, sizeof(State) - l, " ");
+                                   break;
+        case cDiseqc::daScr:
+        case cDiseqc::daWait:      break;
+        default:                   return NULL; // positioner commands are always executed
+        }
+      if (l >= int(sizeof(State)))
+         return NULL;
+      }
+}
+
 void cDvbTuner::ExecuteDiseqc(const cDiseqc *Diseqc, int *Frequency)
 {
   if (!lnbPowerTurnedOn) {
      CHECK(ioctl(fd_frontend, FE_SET_VOLTAGE, SEC_VOLTAGE_13)); // must explicitly turn on LNB power
+     lastVoltage = SEC_VOLTAGE_13;
      lnbPowerTurnedOn = true;
      }
+  // Skip the commands (and the waits between them) if they wouldn't change the state of the switches:
+  cString State;
+  if (!diseqcOffset) {
+     int f = *Frequency;
+     int Tone = lastTone;
+     int Voltage = lastVoltage;
+     State = DiseqcState(Diseqc, &f, &Tone, &Voltage);
+     if (*State && *diseqcState && strcmp(State, diseqcState) == 0) {
+        if (!scr) { // with SCR tone and voltage are reset after each command anyway
+           if (Voltage != lastVoltage)
+              CHECK(ioctl(fd_frontend, FE_SET_VOLTAGE, lastVoltage = Voltage));
+           if (Tone != lastTone)
+              CHECK(ioctl(fd_frontend, FE_SET_TONE, lastTone = Tone));
+           }
+        *Frequency = f;
+        return;
+        }
+     }
+  diseqcState = NULL;
   static cMutex Mutex;
   if (Diseqc->IsScr())
      Mutex.Lock();
@@ -1511,10 +1683,10 @@ void cDvbTuner::ExecuteDiseqc(const cDiseqc *Diseqc, int *Frequency)
          }
       bool d = i >= diseqcOffset;
       switch (da) {
-        case cDiseqc::daToneOff:   if (d) CHECK(ioctl(fd_frontend, FE_SET_TONE, SEC_TONE_OFF)); break;
-        case cDiseqc::daToneOn:    if (d) CHECK(ioctl(fd_frontend, FE_SET_TONE, SEC_TONE_ON)); break;
-        case cDiseqc::daVoltage13: if (d) CHECK(ioctl(fd_frontend, FE_SET_VOLTAGE, SEC_VOLTAGE_13)); break;
-        case cDiseqc::daVoltage18: if (d) CHECK(ioctl(fd_frontend, FE_SET_VOLTAGE, SEC_VOLTAGE_18)); break;
+        case cDiseqc::daToneOff:   if (d) CHECK(ioctl(fd_frontend, FE_SET_TONE, lastTone = SEC_TONE_OFF)); break;
+        case cDiseqc::daToneOn:    if (d) CHECK(ioctl(fd_frontend, FE_SET_TONE, lastTone = SEC_TONE_ON)); break;
+        case cDiseqc::daVoltage13: if (d) CHECK(ioctl(fd_frontend, FE_SET_VOLTAGE, lastVoltage = SEC_VOLTAGE_13)); break;
+        case cDiseqc::daVoltage18: if (d) CHECK(ioctl(fd_frontend, FE_SET_VOLTAGE, lastVoltage = SEC_VOLTAGE_18)); break;
         case cDiseqc::daMiniA:     if (d) CHECK(ioctl(fd_frontend, FE_DISEQC_SEND_BURST, SEC_MINI_A)); break;
         case cDiseqc::daMiniB:     if (d) CHECK(ioctl(fd_frontend, FE_DISEQC_SEND_BURST, SEC_MINI_B)); break;
         case cDiseqc::daCodes:     if (d) CHECK(ioctl(fd_frontend, FE_DISEQC_SEND_MASTER_CMD, &cmd)); break;
@@ -1540,6 +1712,8 @@ void cDvbTuner::ExecuteDiseqc(const cDiseqc *Diseqc, int *Frequency)
          diseqcOffset = i + 1;
       }
   positioner = Positioner;
+  if (!Break)
+     diseqcState = State;
   if (scr && !Break)
      ResetToneAndVoltage(); // makes sure we don't block the bus!
   if (Diseqc->IsScr())
@@ -1550,8 +1724,8 @@ void cDvbTuner::ResetToneAndVoltage(void)
 {
   if (fd_frontend == -1)
      return;
-  CHECK(ioctl(fd_frontend, FE_SET_VOLTAGE, bondedTuner ? SEC_VOLTAGE_OFF : SEC_VOLTAGE_13));
-  CHECK(ioctl(fd_frontend, FE_SET_TONE, SEC_TONE_OFF));
+  CHECK(ioctl(fd_frontend, FE_SET_VOLTAGE, lastVoltage = bondedTuner ? SEC_VOLTAGE_OFF : SEC_VOLTAGE_13));
+  CHECK(ioctl(fd_frontend, FE_SET_TONE, lastTone = SEC_TONE_OFF));
 }
 
 bool cDvbTuner::SetFrontend(void)
@@ -1561,6 +1735,7 @@ bool cDvbTuner::SetFrontend(void)
   dtv_properties CmdSeq;
   memset(&CmdSeq, 0, sizeof(CmdSeq));
   CmdSeq.props = Props;
+  VDR_TRACE(tuner_tune, adapter, frontend, channel.Number(), channel.Transponder());
   SETCMD(DTV_CLEAR, 0);
   if (ioctl(fd_frontend, FE_SET_PROPERTY, &CmdSeq) < 0) {
      esyslog("ERROR: frontend %d/%d: %m (%s:%d)", adapter, frontend, __FILE__, __LINE__);
@@ -1613,8 +1788,9 @@ bool cDvbTuner::SetFrontend(void)
            tone = SEC_TONE_OFF;
            volt = SEC_VOLTAGE_13;
            }
-        CHECK(ioctl(fd_frontend, FE_SET_VOLTAGE, volt));
-        CHECK(ioctl(fd_frontend, FE_SET_TONE, tone));
+        CHECK(ioctl(fd_frontend, FE_SET_VOLTAGE, lastVoltage = volt));
+        CHECK(ioctl(fd_frontend, FE_SET_TONE, lastTone = tone));
+        diseqcState = NULL;
         }
      frequency = abs(frequency); // Allow for C-band, where the frequency is less than the LOF
 
@@ -1699,12 +1875,19 @@ void cDvbTuner::Action(void)
   cTimeMs Timer;
   bool LostLock = false;
   fe_status_t Status = (fe_status_t)0;
+  eTunerStatus LastTunerStatus = tsIdle;
   while (Running()) {
         int WaitTime = 1000;
+        int WaitFd = -1; // the frontend, if we want to react to status changes immediately
         fe_status_t NewStatus;
         if (GetFrontendStatus(NewStatus))
            Status = NewStatus;
+        {
         cMutexLock MutexLock(&mutex);
+        if (tunerStatus != LastTunerStatus) {
+           VDR_TRACE(tuner_status, adapter, frontend, LastTunerStatus, tunerStatus);
+           LastTunerStatus = tunerStatus;
+           }
         switch (tunerStatus) {
           case tsIdle:
                break; // we want the TimedWait() below!
@@ -1732,6 +1915,7 @@ void cDvbTuner::Action(void)
                   tunerStatus = tsSet;
                   lastDiseqc = NULL;
                   lastSource = 0;
+                  diseqcState = NULL;
                   if (time(NULL) - lastTimeoutReport > 60) { // let's not get too many of these
                      if (channel.Number()) // no need to log this for transponders that are announced in the NIT but are not currently broadcasting
                         isyslog("frontend %d/%d timed out while tuning to channel %d (%s), tp %d", adapter, frontend, channel.Number(), channel.Name(), channel.Transponder());
@@ -1746,6 +1930,7 @@ void cDvbTuner::Action(void)
                   tunerStatus = tsSet;
                   lastDiseqc = NULL;
                   lastSource = 0;
+                  diseqcState = NULL;
                   isyslog("frontend %d/%d was reinitialized", adapter, frontend);
                   lastTimeoutReport = 0;
                   continue;
@@ -1761,6 +1946,7 @@ void cDvbTuner::Action(void)
                      tunerStatus = tsSet;
                      lastDiseqc = NULL;
                      lastSource = 0;
+                     diseqcState = NULL;
                      continue;
                      }
                   tunerStatus = tsLocked;
@@ -1775,10 +1961,27 @@ void cDvbTuner::Action(void)
                   lastTimeoutReport = 0;
                   continue;
                   }
+               WaitFd = fd_frontend;
                break;
           default: esyslog("ERROR: unknown tuner status %d", tunerStatus);
           }
-        newSet.TimedWait(mutex, WaitTime);
+        }
+        // Keep the signal statistics up to date, as long as anybody is interested in them:
+        if (WaitFd >= 0) {
+           int Due = SignalStatsDue();
+           if (Due == 0) {
+              SampleSignalStats();
+              Due = SignalStatsDue();
+              }
+           if (Due > 0)
+              WaitTime = min(WaitTime, Due);
+           }
+        // Wait for a new channel or a frontend event (like gaining or losing the lock).
+        // The timeout is only a fallback for drivers that don't deliver events:
+        cPoller Poller(newSet.Fd());
+        Poller.Add(WaitFd, false);
+        Poller.Poll(WaitTime);
+        newSet.Clear();
         }
 }
 
@@ -1792,6 +1995,7 @@ void cDvbTuner::SetPowerSaveMode(bool On)
         dvbFrontend->Close();
         fd_frontend = -1;
         channel = cChannel();
+        newSet.Signal();
         }
      }
   else {
@@ -1800,6 +2004,7 @@ void cDvbTuner::SetPowerSaveMode(bool On)
         fd_frontend = dvbFrontend->Open();
         lastDiseqc = NULL;
         lastSource = 0;
+        diseqcState = NULL;
         lastUncValue = 0;
         lastUncDelta = 0;
         lastUncChange = 0;
@@ -1869,6 +2074,267 @@ cOsdItem *cDvbSourceParam::GetOsdItem(void)
   return NULL;
 }
 
+// --- cDvbTsMmapBuffer ------------------------------------------------------
+
+// A TS buffer that uses the memory mapped buffers of the DVB demux (DMX_REQBUFS),
+// thus avoiding copying all received data from the driver into a ring buffer.
+// The buffers can only be mapped read-only, so cDvbDevice copies the data in
+// case a CAM slot needs to modify the TS packets.
+
+#define DVR_MMAP_BUFFERS        32 // the number of kernel buffers to request
+#define DVR_MMAP_BUFSIZE  (TS_SIZE * 1024) // a multiple of TS_SIZE as well as the page size
+#define DVR_MMAP_GETTIMEOUT    100 // ms to wait for data in Get()
+
+class cDvbTsMmapBuffer : public cTSBuffer {
+private:
+  uchar *buffers[DVR_MMAP_BUFFERS];
+  int lengths[DVR_MMAP_BUFFERS];
+  int numBuffers;
+  int current; // the index of the buffer currently being delivered, -1 if none
+  int offset;
+  int bytesUsed;
+  uint32_t lastCount;
+  cDvbTsMmapBuffer(int File, int DeviceNumber);
+  bool Setup(void);
+  bool Queue(int Index);
+  bool Dequeue(int TimeoutMs);
+public:
+  virtual ~cDvbTsMmapBuffer() override;
+  static cTSBuffer *Create(int File, int DeviceNumber);
+       ///< Creates a memory mapped TS buffer for the given DVR File. Returns NULL if
+       ///< the driver doesn't support memory mapped buffers.
+  virtual uchar *Get(int *Available = NULL, bool CheckAvailable = false) override;
+  virtual void Skip(int Count) override;
+  };
+
+cDvbTsMmapBuffer::cDvbTsMmapBuffer(int File, int DeviceNumber)
+:cTSBuffer(File, DeviceNumber)
+{
+  numBuffers = 0;
+  current = -1;
+  offset = 0;
+  bytesUsed = 0;
+  lastCount = 0;
+}
+
+cDvbTsMmapBuffer::~cDvbTsMmapBuffer()
+{
+  for (int i = 0; i < numBuffers; i++)
+      munmap(buffers[i], lengths[i]);
+}
+
+cTSBuffer *cDvbTsMmapBuffer::Create(int File, int DeviceNumber)
+{
+  cDvbTsMmapBuffer *TsBuffer = new cDvbTsMmapBuffer(File, DeviceNumber);
+  if (TsBuffer->Setup())
+     return TsBuffer;
+  delete TsBuffer;
+  return NULL;
+}
+
+bool cDvbTsMmapBuffer::Setup(void)
+{
+  dmx_requestbuffers rb;
+  memset(&rb, 0, sizeof(rb));
+  rb.count = DVR_MMAP_BUFFERS;
+  rb.size = DVR_MMAP_BUFSIZE;
+  if (ioctl(f, DMX_REQBUFS, &rb) < 0 || rb.count == 0)
+     return false; // the driver doesn't support memory mapped buffers
+  for (uint i = 0; i < rb.count && i < DVR_MMAP_BUFFERS; i++) {
+      dmx_buffer b;
+      memset(&b, 0, sizeof(b));
+      b.index = i;
+      if (ioctl(f, DMX_QUERYBUF, &b) < 0) {
+         LOG_ERROR;
+         return false;
+         }
+      void *p = mmap(NULL, b.length, PROT_READ, MAP_SHARED, f, b.offset);
+      if (p == MAP_FAILED) {
+         LOG_ERROR;
+         return false;
+         }
+      buffers[numBuffers] = (uchar *)p;
+      lengths[numBuffers] = b.length;
+      numBuffers++;
+      }
+  for (int i = 0; i < numBuffers; i++) {
+      if (!Queue(i))
+         return false;
+      }
+  dsyslog("using %d memory mapped DVR buffers of %d bytes on device %d", numBuffers, rb.size, deviceNumber);
+  return true;
+}
+
+bool cDvbTsMmapBuffer::Queue(int Index)
+{
+  dmx_buffer b;
+  memset(&b, 0, sizeof(b));
+  b.index = Index;
+  if (ioctl(f, DMX_QBUF, &b) < 0) {
+     LOG_ERROR;
+     return false;
+     }
+  return true;
+}
+
+bool cDvbTsMmapBuffer::Dequeue(int TimeoutMs)
+{
+  dmx_buffer b;
+  for (int i = 0; i < 2; i++) {
+      memset(&b, 0, sizeof(b));
+      if (ioctl(f, DMX_DQBUF, &b) == 0) {
+         if (int(b.index) >= numBuffers) {
+            esyslog("ERROR: invalid DVR buffer index %d on device %d", b.index, deviceNumber);
+            return false;
+            }
+         if (lastCount && b.count != lastCount + 1 || (b.flags & DMX_BUFFER_FLAG_DISCONTINUITY_DETECTED))
+            esyslog("ERROR: driver buffer overflow on device %d", deviceNumber);
+         lastCount = b.count;
+         current = b.index;
+         offset = 0;
+         bytesUsed = min(int(b.bytesused), lengths[current]);
+         return true;
+         }
+      if (errno != EAGAIN) {
+         LOG_ERROR;
+         return false;
+         }
+      if (i || TimeoutMs <= 0)
+         break;
+      cPoller Poller(f);
+      if (!Poller.Poll(TimeoutMs))
+         break;
+      }
+  return false;
+}
+
+uchar *cDvbTsMmapBuffer::Get(int *Available, bool CheckAvailable)
+{
+  if (current >= 0) {
+     offset += delivered;
+     delivered = 0;
+     if (offset + TS_SIZE > bytesUsed) {
+        if (offset < bytesUsed)
+           esyslog("ERROR: skipped %d bytes of incomplete TS packet on device %d", bytesUsed - offset, deviceNumber);
+        Queue(current);
+        current = -1;
+        }
+     }
+  if (current < 0 && !Dequeue(CheckAvailable ? 0 : DVR_MMAP_GETTIMEOUT))
+     return NULL;
+  uchar *p = buffers[current] + offset;
+  int Count = bytesUsed - offset;
+  if (Count < TS_SIZE)
+     return NULL; // will be requeued with the next call
+  if (*p != TS_SYNC_BYTE) {
+     Count = TsFindSync(p, Count);
+     offset += Count;
+     esyslog("ERROR: skipped %d bytes to sync on TS packet on device %d", Count, deviceNumber);
+     return NULL;
+     }
+  delivered = TS_SIZE;
+  if (Available)
+     *Available = Count;
+  return p;
+}
+
+void cDvbTsMmapBuffer::Skip(int Count)
+{
+  delivered = Count;
+}
+
+// --- cDvbTransponderCache --------------------------------------------------
+
+#define MAXTRANSPONDERCACHE  1000 // the cache is cleared if it grows beyond this many entries
+
+class cDvbTransponderCacheEntry : public cListObject {
+private:
+  int source;
+  int frequency;
+  cString parameters;
+  bool provides;
+public:
+  cDvbTransponderCacheEntry(const cChannel *Channel, bool Provides);
+  bool Matches(const cChannel *Channel) const;
+  bool Provides(void) const { return provides; }
+  };
+
+cDvbTransponderCacheEntry::cDvbTransponderCacheEntry(const cChannel *Channel, bool Provides)
+{
+  source = Channel->Source();
+  frequency = Channel->Frequency();
+  parameters = Channel->Parameters();
+  provides = Provides;
+}
+
+bool cDvbTransponderCacheEntry::Matches(const cChannel *Channel) const
+{
+  return source == Channel->Source() && frequency == Channel->Frequency() && strcmp(parameters, Channel->Parameters()) == 0;
+}
+
+// Remembers whether a device can tune to a given transponder at all, because
+// checking this involves parsing the channel's parameters, looking at all
+// frontends and the DiSEqC configuration, and cDevice::GetDevice() asks for
+// every device and channel quite often.
+
+class cDvbTransponderCache {
+private:
+  cMutex mutex;
+  cHash<cDvbTransponderCacheEntry> entries;
+  int numEntries;
+  int diseqc; // the value of Setup.DiSEqC the entries have been determined with
+  static unsigned int Hash(const cChannel *Channel);
+public:
+  cDvbTransponderCache(void);
+  int Get(const cChannel *Channel);
+       ///< Returns 1 if the device provides the transponder of the given Channel,
+       ///< 0 if it doesn't, and -1 if this is not yet known.
+  void Put(const cChannel *Channel, bool Provides);
+  };
+
+cDvbTransponderCache::cDvbTransponderCache(void)
+:entries(HASHSIZE, true)
+{
+  numEntries = 0;
+  diseqc = Setup.DiSEqC;
+}
+
+unsigned int cDvbTransponderCache::Hash(const cChannel *Channel)
+{
+  unsigned int h = Channel->Source() * 31u + Channel->Frequency();
+  for (const char *p = Channel->Parameters(); *p; p++)
+      h = h * 31u + (unsigned char)*p;
+  return h;
+}
+
+int cDvbTransponderCache::Get(const cChannel *Channel)
+{
+  cMutexLock MutexLock(&mutex);
+  if (diseqc != Setup.DiSEqC) {
+     entries.Clear();
+     numEntries = 0;
+     diseqc = Setup.DiSEqC;
+     return -1;
+     }
+  unsigned int h = Hash(Channel);
+  for (cDvbTransponderCacheEntry *Entry = entries.Get(h); Entry; Entry = entries.GetNext(h, Entry)) {
+      if (Entry->Matches(Channel))
+         return Entry->Provides();
+      }
+  return -1;
+}
+
+void cDvbTransponderCache::Put(const cChannel *Channel, bool Provides)
+{
+  cMutexLock MutexLock(&mutex);
+  if (numEntries >= MAXTRANSPONDERCACHE) {
+     entries.Clear(); // channel parameters have changed a lot, so let's start over
+     numEntries = 0;
+     }
+  entries.Add(new cDvbTransponderCacheEntry(Channel, Provides), Hash(Channel));
+  numEntries++;
+}
+
 // --- cDvbDevice ------------------------------------------------------------
 
 bool cDvbDevice::useDvbDevices = true;
@@ -1881,9 +2347,16 @@ cDvbDevice::cDvbDevice(int Adapter, int Frontend)
   frontend = Frontend;
   ciAdapter = NULL;
   dvbTuner = NULL;
+  transponderCache = new cDvbTransponderCache;
   bondedDevice = NULL;
   needsDetachBondedReceivers = false;
   tsBuffer = NULL;
+  useMmapTsBuffer = true;
+  tsCopy = NULL;
+  sectionBufferSize[sbSmall] = SB_SMALL_SECTIONS * MAX_SECTION_SIZE;
+  sectionBufferSize[sbMedium] = SB_MEDIUM_SECTIONS * MAX_SECTION_SIZE;
+  sectionBufferSize[sbLarge] = SB_LARGE_SECTIONS * MAX_SECTION_SIZE;
+  sectionOverflows = 0;
 
   // Common Interface:
 
@@ -1906,9 +2379,11 @@ cDvbDevice::cDvbDevice(int Adapter, int Frontend)
 cDvbDevice::~cDvbDevice()
 {
   delete dvbTuner;
+  delete transponderCache;
   delete ciAdapter;
   StopSectionHandler();
   UnBond();
+  free(tsCopy);
   // We're not explicitly closing any device files here, since this sometimes
   // caused segfaults. Besides, the program is about to terminate anyway...
 }
@@ -1976,8 +2451,22 @@ cString cDvbDevice::DeviceName(void) const
   return "";
 }
 
+int cDvbDevice::NumaNode(void) const
+{
+  int Node = -1;
+  cString FileName = cString::sprintf("/sys/class/dvb/dvb%d.frontend%d/device/numa_node", adapter, frontend);
+  if (FILE *f = fopen(FileName, "r")) {
+     cReadLine ReadLine;
+     if (char *s = ReadLine.Read(f))
+        Node = atoi(s); // -1 if the system doesn't have NUMA
+     fclose(f);
+     }
+  return Node;
+}
+
 bool cDvbDevice::Initialize(void)
 {
+  cStartupPhase StartupPhase("probe DVB devices");
   new cDvbSourceParam('A', "ATSC");
   new cDvbSourceParam('C', "DVB-C");
   new cDvbSourceParam('S', "DVB-S");
@@ -2039,6 +2528,39 @@ bool cDvbDevice::Initialize(void)
   return Found > 0;
 }
 
+class cDvbDeviceInitializer : public cTask {
+private:
+  bool result;
+protected:
+  virtual void Action(void) override { result = cDvbDevice::Initialize(); }
+public:
+  cDvbDeviceInitializer(void) : cTask(tpHigh) { result = false; }
+  bool Result(void) { Wait(); return result; }
+  };
+
+static cDvbDeviceInitializer *DvbDeviceInitializer = NULL;
+
+void cDvbDevice::StartInitialize(void)
+{
+  if (!DvbDeviceInitializer) {
+     DvbDeviceInitializer = new cDvbDeviceInitializer;
+     if (!DvbDeviceInitializer->Start()) {
+        delete DvbDeviceInitializer; // WaitInitialize() will do it the old way
+        DvbDeviceInitializer = NULL;
+        }
+     }
+}
+
+bool cDvbDevice::WaitInitialize(void)
+{
+  if (!DvbDeviceInitializer)
+     return Initialize();
+  bool Result = DvbDeviceInitializer->Result();
+  delete DvbDeviceInitializer;
+  DvbDeviceInitializer = NULL;
+  return Result;
+}
+
 bool cDvbDevice::BondDevices(const char *Bondings)
 {
   UnBondDevices();
@@ -2182,15 +2704,29 @@ bool cDvbDevice::SetPid(cPidHandle *Handle, int Type, bool On)
   return true;
 }
 
-#define RB_NUM_SECTIONS 8 // default: 2 sections = 8192 bytes
+int cDvbDevice::SectionBufferKind(u_short Pid)
+{
+  switch (Pid) {
+    case EITPID: return sbLarge;
+    case 0x0010: // NIT
+    case 0x0011: // SDT/BAT
+                 return sbMedium;
+    default: ;
+    }
+  return sbSmall;
+}
 
 int cDvbDevice::OpenFilter(u_short Pid, u_char Tid, u_char Mask)
 {
+  if (Setup.SectionFilters)
+     return cDevice::OpenFilter(Pid, Tid, Mask);
   cString FileName = DvbName(DEV_DVB_DEMUX, adapter, frontend);
   int f = open(FileName, O_RDWR | O_NONBLOCK);
   if (f >= 0) {
-     if (Pid == EITPID) { // increase ringbuffer size for EIT
-        if (ioctl(f, DMX_SET_BUFFER_SIZE, MAX_SECTION_SIZE * RB_NUM_SECTIONS) < 0)
+     cMutexLock MutexLock(&filterMutex);
+     int Kind = SectionBufferKind(Pid);
+     if (sectionBufferSize[Kind] != SB_DEFAULT_SECTIONS * MAX_SECTION_SIZE) {
+        if (ioctl(f, DMX_SET_BUFFER_SIZE, sectionBufferSize[Kind]) < 0)
            dsyslog("OpenFilter (pid=%d, tid=%02X): ioctl DMX_SET_BUFFER_SIZE failed", Pid, Tid);
         }
      dmx_sct_filter_params sctFilterParams;
@@ -2200,8 +2736,12 @@ int cDvbDevice::OpenFilter(u_short Pid, u_char Tid, u_char Mask)
      sctFilterParams.flags = DMX_IMMEDIATE_START;
      sctFilterParams.filter.filter[0] = Tid;
      sctFilterParams.filter.mask[0] = Mask;
-     if (ioctl(f, DMX_SET_FILTER, &sctFilterParams) >= 0)
+     if (ioctl(f, DMX_SET_FILTER, &sctFilterParams) >= 0) {
+        filterHandles.Append(f);
+        filterKinds.Append(Kind);
+        filterSizes.Append(sectionBufferSize[Kind]);
         return f;
+        }
      else {
         esyslog("ERROR: can't set filter (pid=%d, tid=%02X, mask=%02X): %m", Pid, Tid, Mask);
         close(f);
@@ -2212,9 +2752,45 @@ int cDvbDevice::OpenFilter(u_short Pid, u_char Tid, u_char Mask)
   return -1;
 }
 
+int cDvbDevice::ReadFilter(int Handle, void *Buffer, size_t Length)
+{
+  int r = cDevice::ReadFilter(Handle, Buffer, Length);
+  if (r < 0 && errno == EOVERFLOW) {
+     cMutexLock MutexLock(&filterMutex);
+     sectionOverflows++;
+     int i = filterHandles.IndexOf(Handle);
+     if (i >= 0) {
+        int Kind = filterKinds[i];
+        if (filterSizes[i] >= sectionBufferSize[Kind] && sectionBufferSize[Kind] < SB_MAX_SECTIONS * MAX_SECTION_SIZE) {
+           sectionBufferSize[Kind] *= 2;
+           dsyslog("device %d: section buffer overflow (%d so far), increasing buffer size of %s filters to %d", DeviceNumber() + 1, sectionOverflows, Kind == sbLarge ? "large" : Kind == sbMedium ? "medium" : "small", sectionBufferSize[Kind]);
+           }
+        if (filterSizes[i] < sectionBufferSize[Kind]) {
+           // The buffer size can only be changed while the filter is stopped:
+           CHECK(ioctl(Handle, DMX_STOP));
+           if (ioctl(Handle, DMX_SET_BUFFER_SIZE, sectionBufferSize[Kind]) < 0)
+              dsyslog("ReadFilter (handle=%d): ioctl DMX_SET_BUFFER_SIZE failed", Handle);
+           CHECK(ioctl(Handle, DMX_START));
+           filterSizes[i] = sectionBufferSize[Kind];
+           }
+        }
+     errno = EOVERFLOW;
+     }
+  return r;
+}
+
 void cDvbDevice::CloseFilter(int Handle)
 {
-  close(Handle);
+  {
+    cMutexLock MutexLock(&filterMutex);
+    int i = filterHandles.IndexOf(Handle);
+    if (i >= 0) {
+       filterHandles.Remove(i);
+       filterKinds.Remove(i);
+       filterSizes.Remove(i);
+       }
+  }
+  cDevice::CloseFilter(Handle);
 }
 
 bool cDvbDevice::ProvidesDeliverySystem(int DeliverySystem) const
@@ -2234,15 +2810,17 @@ bool cDvbDevice::ProvidesSource(int Source) const
 
 bool cDvbDevice::ProvidesTransponder(const cChannel *Channel) const
 {
-  if (!ProvidesSource(Channel->Source()))
-     return false; // doesn't provide source
-  if (!dvbTuner->ProvidesFrontend(Channel))
-     return false; // requires modulation system which frontend doesn't provide
-  cDvbTransponderParameters dtp(Channel->Parameters());
-  if (!cSource::IsSat(Channel->Source()) ||
-     (!Setup.DiSEqC || Diseqcs.Get(DeviceNumber() + 1, Channel->Source(), Channel->Frequency(), dtp.Polarization(), NULL)))
-     return DeviceHooksProvidesTransponder(Channel);
-  return false;
+  int Provides = transponderCache->Get(Channel);
+  if (Provides < 0) {
+     Provides = ProvidesSource(Channel->Source())     // doesn't provide source
+             && dvbTuner->ProvidesFrontend(Channel); // requires modulation system which frontend doesn't provide
+     if (Provides && cSource::IsSat(Channel->Source()) && Setup.DiSEqC) {
+        cDvbTransponderParameters dtp(Channel->Parameters());
+        Provides = Diseqcs.Get(DeviceNumber() + 1, Channel->Source(), Channel->Frequency(), dtp.Polarization(), NULL) != NULL;
+        }
+     transponderCache->Put(Channel, Provides);
+     }
+  return Provides && DeviceHooksProvidesTransponder(Channel); // device hooks may change their mind at any time
 }
 
 bool cDvbDevice::ProvidesChannel(const cChannel *Channel, int Priority, bool *NeedsDetachReceivers) const
@@ -2325,6 +2903,11 @@ int cDvbDevice::SignalQuality(void) const
   return dvbTuner ? dvbTuner->GetSignalQuality() : -1;
 }
 
+uint64_t cDvbDevice::SignalStatsTime(void) const
+{
+  return dvbTuner ? dvbTuner->SignalStatsTime() : 0;
+}
+
 const cChannel *cDvbDevice::GetCurrentlyTunedTransponder(void) const
 {
   return dvbTuner ? dvbTuner->GetTransponder() : NULL;
@@ -2368,8 +2951,19 @@ bool cDvbDevice::OpenDvr(void)
 {
   CloseDvr();
   fd_dvr = DvbOpen(DEV_DVB_DVR, adapter, frontend, O_RDONLY | O_NONBLOCK, true);
-  if (fd_dvr >= 0)
-     tsBuffer = new cTSBuffer(fd_dvr, TSBUFFERSIZE, DeviceNumber() + 1);
+  if (fd_dvr >= 0) {
+     if (useMmapTsBuffer) {
+        tsBuffer = cDvbTsMmapBuffer::Create(fd_dvr, DeviceNumber() + 1);
+        if (!tsBuffer) {
+           // fall back to read(), using a fresh file handle in case the driver has already been switched to streaming mode:
+           useMmapTsBuffer = false;
+           close(fd_dvr);
+           fd_dvr = DvbOpen(DEV_DVB_DVR, adapter, frontend, O_RDONLY | O_NONBLOCK, true);
+           }
+        }
+     if (fd_dvr >= 0 && !tsBuffer)
+        tsBuffer = new cTSBuffer(fd_dvr, TSBUFFERSIZE, DeviceNumber() + 1, NumaNode());
+     }
   return fd_dvr >= 0;
 }
 
@@ -2392,6 +2986,10 @@ bool cDvbDevice::GetTSPacket(uchar *&Data)
            Data = tsBuffer->Get(&Available, checkTsBuffer);
            if (!Data)
               Available = 0;
+           else if (useMmapTsBuffer) {
+              Available = TS_SIZE;
+              Data = WritableTsData(Data, Available);
+              }
            Data = cs->Decrypt(Data, Available);
            tsBuffer->Skip(Available);
            checkTsBuffer = Data != NULL;
@@ -2399,6 +2997,52 @@ bool cDvbDevice::GetTSPacket(uchar *&Data)
            }
         }
      Data = tsBuffer->Get();
+     if (Data && useMmapTsBuffer && CamSlot())
+        Data = WritableTsData(Data, TS_SIZE);
+     return true;
+     }
+  return false;
+}
+
+uchar *cDvbDevice::WritableTsData(uchar *Data, int Count)
+{
+  if (!tsCopy)
+     tsCopy = MALLOC(uchar, MAXTSBATCH * TS_SIZE);
+  if (!tsCopy)
+     return NULL;
+  memcpy(tsCopy, Data, min(Count, MAXTSBATCH * TS_SIZE));
+  return tsCopy;
+}
+
+bool cDvbDevice::GetTSPackets(uchar *&Data, int &Count)
+{
+  if (tsBuffer) {
+     if (cCamSlot *cs = CamSlot()) {
+        if (cs->WantsTsData()) {
+           int Available;
+           Data = tsBuffer->Get(&Available, checkTsBuffer);
+           if (!Data)
+              Available = 0;
+           else {
+              Available = TsSyncedLength(Data, min(Available, MAXTSBATCH * TS_SIZE));
+              if (useMmapTsBuffer)
+                 Data = WritableTsData(Data, Available);
+              }
+           Data = cs->Decrypt(Data, Available, Count);
+           tsBuffer->Skip(Available);
+           checkTsBuffer = Data != NULL;
+           return true;
+           }
+        }
+     int Available;
+     Data = tsBuffer->Get(&Available);
+     Count = 0;
+     if (Data) {
+        Count = TsSyncedLength(Data, min(Available, MAXTSBATCH * TS_SIZE));
+        tsBuffer->Skip(Count);
+        if (useMmapTsBuffer && CamSlot())
+           Data = WritableTsData(Data, Count);
+        }
      return true;
      }
   return false;
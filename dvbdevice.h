@@ -159,6 +159,7 @@ public:
   };
 
 class cDvbTuner;
+class cDvbTransponderCache;
 
 cString DvbName(const char *Name, int Adapter, int Frontend);
 int DvbOpen(const char *Name, int Adapter, int Frontend, int Mode, bool ReportError = false);
@@ -177,6 +178,15 @@ public:
          ///< Initializes the DVB devices.
          ///< Must be called before accessing any DVB functions.
          ///< Returns true if any devices are available.
+  static void StartInitialize(void);
+         ///< Runs Initialize() in the background, so that probing the DVB devices
+         ///< (which may take a while, depending on the drivers and the number of
+         ///< adapters) can be done while the configuration files are being read.
+         ///< Initialize() only depends on the setup parameters, so this must be
+         ///< called after setup.conf has been loaded.
+  static bool WaitInitialize(void);
+         ///< Waits until the Initialize() started by StartInitialize() has finished
+         ///< and returns its result. Must be called before accessing any devices.
 protected:
   int adapter, frontend;
   virtual bool IsBonded(void) const override { return bondedDevice; }
@@ -193,6 +203,7 @@ public:
   int Frontend(void) const;
   virtual cString DeviceType(void) const override;
   virtual cString DeviceName(void) const override;
+  virtual int NumaNode(void) const override;
   static bool BondDevices(const char *Bondings);
        ///< Bonds the devices as defined in the given Bondings string.
        ///< A bonding is a sequence of device numbers (starting at 1),
@@ -230,6 +241,7 @@ private:
 
 private:
   cDvbTuner *dvbTuner;
+  cDvbTransponderCache *transponderCache;
 public:
   virtual bool ProvidesDeliverySystem(int DeliverySystem) const;
   virtual bool ProvidesSource(int Source) const override;
@@ -241,6 +253,7 @@ public:
   virtual bool SignalStats(int &Valid, double *Strength = NULL, double *Cnr = NULL, double *BerPre = NULL, double *BerPost = NULL, double *Per = NULL, int *Status = NULL) const override;
   virtual int SignalStrength(void) const override;
   virtual int SignalQuality(void) const override;
+  virtual uint64_t SignalStatsTime(void) const override;
   virtual const cChannel *GetCurrentlyTunedTransponder(void) const override;
   virtual bool IsTunedToTransponder(const cChannel *Channel) const override;
   virtual bool MaySwitchTransponder(const cChannel *Channel) const override;
@@ -257,8 +270,24 @@ protected:
 
 // Section filter facilities
 
+private:
+  enum eSectionBufferKind { sbSmall, sbMedium, sbLarge, sbNumKinds };
+  cMutex filterMutex;
+  int sectionBufferSize[sbNumKinds];
+  int sectionOverflows;
+  cVector<int> filterHandles;
+  cVector<int> filterKinds;
+  cVector<int> filterSizes;
+  static int SectionBufferKind(u_short Pid);
+       ///< Returns the kind of demux buffer a section filter on the given Pid needs.
+       ///< The EIT gets a large one, the NIT and SDT of other transponders a medium
+       ///< one, and the small tables (PAT, PMT, TDT...) a small one.
 protected:
   virtual int OpenFilter(u_short Pid, u_char Tid, u_char Mask) override;
+  virtual int ReadFilter(int Handle, void *Buffer, size_t Length) override;
+       ///< If the demux buffer of the given filter overflowed, the buffer size for
+       ///< this kind of filter is doubled (up to a limit), and the filter is
+       ///< restarted with the new size.
   virtual void CloseFilter(int Handle) override;
 
 // Common Interface facilities:
@@ -282,10 +311,16 @@ public:
 
 private:
   cTSBuffer *tsBuffer;
+  bool useMmapTsBuffer;
+  uchar *tsCopy;
+  uchar *WritableTsData(uchar *Data, int Count);
+       ///< Returns a copy of the given TS Data, in case the tsBuffer delivers
+       ///< read-only data and a CAM slot needs to modify it.
 protected:
   virtual bool OpenDvr(void) override;
   virtual void CloseDvr(void) override;
   virtual bool GetTSPacket(uchar *&Data) override;
+  virtual bool GetTSPackets(uchar *&Data, int &Count) override;
   virtual void DetachAllReceivers(void) override;
   };
 
@@ -8,17 +8,28 @@
  */
 
 #include "dvbplayer.h"
+#include <atomic>
 #include <math.h>
 #include <stdlib.h>
+#include "membudget.h"
 #include "remux.h"
 #include "ringbuffer.h"
 #include "thread.h"
 #include "tools.h"
+#include "trace.h"
 
 // --- cPtsIndex -------------------------------------------------------------
 
 #define PTSINDEX_ENTRIES 1024
 
+// The PTS index is written by the player (Put() and Clear() are always called with
+// the player's thread lock held) and read by the main thread whenever the progress
+// display is updated. Readers don't lock anything - they take a snapshot of the entries
+// and check a sequence counter (which is odd while the index is being modified) to
+// make sure the snapshot is consistent, and repeat it otherwise. A writer never waits.
+// Note that the entries are in decoding order (and come in reverse order when playing
+// backwards), so they are not sorted by PTS and need to be searched linearly.
+
 class cPtsIndex {
 private:
   struct tPtsIndex {
@@ -26,10 +37,15 @@ private:
     int index;
     bool independent;
     };
-  tPtsIndex pi[PTSINDEX_ENTRIES];
-  int w, r;
-  int lastFound;
-  cMutex mutex;
+  std::atomic<uint64_t> pi[PTSINDEX_ENTRIES]; // pts (32 bit), index (31 bit), independent (1 bit)
+  std::atomic_int w, r;
+  std::atomic_uint seq;
+  std::atomic_int lastFound;
+  void BeginWrite(void);
+  void EndWrite(void);
+  int Snapshot(tPtsIndex *Entries);
+       ///< Copies the current entries into Entries (which must have room for
+       ///< PTSINDEX_ENTRIES), the oldest one first, and returns their number.
 public:
   cPtsIndex(void);
   void Clear(void);
@@ -41,49 +57,83 @@ public:
 
 cPtsIndex::cPtsIndex(void)
 {
+  seq = 0;
   lastFound = 0;
   Clear();
 }
 
+void cPtsIndex::BeginWrite(void)
+{
+  seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void cPtsIndex::EndWrite(void)
+{
+  seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+int cPtsIndex::Snapshot(tPtsIndex *Entries)
+{
+  for (;;) {
+      unsigned int Seq = seq.load(std::memory_order_acquire);
+      if (Seq & 1)
+         continue; // a write is in progress
+      int n = 0;
+      for (int i = r.load(std::memory_order_relaxed), Last = w.load(std::memory_order_relaxed); i != Last && n < PTSINDEX_ENTRIES; ) {
+          uint64_t e = pi[i].load(std::memory_order_relaxed);
+          Entries[n].pts = uint32_t(e >> 32);
+          Entries[n].index = int((e >> 1) & 0x7FFFFFFF);
+          Entries[n].independent = e & 1;
+          n++;
+          if (++i >= PTSINDEX_ENTRIES)
+             i = 0;
+          }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq.load(std::memory_order_relaxed) == Seq)
+         return n;
+      }
+}
+
 void cPtsIndex::Clear(void)
 {
-  cMutexLock MutexLock(&mutex);
+  BeginWrite();
   w = r = 0;
+  EndWrite();
 }
 
 bool cPtsIndex::IsEmpty(void)
 {
-  cMutexLock MutexLock(&mutex);
   return w == r;
 }
 
 void cPtsIndex::Put(uint32_t Pts, int Index, bool Independent)
 {
-  cMutexLock MutexLock(&mutex);
-  pi[w].pts = Pts;
-  pi[w].independent = Independent;
-  pi[w].index = Index;
-  w = (w + 1) % PTSINDEX_ENTRIES;
-  if (w == r)
+  BeginWrite();
+  int i = w;
+  pi[i].store((uint64_t(Pts) << 32) | (uint64_t(Index & 0x7FFFFFFF) << 1) | Independent, std::memory_order_relaxed);
+  i = (i + 1) % PTSINDEX_ENTRIES;
+  if (i == r)
      r = (r + 1) % PTSINDEX_ENTRIES;
+  w = i;
+  EndWrite();
 }
 
 int cPtsIndex::FindIndex(uint32_t Pts, bool Still)
 {
-  cMutexLock MutexLock(&mutex);
-  if (w == r || Pts == 0 && !Still) // while 0 is a valid PTS, DeviceGetSTC() might return 0 if, after a jump,  the device hasn't displayed a frame, yet
+  tPtsIndex Entries[PTSINDEX_ENTRIES];
+  int n = Snapshot(Entries);
+  if (n == 0 || Pts == 0 && !Still) // while 0 is a valid PTS, DeviceGetSTC() might return 0 if, after a jump,  the device hasn't displayed a frame, yet
      return lastFound; // list is empty, let's not jump way off the last known position
   uint32_t Delta = 0xFFFFFFFF;
   int Index = -1;
-  for (int i = w; i != r; ) {
-      if (--i < 0)
-         i = PTSINDEX_ENTRIES - 1;
-      uint32_t d = pi[i].pts < Pts ? Pts - pi[i].pts : pi[i].pts - Pts;
+  for (int i = n; i-- > 0; ) {
+      uint32_t d = Entries[i].pts < Pts ? Pts - Entries[i].pts : Entries[i].pts - Pts;
       if (d > 0x7FFFFFFF)
          d = 0xFFFFFFFF - d; // handle rollover
       if (d < Delta) {
          Delta = d;
-         Index = pi[i].index;
+         Index = Entries[i].index;
          }
       }
   lastFound = Index;
@@ -94,17 +144,18 @@ int cPtsIndex::FindFrameNumber(uint32_t Pts, bool Forward, bool Still)
 {
   if (!Forward)
      return FindIndex(Pts, Still); // there are only I frames in backward
-  cMutexLock MutexLock(&mutex);
-  if (w == r || Pts == 0 && !Still) // while 0 is a valid PTS, DeviceGetSTC() might return 0 if, after a jump,  the device hasn't displayed a frame, yet
+  tPtsIndex Entries[PTSINDEX_ENTRIES];
+  int n = Snapshot(Entries);
+  if (n == 0 || Pts == 0 && !Still) // while 0 is a valid PTS, DeviceGetSTC() might return 0 if, after a jump,  the device hasn't displayed a frame, yet
      return lastFound; // replay always starts at an I frame
   bool Valid = false;
   int FrameNumber = 0;
   int UnplayedIFrame = 2; // GOPs may intersect, so we loop until we processed a complete unplayed GOP
-  for (int i = r; i != w && UnplayedIFrame; ) {
-      int32_t d = int32_t(Pts - pi[i].pts); // typecast handles rollover
+  for (int i = 0; i < n && UnplayedIFrame; i++) {
+      int32_t d = int32_t(Pts - Entries[i].pts); // typecast handles rollover
       if (d >= 0) {
-         if (pi[i].independent) {
-            FrameNumber = pi[i].index; // an I frame's index represents its frame number
+         if (Entries[i].independent) {
+            FrameNumber = Entries[i].index; // an I frame's index represents its frame number
             Valid = true;
             if (d == 0)
                UnplayedIFrame = 1; // if Pts is at an I frame we only need to check up to the next I frame
@@ -112,10 +163,8 @@ int cPtsIndex::FindFrameNumber(uint32_t Pts, bool Forward, bool Still)
          else
             FrameNumber++; // for every played non-I frame, increase frame number
          }
-      else if (pi[i].independent)
+      else if (Entries[i].independent)
          --UnplayedIFrame;
-      if (++i >= PTSINDEX_ENTRIES)
-         i = 0;
       }
   if (Valid) {
      lastFound = FrameNumber;
@@ -126,33 +175,61 @@ int cPtsIndex::FindFrameNumber(uint32_t Pts, bool Forward, bool Still)
 
 // --- cNonBlockingFileReader ------------------------------------------------
 
+#define MAXPREFETCH 32 // max. number of pending prefetch requests
+
 class cNonBlockingFileReader : public cThread {
 private:
+  cFramePool *pool;
   cUnbufferedFile *f;
   uchar *buffer;
   int wanted;
   int length;
+  struct tPrefetch {
+    off_t offset;
+    int length;
+    };
+  cUnbufferedFile *prefetchFile;
+  tPrefetch prefetch[MAXPREFETCH];
+  int prefetchHead;
+  int prefetchCount;
+  cMutex prefetchMutex;
   cCondWait newSet;
   cCondVar newDataCond;
   cMutex newDataMutex;
 protected:
   void Action(void);
 public:
-  cNonBlockingFileReader(void);
+  cNonBlockingFileReader(cFramePool *Pool);
+       ///< The buffers for the data are allocated from the given Pool.
   ~cNonBlockingFileReader();
   void Clear(void);
   void Request(cUnbufferedFile *File, int Length);
   int Result(uchar **Buffer);
+       ///< If the requested data has been read completely, a pointer to it is returned
+       ///< in Buffer, and the caller takes ownership of it (it must be given back with
+       ///< Pool->Free()).
   bool Reading(void) { return buffer; }
   bool WaitForDataMs(int msToWait);
+  void Prefetch(cUnbufferedFile *File, off_t Offset, int Length);
+       ///< Makes the kernel read Length bytes at the given Offset of File into the page
+       ///< cache in the background, so that a later Request() for that data can be served
+       ///< without having to wait for the disk (or the network). Pending prefetches are
+       ///< handled in the order they were given, whenever there is no Request() to serve.
+       ///< If there are already MAXPREFETCH prefetches pending, the oldest one is dropped.
+  void CancelPrefetch(void);
+       ///< Discards all pending prefetches. Must be called before the File given to
+       ///< Prefetch() is closed.
   };
 
-cNonBlockingFileReader::cNonBlockingFileReader(void)
+cNonBlockingFileReader::cNonBlockingFileReader(cFramePool *Pool)
 :cThread("non blocking file reader")
 {
+  pool = Pool;
   f = NULL;
   buffer = NULL;
   wanted = length = 0;
+  prefetchFile = NULL;
+  prefetchHead = prefetchCount = 0;
   Start();
 }
 
@@ -160,25 +237,27 @@ cNonBlockingFileReader::~cNonBlockingFileReader()
 {
   newSet.Signal();
   Cancel(3);
-  free(buffer);
+  pool->Free(buffer);
 }
 
 void cNonBlockingFileReader::Clear(void)
 {
   Lock();
   f = NULL;
-  free(buffer);
+  pool->Free(buffer);
   buffer = NULL;
   wanted = length = 0;
+  CancelPrefetch();
   Unlock();
 }
 
 void cNonBlockingFileReader::Request(cUnbufferedFile *File, int Length)
 {
   Lock();
-  Clear();
+  pool->Free(buffer);
+  length = 0;
   wanted = Length;
-  buffer = MALLOC(uchar, wanted);
+  buffer = pool->Alloc(wanted);
   f = File;
   Unlock();
   newSet.Signal();
@@ -188,7 +267,10 @@ int cNonBlockingFileReader::Result(uchar **Buffer)
 {
   LOCK_THREAD;
   if (buffer && length == wanted) {
-     *Buffer = buffer;
+     if (wanted > 0)
+        *Buffer = buffer;
+     else
+        pool->Free(buffer); // EOF or error
      buffer = NULL;
      return wanted;
      }
@@ -196,6 +278,31 @@ int cNonBlockingFileReader::Result(uchar **Buffer)
   return -1;
 }
 
+void cNonBlockingFileReader::Prefetch(cUnbufferedFile *File, off_t Offset, int Length)
+{
+  prefetchMutex.Lock();
+  if (File != prefetchFile) {
+     prefetchFile = File;
+     prefetchHead = prefetchCount = 0;
+     }
+  if (prefetchCount == MAXPREFETCH) {
+     prefetchHead = (prefetchHead + 1) % MAXPREFETCH;
+     prefetchCount--;
+     }
+  tPrefetch &p = prefetch[(prefetchHead + prefetchCount++) % MAXPREFETCH];
+  p.offset = Offset;
+  p.length = Length;
+  prefetchMutex.Unlock();
+  newSet.Signal();
+}
+
+void cNonBlockingFileReader::CancelPrefetch(void)
+{
+  cMutexLock PrefetchLock(&prefetchMutex);
+  prefetchFile = NULL;
+  prefetchHead = prefetchCount = 0;
+}
+
 void cNonBlockingFileReader::Action(void)
 {
   while (Running()) {
@@ -219,8 +326,22 @@ void cNonBlockingFileReader::Action(void)
               newDataCond.Broadcast();
               }
            }
+        bool Busy = f && buffer && length < wanted;
         Unlock();
-        newSet.Wait(1000);
+        // Prefetching is done only if there is nothing else to read, and it doesn't
+        // lock the thread, so that Request() can be called at any time:
+        bool Prefetching = false;
+        if (!Busy) {
+           cMutexLock PrefetchLock(&prefetchMutex);
+           if (prefetchCount > 0) {
+              tPrefetch &p = prefetch[prefetchHead];
+              prefetchFile->Prefetch(p.offset, p.length);
+              prefetchHead = (prefetchHead + 1) % MAXPREFETCH;
+              Prefetching = --prefetchCount > 0;
+              }
+           }
+        if (!Prefetching)
+           newSet.Wait(1000);
         }
 }
 
@@ -232,9 +353,172 @@ bool cNonBlockingFileReader::WaitForDataMs(int msToWait)
   return newDataCond.TimedWait(newDataMutex, msToWait);
 }
 
+// --- cReplayCache ----------------------------------------------------------
+
+#define REPLAYCACHEDELAY 250 // ms to wait before loading, so that we don't load every recording the user just scrolls past
+
+class cReplayCache : public cThread {
+private:
+  cMutex mutex;
+  cCondWait newRequest;
+  cString requested; // the recording that shall be loaded
+  cString fileName;  // the recording the cached frame belongs to
+  int index;
+  uint16_t fileNumber;
+  off_t fileOffset;
+  int wanted;
+  int length;
+  uchar *data;
+  void Clear(void);
+  void Load(const char *FileName);
+protected:
+  virtual void Action(void) override;
+public:
+  cReplayCache(void);
+  virtual ~cReplayCache() override;
+  void Preload(const char *FileName);
+       ///< Loads the frame at which replay of the recording with the given FileName
+       ///< will start (in the background). Only the most recently given recording
+       ///< is kept.
+  int Get(const char *FileName, int Index, uint16_t FileNumber, off_t FileOffset, int Length, uchar **Data);
+       ///< If the frame with the given Index at FileNumber/FileOffset of the recording
+       ///< with the given FileName has been loaded (requesting Length bytes), a pointer
+       ///< to its data is returned in Data, and the caller takes ownership of it (it
+       ///< must be given back with free()). Returns the number of bytes in Data, or 0
+       ///< if the frame isn't in the cache.
+  };
+
+static cReplayCache ReplayCache;
+
+cReplayCache::cReplayCache(void)
+:cThread("replay cache")
+{
+  index = -1;
+  fileNumber = 0;
+  fileOffset = 0;
+  wanted = length = 0;
+  data = NULL;
+}
+
+cReplayCache::~cReplayCache()
+{
+  newRequest.Signal();
+  Cancel(3);
+  free(data);
+}
+
+void cReplayCache::Clear(void)
+{
+  fileName = NULL;
+  index = -1;
+  free(data);
+  data = NULL;
+}
+
+void cReplayCache::Preload(const char *FileName)
+{
+  cMutexLock MutexLock(&mutex);
+  if (FileName && !(*requested && strcmp(requested, FileName) == 0) && !(*fileName && strcmp(fileName, FileName) == 0)) {
+     requested = FileName;
+     if (!Active())
+        Start();
+     newRequest.Signal();
+     }
+}
+
+int cReplayCache::Get(const char *FileName, int Index, uint16_t FileNumber, off_t FileOffset, int Length, uchar **Data)
+{
+  cMutexLock MutexLock(&mutex);
+  int Result = 0;
+  if (data && *fileName && strcmp(fileName, FileName) == 0 && index == Index && fileNumber == FileNumber && fileOffset == FileOffset && wanted == Length) {
+     *Data = data;
+     data = NULL;
+     Result = length;
+     dsyslog("replay of %s starts with cached frame %d", FileName, Index);
+     }
+  Clear();
+  return Result;
+}
+
+void cReplayCache::Load(const char *FileName)
+{
+  // This needs to do the same steps as cDvbPlayer does when it starts replay, so
+  // that it ends up at the same frame:
+  cRecording Recording(FileName);
+  bool IsPesRecording = Recording.IsPesRecording();
+  cIndexFile IndexFile(FileName, false, IsPesRecording);
+  if (!IndexFile.Ok())
+     return;
+  int Index = IndexFile.GetResume();
+  if (Index < 0 && Setup.SkipEdited) {
+     cMarks Marks;
+     if (Marks.Load(FileName, Recording.FramesPerSecond(), IsPesRecording) && Marks.First())
+        Index = Marks.First()->Position();
+     }
+  if (Index <= 0)
+     Index++; // see cDvbPlayer::Action()
+  uint16_t FileNumber;
+  off_t FileOffset;
+  int Length;
+  if (!IndexFile.Get(Index, &FileNumber, &FileOffset, NULL, &Length))
+     return;
+  if (Length == -1 || Length > MAXFRAMESIZE)
+     Length = MAXFRAMESIZE;
+  cFileName File(FileName, false, false, IsPesRecording);
+  cUnbufferedFile *f = File.SetOffset(FileNumber, FileOffset);
+  if (!f)
+     return;
+  uchar *b = MALLOC(uchar, Length);
+  if (!b)
+     return;
+  int n = 0;
+  while (n < Length && Running()) {
+        int r = f->Read(b + n, Length - n);
+        if (r <= 0) {
+           if (r < 0 && FATALERRNO)
+              LOG_ERROR;
+           break;
+           }
+        n += r;
+        }
+  cMutexLock MutexLock(&mutex);
+  if (n > 0 && *requested && strcmp(requested, FileName) == 0) {
+     Clear();
+     fileName = FileName;
+     index = Index;
+     fileNumber = FileNumber;
+     fileOffset = FileOffset;
+     wanted = Length;
+     length = n;
+     data = b;
+     requested = NULL;
+     }
+  else
+     free(b);
+}
+
+void cReplayCache::Action(void)
+{
+  while (Running()) {
+        if (newRequest.Wait(1000)) {
+           while (newRequest.Wait(REPLAYCACHEDELAY) && Running())
+                 ; // the user is still moving through the list of recordings
+           cString FileName;
+           {
+             cMutexLock MutexLock(&mutex);
+             FileName = requested;
+           }
+           if (*FileName)
+              Load(FileName);
+           }
+        }
+}
+
 // --- cDvbPlayer ------------------------------------------------------------
 
 #define PLAYERBUFSIZE  (MAXFRAMESIZE * 5)
+#define PLAYERBUFSIZEMIN (MAXFRAMESIZE * 2) // if the memory budget is tight
+#define FRAMEPOOLEXTRA (2 * MAXFRAMESIZE) // the frame pool holds the frames in the ring buffer, plus the one being read and the one being played
 
 #define RESUMEBACKUP 10 // number of seconds to back up when resuming an interrupted replay session
 #define MAXSTUCKATEOF 3 // max. number of seconds to wait in case the device doesn't play the last frame
@@ -244,12 +528,16 @@ private:
   enum ePlayModes { pmPlay, pmPause, pmSlow, pmFast, pmStill };
   enum ePlayDirs { pdForward, pdBackward };
   static int Speeds[];
+  cMemoryClient *memory;
+  cFramePool *framePool;
   cNonBlockingFileReader *nonBlockingFileReader;
   cRingBufferFrame *ringBuffer;
   cPtsIndex ptsIndex;
   const cMarks *marks;
   cFileName *fileName;
   cIndexFile *index;
+  cIFrameFile *iFrameFile;
+  cTimeIndexFile *timeIndexFile;
   cUnbufferedFile *replayFile;
   double framesPerSecond;
   bool isPesRecording;
@@ -260,14 +548,31 @@ private:
   ePlayDirs playDir;
   int trickSpeed;
   int readIndex;
+  int prefetchIndex;
+  int gopFirst;
+  int gopLast;
+  int firstFileNumber;
+  int firstIndex;
   bool readIndependent;
   cFrame *readFrame;
   cFrame *playFrame;
   cFrame *dropFrame;
   bool resyncAfterPause;
+  cString recordingName;
   void TrickSpeed(int Increment);
   void Empty(void);
   bool NextFile(uint16_t FileNumber = 0, off_t FileOffset = -1);
+  int FirstIndex(void);
+       ///< Returns the index of the first frame that is still available. This is
+       ///< only different from 0 in a time shift buffer, the oldest files of which
+       ///< are removed while it is being replayed.
+  void Prefetch(bool TrickMode);
+  int NextReverseFrame(uint16_t *FileNumber, off_t *FileOffset, bool *Independent, int *Length);
+       ///< Returns the index of the next frame to read in reverse trick mode on a
+       ///< device that can handle all frames in trick mode. The GOPs are taken in
+       ///< reverse order, but the frames within each GOP are delivered in decoding
+       ///< order, so the device can decode them without a reset after every I-frame.
+       ///< Returns -1 if the beginning of the recording has been reached.
   int Resume(void);
   bool Save(void);
 protected:
@@ -284,6 +589,7 @@ public:
   void Backward(void);
   int SkipFrames(int Frames);
   void SkipSeconds(int Seconds);
+  int SecondsToIndex(int Seconds);
   void Goto(int Position, bool Still = false);
   virtual double FramesPerSecond(void) { return framesPerSecond; }
   virtual void SetAudioTrack(eTrackType Type, const tTrackId *TrackId) override;
@@ -302,10 +608,14 @@ int cDvbPlayer::Speeds[] = { 0, -2, -4, -8, 1, 2, 4, 12, 0 };
 cDvbPlayer::cDvbPlayer(const char *FileName, bool PauseLive)
 :cThread("dvbplayer")
 {
+  memory = new cMemoryClient("Player", mpPlayback, PLAYERBUFSIZEMIN, PLAYERBUFSIZE, PLAYERBUFSIZE);
+  framePool = new cFramePool(memory->Size() + FRAMEPOOLEXTRA);
   nonBlockingFileReader = NULL;
   ringBuffer = NULL;
   marks = NULL;
   index = NULL;
+  iFrameFile = NULL;
+  timeIndexFile = NULL;
   cRecording Recording(FileName);
   framesPerSecond = Recording.FramesPerSecond();
   isPesRecording = Recording.IsPesRecording();
@@ -316,17 +626,22 @@ cDvbPlayer::cDvbPlayer(const char *FileName, bool PauseLive)
   playDir = pdForward;
   trickSpeed = NORMAL_SPEED;
   readIndex = -1;
+  prefetchIndex = -1;
+  gopFirst = gopLast = -1;
+  firstFileNumber = 1;
+  firstIndex = 0;
   readIndependent = false;
   readFrame = NULL;
   playFrame = NULL;
   dropFrame = NULL;
   resyncAfterPause = false;
   isyslog("replay %s", FileName);
+  recordingName = FileName;
   fileName = new cFileName(FileName, false, false, isPesRecording);
   replayFile = fileName->Open();
   if (!replayFile)
      return;
-  ringBuffer = new cRingBufferFrame(PLAYERBUFSIZE);
+  ringBuffer = new cRingBufferFrame(memory->Size(), false, "Player");
   // Create the index file:
   index = new cIndexFile(FileName, false, isPesRecording, pauseLive);
   if (!index)
@@ -344,9 +659,13 @@ cDvbPlayer::~cDvbPlayer()
   Save();
   Detach();
   delete readFrame; // might not have been stored in the buffer in Action()
+  delete iFrameFile;
+  delete timeIndexFile;
   delete index;
   delete fileName;
   delete ringBuffer;
+  delete framePool; // must be deleted after all frames
+  delete memory;
   // don't delete marks here, we don't own them!
 }
 
@@ -386,6 +705,7 @@ void cDvbPlayer::Empty(void)
   readFrame = NULL;
   playFrame = NULL;
   dropFrame = NULL;
+  gopFirst = gopLast = -1;
   ringBuffer->Clear();
   ptsIndex.Clear();
   DeviceClear();
@@ -394,6 +714,8 @@ void cDvbPlayer::Empty(void)
 
 bool cDvbPlayer::NextFile(uint16_t FileNumber, off_t FileOffset)
 {
+  if (nonBlockingFileReader && (FileNumber > 0 ? FileNumber != fileName->Number() : replayFile && eof))
+     nonBlockingFileReader->CancelPrefetch(); // the current file will be closed
   if (FileNumber > 0)
      replayFile = fileName->SetOffset(FileNumber, FileOffset);
   else if (replayFile && eof)
@@ -402,6 +724,83 @@ bool cDvbPlayer::NextFile(uint16_t FileNumber, off_t FileOffset)
   return replayFile != NULL;
 }
 
+int cDvbPlayer::FirstIndex(void)
+{
+  if (pauseLive && index) {
+     uint16_t FileNumber;
+     off_t FileOffset;
+     if (index->Get(index->Last(), &FileNumber, &FileOffset)) {
+        int Number = firstFileNumber;
+        while (Number < FileNumber && !fileName->Exists(Number))
+              Number++;
+        if (Number != firstFileNumber) {
+           firstFileNumber = Number;
+           firstIndex = max(index->Get(uint16_t(Number), 0), 0);
+           }
+        }
+     }
+  return firstIndex;
+}
+
+#define PREFETCHFRAMES 16 // number of frames to prefetch ahead of the current read position
+
+void cDvbPlayer::Prefetch(bool TrickMode)
+{
+  // Keeps a window of PREFETCHFRAMES frames (or I-frames in trick mode) in the current
+  // play direction prefetched, so that reading them later doesn't have to wait for the
+  // disk or the network:
+  int d = 1;
+  if (TrickMode) {
+     d = int(round(0.4 * framesPerSecond)); // the same as in Action()
+     if (playDir != pdForward)
+        d = -d;
+     }
+  int Window = PREFETCHFRAMES * abs(d);
+  int Ahead = d > 0 ? prefetchIndex - readIndex : readIndex - prefetchIndex;
+  if (Ahead <= 0 || Ahead > 2 * Window)
+     prefetchIndex = readIndex; // we've jumped or changed direction, so we start over
+  while (abs(prefetchIndex - readIndex) < Window) {
+        uint16_t FileNumber;
+        off_t FileOffset;
+        int Length;
+        int Index = -1;
+        if (TrickMode)
+           Index = index->GetNextIFrame(prefetchIndex + d, d > 0, &FileNumber, &FileOffset, &Length);
+        else if (index->Get(prefetchIndex + 1, &FileNumber, &FileOffset, NULL, &Length))
+           Index = prefetchIndex + 1;
+        if (Index < 0 || (Index - prefetchIndex) * d <= 0 || FileNumber != fileName->Number())
+           break; // frames in other files will be prefetched once we get there
+        nonBlockingFileReader->Prefetch(replayFile, FileOffset, Length > 0 ? Length : MAXFRAMESIZE);
+        prefetchIndex = Index;
+        }
+}
+
+int cDvbPlayer::NextReverseFrame(uint16_t *FileNumber, off_t *FileOffset, bool *Independent, int *Length)
+{
+  if (gopFirst < 0 || readIndex >= gopLast) {
+     // The current GOP has been delivered completely, so we go back to the one before it:
+     int End = gopFirst < 0 ? readIndex + 1 : gopFirst;
+     int Start = End > 0 ? index->GetNextIFrame(End, false) : -1;
+     if (Start < 0)
+        return -1;
+     gopFirst = Start;
+     gopLast = End - 1;
+     readIndex = Start - 1;
+     // The frames of a GOP are stored contiguously, so the whole GOP can be fetched
+     // with a single sequential read instead of seeking to every frame:
+     uint16_t FirstNumber, LastNumber;
+     off_t FirstOffset, LastOffset;
+     int LastLength;
+     if (index->Get(gopFirst, &FirstNumber, &FirstOffset) && index->Get(gopLast, &LastNumber, &LastOffset, NULL, &LastLength)) {
+        if (FirstNumber == LastNumber && LastLength > 0 && NextFile(FirstNumber, FirstOffset))
+           nonBlockingFileReader->Prefetch(replayFile, FirstOffset, int(LastOffset - FirstOffset) + LastLength);
+        }
+     }
+  if (index->Get(readIndex + 1, FileNumber, FileOffset, Independent, Length))
+     return readIndex + 1;
+  return -1;
+}
+
 int cDvbPlayer::Resume(void)
 {
   if (index) {
@@ -475,7 +874,7 @@ void cDvbPlayer::Action(void)
   if (readIndex > 0) // will first be incremented in the loop!
      --readIndex;
 
-  nonBlockingFileReader = new cNonBlockingFileReader;
+  nonBlockingFileReader = new cNonBlockingFileReader(framePool);
   int Length = 0;
   bool Sleep = false;
   bool WaitingForData = false;
@@ -506,6 +905,8 @@ void cDvbPlayer::Action(void)
           if (playMode != pmStill && playMode != pmPause) {
              if (!readFrame && (replayFile || readIndex >= 0)) {
                 if (!nonBlockingFileReader->Reading() && !AtLastMark) {
+                   bool TrickMode = false;
+                   cUnbufferedFile *IFrameFile = NULL;
                    if (!SwitchToPlayFrame && (playMode == pmFast || (playMode == pmSlow && playDir == pdBackward))) {
                       uint16_t FileNumber;
                       off_t FileOffset;
@@ -516,6 +917,8 @@ void cDvbPlayer::Action(void)
                          if (index->Get(readIndex + 1, &FileNumber, &FileOffset, &readIndependent, &Length))
                             Index = readIndex + 1;
                          }
+                      else if (DeviceHasIBPTrickSpeed())
+                         Index = NextReverseFrame(&FileNumber, &FileOffset, &readIndependent, &Length);
                       else {
                          int d = int(round(0.4 * framesPerSecond));
                          if (playDir != pdForward)
@@ -528,10 +931,19 @@ void cDvbPlayer::Action(void)
                             SwitchToPlayFrame = readIndex;
                          Index = NewIndex;
                          readIndependent = true;
+                         TrickMode = true;
                          }
+                      if (pauseLive && Index >= 0 && Index < FirstIndex())
+                         Index = -1; // the beginning of the time shift buffer has been reached
                       if (Index >= 0) {
                          readIndex = Index;
-                         if (!NextFile(FileNumber, FileOffset))
+                         if (TrickMode && !TimeShiftMode) {
+                            // Reading the I-frames sequentially from a separate file avoids seeking all over the recording:
+                            if (!iFrameFile)
+                               iFrameFile = new cIFrameFile(recordingName, index, isPesRecording);
+                            IFrameFile = iFrameFile->Seek(Index, Length);
+                            }
+                         if (!IFrameFile && !NextFile(FileNumber, FileOffset))
                             continue;
                          }
                       else if (!(TimeShiftMode && playDir == pdForward))
@@ -540,6 +952,8 @@ void cDvbPlayer::Action(void)
                    else if (index) {
                       uint16_t FileNumber;
                       off_t FileOffset;
+                      if (pauseLive && readIndex + 1 < FirstIndex())
+                         readIndex = FirstIndex() - 1; // continue with the oldest frame still in the time shift buffer
                       if (index->Get(readIndex + 1, &FileNumber, &FileOffset, &readIndependent, &Length) && NextFile(FileNumber, FileOffset)) {
                          readIndex++;
                          if ((Setup.SkipEdited || Setup.PauseAtLastMark) && marks) {
@@ -577,17 +991,35 @@ void cDvbPlayer::Action(void)
                       esyslog("ERROR: frame larger than buffer (%d > %d)", Length, MAXFRAMESIZE);
                       Length = MAXFRAMESIZE;
                       }
-                   if (!eof)
-                      nonBlockingFileReader->Request(replayFile, Length);
+                   if (!eof) {
+                      if (LastReadFrame < 0 && index && !pauseLive) {
+                         // The very first frame might have been loaded while the user was still selecting the recording:
+                         uint16_t FileNumber;
+                         off_t FileOffset;
+                         uchar *b = NULL;
+                         int r = 0;
+                         if (index->Get(readIndex, &FileNumber, &FileOffset))
+                            r = ReplayCache.Get(recordingName, readIndex, FileNumber, FileOffset, Length, &b);
+                         if (r > 0) {
+                            LastReadFrame = readIndex;
+                            uint32_t Pts = isPesRecording ? (PesHasPts(b) ? PesGetPts(b) : -1) : TsGetPts(b, r);
+                            readFrame = new cFrame(b, -r, ftUnknown, readIndex, Pts, readIndependent); // not allocated from framePool!
+                            }
+                         }
+                      if (!readFrame)
+                         nonBlockingFileReader->Request(IFrameFile ? IFrameFile : replayFile, Length);
+                      if (index && !IFrameFile && gopFirst < 0)
+                         Prefetch(TrickMode);
+                      }
                    }
-                if (!eof) {
+                if (!eof && !readFrame) {
                    uchar *b = NULL;
                    int r = nonBlockingFileReader->Result(&b);
                    if (r > 0) {
                       WaitingForData = false;
                       LastReadFrame = readIndex;
                       uint32_t Pts = isPesRecording ? (PesHasPts(b) ? PesGetPts(b) : -1) : TsGetPts(b, r);
-                      readFrame = new cFrame(b, -r, ftUnknown, readIndex, Pts, readIndependent); // hands over b to the ringBuffer
+                      readFrame = new cFrame(b, -r, ftUnknown, readIndex, Pts, readIndependent, framePool); // hands over b to the ringBuffer
                       }
                    else if (r < 0) {
                       if (errno == EAGAIN)
@@ -663,6 +1095,7 @@ void cDvbPlayer::Action(void)
                    w = PlayPes(p, pc, VideoOnly);
                 else
                    w = PlayTs(p, pc, VideoOnly);
+                VDR_TRACE(player_submit, playFrame->Index(), pc, w, VideoOnly);
                 if (w > 0) {
                    p += w;
                    pc -= w;
@@ -891,16 +1324,41 @@ void cDvbPlayer::SkipSeconds(int Seconds)
      int Index = ptsIndex.FindIndex(DeviceGetSTC(), playMode == pmStill);
      Empty();
      if (Index >= 0) {
-        Index = max(Index + SecondsToFrames(Seconds, framesPerSecond), 0);
-        if (Index > 0)
-           Index = index->GetNextIFrame(Index, false, NULL, NULL, NULL);
+        int TimeIndex = -1;
+        if (!pauseLive) {
+           if (!timeIndexFile)
+              timeIndexFile = new cTimeIndexFile(recordingName, index, isPesRecording);
+           int s = timeIndexFile->GetSeconds(Index);
+           if (s >= 0)
+              TimeIndex = timeIndexFile->GetIndex(max(s + Seconds, 0));
+           }
+        if (TimeIndex >= 0)
+           Index = TimeIndex;
+        else {
+           Index = max(Index + SecondsToFrames(Seconds, framesPerSecond), 0);
+           if (Index > 0)
+              Index = index->GetNextIFrame(Index, false, NULL, NULL, NULL);
+           }
         if (Index >= 0)
-           readIndex = Index - 1; // Action() will first increment it!
+           readIndex = max(Index, FirstIndex()) - 1; // Action() will first increment it!
         }
      Play();
      }
 }
 
+int cDvbPlayer::SecondsToIndex(int Seconds)
+{
+  if (index && !pauseLive) {
+     LOCK_THREAD;
+     if (!timeIndexFile)
+        timeIndexFile = new cTimeIndexFile(recordingName, index, isPesRecording);
+     int Index = timeIndexFile->GetIndex(Seconds);
+     if (Index >= 0)
+        return Index;
+     }
+  return SecondsToFrames(Seconds, framesPerSecond);
+}
+
 void cDvbPlayer::Goto(int Index, bool Still)
 {
   if (index) {
@@ -908,6 +1366,7 @@ void cDvbPlayer::Goto(int Index, bool Still)
      Empty();
      if (++Index <= 0)
         Index = 1; // not '0', to allow GetNextIFrame() below to work!
+     Index = max(Index, FirstIndex() + 1); // every file begins with an I-frame
      uint16_t FileNumber;
      off_t FileOffset;
      int Length;
@@ -1020,6 +1479,11 @@ bool cDvbPlayerControl::Active(void)
   return player && player->Active();
 }
 
+void cDvbPlayerControl::Preload(const char *FileName)
+{
+  ReplayCache.Preload(FileName);
+}
+
 void cDvbPlayerControl::Stop(void)
 {
   cControl::player = NULL;
@@ -1057,6 +1521,13 @@ void cDvbPlayerControl::SkipSeconds(int Seconds)
      player->SkipSeconds(Seconds);
 }
 
+int cDvbPlayerControl::SecondsToIndex(int Seconds)
+{
+  if (player)
+     return player->SecondsToIndex(Seconds);
+  return -1;
+}
+
 int cDvbPlayerControl::SkipFrames(int Frames)
 {
   if (player)
@@ -28,6 +28,10 @@ public:
   virtual ~cDvbPlayerControl() override;
   void SetMarks(const cMarks *Marks);
   bool Active(void);
+  static void Preload(const char *FileName);
+       // Loads the first frame of the recording with the given FileName in the
+       // background, so that a replay session that is started for it later can
+       // display it immediately. Only the most recently given recording is kept.
   void Stop(void);
        // Stops the current replay session (if any).
   void Pause(void);
@@ -47,6 +51,10 @@ public:
        // The sign of 'Seconds' determines the direction in which to skip.
        // Use a very large negative value to go all the way back to the
        // beginning of the recording.
+  int  SecondsToIndex(int Seconds);
+       // Returns the index of the frame at which the given number of Seconds into
+       // the current replay session are reached. If the recording has a time index,
+       // this is exact even if its frame rate varies.
   const cErrors *GetErrors(void);
        // Returns the frame indexes of errors in the recording (if any).
   bool GetIndex(int &Current, int &Total, bool SnapToIFrame = false);
@@ -162,34 +162,47 @@ void cDvbSpuBitmap::putPixel(int xp, int yp, int len, uint8_t colorid)
     setMax(minsize[colorid].y2, yp);
 }
 
-static uint8_t getBits(uint8_t * &data, uint8_t & bitf)
+// Returns the 16 bits starting at the given nibble position; any data
+// beyond endp is returned as 0:
+static inline uint16_t getWindow(const uint8_t *data, const uint8_t *endp, int nibble)
 {
-    uint8_t ret = *data;
-    if (bitf)
-        ret >>= 4;
-    else
-        data++;
-    bitf ^= 1;
-
-    return (ret & 0xf);
+    const uint8_t *p = data + (nibble >> 1);
+    uint32_t w = p[0] << 16;
+    if (p + 1 < endp) {
+        w |= p[1] << 8;
+        if (p + 2 < endp)
+            w |= p[2];
+    }
+    return (w >> (8 - 4 * (nibble & 1))) & 0xFFFF;
 }
 
 void cDvbSpuBitmap::putFieldData(int field, uint8_t * data, uint8_t * endp)
 {
     int xp = bmpsize.x1;
     int yp = bmpsize.y1 + field;
-    uint8_t bitf = 1;
-
-    while (data < endp) {
-        uint16_t vlc = getBits(data, bitf);
-        if (vlc < 0x0004) {
-            vlc = (vlc << 4) | getBits(data, bitf);
-            if (vlc < 0x0010) {
-                vlc = (vlc << 4) | getBits(data, bitf);
-                if (vlc < 0x0040) {
-                    vlc = (vlc << 4) | getBits(data, bitf);
-                }
-            }
+    int nibble = 0;
+
+    // Each run length code takes 1 to 4 nibbles, depending on its leading
+    // zeros. Instead of reading the code nibble by nibble, look at 16 bits
+    // at once and take as many of them as the code needs:
+    while (data + (nibble >> 1) < endp) {
+        uint16_t w = getWindow(data, endp, nibble);
+        uint16_t vlc;
+        if (w >= 0x4000) {
+            vlc = w >> 12;
+            nibble += 1;
+        }
+        else if (w >= 0x1000) {
+            vlc = w >> 8;
+            nibble += 2;
+        }
+        else if (w >= 0x0400) {
+            vlc = w >> 4;
+            nibble += 3;
+        }
+        else {
+            vlc = w;
+            nibble += 4;
         }
 
         uint8_t color = vlc & 0x03;
@@ -202,9 +215,7 @@ void cDvbSpuBitmap::putFieldData(int field, uint8_t * data, uint8_t * endp)
 
         if (xp > bmpsize.x2) {
             // nextLine
-            if (!bitf)
-                data++;
-            bitf = 1;
+            nibble = (nibble + 1) & ~1;
             xp = bmpsize.x1;
             yp += 2;
             if (yp > bmpsize.y2)
@@ -61,6 +61,21 @@ static bool DebugOutput    = DebugVerbose;
 
 #define FIX_SUBTITLE_VERSION_BROADCASTER_STUPIDITY // some don't properly handle version numbers, which renders them useless because subtitles are not displayed
 
+// Since the version numbers can't be trusted, display sets are identified by
+// a hash of their raw segment data. This allows a display set that is merely
+// repeated by the broadcaster to reuse the previously rendered region bitmaps,
+// and avoids redrawing the OSD if its content wouldn't change.
+
+#define HASHSEED 0x811C9DC5 // FNV-1a offset basis
+
+static uint32_t HashData(uint32_t Hash, const void *Data, int Length)
+{
+  const uchar *p = (const uchar *)Data;
+  for (int i = 0; i < Length; i++)
+      Hash = (Hash ^ p[i]) * 0x01000193; // FNV-1a prime
+  return Hash;
+}
+
 // --- cSubtitleDebug --------------------------------------------------------
 
 class cSubtitleDebug {
@@ -564,43 +579,91 @@ void cSubtitleObject::DrawLine(cBitmap *Bitmap, int x, int y, tIndex Index, int
 {
   if (nonModifyingColorFlag && Index == 1)
      return;
-  for (int pos = x; pos < x + Length; pos++)
-      Bitmap->SetIndex(pos, y, Index);
+  Bitmap->SetIndexes(x, y, Index, Length);
+}
+
+// The 2 and 4 bit/pixel code strings are decoded by looking up the next 8 bits
+// of the stream in a table, instead of evaluating them bit by bit. Each entry
+// holds the number of bits that make up the code, and either the complete run
+// length and color, or the number of bits of run length and color that follow.
+
+struct tRleCode {
+  uint8_t bits;      // the number of bits of the code itself
+  uint8_t runBits;   // the number of run length bits following the code
+  uint8_t colorBits; // the number of color bits following the run length
+  uint8_t color;     // the color, if colorBits is 0
+  int run;           // the run length, or the value to add to the run length bits (0 = end of string)
+  };
+
+class cRleTables {
+private:
+  static tRleCode Code(int Bits, int Run, int Color = 0, int RunBits = 0, int ColorBits = 0)
+  {
+    tRleCode c = { uint8_t(Bits), uint8_t(RunBits), uint8_t(ColorBits), uint8_t(Color), Run };
+    return c;
+  }
+public:
+  tRleCode code2[256];
+  tRleCode code4[256];
+  cRleTables(void)
+  {
+    for (int w = 0; w < 256; w++) {
+        // 2 bit/pixel code string:
+        if (w >> 6)
+           code2[w] = Code(2, 1, w >> 6);
+        else if (w & 0x20) // switch_1
+           code2[w] = Code(8, ((w >> 2) & 0x07) + 3, w & 0x03);
+        else if (w & 0x10) // switch_2
+           code2[w] = Code(4, 1);
+        else {
+           switch ((w >> 2) & 0x03) { // switch_3
+             case 0: code2[w] = Code(6, 0); break;
+             case 1: code2[w] = Code(6, 2); break;
+             case 2: code2[w] = Code(6, 12, 0, 4, 2); break;
+             case 3: code2[w] = Code(6, 29, 0, 8, 2); break;
+             default: ;
+             }
+           }
+        // 4 bit/pixel code string:
+        if (w >> 4)
+           code4[w] = Code(4, 1, w >> 4);
+        else if ((w & 0x08) == 0) // switch_1
+           code4[w] = Code(8, (w & 0x07) ? (w & 0x07) + 2 : 0);
+        else if ((w & 0x04) == 0) // switch_2
+           code4[w] = Code(8, (w & 0x03) + 4, 0, 0, 4);
+        else {
+           switch (w & 0x03) { // switch_3
+             case 0: code4[w] = Code(8, 1); break;
+             case 1: code4[w] = Code(8, 2); break;
+             case 2: code4[w] = Code(8, 9, 0, 4, 4); break;
+             case 3: code4[w] = Code(8, 25, 0, 8, 4); break;
+             default: ;
+             }
+           }
+        }
+  }
+  };
+
+static cRleTables RleTables;
+
+static bool DecodeRleCode(cBitStream *bs, const tRleCode *Table, int &Run, int &Color)
+{
+  const tRleCode &c = Table[bs->PeekBits(8)];
+  bs->SkipBits(c.bits);
+  Run = c.run;
+  if (c.runBits)
+     Run += bs->GetBits(c.runBits);
+  else if (!Run)
+     return false; // end of string
+  Color = c.colorBits ? bs->GetBits(c.colorBits) : c.color;
+  return true;
 }
 
 bool cSubtitleObject::Decode2BppCodeString(cBitmap *Bitmap, int px, int py, cBitStream *bs, int &x, int y, const uint8_t *MapTable)
 {
-  int rl = 0;
-  int color = 0;
-  uchar code = bs->GetBits(2);
-  if (code) {
-     color = code;
-     rl = 1;
-     }
-  else if (bs->GetBit()) { // switch_1
-     rl = bs->GetBits(3) + 3;
-     color = bs->GetBits(2);
-     }
-  else if (bs->GetBit()) // switch_2
-     rl = 1; //color 0
-  else {
-     switch (bs->GetBits(2)) { // switch_3
-       case 0:
-            return false;
-       case 1:
-            rl = 2; //color 0
-            break;
-       case 2:
-            rl = bs->GetBits(4) + 12;
-            color = bs->GetBits(2);
-            break;
-       case 3:
-            rl = bs->GetBits(8) + 29;
-            color = bs->GetBits(2);
-            break;
-       default: ;
-       }
-     }
+  int rl, color;
+  if (!DecodeRleCode(bs, RleTables.code2, rl, color))
+     return false;
   if (MapTable)
      color = MapTable[color];
   DrawLine(Bitmap, px + x, py + y, color, rl);
@@ -610,42 +673,9 @@ bool cSubtitleObject::Decode2BppCodeString(cBitmap *Bitmap, int px, int py, cBit
 
 bool cSubtitleObject::Decode4BppCodeString(cBitmap *Bitmap, int px, int py, cBitStream *bs, int &x, int y, const uint8_t *MapTable)
 {
-  int rl = 0;
-  int color = 0;
-  uchar code = bs->GetBits(4);
-  if (code) {
-     color = code;
-     rl = 1;
-     }
-  else if (bs->GetBit() == 0) { // switch_1
-     code = bs->GetBits(3);
-     if (code)
-        rl = code + 2; //color 0
-     else
-        return false;
-     }
-  else if (bs->GetBit() == 0) { // switch_2
-     rl = bs->GetBits(2) + 4;
-     color = bs->GetBits(4);
-     }
-  else {
-     switch (bs->GetBits(2)) { // switch_3
-       case 0: // color 0
-            rl = 1;
-            break;
-       case 1: // color 0
-            rl = 2;
-            break;
-       case 2:
-            rl = bs->GetBits(4) + 9;
-            color = bs->GetBits(4);
-            break;
-       case 3:
-            rl = bs->GetBits(8) + 25;
-            color = bs->GetBits(4);
-            break;
-       }
-     }
+  int rl, color;
+  if (!DecodeRleCode(bs, RleTables.code4, rl, color))
+     return false;
   if (MapTable)
      color = MapTable[color];
   DrawLine(Bitmap, px + x, py + y, color, rl);
@@ -982,8 +1012,12 @@ private:
   cList<cSubtitleClut> cluts;
   cList<cSubtitleRegion> regions;
   cList<cSubtitleRegionRef> regionRefs;
+  uint32_t dataHash;
+  uint32_t renderedKey;
+  cVector<cBitmap *> renderedBitmaps;
 public:
   cDvbSubtitlePage(int PageId);
+  ~cDvbSubtitlePage();
   void Parse(int64_t Pts, cBitStream &bs);
   void ParsePgs(int64_t Pts, cBitStream &bs);
   int PageId(void) { return pageId; }
@@ -1002,6 +1036,18 @@ public:
   cSubtitleRegionRef *GetRegionRefByIndex(int RegionRefIndex) { return regionRefs.Get(RegionRefIndex); }
   void AddRegionRef(cSubtitleRegionRef *rf) { regionRefs.Add(rf); }
   void SetPending(bool Pending) { pending = Pending; }
+  void StartDisplaySet(void);
+       ///< Starts a new display set. A page update continues the hash of the
+       ///< previous display set, since it builds upon the regions and objects
+       ///< that are already there.
+  void AddSegmentData(const uchar *Data, int Length) { if (dataHash) dataHash = HashData(dataHash, Data, Length); }
+  uint32_t DataHash(void) { return dataHash; }
+       ///< Returns the hash of the data this page's current content was built
+       ///< from, or 0 if this is unknown.
+  cBitmap *GetRenderedBitmap(uint32_t Key, int Index);
+       ///< Returns a copy of the bitmap that has been rendered for the region
+       ///< with the given Index, provided it was rendered with the same Key.
+  void SetRenderedBitmap(uint32_t Key, int Index, const cBitmap *Bitmap);
   };
 
 cDvbSubtitlePage::cDvbSubtitlePage(int PageId)
@@ -1012,6 +1058,50 @@ cDvbSubtitlePage::cDvbSubtitlePage(int PageId)
   pageState = -1;
   pts = -1;
   pending = false;
+  dataHash = 0;
+  renderedKey = 0;
+}
+
+cDvbSubtitlePage::~cDvbSubtitlePage()
+{
+  for (int i = 0; i < renderedBitmaps.Size(); i++)
+      delete renderedBitmaps[i];
+}
+
+void cDvbSubtitlePage::StartDisplaySet(void)
+{
+  if (pageState != 0 || !dataHash)
+     dataHash = HASHSEED;
+}
+
+static cBitmap *CopyBitmap(const cBitmap *Bitmap)
+{
+  cBitmap *bm = new cBitmap(Bitmap->Width(), Bitmap->Height(), Bitmap->Bpp(), Bitmap->X0(), Bitmap->Y0());
+  bm->DrawBitmap(Bitmap->X0(), Bitmap->Y0(), *Bitmap, 0, 0, true);
+  return bm;
+}
+
+cBitmap *cDvbSubtitlePage::GetRenderedBitmap(uint32_t Key, int Index)
+{
+  if (Key && Key == renderedKey && Index < renderedBitmaps.Size() && renderedBitmaps[Index])
+     return CopyBitmap(renderedBitmaps[Index]);
+  return NULL;
+}
+
+void cDvbSubtitlePage::SetRenderedBitmap(uint32_t Key, int Index, const cBitmap *Bitmap)
+{
+  if (Key != renderedKey) {
+     for (int i = 0; i < renderedBitmaps.Size(); i++)
+         delete renderedBitmaps[i];
+     renderedBitmaps.Clear();
+     renderedKey = Key;
+     }
+  if (Key) {
+     while (renderedBitmaps.Size() <= Index)
+           renderedBitmaps.Append(NULL);
+     delete renderedBitmaps[Index];
+     renderedBitmaps[Index] = CopyBitmap(Bitmap);
+     }
 }
 
 void cDvbSubtitlePage::Parse(int64_t Pts, cBitStream &bs)
@@ -1254,20 +1344,24 @@ private:
   tArea areaOsd;
   double osdFactorX;
   double osdFactorY;
+  uint32_t contentKey;
   cVector<cBitmap *> bitmaps;
 public:
-  cDvbSubtitleBitmaps(int State, int64_t Pts, int Timeout, tArea *Areas, int NumAreas, double OsdFactorX, double OsdFactorY, tArea &AreaCombined, tArea &AreaOsd);
+  cDvbSubtitleBitmaps(int State, int64_t Pts, int Timeout, tArea *Areas, int NumAreas, double OsdFactorX, double OsdFactorY, tArea &AreaCombined, tArea &AreaOsd, uint32_t ContentKey = 0);
   virtual ~cDvbSubtitleBitmaps() override;
   int State(void) { return state; }
   int64_t Pts(void) { return pts; }
   int Timeout(void) { return timeout; }
+  uint32_t ContentKey(void) { return contentKey; }
+       ///< Returns a key that is the same for bitmaps that result in the same
+       ///< OSD content, or 0 if this is unknown.
   void AddBitmap(cBitmap *Bitmap);
   bool HasBitmaps(void) { return bitmaps.Size(); }
   void Draw(cOsd *Osd);
   void DbgDump(int WindowWidth, int WindowHeight);
   };
 
-cDvbSubtitleBitmaps::cDvbSubtitleBitmaps(int State, int64_t Pts, int Timeout, tArea *Areas, int NumAreas, double OsdFactorX, double OsdFactorY, tArea &AreaCombined, tArea &AreaOsd)
+cDvbSubtitleBitmaps::cDvbSubtitleBitmaps(int State, int64_t Pts, int Timeout, tArea *Areas, int NumAreas, double OsdFactorX, double OsdFactorY, tArea &AreaCombined, tArea &AreaOsd, uint32_t ContentKey)
 {
   state = State;
   pts = Pts;
@@ -1278,6 +1372,7 @@ cDvbSubtitleBitmaps::cDvbSubtitleBitmaps(int State, int64_t Pts, int Timeout, tA
   areaOsd = AreaOsd;
   osdFactorX = OsdFactorX;
   osdFactorY = OsdFactorY;
+  contentKey = ContentKey;
 }
 
 cDvbSubtitleBitmaps::~cDvbSubtitleBitmaps()
@@ -1360,6 +1455,7 @@ cDvbSubtitleConverter::cDvbSubtitleConverter(void)
 {
   dvbSubtitleAssembler = new cDvbSubtitleAssembler;
   osd = NULL;
+  osdContentKey = 0;
   frozen = false;
   ddsVersionNumber = -1;
   displayWidth = windowWidth = 720;
@@ -1555,8 +1651,13 @@ void cDvbSubtitleConverter::Action(void)
                      else if (!current->HasBitmaps() || current->Timeout() * 1000 - PtsDeltaMs(STC, current->Pts()) <= 0)
                         DELETENULL(osd);
                      else if (visible && AssertOsd()) {
-                        dbgoutput("showing bitmap #%d of %d<br>\n", current->Index() + 1, bitmaps->Count());
-                        current->Draw(osd);
+                        if (current->ContentKey() && current->ContentKey() == osdContentKey)
+                           dbgoutput("bitmap #%d of %d is already shown<br>\n", current->Index() + 1, bitmaps->Count());
+                        else {
+                           dbgoutput("showing bitmap #%d of %d<br>\n", current->Index() + 1, bitmaps->Count());
+                           current->Draw(osd);
+                           osdContentKey = current->ContentKey();
+                           }
                         dbgconverter("PTS: %" PRId64 "  STC: %" PRId64 " (%" PRId64 ") timeout: %d<br>\n", current->Pts(), STC, Delta, current->Timeout());
                         }
                      }
@@ -1595,6 +1696,7 @@ bool cDvbSubtitleConverter::AssertOsd(void)
   LOCK_THREAD;
   if (!osd) {
      SetOsdData();
+     osdContentKey = 0;
      osd = cOsdProvider::NewOsd(int(round(osdFactorX * windowHorizontalOffset + osdDeltaX)), int(round(osdFactorY * windowVerticalOffset + osdDeltaY)) + Setup.SubtitleOffset, OSD_LEVEL_SUBTITLES);
      }
   return osd != NULL;
@@ -1633,6 +1735,7 @@ int cDvbSubtitleConverter::ExtractSegment(const uchar *Data, int Length, int64_t
                }
             dbgsegments("PAGE_COMPOSITION_SEGMENT<br>\n");
             page->Parse(Pts, bs);
+            page->StartDisplaySet();
             SD.SetFactor(double(DBGBITMAPWIDTH) / windowWidth);
             break;
             }
@@ -1728,6 +1831,8 @@ int cDvbSubtitleConverter::ExtractSegment(const uchar *Data, int Length, int64_t
        default:
             dbgsegments("*** unknown segment type: %02X<br>\n", segmentType);
        }
+     if (segmentType != END_OF_DISPLAY_SET_SEGMENT)
+        page->AddSegmentData(Data, bs.Length() / 8);
      return bs.Length() / 8;
      }
   return -1;
@@ -1833,7 +1938,16 @@ void cDvbSubtitleConverter::FinishPage(cDvbSubtitlePage *Page)
               return; // unable to draw bitmaps
            }
      }
-  cDvbSubtitleBitmaps *Bitmaps = new cDvbSubtitleBitmaps(Page->PageState(), Page->Pts(), Page->PageTimeout(), Areas, NumAreas, osdFactorX, osdFactorY, AreaCombined, AreaOsd);
+  uint32_t RenderKey = 0;
+  uint32_t ContentKey = 0;
+  if (uint32_t Hash = Page->DataHash()) {
+     RenderKey = HashData(Hash, &Reduced, sizeof(Reduced));
+     RenderKey = HashData(RenderKey, &AreaOsd.bpp, sizeof(AreaOsd.bpp));
+     ContentKey = HashData(RenderKey, &AreaOsd, sizeof(AreaOsd));
+     ContentKey = HashData(ContentKey, &osdFactorX, sizeof(osdFactorX));
+     ContentKey = HashData(ContentKey, &osdFactorY, sizeof(osdFactorY));
+     }
+  cDvbSubtitleBitmaps *Bitmaps = new cDvbSubtitleBitmaps(Page->PageState(), Page->Pts(), Page->PageTimeout(), Areas, NumAreas, osdFactorX, osdFactorY, AreaCombined, AreaOsd, ContentKey);
   if (After)
      bitmaps->Add(Bitmaps, After);
   else
@@ -1842,24 +1956,28 @@ void cDvbSubtitleConverter::FinishPage(cDvbSubtitlePage *Page)
       if (cSubtitleRegionRef *srr = Page->GetRegionRefByIndex(i)) {
          if (cSubtitleRegion *sr = Page->GetRegionById(srr->RegionId())) {
             if (cSubtitleClut *clut = Page->GetClutById(sr->ClutId())) {
-               cBitmap *bm = new cBitmap(sr->RegionWidth(), sr->RegionHeight(), sr->RegionDepth());
-               bm->Replace(*clut->GetPalette(sr->RegionDepth()));
-               sr->Render(bm, Page->Objects());
-               if (Reduced) {
-                  if (sr->RegionDepth() != Areas[i].bpp) {
-                     if (sr->RegionLevelOfCompatibility() <= Areas[i].bpp) {
-                        //TODO this is untested - didn't have any such subtitle stream
-                        cSubtitleClut *Clut = Page->GetClutById(sr->ClutId());
-                        dbgregions("reduce region %d bpp %d level %d area bpp %d<br>\n", sr->RegionId(), sr->RegionDepth(), sr->RegionLevelOfCompatibility(), Areas[i].bpp);
-                        bm->ReduceBpp(*Clut->GetPalette(sr->RegionDepth()));
-                        }
-                     else {
-                        dbgregions("condense region %d bpp %d level %d area bpp %d<br>\n", sr->RegionId(), sr->RegionDepth(), sr->RegionLevelOfCompatibility(), Areas[i].bpp);
-                        bm->ShrinkBpp(Areas[i].bpp);
+               cBitmap *bm = Page->GetRenderedBitmap(RenderKey, i);
+               if (!bm) {
+                  bm = new cBitmap(sr->RegionWidth(), sr->RegionHeight(), sr->RegionDepth());
+                  bm->Replace(*clut->GetPalette(sr->RegionDepth()));
+                  sr->Render(bm, Page->Objects());
+                  if (Reduced) {
+                     if (sr->RegionDepth() != Areas[i].bpp) {
+                        if (sr->RegionLevelOfCompatibility() <= Areas[i].bpp) {
+                           //TODO this is untested - didn't have any such subtitle stream
+                           cSubtitleClut *Clut = Page->GetClutById(sr->ClutId());
+                           dbgregions("reduce region %d bpp %d level %d area bpp %d<br>\n", sr->RegionId(), sr->RegionDepth(), sr->RegionLevelOfCompatibility(), Areas[i].bpp);
+                           bm->ReduceBpp(*Clut->GetPalette(sr->RegionDepth()));
+                           }
+                        else {
+                           dbgregions("condense region %d bpp %d level %d area bpp %d<br>\n", sr->RegionId(), sr->RegionDepth(), sr->RegionLevelOfCompatibility(), Areas[i].bpp);
+                           bm->ShrinkBpp(Areas[i].bpp);
+                           }
                         }
                      }
+                  bm->SetOffset(srr->RegionHorizontalAddress(), srr->RegionVerticalAddress());
+                  Page->SetRenderedBitmap(RenderKey, i, bm);
                   }
-               bm->SetOffset(srr->RegionHorizontalAddress(), srr->RegionVerticalAddress());
                Bitmaps->AddBitmap(bm);
                }
             }
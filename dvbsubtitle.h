@@ -25,6 +25,7 @@ private:
   static int setupLevel;
   cDvbSubtitleAssembler *dvbSubtitleAssembler;
   cOsd *osd;
+  uint32_t osdContentKey;
   bool frozen;
   int ddsVersionNumber;
   int displayWidth;
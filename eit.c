@@ -29,9 +29,11 @@
 //   event id for tables 0x4E and 0x5X.
 
 #include "eit.h"
+#include <arpa/inet.h>
 #include <sys/time.h>
 #include "epg.h"
 #include "i18n.h"
+#include "trace.h"
 #include "libsi/section.h"
 #include "libsi/descriptor.h"
 
@@ -71,16 +73,144 @@ bool cEitTables::Processed(uchar TableId, uchar LastTableId, int SectionNumber,
   return Result;
 }
 
+// --- cEitEventTexts --------------------------------------------------------
+
+// Converting the texts of the events is by far the most expensive part of processing
+// an EIT section, so this is done before taking any locks. That way EIT data from
+// several devices can be processed in parallel, and the schedules are locked only
+// for the time it takes to actually store the data.
+
+struct tEitEventText {
+  bool decoded;
+  bool hasShortEvent;
+  cString title;
+  cString shortText;
+  cString description;
+  cString language;
+  cComponents *components;
+  tEitEventText(void) { decoded = hasShortEvent = false; components = NULL; }
+  ~tEitEventText() { delete components; }
+  };
+
+class cEitEventTexts {
+private:
+  cVector<tEitEventText *> texts;
+public:
+  ~cEitEventTexts();
+  void Add(SI::EIT::Event &SiEitEvent, bool Decode);
+       ///< Adds the texts of the given event. If Decode is false, the event will not be
+       ///< used (or hasn't changed) and only an empty entry is added.
+  tEitEventText *Get(int Index) { return Index < texts.Size() ? texts[Index] : NULL; }
+  static void Decode(tEitEventText *Text, SI::EIT::Event &SiEitEvent);
+       ///< Decodes the texts of the given event into Text.
+  };
+
+cEitEventTexts::~cEitEventTexts()
+{
+  for (int i = 0; i < texts.Size(); i++)
+      delete texts[i];
+}
+
+void cEitEventTexts::Add(SI::EIT::Event &SiEitEvent, bool Decode)
+{
+  tEitEventText *Text = new tEitEventText;
+  texts.Append(Text);
+  if (Decode)
+     cEitEventTexts::Decode(Text, SiEitEvent);
+}
+
+void cEitEventTexts::Decode(tEitEventText *Text, SI::EIT::Event &SiEitEvent)
+{
+  Text->decoded = true;
+  int LanguagePreferenceShort = -1;
+  int LanguagePreferenceExt = -1;
+  bool UseExtendedEventDescriptor = false;
+  SI::Descriptor *d;
+  SI::ExtendedEventDescriptors *ExtendedEventDescriptors = NULL;
+  SI::ShortEventDescriptor *ShortEventDescriptor = NULL;
+  for (SI::Loop::Iterator it; (d = SiEitEvent.eventDescriptors.getNext(it)); ) {
+      switch (d->getDescriptorTag()) {
+        case SI::ExtendedEventDescriptorTag: {
+             SI::ExtendedEventDescriptor *eed = (SI::ExtendedEventDescriptor *)d;
+             if (I18nIsPreferredLanguage(Setup.EPGLanguages, eed->languageCode, LanguagePreferenceExt) || !ExtendedEventDescriptors) {
+                delete ExtendedEventDescriptors;
+                ExtendedEventDescriptors = new SI::ExtendedEventDescriptors;
+                UseExtendedEventDescriptor = true;
+                }
+             if (UseExtendedEventDescriptor) {
+                if (ExtendedEventDescriptors->Add(eed))
+                   d = NULL; // so that it is not deleted
+                }
+             if (eed->getDescriptorNumber() == eed->getLastDescriptorNumber())
+                UseExtendedEventDescriptor = false;
+             }
+             break;
+        case SI::ShortEventDescriptorTag: {
+             SI::ShortEventDescriptor *sed = (SI::ShortEventDescriptor *)d;
+             if (I18nIsPreferredLanguage(Setup.EPGLanguages, sed->languageCode, LanguagePreferenceShort) || !ShortEventDescriptor) {
+                delete ShortEventDescriptor;
+                ShortEventDescriptor = sed;
+                d = NULL; // so that it is not deleted
+                }
+             }
+             break;
+        case SI::ComponentDescriptorTag: {
+             SI::ComponentDescriptor *cd = (SI::ComponentDescriptor *)d;
+             uchar Stream = cd->getStreamContent();
+             uchar Ext = cd->getStreamContentExt();
+             uchar Type = cd->getComponentType();
+             if ((1 <= Stream && Stream <= 6 && Type != 0) // 1=MPEG2-video, 2=MPEG1-audio, 3=subtitles, 4=AC3-audio, 5=H.264-video, 6=HEAAC-audio
+                || (Stream == 9 && Ext < 2)) {             // 0x09=HEVC-video, 0x19=AC-4-audio
+                if (!Text->components)
+                   Text->components = new cComponents;
+                char buffer[Utf8BufSize(256)];
+                if (Stream == 9)
+                   Stream |= Ext << 4;
+                Text->components->SetComponent(Text->components->NumComponents(), Stream, Type, I18nNormalizeLanguageCode(cd->languageCode), cd->description.getText(buffer, sizeof(buffer)));
+                }
+             }
+             break;
+        default: ;
+        }
+      delete d;
+      }
+  if (ShortEventDescriptor) {
+     char buffer[Utf8BufSize(256)];
+     Text->hasShortEvent = true;
+     Text->title = ShortEventDescriptor->name.getText(buffer, sizeof(buffer));
+     Text->shortText = ShortEventDescriptor->text.getText(buffer, sizeof(buffer));
+     Text->language = I18nNormalizeLanguageCode(ShortEventDescriptor->languageCode);
+     }
+  if (ExtendedEventDescriptors) {
+     char buffer[Utf8BufSize(ExtendedEventDescriptors->getMaximumTextLength(": ")) + 1];
+     Text->description = ExtendedEventDescriptors->getText(buffer, sizeof(buffer), ": ");
+     }
+  delete ExtendedEventDescriptors;
+  delete ShortEventDescriptor;
+}
+
 // --- cEIT ------------------------------------------------------------------
 
 class cEIT : public SI::EIT {
+private:
+  bool IsUnchanged(const cEvent *Event, SI::EIT::Event &SiEitEvent, u_char Tid);
+       ///< Returns true if Event has been stored from this very version of the table and
+       ///< its times haven't changed.
 public:
   cEIT(cEitTablesHash &EitTablesHash, int Source, u_char Tid, const u_char *Data);
   };
 
+bool cEIT::IsUnchanged(const cEvent *Event, SI::EIT::Event &SiEitEvent, u_char Tid)
+{
+  return Event->TableID() == Tid && Event->Version() == getVersionNumber() && Event->StartTime() == SiEitEvent.getStartTime() && Event->Duration() == SiEitEvent.getDuration();
+}
+
+static thread_local SI::Arena EitArena; // backs the descriptors of the section that is currently being processed
+
 cEIT::cEIT(cEitTablesHash &EitTablesHash, int Source, u_char Tid, const u_char *Data)
 :SI::EIT(Data, false)
 {
+  SI::ArenaScope ArenaScope(EitArena);
   if (!CheckCRCAndParse())
      return;
   int HashId = getServiceId();
@@ -96,12 +226,42 @@ cEIT::cEIT(cEitTablesHash &EitTablesHash, int Source, u_char Tid, const u_char *
   time_t Now = time(NULL);
   if (Now < VALID_TIME)
      return; // we need the current time for handling PDC descriptors
+  time_t LingerLimit = Now - EPG_LINGER_TIME;
+
+  tChannelID channelID(Source, getOriginalNetworkId(), getTransportStreamId(), getServiceId());
+  SI::EIT::Event SiEitEvent;
+
+  // Most of the time the events in a section are the same as the ones we already have,
+  // so we briefly take a read lock to find out which ones need their texts decoded:
+  cVector<bool> Unchanged;
+  if (Process) {
+     cStateKey SchedulesStateKey;
+     if (const cSchedules *Schedules = cSchedules::GetSchedulesRead(SchedulesStateKey, 10)) {
+        if (const cSchedule *Schedule = Schedules->GetSchedule(channelID)) {
+           for (SI::Loop::Iterator it; eventLoop.getNext(SiEitEvent, it); ) {
+               const cEvent *Event = (Tid == 0x4E || (Tid & 0xF0) == 0x50) ? Schedule->GetEventById(SiEitEvent.getEventId()) : Schedule->GetEventByTime(SiEitEvent.getStartTime());
+               Unchanged.Append(Event && IsUnchanged(Event, SiEitEvent, Tid));
+               }
+           }
+        SchedulesStateKey.Remove();
+        }
+     }
+
+  cEitEventTexts EventTexts;
+  int EventIndex = 0;
+  for (SI::Loop::Iterator it; eventLoop.getNext(SiEitEvent, it); EventIndex++) {
+      // This uses the same criteria as below for skipping events:
+      time_t StartTime = SiEitEvent.getStartTime();
+      int Duration = SiEitEvent.getDuration();
+      bool Bogus = StartTime == 0 || StartTime > 0 && Duration == 0;
+      bool Skip = EventIndex < Unchanged.Size() && Unchanged[EventIndex];
+      EventTexts.Add(SiEitEvent, !Bogus && !Skip && StartTime + Duration >= LingerLimit && (Process || Tid != 0x4E));
+      }
 
   cStateKey ChannelsStateKey;
   cChannels *Channels = cChannels::GetChannelsWrite(ChannelsStateKey, 10);
   if (!Channels)
      return;
-  tChannelID channelID(Source, getOriginalNetworkId(), getTransportStreamId(), getServiceId());
   cChannel *Channel = Channels->GetByChannelID(channelID, true);
   if (!Channel || EpgHandlers.IgnoreChannel(Channel)) {
      ChannelsStateKey.Remove(false);
@@ -134,14 +294,14 @@ cEIT::cEIT(cEitTablesHash &EitTablesHash, int Source, u_char Tid, const u_char *
 
   bool Empty = true;
   bool Modified = false;
-  time_t LingerLimit = Now - EPG_LINGER_TIME;
   time_t SegmentStart = 0; // these are actually "section" start/end times
   time_t SegmentEnd = 0;
   struct tm t = { 0 };
   localtime_r(&Now, &t); // this initializes the time zone in 't'
 
-  SI::EIT::Event SiEitEvent;
+  EventIndex = 0;
   for (SI::Loop::Iterator it; eventLoop.getNext(SiEitEvent, it); ) {
+      tEitEventText *Text = EventTexts.Get(EventIndex++);
       if (EpgHandlers.HandleEitEvent(pSchedule, &SiEitEvent, Tid, getVersionNumber()))
          continue; // an EPG handler has done all of the processing
       time_t StartTime = SiEitEvent.getStartTime();
@@ -165,6 +325,7 @@ cEIT::cEIT(cEitTablesHash &EitTablesHash, int Source, u_char Tid, const u_char *
       cEvent *newEvent = NULL;
       cEvent *rEvent = NULL;
       cEvent *pEvent = NULL;
+      bool EventUnchanged = false;
       if (Tid == 0x4E || (Tid & 0xF0) == 0x50)
          pEvent = const_cast<cEvent *>(pSchedule->GetEventById(SiEitEvent.getEventId()));
       else
@@ -183,6 +344,7 @@ cEIT::cEIT(cEitTablesHash &EitTablesHash, int Source, u_char Tid, const u_char *
       else {
          // We have found an existing event, either through its event ID or its start time.
          pEvent->SetSeen();
+         EventUnchanged = IsUnchanged(pEvent, SiEitEvent, Tid);
          uchar TableID = max(pEvent->TableID(), uchar(0x4E)); // for backwards compatibility, table ids less than 0x4E are treated as if they were "present"
          // We never overwrite present/following with events from other tables:
          if (TableID == 0x4E && Tid != 0x4E)
@@ -229,42 +391,16 @@ cEIT::cEIT(cEitTablesHash &EitTablesHash, int Source, u_char Tid, const u_char *
          if (!Process)
             continue;
          }
+      if (EventUnchanged)
+         continue; // this is the same version of the event we already have, so there's no need to look at its descriptors
+      if (!Text->decoded)
+         cEitEventTexts::Decode(Text, SiEitEvent); // the event has changed since we looked at it without a lock
       pEvent->SetVersion(getVersionNumber());
 
-      int LanguagePreferenceShort = -1;
-      int LanguagePreferenceExt = -1;
-      bool UseExtendedEventDescriptor = false;
       SI::Descriptor *d;
-      SI::ExtendedEventDescriptors *ExtendedEventDescriptors = NULL;
-      SI::ShortEventDescriptor *ShortEventDescriptor = NULL;
       cLinkChannels *LinkChannels = NULL;
-      cComponents *Components = NULL;
       for (SI::Loop::Iterator it2; (d = SiEitEvent.eventDescriptors.getNext(it2)); ) {
           switch (d->getDescriptorTag()) {
-            case SI::ExtendedEventDescriptorTag: {
-                 SI::ExtendedEventDescriptor *eed = (SI::ExtendedEventDescriptor *)d;
-                 if (I18nIsPreferredLanguage(Setup.EPGLanguages, eed->languageCode, LanguagePreferenceExt) || !ExtendedEventDescriptors) {
-                    delete ExtendedEventDescriptors;
-                    ExtendedEventDescriptors = new SI::ExtendedEventDescriptors;
-                    UseExtendedEventDescriptor = true;
-                    }
-                 if (UseExtendedEventDescriptor) {
-                    if (ExtendedEventDescriptors->Add(eed))
-                       d = NULL; // so that it is not deleted
-                    }
-                 if (eed->getDescriptorNumber() == eed->getLastDescriptorNumber())
-                    UseExtendedEventDescriptor = false;
-                 }
-                 break;
-            case SI::ShortEventDescriptorTag: {
-                 SI::ShortEventDescriptor *sed = (SI::ShortEventDescriptor *)d;
-                 if (I18nIsPreferredLanguage(Setup.EPGLanguages, sed->languageCode, LanguagePreferenceShort) || !ShortEventDescriptor) {
-                    delete ShortEventDescriptor;
-                    ShortEventDescriptor = sed;
-                    d = NULL; // so that it is not deleted
-                    }
-                 }
-                 break;
             case SI::ContentDescriptorTag: {
                  SI::ContentDescriptor *cd = (SI::ContentDescriptor *)d;
                  SI::ContentDescriptor::Nibble Nibble;
@@ -365,49 +501,26 @@ cEIT::cEIT(cEitTablesHash &EitTablesHash, int Source, u_char Tid, const u_char *
                     }
                  }
                  break;
-            case SI::ComponentDescriptorTag: {
-                 SI::ComponentDescriptor *cd = (SI::ComponentDescriptor *)d;
-                 uchar Stream = cd->getStreamContent();
-                 uchar Ext = cd->getStreamContentExt();
-                 uchar Type = cd->getComponentType();
-                 if ((1 <= Stream && Stream <= 6 && Type != 0) // 1=MPEG2-video, 2=MPEG1-audio, 3=subtitles, 4=AC3-audio, 5=H.264-video, 6=HEAAC-audio
-                    || (Stream == 9 && Ext < 2)) {             // 0x09=HEVC-video, 0x19=AC-4-audio
-                    if (!Components)
-                       Components = new cComponents;
-                    char buffer[Utf8BufSize(256)];
-                    if (Stream == 9)
-                       Stream |= Ext << 4;
-                    Components->SetComponent(Components->NumComponents(), Stream, Type, I18nNormalizeLanguageCode(cd->languageCode), cd->description.getText(buffer, sizeof(buffer)));
-                    }
-                 }
-                 break;
-            default: ;
+            default: ; // the short and extended event descriptors, as well as the component descriptors, have been handled by cEitEventTexts
             }
           delete d;
           }
 
       if (!rEvent) {
-         if (ShortEventDescriptor) {
-            char buffer[Utf8BufSize(256)];
-            EpgHandlers.SetTitle(pEvent, ShortEventDescriptor->name.getText(buffer, sizeof(buffer)));
-            EpgHandlers.SetShortText(pEvent, ShortEventDescriptor->text.getText(buffer, sizeof(buffer)));
-            EpgHandlers.SetLanguage(pEvent, I18nNormalizeLanguageCode(ShortEventDescriptor->languageCode));
+         if (Text->hasShortEvent) {
+            EpgHandlers.SetTitle(pEvent, Text->title);
+            EpgHandlers.SetShortText(pEvent, Text->shortText);
+            EpgHandlers.SetLanguage(pEvent, Text->language);
             }
          else {
             EpgHandlers.SetTitle(pEvent, NULL);
             EpgHandlers.SetShortText(pEvent, NULL);
             }
-         if (ExtendedEventDescriptors) {
-            char buffer[Utf8BufSize(ExtendedEventDescriptors->getMaximumTextLength(": ")) + 1];
-            EpgHandlers.SetDescription(pEvent, ExtendedEventDescriptors->getText(buffer, sizeof(buffer), ": "));
-            }
-         else
-            EpgHandlers.SetDescription(pEvent, NULL);
+         EpgHandlers.SetDescription(pEvent, Text->description);
          }
-      delete ExtendedEventDescriptors;
-      delete ShortEventDescriptor;
 
-      EpgHandlers.SetComponents(pEvent, Components);
+      EpgHandlers.SetComponents(pEvent, Text->components);
+      Text->components = NULL; // the event has taken ownership
 
       EpgHandlers.FixEpgBugs(pEvent);
       if (LinkChannels)
@@ -434,6 +547,7 @@ cEIT::cEIT(cEitTablesHash &EitTablesHash, int Source, u_char Tid, const u_char *
         EpgHandlers.DropOutdated(pSchedule, SegmentStart, SegmentEnd, Tid, getVersionNumber());
         }
      }
+  VDR_TRACE(eit_apply, Tid, getServiceId(), getSectionNumber(), Modified);
   EpgHandlers.EndSegmentTransfer(Modified);
   SchedulesStateKey.Remove(Modified);
   ChannelsStateKey.Remove(ChannelsModified);
@@ -500,11 +614,15 @@ cTDT::cTDT(const u_char *Data)
 // --- cEitFilter ------------------------------------------------------------
 
 time_t cEitFilter::disableUntil = 0;
+cMutex cEitFilter::dumpMutex;
+FILE *cEitFilter::dumpFile = NULL;
+char *cEitFilter::dumpFileName = NULL;
 
 cEitFilter::cEitFilter(void)
 {
   Set(0x12, 0x40, 0xC0);  // event info present&following actual/other TS (0x4E/0x4F), future actual/other TS (0x5X/0x6X)
   Set(0x14, 0x70);        // TDT
+  sections = 0;
 }
 
 void cEitFilter::SetStatus(bool On)
@@ -519,6 +637,54 @@ void cEitFilter::SetDisableUntil(time_t Time)
   disableUntil = Time;
 }
 
+void cEitFilter::SetDumpFileName(const char *FileName)
+{
+  cMutexLock MutexLock(&dumpMutex);
+  if (dumpFile) {
+     fclose(dumpFile);
+     dumpFile = NULL;
+     }
+  free(dumpFileName);
+  dumpFileName = FileName ? strdup(FileName) : NULL;
+}
+
+void cEitFilter::Dump(const u_char *Data, int Length)
+{
+  cMutexLock MutexLock(&dumpMutex);
+  if (!dumpFileName)
+     return;
+  if (!dumpFile) {
+     if ((dumpFile = fopen(dumpFileName, "a")) == NULL) {
+        LOG_ERROR_STR(dumpFileName);
+        SetDumpFileName(NULL);
+        return;
+        }
+     isyslog("dumping EIT sections to %s", dumpFileName);
+     }
+  uint32_t Header[2] = { htonl(Source()), htonl(uint32_t(time(NULL))) };
+  if (fwrite(Header, sizeof(Header), 1, dumpFile) != 1 || fwrite(Data, Length, 1, dumpFile) != 1) {
+     LOG_ERROR_STR(dumpFileName);
+     SetDumpFileName(NULL);
+     }
+}
+
+void cEitFilter::ProcessEit(int Source, u_char Tid, const u_char *Data, int Length)
+{
+  cMutexLock MutexLock(&mutex);
+  sections++;
+  if (Tid == 0x4E || Tid >= 0x50 && Tid <= 0x6F) { // we ignore 0x4F, which only causes trouble
+     if (Tid != 0x4E && Length >= 8) {
+        // Most sections of the EIT schedule are repetitions of ones we have already
+        // processed, so we skip them before checking the CRC and parsing the data:
+        int ServiceId = (Data[3] << 8) | Data[4];
+        cEitTables *EitTables = eitTablesHash.Get(ServiceId);
+        if (EitTables && EitTables->Known(Tid, (Data[5] >> 1) & 0x1F, Data[6]))
+           return;
+        }
+     cEIT EIT(eitTablesHash, Source, Tid, Data);
+     }
+}
+
 void cEitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length)
 {
   cMutexLock MutexLock(&mutex);
@@ -530,8 +696,9 @@ void cEitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
      }
   switch (Pid) {
     case 0x12: {
-         if (Tid == 0x4E || Tid >= 0x50 && Tid <= 0x6F) // we ignore 0x4F, which only causes trouble
-            cEIT EIT(eitTablesHash, Source(), Tid, Data);
+         if (dumpFileName)
+            Dump(Data, Length);
+         ProcessEit(Source(), Tid, Data, Length);
          }
          break;
     case 0x14: {
@@ -34,6 +34,8 @@ public:
   time_t TableStart(void) { return tableStart; }
   time_t TableEnd(void) { return tableEnd; }
   bool Check(uchar TableId, uchar Version, int SectionNumber);
+  bool Known(uchar TableId, uchar Version, int SectionNumber) { return sectionSyncer[Index(TableId)].Known(Version, SectionNumber); }
+       ///< Returns true if the given section has already been processed (see cSectionSyncer::Known()).
   bool Processed(uchar TableId, uchar LastTableId, int SectionNumber, int LastSectionNumber, int SegmentLastSectionNumber = -1);
        ///< Returns true if all sections of the table with the given TableId have been processed.
   bool Complete(void) { return complete; }
@@ -49,13 +51,29 @@ class cEitFilter : public cFilter {
 private:
   cMutex mutex;
   cEitTablesHash eitTablesHash;
+  uint64_t sections;
   static time_t disableUntil;
+  static cMutex dumpMutex;
+  static FILE *dumpFile;
+  static char *dumpFileName;
+  void Dump(const u_char *Data, int Length);
 protected:
   virtual void Process(u_short Pid, u_char Tid, const u_char *Data, int Length) override;
 public:
   cEitFilter(void);
   virtual void SetStatus(bool On) override;
   static void SetDisableUntil(time_t Time);
+  static void SetDumpFileName(const char *FileName);
+       ///< Makes all EIT filters append every EIT section they receive to the file
+       ///< with the given name (in case of NULL, no more sections are written).
+       ///< Each section is preceded by the source it was received from and the
+       ///< time it was received, both as 32 bit values in network byte order.
+       ///< Such a dump can be replayed with 'vdr-benchepg'.
+  void ProcessEit(int Source, u_char Tid, const u_char *Data, int Length);
+       ///< Processes the EIT section in Data with the given Tid, as if it had
+       ///< been received from the given Source.
+  uint64_t Sections(void) const { return sections; }
+       ///< Returns the number of EIT sections this filter has received so far.
   };
 
 #endif //__EIT_H
@@ -11,31 +11,71 @@
 #include <stdlib.h>
 #include "channels.h"
 #include "dvbdevice.h"
+#include "epg.h"
 #include "skins.h"
 #include "transfer.h"
 
+#define SCANFRESHTIME    3600 // seconds within which a transponder's EIT is considered up to date
+#define SCANMAXAGE      86400 // transponders that haven't been seen for longer than this are all equally stale
+#define SCANMAXSCHEDULES    4 // the number of schedules beyond which a transponder's weight no longer increases
+#define SCANTIMERWEIGHT     4 // the additional weight of a transponder that timers depend on
+
 // --- cScanData -------------------------------------------------------------
 
 class cScanData : public cListObject {
 private:
   cChannel channel;
+  time_t lastSeen;
+  int schedules;
+  bool timers;
+  int score;
 public:
   cScanData(const cChannel *Channel);
   virtual int Compare(const cListObject &ListObject) const override;
   int Source(void) const { return channel.Source(); }
   int Transponder(void) const { return channel.Transponder(); }
   const cChannel *GetChannel(void) const { return &channel; }
+  void AddSchedule(const cSchedule *Schedule);
+       ///< Takes the given Schedule of one of the channels on this transponder
+       ///< into account when calculating the score.
+  int Age(time_t Now) const { return lastSeen ? min(int(Now - lastSeen), SCANMAXAGE) : SCANMAXAGE; }
+       ///< Returns the number of seconds since the EIT of this transponder has
+       ///< last been received.
+  void SetScore(time_t Now);
+  int Score(void) const { return score; }
   };
 
 cScanData::cScanData(const cChannel *Channel)
 {
   channel = *Channel;
+  lastSeen = 0;
+  schedules = 0;
+  timers = false;
+  score = 0;
+}
+
+void cScanData::AddSchedule(const cSchedule *Schedule)
+{
+  lastSeen = max(lastSeen, Schedule->PresentSeen());
+  schedules++;
+  timers |= Schedule->HasTimer();
+}
+
+void cScanData::SetScore(time_t Now)
+{
+  // The longer the EIT of a transponder hasn't been seen, the more it needs
+  // to be scanned. Transponders that carry more schedules, or that timers
+  // depend on, gain more from being scanned:
+  int Weight = 1 + min(schedules, SCANMAXSCHEDULES) + (timers ? SCANTIMERWEIGHT : 0);
+  score = Age(Now) / 60 * Weight;
 }
 
 int cScanData::Compare(const cListObject &ListObject) const
 {
   const cScanData *sd = (const cScanData *)&ListObject;
-  int r = Source() - sd->Source();
+  int r = sd->Score() - Score(); // highest score first
+  if (r == 0)
+     r = Source() - sd->Source();
   if (r == 0)
      r = Transponder() - sd->Transponder();
   return r;
@@ -48,7 +88,11 @@ private:
   bool HasDeviceForChannelEIT(const cChannel *Channel) const;
 public:
   void AddTransponders(const cList<cChannel> *Channels);
-  void AddTransponder(const cChannel *Channel);
+  cScanData *AddTransponder(const cChannel *Channel);
+  void Prioritize(const cList<cChannel> *Channels, const cSchedules *Schedules, bool All);
+       ///< Sorts the transponders so that the ones that gain the most from being
+       ///< scanned come first. Unless All is true, transponders the EIT of which
+       ///< has been received within the last SCANFRESHTIME seconds are removed.
   };
 
 bool cScanList::HasDeviceForChannelEIT(const cChannel *Channel) const
@@ -65,20 +109,50 @@ void cScanList::AddTransponders(const cList<cChannel> *Channels)
 {
   for (const cChannel *ch = Channels->First(); ch; ch = Channels->Next(ch))
       AddTransponder(ch);
-  Sort();
 }
 
-void cScanList::AddTransponder(const cChannel *Channel)
+cScanData *cScanList::AddTransponder(const cChannel *Channel)
 {
   if (Channel->Source() && Channel->Transponder() && (Setup.EPGScanMaxChannel <= 0 || Channel->Number() < Setup.EPGScanMaxChannel)) {
-     if (!HasDeviceForChannelEIT(Channel))
-        return;
      for (cScanData *sd = First(); sd; sd = Next(sd)) {
          if (sd->Source() == Channel->Source() && ISTRANSPONDER(sd->Transponder(), Channel->Transponder()))
-            return;
+            return sd;
+         }
+     if (!HasDeviceForChannelEIT(Channel))
+        return NULL;
+     cScanData *sd = new cScanData(Channel);
+     Add(sd);
+     return sd;
+     }
+  return NULL;
+}
+
+void cScanList::Prioritize(const cList<cChannel> *Channels, const cSchedules *Schedules, bool All)
+{
+  if (Schedules) {
+     for (const cChannel *ch = Channels->First(); ch; ch = Channels->Next(ch)) {
+         if (!ch->GroupSep()) {
+            if (const cSchedule *Schedule = Schedules->GetSchedule(ch)) {
+               for (cScanData *sd = First(); sd; sd = Next(sd)) {
+                   if (sd->Source() == ch->Source() && ISTRANSPONDER(sd->Transponder(), ch->Transponder())) {
+                      sd->AddSchedule(Schedule);
+                      break;
+                      }
+                   }
+               }
+            }
          }
-     Add(new cScanData(Channel));
      }
+  time_t Now = time(NULL);
+  cScanData *Next = NULL;
+  for (cScanData *sd = First(); sd; sd = Next) {
+      Next = cList<cScanData>::Next(sd);
+      if (!All && sd->Age(Now) < SCANFRESHTIME)
+         Del(sd);
+      else
+         sd->SetScore(Now);
+      }
+  Sort();
 }
 
 // --- cTransponderList ------------------------------------------------------
@@ -111,10 +185,16 @@ cEITScanner::cEITScanner(void)
   currentChannel = 0;
   scanList = new cScanList;
   transponderList = NULL;
+  for (int i = 0; i < MAXDEVICES; i++) {
+      deviceScanData[i] = NULL;
+      deviceScanStart[i] = 0;
+      }
 }
 
 cEITScanner::~cEITScanner()
 {
+  for (int i = 0; i < MAXDEVICES; i++)
+      delete deviceScanData[i];
   delete scanList;
   delete transponderList;
 }
@@ -141,12 +221,40 @@ void cEITScanner::Activity(void)
   lastActivity = time(NULL);
 }
 
+int cEITScanner::Scanning(time_t Now)
+{
+  int n = 0;
+  for (int i = 0; i < cDevice::NumDevices(); i++) {
+      if (cScanData *ScanData = deviceScanData[i]) {
+         cDevice *Device = cDevice::GetDevice(i);
+         if (!Device || Device->Priority() >= 0 || !Device->IsTunedToTransponder(ScanData->GetChannel())) {
+            if (Now - deviceScanStart[i] < ScanTimeout) {
+               //dsyslog("EIT scan: device %d was taken before scanning tp %d", i + 1, ScanData->Transponder());
+               scanList->Ins(ScanData); // the most urgent transponder is always the one at the front
+               }
+            else
+               delete ScanData;
+            deviceScanData[i] = NULL;
+            }
+         else if (Now - deviceScanStart[i] >= ScanTimeout) {
+            delete ScanData;
+            deviceScanData[i] = NULL;
+            }
+         else
+            n++;
+         }
+      }
+  return n;
+}
+
 void cEITScanner::Process(void)
 {
   if (Setup.EPGScanTimeout || !lastActivity) { // !lastActivity means a scan was forced
      time_t now = time(NULL);
-     if (now - lastScan > ScanTimeout && now - lastActivity > ActivityTimeout) {
-        if (Setup.EPGPauseAfterScan && scanList->Count() == 0 && lastActivity && lastScan && now - lastScan < Setup.EPGScanTimeout * 3600) {
+     if (now != lastScan && now - lastActivity > ActivityTimeout) {
+        // Every device scans at its own pace, so we check them once per second:
+        int Busy = Scanning(now);
+        if (Setup.EPGPauseAfterScan && scanList->Count() == 0 && !Busy && lastActivity && lastScan && now - lastScan < Setup.EPGScanTimeout * 3600) {
            if (!paused) {
               dsyslog("pause EPG scan");
               paused = true;
@@ -166,16 +274,24 @@ void cEITScanner::Process(void)
            }
         cStateKey StateKey;
         if (const cChannels *Channels = cChannels::GetChannelsRead(StateKey, 10)) {
-           if (scanList->Count() == 0) {
+           if (scanList->Count() == 0 && !Busy) {
               if (transponderList) {
                  scanList->AddTransponders(transponderList);
                  delete transponderList;
                  transponderList = NULL;
                  }
               scanList->AddTransponders(Channels);
+              cStateKey SchedulesStateKey;
+              const cSchedules *Schedules = cSchedules::GetSchedulesRead(SchedulesStateKey, 10);
+              scanList->Prioritize(Channels, Schedules, !lastActivity);
+              if (Schedules)
+                 SchedulesStateKey.Remove();
               //dsyslog("EIT scan: %d scanList entries", scanList->Count());
               }
+           // Each idle device takes the most urgent transponder it can receive:
            for (int i = 0; i < cDevice::NumDevices(); i++) {
+               if (deviceScanData[i])
+                  continue; // still scanning
                cDevice *Device = cDevice::GetDevice(i);
                if (Device && Device->ProvidesEIT()) {
                   cScanData *Next = NULL;
@@ -203,7 +319,10 @@ void cEITScanner::Process(void)
                                         }
                                      //dsyslog("EIT scan: %d device %d  source  %-8s tp %5d", scanList->Count(), Device->DeviceNumber() + 1, *cSource::ToString(Channel->Source()), Channel->Transponder());
                                      Device->SwitchChannel(Channel, false);
-                                     scanList->Del(ScanData);
+                                     scanList->Del(ScanData, false);
+                                     deviceScanData[i] = ScanData;
+                                     deviceScanStart[i] = now;
+                                     Busy++;
                                      break;
                                      }
                                   }
@@ -213,7 +332,7 @@ void cEITScanner::Process(void)
                       }
                   }
                }
-           if (scanList->Count() == 0) {
+           if (scanList->Count() == 0 && !Busy) {
               if (lastActivity == 0) // this was a triggered scan
                  Activity();
               }
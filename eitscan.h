@@ -15,6 +15,7 @@
 #include "config.h"
 #include "device.h"
 
+class cScanData;
 class cScanList;
 class cTransponderList;
 
@@ -28,6 +29,14 @@ private:
   int currentChannel;
   cScanList *scanList;
   cTransponderList *transponderList;
+  cScanData *deviceScanData[MAXDEVICES];
+  time_t deviceScanStart[MAXDEVICES];
+  int Scanning(time_t Now);
+       ///< Checks the transponders the devices are currently scanning. Transponders
+       ///< that have been scanned for ScanTimeout seconds are done, while those
+       ///< the device of which has been taken for something else before that are
+       ///< put back into the scan list. Returns the number of devices that are
+       ///< still scanning.
 public:
   cEITScanner(void);
   ~cEITScanner();
@@ -11,10 +11,14 @@
  */
 
 #include "epg.h"
+#include <algorithm>
 #include <ctype.h>
 #include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
 #include "libsi/si.h"
+#include "startup.h"
 
 #define RUNNINGSTATUSTIMEOUT 30 // seconds before the running status is considered unknown
 #define EPGDATAWRITEDELTA   600 // seconds between writing the epg.data file
@@ -46,21 +50,28 @@ bool tComponent::FromString(const char *s)
 cComponents::cComponents(void)
 {
   numComponents = 0;
-  components = NULL;
+  components = inlineComponents;
 }
 
 cComponents::~cComponents(void)
 {
   for (int i = 0; i < numComponents; i++)
       free(components[i].description);
-  free(components);
+  if (components != inlineComponents)
+     free(components);
 }
 
 bool cComponents::Realloc(int Index)
 {
   if (Index >= numComponents) {
      Index++;
-     if (tComponent *NewBuffer = (tComponent *)realloc(components, Index * sizeof(tComponent))) {
+     if (Index <= MAXINLINECOMPONENTS) {
+        memset(&components[numComponents], 0, sizeof(tComponent) * (Index - numComponents));
+        numComponents = Index;
+        }
+     else if (tComponent *NewBuffer = (tComponent *)(components == inlineComponents ? malloc(Index * sizeof(tComponent)) : realloc(components, Index * sizeof(tComponent)))) {
+        if (components == inlineComponents)
+           memcpy(NewBuffer, inlineComponents, numComponents * sizeof(tComponent));
         int n = numComponents;
         numComponents = Index;
         components = NewBuffer;
@@ -108,6 +119,99 @@ tComponent *cComponents::GetComponent(int Index, uchar Stream, uchar Type)
   return NULL;
 }
 
+// --- cEpgStrings -----------------------------------------------------------
+
+struct cEpgStrings::tString {
+  tString *next;
+  uint hash;
+  int refs;
+  char s[];
+  static tString *FromString(const char *s) { return (tString *)(s - offsetof(tString, s)); }
+  };
+
+cMutex cEpgStrings::mutex;
+cEpgStrings::tString **cEpgStrings::hash = NULL;
+int cEpgStrings::hashSize = 0;
+int cEpgStrings::count = 0;
+
+static uint EpgStringHash(const char *s, size_t &Length)
+{
+  // FNV-1a:
+  const char *p = s;
+  uint h = 2166136261u;
+  while (*p)
+        h = (h ^ uchar(*p++)) * 16777619u;
+  Length = p - s;
+  return h;
+}
+
+void cEpgStrings::Resize(int Size)
+{
+  tString **h = MALLOC(tString *, Size);
+  if (!h)
+     return; // we just keep using the old table
+  memset(h, 0, Size * sizeof(tString *));
+  for (int i = 0; i < hashSize; i++) {
+      for (tString *p = hash[i]; p; ) {
+          tString *n = p->next;
+          p->next = h[p->hash & (Size - 1)];
+          h[p->hash & (Size - 1)] = p;
+          p = n;
+          }
+      }
+  free(hash);
+  hash = h;
+  hashSize = Size;
+}
+
+const char *cEpgStrings::Get(const char *s)
+{
+  if (!s)
+     return NULL;
+  size_t l;
+  uint h = EpgStringHash(s, l);
+  cMutexLock MutexLock(&mutex);
+  if (count >= hashSize)
+     Resize(hashSize ? 2 * hashSize : 4096); // the size must be a power of 2
+  tString **b = &hash[h & (hashSize - 1)];
+  for (tString *p = *b; p; p = p->next) {
+      if (p->hash == h && strcmp(p->s, s) == 0) {
+         p->refs++;
+         return p->s;
+         }
+      }
+  tString *p = (tString *)malloc(sizeof(tString) + l + 1);
+  if (!p) {
+     esyslog("ERROR: out of memory");
+     return NULL;
+     }
+  memcpy(p->s, s, l + 1);
+  p->hash = h;
+  p->refs = 1;
+  p->next = *b;
+  *b = p;
+  count++;
+  return p->s;
+}
+
+void cEpgStrings::Release(const char *s)
+{
+  if (!s)
+     return;
+  tString *p = tString::FromString(s);
+  cMutexLock MutexLock(&mutex);
+  if (--p->refs > 0)
+     return;
+  for (tString **b = &hash[p->hash & (hashSize - 1)]; *b; b = &(*b)->next) {
+      if (*b == p) {
+         *b = p->next;
+         break;
+         }
+      }
+  free(p);
+  count--;
+}
+
 // --- cEvent ----------------------------------------------------------------
 
 cMutex cEvent::numTimersMutex;
@@ -131,14 +235,16 @@ cEvent::cEvent(tEventID EventID)
   duration = 0;
   vps = 0;
   aux = NULL;
+  hashNextID = NULL;
+  hashNextStartTime = NULL;
   SetSeen();
 }
 
 cEvent::~cEvent()
 {
-  free(title);
-  free(shortText);
-  free(description);
+  cEpgStrings::Release(title);
+  cEpgStrings::Release(shortText);
+  cEpgStrings::Release(description);
   free(aux);
   delete components;
 }
@@ -192,17 +298,29 @@ void cEvent::SetLanguage(const char *Language)
 
 void cEvent::SetTitle(const char *Title)
 {
-  title = strcpyrealloc(title, Title);
+  const char *s = cEpgStrings::Get(Title);
+  if (schedule && s != title)
+     schedule->IndexText(this, title, s);
+  cEpgStrings::Release(title);
+  title = s;
 }
 
 void cEvent::SetShortText(const char *ShortText)
 {
-  shortText = strcpyrealloc(shortText, ShortText);
+  const char *s = cEpgStrings::Get(ShortText);
+  if (schedule && s != shortText)
+     schedule->IndexText(this, shortText, s);
+  cEpgStrings::Release(shortText);
+  shortText = s;
 }
 
 void cEvent::SetDescription(const char *Description)
 {
-  description = strcpyrealloc(description, Description);
+  const char *s = cEpgStrings::Get(Description);
+  if (schedule && s != description)
+     schedule->IndexText(this, description, s);
+  cEpgStrings::Release(description);
+  description = s;
 }
 
 void cEvent::SetComponents(cComponents *Components)
@@ -235,7 +353,11 @@ void cEvent::SetStartTime(time_t StartTime)
 
 void cEvent::SetDuration(int Duration)
 {
-  duration = Duration;
+  if (duration != Duration) {
+     duration = Duration;
+     if (schedule)
+        schedule->InvalidateEventsByTime();
+     }
 }
 
 void cEvent::SetVps(time_t Vps)
@@ -466,9 +588,10 @@ void cEvent::Dump(FILE *f, const char *Prefix, bool InfoOnly) const
      if (!isempty(shortText))
         fprintf(f, "%sS %s\n", Prefix, shortText);
      if (!isempty(description)) {
-        strreplace(description, '\n', '|');
-        fprintf(f, "%sD %s\n", Prefix, description);
-        strreplace(description, '|', '\n');
+        fprintf(f, "%sD ", Prefix);
+        for (const char *p = description; *p; p++)
+            fputc(*p == '\n' ? '|' : *p, f);
+        fputc('\n', f);
         }
      if (contents[0]) {
         fprintf(f, "%sG", Prefix);
@@ -707,6 +830,12 @@ static void StripControlCharacters(char *s)
 
 void cEvent::FixEpgBugs(void)
 {
+  // The texts are shared with other events, so we work on private copies here
+  // and store the results at the end:
+  char *title = this->title ? strdup(this->title) : NULL;
+  char *shortText = this->shortText ? strdup(this->shortText) : NULL;
+  char *description = this->description ? strdup(this->description) : NULL;
+
   if (isempty(title)) {
      // we don't want any "(null)" titles
      title = strcpyrealloc(title, tr("No title"));
@@ -935,20 +1064,463 @@ Final:
   StripControlCharacters(title);
   StripControlCharacters(shortText);
   StripControlCharacters(description);
+
+  SetTitle(title);
+  SetShortText(shortText);
+  SetDescription(description);
+  free(title);
+  free(shortText);
+  free(description);
+}
+
+// --- cEpgSnapshot ---------------------------------------------------------
+
+// The binary EPG snapshot is a memory mapped copy of the EPG data, which allows
+// for a much faster startup than parsing the text epg.data file. It consists of
+// the encoded events of all schedules, followed by a table with one entry per
+// schedule and a trailer. All values are in host byte order, since this file is
+// only meant to be read by the VDR that has written it.
+
+#define EPGSNAPSHOTMAGIC   0x47504556 // 'VEPG'
+#define EPGSNAPSHOTVERSION 1
+
+struct tEpgSnapshotHeader {
+  uint32_t magic;
+  uint32_t version;
+  };
+
+struct tEpgSnapshotEntry {
+  int32_t source;
+  int32_t nid;
+  int32_t tid;
+  int32_t sid;
+  uint64_t offset;
+  uint32_t length;
+  uint32_t numEvents;
+  };
+
+struct tEpgSnapshotTrailer {
+  uint64_t tableOffset;
+  uint32_t numSchedules;
+  uint32_t magic;
+  };
+
+class cEpgSnapshot {
+private:
+  uchar *data;
+  size_t size;
+  std::atomic_int pending; // the number of schedules that have not yet been decoded
+public:
+  cEpgSnapshot(uchar *Data, size_t Size) { data = Data; size = Size; pending = 1; }
+  ~cEpgSnapshot() { munmap(data, size); }
+  void Attach(void) { pending++; }
+  void Detach(void) { if (--pending == 0) delete this; }
+  };
+
+class cEpgSnapshotWriter {
+private:
+  FILE *f;
+  bool ok;
+public:
+  cEpgSnapshotWriter(FILE *File) { f = File; ok = true; }
+  bool Ok(void) const { return ok; }
+  off_t Offset(void) { return ftello(f); }
+  void Put(const void *Data, size_t Length) { if (ok && Length && fwrite(Data, Length, 1, f) != 1) ok = false; }
+  template<class T> void Put(T Value) { Put(&Value, sizeof(Value)); }
+  void PutString(const char *s);
+  void PutEvent(const cEvent *Event);
+  };
+
+void cEpgSnapshotWriter::PutString(const char *s)
+{
+  // Strings are stored including their terminating 0, so that they can be
+  // used directly from the mapped file. A length of 0 stands for NULL.
+  uint32_t l = s ? strlen(s) + 1 : 0;
+  Put(l);
+  Put(s, l);
+}
+
+void cEpgSnapshotWriter::PutEvent(const cEvent *Event)
+{
+  Put(uint32_t(Event->EventID()));
+  Put(int64_t(Event->StartTime()));
+  Put(int32_t(Event->Duration()));
+  Put(int64_t(Event->Vps()));
+  Put(uchar(Event->TableID()));
+  Put(uchar(Event->ParentalRating()));
+  for (int i = 0; i < MaxEventContents; i++)
+      Put(Event->Contents(i));
+  char Language[MAXLANGCODE1] = { 0 };
+  strn0cpy(Language, Event->Language(), sizeof(Language));
+  Put(Language, sizeof(Language));
+  PutString(Event->Title());
+  PutString(Event->ShortText());
+  PutString(Event->Description());
+  PutString(Event->Aux());
+  const cComponents *Components = Event->Components();
+  Put(uint32_t(Components ? Components->NumComponents() : 0));
+  if (Components) {
+     for (int i = 0; i < Components->NumComponents(); i++) {
+         const tComponent *p = Components->Component(i);
+         Put(p->stream);
+         Put(p->type);
+         Put(p->language, sizeof(p->language));
+         PutString(p->description);
+         }
+     }
+}
+
+class cEpgSnapshotReader {
+private:
+  const uchar *data;
+  const uchar *end;
+  bool ok;
+public:
+  cEpgSnapshotReader(const uchar *Data, int Length) { data = Data; end = Data + Length; ok = true; }
+  bool Ok(void) const { return ok; }
+  const uchar *Get(size_t Length);
+  template<class T> T Get(void) { T Value = 0; if (const uchar *p = Get(sizeof(Value))) memcpy(&Value, p, sizeof(Value)); return Value; }
+  const char *GetString(void);
+  };
+
+const uchar *cEpgSnapshotReader::Get(size_t Length)
+{
+  if (ok && size_t(end - data) >= Length) {
+     const uchar *p = data;
+     data += Length;
+     return p;
+     }
+  ok = false;
+  return NULL;
+}
+
+const char *cEpgSnapshotReader::GetString(void)
+{
+  uint32_t l = Get<uint32_t>();
+  if (l) {
+     if (const char *s = (const char *)Get(l)) {
+        if (!s[l - 1])
+           return s;
+        ok = false;
+        }
+     }
+  return NULL;
+}
+
+// --- cEpgIndex ------------------------------------------------------------
+
+#define MAXEPGTOKEN       32   // longer words are truncated
+#define EPGINDEXHASHSIZE  256 // initial size, grows as needed
+
+static inline bool IsEpgTokenChar(uchar c)
+{
+  return '0' <= c && c <= '9' || 'a' <= c && c <= 'z' || 'A' <= c && c <= 'Z' || c >= 0x80; // all non-ASCII characters are considered part of words
+}
+
+class cEpgTokenizer {
+private:
+  const char *p;
+  char token[MAXEPGTOKEN];
+public:
+  cEpgTokenizer(const char *s) { p = s; }
+  const char *Next(void);
+       ///< Returns the next word of the text (in lowercase), or NULL if there are no more.
+  };
+
+const char *cEpgTokenizer::Next(void)
+{
+  if (p) {
+     for (;;) {
+         while (*p && !IsEpgTokenChar(*p))
+               p++;
+         if (!*p)
+            break;
+         int l = 0;
+         for ( ; IsEpgTokenChar(*p); p++) {
+             if (l < MAXEPGTOKEN - 1)
+                token[l++] = ('A' <= *p && *p <= 'Z') ? *p + 'a' - 'A' : *p;
+             }
+         if (l > 1) {
+            token[l] = 0;
+            return token;
+            }
+         }
+     }
+  return NULL;
+}
+
+static bool EpgTextHasToken(const char *Text, const char *Token)
+{
+  cEpgTokenizer Tokenizer(Text);
+  while (const char *t = Tokenizer.Next()) {
+        if (strcmp(t, Token) == 0)
+           return true;
+        }
+  return false;
+}
+
+static bool EpgEventMatches(const cEvent *Event, const cStringList &Tokens)
+{
+  for (int i = 0; i < Tokens.Size(); i++) {
+      if (!EpgTextHasToken(Event->Title(), Tokens[i]) && !EpgTextHasToken(Event->ShortText(), Tokens[i]) && !EpgTextHasToken(Event->Description(), Tokens[i]))
+         return false;
+      }
+  return true;
+}
+
+class cEpgIndexEntry : public cListObject {
+public:
+  const char *token; // from cEpgStrings
+  cVector<const cEvent *> events; // contains an event once for every text of it that contains the token
+  cEpgIndexEntry(const char *Token) { token = cEpgStrings::Get(Token); }
+  virtual ~cEpgIndexEntry() override { cEpgStrings::Release(token); }
+  };
+
+class cEpgIndex {
+private:
+  cHash<cEpgIndexEntry> entries;
+  cEpgIndexEntry *Get(const char *Token, uint &Hash) const;
+public:
+  cEpgIndex(void) : entries(EPGINDEXHASHSIZE, true) {}
+  void Add(const char *Text, const cEvent *Event);
+  void Del(const char *Text, const cEvent *Event);
+  const cVector<const cEvent *> *Events(const char *Token) const;
+       ///< Returns the events that contain the given Token (or NULL, if there are none).
+       ///< An event may be contained more than once.
+  };
+
+cEpgIndexEntry *cEpgIndex::Get(const char *Token, uint &Hash) const
+{
+  size_t l;
+  Hash = EpgStringHash(Token, l);
+  for (cEpgIndexEntry *e = entries.Get(Hash); e; e = entries.GetNext(Hash, e)) {
+      if (strcmp(e->token, Token) == 0)
+         return e;
+      }
+  return NULL;
+}
+
+void cEpgIndex::Add(const char *Text, const cEvent *Event)
+{
+  cVector<cEpgIndexEntry *> Seen; // every word counts only once per text
+  cEpgTokenizer Tokenizer(Text);
+  while (const char *t = Tokenizer.Next()) {
+        uint Hash;
+        cEpgIndexEntry *e = Get(t, Hash);
+        if (!e) {
+           e = new cEpgIndexEntry(t);
+           entries.Add(e, Hash);
+           }
+        if (Seen.IndexOf(e) < 0) {
+           Seen.Append(e);
+           e->events.Append(Event);
+           }
+        }
+}
+
+void cEpgIndex::Del(const char *Text, const cEvent *Event)
+{
+  cVector<cEpgIndexEntry *> Seen;
+  cEpgTokenizer Tokenizer(Text);
+  while (const char *t = Tokenizer.Next()) {
+        uint Hash;
+        if (cEpgIndexEntry *e = Get(t, Hash)) {
+           if (Seen.IndexOf(e) < 0) {
+              e->events.RemoveElement(Event);
+              if (e->events.Size())
+                 Seen.Append(e);
+              else {
+                 entries.Del(e, Hash);
+                 delete e;
+                 }
+              }
+           }
+        }
+}
+
+const cVector<const cEvent *> *cEpgIndex::Events(const char *Token) const
+{
+  uint Hash;
+  cEpgIndexEntry *e = Get(Token, Hash);
+  return e ? &e->events : NULL;
+}
+
+// --- cEventHash ------------------------------------------------------------
+
+cEventHash::cEventHash(cEvent *cEvent::*Next, bool ByStartTime)
+{
+  next = Next;
+  byStartTime = ByStartTime;
+  buckets = NULL;
+  size = 0;
+  count = 0;
+}
+
+cEventHash::~cEventHash()
+{
+  free(buckets);
+}
+
+int cEventHash::Bucket(intmax_t Key) const
+{
+  uint h = uint(Key ^ (Key >> 32)) * 2654435769u; // Fibonacci hashing
+  return (h ^ (h >> 16)) & (size - 1);
+}
+
+void cEventHash::Resize(int Size)
+{
+  cEvent **NewBuckets = MALLOC(cEvent *, Size);
+  if (!NewBuckets) {
+     esyslog("ERROR: out of memory");
+     return;
+     }
+  memset(NewBuckets, 0, Size * sizeof(cEvent *));
+  cEvent **OldBuckets = buckets;
+  int OldSize = size;
+  buckets = NewBuckets;
+  size = Size;
+  for (int i = 0; i < OldSize; i++) {
+      for (cEvent *e = OldBuckets[i]; e; ) {
+          cEvent *n = e->*next;
+          int b = Bucket(Key(e));
+          e->*next = buckets[b];
+          buckets[b] = e;
+          e = n;
+          }
+      }
+  free(OldBuckets);
+}
+
+void cEventHash::Add(cEvent *Event)
+{
+  if (cEvent *p = Get(Key(Event)))
+     Del(p);
+  if (count >= size)
+     Resize(size ? 2 * size : 64); // the size must be a power of 2
+  if (!size)
+     return;
+  int b = Bucket(Key(Event));
+  Event->*next = buckets[b];
+  buckets[b] = Event;
+  count++;
+}
+
+void cEventHash::Del(cEvent *Event)
+{
+  if (size) {
+     for (cEvent **p = &buckets[Bucket(Key(Event))]; *p; p = &((*p)->*next)) {
+         if (*p == Event) {
+            *p = Event->*next;
+            Event->*next = NULL;
+            count--;
+            break;
+            }
+         }
+     }
+}
+
+cEvent *cEventHash::Get(intmax_t Key) const
+{
+  if (size) {
+     for (cEvent *e = buckets[Bucket(Key)]; e; e = e->*next) {
+         if (this->Key(e) == Key)
+            return e;
+         }
+     }
+  return NULL;
 }
 
 // --- cSchedule -------------------------------------------------------------
 
 cMutex cSchedule::numTimersMutex;
+std::atomic<int> cSchedule::lastModified(0);
 
 cSchedule::cSchedule(tChannelID ChannelID)
+:eventsHashID(&cEvent::hashNextID, false)
+,eventsHashStartTime(&cEvent::hashNextStartTime, true)
 {
   channelID = ChannelID;
   events.SetUseGarbageCollector();
   numTimers = 0;
-  modified = 0;
+  modified = ++lastModified;
   onActualTp = false;
   presentSeen = 0;
+  maxDuration = 0;
+  eventsByTimeValid = false;
+  snapshot = NULL;
+  snapshotData = NULL;
+  snapshotLength = 0;
+  index = NULL;
+}
+
+cSchedule::~cSchedule()
+{
+  delete index;
+  if (cEpgSnapshot *Snapshot = snapshot)
+     Snapshot->Detach();
+}
+
+void cSchedule::SetSnapshot(cEpgSnapshot *Snapshot, const uchar *Data, int Length)
+{
+  Snapshot->Attach();
+  snapshotData = Data;
+  snapshotLength = Length;
+  snapshot = Snapshot;
+}
+
+void cSchedule::DecodeSnapshot(void) const
+{
+  // This may be called with only a read lock on the schedules, so we need to make
+  // sure parallel readers don't decode the same data:
+  cMutexLock MutexLock(&snapshotMutex);
+  cEpgSnapshot *Snapshot = snapshot;
+  if (!Snapshot)
+     return;
+  cSchedule *Schedule = (cSchedule *)this;
+  cEpgSnapshotReader Reader(snapshotData, snapshotLength);
+  int NumEvents = Reader.Get<uint32_t>();
+  for (int n = 0; n < NumEvents && Reader.Ok(); n++) {
+      cEvent *Event = new cEvent(Reader.Get<uint32_t>());
+      Event->seen = 0;
+      Event->SetStartTime(Reader.Get<int64_t>());
+      Event->SetDuration(Reader.Get<int32_t>());
+      Event->SetVps(Reader.Get<int64_t>());
+      Event->SetTableID(Reader.Get<uchar>());
+      Event->SetParentalRating(Reader.Get<uchar>());
+      if (const uchar *p = Reader.Get(MaxEventContents))
+         memcpy(Event->contents, p, MaxEventContents);
+      if (const char *p = (const char *)Reader.Get(MAXLANGCODE1))
+         strn0cpy(Event->language, p, sizeof(Event->language));
+      Event->SetTitle(Reader.GetString());
+      Event->SetShortText(Reader.GetString());
+      Event->SetDescription(Reader.GetString());
+      Event->SetAux(Reader.GetString());
+      if (int NumComponents = Reader.Get<uint32_t>()) {
+         cComponents *Components = new cComponents;
+         for (int i = 0; i < NumComponents && Reader.Ok(); i++) {
+             uchar Stream = Reader.Get<uchar>();
+             uchar Type = Reader.Get<uchar>();
+             char Language[MAXLANGCODE2] = { 0 };
+             if (const char *p = (const char *)Reader.Get(sizeof(Language)))
+                strn0cpy(Language, p, sizeof(Language));
+             const char *Description = Reader.GetString();
+             if (Reader.Ok())
+                Components->SetComponent(i, Stream, Type, Language, Description);
+             }
+         Event->SetComponents(Components);
+         }
+      if (!Reader.Ok()) {
+         delete Event;
+         break;
+         }
+      Schedule->events.Add(Event);
+      Event->schedule = Schedule;
+      Schedule->HashEvent(Event);
+      }
+  if (!Reader.Ok())
+     esyslog("ERROR: corrupted EPG snapshot data for channel %s", *channelID.ToString());
+  snapshot = NULL;
+  Snapshot->Detach();
 }
 
 void cSchedule::IncNumTimers(void) const
@@ -974,15 +1546,35 @@ bool cSchedule::OnActualTp(uchar TableId)
 
 cEvent *cSchedule::AddEvent(cEvent *Event)
 {
-  events.Add(Event);
+  Load();
+  // Events usually come in chronologically, so searching backwards for the
+  // insert position keeps the list sorted at hardly any cost:
+  cEvent *After = events.Last();
+  while (After && After->Compare(*Event) > 0)
+        After = events.Prev(After);
+  if (After)
+     events.Add(Event, After);
+  else
+     events.Ins(Event);
   Event->schedule = this;
   HashEvent(Event);
+  if (index) {
+     index->Add(Event->title, Event);
+     index->Add(Event->shortText, Event);
+     index->Add(Event->description, Event);
+     }
   return Event;
 }
 
 void cSchedule::DelEvent(cEvent *Event)
 {
+  Load();
   if (Event->schedule == this) {
+     if (index) {
+        index->Del(Event->title, Event);
+        index->Del(Event->shortText, Event);
+        index->Del(Event->description, Event);
+        }
      UnhashEvent(Event);
      Event->schedule = NULL;
      // Removing the event from its schedule prevents it from decrementing the
@@ -993,37 +1585,81 @@ void cSchedule::DelEvent(cEvent *Event)
      numTimersMutex.Unlock();
      cEvent::numTimersMutex.Unlock();
      events.Del(Event);
+     SetModified();
      }
 }
 
-void cSchedule::HashEvent(cEvent *Event)
+void cSchedule::IndexText(const cEvent *Event, const char *OldText, const char *NewText)
 {
-  if (cEvent *p = eventsHashID.Get(Event->EventID()))
-     eventsHashID.Del(p, p->EventID());
-  eventsHashID.Add(Event, Event->EventID());
-  if (Event->StartTime() > 0) { // 'StartTime < 0' is apparently used with NVOD channels
-     if (cEvent *p = eventsHashStartTime.Get(Event->StartTime()))
-        eventsHashStartTime.Del(p, p->StartTime());
-     eventsHashStartTime.Add(Event, Event->StartTime());
+  if (index) {
+     index->Del(OldText, Event);
+     index->Add(NewText, Event);
      }
 }
 
+void cSchedule::HashEvent(cEvent *Event)
+{
+  InvalidateEventsByTime(); // this is also called when the start time of an event changes
+  eventsHashID.Add(Event);
+  if (Event->StartTime() > 0) // 'StartTime < 0' is apparently used with NVOD channels
+     eventsHashStartTime.Add(Event);
+}
+
 void cSchedule::UnhashEvent(cEvent *Event)
 {
-  eventsHashID.Del(Event, Event->EventID());
+  InvalidateEventsByTime();
+  eventsHashID.Del(Event);
   if (Event->StartTime() > 0) // 'StartTime < 0' is apparently used with NVOD channels
-     eventsHashStartTime.Del(Event, Event->StartTime());
+     eventsHashStartTime.Del(Event);
+}
+
+void cSchedule::UpdateEventsByTime(void) const
+{
+  Load();
+  // Any modification of the events happens under a write lock, so this can only
+  // run in parallel with other readers:
+  if (eventsByTimeValid)
+     return;
+  cMutexLock MutexLock(&eventsByTimeMutex);
+  if (eventsByTimeValid)
+     return;
+  eventsByTime.Clear();
+  maxDuration = 0;
+  bool Sorted = true;
+  for (const cEvent *p = events.First(); p; p = events.Next(p)) {
+      if (eventsByTime.Size() && p->StartTime() < eventsByTime[eventsByTime.Size() - 1]->StartTime())
+         Sorted = false; // events may have changed their start times since the last call to Sort()
+      eventsByTime.Append(p);
+      maxDuration = max(maxDuration, p->Duration());
+      }
+  if (!Sorted)
+     std::stable_sort(&eventsByTime[0], &eventsByTime[0] + eventsByTime.Size(), [](const cEvent *a, const cEvent *b) { return a->StartTime() < b->StartTime(); });
+  eventsByTimeValid = true;
+}
+
+int cSchedule::FirstEventAfter(time_t Time) const
+{
+  int l = 0;
+  int h = eventsByTime.Size();
+  while (l < h) {
+        int m = (l + h) / 2;
+        if (eventsByTime[m]->StartTime() <= Time)
+           l = m + 1;
+        else
+           h = m;
+        }
+  return l;
 }
 
 const cEvent *cSchedule::GetPresentEvent(void) const
 {
+  UpdateEventsByTime();
   const cEvent *pe = NULL;
   time_t now = time(NULL);
-  for (const cEvent *p = events.First(); p; p = events.Next(p)) {
+  for (int i = 0, n = FirstEventAfter(now + 3600); i < n; i++) {
+      const cEvent *p = eventsByTime[i];
       if (p->StartTime() <= now)
          pe = p;
-      else if (p->StartTime() > now + 3600)
-         break;
       if (p->SeenWithin(RUNNINGSTATUSTIMEOUT) && p->RunningStatus() >= SI::RunningStatusPausing)
          return p;
       }
@@ -1037,21 +1673,21 @@ const cEvent *cSchedule::GetFollowingEvent(void) const
      p = events.Next(p);
   else {
      time_t now = time(NULL);
-     for (p = events.First(); p; p = events.Next(p)) {
-         if (p->StartTime() >= now)
-            break;
-         }
+     int i = FirstEventAfter(now - 1); // the first event with StartTime() >= now
+     p = i < eventsByTime.Size() ? eventsByTime[i] : NULL;
      }
   return p;
 }
 
 const cEvent *cSchedule::GetEventById(tEventID EventID) const
 {
+  Load();
   return eventsHashID.Get(EventID);
 }
 
 const cEvent *cSchedule::GetEventByTime(time_t StartTime) const
 {
+  Load();
   if (StartTime > 0) // 'StartTime < 0' is apparently used with NVOD channels
      return eventsHashStartTime.Get(StartTime);
   return NULL;
@@ -1059,20 +1695,38 @@ const cEvent *cSchedule::GetEventByTime(time_t StartTime) const
 
 const cEvent *cSchedule::GetEventAround(time_t Time) const
 {
+  // This is the event that covers Time and has the latest start time (and is the
+  // first one with that start time, in case there are several):
+  UpdateEventsByTime();
   const cEvent *pe = NULL;
-  time_t delta = INT_MAX;
-  for (const cEvent *p = events.First(); p; p = events.Next(p)) {
-      time_t dt = Time - p->StartTime();
-      if (dt >= 0 && dt < delta && p->EndTime() >= Time) {
-         delta = dt;
+  for (int i = FirstEventAfter(Time); i-- > 0; ) {
+      const cEvent *p = eventsByTime[i];
+      if (pe && p->StartTime() < pe->StartTime())
+         break;
+      if (p->StartTime() + maxDuration < Time)
+         break; // no earlier event can reach up to Time
+      if (p->EndTime() >= Time)
          pe = p;
-         }
       }
   return pe;
 }
 
+void cSchedule::GetEventsBetween(time_t Begin, time_t End, cVector<const cEvent *> &Events) const
+{
+  UpdateEventsByTime();
+  // No event that starts more than maxDuration before Begin can end after Begin:
+  for (int i = FirstEventAfter(Begin - maxDuration - 1); i < eventsByTime.Size(); i++) {
+      const cEvent *p = eventsByTime[i];
+      if (p->StartTime() > End)
+         break;
+      if (p->EndTime() >= Begin)
+         Events.Append(p);
+      }
+}
+
 void cSchedule::SetRunningStatus(cEvent *Event, int RunningStatus, const cChannel *Channel)
 {
+  Load();
   for (cEvent *p = events.First(); p; p = events.Next(p)) {
       if (p == Event) {
          if (p->RunningStatus() > SI::RunningStatusNotRunning || RunningStatus > SI::RunningStatusNotRunning) {
@@ -1088,6 +1742,7 @@ void cSchedule::SetRunningStatus(cEvent *Event, int RunningStatus, const cChanne
 
 void cSchedule::ClrRunningStatus(cChannel *Channel)
 {
+  Load();
   for (cEvent *p = events.First(); p; p = events.Next(p)) {
       if (p->RunningStatus() >= SI::RunningStatusPausing) {
          p->SetRunningStatus(SI::RunningStatusNotRunning, Channel);
@@ -1099,18 +1754,22 @@ void cSchedule::ClrRunningStatus(cChannel *Channel)
 
 void cSchedule::ResetVersions(void)
 {
+  Load();
   for (cEvent *p = events.First(); p; p = events.Next(p))
       p->SetVersion(0xFF);
 }
 
 void cSchedule::Sort(void)
 {
+  Load();
   events.Sort();
+  InvalidateEventsByTime();
   SetModified();
 }
 
 void cSchedule::DropOutdated(time_t SegmentStart, time_t SegmentEnd, uchar TableID, uchar Version)
 {
+  Load();
   // Events are sorted by start time.
   if (SegmentStart > 0 && SegmentEnd > 0) {
      cEvent *p = events.First();
@@ -1155,6 +1814,9 @@ void cSchedule::Cleanup(void)
 
 void cSchedule::Cleanup(time_t Time)
 {
+  Load();
+  if (!Setup.EPGSearchIndex)
+     DELETENULL(index);
   cEvent *Event;
   while ((Event = events.First()) != NULL) {
         if (!Event->HasTimer() && Event->EndTime() + EPG_LINGER_TIME < Time)
@@ -1164,8 +1826,58 @@ void cSchedule::Cleanup(time_t Time)
         }
 }
 
-void cSchedule::Dump(const cChannels *Channels, FILE *f, const char *Prefix, eDumpMode DumpMode, time_t AtTime) const
+void cSchedule::Search(const char *Query, cVector<const cEvent *> &Events) const
 {
+  cStringList Tokens;
+  cEpgTokenizer Tokenizer(Query);
+  while (const char *t = Tokenizer.Next()) {
+        if (Tokens.Find(t) < 0)
+           Tokens.Append(strdup(t));
+        }
+  if (!Tokens.Size())
+     return;
+  Load();
+  if (Setup.EPGSearchIndex) {
+     indexMutex.Lock();
+     if (!index) {
+        index = new cEpgIndex;
+        for (const cEvent *p = events.First(); p; p = events.Next(p)) {
+            index->Add(p->title, p);
+            index->Add(p->shortText, p);
+            index->Add(p->description, p);
+            }
+        }
+     indexMutex.Unlock();
+     // Only the events that contain the rarest word need to be checked:
+     const cVector<const cEvent *> *Candidates = NULL;
+     for (int i = 0; i < Tokens.Size(); i++) {
+         const cVector<const cEvent *> *e = index->Events(Tokens[i]);
+         if (!e)
+            return;
+         if (!Candidates || e->Size() < Candidates->Size())
+            Candidates = e;
+         }
+     cVector<const cEvent *> Found(Candidates->Size());
+     for (int i = 0; i < Candidates->Size(); i++)
+         Found.Append((*Candidates)[i]);
+     // Sorting also brings multiple occurrences of the same event together:
+     std::sort(&Found[0], &Found[0] + Found.Size(), [](const cEvent *a, const cEvent *b) { return a->StartTime() < b->StartTime() || a->StartTime() == b->StartTime() && a < b; });
+     for (int i = 0; i < Found.Size(); i++) {
+         if ((i == 0 || Found[i] != Found[i - 1]) && EpgEventMatches(Found[i], Tokens))
+            Events.Append(Found[i]);
+         }
+     }
+  else {
+     for (const cEvent *p = events.First(); p; p = events.Next(p)) {
+         if (EpgEventMatches(p, Tokens))
+            Events.Append(p);
+         }
+     }
+}
+
+void cSchedule::Dump(const cChannels *Channels, FILE *f, const char *Prefix, eDumpMode DumpMode, time_t AtTime, time_t EndTime) const
+{
+  Load();
   if (const cChannel *Channel = Channels->GetByChannelID(channelID, true)) {
      fprintf(f, "%sC %s %s\n", Prefix, *Channel->GetChannelID().ToString(), Channel->Name());
      const cEvent *p;
@@ -1190,6 +1902,13 @@ void cSchedule::Dump(const cChannels *Channels, FILE *f, const char *Prefix, eDu
                p->Dump(f, Prefix);
             }
             break;
+       case dmBetween: {
+            cVector<const cEvent *> Events;
+            GetEventsBetween(AtTime, EndTime, Events);
+            for (int i = 0; i < Events.Size(); i++)
+                Events[i]->Dump(f, Prefix);
+            }
+            break;
        default: esyslog("ERROR: unknown DumpMode %d (%s %d)", DumpMode, __FUNCTION__, __LINE__);
        }
      fprintf(f, "%sc\n", Prefix);
@@ -1236,22 +1955,57 @@ bool cSchedule::Read(FILE *f, cSchedules *Schedules)
 
 // --- cEpgDataWriter --------------------------------------------------------
 
+#define EPGDATASLICETIME   20 // ms to hold the schedules lock while cleaning up or collecting EPG data
+#define EPGDATASLICEPAUSE  10 // ms to pause between slices, so that EIT processing can proceed
+
+struct tEpgDataChunk {
+  const cSchedule *schedule;
+  int state;           // the modification state of the schedule when this chunk was collected
+  time_t expires;      // when the first event in this chunk will no longer be written
+  off_t textOffset;    // the location of the chunk in the previous epg.data file
+  size_t textLength;
+  off_t dataOffset;    // the location of the chunk in the previous binary EPG snapshot
+  size_t dataLength;
+  uint32_t numEvents;
+  char *text;          // newly collected data, or NULL if the data can be copied from the previous files
+  char *data;
+  tEpgDataChunk(const cSchedule *Schedule) { schedule = Schedule; state = -1; expires = 0; textOffset = dataOffset = 0; textLength = dataLength = 0; numEvents = 0; text = data = NULL; }
+  ~tEpgDataChunk() { free(text); free(data); }
+  };
+
 class cEpgDataWriter : public cThread {
 private:
   cMutex mutex;
   bool dump;
+  cVector<tEpgDataChunk *> chunks; // one for each schedule, in the same sequence as in cSchedules
+  struct stat textStat;            // the epg.data file we have written last
+  struct stat dataStat;            // the binary EPG snapshot we have written last
+  bool Collect(tEpgDataChunk *Chunk, const cSchedule *Schedule, const cChannels *Channels, time_t Now);
+  bool Write(tEpgDataChunk *Chunk, FILE *TextFile, int OldText, FILE *DataFile, int OldData);
+  void Invalidate(void);
+  void Save(void);
 protected:
   virtual void Action(void) override;
 public:
   cEpgDataWriter(void);
+  ~cEpgDataWriter();
   void SetDump(bool Dump) { dump = Dump; }
   void Perform(void);
+  void Dump(void);
   };
 
 cEpgDataWriter::cEpgDataWriter(void)
 :cThread("epg data writer", true)
 {
   dump = false;
+  memset(&textStat, 0, sizeof(textStat));
+  memset(&dataStat, 0, sizeof(dataStat));
+}
+
+cEpgDataWriter::~cEpgDataWriter()
+{
+  for (int i = 0; i < chunks.Size(); i++)
+      delete chunks[i];
 }
 
 void cEpgDataWriter::Action(void)
@@ -1262,17 +2016,210 @@ void cEpgDataWriter::Action(void)
 void cEpgDataWriter::Perform(void)
 {
   cMutexLock MutexLock(&mutex); // to make sure fore- and background calls don't cause parellel dumps!
-  {
-    cStateKey StateKey;
-    if (cSchedules *Schedules = cSchedules::GetSchedulesWrite(StateKey, 1000)) {
-       time_t now = time(NULL);
-       for (cSchedule *p = Schedules->First(); p; p = Schedules->Next(p))
-           p->Cleanup(now);
-       StateKey.Remove();
-       }
-  }
+  // The schedules are cleaned up in slices, so that nobody else has to wait
+  // too long for the lock. Since the events are sorted by time, each schedule
+  // only needs to look at its first events:
+  time_t now = time(NULL);
+  for (int Index = 0; ; ) {
+      bool Done = false;
+      cStateKey StateKey;
+      if (cSchedules *Schedules = cSchedules::GetSchedulesWrite(StateKey, 1000)) {
+         cTimeMs Slice(EPGDATASLICETIME);
+         cSchedule *p = Schedules->First();
+         for (int i = 0; p && i < Index; i++)
+             p = Schedules->Next(p);
+         for ( ; p && !Slice.TimedOut(); p = Schedules->Next(p), Index++)
+             p->Cleanup(now);
+         Done = !p;
+         StateKey.Remove();
+         }
+      else
+         break;
+      if (Done)
+         break;
+      cCondWait::SleepMs(EPGDATASLICEPAUSE);
+      }
   if (dump)
-     cSchedules::Dump();
+     Save();
+}
+
+void cEpgDataWriter::Dump(void)
+{
+  cMutexLock MutexLock(&mutex);
+  Save();
+}
+
+void cEpgDataWriter::Invalidate(void)
+{
+  for (int i = 0; i < chunks.Size(); i++)
+      delete chunks[i];
+  chunks.Clear();
+  memset(&textStat, 0, sizeof(textStat));
+  memset(&dataStat, 0, sizeof(dataStat));
+}
+
+static bool SameFile(int Fd, const struct stat &St)
+{
+  struct stat st;
+  return Fd >= 0 && fstat(Fd, &st) == 0 && st.st_dev == St.st_dev && st.st_ino == St.st_ino && st.st_size == St.st_size && st.st_mtime == St.st_mtime;
+}
+
+static bool CopyFileData(int Fd, off_t Offset, size_t Length, FILE *f)
+{
+  char buf[KILOBYTE(64)];
+  while (Length > 0) {
+        ssize_t r = pread(Fd, buf, min(Length, sizeof(buf)), Offset);
+        if (r <= 0 || fwrite(buf, r, 1, f) != 1)
+           return false;
+        Offset += r;
+        Length -= r;
+        }
+  return true;
+}
+
+bool cEpgDataWriter::Collect(tEpgDataChunk *Chunk, const cSchedule *Schedule, const cChannels *Channels, time_t Now)
+{
+  free(Chunk->text);
+  free(Chunk->data);
+  Chunk->text = Chunk->data = NULL;
+  Chunk->expires = 0;
+  Chunk->numEvents = 0;
+  size_t TextLength = 0;
+  FILE *f = open_memstream(&Chunk->text, &TextLength);
+  if (!f)
+     return false;
+  Schedule->Dump(Channels, f);
+  fclose(f);
+  size_t DataLength = 0;
+  if ((f = open_memstream(&Chunk->data, &DataLength)) == NULL)
+     return false;
+  const cList<cEvent> *Events = Schedule->Events();
+  for (const cEvent *e = Events->First(); e; e = Events->Next(e)) {
+      if (e->EndTime() + EPG_LINGER_TIME >= Now) { // same as in cEvent::Dump()
+         if (!Chunk->expires || e->EndTime() + EPG_LINGER_TIME < Chunk->expires)
+            Chunk->expires = e->EndTime() + EPG_LINGER_TIME;
+         Chunk->numEvents++;
+         }
+      }
+  cEpgSnapshotWriter Writer(f);
+  Writer.Put(Chunk->numEvents);
+  for (const cEvent *e = Events->First(); e; e = Events->Next(e)) {
+      if (e->EndTime() + EPG_LINGER_TIME >= Now)
+         Writer.PutEvent(e);
+      }
+  fclose(f);
+  Chunk->textLength = TextLength;
+  Chunk->dataLength = DataLength;
+  return Writer.Ok();
+}
+
+bool cEpgDataWriter::Write(tEpgDataChunk *Chunk, FILE *TextFile, int OldText, FILE *DataFile, int OldData)
+{
+  off_t TextOffset = ftello(TextFile);
+  off_t DataOffset = ftello(DataFile);
+  bool Ok;
+  if (Chunk->text)
+     Ok = fwrite(Chunk->text, Chunk->textLength, 1, TextFile) == 1 || !Chunk->textLength;
+  else
+     Ok = CopyFileData(OldText, Chunk->textOffset, Chunk->textLength, TextFile);
+  if (!Chunk->numEvents)
+     ; // empty schedules are not stored in the binary snapshot
+  else if (Chunk->data)
+     Ok &= fwrite(Chunk->data, Chunk->dataLength, 1, DataFile) == 1;
+  else
+     Ok &= CopyFileData(OldData, Chunk->dataOffset, Chunk->dataLength, DataFile);
+  Chunk->textOffset = TextOffset;
+  Chunk->dataOffset = DataOffset;
+  free(Chunk->text);
+  free(Chunk->data);
+  Chunk->text = Chunk->data = NULL;
+  return Ok;
+}
+
+void cEpgDataWriter::Save(void)
+{
+  // The EPG data is collected in small slices, so that the schedules are never
+  // locked for long. Only schedules that have been modified since the previous
+  // save are actually collected, the data of all others is copied from the
+  // files that have been written the last time:
+  const char *TextFileName = cSchedules::epgDataFileName;
+  cString DataFileName = cSchedules::SnapshotFileName();
+  int OldText = open(TextFileName, O_RDONLY);
+  int OldData = open(DataFileName, O_RDONLY);
+  if (!SameFile(OldText, textStat) || !SameFile(OldData, dataStat))
+     Invalidate();
+  cSafeFile TextFile(TextFileName);
+  cSafeFile DataFile(DataFileName);
+  bool Ok = TextFile.Open() && DataFile.Open();
+  cEpgSnapshotWriter Writer(DataFile);
+  if (Ok) {
+     tEpgSnapshotHeader Header = { EPGSNAPSHOTMAGIC, EPGSNAPSHOTVERSION };
+     Writer.Put(Header);
+     }
+  cVector<tEpgSnapshotEntry *> Entries;
+  int Collected = 0;
+  for (int Index = 0; Ok; ) {
+      int First = Index;
+      bool Done = false;
+      time_t Now = time(NULL);
+      {
+        LOCK_CHANNELS_READ;
+        LOCK_SCHEDULES_READ;
+        cTimeMs Slice(EPGDATASLICETIME);
+        const cSchedule *p = Schedules->First();
+        for (int i = 0; p && i < Index; i++)
+            p = Schedules->Next(p);
+        for ( ; p && Ok && !Slice.TimedOut(); p = Schedules->Next(p), Index++) {
+            if (Index < chunks.Size() && chunks[Index]->schedule != p) {
+               // Schedules are only ever appended, so this shouldn't happen:
+               for (int i = Index; i < chunks.Size(); i++)
+                   delete chunks[i];
+               chunks.Remove(Index, chunks.Size() - Index);
+               }
+            if (Index == chunks.Size())
+               chunks.Append(new tEpgDataChunk(p));
+            tEpgDataChunk *Chunk = chunks[Index];
+            if (p->Modified(Chunk->state) || Chunk->expires && Chunk->expires < Now) {
+               Ok = Collect(Chunk, p, Channels, Now);
+               Collected++;
+               }
+            }
+        Done = !p;
+      }
+      // Now write the data of this slice, without holding any locks:
+      for (int i = First; i < Index && Ok; i++) {
+          tEpgDataChunk *Chunk = chunks[i];
+          Ok = Write(Chunk, TextFile, OldText, DataFile, OldData);
+          if (Chunk->numEvents) {
+             tChannelID ChannelID = Chunk->schedule->ChannelID();
+             Entries.Append(new tEpgSnapshotEntry{ ChannelID.Source(), ChannelID.Nid(), ChannelID.Tid(), ChannelID.Sid(), uint64_t(Chunk->dataOffset), uint32_t(Chunk->dataLength), Chunk->numEvents });
+             }
+          }
+      if (Done)
+         break;
+      cCondWait::SleepMs(EPGDATASLICEPAUSE);
+      }
+  if (Ok) {
+     tEpgSnapshotTrailer Trailer = { uint64_t(Writer.Offset()), uint32_t(Entries.Size()), EPGSNAPSHOTMAGIC };
+     for (int i = 0; i < Entries.Size(); i++)
+         Writer.Put(*Entries[i]);
+     Writer.Put(Trailer);
+     Ok = Writer.Ok();
+     }
+  for (int i = 0; i < Entries.Size(); i++)
+      delete Entries[i];
+  if (OldText >= 0)
+     close(OldText);
+  if (OldData >= 0)
+     close(OldData);
+  Ok &= TextFile.Close();
+  Ok &= DataFile.Close();
+  if (Ok && stat(TextFileName, &textStat) == 0 && stat(DataFileName, &dataStat) == 0)
+     dsyslog("EPG data written (%d of %d schedules collected)", Collected, chunks.Size());
+  else {
+     esyslog("ERROR: failed to write EPG data to %s", TextFileName);
+     Invalidate();
+     }
 }
 
 static cEpgDataWriter EpgDataWriter;
@@ -1328,32 +2275,89 @@ void cSchedules::ResetVersions(void)
 
 bool cSchedules::Dump(FILE *f, const char *Prefix, eDumpMode DumpMode, time_t AtTime)
 {
-  cSafeFile *sf = NULL;
   if (!f) {
-     sf = new cSafeFile(epgDataFileName);
-     if (sf->Open())
-        f = *sf;
-     else {
-        LOG_ERROR;
-        delete sf;
-        return false;
-        }
+     if (epgDataFileName)
+        EpgDataWriter.Dump();
+     return epgDataFileName != NULL;
      }
   LOCK_CHANNELS_READ;
   LOCK_SCHEDULES_READ;
   for (const cSchedule *p = Schedules->First(); p; p = Schedules->Next(p))
       p->Dump(Channels, f, Prefix, DumpMode, AtTime);
-  if (sf) {
-     sf->Close();
-     delete sf;
+  return true;
+}
+
+cString cSchedules::SnapshotFileName(void)
+{
+  return cString::sprintf("%s.bin", epgDataFileName);
+}
+
+bool cSchedules::ReadSnapshot(void)
+{
+  if (!epgDataFileName)
+     return false;
+  cString FileName = SnapshotFileName();
+  struct stat st;
+  if (stat(FileName, &st) != 0)
+     return false;
+  struct stat sd;
+  if (stat(epgDataFileName, &sd) == 0 && sd.st_mtime > st.st_mtime) {
+     dsyslog("%s is older than %s - ignored", *FileName, epgDataFileName);
+     return false;
+     }
+  int fd = open(FileName, O_RDONLY);
+  if (fd < 0) {
+     LOG_ERROR_STR(*FileName);
+     return false;
      }
+  size_t Size = st.st_size;
+  void *p = Size >= sizeof(tEpgSnapshotHeader) + sizeof(tEpgSnapshotTrailer) ? mmap(NULL, Size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (p == MAP_FAILED) {
+     esyslog("ERROR: can't map EPG snapshot %s", *FileName);
+     return false;
+     }
+  uchar *Data = (uchar *)p;
+  tEpgSnapshotHeader Header;
+  tEpgSnapshotTrailer Trailer;
+  memcpy(&Header, Data, sizeof(Header));
+  memcpy(&Trailer, Data + Size - sizeof(Trailer), sizeof(Trailer));
+  if (Header.magic != EPGSNAPSHOTMAGIC || Header.version != EPGSNAPSHOTVERSION || Trailer.magic != EPGSNAPSHOTMAGIC ||
+      Trailer.tableOffset < sizeof(Header) || Trailer.tableOffset + uint64_t(Trailer.numSchedules) * sizeof(tEpgSnapshotEntry) + sizeof(Trailer) != Size) {
+     esyslog("ERROR: invalid EPG snapshot %s", *FileName);
+     munmap(Data, Size);
+     return false;
+     }
+  dsyslog("reading EPG data from %s", *FileName);
+  cEpgSnapshot *Snapshot = new cEpgSnapshot(Data, Size);
+  {
+    LOCK_SCHEDULES_WRITE;
+    for (uint32_t i = 0; i < Trailer.numSchedules; i++) {
+        tEpgSnapshotEntry Entry;
+        memcpy(&Entry, Data + Trailer.tableOffset + i * sizeof(Entry), sizeof(Entry));
+        tChannelID ChannelID(Entry.source, Entry.nid, Entry.tid, Entry.sid);
+        if (Entry.offset < sizeof(Header) || Entry.offset + Entry.length > Trailer.tableOffset || !ChannelID.Valid()) {
+           esyslog("ERROR: invalid entry %d in EPG snapshot %s", i, *FileName);
+           continue;
+           }
+        if (cSchedule *Schedule = Schedules->AddSchedule(ChannelID)) {
+           if (Schedule->events.First() || Schedule->snapshot)
+              continue; // we don't mix the snapshot data with existing events
+           Schedule->SetSnapshot(Snapshot, Data + Entry.offset, Entry.length);
+           }
+        }
+  }
+  Snapshot->Detach(); // the schedules now keep it alive as long as they need it
   return true;
 }
 
 bool cSchedules::Read(FILE *f)
 {
   bool OwnFile = f == NULL;
-  if (OwnFile) {
+  bool result = false;
+  if (OwnFile && ReadSnapshot())
+     result = true;
+  else if (OwnFile) {
      if (epgDataFileName && access(epgDataFileName, R_OK) == 0) {
         dsyslog("reading EPG data from %s", epgDataFileName);
         if ((f = fopen(epgDataFileName, "r")) == NULL) {
@@ -1366,9 +2370,11 @@ bool cSchedules::Read(FILE *f)
      }
   LOCK_CHANNELS_WRITE;
   LOCK_SCHEDULES_WRITE;
-  bool result = cSchedule::Read(f, Schedules);
-  if (OwnFile)
-     fclose(f);
+  if (!result) {
+     result = cSchedule::Read(f, Schedules);
+     if (OwnFile)
+        fclose(f);
+     }
   if (result) {
      // Initialize the channels' schedule pointers, so that the first WhatsOn menu will come up faster:
      for (cChannel *Channel = Channels->First(); Channel; Channel = Channels->Next(Channel)) {
@@ -1422,6 +2428,12 @@ const cSchedule *cSchedules::GetSchedule(const cChannel *Channel, bool AddIfMiss
   return Channel->schedule != &DummySchedule? Channel->schedule : NULL;
 }
 
+void cSchedules::Search(const char *Query, cVector<const cEvent *> &Events) const
+{
+  for (const cSchedule *p = First(); p; p = Next(p))
+      p->Search(Query, Events);
+}
+
 // --- cEpgDataReader --------------------------------------------------------
 
 cEpgDataReader::cEpgDataReader(void)
@@ -1431,6 +2443,7 @@ cEpgDataReader::cEpgDataReader(void)
 
 void cEpgDataReader::Action(void)
 {
+  cStartupPhase StartupPhase("read EPG data");
   cSchedules::Read();
 }
 
@@ -1440,8 +2453,10 @@ static cMutex Mutex;
 
 cEpgHandler::cEpgHandler(void)
 {
+  notImplemented = 0;
   Mutex.Lock();
   EpgHandlers.Add(this);
+  EpgHandlers.UpdateHooks();
   Mutex.Unlock();
 }
 
@@ -1449,17 +2464,42 @@ cEpgHandler::~cEpgHandler()
 {
   Mutex.Lock();
   EpgHandlers.Del(this, false);
+  EpgHandlers.UpdateHooks();
   Mutex.Unlock();
 }
 
+bool cEpgHandler::NotImplemented(eEpgHook Hook)
+{
+  if (!(notImplemented & (1 << Hook))) {
+     Mutex.Lock();
+     notImplemented |= 1 << Hook;
+     EpgHandlers.UpdateHooks();
+     Mutex.Unlock();
+     }
+  return false;
+}
+
 // --- cEpgHandlers ----------------------------------------------------------
 
 cEpgHandlers EpgHandlers;
 
+cEpgHandlers::cEpgHandlers(void)
+{
+  notImplemented = 0xFFFFFFFF; // no handlers, so nothing is implemented
+}
+
+void cEpgHandlers::UpdateHooks(void)
+{
+  uint32_t NotImplemented = 0xFFFFFFFF;
+  for (cEpgHandler *eh = First(); eh; eh = Next(eh))
+      NotImplemented &= eh->notImplemented;
+  notImplemented = NotImplemented;
+}
+
 bool cEpgHandlers::IgnoreChannel(const cChannel *Channel)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->IgnoreChannel(Channel))
+  for (cEpgHandler *eh = Empty(ehIgnoreChannel) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehIgnoreChannel) && eh->IgnoreChannel(Channel))
          return true;
       }
   return false;
@@ -1467,8 +2507,8 @@ bool cEpgHandlers::IgnoreChannel(const cChannel *Channel)
 
 bool cEpgHandlers::HandleEitEvent(cSchedule *Schedule, const SI::EIT::Event *EitEvent, uchar TableID, uchar Version)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->HandleEitEvent(Schedule, EitEvent, TableID, Version))
+  for (cEpgHandler *eh = Empty(ehHandleEitEvent) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehHandleEitEvent) && eh->HandleEitEvent(Schedule, EitEvent, TableID, Version))
          return true;
       }
   return false;
@@ -1476,8 +2516,8 @@ bool cEpgHandlers::HandleEitEvent(cSchedule *Schedule, const SI::EIT::Event *Eit
 
 bool cEpgHandlers::HandledExternally(const cChannel *Channel)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->HandledExternally(Channel))
+  for (cEpgHandler *eh = Empty(ehHandledExternally) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehHandledExternally) && eh->HandledExternally(Channel))
          return true;
       }
   return false;
@@ -1485,8 +2525,8 @@ bool cEpgHandlers::HandledExternally(const cChannel *Channel)
 
 bool cEpgHandlers::IsUpdate(tEventID EventID, time_t StartTime, uchar TableID, uchar Version)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->IsUpdate(EventID, StartTime, TableID, Version))
+  for (cEpgHandler *eh = Empty(ehIsUpdate) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehIsUpdate) && eh->IsUpdate(EventID, StartTime, TableID, Version))
          return true;
       }
   return false;
@@ -1494,8 +2534,8 @@ bool cEpgHandlers::IsUpdate(tEventID EventID, time_t StartTime, uchar TableID, u
 
 void cEpgHandlers::SetEventID(cEvent *Event, tEventID EventID)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SetEventID(Event, EventID))
+  for (cEpgHandler *eh = Empty(ehSetEventID) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSetEventID) && eh->SetEventID(Event, EventID))
          return;
       }
   Event->SetEventID(EventID);
@@ -1503,8 +2543,8 @@ void cEpgHandlers::SetEventID(cEvent *Event, tEventID EventID)
 
 void cEpgHandlers::SetTitle(cEvent *Event, const char *Title)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SetTitle(Event, Title))
+  for (cEpgHandler *eh = Empty(ehSetTitle) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSetTitle) && eh->SetTitle(Event, Title))
          return;
       }
   Event->SetTitle(Title);
@@ -1512,8 +2552,8 @@ void cEpgHandlers::SetTitle(cEvent *Event, const char *Title)
 
 void cEpgHandlers::SetLanguage(cEvent *Event, const char *Language)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SetLanguage(Event, Language))
+  for (cEpgHandler *eh = Empty(ehSetLanguage) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSetLanguage) && eh->SetLanguage(Event, Language))
          return;
       }
   Event->SetLanguage(Language);
@@ -1521,8 +2561,8 @@ void cEpgHandlers::SetLanguage(cEvent *Event, const char *Language)
 
 void cEpgHandlers::SetShortText(cEvent *Event, const char *ShortText)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SetShortText(Event, ShortText))
+  for (cEpgHandler *eh = Empty(ehSetShortText) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSetShortText) && eh->SetShortText(Event, ShortText))
          return;
       }
   Event->SetShortText(ShortText);
@@ -1530,8 +2570,8 @@ void cEpgHandlers::SetShortText(cEvent *Event, const char *ShortText)
 
 void cEpgHandlers::SetDescription(cEvent *Event, const char *Description)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SetDescription(Event, Description))
+  for (cEpgHandler *eh = Empty(ehSetDescription) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSetDescription) && eh->SetDescription(Event, Description))
          return;
       }
   Event->SetDescription(Description);
@@ -1539,8 +2579,8 @@ void cEpgHandlers::SetDescription(cEvent *Event, const char *Description)
 
 void cEpgHandlers::SetContents(cEvent *Event, uchar *Contents)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SetContents(Event, Contents))
+  for (cEpgHandler *eh = Empty(ehSetContents) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSetContents) && eh->SetContents(Event, Contents))
          return;
       }
   Event->SetContents(Contents);
@@ -1548,8 +2588,8 @@ void cEpgHandlers::SetContents(cEvent *Event, uchar *Contents)
 
 void cEpgHandlers::SetParentalRating(cEvent *Event, int ParentalRating)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SetParentalRating(Event, ParentalRating))
+  for (cEpgHandler *eh = Empty(ehSetParentalRating) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSetParentalRating) && eh->SetParentalRating(Event, ParentalRating))
          return;
       }
   Event->SetParentalRating(ParentalRating);
@@ -1557,8 +2597,8 @@ void cEpgHandlers::SetParentalRating(cEvent *Event, int ParentalRating)
 
 void cEpgHandlers::SetStartTime(cEvent *Event, time_t StartTime)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SetStartTime(Event, StartTime))
+  for (cEpgHandler *eh = Empty(ehSetStartTime) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSetStartTime) && eh->SetStartTime(Event, StartTime))
          return;
       }
   Event->SetStartTime(StartTime);
@@ -1566,8 +2606,8 @@ void cEpgHandlers::SetStartTime(cEvent *Event, time_t StartTime)
 
 void cEpgHandlers::SetDuration(cEvent *Event, int Duration)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SetDuration(Event, Duration))
+  for (cEpgHandler *eh = Empty(ehSetDuration) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSetDuration) && eh->SetDuration(Event, Duration))
          return;
       }
   Event->SetDuration(Duration);
@@ -1575,8 +2615,8 @@ void cEpgHandlers::SetDuration(cEvent *Event, int Duration)
 
 void cEpgHandlers::SetVps(cEvent *Event, time_t Vps)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SetVps(Event, Vps))
+  for (cEpgHandler *eh = Empty(ehSetVps) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSetVps) && eh->SetVps(Event, Vps))
          return;
       }
   Event->SetVps(Vps);
@@ -1584,8 +2624,8 @@ void cEpgHandlers::SetVps(cEvent *Event, time_t Vps)
 
 void cEpgHandlers::SetComponents(cEvent *Event, cComponents *Components)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SetComponents(Event, Components))
+  for (cEpgHandler *eh = Empty(ehSetComponents) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSetComponents) && eh->SetComponents(Event, Components))
          return;
       }
   Event->SetComponents(Components);
@@ -1593,8 +2633,8 @@ void cEpgHandlers::SetComponents(cEvent *Event, cComponents *Components)
 
 void cEpgHandlers::FixEpgBugs(cEvent *Event)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->FixEpgBugs(Event))
+  for (cEpgHandler *eh = Empty(ehFixEpgBugs) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehFixEpgBugs) && eh->FixEpgBugs(Event))
          return;
       }
   Event->FixEpgBugs();
@@ -1602,16 +2642,16 @@ void cEpgHandlers::FixEpgBugs(cEvent *Event)
 
 void cEpgHandlers::HandleEvent(cEvent *Event)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->HandleEvent(Event))
+  for (cEpgHandler *eh = Empty(ehHandleEvent) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehHandleEvent) && eh->HandleEvent(Event))
          break;
       }
 }
 
 void cEpgHandlers::SortSchedule(cSchedule *Schedule)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->SortSchedule(Schedule))
+  for (cEpgHandler *eh = Empty(ehSortSchedule) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehSortSchedule) && eh->SortSchedule(Schedule))
          return;
       }
   Schedule->Sort();
@@ -1619,8 +2659,8 @@ void cEpgHandlers::SortSchedule(cSchedule *Schedule)
 
 void cEpgHandlers::DropOutdated(cSchedule *Schedule, time_t SegmentStart, time_t SegmentEnd, uchar TableID, uchar Version)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->DropOutdated(Schedule, SegmentStart, SegmentEnd, TableID, Version))
+  for (cEpgHandler *eh = Empty(ehDropOutdated) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehDropOutdated) && eh->DropOutdated(Schedule, SegmentStart, SegmentEnd, TableID, Version))
          return;
       }
   Schedule->DropOutdated(SegmentStart, SegmentEnd, TableID, Version);
@@ -1628,8 +2668,8 @@ void cEpgHandlers::DropOutdated(cSchedule *Schedule, time_t SegmentStart, time_t
 
 bool cEpgHandlers::BeginSegmentTransfer(const cChannel *Channel)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (!eh->BeginSegmentTransfer(Channel, false))
+  for (cEpgHandler *eh = Empty(ehBeginSegmentTransfer) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehBeginSegmentTransfer) && !eh->BeginSegmentTransfer(Channel, false))
          return false;
       }
   return true;
@@ -1637,8 +2677,8 @@ bool cEpgHandlers::BeginSegmentTransfer(const cChannel *Channel)
 
 void cEpgHandlers::EndSegmentTransfer(bool Modified)
 {
-  for (cEpgHandler *eh = First(); eh; eh = Next(eh)) {
-      if (eh->EndSegmentTransfer(Modified, false))
+  for (cEpgHandler *eh = Empty(ehEndSegmentTransfer) ? NULL : First(); eh; eh = Next(eh)) {
+      if (!Skip(eh, ehEndSegmentTransfer) && eh->EndSegmentTransfer(Modified, false))
          return;
       }
 }
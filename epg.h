@@ -13,6 +13,7 @@
 #ifndef __EPG_H
 #define __EPG_H
 
+#include <atomic>
 #include "channels.h"
 #include "libsi/section.h"
 #include "thread.h"
@@ -39,7 +40,7 @@ enum eEventContentGroup {
   ecgUserDefined              = 0xF0
   };
 
-enum eDumpMode { dmAll, dmPresent, dmFollowing, dmAtTime };
+enum eDumpMode { dmAll, dmPresent, dmFollowing, dmAtTime, dmBetween };
 
 struct tComponent {
   uchar stream;
@@ -50,10 +51,13 @@ struct tComponent {
   bool FromString(const char *s);
   };
 
+#define MAXINLINECOMPONENTS 4 // most events have only a few components, so they are stored within cComponents itself
+
 class cComponents {
 private:
   int numComponents;
   tComponent *components;
+  tComponent inlineComponents[MAXINLINECOMPONENTS];
   bool Realloc(int Index);
 public:
   cComponents(void);
@@ -70,8 +74,28 @@ class cSchedule;
 
 typedef u_int32_t tEventID;
 
+class cEpgStrings {
+private:
+  struct tString;
+  static cMutex mutex;
+  static tString **hash;
+  static int hashSize;
+  static int count;
+  static void Resize(int Size);
+public:
+  static const char *Get(const char *s);
+       ///< Returns a pointer to a shared, reference counted copy of the given string s
+       ///< (or NULL, if s is NULL). Identical strings (like the descriptions of a series
+       ///< that are repeated on many channels and days) are stored only once.
+       ///< Every pointer returned by Get() must eventually be given to Release().
+  static void Release(const char *s);
+       ///< Releases a string that has been returned by Get(). The string is deleted
+       ///< when its last reference is released. s may be NULL.
+  };
+
 class cEvent : public cListObject {
   friend class cSchedule;
+  friend class cEventHash;
 private:
   static cMutex numTimersMutex; // Protects numTimers, because it might be accessed from parallel read locks
   // The sequence of these parameters is optimized for minimal memory waste!
@@ -83,9 +107,9 @@ private:
   uchar runningStatus;     // 0=undefined, 1=not running, 2=starts in a few seconds, 3=pausing, 4=running
   uchar parentalRating;    // Parental rating of this event
   char language[MAXLANGCODE1]; // ISO 639-2/T three character language code of the language of title and shortText, 0 terminated!//XXX description?
-  char *title;             // Title of this event
-  char *shortText;         // Short description of this event (typically the episode name in case of a series)
-  char *description;       // Description of this event
+  const char *title;       // Title of this event (from cEpgStrings)
+  const char *shortText;   // Short description of this event (typically the episode name in case of a series) (from cEpgStrings)
+  const char *description; // Description of this event (from cEpgStrings)
   cComponents *components; // The stream components of this event
   time_t startTime;        // Start time of this event
   int duration;            // Duration of this event in seconds
@@ -93,6 +117,8 @@ private:
   time_t vps;              // Video Programming Service timestamp (VPS, aka "Programme Identification Label", PIL)
   time_t seen;             // When this event was last seen in the data stream
   char *aux;               // Auxiliary data, for use with plugins
+  cEvent *hashNextID;      // The next event in the same bucket of the schedule's eventsHashID
+  cEvent *hashNextStartTime;// The next event in the same bucket of the schedule's eventsHashStartTime
 public:
   cEvent(tEventID EventID);
   ~cEvent();
@@ -150,27 +176,86 @@ public:
   void FixEpgBugs(void);
   };
 
+class cEventHash {
+private:
+  cEvent *cEvent::*next; // the link within cEvent that is used by this hash
+  bool byStartTime;
+  cEvent **buckets;
+  int size;
+  int count;
+  intmax_t Key(const cEvent *Event) const { return byStartTime ? intmax_t(Event->startTime) : intmax_t(Event->eventID); }
+  int Bucket(intmax_t Key) const;
+  void Resize(int Size);
+public:
+  cEventHash(cEvent *cEvent::*Next, bool ByStartTime);
+       ///< Creates a hash of events, using either their start time or their event id
+       ///< as the key. The links between the events are stored in the events themselves,
+       ///< using the member that Next points to, so an event can only be in one hash
+       ///< per link member at a time.
+  ~cEventHash();
+  void Add(cEvent *Event);
+       ///< Adds the given Event. If there is already an event with the same key, it is
+       ///< removed from the hash.
+  void Del(cEvent *Event);
+       ///< Removes the given Event from the hash (if it is in it).
+  cEvent *Get(intmax_t Key) const;
+  };
+
 class cSchedules;
+class cEpgSnapshot;
+class cEpgIndex;
 
 class cSchedule : public cListObject  {
+  friend class cEvent;
+  friend class cSchedules;
 private:
   static cMutex numTimersMutex; // Protects numTimers, because it might be accessed from parallel read locks
   tChannelID channelID;
   cList<cEvent> events;
-  cHash<cEvent> eventsHashID;
-  cHash<cEvent> eventsHashStartTime;
+  cEventHash eventsHashID;
+  cEventHash eventsHashStartTime;
+  mutable cVector<const cEvent *> eventsByTime; // all events, sorted by start time
+  mutable int maxDuration;                      // the longest duration of all events in eventsByTime
+  mutable std::atomic_bool eventsByTimeValid;
+  mutable cMutex eventsByTimeMutex;             // protects updating eventsByTime from parallel read locks
+  void InvalidateEventsByTime(void) { eventsByTimeValid = false; }
+  void UpdateEventsByTime(void) const;
+  int FirstEventAfter(time_t Time) const;
+       ///< Returns the position within eventsByTime of the first event that starts after
+       ///< the given Time (or eventsByTime.Size(), if there is none).
+  mutable std::atomic<cEpgSnapshot *> snapshot; // the binary EPG snapshot this schedule's events have not yet been decoded from
+  const uchar *snapshotData;
+  int snapshotLength;
+  mutable cMutex snapshotMutex;
+  void Load(void) const { if (snapshot) DecodeSnapshot(); }
+       ///< Makes sure the events of this schedule have been decoded from the binary
+       ///< EPG snapshot, in case they have been read from one.
+  void DecodeSnapshot(void) const;
+  void SetSnapshot(cEpgSnapshot *Snapshot, const uchar *Data, int Length);
+  mutable cEpgIndex *index;                    // the full text index of the events, if Setup.EPGSearchIndex is set
+  mutable cMutex indexMutex;                   // protects building the index from parallel read locks
+  void IndexText(const cEvent *Event, const char *OldText, const char *NewText);
   mutable u_int16_t numTimers;// The number of timers that use this schedule
   bool onActualTp;
   int modified;
+  static std::atomic<int> lastModified;
   time_t presentSeen;
 public:
   cSchedule(tChannelID ChannelID);
+  ~cSchedule();
   tChannelID ChannelID(void) const { return channelID; }
   bool Modified(int &State) const { bool Result = State != modified; State = modified; return Result; }
+  bool ModifiedSince(int State) const { return modified > State; }
+       ///< Returns true if this schedule has been modified after the given State, as
+       ///< returned by LastModified().
+  static int LastModified(void) { return lastModified; }
+       ///< Returns the state of the most recent modification of any schedule.
+       ///< Modifications are numbered across all schedules, so this can be used to
+       ///< find the schedules that have been modified since a given point in time.
   bool OnActualTp(uchar TableId);
   time_t PresentSeen(void) const { return presentSeen; }
   bool PresentSeenWithin(int Seconds) const { return time(NULL) - presentSeen < Seconds; }
-  void SetModified(void) { modified++; }
+  void SetModified(void) { modified = ++lastModified; }
   void SetPresentSeen(void) { presentSeen = time(NULL); }
   void SetRunningStatus(cEvent *Event, int RunningStatus, const cChannel *Channel = NULL);
   void ClrRunningStatus(cChannel *Channel = NULL);
@@ -186,22 +271,37 @@ public:
   void DelEvent(cEvent *Event);
   void HashEvent(cEvent *Event);
   void UnhashEvent(cEvent *Event);
-  const cList<cEvent> *Events(void) const { return &events; }
+  const cList<cEvent> *Events(void) const { Load(); return &events; }
   const cEvent *GetPresentEvent(void) const;
   const cEvent *GetFollowingEvent(void) const;
   const cEvent *GetEventById(tEventID EventID) const;
   const cEvent *GetEventByTime(time_t StartTime) const;
   const cEvent *GetEventAround(time_t Time) const;
-  void Dump(const cChannels *Channels, FILE *f, const char *Prefix = "", eDumpMode DumpMode = dmAll, time_t AtTime = 0) const;
+  void GetEventsBetween(time_t Begin, time_t End, cVector<const cEvent *> &Events) const;
+       ///< Appends all events of this schedule that end at or after Begin and start at
+       ///< or before End to Events, sorted by start time.
+  void Search(const char *Query, cVector<const cEvent *> &Events) const;
+       ///< Appends all events of this schedule that contain all words of the given Query
+       ///< in their title, short text or description to Events, sorted by start time.
+       ///< Words are compared without regard to case, and words consisting of only a
+       ///< single character are ignored. If Setup.EPGSearchIndex is set, an index of
+       ///< all words is used (and built upon the first call), otherwise the text of
+       ///< all events is searched.
+  void Dump(const cChannels *Channels, FILE *f, const char *Prefix = "", eDumpMode DumpMode = dmAll, time_t AtTime = 0, time_t EndTime = 0) const;
+       ///< Writes the events of this schedule to f. With dmBetween only the events that
+       ///< end at or after AtTime and start at or before EndTime are written.
   static bool Read(FILE *f, cSchedules *Schedules);
   };
 
 class cSchedules : public cList<cSchedule> {
   friend class cSchedule;
+  friend class cEpgDataWriter;
 private:
   static cSchedules schedules;
   static char *epgDataFileName;
   static time_t lastDump;
+  static cString SnapshotFileName(void);
+  static bool ReadSnapshot(void);
 public:
   cSchedules(void);
   static const cSchedules *GetSchedulesRead(cStateKey &StateKey, int TimeoutMs = 0);
@@ -214,10 +314,22 @@ public:
   static void Cleanup(bool Force = false);
   static void ResetVersions(void);
   static bool Dump(FILE *f = NULL, const char *Prefix = "", eDumpMode DumpMode = dmAll, time_t AtTime = 0);
+       ///< Writes the EPG data to the given file f. If f is NULL, the data is written
+       ///< to the epg.data file, and additionally to the binary EPG snapshot, which
+       ///< allows for a considerably faster startup. In that case only the schedules
+       ///< that have been modified since the last time are actually collected, and
+       ///< the schedules are only locked for short periods of time.
   static bool Read(FILE *f = NULL);
+       ///< Reads EPG data from the given file f. If f is NULL, the binary EPG snapshot
+       ///< is used if it is at least as new as the epg.data file, in which case the
+       ///< events of each schedule are only decoded when they are first accessed.
+       ///< Otherwise the epg.data file is read.
   cSchedule *AddSchedule(tChannelID ChannelID);
   const cSchedule *GetSchedule(tChannelID ChannelID) const;
   const cSchedule *GetSchedule(const cChannel *Channel, bool AddIfMissing = false) const;
+  void Search(const char *Query, cVector<const cEvent *> &Events) const;
+       ///< Appends the events of all schedules that match the given Query to Events.
+       ///< See cSchedule::Search() for details.
   };
 
 // Provide lock controlled access to the list:
@@ -239,7 +351,41 @@ public:
 
 void ReportEpgBugFixStats(bool Force = false);
 
+enum eEpgHook {
+  ehIgnoreChannel,
+  ehHandleEitEvent,
+  ehHandledExternally,
+  ehIsUpdate,
+  ehSetEventID,
+  ehSetLanguage,
+  ehSetTitle,
+  ehSetShortText,
+  ehSetDescription,
+  ehSetContents,
+  ehSetParentalRating,
+  ehSetStartTime,
+  ehSetDuration,
+  ehSetVps,
+  ehSetComponents,
+  ehFixEpgBugs,
+  ehHandleEvent,
+  ehSortSchedule,
+  ehDropOutdated,
+  ehBeginSegmentTransfer,
+  ehEndSegmentTransfer,
+  };
+
 class cEpgHandler : public cListObject {
+  friend class cEpgHandlers;
+private:
+  uint32_t notImplemented; // a bit mask of the eEpgHook functions this handler doesn't implement
+protected:
+  bool NotImplemented(eEpgHook Hook);
+          ///< Called by the default implementations of the hook functions, to record that
+          ///< this handler doesn't implement the given Hook. From then on, that function
+          ///< will no longer be called for this handler (and not at all, if none of the
+          ///< handlers implements it). A derived class that implements a hook function
+          ///< must therefore not call the function of the base class. Returns false.
 public:
   cEpgHandler(void);
           ///< Constructs a new EPG handler and adds it to the list of EPG handlers.
@@ -251,64 +397,71 @@ public:
           ///< will take place.
           ///< EPG handlers will be deleted automatically at the end of the program.
   virtual ~cEpgHandler() override;
-  virtual bool IgnoreChannel(const cChannel *Channel) { return false; }
+  virtual bool IgnoreChannel(const cChannel *Channel) { return NotImplemented(ehIgnoreChannel); }
           ///< Before any EIT data for the given Channel is processed, the EPG handlers
           ///< are asked whether this Channel shall be completely ignored. If any of
           ///< the EPG handlers returns true in this function, no EIT data at all will
           ///< be processed for this Channel.
-  virtual bool HandleEitEvent(cSchedule *Schedule, const SI::EIT::Event *EitEvent, uchar TableID, uchar Version) { return false; }
+  virtual bool HandleEitEvent(cSchedule *Schedule, const SI::EIT::Event *EitEvent, uchar TableID, uchar Version) { return NotImplemented(ehHandleEitEvent); }
           ///< Before the raw EitEvent for the given Schedule is processed, the
           ///< EPG handlers are queried to see if any of them would like to do the
           ///< complete processing by itself. TableID and Version are from the
           ///< incoming section data.
-  virtual bool HandledExternally(const cChannel *Channel) { return false; }
+  virtual bool HandledExternally(const cChannel *Channel) { return NotImplemented(ehHandledExternally); }
           ///< If any EPG handler returns true in this function, it is assumed that
           ///< the EPG for the given Channel is handled completely from some external
           ///< source. Incoming EIT data is processed as usual, but any new EPG event
           ///< will not be added to the respective schedule. It's up to the EPG
           ///< handler to take care of this.
-  virtual bool IsUpdate(tEventID EventID, time_t StartTime, uchar TableID, uchar Version) { return false; }
+  virtual bool IsUpdate(tEventID EventID, time_t StartTime, uchar TableID, uchar Version) { return NotImplemented(ehIsUpdate); }
           ///< VDR can't perform the update check (version, tid) for externally handled events,
           ///< therefore the EPG handlers have to take care of this. Otherwise the parsing of
           ///< non-updates will waste a lot of resources.
-  virtual bool SetEventID(cEvent *Event, tEventID EventID) { return false; }
+  virtual bool SetEventID(cEvent *Event, tEventID EventID) { return NotImplemented(ehSetEventID); }
           ///< Important note: if you want VPS to work, do not mess with the event ids!
-  virtual bool SetLanguage(cEvent *Event, const char *Language) { return false; }
+  virtual bool SetLanguage(cEvent *Event, const char *Language) { return NotImplemented(ehSetLanguage); }
           ///< ISO 639-2/T three character language code of the language of title and shortText.
-  virtual bool SetTitle(cEvent *Event, const char *Title) { return false; }
-  virtual bool SetShortText(cEvent *Event, const char *ShortText) { return false; }
-  virtual bool SetDescription(cEvent *Event, const char *Description) { return false; }
-  virtual bool SetContents(cEvent *Event, uchar *Contents) { return false; }
-  virtual bool SetParentalRating(cEvent *Event, int ParentalRating) { return false; }
-  virtual bool SetStartTime(cEvent *Event, time_t StartTime) { return false; }
-  virtual bool SetDuration(cEvent *Event, int Duration) { return false; }
-  virtual bool SetVps(cEvent *Event, time_t Vps) { return false; }
-  virtual bool SetComponents(cEvent *Event, cComponents *Components) { return false; }
-  virtual bool FixEpgBugs(cEvent *Event) { return false; }
+  virtual bool SetTitle(cEvent *Event, const char *Title) { return NotImplemented(ehSetTitle); }
+  virtual bool SetShortText(cEvent *Event, const char *ShortText) { return NotImplemented(ehSetShortText); }
+  virtual bool SetDescription(cEvent *Event, const char *Description) { return NotImplemented(ehSetDescription); }
+  virtual bool SetContents(cEvent *Event, uchar *Contents) { return NotImplemented(ehSetContents); }
+  virtual bool SetParentalRating(cEvent *Event, int ParentalRating) { return NotImplemented(ehSetParentalRating); }
+  virtual bool SetStartTime(cEvent *Event, time_t StartTime) { return NotImplemented(ehSetStartTime); }
+  virtual bool SetDuration(cEvent *Event, int Duration) { return NotImplemented(ehSetDuration); }
+  virtual bool SetVps(cEvent *Event, time_t Vps) { return NotImplemented(ehSetVps); }
+  virtual bool SetComponents(cEvent *Event, cComponents *Components) { return NotImplemented(ehSetComponents); }
+  virtual bool FixEpgBugs(cEvent *Event) { return NotImplemented(ehFixEpgBugs); }
           ///< Fixes some known problems with EPG data.
-  virtual bool HandleEvent(cEvent *Event) { return false; }
+  virtual bool HandleEvent(cEvent *Event) { return NotImplemented(ehHandleEvent); }
           ///< After all modifications of the Event have been done, the EPG handler
           ///< can take a final look at it.
-  virtual bool SortSchedule(cSchedule *Schedule) { return false; }
+  virtual bool SortSchedule(cSchedule *Schedule) { return NotImplemented(ehSortSchedule); }
           ///< Sorts the Schedule after the complete table has been processed.
-  virtual bool DropOutdated(cSchedule *Schedule, time_t SegmentStart, time_t SegmentEnd, uchar TableID, uchar Version) { return false; }
+  virtual bool DropOutdated(cSchedule *Schedule, time_t SegmentStart, time_t SegmentEnd, uchar TableID, uchar Version) { return NotImplemented(ehDropOutdated); }
           ///< Takes a look at all EPG events between SegmentStart and SegmentEnd and
           ///< drops outdated events.
-  virtual bool BeginSegmentTransfer(const cChannel *Channel, bool Dummy) { return true; } // TODO remove obsolete Dummy
+  virtual bool BeginSegmentTransfer(const cChannel *Channel, bool Dummy) { NotImplemented(ehBeginSegmentTransfer); return true; } // TODO remove obsolete Dummy
           ///< Called directly after IgnoreChannel() before any other handler method is called.
           ///< Designed to give handlers the possibility to prepare a database transaction.
           ///< If any EPG handler returns false in this function, it is assumed that
           ///< the EPG for the given Channel has to be handled later due to some transaction problems,
           ///> therefore the processing will be aborted.
           ///< Dummy is for backward compatibility and may be removed in a future version.
-  virtual bool EndSegmentTransfer(bool Modified, bool Dummy) { return false; } // TODO remove obsolete Dummy
+  virtual bool EndSegmentTransfer(bool Modified, bool Dummy) { return NotImplemented(ehEndSegmentTransfer); } // TODO remove obsolete Dummy
           ///< Called after the segment data has been processed.
           ///< At this point handlers should close/commit/rollback any pending database transactions.
           ///< Dummy is for backward compatibility and may be removed in a future version.
   };
 
 class cEpgHandlers : public cList<cEpgHandler> {
+  friend class cEpgHandler;
+private:
+  uint32_t notImplemented; // a bit mask of the eEpgHook functions none of the handlers implements
+  void UpdateHooks(void);
+  bool Skip(const cEpgHandler *Handler, eEpgHook Hook) const { return Handler->notImplemented & (1 << Hook); }
+  bool Empty(eEpgHook Hook) const { return notImplemented & (1 << Hook); }
 public:
+  cEpgHandlers(void);
   bool IgnoreChannel(const cChannel *Channel);
   bool HandleEitEvent(cSchedule *Schedule, const SI::EIT::Event *EitEvent, uchar TableID, uchar Version);
   bool HandledExternally(const cChannel *Channel);
@@ -73,6 +73,56 @@ bool cSectionSyncer::Processed(int SectionNumber, int LastSectionNumber, int Seg
   return complete;
 }
 
+// --- cSectionCollector -----------------------------------------------------
+
+cSectionCollector::cSectionCollector(void)
+{
+  version = -1;
+  memset(sections, 0, sizeof(sections));
+  memset(lengths, 0, sizeof(lengths));
+}
+
+cSectionCollector::~cSectionCollector()
+{
+  Clear();
+}
+
+void cSectionCollector::Clear(void)
+{
+  for (int i = 0; i < 256; i++) {
+      free(sections[i]);
+      sections[i] = NULL;
+      lengths[i] = 0;
+      }
+  version = -1;
+}
+
+void cSectionCollector::Add(uchar Version, int SectionNumber, const u_char *Data, int Length)
+{
+  if (SectionNumber < 0 || SectionNumber > 255)
+     return;
+  if (Version != version) {
+     Clear();
+     version = Version;
+     }
+  free(sections[SectionNumber]);
+  if ((sections[SectionNumber] = MALLOC(u_char, Length)) != NULL) {
+     memcpy(sections[SectionNumber], Data, Length);
+     lengths[SectionNumber] = Length;
+     }
+  else
+     lengths[SectionNumber] = 0;
+}
+
+const u_char *cSectionCollector::Get(int SectionNumber, int *Length) const
+{
+  if (SectionNumber < 0 || SectionNumber > 255)
+     return NULL;
+  if (Length)
+     *Length = lengths[SectionNumber];
+  return sections[SectionNumber];
+}
+
 // --- cFilterData -----------------------------------------------------------
 
 cFilterData::cFilterData(void)
@@ -39,6 +39,10 @@ public:
        ///< Returns true if Version is not the current version, or the given SectionNumber has not
        ///< been marked as processed, yet. Sections are handled in ascending order, starting at 0,
        ///< unless Random is true in the constructor call.
+  bool Known(uchar Version, int SectionNumber) { return Version == currentVersion && (complete || GetSectionFlag(SectionNumber)); }
+       ///< Returns true if the given SectionNumber of the given Version has already been
+       ///< processed, which means that Check() would return false. In contrast to Check(),
+       ///< this doesn't change any state, so it can be used with unverified data.
   bool Processed(int SectionNumber, int LastSectionNumber, int SegmentLastSectionNumber = -1);
        ///< Marks the given SectionNumber as processed.
        ///< LastSectionNumber is used to determine whether all sections have been processed.
@@ -49,6 +53,26 @@ public:
        ///< Returns true if all sections have been processed.
   };
 
+class cSectionCollector {
+private:
+  int version;
+  u_char *sections[256];
+  int lengths[256];
+public:
+  cSectionCollector(void);
+  ~cSectionCollector();
+  void Clear(void);
+       ///< Discards all collected sections.
+  void Add(uchar Version, int SectionNumber, const u_char *Data, int Length);
+       ///< Stores a copy of the given section. If Version differs from the version
+       ///< of the sections collected so far, those are discarded first.
+  const u_char *Get(int SectionNumber, int *Length = NULL) const;
+       ///< Returns the data of the given SectionNumber, or NULL if no such section
+       ///< has been collected. If Length is given, it receives the section's length.
+       ///< This allows a filter to collect all sections of a table (as reported by
+       ///< cSectionSyncer::Processed()) and then process them all at once.
+  };
+
 class cSectionSyncerRandom : public cSectionSyncer {
   ///< Helper class for having an array of random section syncers.
 public:
@@ -17,8 +17,10 @@
 #endif
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_SIZES_H
 #include "config.h"
 #include "osd.h"
+#include "thread.h"
 #include "tools.h"
 
 const char *DefaultFontOsd = "Sans Serif:Bold";
@@ -27,14 +29,6 @@ const char *DefaultFontFix = "Courier:Bold";
 
 // --- cFreetypeFont ---------------------------------------------------------
 
-#define KERNING_UNKNOWN  (-10000)
-
-struct tKerning {
-  uint prevSym;
-  int kerning;
-  tKerning(uint PrevSym, int Kerning = 0) { prevSym = PrevSym; kerning = Kerning; }
-  };
-
 class cGlyph : public cListObject {
 private:
   uint charCode;
@@ -46,7 +40,6 @@ private:
   int width; ///< The number of pixels per bitmap row.
   int rows;  ///< The number of bitmap rows.
   int pitch; ///< The pitch's absolute value is the number of bytes taken by one bitmap row, including padding.
-  cVector<tKerning> kerningCache;
 public:
   cGlyph(uint CharCode, FT_GlyphSlotRec_ *GlyphData);
   virtual ~cGlyph() override;
@@ -59,8 +52,6 @@ public:
   int Width(void) const { return width; }
   int Rows(void) const { return rows; }
   int Pitch(void) const { return pitch; }
-  int GetKerningCache(uint PrevSym) const;
-  void SetKerningCache(uint PrevSym, int Kerning);
   };
 
 cGlyph::cGlyph(uint CharCode, FT_GlyphSlotRec_ *GlyphData)
@@ -83,20 +74,304 @@ cGlyph::~cGlyph()
   free(bitmap);
 }
 
-int cGlyph::GetKerningCache(uint PrevSym) const
+// The glyphs of the Latin-1 range are accessed directly through a table,
+// all others through a hash, so that fonts with thousands of different
+// glyphs (as with CJK or Cyrillic texts) can still be handled efficiently.
+
+#define GLYPHTABLESIZE 256
+
+class cGlyphCache {
+private:
+  cList<cGlyph> glyphs;
+  cGlyph *glyphTable[GLYPHTABLESIZE];
+  cHash<cGlyph> glyphHash;
+public:
+  cGlyphCache(void);
+  cGlyph *Get(uint CharCode) const;
+  void Add(cGlyph *Glyph);
+  };
+
+cGlyphCache::cGlyphCache(void)
+:glyphHash(HASHSIZE, false)
+{
+  memset(glyphTable, 0, sizeof(glyphTable));
+}
+
+cGlyph *cGlyphCache::Get(uint CharCode) const
 {
-  for (int i = kerningCache.Size(); --i > 0; ) {
-      if (kerningCache[i].prevSym == PrevSym)
-         return kerningCache[i].kerning;
+  if (CharCode < GLYPHTABLESIZE)
+     return glyphTable[CharCode];
+  return glyphHash.Get(CharCode);
+}
+
+void cGlyphCache::Add(cGlyph *Glyph)
+{
+  glyphs.Add(Glyph);
+  if (Glyph->CharCode() < GLYPHTABLESIZE)
+     glyphTable[Glyph->CharCode()] = Glyph;
+  else
+     glyphHash.Add(Glyph, Glyph->CharCode());
+}
+
+class cKerning : public cListObject {
+private:
+  uint prevSym;
+  uint sym;
+  int kerning;
+public:
+  cKerning(uint PrevSym, uint Sym, int Kerning) { prevSym = PrevSym; sym = Sym; kerning = Kerning; }
+  static uint Id(uint PrevSym, uint Sym) { return PrevSym * 0x10001 ^ Sym; }
+  bool Is(uint PrevSym, uint Sym) const { return prevSym == PrevSym && sym == Sym; }
+  int Kerning(void) const { return kerning; }
+  };
+
+// --- cFreetypeFace ---------------------------------------------------------
+
+// A font file, shared by all fonts that use it (in whatever size).
+
+class cFreetypeFace : public cListObject {
+private:
+  cString fileName;
+  FT_Face face;
+  int users;
+public:
+  cFreetypeFace(FT_Library Library, const char *FileName);
+  virtual ~cFreetypeFace() override;
+  const char *FileName(void) const { return fileName; }
+  FT_Face Face(void) const { return face; }
+  int Users(void) const { return users; }
+  void IncUsers(void) { users++; }
+  void DecUsers(void) { users--; }
+  };
+
+cFreetypeFace::cFreetypeFace(FT_Library Library, const char *FileName)
+{
+  fileName = FileName;
+  face = NULL;
+  users = 0;
+  if (int error = FT_New_Face(Library, FileName, 0, &face)) {
+     esyslog("ERROR: FreeType: load error %d (font = %s)", error, FileName);
+     face = NULL;
+     }
+}
+
+cFreetypeFace::~cFreetypeFace()
+{
+  if (face)
+     FT_Done_Face(face);
+}
+
+// --- cFreetypeSize ---------------------------------------------------------
+
+// A font file in a particular size, together with the glyphs that have been
+// rendered in this size. All fonts with the same file name and size share one
+// cFreetypeSize, so that a font that is created anew (for instance every time
+// a skin opens a menu) doesn't have to render its glyphs again.
+
+class cFreetypeSize : public cListObject {
+private:
+  cFreetypeFace *face;
+  FT_Size size;
+  int charHeight;
+  int charWidth;
+  int height;
+  int bottom;
+  int users;
+public:
+  cGlyphCache glyphCacheMonochrome;
+  cGlyphCache glyphCacheAntiAliased;
+  cHash<cKerning> kerningCache; ///< Kerning values, indexed by the pair of symbols.
+  cFreetypeSize(cFreetypeFace *Face, int CharHeight, int CharWidth);
+  virtual ~cFreetypeSize() override;
+  bool Activate(void);
+       ///< Makes this size the active one of the face. Must be called (with the
+       ///< font manager locked) before rendering glyphs or getting kerning values.
+  FT_Face Face(void) const { return face->Face(); }
+  bool Matches(const char *FileName, int CharHeight, int CharWidth) const { return charHeight == CharHeight && charWidth == CharWidth && strcmp(face->FileName(), FileName) == 0; }
+  int Height(void) const { return height; }
+  int Bottom(void) const { return bottom; }
+  int Users(void) const { return users; }
+  void IncUsers(void) { users++; }
+  void DecUsers(void) { users--; }
+  };
+
+cFreetypeSize::cFreetypeSize(cFreetypeFace *Face, int CharHeight, int CharWidth)
+:kerningCache(HASHSIZE, true)
+{
+  face = Face;
+  face->IncUsers();
+  size = NULL;
+  charHeight = CharHeight;
+  charWidth = CharWidth;
+  height = 0;
+  bottom = 0;
+  users = 0;
+  FT_Face f = face->Face();
+  if (!f)
+     return;
+  int error = FT_New_Size(f, &size);
+  if (error) {
+     esyslog("ERROR: FreeType: error %d in FT_New_Size (font = %s)", error, face->FileName());
+     size = NULL;
+     return;
+     }
+  FT_Activate_Size(size);
+  if (f->num_fixed_sizes && f->available_sizes) { // fixed font
+     // TODO what exactly does all this mean?
+     if (!FT_IS_SCALABLE(f))
+        FT_Select_Size(f, 0);
+     height = f->available_sizes->height;
+     for (uint sym ='A'; sym < 'z'; sym++) { // search for descender for fixed font FIXME
+         FT_UInt glyph_index = FT_Get_Char_Index(f, sym);
+         error = FT_Load_Glyph(f, glyph_index, FT_LOAD_DEFAULT);
+         if (!error) {
+            error = FT_Render_Glyph(f->glyph, FT_RENDER_MODE_NORMAL);
+            if (!error) {
+               if (int(f->glyph->bitmap.rows-f->glyph->bitmap_top) > bottom)
+                  bottom = f->glyph->bitmap.rows-f->glyph->bitmap_top;
+               }
+            else
+               esyslog("ERROR: FreeType: error %d in FT_Render_Glyph", error);
+            }
+         else
+            esyslog("ERROR: FreeType: error %d in FT_Load_Glyph", error);
+         }
+     }
+  else {
+     error = FT_Set_Char_Size(f, // handle to face object
+                              CharWidth * 64,  // CharWidth in 1/64th of points
+                              CharHeight * 64, // CharHeight in 1/64th of points
+                              0,    // horizontal device resolution
+                              0);   // vertical device resolution
+     if (!error) {
+        height = (f->size->metrics.ascender - f->size->metrics.descender + 63) / 64;
+        bottom = abs((f->size->metrics.descender - 63) / 64);
+        }
+     else
+        esyslog("ERROR: FreeType: error %d during FT_Set_Char_Size (font = %s)\n", error, face->FileName());
+     }
+}
+
+cFreetypeSize::~cFreetypeSize()
+{
+  if (size)
+     FT_Done_Size(size);
+  face->DecUsers();
+}
+
+bool cFreetypeSize::Activate(void)
+{
+  if (size) {
+     if (face->Face()->size != size)
+        FT_Activate_Size(size);
+     return true;
+     }
+  return false;
+}
+
+// --- cFreetypeManager ------------------------------------------------------
+
+// Keeps the one FreeType library of this process, together with the faces and
+// sizes that are in use. Since the faces are shared between fonts that may be
+// used in different threads, all calls into FreeType are made with the manager
+// locked.
+
+#define MAXUNUSEDSIZES 16 // the number of sizes kept for later use after their last font has been deleted
+
+class cFreetypeManager {
+private:
+  static FT_Library library;
+  static cMutex mutex;
+  static cList<cFreetypeFace> faces;
+  static cList<cFreetypeSize> sizes; // the most recently used ones are at the end
+  static void Cleanup(int MaxUnused);
+public:
+  ~cFreetypeManager();
+  static cMutex *Mutex(void) { return &mutex; }
+  static cFreetypeSize *GetSize(const char *FileName, int CharHeight, int CharWidth);
+       ///< Returns the size with the given parameters, creating it (and its face)
+       ///< if necessary. Every call must be matched by a call to ReleaseSize().
+  static void ReleaseSize(cFreetypeSize *Size);
+  };
+
+FT_Library cFreetypeManager::library = NULL;
+cMutex cFreetypeManager::mutex;
+cList<cFreetypeFace> cFreetypeManager::faces;
+cList<cFreetypeSize> cFreetypeManager::sizes;
+
+static cFreetypeManager FreetypeManager;
+
+cFreetypeManager::~cFreetypeManager()
+{
+  Cleanup(0);
+  if (library && !faces.Count()) {
+     FT_Done_FreeType(library);
+     library = NULL;
+     }
+}
+
+void cFreetypeManager::Cleanup(int MaxUnused)
+{
+  int Unused = 0;
+  for (cFreetypeSize *s = sizes.Last(); s; ) {
+      cFreetypeSize *Prev = sizes.Prev(s);
+      if (!s->Users() && ++Unused > MaxUnused)
+         sizes.Del(s);
+      s = Prev;
+      }
+  for (cFreetypeFace *f = faces.First(); f; ) {
+      cFreetypeFace *Next = faces.Next(f);
+      if (!f->Users())
+         faces.Del(f);
+      f = Next;
       }
-  return KERNING_UNKNOWN;
 }
 
-void cGlyph::SetKerningCache(uint PrevSym, int Kerning)
+cFreetypeSize *cFreetypeManager::GetSize(const char *FileName, int CharHeight, int CharWidth)
 {
-  kerningCache.Append(tKerning(PrevSym, Kerning));
+  cMutexLock MutexLock(&mutex);
+  if (!library) {
+     if (int error = FT_Init_FreeType(&library)) {
+        esyslog("ERROR: FreeType: initialization error %d (font = %s)", error, FileName);
+        library = NULL;
+        return NULL;
+        }
+     }
+  cFreetypeSize *Size = NULL;
+  for (cFreetypeSize *s = sizes.First(); s; s = sizes.Next(s)) {
+      if (s->Matches(FileName, CharHeight, CharWidth)) {
+         Size = s;
+         sizes.Move(Size, sizes.Last());
+         break;
+         }
+      }
+  if (!Size) {
+     cFreetypeFace *Face = NULL;
+     for (cFreetypeFace *f = faces.First(); f; f = faces.Next(f)) {
+         if (strcmp(f->FileName(), FileName) == 0) {
+            Face = f;
+            break;
+            }
+         }
+     if (!Face)
+        faces.Add(Face = new cFreetypeFace(library, FileName));
+     sizes.Add(Size = new cFreetypeSize(Face, CharHeight, CharWidth));
+     }
+  Size->IncUsers();
+  return Size;
 }
 
+void cFreetypeManager::ReleaseSize(cFreetypeSize *Size)
+{
+  if (Size) {
+     cMutexLock MutexLock(&mutex);
+     Size->DecUsers();
+     Cleanup(MAXUNUSEDSIZES);
+     }
+}
+
+// --- cFreetypeFont ---------------------------------------------------------
+
 class cFreetypeFont : public cFont {
 private:
   cString fontName;
@@ -104,10 +379,7 @@ private:
   int width;
   int height;
   int bottom;
-  FT_Library library; ///< Handle to library
-  FT_Face face; ///< Handle to face object
-  mutable cList<cGlyph> glyphCacheMonochrome;
-  mutable cList<cGlyph> glyphCacheAntiAliased;
+  cFreetypeSize *fontSize; ///< The face in this font's size, together with the glyphs rendered so far
   int Bottom(void) const { return bottom; }
   int Kerning(cGlyph *Glyph, uint PrevSym) const;
   cGlyph* Glyph(uint CharCode, bool AntiAliased = false) const;
@@ -131,68 +403,38 @@ cFreetypeFont::cFreetypeFont(const char *Name, int CharHeight, int CharWidth)
   width = CharWidth;
   height = 0;
   bottom = 0;
-  int error = FT_Init_FreeType(&library);
-  if (!error) {
-     error = FT_New_Face(library, Name, 0, &face);
-     if (!error) {
-        if (face->num_fixed_sizes && face->available_sizes) { // fixed font
-           // TODO what exactly does all this mean?
-           height = face->available_sizes->height;
-           for (uint sym ='A'; sym < 'z'; sym++) { // search for descender for fixed font FIXME
-               FT_UInt glyph_index = FT_Get_Char_Index(face, sym);
-               error = FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
-               if (!error) {
-                  error = FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL);
-                  if (!error) {
-                     if (int(face->glyph->bitmap.rows-face->glyph->bitmap_top) > bottom)
-                        bottom = face->glyph->bitmap.rows-face->glyph->bitmap_top;
-                     }
-                  else
-                     esyslog("ERROR: FreeType: error %d in FT_Render_Glyph", error);
-                  }
-               else
-                  esyslog("ERROR: FreeType: error %d in FT_Load_Glyph", error);
-               }
-           }
-        else {
-           error = FT_Set_Char_Size(face, // handle to face object
-                                    CharWidth * 64,  // CharWidth in 1/64th of points
-                                    CharHeight * 64, // CharHeight in 1/64th of points
-                                    0,    // horizontal device resolution
-                                    0);   // vertical device resolution
-           if (!error) {
-              height = (face->size->metrics.ascender - face->size->metrics.descender + 63) / 64;
-              bottom = abs((face->size->metrics.descender - 63) / 64);
-              }
-           else
-              esyslog("ERROR: FreeType: error %d during FT_Set_Char_Size (font = %s)\n", error, Name);
-           }
-        }
-     else
-        esyslog("ERROR: FreeType: load error %d (font = %s)", error, Name);
+  fontSize = cFreetypeManager::GetSize(Name, CharHeight, CharWidth);
+  if (fontSize) {
+     height = fontSize->Height();
+     bottom = fontSize->Bottom();
      }
-  else
-     esyslog("ERROR: FreeType: initialization error %d (font = %s)", error, Name);
 }
 
 cFreetypeFont::~cFreetypeFont()
 {
-  FT_Done_Face(face);
-  FT_Done_FreeType(library);
+  cFreetypeManager::ReleaseSize(fontSize);
 }
 
 int cFreetypeFont::Kerning(cGlyph *Glyph, uint PrevSym) const
 {
   int kerning = 0;
-  if (Glyph && PrevSym) {
-     kerning = Glyph->GetKerningCache(PrevSym);
-     if (kerning == KERNING_UNKNOWN) {
+  if (Glyph && PrevSym && FT_HAS_KERNING(fontSize->Face())) {
+     cMutexLock MutexLock(cFreetypeManager::Mutex());
+     uint Sym = Glyph->CharCode();
+     uint Id = cKerning::Id(PrevSym, Sym);
+     cKerning *k = fontSize->kerningCache.Get(Id);
+     while (k && !k->Is(PrevSym, Sym))
+           k = fontSize->kerningCache.GetNext(Id, k);
+     if (k)
+        kerning = k->Kerning();
+     else if (fontSize->Activate()) {
+        FT_Face face = fontSize->Face();
         FT_Vector delta;
-        FT_UInt glyph_index = FT_Get_Char_Index(face, Glyph->CharCode());
+        FT_UInt glyph_index = FT_Get_Char_Index(face, Sym);
         FT_UInt glyph_index_prev = FT_Get_Char_Index(face, PrevSym);
         FT_Get_Kerning(face, glyph_index_prev, glyph_index, FT_KERNING_DEFAULT, &delta);
         kerning = delta.x / 64;
-        Glyph->SetKerningCache(PrevSym, kerning);
+        fontSize->kerningCache.Add(new cKerning(PrevSym, Sym, kerning), Id);
         }
      }
   return kerning;
@@ -200,16 +442,21 @@ int cFreetypeFont::Kerning(cGlyph *Glyph, uint PrevSym) const
 
 cGlyph* cFreetypeFont::Glyph(uint CharCode, bool AntiAliased) const
 {
+  if (!height)
+     return NULL;
+
   // Non-breaking space:
   if (CharCode == 0xA0)
      CharCode = 0x20;
 
   // Lookup in cache:
-  cList<cGlyph> *glyphCache = AntiAliased ? &glyphCacheAntiAliased : &glyphCacheMonochrome;
-  for (cGlyph *g = glyphCache->First(); g; g = glyphCache->Next(g)) {
-      if (g->CharCode() == CharCode)
-         return g;
-      }
+  cMutexLock MutexLock(cFreetypeManager::Mutex());
+  cGlyphCache *glyphCache = AntiAliased ? &fontSize->glyphCacheAntiAliased : &fontSize->glyphCacheMonochrome;
+  if (cGlyph *g = glyphCache->Get(CharCode))
+     return g;
+
+  FT_Face face = fontSize->Face();
+  fontSize->Activate();
 
   FT_UInt glyph_index = FT_Get_Char_Index(face, CharCode);
 
@@ -399,6 +646,163 @@ public:
   virtual void DrawText(cPixmap *Pixmap, int x, int y, const char *s, tColor ColorFg, tColor ColorBg, int Width) const override {}
   };
 
+// --- cFontConfigCache ------------------------------------------------------
+
+// Querying fontconfig can take quite a while on systems with many fonts, so the
+// list of available font names and the file names of the fonts that have been
+// used are kept for the lifetime of the process. They are only queried anew if
+// fontconfig reports that its configuration (or any of the font directories)
+// has changed.
+
+#define FONTCONFIGCHECK 30 // seconds between checks whether the font configuration has changed
+
+class cFontConfigCache {
+private:
+  static cMutex mutex;
+  static bool initialized;
+  static cTimeMs checkTimeout;
+  static cStringList fontNames[2]; // all fonts, monospaced fonts
+  static bool fontNamesValid[2];
+  static cStringList fontNameKeys; // font names...
+  static cStringList fontFileNames; // ...and their font files
+  static void Check(void);
+  static void ListFontNames(cStringList *FontNames, bool Monospaced);
+  static cString FindFontFile(const char *FontName);
+public:
+  static bool GetAvailableFontNames(cStringList *FontNames, bool Monospaced);
+  static cString GetFontFileName(const char *FontName);
+  };
+
+cMutex cFontConfigCache::mutex;
+bool cFontConfigCache::initialized = false;
+cTimeMs cFontConfigCache::checkTimeout;
+cStringList cFontConfigCache::fontNames[2];
+bool cFontConfigCache::fontNamesValid[2] = { false, false };
+cStringList cFontConfigCache::fontNameKeys;
+cStringList cFontConfigCache::fontFileNames;
+
+void cFontConfigCache::Check(void)
+{
+  // mutex must be locked!
+  if (!initialized) {
+     FcInit();
+     initialized = true;
+     }
+  else if (checkTimeout.TimedOut()) {
+     if (!FcConfigUptoDate(NULL)) {
+        dsyslog("font configuration has changed - reloading");
+        FcInitBringUptoDate();
+        for (int i = 0; i < 2; i++) {
+            fontNames[i].Clear();
+            fontNamesValid[i] = false;
+            }
+        fontNameKeys.Clear();
+        fontFileNames.Clear();
+        }
+     }
+  else
+     return;
+  checkTimeout.Set(FONTCONFIGCHECK * 1000);
+}
+
+bool cFontConfigCache::GetAvailableFontNames(cStringList *FontNames, bool Monospaced)
+{
+  cMutexLock MutexLock(&mutex);
+  Check();
+  if (!fontNamesValid[Monospaced]) {
+     ListFontNames(&fontNames[Monospaced], Monospaced);
+     fontNamesValid[Monospaced] = true;
+     }
+  for (int i = 0; i < fontNames[Monospaced].Size(); i++)
+      FontNames->Append(strdup(fontNames[Monospaced][i]));
+  return FontNames->Size() > 0;
+}
+
+cString cFontConfigCache::GetFontFileName(const char *FontName)
+{
+  cMutexLock MutexLock(&mutex);
+  Check();
+  int i = fontNameKeys.Find(FontName);
+  if (i < 0) {
+     cString FontFileName = FindFontFile(FontName);
+     fontNameKeys.Append(strdup(FontName));
+     fontFileNames.Append(strdup(*FontFileName ? *FontFileName : "")); // an empty string if there is no such font
+     i = fontNameKeys.Size() - 1;
+     }
+  return *fontFileNames[i] ? fontFileNames[i] : NULL;
+}
+
+void cFontConfigCache::ListFontNames(cStringList *FontNames, bool Monospaced)
+{
+  FcObjectSet *os = FcObjectSetBuild(FC_FAMILY, FC_STYLE, NULL);
+  FcPattern *pat = FcPatternCreate();
+  FcPatternAddBool(pat, FC_SCALABLE, FcTrue);
+  if (Monospaced)
+     FcPatternAddInteger(pat, FC_SPACING, FC_MONO);
+  FcFontSet* fontset = FcFontList(NULL, pat, os);
+  for (int i = 0; i < fontset->nfont; i++) {
+      char *s = (char *)FcNameUnparse(fontset->fonts[i]);
+      if (s) {
+         // Strip i18n stuff:
+         char *c = strchr(s, ':');
+         if (c) {
+            char *p = strchr(c + 1, ',');
+            if (p)
+               *p = 0;
+            }
+         char *p = strchr(s, ',');
+         if (p) {
+            if (c)
+               memmove(p, c, strlen(c) + 1);
+            else
+               *p = 0;
+            }
+         // Make it user presentable:
+         s = strreplace(s, "\\", ""); // '-' is escaped
+         s = strreplace(s, "style=", "");
+         FontNames->Append(s); // takes ownership of s
+         }
+      }
+  FcFontSetDestroy(fontset);
+  FcPatternDestroy(pat);
+  FcObjectSetDestroy(os);
+  //FcFini(); // older versions of fontconfig are broken - and FcInit() can be called more than once
+  FontNames->Sort();
+}
+
+cString cFontConfigCache::FindFontFile(const char *FontName)
+{
+  cString FontFileName;
+  char *fn = strdup(FontName);
+  fn = strreplace(fn, ":", ":style=");
+  fn = strreplace(fn, "-", "\\-");
+  FcPattern *pat = FcNameParse((FcChar8 *)fn);
+  FcPatternAddBool(pat, FC_SCALABLE, FcTrue);
+  FcConfigSubstitute(NULL, pat, FcMatchPattern);
+  FcDefaultSubstitute(pat);
+  FcResult fresult;
+  FcFontSet *fontset = FcFontSort(NULL, pat, FcFalse, NULL, &fresult);
+  if (fontset) {
+     for (int i = 0; i < fontset->nfont; i++) {
+         FcBool scalable;
+         FcPatternGetBool(fontset->fonts[i], FC_SCALABLE, 0, &scalable);
+         if (scalable) {
+            FcChar8 *s = NULL;
+            FcPatternGetString(fontset->fonts[i], FC_FILE, 0, &s);
+            FontFileName = (char *)s;
+            break;
+            }
+         }
+     FcFontSetDestroy(fontset);
+     }
+  else
+     esyslog("ERROR: no usable font found for '%s'", FontName);
+  FcPatternDestroy(pat);
+  free(fn);
+  //FcFini(); // older versions of fontconfig are broken - and FcInit() can be called more than once
+  return FontFileName;
+}
+
 // --- cFont -----------------------------------------------------------------
 
 cFont *cFont::fonts[eDvbFontSize] = { NULL };
@@ -439,80 +843,16 @@ cFont *cFont::CreateFont(const char *Name, int CharHeight, int CharWidth)
 
 bool cFont::GetAvailableFontNames(cStringList *FontNames, bool Monospaced)
 {
-  if (!FontNames->Size()) {
-     FcInit();
-     FcObjectSet *os = FcObjectSetBuild(FC_FAMILY, FC_STYLE, NULL);
-     FcPattern *pat = FcPatternCreate();
-     FcPatternAddBool(pat, FC_SCALABLE, FcTrue);
-     if (Monospaced)
-        FcPatternAddInteger(pat, FC_SPACING, FC_MONO);
-     FcFontSet* fontset = FcFontList(NULL, pat, os);
-     for (int i = 0; i < fontset->nfont; i++) {
-         char *s = (char *)FcNameUnparse(fontset->fonts[i]);
-         if (s) {
-            // Strip i18n stuff:
-            char *c = strchr(s, ':');
-            if (c) {
-               char *p = strchr(c + 1, ',');
-               if (p)
-                  *p = 0;
-               }
-            char *p = strchr(s, ',');
-            if (p) {
-               if (c)
-                  memmove(p, c, strlen(c) + 1);
-               else
-                  *p = 0;
-               }
-            // Make it user presentable:
-            s = strreplace(s, "\\", ""); // '-' is escaped
-            s = strreplace(s, "style=", "");
-            FontNames->Append(s); // takes ownership of s
-            }
-         }
-     FcFontSetDestroy(fontset);
-     FcPatternDestroy(pat);
-     FcObjectSetDestroy(os);
-     //FcFini(); // older versions of fontconfig are broken - and FcInit() can be called more than once
-     FontNames->Sort();
-     }
+  if (!FontNames->Size())
+     cFontConfigCache::GetAvailableFontNames(FontNames, Monospaced);
   return FontNames->Size() > 0;
 }
 
 cString cFont::GetFontFileName(const char *FontName)
 {
-  cString FontFileName;
-  if (FontName) {
-     char *fn = strdup(FontName);
-     fn = strreplace(fn, ":", ":style=");
-     fn = strreplace(fn, "-", "\\-");
-     FcInit();
-     FcPattern *pat = FcNameParse((FcChar8 *)fn);
-     FcPatternAddBool(pat, FC_SCALABLE, FcTrue);
-     FcConfigSubstitute(NULL, pat, FcMatchPattern);
-     FcDefaultSubstitute(pat);
-     FcResult fresult;
-     FcFontSet *fontset = FcFontSort(NULL, pat, FcFalse, NULL, &fresult);
-     if (fontset) {
-        for (int i = 0; i < fontset->nfont; i++) {
-            FcBool scalable;
-            FcPatternGetBool(fontset->fonts[i], FC_SCALABLE, 0, &scalable);
-            if (scalable) {
-               FcChar8 *s = NULL;
-               FcPatternGetString(fontset->fonts[i], FC_FILE, 0, &s);
-               FontFileName = (char *)s;
-               break;
-               }
-            }
-        FcFontSetDestroy(fontset);
-        }
-     else
-        esyslog("ERROR: no usable font found for '%s'", FontName);
-     FcPatternDestroy(pat);
-     free(fn);
-     //FcFini(); // older versions of fontconfig are broken - and FcInit() can be called more than once
-     }
-  return FontFileName;
+  if (FontName)
+     return cFontConfigCache::GetFontFileName(FontName);
+  return NULL;
 }
 
 #ifdef BIDI
@@ -543,6 +883,107 @@ cString cFont::Bidi(const char *Ltr)
 }
 #endif
 
+// --- cTextWrapperCache -----------------------------------------------------
+
+// Keeps the results of the most recent calls to cTextWrapper::Set(), so that
+// long texts (like EPG descriptions) don't have to be wrapped again every time
+// they are displayed or scrolled. The most recently used entries are at the
+// beginning of the list.
+
+#define TEXTWRAPPERCACHESIZE 32
+
+class cTextWrapperCacheEntry : public cListObject {
+private:
+  cString fontName;
+  int fontSize;
+  int fontWidth;
+  bool antiAlias;
+  int width;
+  uint hash;
+  char *text;
+  char *wrapped;
+  int lines;
+public:
+  cTextWrapperCacheEntry(const cFont *Font, int Width, uint Hash, const char *Text, const char *Wrapped, int Lines);
+  virtual ~cTextWrapperCacheEntry() override;
+  bool Matches(const cFont *Font, int Width, uint Hash, const char *Text) const;
+  const char *Wrapped(void) const { return wrapped; }
+  int Lines(void) const { return lines; }
+  };
+
+cTextWrapperCacheEntry::cTextWrapperCacheEntry(const cFont *Font, int Width, uint Hash, const char *Text, const char *Wrapped, int Lines)
+{
+  fontName = Font->FontName();
+  fontSize = Font->Size();
+  fontWidth = Font->Width();
+  antiAlias = Setup.AntiAlias;
+  width = Width;
+  hash = Hash;
+  text = strdup(Text);
+  wrapped = strdup(Wrapped);
+  lines = Lines;
+}
+
+cTextWrapperCacheEntry::~cTextWrapperCacheEntry()
+{
+  free(text);
+  free(wrapped);
+}
+
+bool cTextWrapperCacheEntry::Matches(const cFont *Font, int Width, uint Hash, const char *Text) const
+{
+  return hash == Hash && width == Width && fontSize == Font->Size() && fontWidth == Font->Width() && antiAlias == bool(Setup.AntiAlias) && strcmp(fontName, Font->FontName()) == 0 && strcmp(text, Text) == 0;
+}
+
+class cTextWrapperCache {
+private:
+  static cMutex mutex;
+  static cList<cTextWrapperCacheEntry> entries;
+public:
+  static uint Hash(const char *Text);
+  static char *Get(const cFont *Font, int Width, uint Hash, const char *Text, int &Lines);
+       ///< Returns a copy of the wrapped version of Text, or NULL if it isn't in the cache.
+       ///< The caller must free() the result.
+  static void Put(const cFont *Font, int Width, uint Hash, const char *Text, const char *Wrapped, int Lines);
+  };
+
+cMutex cTextWrapperCache::mutex;
+cList<cTextWrapperCacheEntry> cTextWrapperCache::entries;
+
+uint cTextWrapperCache::Hash(const char *Text)
+{
+  uint h = 2166136261u; // FNV-1a
+  while (*Text)
+        h = (h ^ uchar(*Text++)) * 16777619u;
+  return h;
+}
+
+char *cTextWrapperCache::Get(const cFont *Font, int Width, uint Hash, const char *Text, int &Lines)
+{
+  if (!*Font->FontName())
+     return NULL; // fonts without a name can't be told apart
+  cMutexLock MutexLock(&mutex);
+  for (cTextWrapperCacheEntry *e = entries.First(); e; e = entries.Next(e)) {
+      if (e->Matches(Font, Width, Hash, Text)) {
+         if (e != entries.First())
+            entries.Move(e, entries.First());
+         Lines = e->Lines();
+         return strdup(e->Wrapped());
+         }
+      }
+  return NULL;
+}
+
+void cTextWrapperCache::Put(const cFont *Font, int Width, uint Hash, const char *Text, const char *Wrapped, int Lines)
+{
+  if (!*Font->FontName())
+     return;
+  cMutexLock MutexLock(&mutex);
+  entries.Ins(new cTextWrapperCacheEntry(Font, Width, Hash, Text, Wrapped, Lines));
+  while (entries.Count() > TEXTWRAPPERCACHESIZE)
+        entries.Del(entries.Last());
+}
+
 // --- cTextWrapper ----------------------------------------------------------
 
 cTextWrapper::cTextWrapper(void)
@@ -576,6 +1017,13 @@ void cTextWrapper::Set(const char *Text, const cFont *Font, int Width)
   if (Width <= 0)
      return;
 
+  uint Hash = cTextWrapperCache::Hash(Text);
+  if (char *Wrapped = cTextWrapperCache::Get(Font, Width, Hash, Text, lines)) {
+     free(text);
+     text = Wrapped;
+     return;
+     }
+
   char *Blank = NULL;
   char *Delim = NULL;
   int w = 0;
@@ -624,6 +1072,7 @@ void cTextWrapper::Set(const char *Text, const cFont *Font, int Width)
          }
       p += sl;
       }
+  cTextWrapperCache::Put(Font, Width, Hash, Text, text, lines);
 }
 
 const char *cTextWrapper::Text(void)
@@ -22,6 +22,7 @@
 #include <libintl.h>
 #include <locale.h>
 #include <unistd.h>
+#include "thread.h"
 #include "tools.h"
 
 // TRANSLATORS: The name of the language, as written natively
@@ -135,8 +136,36 @@ static const char *SkipContext(const char *s)
   return p ? p + 1 : s;
 }
 
+// Translated texts are cached by the address of the original text, so that
+// repeatedly translating the same literal (as menus and skins do with every
+// redraw) doesn't require a gettext lookup each time. Since tr() may also be
+// called with texts in buffers, a cached entry is only used if the text at
+// that address is still the same.
+
+#define TRANSLATIONCACHESIZE 2048 // must be a power of 2
+
+struct tTranslationCacheEntry {
+  const char *s;
+  const char *plugin;
+  char *msgid;
+  const char *translation;
+  };
+
+static tTranslationCacheEntry TranslationCache[TRANSLATIONCACHESIZE] = {};
+static cMutex TranslationCacheMutex;
+
+static void ClearTranslationCache(void)
+{
+  cMutexLock MutexLock(&TranslationCacheMutex);
+  for (int i = 0; i < TRANSLATIONCACHESIZE; i++) {
+      free(TranslationCache[i].msgid);
+      memset(&TranslationCache[i], 0, sizeof(TranslationCache[i]));
+      }
+}
+
 static void SetEnvLanguage(const char *Locale)
 {
+  ClearTranslationCache();
   setenv("LANGUAGE", Locale, 1);
   extern int _nl_msg_cat_cntr;
   ++_nl_msg_cat_cntr;
@@ -270,9 +299,19 @@ const char *I18nTranslate(const char *s, const char *Plugin)
   if (!s)
      return s;
   if (CurrentLanguage) {
+     cMutexLock MutexLock(&TranslationCacheMutex);
+     tTranslationCacheEntry *e = &TranslationCache[((uintptr_t(s) >> 3) ^ (uintptr_t(Plugin) >> 5)) & (TRANSLATIONCACHESIZE - 1)];
+     if (e->s == s && e->plugin == Plugin && e->msgid && strcmp(e->msgid, s) == 0)
+        return e->translation;
      const char *t = Plugin ? dgettext(Plugin, s) : gettext(s);
-     if (t != s)
-        return t;
+     if (t == s)
+        t = SkipContext(s);
+     free(e->msgid);
+     e->s = s;
+     e->plugin = Plugin;
+     e->msgid = strdup(s);
+     e->translation = t;
+     return t;
      }
   return SkipContext(s);
 }
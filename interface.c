@@ -13,6 +13,7 @@
 #ifdef SDNOTIFY
 #include <systemd/sd-daemon.h>
 #endif
+#include <sys/time.h>
 #include <unistd.h>
 #include "i18n.h"
 #include "status.h"
@@ -30,10 +31,21 @@ cInterface::~cInterface()
 
 eKeys cInterface::GetKey(bool Wait)
 {
-  if (!cRemote::HasKeys())
+  if (!cRemote::HasKeys()) {
      Skins.Flush();
-  if (!cRemote::IsLearning())
-     return cRemote::Get(Wait ? 1000 : 10);
+     cRemote::KeyProcessed();
+     }
+  if (!cRemote::IsLearning()) {
+     int WaitMs = 10;
+     if (Wait) {
+        // The main loop does its housekeeping once per second, so we wake up
+        // right after the next full second instead of one second from now:
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        WaitMs = 1000 - tv.tv_usec / 1000;
+        }
+     return cRemote::Get(WaitMs);
+     }
   else
      return kNone;
 }
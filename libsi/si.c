@@ -14,6 +14,7 @@
 #include <errno.h>
 #include <iconv.h>
 #include <malloc.h>
+#include <new>
 #include <stdlib.h> // for broadcaster stupidity workaround
 #include <string.h>
 #include "descriptor.h"
@@ -97,6 +98,31 @@ int Descriptor::getLength() {
    return getLength(data.getData());
 }
 
+//Every descriptor is preceded by a header that tells where its memory came from
+#define DESCRIPTOR_HEADER 16
+
+void *Descriptor::operator new(size_t size) {
+   Arena *a=Arena::getCurrent();
+   unsigned char *p=a ? (unsigned char *)a->alloc(DESCRIPTOR_HEADER+size) : 0;
+   if (p)
+      *p=1;
+   else {
+      p=(unsigned char *)malloc(DESCRIPTOR_HEADER+size);
+      if (!p)
+         throw std::bad_alloc();
+      *p=0;
+   }
+   return p+DESCRIPTOR_HEADER;
+}
+
+void Descriptor::operator delete(void *p) {
+   if (p) {
+      unsigned char *h=(unsigned char *)p-DESCRIPTOR_HEADER;
+      if (!*h)
+         free(h);
+   }
+}
+
 DescriptorTag Descriptor::getDescriptorTag() const {
    return getDescriptorTag(data.getData());
 }
@@ -305,6 +305,10 @@ public:
 
    static int getLength(const unsigned char *d);
    static DescriptorTag getDescriptorTag(const unsigned char *d);
+   //Descriptors are taken from the calling thread's current Arena, if there is one.
+   //They are still destroyed with delete, which only frees them if they came from the heap.
+   static void *operator new(size_t size);
+   static void operator delete(void *p);
 protected:
    friend class DescriptorLoop;
    //returns a subclass of descriptor according to the data given.
@@ -10,6 +10,7 @@
  *                                                                         *
  ***************************************************************************/
 
+#include <stdlib.h>
 #include <string.h>
 #include "util.h"
 
@@ -175,6 +176,60 @@ void CharArray::Data::Unlock(void)
 }
 */
 
+/*----------------------------- Arena -------------------------------*/
+
+thread_local Arena *Arena::current=0;
+
+//the first bytes of every chunk hold the Chunk header
+#define ARENA_HEADER ((sizeof(Chunk)+Alignment-1) & ~size_t(Alignment-1))
+
+Arena::Arena() : chunks(0), used(0) {
+}
+
+Arena::~Arena() {
+   while (chunks) {
+      Chunk *c=chunks;
+      chunks=c->next;
+      free(c);
+   }
+}
+
+void *Arena::alloc(size_t size) {
+   size=(size+Alignment-1) & ~size_t(Alignment-1);
+   if (!chunks || used+size > chunks->size) {
+      size_t s=ARENA_HEADER+size;
+      if (s < ChunkSize)
+         s=ChunkSize;
+      Chunk *c=(Chunk *)malloc(s);
+      if (!c)
+         return 0;
+      c->next=chunks;
+      c->size=s;
+      chunks=c;
+      used=ARENA_HEADER;
+   }
+   void *p=(char *)chunks+used;
+   used+=size;
+   return p;
+}
+
+void Arena::reset() {
+   //keep one regular chunk, so that the next section doesn't need to allocate anything
+   Chunk *keep=0;
+   while (chunks) {
+      Chunk *c=chunks;
+      chunks=c->next;
+      if (!keep && c->size == ChunkSize)
+         keep=c;
+      else
+         free(c);
+   }
+   if (keep)
+      keep->next=0;
+   chunks=keep;
+   used=ARENA_HEADER;
+}
+
 Parsable::Parsable() {
    parsed=false;
 }
@@ -264,12 +319,30 @@ u_int32_t CRC32::crc_table[256] = {
    0x933eb0bb, 0x97ffad0c, 0xafb010b1, 0xab710d06, 0xa6322bdf, 0xa2f33668,
    0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4};
 
+// Tables for processing 8 bytes at a time ("slicing-by-8"): crc_tables[k][b] is the
+// CRC of byte b followed by k zero bytes, so crc_tables[0] is the same as crc_table.
+struct CRC32Tables {
+   u_int32_t t[8][256];
+   CRC32Tables(const u_int32_t *table) {
+      memcpy(t[0], table, sizeof(t[0]));
+      for (int k=1; k<8; k++)
+         for (int i=0; i<256; i++)
+            t[k][i] = (t[k-1][i] << 8) ^ table[t[k-1][i] >> 24];
+   }
+};
+
 u_int32_t CRC32::crc32 (const char *d, int len, u_int32_t crc)
 {
-   int i;
+   static const CRC32Tables tables(crc_table);
+   const u_int32_t (*t)[256] = tables.t;
    const unsigned char *u=(unsigned char*)d; // Saves '& 0xff'
 
-   for (i=0; i<len; i++)
+   for (; len >= 8; len -= 8, u += 8) {
+      crc ^= (u[0] << 24) | (u[1] << 16) | (u[2] << 8) | u[3];
+      crc = t[7][crc >> 24] ^ t[6][(crc >> 16) & 0xff] ^ t[5][(crc >> 8) & 0xff] ^ t[4][crc & 0xff]
+          ^ t[3][u[4]] ^ t[2][u[5]] ^ t[1][u[6]] ^ t[0][u[7]];
+   }
+   while (len-- > 0)
       crc = (crc << 8) ^ crc_table[((crc >> 24) ^ *u++)];
 
    return crc;
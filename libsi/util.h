@@ -121,6 +121,41 @@ private:
    int off;
 };
 
+//A simple bump allocator for objects that only live while one section is
+//being processed. Memory handed out by alloc() is never freed individually,
+//it all becomes available again with reset().
+class Arena {
+public:
+   Arena();
+   ~Arena();
+   void *alloc(size_t size);
+   //all objects allocated from this arena must have been destroyed before calling this
+   void reset();
+   //the arena that is used by the calling thread, or 0 if there is none
+   static Arena *getCurrent() { return current; }
+private:
+   friend class ArenaScope;
+   struct Chunk {
+      Chunk *next;
+      size_t size;
+   };
+   enum { ChunkSize = 16384, Alignment = 16 };
+   Chunk *chunks;
+   size_t used;
+   static thread_local Arena *current;
+};
+
+//Makes the given arena the current one of the calling thread for the lifetime
+//of this object, and resets it at the end.
+class ArenaScope {
+public:
+   ArenaScope(Arena &a) : arena(a), previous(Arena::current) { Arena::current=&arena; }
+   ~ArenaScope() { Arena::current=previous; arena.reset(); }
+private:
+   Arena &arena;
+   Arena *previous;
+};
+
 //abstract base class
 class Parsable {
 public:
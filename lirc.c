@@ -116,6 +116,7 @@ void cLircUsrRemote::Action(void)
 
         bool ready = f >= 0 && cFile::FileReady(f, timeout);
         int ret = ready ? safe_read(f, buf, sizeof(buf)) : -1;
+        uint64_t Now = cTimeMs::Now(); // the time at which the key has been captured
 
         if (f < 0 || ready && ret <= 0) {
            esyslog("ERROR: lircd connection broken, trying to reconnect every %.1f seconds", float(RECONNECTDELAY) / 1000);
@@ -163,7 +164,7 @@ void cLircUsrRemote::Action(void)
               }
            if (pressed) {
               LastTime.Set();
-              Put(KeyName, repeat);
+              Put(KeyName, repeat, false, Now);
               }
            }
         else {
@@ -222,6 +223,7 @@ void cLircDevRemote::Action(void)
   while (Running()) {
         lirc_scancode sc;
         ssize_t ret = read(f, &sc, sizeof sc);
+        uint64_t Now = cTimeMs::Now(); // the time at which the key has been captured
 
         if (ret == sizeof sc) {
            const bool SameKey = sc.keycode == LastKeyCode && !((sc.flags ^ LastFlags) & LIRC_SCANCODE_FLAG_TOGGLE);
@@ -248,7 +250,7 @@ void cLircDevRemote::Action(void)
               repeat = true;
 
            LastTime = sc.timestamp;
-           Put(sc.keycode, repeat);
+           Put(sc.keycode, repeat, false, Now);
            }
         else {
            if (repeat) // the last one was a repeat, so let's generate a release
@@ -0,0 +1,126 @@
+/*
+ * membudget.c: Global memory budget for buffers and caches
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#include "membudget.h"
+#include "config.h"
+
+static const char *PriorityTexts[] = { "cache", "playback", "live", "recording" };
+
+// --- cMemoryClient ---------------------------------------------------------
+
+cMemoryClient::cMemoryClient(const char *Name, eMemoryPriority Priority, size_t Minimum, size_t Preferred, size_t Maximum, bool Resizable)
+{
+  name = Name;
+  priority = Priority;
+  minimum = Minimum;
+  preferred = max(Preferred, Minimum);
+  maximum = max(Maximum, preferred);
+  size = 0;
+  resizable = Resizable;
+  cMutexLock MutexLock(&cMemoryBudget::mutex);
+  cMemoryBudget::clients.Append(this);
+  cMemoryBudget::Distribute(this);
+}
+
+cMemoryClient::~cMemoryClient()
+{
+  cMutexLock MutexLock(&cMemoryBudget::mutex);
+  cMemoryBudget::clients.RemoveElement(this);
+  cMemoryBudget::Distribute();
+}
+
+void cMemoryClient::SetLimits(size_t Minimum, size_t Preferred, size_t Maximum)
+{
+  cMutexLock MutexLock(&cMemoryBudget::mutex);
+  minimum = Minimum;
+  preferred = max(Preferred, Minimum);
+  maximum = max(Maximum, preferred);
+  cMemoryBudget::Distribute();
+}
+
+// --- cMemoryBudget ---------------------------------------------------------
+
+cMutex cMemoryBudget::mutex;
+cVector<cMemoryClient *> cMemoryBudget::clients;
+size_t cMemoryBudget::peak = 0;
+
+void cMemoryBudget::Distribute(cMemoryClient *New)
+{
+  size_t Budget = size_t(max(Setup.MemoryBudget, 0)) * MEGABYTE(1);
+  size_t Available = Budget;
+  // The clients that get their share now, in the order of their priorities:
+  cVector<cMemoryClient *> Candidates;
+  for (int p = mpRecording; p >= mpCache; p--) {
+      for (int i = 0; i < clients.Size(); i++) {
+          cMemoryClient *c = clients[i];
+          if (c->priority == p) {
+             if (c->resizable || c == New)
+                Candidates.Append(c);
+             else
+                Available -= min(Available, c->size);
+             }
+          }
+      }
+  int n = Candidates.Size();
+  size_t Size[n];
+  if (Budget) {
+     for (int i = 0; i < n; i++) {
+         Size[i] = Candidates[i]->minimum;
+         Available -= min(Available, Size[i]);
+         }
+     for (int Pass = 0; Pass < 2; Pass++) {
+         for (int i = 0; i < n && Available; i++) {
+             size_t Limit = Pass ? Candidates[i]->maximum : Candidates[i]->preferred;
+             size_t More = min(Limit - Size[i], Available);
+             Size[i] += More;
+             Available -= More;
+             }
+         }
+     }
+  else {
+     for (int i = 0; i < n; i++)
+         Size[i] = Candidates[i]->preferred;
+     }
+  for (int i = 0; i < n; i++) {
+      cMemoryClient *c = Candidates[i];
+      if (c->size != Size[i]) {
+         c->size = Size[i];
+         if (c != New)
+            c->Resize(c->size);
+         }
+      }
+  size_t Total = 0;
+  for (int i = 0; i < clients.Size(); i++)
+      Total += clients[i]->size;
+  if (Budget && Total > Budget && New)
+     dsyslog("memory budget of %d MB exceeded by %s (%d MB granted)", Setup.MemoryBudget, *New->name, int(Total / MEGABYTE(1)));
+  peak = max(peak, Total);
+}
+
+void cMemoryBudget::Update(void)
+{
+  cMutexLock MutexLock(&mutex);
+  Distribute();
+}
+
+void cMemoryBudget::GetStatistics(cStringList &Lines)
+{
+  cMutexLock MutexLock(&mutex);
+  size_t Total = 0;
+  for (int i = 0; i < clients.Size(); i++)
+      Total += clients[i]->size;
+  if (Setup.MemoryBudget)
+     Lines.Append(strdup(cString::sprintf("budget %d MB, granted %d MB, peak %d MB", Setup.MemoryBudget, int(Total / MEGABYTE(1)), int(peak / MEGABYTE(1)))));
+  else
+     Lines.Append(strdup(cString::sprintf("budget unlimited, granted %d MB, peak %d MB", int(Total / MEGABYTE(1)), int(peak / MEGABYTE(1)))));
+  for (int i = 0; i < clients.Size(); i++) {
+      cMemoryClient *c = clients[i];
+      Lines.Append(strdup(cString::sprintf("%-9s %8d %8d %8d %8d %s%s", PriorityTexts[c->priority], int(c->minimum / KILOBYTE(1)), int(c->preferred / KILOBYTE(1)), int(c->maximum / KILOBYTE(1)), int(c->size / KILOBYTE(1)), *c->name, c->resizable ? " (resizable)" : "")));
+      }
+}
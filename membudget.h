@@ -0,0 +1,84 @@
+/*
+ * membudget.h: Global memory budget for buffers and caches
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#ifndef __MEMBUDGET_H
+#define __MEMBUDGET_H
+
+#include "thread.h"
+#include "tools.h"
+
+// The large buffers and caches of VDR register with the global memory budget,
+// which distributes the memory given in Setup.MemoryBudget among them. Every
+// client states the minimum amount of memory it needs to work at all, the
+// amount it would like to have, and the maximum amount it can make use of.
+// All clients always get their minimum. The rest is handed out in the order
+// of the clients' priorities, first up to their preferred and then up to their
+// maximum sizes. If the budget is 0, every client simply gets its preferred size.
+//
+// Buffers can't change their size once they are allocated, so a client that is
+// not resizable keeps the size it has been given when registering. Resizable
+// clients (like caches) are shrunk when a client with a higher priority needs
+// the memory, and grow again when it is released. So if a recording starts at
+// a time when memory is scarce, its buffer is taken from the caches.
+
+enum eMemoryPriority {
+  mpCache,     // caches, which can be rebuilt at any time
+  mpPlayback,  // replay of recordings
+  mpLive,      // live viewing and streaming
+  mpRecording, // recordings, and the buffers of the devices they are recorded from
+  };
+
+class cMemoryClient {
+  friend class cMemoryBudget;
+private:
+  cString name;
+  eMemoryPriority priority;
+  size_t minimum;
+  size_t preferred;
+  size_t maximum;
+  size_t size;
+  bool resizable;
+protected:
+  virtual void Resize(size_t Size) {}
+       ///< Is called for resizable clients whenever the amount of memory they are
+       ///< granted changes. Resize() is called with the budget locked, so it must
+       ///< not register or unregister any clients.
+public:
+  cMemoryClient(const char *Name, eMemoryPriority Priority, size_t Minimum, size_t Preferred, size_t Maximum, bool Resizable = false);
+       ///< Registers a client with the given Name and Priority with the global
+       ///< memory budget. Preferred and Maximum are limited to be at least Minimum.
+       ///< Size() returns the amount of memory that has been granted.
+  virtual ~cMemoryClient();
+  const char *Name(void) const { return name; }
+  eMemoryPriority Priority(void) const { return priority; }
+  size_t Size(void) const { return size; }
+       ///< Returns the amount of memory this client has been granted.
+  void SetLimits(size_t Minimum, size_t Preferred, size_t Maximum);
+       ///< Changes the limits of a resizable client, which then has Resize() called
+       ///< if the amount of memory it is granted changes.
+  };
+
+class cMemoryBudget {
+  friend class cMemoryClient;
+private:
+  static cMutex mutex;
+  static cVector<cMemoryClient *> clients;
+  static size_t peak;
+  static void Distribute(cMemoryClient *New = NULL);
+       ///< Distributes the budget among the resizable clients and New (if given).
+public:
+  static void Update(void);
+       ///< Distributes the budget anew, after Setup.MemoryBudget has been changed.
+  static void GetStatistics(cStringList &Lines);
+       ///< Appends one line per client with its priority, minimum, preferred,
+       ///< maximum and granted size (in KB) and its name, preceded by a line with
+       ///< the budget, the total granted and the peak total (in MB).
+  };
+
+#endif //__MEMBUDGET_H
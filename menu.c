@@ -20,6 +20,7 @@
 #include "eitscan.h"
 #include "i18n.h"
 #include "interface.h"
+#include "membudget.h"
 #include "plugin.h"
 #include "recording.h"
 #include "remote.h"
@@ -32,6 +33,7 @@
 #include "timers.h"
 #include "transfer.h"
 #include "videodir.h"
+#include "zapahead.h"
 
 #define MAXWAIT4EPGINFO   3 // seconds
 #define MODETIMEOUT       3 // seconds
@@ -166,6 +168,10 @@ private:
   cChannel data;
   cSourceParam *sourceParam;
   char name[256];
+  int apids[2];
+  int dpids[2];
+  int spids[2];
+  int caid;
   void Setup(void);
 public:
   cMenuEditChannel(cStateKey *ChannelsStateKey, cChannel *Channel, bool New = false);
@@ -190,11 +196,15 @@ cMenuEditChannel::cMenuEditChannel(cStateKey *ChannelsStateKey, cChannel *Channe
         data.nid = 0;
         data.tid = 0;
         data.rid = 0;
-        *data.shortName  = 0;
-        *data.provider   = 0;
-        *data.portalName = 0;
+        data.SetNames(data.name, "", "", "");
         }
      }
+  for (int i = 0; i < 2; i++) {
+      apids[i] = data.Apid(i);
+      dpids[i] = data.Dpid(i);
+      spids[i] = data.Spid(i);
+      }
+  caid = data.Ca();
   Setup();
 }
 
@@ -210,14 +220,14 @@ void cMenuEditChannel::Setup(void)
   Add(new cMenuEditIntItem( tr("Frequency"),    &data.frequency));
   Add(new cMenuEditIntItem( tr("Vpid"),         &data.vpid,  0, 0x1FFF));
   Add(new cMenuEditIntItem( tr("Ppid"),         &data.ppid,  0, 0x1FFF));
-  Add(new cMenuEditIntItem( tr("Apid1"),        &data.apids[0], 0, 0x1FFF));
-  Add(new cMenuEditIntItem( tr("Apid2"),        &data.apids[1], 0, 0x1FFF));
-  Add(new cMenuEditIntItem( tr("Dpid1"),        &data.dpids[0], 0, 0x1FFF));
-  Add(new cMenuEditIntItem( tr("Dpid2"),        &data.dpids[1], 0, 0x1FFF));
-  Add(new cMenuEditIntItem( tr("Spid1"),        &data.spids[0], 0, 0x1FFF));
-  Add(new cMenuEditIntItem( tr("Spid2"),        &data.spids[1], 0, 0x1FFF));
+  Add(new cMenuEditIntItem( tr("Apid1"),        &apids[0], 0, 0x1FFF));
+  Add(new cMenuEditIntItem( tr("Apid2"),        &apids[1], 0, 0x1FFF));
+  Add(new cMenuEditIntItem( tr("Dpid1"),        &dpids[0], 0, 0x1FFF));
+  Add(new cMenuEditIntItem( tr("Dpid2"),        &dpids[1], 0, 0x1FFF));
+  Add(new cMenuEditIntItem( tr("Spid1"),        &spids[0], 0, 0x1FFF));
+  Add(new cMenuEditIntItem( tr("Spid2"),        &spids[1], 0, 0x1FFF));
   Add(new cMenuEditIntItem( tr("Tpid"),         &data.tpid,  0, 0x1FFF));
-  Add(new cMenuEditCaItem(  tr("CA"),           &data.caids[0]));
+  Add(new cMenuEditCaItem(  tr("CA"),           &caid));
   Add(new cMenuEditIntItem( tr("Sid"),          &data.sid, 1, 0xFFFF));
   Add(new cMenuEditIntItem( tr("Nid"),          &data.nid, 0));
   Add(new cMenuEditIntItem( tr("Tid"),          &data.tid, 0));
@@ -248,8 +258,9 @@ eOSState cMenuEditChannel::ProcessKey(eKeys Key)
         bool Modified = false;
         if (sourceParam)
            sourceParam->GetData(&data);
+        data.SetEditablePids(apids, dpids, spids, caid);
         if (Channels->HasUniqueChannelID(&data, channel)) {
-           data.name = strcpyrealloc(data.name, name);
+           data.SetNames(name, data.shortName, data.provider, data.portalName);
            if (channel) {
               *channel = data;
               isyslog("edited channel %d %s", channel->Number(), *channel->ToText());
@@ -1589,6 +1600,7 @@ public:
   static eScheduleSortMode SortMode(void) { return sortMode; }
   virtual int Compare(const cListObject &ListObject) const override;
   bool Update(const cTimers *Timers, bool Force = false);
+  virtual void Set(void) override;
   virtual void SetMenuItem(cSkinDisplayMenu *DisplayMenu, int Index, bool Current, bool Selectable) override;
   };
 
@@ -1630,24 +1642,31 @@ bool cMenuScheduleItem::Update(const cTimers *Timers, bool Force)
      timerMatch = tmNone;
   timerActive = timer && timer->HasFlags(tfActive);
   if (Force || timerMatch != OldTimerMatch || timerActive != OldTimerActive) {
-     cString buffer;
-     char t = TimerMatchChars[timerMatch + (timerActive ? 0 : 3)];
-     char v = event->Vps() && (event->Vps() - event->StartTime()) ? 'V' : ' ';
-     char r = event->SeenWithin(30) && event->IsRunning() ? '*' : ' ';
-     const char *csn = channel ? channel->ShortName(true) : NULL;
-     cString eds = event->GetDateString();
-     if (channel && withDate)
-        buffer = cString::sprintf("%d\t%.*s\t%.*s\t%s\t%c%c%c\t%s", channel->Number(), Utf8SymChars(csn, 999), csn, Utf8SymChars(eds, 6), *eds, *event->GetTimeString(), t, v, r, event->Title());
-     else if (channel)
-        buffer = cString::sprintf("%d\t%.*s\t%s\t%c%c%c\t%s", channel->Number(), Utf8SymChars(csn, 999), csn, *event->GetTimeString(), t, v, r, event->Title());
-     else
-        buffer = cString::sprintf("%.*s\t%s\t%c%c%c\t%s", Utf8SymChars(eds, 6), *eds, *event->GetTimeString(), t, v, r, event->Title());
-     SetText(buffer);
+     SetTextDeferred(); // the text is only needed once this item is displayed
      return true;
      }
   return false;
 }
 
+void cMenuScheduleItem::Set(void)
+{
+  LOCK_CHANNELS_READ;
+  LOCK_SCHEDULES_READ;
+  cString buffer;
+  char t = TimerMatchChars[timerMatch + (timerActive ? 0 : 3)];
+  char v = event->Vps() && (event->Vps() - event->StartTime()) ? 'V' : ' ';
+  char r = event->SeenWithin(30) && event->IsRunning() ? '*' : ' ';
+  const char *csn = channel ? channel->ShortName(true) : NULL;
+  cString eds = event->GetDateString();
+  if (channel && withDate)
+     buffer = cString::sprintf("%d\t%.*s\t%.*s\t%s\t%c%c%c\t%s", channel->Number(), Utf8SymChars(csn, 999), csn, Utf8SymChars(eds, 6), *eds, *event->GetTimeString(), t, v, r, event->Title());
+  else if (channel)
+     buffer = cString::sprintf("%d\t%.*s\t%s\t%c%c%c\t%s", channel->Number(), Utf8SymChars(csn, 999), csn, *event->GetTimeString(), t, v, r, event->Title());
+  else
+     buffer = cString::sprintf("%.*s\t%s\t%c%c%c\t%s", Utf8SymChars(eds, 6), *eds, *event->GetTimeString(), t, v, r, event->Title());
+  SetText(buffer);
+}
+
 void cMenuScheduleItem::SetMenuItem(cSkinDisplayMenu *DisplayMenu, int Index, bool Current, bool Selectable)
 {
   LOCK_TIMERS_READ;
@@ -3046,7 +3065,11 @@ public:
   int Level(void) const { return level; }
   const cRecording *Recording(void) const { return recording; }
   bool IsDirectory(void) const { return name != NULL; }
+  bool IsEmpty(void) const { return !name && level >= 0 && level != recording->HierarchyLevels(); }
+       ///< Returns true if the recording is neither shown as a folder nor as an actual
+       ///< recording on the given level.
   void SetRecording(const cRecording *Recording) { recording = Recording; }
+  virtual void Set(void) override;
   virtual void SetMenuItem(cSkinDisplayMenu *DisplayMenu, int Index, bool Current, bool Selectable) override;
   };
 
@@ -3056,14 +3079,17 @@ cMenuRecordingItem::cMenuRecordingItem(const cRecording *Recording, int Level)
   level = Level;
   name = NULL;
   totalEntries = newEntries = 0;
-  SetText(Recording->Title('\t', true, Level));
-  if (*Text() == '\t') // this is a folder
-     name = strdup(Text() + 2); // 'Text() + 2' to skip the two '\t'
-  else { // this is an actual recording
+  if (Level < 0 || Level == Recording->HierarchyLevels()) { // this is an actual recording
+     SetTextDeferred(); // formatting the title may require reading the recording's index file, so this is only done once the item is displayed
      int Usage = Recording->IsInUse();
      if ((Usage & ruDst) != 0 && (Usage & (ruMove | ruCopy)) != 0)
         SetSelectable(false);
      }
+  else {
+     SetText(Recording->Title('\t', true, Level));
+     if (*Text() == '\t') // this is a folder
+        name = strdup(Text() + 2); // 'Text() + 2' to skip the two '\t'
+     }
 }
 
 cMenuRecordingItem::~cMenuRecordingItem()
@@ -3079,6 +3105,14 @@ void cMenuRecordingItem::IncrementCounter(bool New)
   SetText(cString::sprintf("%d\t\t%d\t%s", totalEntries, newEntries, name));
 }
 
+void cMenuRecordingItem::Set(void)
+{
+  if (!IsDirectory()) {
+     LOCK_RECORDINGS_READ;
+     SetText(recording->Title('\t', true, level));
+     }
+}
+
 void cMenuRecordingItem::SetMenuItem(cSkinDisplayMenu *DisplayMenu, int Index, bool Current, bool Selectable)
 {
   LOCK_RECORDINGS_READ;
@@ -3200,7 +3234,7 @@ void cMenuRecordings::Set(bool Refresh)
                       }
                    }
                }
-            if (*Item->Text() && !LastDir) {
+            if (!Item->IsEmpty() && !LastDir) {
                Add(Item);
                LastItem = Item;
                if (Item->IsDirectory())
@@ -3606,6 +3640,11 @@ eOSState cMenuRecordings::ProcessKey(eKeys Key)
      Set(true);
      if (Key != kNone)
         SetHelpKeys();
+     if (!delRecMenu) {
+        cMenuRecordingItem *ri = (cMenuRecordingItem *)Get(Current());
+        if (ri && !ri->IsDirectory())
+           cReplayControl::Preload(ri->Recording()->FileName()); // so that replay can start immediately
+        }
      }
   return state;
 }
@@ -3838,6 +3877,7 @@ void cMenuSetupEPG::Setup(void)
   Add(new cMenuEditBoolItem(tr("Setup.EPG$EPG pause after scan"),      &data.EPGPauseAfterScan));
   Add(new cMenuEditIntItem( tr("Setup.EPG$EPG bugfix level"),          &data.EPGBugfixLevel, 0, MAXEPGBUGFIXLEVEL));
   Add(new cMenuEditIntItem( tr("Setup.EPG$EPG linger time (min)"),     &data.EPGLinger, 0));
+  Add(new cMenuEditBoolItem(tr("Setup.EPG$EPG search index"),          &data.EPGSearchIndex));
   Add(new cMenuEditBoolItem(tr("Setup.EPG$Set system time"),           &data.SetSystemTime));
   if (data.SetSystemTime)
      Add(new cMenuEditTranItem(Indent(2, tr("Setup.EPG$Use time from transponder")), &data.TimeTransponder, &data.TimeSource));
@@ -3959,6 +3999,8 @@ void cMenuSetupDVB::Setup(void)
      Add(new cMenuEditStraItem(tr("Setup.DVB$Video display format"), &data.VideoDisplayFormat, 3, videoDisplayFormatTexts));
   Add(new cMenuEditBoolItem(tr("Setup.DVB$Use Dolby Digital"),     &data.UseDolbyDigital));
   Add(new cMenuEditStraItem(tr("Setup.DVB$Update channels"),       &data.UpdateChannels, 6, updateChannelsTexts));
+  Add(new cMenuEditBoolItem(tr("Setup.DVB$Section filters"),       &data.SectionFilters, tr("device"), tr("VDR")));
+  Add(new cMenuEditIntItem( tr("Setup.DVB$Signal statistics interval (ms)"), &data.SignalStatsInterval, 0, 10000, tr("off")));
   Add(new cMenuEditIntItem( tr("Setup.DVB$Audio languages"),       &numAudioLanguages, 0, I18nLanguages()->Size()));
   for (int i = 0; i < numAudioLanguages; i++)
       Add(new cMenuEditStraItem(Indent(2, tr("Setup.DVB$Audio language")), &data.AudioLanguages[i], I18nLanguages()->Size(), &I18nLanguages()->At(0)));
@@ -4361,6 +4403,7 @@ cMenuSetupRecord::cMenuSetupRecord(void)
   Add(new cMenuEditStraItem(tr("Setup.Recording$Pause key handling"),        &data.PauseKeyHandling, 3, pauseKeyHandlingTexts));
   Add(new cMenuEditIntItem( tr("Setup.Recording$Pause priority"),            &data.PausePriority, 0, MAXPRIORITY));
   Add(new cMenuEditIntItem( tr("Setup.Recording$Pause lifetime (d)"),        &data.PauseLifetime, 0, MAXLIFETIME));
+  Add(new cMenuEditIntItem( tr("Setup.Recording$Pause buffer size (MB)"),     &data.PauseBufferSize, 0, INT_MAX, tr("off")));
   Add(new cMenuEditBoolItem(tr("Setup.Recording$Use episode name"),          &data.UseSubtitle));
   Add(new cMenuEditBoolItem(tr("Setup.Recording$Use VPS"),                   &data.UseVps));
   Add(new cMenuEditIntItem( tr("Setup.Recording$VPS margin (s)"),            &data.VpsMargin, 0));
@@ -4370,6 +4413,11 @@ cMenuSetupRecord::cMenuSetupRecord(void)
   Add(new cMenuEditIntItem( tr("Setup.Recording$Max. video file size (MB)"), &data.MaxVideoFileSize, MINVIDEOFILESIZE, MAXVIDEOFILESIZETS));
   Add(new cMenuEditBoolItem(tr("Setup.Recording$Split edited files"),        &data.SplitEditedFiles));
   Add(new cMenuEditStraItem(tr("Setup.Recording$Delete timeshift recording"),&data.DelTimeshiftRec, 3, delTimeshiftRecTexts));
+  Add(new cMenuEditBoolItem(tr("Setup.Recording$Use asynchronous I/O"),      &data.UseIoUring));
+  Add(new cMenuEditBoolItem(tr("Setup.Recording$Use direct I/O"),            &data.UseDirectIo));
+  Add(new cMenuEditIntItem( tr("Setup.Recording$Preallocation (MB)"),        &data.PreallocateMB, 0, MAXVIDEOFILESIZETS, tr("off")));
+  Add(new cMenuEditIntItem( tr("Setup.Recording$Jobs per disk"),             &data.JobsPerDisk, 1, MAXJOBSPERDISK));
+  Add(new cMenuEditIntItem( tr("Setup.Recording$Job bandwidth (MB/s)"),      &data.JobBandwidth, 0, INT_MAX, tr("unlimited")));
 }
 
 // --- cMenuSetupReplay ------------------------------------------------------
@@ -4455,9 +4503,11 @@ void cMenuSetupMisc::Set(void)
      }
   Add(new cMenuEditIntItem( tr("Setup.Miscellaneous$Zap timeout (s)"),            &data.ZapTimeout));
   Add(new cMenuEditIntItem( tr("Setup.Miscellaneous$Channel entry timeout (ms)"), &data.ChannelEntryTimeout, 0));
+  Add(new cMenuEditIntItem( tr("Setup.Miscellaneous$Zap ahead (channels)"),       &data.ZapAhead, 0, MAXZAPAHEAD, tr("off")));
   Add(new cMenuEditIntItem( tr("Setup.Miscellaneous$Remote control repeat delay (ms)"), &data.RcRepeatDelay, 0));
   Add(new cMenuEditIntItem( tr("Setup.Miscellaneous$Remote control repeat delta (ms)"), &data.RcRepeatDelta, 0));
   Add(new cMenuEditIntItem( tr("Setup.Miscellaneous$Deleted recordings retention (d)"), &data.DeleteRetention, 0));
+  Add(new cMenuEditIntItem( tr("Setup.Miscellaneous$Deleted recordings removal step (MB)"), &data.RemoveStepSize, 0, MAXVIDEOFILESIZETS, tr("off")));
   Add(new cMenuEditChanItem(tr("Setup.Miscellaneous$Initial channel"),            &data.InitialChannel, tr("Setup.Miscellaneous$as before")));
   Add(new cMenuEditIntItem( tr("Setup.Miscellaneous$Initial volume"),             &data.InitialVolume, -1, 255, tr("Setup.Miscellaneous$as before")));
   Add(new cMenuEditIntItem( tr("Setup.Miscellaneous$Volume steps"),               &data.VolumeSteps, 5, 255));
@@ -4465,6 +4515,7 @@ void cMenuSetupMisc::Set(void)
   Add(new cMenuEditBoolItem(tr("Setup.Miscellaneous$Channels wrap"),              &data.ChannelsWrap));
   Add(new cMenuEditStraItem(tr("Setup.Miscellaneous$Show channel names with source"), &data.ShowChannelNamesWithSource, 3, showChannelNamesWithSourceTexts));
   Add(new cMenuEditBoolItem(tr("Setup.Miscellaneous$Emergency exit"),             &data.EmergencyExit));
+  Add(new cMenuEditIntItem( tr("Setup.Miscellaneous$Memory budget (MB)"),         &data.MemoryBudget, 0, INT_MAX, tr("unlimited")));
   SetCurrent(Get(current));
   Display();
 }
@@ -4474,11 +4525,15 @@ eOSState cMenuSetupMisc::ProcessKey(eKeys Key)
   bool OldSVDRPPeering = data.SVDRPPeering;
   bool ModifiedSVDRPSettings = false;
   bool ModifiedShowChannelNamesWithSource = false;
+  bool ModifiedMemoryBudget = false;
   if (Key == kOk) {
      ModifiedSVDRPSettings = data.SVDRPPeering != Setup.SVDRPPeering || strcmp(data.SVDRPHostName, Setup.SVDRPHostName);
      ModifiedShowChannelNamesWithSource = data.ShowChannelNamesWithSource != Setup.ShowChannelNamesWithSource;
+     ModifiedMemoryBudget = data.MemoryBudget != Setup.MemoryBudget;
      }
   eOSState state = cMenuSetupBase::ProcessKey(Key);
+  if (ModifiedMemoryBudget)
+     cMemoryBudget::Update();
   if (ModifiedShowChannelNamesWithSource) {
      LOCK_CHANNELS_WRITE;
      for (cChannel *Channel = Channels->First(); Channel; Channel = Channels->Next(Channel))
@@ -5590,6 +5645,8 @@ cRecordControl::cRecordControl(cDevice *Device, cTimers *Timers, cTimer *Timer,
 
   event = NULL;
   fileName = NULL;
+  timeshiftBuffer = false;
+  keep = false;
   recorder = NULL;
   device = Device;
   if (!device) device = cDevice::PrimaryDevice();//XXX
@@ -5607,7 +5664,15 @@ cRecordControl::cRecordControl(cDevice *Device, cTimers *Timers, cTimer *Timer,
   if (event || GetEvent())
      dsyslog("Title: '%s' Subtitle: '%s'", event->Title(), event->ShortText());
   cRecording Recording(timer, event);
-  fileName = strdup(Recording.FileName());
+  if (Pause && Setup.PauseBufferSize > 0 && cRecordControls::PauseDirectory()) {
+     // The time shift buffer has the same path below the pause directory as the
+     // recording would have below the video directory, so that it can be moved
+     // there if the user decides to keep it:
+     fileName = strdup(AddDirectory(cRecordControls::PauseDirectory(), Recording.FileName() + strlen(cVideoDirectory::Name()) + 1));
+     timeshiftBuffer = true;
+     }
+  else
+     fileName = strdup(Recording.FileName());
 
   // crude attempt to avoid duplicate recordings:
   if (cRecordControls::GetRecordControl(fileName)) {
@@ -5627,17 +5692,22 @@ cRecordControl::cRecordControl(cDevice *Device, cTimers *Timers, cTimer *Timer,
      return;
      }
 
-  cRecordingUserCommand::InvokeCommand(RUC_BEFORERECORDING, fileName);
+  if (!timeshiftBuffer)
+     cRecordingUserCommand::InvokeCommand(RUC_BEFORERECORDING, fileName);
   isyslog("record %s", fileName);
   if (MakeDirs(fileName, true)) {
-     Recording.WriteInfo(); // we write this *before* attaching the recorder to the device, to make sure the info file is present when the recorder needs to update the fps value!
+     Recording.WriteInfo(timeshiftBuffer ? fileName : NULL); // we write this *before* attaching the recorder to the device, to make sure the info file is present when the recorder needs to update the fps value!
      const cChannel *ch = timer->Channel();
      recorder = new cRecorder(fileName, ch, timer->Priority());
+     if (timeshiftBuffer)
+        recorder->SetTimeshiftSize(Setup.PauseBufferSize);
      if (device->AttachReceiver(recorder)) {
-        cStatus::MsgRecording(device, Recording.Name(), Recording.FileName(), true);
+        cStatus::MsgRecording(device, Recording.Name(), fileName, true);
         if (!Timer && !LastReplayed) // an instant recording, maybe from cRecordControls::PauseLiveVideo()
            cReplayControl::SetRecording(fileName);
         SchedulesStateKey.Remove();
+        if (timeshiftBuffer)
+           return; // becomes a recording only if the user decides to keep it
         LOCK_RECORDINGS_WRITE;
         SetRecordingTimerId(fileName, cString::sprintf("%d@%s", timer->Id(), Setup.SVDRPHostName));
         Recordings->AddByName(fileName);
@@ -5695,6 +5765,10 @@ void cRecordControl::Stop(bool ExecuteUserCommand)
         recorder->Stop();
         int Errors = recorder->Errors();
         isyslog("timer %s %s with %d error%s", *timer->ToDescr(), Finished ? "finished" : "stopped", Errors, Errors != 1 ? "s" : "");
+        int Size, MaxFill, Overflows;
+        int64_t OverflowBytes;
+        if (recorder->GetBufferStats(Size, MaxFill, Overflows, OverflowBytes))
+           dsyslog("timer %s: recording buffer %d MB, max. %d%% used, %d overflow%s (%" PRId64 " bytes dropped)", *timer->ToDescr(), int(Size / MEGABYTE(1)), int(int64_t(MaxFill) * 100 / Size), Overflows, Overflows != 1 ? "s" : "", OverflowBytes);
         if (timer->HasFlags(tfAvoid) && Errors == 0 && Finished) {
            const char *p = strgetlast(timer->File(), FOLDERDELIMCHAR);
            DoneRecordingsPattern.Append(p);
@@ -5703,13 +5777,39 @@ void cRecordControl::Stop(bool ExecuteUserCommand)
      DELETENULL(recorder);
      timer->SetRecording(false);
      timer = NULL;
+     if (timeshiftBuffer) {
+        cStatus::MsgRecording(device, NULL, fileName, false);
+        if (keep) {
+           cString NewName = AddDirectory(cVideoDirectory::Name(), fileName + strlen(cRecordControls::PauseDirectory()) + 1);
+           isyslog("keeping time shift buffer %s as %s", fileName, *NewName);
+           if (MakeDirs(NewName) && cVideoDirectory::MoveVideoFile(fileName, NewName)) {
+              LOCK_RECORDINGS_WRITE;
+              Recordings->AddByName(NewName);
+              }
+           }
+        else if (!cReplayControl::NowReplaying() || strcmp(cReplayControl::NowReplaying(), fileName) != 0)
+           cRecordControls::RemoveTimeshiftBuffer(fileName); // otherwise the replay will remove it when it ends
+        return;
+        }
      SetRecordingTimerId(fileName, NULL);
      cStatus::MsgRecording(device, NULL, fileName, false);
+     RecordingsHandler.Add(ruPreview, fileName);
      if (ExecuteUserCommand && Finished)
         cRecordingUserCommand::InvokeCommand(RUC_AFTERRECORDING, fileName);
      }
 }
 
+bool cRecordControl::Keep(void)
+{
+  if (timeshiftBuffer && !keep && recorder) {
+     recorder->SetTimeshiftSize(0);
+     keep = true;
+     isyslog("time shift buffer %s will be kept", fileName);
+     return true;
+     }
+  return false;
+}
+
 bool cRecordControl::Process(time_t t)
 {
   if (!recorder || !recorder->IsAttached() || !timer || !timer->Matches(t)) {
@@ -5724,6 +5824,25 @@ bool cRecordControl::Process(time_t t)
 
 cRecordControl *cRecordControls::RecordControls[MAXRECORDCONTROLS] = { NULL };
 int cRecordControls::state = 0;
+cString cRecordControls::pauseDirectory;
+
+bool cRecordControls::InPauseDirectory(const char *FileName)
+{
+  return *pauseDirectory && FileName && startswith(FileName, pauseDirectory) && FileName[strlen(pauseDirectory)] == '/';
+}
+
+void cRecordControls::RemoveTimeshiftBuffer(const char *FileName)
+{
+  if (InPauseDirectory(FileName) && access(FileName, F_OK) == 0 && !RecordingsHandler.GetUsage(FileName)) {
+     for (int i = 0; i < MAXRECORDCONTROLS; i++) {
+         if (RecordControls[i] && RecordControls[i]->Timer() && strcmp(RecordControls[i]->FileName(), FileName) == 0)
+            return; // still being recorded
+         }
+     isyslog("removing time shift buffer %s", FileName);
+     RemoveFileOrDir(FileName);
+     RemoveEmptyDirectories(pauseDirectory);
+     }
+}
 
 bool cRecordControls::Start(cTimers *Timers, cTimer *Timer, bool Pause)
 {
@@ -6014,6 +6133,18 @@ void cReplayControl::Stop(void)
 {
   Hide();
   cStatus::MsgReplaying(this, NULL, fileName, false);
+  if (cRecordControls::InPauseDirectory(fileName)) {
+     // A time shift buffer ends with the replay, unless the user has decided to keep it:
+     cRecordControl* rc = cRecordControls::GetRecordControl(fileName);
+     if (rc && rc->IsTimeshiftBuffer()) {
+        timeshiftTimer = rc->Timer();
+        rc->Stop(false);
+        }
+     cDvbPlayerControl::Stop();
+     cRecordControls::RemoveTimeshiftBuffer(fileName);
+     ClearLastReplayed(fileName);
+     return;
+     }
   if (Setup.DelTimeshiftRec && *fileName) {
      cRecordControl* rc = cRecordControls::GetRecordControl(fileName);
      if (rc && rc->InstantId()) {
@@ -6073,6 +6204,8 @@ const char *cReplayControl::NowReplaying(void)
 
 const char *cReplayControl::LastReplayed(void)
 {
+  if (currentReplayControl && cRecordControls::InPauseDirectory(fileName))
+     return fileName; // a time shift buffer is not among the recordings
   LOCK_RECORDINGS_READ;
   if (!Recordings->GetByName(fileName))
      fileName = NULL;
@@ -6244,7 +6377,7 @@ void cReplayControl::TimeSearchProcess(eKeys Key)
          if (timeSearchPos > 0) {
             Seconds = min(Total - STAY_SECONDS_OFF_END, Seconds);
             bool Still = Key == kDown || Key == kPause || Key == kOk;
-            Goto(SecondsToFrames(Seconds, FramesPerSecond()), Still);
+            Goto(SecondsToIndex(Seconds), Still);
             }
          timeSearchActive = false;
          break;
@@ -6378,31 +6511,26 @@ void cReplayControl::ErrorJump(bool Forward)
      if (GetIndex(Current, Total)) {
         if (Forward) {
            int Offset = 0;
-           for (int i = 0; i < NumErrors; i++) {
-               int Position = Errors->At(i);
-               if (Position > Current + Offset) {
-                  int NextIFrame = SkipFrames(Position - Current) + Offset; // this takes us to the I-frame at or right after Position
-                  if (NextIFrame > Position) {
-                     if (SkipFrames(Offset + 1) == NextIFrame) { // means Current is the I-frame right before Position
-                        Offset = NextIFrame - Current;
-                        continue;
-                        }
+           for (int Position = Errors->Next(Current); Position >= 0; Position = Errors->Next(Current + Offset)) {
+               int NextIFrame = SkipFrames(Position - Current) + Offset; // this takes us to the I-frame at or right after Position
+               if (NextIFrame > Position) {
+                  if (SkipFrames(Offset + 1) == NextIFrame) { // means Current is the I-frame right before Position
+                     Offset = NextIFrame - Current;
+                     continue;
                      }
-                  Goto(Position, true); // this takes us to the I-frame at or right before Position
-                  return;
                   }
+               Goto(Position, true); // this takes us to the I-frame at or right before Position
+               return;
                }
            if (Current < Total)
               Goto(Total, true);
            }
         else {
-           for (int i = NumErrors - 1; i >= 0; i--) {
-               if (Errors->At(i) < Current) {
-                  int Position = Errors->At(i);
-                  Goto(Position, true); // this takes us to the I-frame at or right before Position
-                  return;
-                  }
-               }
+           int Position = Errors->Prev(Current);
+           if (Position >= 0) {
+              Goto(Position, true); // this takes us to the I-frame at or right before Position
+              return;
+              }
            if (Current > 0)
               Goto(0, true);
            }
@@ -6450,6 +6578,17 @@ void cReplayControl::EditTest(void)
      }
 }
 
+bool cReplayControl::KeepTimeshiftBuffer(void)
+{
+  if (cRecordControl *rc = cRecordControls::GetRecordControl(fileName)) {
+     if (rc->Keep()) {
+        Skins.Message(mtInfo, tr("Recording started"));
+        return true;
+        }
+     }
+  return false;
+}
+
 cOsdObject *cReplayControl::GetInfo(void)
 {
   LOCK_RECORDINGS_READ;
@@ -6560,6 +6699,9 @@ eOSState cReplayControl::ProcessKey(eKeys Key)
         case kChanDn:          ErrorJump(false); break;
         case kEditCut:         EditCut(); break;
         case kEditTest:        EditTest(); break;
+        case kRecord:          if (!KeepTimeshiftBuffer())
+                                  return osUnknown;
+                               break;
         default: {
           displayFrames = DisplayedFrames;
           switch (Key) {
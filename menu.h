@@ -250,6 +250,8 @@ private:
   const cEvent *event;
   cString instantId;
   char *fileName;
+  bool timeshiftBuffer;
+  bool keep;
   bool GetEvent(void);
 public:
   cRecordControl(cDevice *Device, cTimers *Timers, cTimer *Timer = NULL, bool Pause = false);
@@ -260,13 +262,30 @@ public:
   const char *InstantId(void) { return instantId; }
   const char *FileName(void) { return fileName; }
   cTimer *Timer(void) { return timer; }
+  bool IsTimeshiftBuffer(void) { return timeshiftBuffer && !keep; }
+       ///< Returns true if this is a time shift buffer for pausing live video, which
+       ///< is discarded when it is stopped.
+  bool Keep(void);
+       ///< Turns a time shift buffer into a real recording, which is moved into the
+       ///< video directory when it is stopped. Returns false if this is not a time
+       ///< shift buffer.
   };
 
 class cRecordControls {
 private:
   static cRecordControl *RecordControls[];
   static int state;
+  static cString pauseDirectory;
 public:
+  static void SetPauseDirectory(const char *Directory) { pauseDirectory = Directory; }
+         ///< Sets the Directory that holds the time shift buffers used for pausing
+         ///< live video (if Setup.PauseBufferSize is not 0). It should be on a tmpfs.
+  static const char *PauseDirectory(void) { return pauseDirectory; }
+  static bool InPauseDirectory(const char *FileName);
+         ///< Returns true if FileName is a time shift buffer in the pause directory.
+  static void RemoveTimeshiftBuffer(const char *FileName);
+         ///< Removes the time shift buffer with the given FileName, unless it is still
+         ///< being recorded or moved into the video directory.
   static bool Start(cTimers *Timers, cTimer *Timer, bool Pause = false);
   static bool Start(bool Pause = false);
   static void Stop(const char *InstantId);
@@ -328,6 +347,7 @@ private:
   void ErrorJump(bool Forward);
   void EditCut(void);
   void EditTest(void);
+  bool KeepTimeshiftBuffer(void);
 public:
   cReplayControl(bool PauseLive = false);
   virtual ~cReplayControl() override;
@@ -0,0 +1,121 @@
+/*
+ * metrics.c: Runtime metrics in OpenMetrics format
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#include "metrics.h"
+#include "device.h"
+#include "eit.h"
+#include "recorder.h"
+#include "remote.h"
+#include "ringbuffer.h"
+#include "sections.h"
+#include "thread.h"
+
+// --- cMetrics --------------------------------------------------------------
+
+cMetrics::cMetrics(cStringList &Lines)
+:lines(Lines)
+{
+  counter = false;
+}
+
+void cMetrics::Family(const char *Name, const char *Type, const char *Help)
+{
+  name = Name;
+  counter = strcmp(Type, "counter") == 0;
+  lines.Append(strdup(cString::sprintf("# TYPE %s %s", Name, Type)));
+  lines.Append(strdup(cString::sprintf("# HELP %s %s", Name, Help)));
+}
+
+void cMetrics::Add(double Value, const char *Labels)
+{
+  lines.Append(strdup(cString::sprintf("%s%s%s%s%s %.15g", *name, counter ? "_total" : "", Labels ? "{" : "", Labels ? Labels : "", Labels ? "}" : "", Value)));
+}
+
+cString cMetrics::Label(const char *Name, const char *Value)
+{
+  char *Escaped = MALLOC(char, 2 * strlen(Value) + 1);
+  char *q = Escaped;
+  for (const char *p = Value; *p; p++) {
+      switch (*p) {
+        case '\\':
+        case '"': *q++ = '\\'; *q++ = *p; break;
+        case '\n': *q++ = '\\'; *q++ = 'n'; break;
+        default: *q++ = *p;
+        }
+      }
+  *q = 0;
+  cString Label = cString::sprintf("%s=\"%s\"", Name, Escaped);
+  free(Escaped);
+  return Label;
+}
+
+cString cMetrics::Label(const char *Name, int Value)
+{
+  return cString::sprintf("%s=\"%d\"", Name, Value);
+}
+
+void cMetrics::Report(cStringList &Lines)
+{
+  cMetrics Metrics(Lines);
+  // Devices:
+  Metrics.Family("vdr_device_ts_packets", "counter", "TS packets received by a device");
+  for (int i = 0; i < cDevice::NumDevices(); i++) {
+      if (const cDevice *Device = cDevice::GetDevice(i))
+         Metrics.Add(Device->TsPackets(), Label("device", i + 1));
+      }
+  Metrics.Family("vdr_device_continuity_errors", "counter", "TS continuity counter errors detected by a device");
+  for (int i = 0; i < cDevice::NumDevices(); i++) {
+      if (const cDevice *Device = cDevice::GetDevice(i))
+         Metrics.Add(Device->ContinuityErrors(), Label("device", i + 1));
+      }
+  Metrics.Family("vdr_device_signal_strength_percent", "gauge", "Signal strength of a device's tuner");
+  for (int i = 0; i < cDevice::NumDevices(); i++) {
+      if (const cDevice *Device = cDevice::GetDevice(i)) {
+         int Strength = Device->SignalStrength();
+         if (Strength >= 0)
+            Metrics.Add(Strength, Label("device", i + 1));
+         }
+      }
+  Metrics.Family("vdr_device_signal_quality_percent", "gauge", "Signal quality of a device's tuner");
+  for (int i = 0; i < cDevice::NumDevices(); i++) {
+      if (const cDevice *Device = cDevice::GetDevice(i)) {
+         int Quality = Device->SignalQuality();
+         if (Quality >= 0)
+            Metrics.Add(Quality, Label("device", i + 1));
+         }
+      }
+  // Sections:
+  Metrics.Family("vdr_device_section_filters", "gauge", "Section filters currently open on a device");
+  for (int i = 0; i < cDevice::NumDevices(); i++) {
+      if (const cDevice *Device = cDevice::GetDevice(i)) {
+         if (cSectionHandler *SectionHandler = Device->SectionHandler())
+            Metrics.Add(SectionHandler->NumFilters(), Label("device", i + 1));
+         }
+      }
+  Metrics.Family("vdr_device_sections", "counter", "Sections received by a device");
+  for (int i = 0; i < cDevice::NumDevices(); i++) {
+      if (const cDevice *Device = cDevice::GetDevice(i)) {
+         if (cSectionHandler *SectionHandler = Device->SectionHandler())
+            Metrics.Add(SectionHandler->Sections(), Label("device", i + 1));
+         }
+      }
+  Metrics.Family("vdr_device_eit_sections", "counter", "EIT sections received by a device");
+  for (int i = 0; i < cDevice::NumDevices(); i++) {
+      if (const cDevice *Device = cDevice::GetDevice(i)) {
+         if (const cEitFilter *EitFilter = Device->EitFilter())
+            Metrics.Add(EitFilter->Sections(), Label("device", i + 1));
+         }
+      }
+  // Recordings, buffers, locks and remote controls:
+  cRecorder::AddMetrics(Metrics);
+  cRingBuffer::AddMetrics(Metrics);
+  cStateLock::AddMetrics(Metrics);
+  cRemote::AddMetrics(Metrics);
+  Lines.Append(strdup("# EOF"));
+}
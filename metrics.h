@@ -0,0 +1,45 @@
+/*
+ * metrics.h: Runtime metrics in OpenMetrics format
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#ifndef __METRICS_H
+#define __METRICS_H
+
+#include "tools.h"
+
+// cMetrics collects VDR's runtime statistics (of devices, section filters, EIT
+// processing, recordings, ring buffers and state locks) in the OpenMetrics text
+// format, so that they can be scraped by a monitoring system like Prometheus.
+// The complete set is retrieved through the SVDRP command STAT METRICS.
+// Counters only ever increase (as long as the objects they belong to exist),
+// so rates (like TS packets per second) are to be calculated by the monitoring
+// system.
+
+class cMetrics {
+private:
+  cStringList &lines;
+  cString name;
+  bool counter;
+public:
+  cMetrics(cStringList &Lines);
+  void Family(const char *Name, const char *Type, const char *Help);
+       ///< Starts a new metric family with the given Name, Type ("counter" or
+       ///< "gauge") and Help text. All samples of a family must be added before
+       ///< the next family is started. The samples of a counter automatically
+       ///< get the suffix "_total".
+  void Add(double Value, const char *Labels = NULL);
+       ///< Adds a sample with the given Value to the current family. Labels is
+       ///< a comma separated list of labels, as returned by Label().
+  static cString Label(const char *Name, const char *Value);
+       ///< Returns the label Name="Value", with Value properly escaped.
+  static cString Label(const char *Name, int Value);
+  static void Report(cStringList &Lines);
+       ///< Appends all available metrics to Lines, terminated by "# EOF".
+  };
+
+#endif //__METRICS_H
@@ -252,7 +252,7 @@ cMtdCamSlot::cMtdCamSlot(cCamSlot *MasterSlot, int Index)
 {
   mtdBuffer = new cRingBufferLinear(MTD_BUFFER_SIZE, TS_SIZE, true, "MTD buffer");
   mtdMapper = new cMtdMapper(Index + 1, MasterSlot->SlotNumber());
-  delivered = false;
+  delivered = 0;
   ciAdapter = MasterSlot->ciAdapter; // we don't pass the CI adapter in the constructor, to prevent this one from being inserted into CamSlots
 }
 
@@ -303,29 +303,34 @@ void cMtdCamSlot::StopDecrypting(void)
   cMutexLock MutexLock(&clearMutex);
   mtdMapper->Clear();
   mtdBuffer->Clear();
-  delivered = false;
-}
-
-uchar *cMtdCamSlot::Decrypt(uchar *Data, int &Count)
-{
-  // Send data to CAM:
-  if (Count >= TS_SIZE) {
-     Count = TS_SIZE;
-     int Pid = TsPid(Data);
-     TsSetPid(Data, mtdMapper->RealToUniqPid(Pid));
-     MasterSlot()->Decrypt(Data, Count);
-     if (Count == 0)
-        TsSetPid(Data, Pid); // must restore PID for later retry
-     }
-  else
-     Count = 0;
+  delivered = 0;
+}
+
+uchar *cMtdCamSlot::DecryptPackets(uchar *Data, int &Count, int &Length, int MaxPackets)
+{
+  // Send data to CAM (the master slot's Decrypt() accepts one TS packet at a time):
+  int Sent = 0;
+  for (int i = 0; i < MaxPackets && Count - Sent >= TS_SIZE; i++) {
+      uchar *p = Data + Sent;
+      int Pid = TsPid(p);
+      TsSetPid(p, mtdMapper->RealToUniqPid(Pid));
+      int n = TS_SIZE;
+      MasterSlot()->Decrypt(p, n);
+      if (n == 0) {
+         TsSetPid(p, Pid); // must restore PID for later retry
+         break;
+         }
+      Sent += TS_SIZE;
+      }
+  Count = Sent;
   // Drop delivered data from previous call:
   cMutexLock MutexLock(&clearMutex);
   if (delivered) {
-     mtdBuffer->Del(TS_SIZE);
-     delivered = false;
+     mtdBuffer->Del(delivered);
+     delivered = 0;
      }
   // Receive data from buffer:
+  Length = 0;
   int c = 0;
   uchar *d = mtdBuffer->Get(c);
   if (d) {
@@ -333,9 +338,11 @@ uchar *cMtdCamSlot::Decrypt(uchar *Data, int &Count)
         mtdBuffer->Del(Skipped);
         return NULL;
         }
+     c = TsSyncedLength(d, min(c, MaxPackets * TS_SIZE));
      if (c >= TS_SIZE) {
-        TsSetPid(d, mtdMapper->UniqToRealPid(TsPid(d)));
-        delivered = true;
+        for (uchar *p = d; p < d + c; p += TS_SIZE)
+            TsSetPid(p, mtdMapper->UniqToRealPid(TsPid(p)));
+        delivered = Length = c;
         }
      else
         d = NULL;
@@ -343,11 +350,27 @@ uchar *cMtdCamSlot::Decrypt(uchar *Data, int &Count)
   return d;
 }
 
+uchar *cMtdCamSlot::Decrypt(uchar *Data, int &Count)
+{
+  int Length;
+  return DecryptPackets(Data, Count, Length, 1);
+}
+
+uchar *cMtdCamSlot::Decrypt(uchar *Data, int &Count, int &Length)
+{
+  return DecryptPackets(Data, Count, Length, MAXTSBATCH);
+}
+
 bool cMtdCamSlot::TsPostProcess(uchar *Data)
 {
   return MasterSlot()->TsPostProcess(Data);
 }
 
+bool cMtdCamSlot::TsPostProcess(uchar *Data, int Count)
+{
+  return MasterSlot()->TsPostProcess(Data, Count);
+}
+
 void cMtdCamSlot::InjectEit(int Sid)
 {
   MasterSlot()->InjectEit(mtdMapper->RealToUniqSid(Sid));
@@ -158,7 +158,8 @@ private:
   cMutex clearMutex;
   cMtdMapper *mtdMapper;
   cRingBufferLinear *mtdBuffer;
-  bool delivered;
+  int delivered;
+  uchar *DecryptPackets(uchar *Data, int &Count, int &Length, int MaxPackets);
 protected:
   virtual const int *GetCaSystemIds(void) override;
   virtual void SendCaPmt(uint8_t CmdId) override;
@@ -174,7 +175,9 @@ public:
   virtual void StartDecrypting(void) override;
   virtual void StopDecrypting(void) override;
   virtual uchar *Decrypt(uchar *Data, int &Count) override;
+  virtual uchar *Decrypt(uchar *Data, int &Count, int &Length) override;
   virtual bool TsPostProcess(uchar *Data) override;
+  virtual bool TsPostProcess(uchar *Data, int Count) override;
   virtual void InjectEit(int Sid) override;
   int PutData(const uchar *Data, int Count);
   int PutCat(const uchar *Data, int Count);
@@ -36,6 +36,7 @@ void cNitFilter::SetStatus(bool On)
 {
   cFilter::SetStatus(On);
   sectionSyncer.Reset();
+  sectionCollector.Clear();
 }
 
 void cNitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length)
@@ -61,10 +62,34 @@ void cNitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
          }
      dbgnit("NIT: %02X %2d %2d %2d %s %d %d '%s'\n", Tid, nit.getVersionNumber(), nit.getSectionNumber(), nit.getLastSectionNumber(), *cSource::ToString(Source()), nit.getNetworkId(), Transponder(), NetworkName);
      }
+  sectionCollector.Add(nit.getVersionNumber(), nit.getSectionNumber(), Data, Length);
+  if (!sectionSyncer.Processed(nit.getSectionNumber(), nit.getLastSectionNumber()))
+     return;
+  // The table is complete, so all of its sections are applied to the channels at once:
   cStateKey StateKey;
   cChannels *Channels = cChannels::GetChannelsWrite(StateKey, 10);
-  if (!Channels)
+  if (!Channels) {
+     // we'll try again with the next repetition of this table:
+     sectionSyncer.Reset();
+     sectionCollector.Clear();
      return;
+     }
+  bool ChannelsModified = false;
+  for (int i = 0; i <= nit.getLastSectionNumber(); i++) {
+      if (const u_char *SectionData = sectionCollector.Get(i)) {
+         SI::NIT Section(SectionData, false);
+         if (Section.CheckCRCAndParse())
+            ChannelsModified |= ProcessTransportStreams(Channels, Section);
+         }
+      }
+  sectionCollector.Clear();
+  dbgnit("    trigger sdtFilter for current tp %d\n", Transponder());
+  sdtFilter->Trigger(Source());
+  StateKey.Remove(ChannelsModified);
+}
+
+bool cNitFilter::ProcessTransportStreams(cChannels *Channels, SI::NIT &nit)
+{
   bool ChannelsModified = false;
   SI::NIT::TransportStream ts;
   for (SI::Loop::Iterator it; nit.transportStreamLoop.getNext(ts, it); ) {
@@ -371,9 +396,5 @@ void cNitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
           delete d;
           }
       }
-  if (sectionSyncer.Processed(nit.getSectionNumber(), nit.getLastSectionNumber())) {
-     dbgnit("    trigger sdtFilter for current tp %d\n", Transponder());
-     sdtFilter->Trigger(Source());
-     }
-  StateKey.Remove(ChannelsModified);
+  return ChannelsModified;
 }
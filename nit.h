@@ -10,13 +10,19 @@
 #ifndef __NIT_H
 #define __NIT_H
 
+#include "channels.h"
 #include "filter.h"
+#include "libsi/section.h"
 #include "sdt.h"
 
 class cNitFilter : public cFilter {
 private:
   cSectionSyncer sectionSyncer;
+  cSectionCollector sectionCollector;
   cSdtFilter *sdtFilter;
+  bool ProcessTransportStreams(cChannels *Channels, SI::NIT &nit);
+       ///< Applies the transport streams of the given NIT section to Channels.
+       ///< Returns true if any channel has been modified.
 protected:
   virtual void Process(u_short Pid, u_char Tid, const u_char *Data, int Length) override;
 public:
@@ -8,13 +8,21 @@
  */
 
 #include "osd.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 #include <math.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/unistd.h>
 #include "device.h"
+#include "membudget.h"
+#include "startup.h"
 #include "tools.h"
+#include "trace.h"
 
 tColor HsvToColor(double H, double S, double V)
 {
@@ -112,10 +120,147 @@ tColor AlphaBlend(tColor ColorFg, tColor ColorBg, uint8_t AlphaLayer)
 }
 #endif
 
+// Blends Count pixels of Src onto Dst, with the same result as calling AlphaBlend()
+// for each of them. With the lookup table, a foreground pixel that is fully transparent
+// or fully opaque, or a background pixel that is fully transparent, doesn't actually
+// need to be blended. Such pixels make up most of a typical OSD, so where SIMD
+// instructions are available they are handled four at a time:
+static void AlphaBlendRow(tColor *Dst, const tColor *Src, int Count, uint8_t AlphaLayer)
+{
+  int i = 0;
+#if defined(USE_ALPHA_LUT) && defined(__SSE2__)
+  const __m128i Layer = _mm_set1_epi32(AlphaLayer);
+  const __m128i Zero = _mm_setzero_si128();
+  const __m128i Opaque = _mm_set1_epi32((ALPHA_OPAQUE * ALPHA_OPAQUE) >> 8);
+  const __m128i RgbMask = _mm_set1_epi32(0x00FFFFFF);
+  for (; i + 4 <= Count; i += 4) {
+      __m128i s = _mm_loadu_si128((const __m128i *)(Src + i));
+      __m128i d = _mm_loadu_si128((const __m128i *)(Dst + i));
+      __m128i a = _mm_srli_epi32(_mm_mullo_epi16(_mm_srli_epi32(s, 24), Layer), 8);
+      __m128i FgTransparent = _mm_cmpeq_epi32(a, Zero);
+      __m128i FgOpaque = _mm_cmpeq_epi32(a, Opaque);
+      __m128i BgTransparent = _mm_cmpeq_epi32(_mm_srli_epi32(d, 24), Zero);
+      int Simple = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(FgTransparent, FgOpaque), BgTransparent));
+      if (!Simple) {
+         for (int j = i; j < i + 4; j++)
+             Dst[j] = AlphaBlend(Src[j], Dst[j], AlphaLayer);
+         continue;
+         }
+      // transparent background: the foreground color with the effective alpha value
+      __m128i r = _mm_or_si128(_mm_and_si128(s, RgbMask), _mm_slli_epi32(a, 24));
+      // opaque foreground: the foreground pixel
+      r = _mm_or_si128(_mm_and_si128(FgOpaque, s), _mm_andnot_si128(FgOpaque, r));
+      // transparent foreground: the background pixel (or 0 if that is transparent, too)
+      r = _mm_or_si128(_mm_and_si128(FgTransparent, _mm_andnot_si128(BgTransparent, d)), _mm_andnot_si128(FgTransparent, r));
+      if (Simple == 0xFFFF)
+         _mm_storeu_si128((__m128i *)(Dst + i), r);
+      else {
+         tColor t[4];
+         _mm_storeu_si128((__m128i *)t, r);
+         for (int j = 0; j < 4; j++) {
+             if (!(Simple & (1 << (4 * j))))
+                t[j] = AlphaBlend(Src[i + j], Dst[i + j], AlphaLayer);
+             }
+         memcpy(Dst + i, t, sizeof(t));
+         }
+      }
+#elif defined(USE_ALPHA_LUT) && defined(__ARM_NEON) && defined(__aarch64__)
+  const uint32x4_t Layer = vdupq_n_u32(AlphaLayer);
+  const uint32x4_t Opaque = vdupq_n_u32((ALPHA_OPAQUE * ALPHA_OPAQUE) >> 8);
+  const uint32x4_t RgbMask = vdupq_n_u32(0x00FFFFFF);
+  for (; i + 4 <= Count; i += 4) {
+      uint32x4_t s = vld1q_u32(Src + i);
+      uint32x4_t d = vld1q_u32(Dst + i);
+      uint32x4_t a = vshrq_n_u32(vmulq_u32(vshrq_n_u32(s, 24), Layer), 8);
+      uint32x4_t FgTransparent = vceqzq_u32(a);
+      uint32x4_t FgOpaque = vceqq_u32(a, Opaque);
+      uint32x4_t BgTransparent = vceqzq_u32(vshrq_n_u32(d, 24));
+      uint32x4_t Simple = vorrq_u32(vorrq_u32(FgTransparent, FgOpaque), BgTransparent);
+      if (!vmaxvq_u32(Simple)) {
+         for (int j = i; j < i + 4; j++)
+             Dst[j] = AlphaBlend(Src[j], Dst[j], AlphaLayer);
+         continue;
+         }
+      // see above for the individual cases:
+      uint32x4_t r = vorrq_u32(vandq_u32(s, RgbMask), vshlq_n_u32(a, 24));
+      r = vbslq_u32(FgOpaque, s, r);
+      r = vbslq_u32(FgTransparent, vbicq_u32(d, BgTransparent), r);
+      if (vminvq_u32(Simple))
+         vst1q_u32(Dst + i, r);
+      else {
+         tColor t[4];
+         uint32_t m[4];
+         vst1q_u32(t, r);
+         vst1q_u32(m, Simple);
+         for (int j = 0; j < 4; j++) {
+             if (!m[j])
+                t[j] = AlphaBlend(Src[i + j], Dst[i + j], AlphaLayer);
+             }
+         memcpy(Dst + i, t, sizeof(t));
+         }
+      }
+#endif
+  for (; i < Count; i++)
+      Dst[i] = AlphaBlend(Src[i], Dst[i], AlphaLayer);
+}
+
+// Expands Count palette indexes from Src into Dst, using the colors in Table. If
+// Overlay is true, pixels with index 0 leave Dst unchanged. Subtitle bitmaps
+// consist mostly of such pixels, so where SIMD instructions are available, runs
+// of 16 of them are skipped at once, and the others are merged with a mask:
+static void ExpandIndexRow(tColor *Dst, const tIndex *Src, int Count, const tColor *Table, bool Overlay)
+{
+  int i = 0;
+  if (Overlay) {
+#if defined(__SSE2__)
+     const __m128i Zero = _mm_setzero_si128();
+     for (; i + 16 <= Count; i += 16) {
+         __m128i t8 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(Src + i)), Zero);
+         if (_mm_movemask_epi8(t8) == 0xFFFF)
+            continue;
+         __m128i t16[2] = { _mm_unpacklo_epi8(t8, t8), _mm_unpackhi_epi8(t8, t8) };
+         for (int k = 0; k < 4; k++) {
+             const tIndex *s = Src + i + 4 * k;
+             tColor *d = Dst + i + 4 * k;
+             __m128i Transparent = (k & 1) ? _mm_unpackhi_epi16(t16[k >> 1], t16[k >> 1]) : _mm_unpacklo_epi16(t16[k >> 1], t16[k >> 1]);
+             __m128i c = _mm_setr_epi32(Table[s[0]], Table[s[1]], Table[s[2]], Table[s[3]]);
+             __m128i o = _mm_loadu_si128((const __m128i *)d);
+             _mm_storeu_si128((__m128i *)d, _mm_or_si128(_mm_and_si128(Transparent, o), _mm_andnot_si128(Transparent, c)));
+             }
+         }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+     for (; i + 16 <= Count; i += 16) {
+         uint8x16_t t8 = vceqzq_u8(vld1q_u8(Src + i));
+         if (vminvq_u8(t8))
+            continue;
+         uint8x16_t t16[2] = { vzip1q_u8(t8, t8), vzip2q_u8(t8, t8) };
+         for (int k = 0; k < 4; k++) {
+             const tIndex *s = Src + i + 4 * k;
+             tColor *d = Dst + i + 4 * k;
+             uint16x8_t h = vreinterpretq_u16_u8(t16[k >> 1]);
+             uint32x4_t Transparent = vreinterpretq_u32_u16((k & 1) ? vzip2q_u16(h, h) : vzip1q_u16(h, h));
+             const tColor c[4] = { Table[s[0]], Table[s[1]], Table[s[2]], Table[s[3]] };
+             vst1q_u32(d, vbslq_u32(Transparent, vld1q_u32(d), vld1q_u32(c)));
+             }
+         }
+#endif
+     for (; i < Count; i++) {
+         if (Src[i])
+            Dst[i] = Table[Src[i]];
+         }
+     }
+  else {
+     for (; i < Count; i++)
+         Dst[i] = Table[Src[i]];
+     }
+}
+
 // --- cPalette --------------------------------------------------------------
 
 cPalette::cPalette(int Bpp)
 {
+  generation = 1;
+  memset(indexCache, 0, sizeof(indexCache)); // generation 0 is never valid
   SetBpp(Bpp);
   SetAntiAliasGranularity(10, 10);
 }
@@ -139,27 +284,42 @@ void cPalette::Reset(void)
 {
   numColors = 0;
   modified = false;
+  generation++;
 }
 
 int cPalette::Index(tColor Color)
 {
+  // The result only depends on the current colors, so it can be cached
+  // (drawing anti-aliased text or scaled bitmaps requests the same few
+  // colors over and over again):
+  tIndexCache &c = indexCache[(Color * 2654435769u) >> 24 & (PALETTECACHESIZE - 1)];
+  if (c.generation == generation && c.color == Color)
+     return c.index;
+  int i = -1;
   // Check if color is already defined:
-  for (int i = 0; i < numColors; i++) {
-      if (color[i] == Color)
-         return i;
+  for (int n = 0; n < numColors; n++) {
+      if (color[n] == Color) {
+         i = n;
+         break;
+         }
       }
   // No exact color, try a close one:
-  int i = ClosestColor(Color, 4);
-  if (i >= 0)
-     return i;
+  if (i < 0)
+     i = ClosestColor(Color, 4);
   // No close one, try to define a new one:
-  if (numColors < maxColors) {
+  if (i < 0 && numColors < maxColors) {
      color[numColors++] = Color;
      modified = true;
-     return numColors - 1;
+     generation++;
+     i = numColors - 1;
      }
   // Out of colors, so any close color must do:
-  return ClosestColor(Color);
+  if (i < 0)
+     i = ClosestColor(Color);
+  c.color = Color;
+  c.generation = generation;
+  c.index = i;
+  return i;
 }
 
 void cPalette::SetBpp(int Bpp)
@@ -175,9 +335,12 @@ void cPalette::SetColor(int Index, tColor Color)
      if (numColors <= Index) {
         numColors = Index + 1;
         modified = true;
+        generation++;
+        }
+     else if (color[Index] != Color) {
+        modified = true;
+        generation++;
         }
-     else
-        modified |= color[Index] != Color;
      color[Index] = Color;
      }
 }
@@ -210,6 +373,7 @@ void cPalette::Replace(const cPalette &Palette)
   for (int i = 0; i < Palette.numColors; i++)
       SetColor(i, Palette.color[i]);
   numColors = Palette.numColors;
+  generation++;
   antiAliasGranularity = Palette.antiAliasGranularity;
 }
 
@@ -512,6 +676,26 @@ void cBitmap::SetIndex(int x, int y, tIndex Index)
      }
 }
 
+void cBitmap::SetIndexes(int x, int y, tIndex Index, int Count)
+{
+  if (bitmap && 0 <= y && y < height) {
+     int x1 = max(x, 0);
+     int x2 = min(x + Count, width) - 1;
+     tIndex *p = bitmap + width * y;
+     while (x1 <= x2 && p[x1] == Index)
+           x1++;
+     while (x2 >= x1 && p[x2] == Index)
+           x2--;
+     if (x1 <= x2) {
+        memset(p + x1, Index, x2 - x1 + 1);
+        if (dirtyX1 > x1)  dirtyX1 = x1;
+        if (dirtyY1 > y)   dirtyY1 = y;
+        if (dirtyX2 < x2)  dirtyX2 = x2;
+        if (dirtyY2 < y)   dirtyY2 = y;
+        }
+     }
+}
+
 void cBitmap::Fill(tIndex Index)
 {
   if (bitmap) {
@@ -964,6 +1148,7 @@ cPixmap::cPixmap(void)
   layer = -1;
   alpha = ALPHA_OPAQUE;
   tile = false;
+  numDirtyRects = 0;
 }
 
 cPixmap::cPixmap(int Layer, const cRect &ViewPort, const cRect &DrawPort)
@@ -982,18 +1167,72 @@ cPixmap::cPixmap(int Layer, const cRect &ViewPort, const cRect &DrawPort)
      }
   alpha = ALPHA_OPAQUE;
   tile = false;
+  numDirtyRects = 0;
+}
+
+static inline int Area(const cRect &Rect)
+{
+  return Rect.Width() * Rect.Height();
+}
+
+void cPixmap::AddDirtyRect(cRect Rect)
+{
+  for (int i = 0; i < numDirtyRects; i++) {
+      if (dirtyRects[i].Contains(Rect))
+         return; // the most frequent case when drawing pixel by pixel
+      }
+  // Rectangles are merged if they overlap, or if that doesn't waste much space:
+  for (int i = 0; i < numDirtyRects; ) {
+      cRect r = Rect.Combined(dirtyRects[i]);
+      if (Rect.Intersects(dirtyRects[i]) || Area(r) <= 2 * (Area(Rect) + Area(dirtyRects[i]))) {
+         Rect = r;
+         RemoveDirtyRect(i);
+         i = 0; // the combined rectangle may now touch one that has already been checked
+         }
+      else
+         i++;
+      }
+  if (numDirtyRects >= MAXDIRTYRECTS) {
+     // merge with the rectangle that grows the least:
+     int Best = 0;
+     int BestGrowth = INT_MAX;
+     for (int i = 0; i < numDirtyRects; i++) {
+         int Growth = Area(Rect.Combined(dirtyRects[i])) - Area(dirtyRects[i]);
+         if (Growth < BestGrowth) {
+            Best = i;
+            BestGrowth = Growth;
+            }
+         }
+     Rect.Combine(dirtyRects[Best]);
+     RemoveDirtyRect(Best);
+     AddDirtyRect(Rect);
+     return;
+     }
+  dirtyRects[numDirtyRects++] = Rect;
+}
+
+void cPixmap::RemoveDirtyRect(int Index)
+{
+  dirtyRects[Index] = dirtyRects[--numDirtyRects];
 }
 
 void cPixmap::MarkViewPortDirty(const cRect &Rect)
 {
-  if (layer >= 0)
-     dirtyViewPort.Combine(Rect.Intersected(viewPort));
+  if (layer >= 0) {
+     cRect r = Rect.Intersected(viewPort);
+     if (!r.IsEmpty()) {
+        dirtyViewPort.Combine(r);
+        AddDirtyRect(r);
+        }
+     }
 }
 
 void cPixmap::MarkViewPortDirty(const cPoint &Point)
 {
-  if (layer >= 0 && viewPort.Contains(Point))
+  if (layer >= 0 && viewPort.Contains(Point)) {
      dirtyViewPort.Combine(Point);
+     AddDirtyRect(cRect(Point.X(), Point.Y(), 1, 1));
+     }
 }
 
 void cPixmap::MarkDrawPortDirty(const cRect &Rect)
@@ -1019,6 +1258,7 @@ void cPixmap::MarkDrawPortDirty(const cPoint &Point)
 void cPixmap::SetClean(void)
 {
   dirtyViewPort = dirtyDrawPort = cRect();
+  numDirtyRects = 0;
 }
 
 void cPixmap::SetLayer(int Layer)
@@ -1147,14 +1387,64 @@ cImage *cImage::Scaled(double FactorX, double FactorY, bool AntiAlias) const
   int RatioX = (Width() << 16) / i->Width();
   int RatioY = (Height() << 16) / i->Height();
 
-  if (!AntiAlias || FactorX <= 1.0 && FactorY <= 1.0) {
-     // Downscaling - no anti-aliasing:
+  if (AntiAlias && FactorX <= 1.0 && FactorY <= 1.0) {
+     // Downscaling - anti-aliasing:
+     // Each target pixel is the average of the source pixels it covers (a box filter),
+     // weighted by their alpha values, so that fully transparent pixels don't darken
+     // the colors. The sums of each row of target pixels are collected source row by
+     // source row, which keeps the memory access sequential.
+     int *x0 = MALLOC(int, w + 1);
+     for (int x = 0; x <= w; x++)
+         x0[x] = x * Width() / w;
+     uint64_t *Sums = MALLOC(uint64_t, 4 * w);
+     tColor *t = i->data;
+     for (int y = 0; y < h; y++) {
+         int y0 = y * Height() / h;
+         int y1 = max(y0 + 1, (y + 1) * Height() / h);
+         memset(Sums, 0, 4 * w * sizeof(uint64_t));
+         for (int sy = y0; sy < y1; sy++) {
+             const tColor *p = data + sy * Width();
+             uint64_t *Sum = Sums;
+             for (int x = 0; x < w; x++) {
+                 uint32_t A = 0, R = 0, G = 0, B = 0;
+                 for (int sx = x0[x], sx1 = max(sx + 1, x0[x + 1]); sx < sx1; sx++) {
+                     tColor c = p[sx];
+                     uint32_t a = c >> 24;
+                     A += a;
+                     R += ((c >> 16) & 0xFF) * a;
+                     G += ((c >>  8) & 0xFF) * a;
+                     B += ( c        & 0xFF) * a;
+                     }
+                 Sum[0] += A;
+                 Sum[1] += R;
+                 Sum[2] += G;
+                 Sum[3] += B;
+                 Sum += 4;
+                 }
+             }
+         const uint64_t *Sum = Sums;
+         for (int x = 0; x < w; x++) {
+             uint64_t n = uint64_t(max(1, x0[x + 1] - x0[x])) * (y1 - y0);
+             uint64_t A = Sum[0];
+             if (A)
+                *t++ = tColor((A + n / 2) / n) << 24 | tColor((Sum[1] + A / 2) / A) << 16 | tColor((Sum[2] + A / 2) / A) << 8 | tColor((Sum[3] + A / 2) / A);
+             else
+                *t++ = clrTransparent;
+             Sum += 4;
+             }
+         }
+     free(Sums);
+     free(x0);
+     }
+  else if (!AntiAlias || FactorX <= 1.0 && FactorY <= 1.0) {
+     // No anti-aliasing:
+     tColor *t = i->data;
      int SourceY = 0;
      for (int y = 0; y < i->Height(); y++) {
+         const tColor *p = data + (SourceY >> 16) * Width();
          int SourceX = 0;
          for (int x = 0; x < i->Width(); x++) {
-             tColor c1 = GetPixel(cPoint(SourceX >> 16, SourceY >> 16));
-             i->SetPixel(cPoint(x, y), c1);
+             *t++ = p[SourceX >> 16];
              SourceX += RatioX;
              }
          SourceY += RatioY;
@@ -1162,28 +1452,60 @@ cImage *cImage::Scaled(double FactorX, double FactorY, bool AntiAlias) const
      }
   else {
      // Upscaling - anti-aliasing:
+     // Bilinear interpolation, done separately for both directions. Since neighboring
+     // target rows mostly use the same source rows, the horizontally interpolated
+     // source rows are kept and only calculated once.
+     int *SourceXs = MALLOC(int, w);
+     uint8_t *BlendXs = MALLOC(uint8_t, w);
+     int SourceX = 0;
+     for (int x = 0; x < w; x++) {
+         SourceXs[x] = max(0, min(SourceX >> 16, Width() - 2));
+         BlendXs[x] = 0xFF - ((SourceX >> 8) & 0xFF);
+         SourceX += RatioX;
+         }
+     int dx = Width() > 1 ? 1 : 0;
+     tColor *Rows[2] = { MALLOC(tColor, w), MALLOC(tColor, w) };
+     int RowY[2] = { -1, -1 };
+     tColor *t = i->data;
      int SourceY = 0;
-     for (int y = 0; y < i->Height(); y++) {
-         int SourceX = 0;
-         int sy = min(SourceY >> 16, Height() - 2);
+     for (int y = 0; y < h; y++) {
+         int sy = max(0, min(SourceY >> 16, Height() - 2));
          uint8_t BlendY = 0xFF - ((SourceY >> 8) & 0xFF);
-         for (int x = 0; x < i->Width(); x++) {
-             int sx = min(SourceX >> 16, Width() - 2);
-             uint8_t BlendX = 0xFF - ((SourceX >> 8) & 0xFF);
-             tColor c1 = AlphaBlend(GetPixel(cPoint(sx, sy)),     GetPixel(cPoint(sx + 1, sy)),     BlendX);
-             tColor c2 = AlphaBlend(GetPixel(cPoint(sx, sy + 1)), GetPixel(cPoint(sx + 1, sy + 1)), BlendX);
-             tColor c3 = AlphaBlend(c1, c2, BlendY);
-             i->SetPixel(cPoint(x, y), c3);
-             SourceX += RatioX;
+         for (int r = 0; r < 2; r++) {
+             int ry = min(sy + r, Height() - 1);
+             if (RowY[r] != ry) {
+                if (RowY[1 - r] == ry) {
+                   // the row has already been interpolated (happens when moving on to the next source row)
+                   tColor *Row = Rows[r];
+                   Rows[r] = Rows[1 - r];
+                   Rows[1 - r] = Row;
+                   RowY[1 - r] = RowY[r];
+                   }
+                else {
+                   const tColor *p = data + ry * Width();
+                   tColor *Row = Rows[r];
+                   for (int x = 0; x < w; x++)
+                       Row[x] = AlphaBlend(p[SourceXs[x]], p[SourceXs[x] + dx], BlendXs[x]);
+                   }
+                RowY[r] = ry;
+                }
              }
+         for (int x = 0; x < w; x++)
+             *t++ = AlphaBlend(Rows[0][x], Rows[1][x], BlendY);
          SourceY += RatioY;
          }
+     free(Rows[0]);
+     free(Rows[1]);
+     free(BlendXs);
+     free(SourceXs);
      }
   return i;
 }
 
 // --- cPixmapMemory ---------------------------------------------------------
 
+uint64_t cPixmapMemory::pixelsBlended = 0;
+
 cPixmapMemory::cPixmapMemory(void)
 {
   data = NULL;
@@ -1317,8 +1639,8 @@ void cPixmapMemory::DrawScaledImage(const cPoint &Point, const cImage &Image, do
 void cPixmapMemory::DrawScaledImage(const cPoint &Point, int ImageHandle, double FactorX, double FactorY, bool AntiAlias)
 {
   Lock();
-  if (const cImage *Image = cOsdProvider::GetImageData(ImageHandle))
-     DrawScaledImage(Point, *Image, FactorX, FactorY, AntiAlias);
+  if (const cImage *Image = cOsdProvider::GetScaledImageData(ImageHandle, FactorX, FactorY, AntiAlias))
+     DrawImage(Point, *Image);
   Unlock();
 }
 
@@ -1327,8 +1649,10 @@ void cPixmapMemory::DrawPixel(const cPoint &Point, tColor Color)
   Lock();
   if (DrawPort().Size().Contains(Point)) {
      int p = Point.Y() * DrawPort().Width() + Point.X();
-     if (Layer() == 0 && !IS_OPAQUE(Color))
+     if (Layer() == 0 && !IS_OPAQUE(Color)) {
         data[p] = AlphaBlend(Color, data[p]);
+        pixelsBlended++;
+        }
      else
         data[p] = Color;
      MarkDrawPortDirty(Point);
@@ -1346,6 +1670,7 @@ void cPixmapMemory::DrawBlendedPixel(const cPoint &Point, tColor Color, uint8_t
            data[p] = (data[p] & 0x00FFFFFF) | ((((data[p] >> 24) * (255 - Alpha)) << 16) & 0xFF000000);
         else
            data[p] = AlphaBlend(Color, data[p], Alpha);
+        pixelsBlended++;
         }
      else
         data[p] = Color;
@@ -1359,21 +1684,20 @@ void cPixmapMemory::DrawBitmap(const cPoint &Point, const cBitmap &Bitmap, tColo
   Lock();
   cRect r = cRect(Point, cSize(Bitmap.Width(), Bitmap.Height())).Intersected(DrawPort().Size());
   if (!r.IsEmpty()) {
-     bool UseColors = ColorFg || ColorBg;
+     tColor Table[MAXNUMCOLORS];
+     if (ColorFg || ColorBg) {
+        Table[0] = ColorBg;
+        for (int i = 1; i < MAXNUMCOLORS; i++)
+            Table[i] = ColorFg;
+        }
+     else {
+        for (int i = 0; i < MAXNUMCOLORS; i++)
+            Table[i] = Bitmap.Color(i);
+        }
      int wd = DrawPort().Width();
      tColor *pd = data + wd * r.Top() + r.Left();
      for (int y = r.Top(); y <= r.Bottom(); y++) {
-         tColor *cd = pd;
-         for (int x = r.Left(); x <= r.Right(); x++) {
-             tIndex Index = *Bitmap.Data(x - Point.X(), y - Point.Y());
-             if (Index || !Overlay) {
-                if (UseColors)
-                   *cd = Index ? ColorFg : ColorBg;
-                else
-                   *cd = Bitmap.Color(Index);
-                }
-             cd++;
-             }
+         ExpandIndexRow(pd, Bitmap.Data(r.Left() - Point.X(), y - Point.Y()), r.Width(), Table, Overlay);
          pd += wd;
          }
      MarkDrawPortDirty(r);
@@ -1798,16 +2122,11 @@ void cPixmapMemory::Render(const cPixmap *Pixmap, const cRect &Source, const cPo
               const tColor *ps = pm->data + ws * s.Top() + s.Left();
               tColor *pd = data + wd * d.Top() + d.Left();
               for (int y = d.Height(); y-- > 0; ) {
-                  const tColor *cs = ps;
-                  tColor *cd = pd;
-                  for (int x = d.Width(); x-- > 0; ) {
-                      *cd = AlphaBlend(*cs, *cd, a);
-                      cs++;
-                      cd++;
-                      }
+                  AlphaBlendRow(pd, ps, d.Width(), a);
                   ps += ws;
                   pd += wd;
                   }
+              pixelsBlended += d.Width() * d.Height();
               MarkDrawPortDirty(d);
               }
            }
@@ -1886,6 +2205,65 @@ void cPixmapMemory::Pan(const cPoint &Dest, const cRect &Source)
   Unlock();
 }
 
+// --- cOsdFlushThread -------------------------------------------------------
+
+class cOsdFlushThread : public cThread {
+private:
+  cOsd *osd;
+  cMutex mutex;
+  cCondVar condVar;
+  bool pending;
+  tThreadId threadId;
+protected:
+  virtual void Action(void) override;
+public:
+  cOsdFlushThread(cOsd *Osd);
+  virtual ~cOsdFlushThread() override;
+  bool IsFlushThread(void) const { return threadId == cThread::ThreadId(); }
+  void Trigger(void);
+  };
+
+cOsdFlushThread::cOsdFlushThread(cOsd *Osd)
+:cThread("osd flush")
+{
+  osd = Osd;
+  pending = false;
+  threadId = 0;
+}
+
+cOsdFlushThread::~cOsdFlushThread()
+{
+  Cancel(-1);
+  mutex.Lock();
+  condVar.Broadcast();
+  mutex.Unlock();
+  Cancel(3);
+}
+
+void cOsdFlushThread::Trigger(void)
+{
+  cMutexLock MutexLock(&mutex);
+  pending = true;
+  condVar.Broadcast();
+}
+
+void cOsdFlushThread::Action(void)
+{
+  threadId = cThread::ThreadId();
+  cMutexLock MutexLock(&mutex);
+  while (Running()) {
+        if (pending) {
+           pending = false;
+           mutex.Unlock();
+           VDR_TRACE(osd_flush, osd);
+           osd->Flush();
+           mutex.Lock();
+           }
+        else
+           condVar.TimedWait(mutex, 1000);
+        }
+}
+
 // --- cOsd ------------------------------------------------------------------
 
 static const char *OsdErrorTexts[] = {
@@ -1920,6 +2298,7 @@ cOsd::cOsd(int Left, int Top, uint Level)
   width = height = 0;
   level = Level;
   active = false;
+  flushThread = NULL;
   for (int i = 0; i < Osds.Size(); i++) {
       if (Osds[i]->level > level) {
          Osds.Insert(this, i);
@@ -1931,6 +2310,10 @@ cOsd::cOsd(int Left, int Top, uint Level)
 
 cOsd::~cOsd()
 {
+  if (flushThread) {
+     esyslog("ERROR: asynchronous flushing still active while deleting OSD");
+     DELETENULL(flushThread);
+     }
   cMutexLock MutexLock(&mutex);
   for (int i = 0; i < numBitmaps; i++)
       delete bitmaps[i];
@@ -2021,17 +2404,33 @@ cPixmap *cOsd::RenderPixmaps(void)
   cPixmap *Pixmap = NULL;
   if (isTrueColor) {
      LOCK_PIXMAPS;
-     // Collect overlapping dirty rectangles:
+     // Collect overlapping dirty rectangles (any others are handled by the next call):
      cRect d;
-     for (int i = 0; i < pixmaps.Size(); i++) {
-         if (cPixmap *pm = pixmaps[i]) {
-            if (!pm->DirtyViewPort().IsEmpty()) {
-               if (d.IsEmpty() || d.Intersects(pm->DirtyViewPort())) {
-                  d.Combine(pm->DirtyViewPort());
-                  pm->SetClean();
-                  }
-               }
-            }
+     for (bool Combined = true; Combined; ) {
+         Combined = false;
+         for (int i = 0; i < pixmaps.Size(); i++) {
+             if (cPixmap *pm = pixmaps[i]) {
+                bool Removed = false;
+                for (int j = 0; j < pm->numDirtyRects; ) {
+                    if (d.IsEmpty() || d.Intersects(pm->dirtyRects[j])) {
+                       d.Combine(pm->dirtyRects[j]);
+                       pm->RemoveDirtyRect(j);
+                       Removed = Combined = true; // d may now intersect rectangles that have already been checked
+                       }
+                    else
+                       j++;
+                    }
+                if (Removed) {
+                   if (pm->numDirtyRects) {
+                      pm->dirtyViewPort = cRect();
+                      for (int j = 0; j < pm->numDirtyRects; j++)
+                          pm->dirtyViewPort.Combine(pm->dirtyRects[j]);
+                      }
+                   else
+                      pm->SetClean();
+                   }
+                }
+             }
          }
      if (!d.IsEmpty()) {
 //#define DebugDirty
@@ -2061,6 +2460,7 @@ cPixmap *cOsd::RenderPixmaps(void)
            DirtyIndicatorIndex = 1 - DirtyIndicatorIndex;
            Pixmap->Render(&DirtyIndicator, DirtyIndicator.DrawPort(), DirtyIndicator.ViewPort().Point().Shifted(-Pixmap->ViewPort().Point()));
 #endif
+           VDR_TRACE(osd_render, this, d.X(), d.Y(), d.Width(), d.Height());
            }
         }
      }
@@ -2267,6 +2667,41 @@ void cOsd::Flush(void)
 {
 }
 
+void cOsd::SetAsyncFlush(bool On)
+{
+  if (On) {
+     if (!flushThread) {
+        flushThread = new cOsdFlushThread(this);
+        flushThread->Start();
+        }
+     }
+  else
+     DELETENULL(flushThread);
+}
+
+bool cOsd::FlushAsync(void)
+{
+  if (flushThread && isTrueColor && !flushThread->IsFlushThread()) {
+     flushThread->Trigger();
+     return true;
+     }
+  return false;
+}
+
+// --- cImageCacheBudget -----------------------------------------------------
+
+class cImageCacheBudget : public cMemoryClient {
+protected:
+  virtual void Resize(size_t Size) override
+  {
+    LOCK_PIXMAPS;
+    cOsdProvider::imageCacheMax = Size;
+    cOsdProvider::TrimImageCache();
+  }
+public:
+  cImageCacheBudget(size_t Size) : cMemoryClient("Image cache", mpCache, 0, Size, Size, true) {}
+  };
+
 // --- cOsdProvider ----------------------------------------------------------
 
 cOsdProvider *cOsdProvider::osdProvider = NULL;
@@ -2274,12 +2709,24 @@ int cOsdProvider::oldWidth = 0;
 int cOsdProvider::oldHeight = 0;
 double cOsdProvider::oldAspect = 1.0;
 cImage *cOsdProvider::images[MAXOSDIMAGES] = { NULL };
+cImage *cOsdProvider::scaledImages[MAXOSDIMAGES] = { NULL };
+bool cOsdProvider::scaledAntiAlias[MAXOSDIMAGES] = { false };
+cList<cImageCacheEntry> cOsdProvider::imageCache;
+size_t cOsdProvider::imageCacheUsed = 0;
+size_t cOsdProvider::imageCacheMax = size_t(IMAGECACHESIZE) * MEGABYTE(1);
+cImageCacheBudget *cOsdProvider::imageCacheBudget = NULL;
 int cOsdProvider::osdState = 0;
 
 cOsdProvider::cOsdProvider(void)
 {
   delete osdProvider;
   osdProvider = this;
+  if (!imageCacheBudget) {
+     imageCacheBudget = new cImageCacheBudget(imageCacheMax);
+     LOCK_PIXMAPS;
+     imageCacheMax = imageCacheBudget->Size();
+     TrimImageCache();
+     }
 }
 
 cOsdProvider::~cOsdProvider()
@@ -2290,6 +2737,11 @@ cOsdProvider::~cOsdProvider()
 cOsd *cOsdProvider::NewOsd(int Left, int Top, uint Level)
 {
   cMutexLock MutexLock(&cOsd::mutex);
+  static bool FirstOsd = true;
+  if (FirstOsd) {
+     cStartupTimes::Mark("first OSD");
+     FirstOsd = false;
+     }
   if (Level == OSD_LEVEL_DEFAULT && cOsd::IsOpen())
      esyslog("ERROR: attempt to open OSD while it is already open - using dummy OSD!");
   else if (osdProvider) {
@@ -2370,6 +2822,7 @@ void cOsdProvider::DropImageData(int ImageHandle)
   if (0 < ImageHandle && ImageHandle < MAXOSDIMAGES) {
      delete images[ImageHandle];
      images[ImageHandle] = NULL;
+     DELETENULL(scaledImages[ImageHandle]);
      }
 }
 
@@ -2381,6 +2834,23 @@ const cImage *cOsdProvider::GetImageData(int ImageHandle)
   return NULL;
 }
 
+const cImage *cOsdProvider::GetScaledImageData(int ImageHandle, double FactorX, double FactorY, bool AntiAlias)
+{
+  LOCK_PIXMAPS;
+  const cImage *Image = GetImageData(ImageHandle);
+  if (Image && (!DoubleEqual(FactorX, 1.0) || !DoubleEqual(FactorY, 1.0))) {
+     cImage *&Scaled = scaledImages[ImageHandle];
+     cSize Size(max(1, int(round(Image->Width() * FactorX))), max(1, int(round(Image->Height() * FactorY)))); // the same as in cImage::Scaled()
+     if (!Scaled || Scaled->Size() != Size || scaledAntiAlias[ImageHandle] != AntiAlias) {
+        delete Scaled;
+        Scaled = Image->Scaled(FactorX, FactorY, AntiAlias);
+        scaledAntiAlias[ImageHandle] = AntiAlias;
+        }
+     return Scaled;
+     }
+  return Image;
+}
+
 int cOsdProvider::StoreImage(const cImage &Image)
 {
   if (osdProvider)
@@ -2394,10 +2864,105 @@ void cOsdProvider::DropImage(int ImageHandle)
      osdProvider->DropImageData(ImageHandle);
 }
 
+// The image cache keeps the most recently used images at the beginning of the list:
+
+class cImageCacheEntry : public cListObject {
+private:
+  cString name;
+  cImage *image;
+  bool original;
+public:
+  cImageCacheEntry(const char *Name, cImage *Image, bool Original) { name = Name; image = Image; original = Original; }
+  virtual ~cImageCacheEntry() override { delete image; }
+  const char *Name(void) const { return name; }
+  const cImage *Image(void) const { return image; }
+  bool Original(void) const { return original; }
+  size_t Bytes(void) const { return size_t(image->Width()) * image->Height() * sizeof(tColor); }
+  };
+
+void cOsdProvider::DelCachedImage(cImageCacheEntry *Entry)
+{
+  imageCacheUsed -= Entry->Bytes();
+  imageCache.Del(Entry);
+}
+
+void cOsdProvider::TrimImageCache(const cImageCacheEntry *Keep)
+{
+  while (imageCacheUsed > imageCacheMax) {
+        cImageCacheEntry *e = imageCache.Last();
+        if (!e || e == Keep)
+           break;
+        DelCachedImage(e);
+        }
+}
+
+void cOsdProvider::CacheImage(const char *Name, cImage *Image)
+{
+  LOCK_PIXMAPS;
+  for (cImageCacheEntry *e = imageCache.First(); e; ) {
+      cImageCacheEntry *Next = imageCache.Next(e);
+      if (strcmp(e->Name(), Name) == 0)
+         DelCachedImage(e);
+      e = Next;
+      }
+  cImageCacheEntry *Entry = new cImageCacheEntry(Name, Image, true);
+  imageCache.Ins(Entry);
+  imageCacheUsed += Entry->Bytes();
+  TrimImageCache(Entry);
+}
+
+const cImage *cOsdProvider::GetCachedImage(const char *Name, const cSize &Size)
+{
+  LOCK_PIXMAPS;
+  cImageCacheEntry *Original = NULL;
+  cImageCacheEntry *Entry = NULL;
+  for (cImageCacheEntry *e = imageCache.First(); e; e = imageCache.Next(e)) {
+      if (strcmp(e->Name(), Name) == 0) {
+         if (e->Original())
+            Original = e;
+         if (Size.Width() <= 0 || Size.Height() <= 0 ? e->Original() : e->Image()->Size() == Size) {
+            Entry = e;
+            break;
+            }
+         }
+      }
+  if (!Entry) {
+     if (!Original)
+        return NULL;
+     cImage *Image = Original->Image()->Scaled(double(Size.Width()) / Original->Image()->Width(), double(Size.Height()) / Original->Image()->Height(), true);
+     Entry = new cImageCacheEntry(Name, Image, false);
+     imageCache.Ins(Entry);
+     imageCacheUsed += Entry->Bytes();
+     if (Original != imageCache.First()) // the original is just as recently used as its scaled version
+        imageCache.Move(Original, imageCache.Next(Entry));
+     }
+  else if (Entry != imageCache.First())
+     imageCache.Move(Entry, imageCache.First());
+  TrimImageCache(Entry);
+  return Entry->Image();
+}
+
+void cOsdProvider::SetImageCacheSize(int MegaBytes)
+{
+  size_t Size = size_t(max(0, MegaBytes)) * MEGABYTE(1);
+  if (imageCacheBudget)
+     imageCacheBudget->SetLimits(0, Size, Size); // calls Resize() if necessary, so we must not hold the pixmap lock here
+  else {
+     LOCK_PIXMAPS;
+     imageCacheMax = Size;
+     TrimImageCache();
+     }
+}
+
 void cOsdProvider::Shutdown(void)
 {
   delete osdProvider;
   osdProvider = NULL;
+  delete imageCacheBudget;
+  imageCacheBudget = NULL;
+  LOCK_PIXMAPS;
+  imageCache.Clear();
+  imageCacheUsed = 0;
 }
 
 // --- cTextScroller ---------------------------------------------------------
@@ -85,13 +85,22 @@ tColor HsvToColor(double H, double S, double V);
 
 tColor AlphaBlend(tColor ColorFg, tColor ColorBg, uint8_t AlphaLayer = ALPHA_OPAQUE);
 
+#define PALETTECACHESIZE 256 // must be a power of 2
+
 class cPalette {
 private:
+  struct tIndexCache {
+    tColor color;
+    uint generation;
+    tIndex index;
+    };
   tColor color[MAXNUMCOLORS];
   int bpp;
   int maxColors, numColors;
   bool modified;
   double antiAliasGranularity;
+  uint generation; ///< Incremented whenever the colors of this palette change.
+  tIndexCache indexCache[PALETTECACHESIZE]; ///< Results of Index(), only valid for the current generation.
 protected:
   typedef tIndex tIndexes[MAXNUMCOLORS];
 public:
@@ -223,6 +232,10 @@ public:
   void SetIndex(int x, int y, tIndex Index);
        ///< Sets the index at the given coordinates to Index.
        ///< Coordinates are relative to the bitmap's origin.
+  void SetIndexes(int x, int y, tIndex Index, int Count);
+       ///< Sets Count indexes, starting at the given coordinates and going to
+       ///< the right, to Index. This is the same as calling SetIndex() for each
+       ///< of these pixels, but much faster.
   void Fill(tIndex Index);
        ///< Fills the bitmap data with the given Index.
   void DrawPixel(int x, int y, tColor Color);
@@ -449,12 +462,14 @@ public:
        ///< Fills the image data with the given Color.
   cImage *Scaled(double FactorX, double FactorY, bool AntiAlias = false) const;
        ///< Creates a copy of this image, scaled by the given factors.
-       ///< If AntiAlias is true and either of the factors is greater than 1.0,
-       ///< anti-aliasing is applied.
+       ///< If AntiAlias is true, anti-aliasing is applied, by averaging the
+       ///< covered source pixels when both factors are less than or equal to 1.0,
+       ///< and by bilinear interpolation otherwise.
        ///< The caller must delete the returned image once it is no longer used.
   };
 
 #define MAXPIXMAPLAYERS    8
+#define MAXDIRTYRECTS      8 // the maximum number of separate dirty rectangles per pixmap
 
 class cPixmap {
   friend class cOsd;
@@ -468,11 +483,16 @@ private:
   cRect drawPort;
   cRect dirtyViewPort;
   cRect dirtyDrawPort;
+  cRect dirtyRects[MAXDIRTYRECTS];
+  int numDirtyRects;
+  void AddDirtyRect(cRect Rect);
+  void RemoveDirtyRect(int Index);
 protected:
   virtual ~cPixmap() {}
   void MarkViewPortDirty(const cRect &Rect);
        ///< Marks the given rectangle of the view port of this pixmap as dirty.
-       ///< Rect is combined with the existing dirtyViewPort rectangle.
+       ///< Rect is combined with the existing dirtyViewPort rectangle, and added
+       ///< to the list of dirty rectangles (see DirtyRect()).
        ///< The coordinates of Rect are given in absolute OSD values.
   void MarkViewPortDirty(const cPoint &Point);
        ///< Marks the given point of the view port of this pixmap as dirty.
@@ -556,6 +576,17 @@ public:
        ///< relative to the OSD's origin.
        ///< Since this function returns a reference to a data member, the caller must
        ///< use Lock()/Unlock() to make sure the data doesn't change while it is used.
+  int NumDirtyRects(void) const { return numDirtyRects; }
+       ///< Returns the number of separate rectangles that make up the "dirty" area
+       ///< of this pixmap on the OSD (see DirtyRect()).
+  const cRect &DirtyRect(int Index) const { return dirtyRects[Index]; }
+       ///< Returns the dirty rectangle with the given Index, which must be in the
+       ///< range 0..NumDirtyRects() - 1. These rectangles don't overlap each other
+       ///< and all lie within DirtyViewPort(), but unlike DirtyViewPort() they don't
+       ///< cover the space between areas that have been modified far apart from each
+       ///< other. The rectangles are relative to the OSD's origin.
+       ///< Since this function returns a reference to a data member, the caller must
+       ///< use Lock()/Unlock() to make sure the data doesn't change while it is used.
   const cRect &DirtyDrawPort(void) const { return dirtyDrawPort; }
        ///< Returns the "dirty" rectangle in the draw port of this this pixmap. This is
        ///< the surrounding rectangle around all pixels that have been modified since the
@@ -713,11 +744,16 @@ class cPixmapMemory : public cPixmap {
 private:
   tColor *data;
   bool panning;
+  static uint64_t pixelsBlended;
 public:
   cPixmapMemory(void);
   cPixmapMemory(int Layer, const cRect &ViewPort, const cRect &DrawPort = cRect::Null);
   virtual ~cPixmapMemory() override;
   const uint8_t *Data(void) { return (uint8_t *)data; }
+  static uint64_t PixelsBlended(void) { return pixelsBlended; }
+       ///< Returns the total number of pixels that have been alpha blended onto
+       ///< any pixmap so far, by Render() as well as by DrawPixel() and
+       ///< DrawBlendedPixel() (for benchmarking OSD rendering).
   virtual void Clear(void) override;
   virtual void Fill(tColor Color) override;
   virtual void DrawImage(const cPoint &Point, const cImage &Image) override;
@@ -750,6 +786,8 @@ public:
 /// in order to verify proper operation. The plugin that implements the OSD
 /// shall offer a configuration switch in its setup.
 
+class cOsdFlushThread;
+
 class cOsd {
   friend class cOsdProvider;
 private:
@@ -766,6 +804,7 @@ private:
   int left, top, width, height;
   uint level;
   bool active;
+  cOsdFlushThread *flushThread;
 protected:
   cOsd(int Left, int Top, uint Level);
        ///< Initializes the OSD with the given coordinates.
@@ -822,6 +861,32 @@ protected:
        ///< in order to preset the bitmap's palette won't crash.
        ///< Use of this function outside of derived classes is deprecated and it
        ///< may be made 'protected' in a future version.
+  void SetAsyncFlush(bool On);
+       ///< Turns asynchronous flushing on or off. If it is on, Flush() only hands the
+       ///< current state of the pixmaps over to a separate thread, which does the actual
+       ///< rendering and transfer to the output device. Several calls to Flush() that
+       ///< happen while that thread is busy result in only one more flush operation.
+       ///< This way the main thread (and thus remote control input) doesn't have to
+       ///< wait for the output device during animations or large updates.
+       ///< A derived class that turns this on must also call FlushAsync() in its
+       ///< Flush() function, and must turn it off again in its destructor, before
+       ///< releasing anything its Flush() function uses.
+       ///< Asynchronous flushing only takes place on a true color OSD, since only
+       ///< drawing into pixmaps is protected by the cPixmap mutex.
+       ///< Drawing into pixmaps has to wait while the flush thread holds the lock on
+       ///< the cPixmap mutex, so in order to benefit from this, Flush() should hold that
+       ///< lock only while calling RenderPixmaps() and copying the results, not while
+       ///< transferring them to the output device.
+  bool FlushAsync(void);
+       ///< If asynchronous flushing has been turned on by a call to SetAsyncFlush(),
+       ///< a derived class must call this function at the very beginning of its
+       ///< Flush() function, and return immediately if it returns true:
+       ///<
+       ///<  if (FlushAsync())
+       ///<     return;
+       ///<
+       ///< FlushAsync() returns true if the flush operation has been handed over
+       ///< to the flush thread, which will then call Flush() again itself.
 public:
   virtual ~cOsd();
        ///< Shuts down the OSD.
@@ -994,19 +1059,33 @@ public:
        ///<
        ///< If a plugin uses a derived cPixmap implementation, it needs to use that
        ///< type instead of cPixmapMemory.
+       ///< See SetAsyncFlush() for how to do the actual flushing in a separate thread.
   };
 
 #define MAXOSDIMAGES 64
+#define IMAGECACHESIZE 32 // MB
+
+class cImageCacheEntry;
+class cImageCacheBudget;
 
 class cOsdProvider {
   friend class cPixmapMemory;
+  friend class cImageCacheBudget;
 private:
   static cOsdProvider *osdProvider;
   static int oldWidth;
   static int oldHeight;
   static double oldAspect;
   static cImage *images[MAXOSDIMAGES];
+  static cImage *scaledImages[MAXOSDIMAGES];
+  static bool scaledAntiAlias[MAXOSDIMAGES];
+  static cList<cImageCacheEntry> imageCache;
+  static size_t imageCacheUsed;
+  static size_t imageCacheMax;
+  static cImageCacheBudget *imageCacheBudget;
   static int osdState;
+  static void DelCachedImage(cImageCacheEntry *Entry);
+  static void TrimImageCache(const cImageCacheEntry *Keep = NULL);
 protected:
   virtual cOsd *CreateOsd(int Left, int Top, uint Level) = 0;
       ///< Returns a pointer to a newly created cOsd object, which will be located
@@ -1028,6 +1107,11 @@ protected:
       ///< Drops the image data referenced by ImageHandle.
   static const cImage *GetImageData(int ImageHandle);
       ///< Gets the image data referenced by ImageHandle.
+  static const cImage *GetScaledImageData(int ImageHandle, double FactorX, double FactorY, bool AntiAlias);
+      ///< Gets the image data referenced by ImageHandle, scaled by the given factors
+      ///< (see cImage::Scaled()). The most recently scaled version of each image is
+      ///< kept, so that drawing the same image in the same size over and over again
+      ///< doesn't require scaling it every time.
 public:
   cOsdProvider(void);
       //XXX maybe parameter to make this one "sticky"??? (frame-buffer etc.)
@@ -1064,6 +1148,28 @@ public:
   static void DropImage(int ImageHandle);
       ///< Drops the image referenced by the given ImageHandle. If ImageHandle
       ///< has an invalid value, nothing happens.
+  static void CacheImage(const char *Name, cImage *Image);
+      ///< Puts the given Image into the image cache, where it can be retrieved by
+      ///< skins and plugins through GetCachedImage(). Name identifies the image, and
+      ///< is typically the full path of the file it has been loaded from. The cache
+      ///< takes ownership of Image. Any image previously cached under the same Name
+      ///< is dropped (together with its scaled versions).
+  static const cImage *GetCachedImage(const char *Name, const cSize &Size = cSize(0, 0));
+      ///< Returns the image that has been cached under the given Name, scaled to
+      ///< Size (unless Size is empty, in which case the original image is returned).
+      ///< A scaled version is made from the original image (with anti-aliasing) the
+      ///< first time it is requested, and is then kept in the cache as well.
+      ///< If the least recently used images exceed the size of the cache (see
+      ///< SetImageCacheSize()), they are dropped. Therefore the result may be NULL,
+      ///< in which case the caller has to load the image again and give it to
+      ///< CacheImage().
+      ///< The caller must hold a lock on the cPixmap mutex (for instance by
+      ///< putting a LOCK_PIXMAPS into the scope of the operation) for as long as
+      ///< it uses the returned image.
+  static void SetImageCacheSize(int MegaBytes);
+      ///< Sets the maximum amount of memory used by the image cache. The default
+      ///< is IMAGECACHESIZE. The image cache is part of the global memory budget
+      ///< (see membudget.h), so it may actually be smaller.
   static void Shutdown(void);
       ///< Shuts down the OSD provider facility by deleting the current OSD provider.
   };
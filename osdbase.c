@@ -22,6 +22,7 @@ cOsdItem::cOsdItem(eOSState State)
   text = NULL;
   state = State;
   selectable = true;
+  deferred = false;
   fresh = true;
 }
 
@@ -30,6 +31,7 @@ cOsdItem::cOsdItem(const char *Text, eOSState State, bool Selectable)
   text = NULL;
   state = State;
   selectable = Selectable;
+  deferred = false;
   fresh = true;
   SetText(Text);
 }
@@ -43,6 +45,17 @@ void cOsdItem::SetText(const char *Text, bool Copy)
 {
   free(text);
   text = Copy ? strdup(Text ? Text : "") : (char *)Text; // text assumes ownership!
+  deferred = false;
+}
+
+const char *cOsdItem::Text(void) const
+{
+  if (deferred) {
+     cOsdItem *Item = const_cast<cOsdItem *>(this);
+     Item->deferred = false;
+     Item->Set();
+     }
+  return text;
 }
 
 void cOsdItem::SetSelectable(bool Selectable)
@@ -274,8 +287,9 @@ void cOsdMenu::Display(void)
   int count = Count();
   if (count > 0) {
      int ni = 0;
+     bool MsgOsdItem = conveyStatus && cStatus::HasMonitors(); // avoids setting the text of items that are not displayed
      for (cOsdItem *item = First(); item; item = Next(item)) {
-         if (conveyStatus)
+         if (MsgOsdItem)
             cStatus::MsgOsdItem(item->Text(), ni++, item->Selectable());
          if (current < 0 && item->Selectable())
             current = item->Index();
@@ -52,8 +52,16 @@ private:
   char *text;
   eOSState state;
   bool selectable;
+  bool deferred;
 protected:
   bool fresh;
+  void SetTextDeferred(void) { deferred = true; }
+       ///< Marks the text of this item as not yet set. Set() will be called to set
+       ///< the actual text when Text() is called for the first time, which is
+       ///< typically when the item becomes visible. This allows menus with thousands
+       ///< of items to be built quickly, since only the items that are actually
+       ///< displayed need to format their text. A derived class that uses this
+       ///< must implement Set() so that it calls SetText().
 public:
   cOsdItem(eOSState State = osUnknown);
   cOsdItem(const char *Text, eOSState State = osUnknown, bool Selectable = true);
@@ -62,7 +70,7 @@ public:
   void SetText(const char *Text, bool Copy = true);
   void SetSelectable(bool Selectable);
   void SetFresh(bool Fresh);
-  const char *Text(void) const { return text; }
+  const char *Text(void) const;
   virtual void Set(void) {}
   virtual void SetMenuItem(cSkinDisplayMenu *DisplayMenu, int Index, bool Current, bool Selectable);
   virtual eOSState ProcessKey(eKeys Key);
@@ -14,6 +14,8 @@
 #include "libsi/descriptor.h"
 
 #define PMT_SCAN_TIMEOUT  1000 // ms
+#define PMT_SCANS_DEVICE     8 // max. number of PMT PIDs scanned in parallel with the device's section filters
+#define PMT_SCANS_VDR       32 // max. number of PMT PIDs scanned in parallel with sections assembled by VDR
 
 // --- cCaDescriptor ---------------------------------------------------------
 
@@ -290,6 +292,8 @@ private:
              // otherwise there could be a deadlock between cPatFilter::mutex and cSectionHandler::mutex;
              // this member tells whether this PID needs to be added to (>0) or deleted from (<0) the filter
   bool complete; // true if all SIDs on this PID have been received
+  bool scanning; // true if this PID is currently being scanned in the background
+  cTimeMs scanTimer;
 public:
   cPmtPidEntry(int Pid);
   int Pid(void) { return pid; }
@@ -300,6 +304,9 @@ public:
   void Dec(void) { if (--count == 0) state = -1; }
   int Complete(void) { return complete; }
   void SetComplete(bool State) { complete = State; }
+  bool Scanning(void) { return scanning; }
+  void SetScanning(bool On) { scanning = On; if (On) scanTimer.Set(PMT_SCAN_TIMEOUT); }
+  bool ScanTimedOut(void) { return scanning && scanTimer.TimedOut(); }
   };
 
 cPmtPidEntry::cPmtPidEntry(int Pid)
@@ -308,6 +315,7 @@ cPmtPidEntry::cPmtPidEntry(int Pid)
   count = 0;
   state = 0;
   complete = false;
+  scanning = false;
 }
 
 // --- cPmtSidEntry ----------------------------------------------------------
@@ -353,6 +361,66 @@ public:
   void Dec(void) { count--; }
   };
 
+// --- cPatCache -------------------------------------------------------------
+
+#define PATCACHESIZE 32 // the number of transponders the PAT/PMT information is cached for
+
+class cPatCacheEntry : public cListObject {
+public:
+  int source;
+  int transponder;
+  int patVersion;
+  cVector<int> sids;
+  cVector<int> pids;
+  cVector<int> versions; // the PMT versions (-1 if not yet known)
+  cPatCacheEntry(int Source, int Transponder, int PatVersion) { source = Source; transponder = Transponder; patVersion = PatVersion; }
+  };
+
+class cPatCache {
+private:
+  cMutex mutex;
+  cList<cPatCacheEntry> entries; // the most recently used one first
+public:
+  void Store(cPatCacheEntry *Entry);
+       ///< Stores the given Entry in the cache, which takes ownership of it.
+  cPatCacheEntry *Load(int Source, int Transponder);
+       ///< Returns a copy of the cached entry for the given Source and Transponder,
+       ///< or NULL if there is none. The caller must delete the returned entry.
+  };
+
+static cPatCache PatCache;
+
+void cPatCache::Store(cPatCacheEntry *Entry)
+{
+  cMutexLock MutexLock(&mutex);
+  for (cPatCacheEntry *e = entries.First(); e; e = entries.Next(e)) {
+      if (e->source == Entry->source && e->transponder == Entry->transponder) {
+         entries.Del(e);
+         break;
+         }
+      }
+  entries.Ins(Entry);
+  while (entries.Count() > PATCACHESIZE)
+        entries.Del(entries.Last());
+}
+
+cPatCacheEntry *cPatCache::Load(int Source, int Transponder)
+{
+  cMutexLock MutexLock(&mutex);
+  for (cPatCacheEntry *e = entries.First(); e; e = entries.Next(e)) {
+      if (e->source == Source && e->transponder == Transponder) {
+         cPatCacheEntry *Entry = new cPatCacheEntry(Source, Transponder, e->patVersion);
+         for (int i = 0; i < e->sids.Size(); i++) {
+             Entry->sids.Append(e->sids[i]);
+             Entry->pids.Append(e->pids[i]);
+             Entry->versions.Append(e->versions[i]);
+             }
+         return Entry;
+         }
+      }
+  return NULL;
+}
+
 // --- cPatFilter ------------------------------------------------------------
 
 //#define DEBUG_PAT_PMT
@@ -365,7 +433,10 @@ public:
 cPatFilter::cPatFilter(void)
 {
   patVersion = -1;
-  activePmt = NULL;
+  patComplete = false;
+  patCached = false;
+  nextPmt = NULL;
+  numPmtScans = 0;
   transponder = 0;
   source = 0;
   Set(0x00, 0x00);  // PAT
@@ -377,10 +448,19 @@ void cPatFilter::SetStatus(bool On)
   if (On) { // restart all requested PMT Pids
      for (cPmtPidEntry *pPid = pmtPidList.First(); pPid; pPid = pmtPidList.Next(pPid))
          pPid->SetState(pPid->Count() > 0);
-     if (activePmt && activePmt->Count() == 0) {
-        activePmt->SetState(1);
-        timer.Set(PMT_SCAN_TIMEOUT);
-        }
+     }
+  else { // turning the filter off deletes all PIDs, so any ongoing scans will be started again
+     cPmtPidEntry *FirstScan = NULL;
+     for (cPmtPidEntry *pPid = pmtPidList.First(); pPid; pPid = pmtPidList.Next(pPid)) {
+         if (pPid->Scanning()) {
+            if (!FirstScan)
+               FirstScan = pPid;
+            pPid->SetScanning(false);
+            }
+         }
+     if (FirstScan)
+        nextPmt = FirstScan;
+     numPmtScans = 0;
      }
   DBGLOG("PAT filter set status %d", On);
   cFilter::SetStatus(On);
@@ -390,6 +470,7 @@ bool cPatFilter::TransponderChanged(void)
 {
   if (source != Source() || transponder != Transponder()) {
      DBGLOG("PAT filter transponder changed from %d/%d to %d/%d", source, transponder, Source(), Transponder());
+     StoreInCache();
      source = Source();
      transponder = Transponder();
      return true;
@@ -397,11 +478,58 @@ bool cPatFilter::TransponderChanged(void)
   return false;
 }
 
+void cPatFilter::StoreInCache(void)
+{
+  if (patComplete && source && transponder) {
+     cPatCacheEntry *Entry = new cPatCacheEntry(source, transponder, patVersion);
+     for (cPmtSidEntry *se = pmtSidList.First(); se; se = pmtSidList.Next(se)) {
+         Entry->sids.Append(se->Sid());
+         Entry->pids.Append(se->Pid());
+         Entry->versions.Append(se->Version());
+         }
+     PatCache.Store(Entry);
+     }
+}
+
+void cPatFilter::LoadFromCache(void)
+{
+  for (cPmtPidEntry *pPid = pmtPidList.First(); pPid; pPid = pmtPidList.Next(pPid)) {
+      if (pPid->Scanning())
+         StopPmtScan(pPid);
+      }
+  nextPmt = NULL;
+  numPmtScans = 0;
+  pmtSidList.Clear();
+  pmtPidList.Clear();
+  patComplete = false;
+  patCached = false;
+  if (cPatCacheEntry *Entry = PatCache.Load(Source(), Transponder())) {
+     DBGLOG("PAT %d taken from cache (version %d, %d services)", Transponder(), Entry->patVersion, Entry->sids.Size());
+     for (int i = 0; i < Entry->sids.Size(); i++) {
+         cPmtPidEntry *pPid = PmtPidEntry(Entry->pids[i]);
+         if (!pPid) {
+            pPid = new cPmtPidEntry(Entry->pids[i]);
+            pmtPidList.Add(pPid);
+            }
+         cPmtSidEntry *se = new cPmtSidEntry(Entry->sids[i], pPid);
+         se->SetVersion(Entry->versions[i]);
+         pmtSidList.Add(se);
+         if (NumSidRequests(Entry->sids[i]) > 0)
+            pPid->Inc(); // the requested PMTs are added to the filter right away
+         }
+     patVersion = Entry->patVersion;
+     patCached = true;
+     delete Entry;
+     }
+}
+
 void cPatFilter::Trigger(int)
 {
   cMutexLock MutexLock(&mutex);
   DBGLOG("PAT filter trigger");
   patVersion = -1;
+  patComplete = false;
+  patCached = false;
   sectionSyncer.Reset();
 }
 
@@ -501,22 +629,51 @@ bool cPatFilter::PmtVersionChanged(int PmtPid, int Sid, int Version, bool SetNew
   return false;
 }
 
-void cPatFilter::SwitchToNextPmtPid(void)
+cPmtPidEntry *cPatFilter::PmtPidEntry(int PmtPid)
 {
-  if (activePmt) {
-     if (activePmt->Count() == 0)
-        Del(activePmt->Pid(), SI::TableIdPMT);
-     for (;;) {
-         activePmt = pmtPidList.Next(activePmt);
-         if (!activePmt || activePmt->Count() == 0)
-            break;
-         }
-     if (activePmt) {
-        PmtPidReset(activePmt->Pid());
-        Add(activePmt->Pid(), SI::TableIdPMT);
-        timer.Set(PMT_SCAN_TIMEOUT);
+  for (cPmtPidEntry *pPid = pmtPidList.First(); pPid; pPid = pmtPidList.Next(pPid)) {
+      if (pPid->Pid() == PmtPid)
+         return pPid;
+      }
+  return NULL;
+}
+
+void cPatFilter::StartPmtScans(void)
+{
+  int MaxPmtScans = Setup.SectionFilters ? PMT_SCANS_VDR : PMT_SCANS_DEVICE;
+  while (nextPmt && numPmtScans < MaxPmtScans) {
+        cPmtPidEntry *pPid = nextPmt;
+        nextPmt = pmtPidList.Next(nextPmt);
+        if (pPid->Count() == 0 && !pPid->Scanning()) { // requested PIDs are permanently in the filter anyway
+           DBGLOG("PMT scan start Pid %d", pPid->Pid());
+           PmtPidReset(pPid->Pid());
+           Add(pPid->Pid(), SI::TableIdPMT);
+           pPid->SetScanning(true);
+           numPmtScans++;
+           }
         }
-     }
+}
+
+void cPatFilter::StopPmtScan(cPmtPidEntry *PidEntry)
+{
+  DBGLOG("PMT scan %s Pid %d", PidEntry->Complete() ? "done" : "timeout", PidEntry->Pid());
+  Del(PidEntry->Pid(), SI::TableIdPMT);
+  PidEntry->SetScanning(false);
+  numPmtScans--;
+}
+
+void cPatFilter::UpdatePmtFilters(void)
+{
+  for (cPmtPidEntry *pPid = pmtPidList.First(); pPid; pPid = pmtPidList.Next(pPid)) {
+      int State = pPid->State();
+      if (State > 0)
+         Add(pPid->Pid(), SI::TableIdPMT);
+      else if (State < 0)
+         Del(pPid->Pid(), SI::TableIdPMT);
+      if (pPid->ScanTimedOut())
+         StopPmtScan(pPid);
+      }
+  StartPmtScans();
 }
 
 void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length)
@@ -525,16 +682,10 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
   if (TransponderChanged()) {
      patVersion = -1;
      sectionSyncer.Reset();
+     LoadFromCache();
      }
-  if (patVersion >= 0) {
-     for (cPmtPidEntry *pPid = pmtPidList.First(); pPid; pPid = pmtPidList.Next(pPid)) {
-         int State = pPid->State();
-         if (State > 0)
-            Add(pPid->Pid(), SI::TableIdPMT);
-         else if (State < 0)
-            Del(pPid->Pid(), SI::TableIdPMT);
-         }
-     }
+  if (patVersion >= 0)
+     UpdatePmtFilters();
   else if (Pid != 0x00)
      return;
   if (Pid == 0x00) {
@@ -544,14 +695,35 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
            return;
         if (sectionSyncer.Check(pat.getVersionNumber(), pat.getSectionNumber())) {
            DBGLOG("PAT %d %d -> %d %d/%d", Transponder(), patVersion, pat.getVersionNumber(), pat.getSectionNumber(), pat.getLastSectionNumber());
+           if (patCached) {
+              if (pat.getVersionNumber() == patVersion) { // the cached data is still valid
+                 if (sectionSyncer.Processed(pat.getSectionNumber(), pat.getLastSectionNumber())) {
+                    DBGLOG("PAT %d cache verified", Transponder());
+                    patCached = false;
+                    patComplete = true;
+                    nextPmt = pmtPidList.First(); // verify the PMT versions in the background
+                    UpdatePmtFilters();
+                    }
+                 return;
+                 }
+              patCached = false; // the PAT has changed since it was cached, so everything is set up from scratch
+              }
            bool NeedsSetStatus = patVersion >= 0;
            if (pat.getVersionNumber() != patVersion) {
               if (NeedsSetStatus)
                  SetStatus(false); // deletes all PIDs from the filter
-              activePmt = NULL;
+              else {
+                 for (cPmtPidEntry *pPid = pmtPidList.First(); pPid; pPid = pmtPidList.Next(pPid)) {
+                     if (pPid->Scanning())
+                        StopPmtScan(pPid);
+                     }
+                 }
+              nextPmt = NULL;
+              numPmtScans = 0;
               pmtSidList.Clear();
               pmtPidList.Clear();
               patVersion = pat.getVersionNumber();
+              patComplete = false;
               }
            SI::PAT::Association assoc;
            for (SI::Loop::Iterator it; pat.associationLoop.getNext(assoc, it); ) {
@@ -575,16 +747,11 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                   }
                }
            if (sectionSyncer.Processed(pat.getSectionNumber(), pat.getLastSectionNumber())) { // all PAT sections done
-              for (cPmtPidEntry *pPid = pmtPidList.First(); pPid; pPid = pmtPidList.Next(pPid)) {
-                  if (pPid->Count() == 0) {
-                     pPid->SetState(1);
-                     activePmt = pPid;
-                     timer.Set(PMT_SCAN_TIMEOUT);
-                     break;
-                     }
-                  }
+              nextPmt = pmtPidList.First(); // scan all PMT PIDs in the background
+              patComplete = true;
               if (NeedsSetStatus)
                  SetStatus(true);
+              UpdatePmtFilters(); // requested PIDs get their filters right away
               }
            }
         }
@@ -593,9 +760,12 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
      SI::PMT pmt(Data, false);
      if (!pmt.CheckCRCAndParse())
         return;
+     cPmtPidEntry *pPid = PmtPidEntry(Pid);
      if (!PmtVersionChanged(Pid, pmt.getTableIdExtension(), pmt.getVersionNumber(), false)) {
-        if (activePmt && activePmt->Complete())
-           SwitchToNextPmtPid();
+        if (pPid && pPid->Scanning() && pPid->Complete()) {
+           StopPmtScan(pPid);
+           StartPmtScans();
+           }
         return;
         }
      cStateKey StateKey;
@@ -604,8 +774,10 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
         return;
      PmtVersionChanged(Pid, pmt.getTableIdExtension(), pmt.getVersionNumber(), true);
      bool ChannelsModified = false;
-     if (activePmt && activePmt->Complete())
-        SwitchToNextPmtPid();
+     if (pPid && pPid->Scanning() && pPid->Complete()) {
+        StopPmtScan(pPid);
+        StartPmtScans();
+        }
      cChannel *Channel = Channels->GetByServiceID(Source(), Transponder(), pmt.getServiceId());
      if (Channel) {
         SI::CaDescriptor *d;
@@ -846,9 +1018,4 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
         }
      StateKey.Remove(ChannelsModified);
      }
-  if (timer.TimedOut()) {
-     if (activePmt)
-        DBGLOG("PMT timeout Pid %d", activePmt->Pid());
-     SwitchToNextPmtPid();
-     }
 }
@@ -17,13 +17,16 @@
 class cPmtPidEntry;
 class cPmtSidEntry;
 class cPmtSidRequest;
+class cPatCacheEntry;
 
 class cPatFilter : public cFilter {
 private:
   cMutex mutex;
-  cTimeMs timer;
   int patVersion;
-  cPmtPidEntry *activePmt;
+  bool patComplete; // true if all sections of the current PAT have been processed
+  bool patCached; // true if the PAT and PMT information has been taken from the cache and not yet verified
+  cPmtPidEntry *nextPmt; // the next PMT PID to be scanned in the background
+  int numPmtScans; // the number of PMT PIDs currently being scanned
   cList<cPmtPidEntry> pmtPidList;
   cList<cPmtSidEntry> pmtSidList;
   cList<cPmtSidRequest> pmtSidRequestList;
@@ -31,11 +34,25 @@ private:
   int transponder;
   cSectionSyncer sectionSyncer;
   bool TransponderChanged(void);
+  void StoreInCache(void);
+       ///< Stores the PAT and PMT versions of the current transponder in the cache.
+  void LoadFromCache(void);
+       ///< Sets up the PMT lists of the current transponder from the cache (if it has
+       ///< been tuned to before), so that the requested PMTs are filtered right away
+       ///< and PMTs that haven't changed are not processed again. The cached data is
+       ///< verified against the PAT once it has been received.
   bool PmtPidComplete(int PmtPid);
   void PmtPidReset(int PmtPid);
   bool PmtVersionChanged(int PmtPid, int Sid, int Version, bool SetNewVersion = false);
   int  NumSidRequests(int Sid);
-  void SwitchToNextPmtPid(void);
+  cPmtPidEntry *PmtPidEntry(int PmtPid);
+  void StartPmtScans(void);
+       ///< Adds filters for the next PMT PIDs to be scanned, up to the maximum
+       ///< number of parallel scans.
+  void StopPmtScan(cPmtPidEntry *PidEntry);
+  void UpdatePmtFilters(void);
+       ///< Adds/deletes the filters of requested PMT PIDs, stops scans that have
+       ///< timed out and starts new ones.
 protected:
   virtual void Process(u_short Pid, u_char Tid, const u_char *Data, int Length) override;
 public:
@@ -9,6 +9,7 @@
 
 #include "player.h"
 #include "i18n.h"
+#include "remote.h"
 
 // --- cPlayer ---------------------------------------------------------------
 
@@ -81,6 +82,8 @@ void cControl::Launch(cControl *Control)
   cMutexLock MutexLock(&mutex);
   delete control;
   control = Control;
+  if (!cThread::IsMainThread())
+     cRemote::Wakeup(); // so that the player is attached right away
 }
 
 void cControl::Attach(void)
@@ -16,6 +16,8 @@
 #include <time.h>
 #include "config.h"
 #include "interface.h"
+#include "startup.h"
+#include "taskpool.h"
 #include "thread.h"
 
 #define LIBVDR_PREFIX  "libvdr-"
@@ -23,6 +25,7 @@
 
 #define MAXPLUGINARGS  1024
 #define HOUSEKEEPINGDELTA 10 // seconds
+#define SLOWHOOKTIME  100000 // microseconds a MainThreadHook() call may take before it is logged
 
 // --- cPlugin ---------------------------------------------------------------
 
@@ -34,6 +37,9 @@ cPlugin::cPlugin(void)
 {
   name = NULL;
   started = false;
+  hookCalls = 0;
+  hookTime = 0;
+  hookMaxTime = 0;
 }
 
 cPlugin::~cPlugin()
@@ -66,6 +72,11 @@ bool cPlugin::Start(void)
   return true;
 }
 
+bool cPlugin::DeferredStart(void)
+{
+  return false;
+}
+
 void cPlugin::Stop(void)
 {
 }
@@ -225,6 +236,7 @@ bool cDll::Load(bool Log)
      esyslog("attempt to load plugin '%s' twice!", fileName);
      return false;
      }
+  cStartupPhase StartupPhase(cString::sprintf("load plugin %s", fileName));
   handle = dlopen(fileName, RTLD_NOW);
   const char *error = dlerror();
   if (!error) {
@@ -297,6 +309,30 @@ bool cDll::Load(bool Log)
   return !error && plugin;
 }
 
+// --- cDeferredPluginStarter -----------------------------------------------
+
+class cDeferredPluginStarter : public cTask {
+private:
+  cPluginManager *pluginManager;
+protected:
+  virtual void Action(void);
+public:
+  cDeferredPluginStarter(cPluginManager *PluginManager) : cTask(tpLow) { pluginManager = PluginManager; }
+  };
+
+void cDeferredPluginStarter::Action(void)
+{
+  for (cDll *dll = pluginManager->dlls.First(); dll && Running(); dll = pluginManager->dlls.Next(dll)) {
+      cPlugin *p = dll->Plugin();
+      if (p && !p->started && p->DeferredStart()) {
+         isyslog("starting plugin: %s (deferred)", p->Name());
+         cStartupPhase StartupPhase(cString::sprintf("start plugin %s (deferred)", p->Name()));
+         if (!pluginManager->StartPlugin(p))
+            esyslog("ERROR: deferred start of plugin %s failed", p->Name());
+         }
+      }
+}
+
 // --- cPluginManager --------------------------------------------------------
 
 cPluginManager *cPluginManager::pluginManager = NULL;
@@ -306,6 +342,7 @@ cPluginManager::cPluginManager(const char *Directory)
   directory = NULL;
   lastHousekeeping = time(NULL);
   nextHousekeeping = -1;
+  deferredPluginStarter = NULL;
   if (pluginManager) {
      fprintf(stderr, "vdr: attempt to create more than one plugin manager - exiting!\n");
      exit(2);
@@ -373,6 +410,7 @@ bool cPluginManager::InitializePlugins(void)
       cPlugin *p = dll->Plugin();
       if (p) {
          isyslog("initializing plugin: %s (%s): %s", p->Name(), p->Version(), p->Description());
+         cStartupPhase StartupPhase(cString::sprintf("initialize plugin %s", p->Name()));
          if (!p->Initialize())
             return false;
          }
@@ -380,20 +418,40 @@ bool cPluginManager::InitializePlugins(void)
   return true;
 }
 
+bool cPluginManager::StartPlugin(cPlugin *Plugin)
+{
+  if (!Plugin->Start())
+     return false;
+  Plugin->started = true;
+  return true;
+}
+
 bool cPluginManager::StartPlugins(void)
 {
   for (cDll *dll = dlls.First(); dll; dll = dlls.Next(dll)) {
       cPlugin *p = dll->Plugin();
       if (p) {
+         if (p->DeferredStart()) {
+            isyslog("deferring start of plugin: %s", p->Name());
+            continue;
+            }
          isyslog("starting plugin: %s", p->Name());
-         if (!p->Start())
+         cStartupPhase StartupPhase(cString::sprintf("start plugin %s", p->Name()));
+         if (!StartPlugin(p))
             return false;
-         p->started = true;
          }
       }
   return true;
 }
 
+void cPluginManager::StartDeferredPlugins(void)
+{
+  if (!deferredPluginStarter) {
+     deferredPluginStarter = new cDeferredPluginStarter(this);
+     deferredPluginStarter->Start();
+     }
+}
+
 void cPluginManager::Housekeeping(void)
 {
   if (time(NULL) - lastHousekeeping > HOUSEKEEPINGDELTA) {
@@ -402,7 +460,7 @@ void cPluginManager::Housekeeping(void)
      cDll *dll = dlls.Get(nextHousekeeping);
      if (dll) {
         cPlugin *p = dll->Plugin();
-        if (p) {
+        if (p && p->started) {
            p->Housekeeping();
            }
         }
@@ -414,11 +472,33 @@ void cPluginManager::MainThreadHook(void)
 {
   for (cDll *dll = pluginManager->dlls.First(); dll; dll = pluginManager->dlls.Next(dll)) {
       cPlugin *p = dll->Plugin();
-      if (p)
+      if (p && p->started) {
+         uint64_t Begin = cTimeMs::NowUs();
          p->MainThreadHook();
+         uint64_t Time = cTimeMs::NowUs() - Begin;
+         p->hookCalls++;
+         p->hookTime += Time;
+         if (Time > p->hookMaxTime)
+            p->hookMaxTime = Time;
+         if (Time > SLOWHOOKTIME)
+            dsyslog("plugin %s: MainThreadHook() took %d ms", p->Name(), int(Time / 1000));
+         }
       }
 }
 
+void cPluginManager::GetStatistics(cStringList &Lines)
+{
+  if (pluginManager) {
+     for (cDll *dll = pluginManager->dlls.First(); dll; dll = pluginManager->dlls.Next(dll)) {
+         if (cPlugin *p = dll->Plugin()) {
+            const char *State = p->started ? "started" : p->DeferredStart() ? "deferred" : "stopped";
+            uint64_t Average = p->hookCalls ? p->hookTime / p->hookCalls : 0;
+            Lines.Append(strdup(cString::sprintf("%-16s %-8s %10d hook calls, total %8d ms, average %6d us, max %6d us", p->Name(), State, p->hookCalls, int(p->hookTime / 1000), int(Average), int(p->hookMaxTime))));
+            }
+         }
+     }
+}
+
 bool cPluginManager::Active(const char *Prompt)
 {
   if (pluginManager) {
@@ -506,13 +586,17 @@ bool cPluginManager::CallAllServices(const char *Id, void *Data)
 
 void cPluginManager::StopPlugins(void)
 {
-  for (cDll *dll = dlls.Last(); dll; dll = dlls.Prev(dll)) {
-      cPlugin *p = dll->Plugin();
-      if (p && p->started) {
-         isyslog("stopping plugin: %s", p->Name());
-         p->Stop();
-         p->started = false;
-         }
+  delete deferredPluginStarter; // waits for a deferred start that is currently going on
+  deferredPluginStarter = NULL;
+  for (int Deferred = 1; Deferred >= 0; Deferred--) { // deferred plugins have been started last, so they are stopped first
+      for (cDll *dll = dlls.Last(); dll; dll = dlls.Prev(dll)) {
+          cPlugin *p = dll->Plugin();
+          if (p && p->started && p->DeferredStart() == Deferred) {
+             isyslog("stopping plugin: %s", p->Name());
+             p->Stop();
+             p->started = false;
+             }
+          }
       }
 }
 
@@ -10,6 +10,7 @@
 #ifndef __PLUGIN_H
 #define __PLUGIN_H
 
+#include <atomic>
 #include "i18n.h"
 #include "menuitems.h"
 #include "osdbase.h"
@@ -22,12 +23,16 @@
 class cPlugin {
   friend class cDll;
   friend class cPluginManager;
+  friend class cDeferredPluginStarter;
 private:
   static cString configDirectory;
   static cString cacheDirectory;
   static cString resourceDirectory;
   const char *name;
-  bool started;
+  std::atomic_bool started;
+  int hookCalls;
+  uint64_t hookTime;    // the total time spent in MainThreadHook() (in microseconds)
+  uint64_t hookMaxTime; // the longest single call of MainThreadHook() (in microseconds)
   void SetName(const char *s);
 public:
   cPlugin(void);
@@ -41,6 +46,12 @@ public:
   virtual bool ProcessArgs(int argc, char *argv[]);
   virtual bool Initialize(void);
   virtual bool Start(void);
+  virtual bool DeferredStart(void);
+       ///< If this function returns true, Start() is not called during VDR's
+       ///< startup, but later in a separate thread, once the first picture is
+       ///< being displayed (or a while after startup if there is none). The
+       ///< plugin's Housekeeping() and MainThreadHook() are only called after
+       ///< Start() has returned true.
   virtual void Stop(void);
   virtual void Housekeeping(void);
 #ifndef MUTE_DEPRECATED_MAINTHREADHOOK
@@ -87,13 +98,18 @@ public:
 
 class cDlls : public cList<cDll> {};
 
+class cDeferredPluginStarter;
+
 class cPluginManager {
+  friend class cDeferredPluginStarter;
 private:
   static cPluginManager *pluginManager;
   char *directory;
   time_t lastHousekeeping;
   int nextHousekeeping;
   cDlls dlls;
+  cDeferredPluginStarter *deferredPluginStarter;
+  bool StartPlugin(cPlugin *Plugin);
 public:
   cPluginManager(const char *Directory);
   virtual ~cPluginManager();
@@ -102,8 +118,16 @@ public:
   bool LoadPlugins(bool Log = false);
   bool InitializePlugins(void);
   bool StartPlugins(void);
+       ///< Starts all plugins, except for those that request a deferred start.
+  void StartDeferredPlugins(void);
+       ///< Starts the plugins that have requested a deferred start in a separate
+       ///< thread. Only the first call to this function has any effect.
   void Housekeeping(void);
   void MainThreadHook(void);
+  static void GetStatistics(cStringList &Lines);
+       ///< Appends one line for each plugin to Lines, containing its name, whether
+       ///< it has been started and the number of calls to, as well as the total
+       ///< and maximum time spent in its MainThreadHook().
   static bool Active(const char *Prompt = NULL);
   static cPlugin *GetNextWakeupPlugin(void);
   static bool HasPlugins(void);
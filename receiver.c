@@ -21,6 +21,7 @@ cReceiver::cReceiver(const cChannel *Channel, int Priority)
   scramblingTimeout = 0;
   startEitInjection = 0;
   lastEitInjection = 0;
+  multiPacket = false;
   SetPids(Channel);
 }
 
@@ -45,8 +46,10 @@ bool cReceiver::AddPid(int Pid)
      if (numPids < MAXRECEIVEPIDS) {
         if (!WantsPid(Pid)) {
            pids[numPids++] = Pid;
-           if (device)
+           if (device) {
               device->AddPid(Pid);
+              device->SetReceiverPid(this, Pid, true);
+              }
            }
         }
      else {
@@ -75,6 +78,10 @@ bool cReceiver::AddPids(int Pid1, int Pid2, int Pid3, int Pid4, int Pid5, int Pi
 
 bool cReceiver::SetPids(const cChannel *Channel)
 {
+  if (device) {
+     for (int i = 0; i < numPids; i++)
+         device->SetReceiverPid(this, pids[i], false);
+     }
   numPids = 0;
   if (Channel) {
      channelID = Channel->GetChannelID();
@@ -95,8 +102,10 @@ void cReceiver::DelPid(int Pid)
             for ( ; i < numPids; i++) // we also copy the terminating 0!
                 pids[i] = pids[i + 1];
             numPids--;
-            if (device)
+            if (device) {
+               device->SetReceiverPid(this, Pid, false);
                device->DelPid(Pid);
+               }
             return;
             }
          }
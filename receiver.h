@@ -27,10 +27,16 @@ private:
   int scramblingTimeout;
   time_t startEitInjection;
   time_t lastEitInjection;
+  bool multiPacket;
   bool WantsPid(int Pid);
 protected:
   cDevice *Device(void) { return device; }
   void Detach(void);
+  void SetMultiPacket(bool On) { multiPacket = On; }
+               ///< If a derived cReceiver is able to handle several consecutive TS packets
+               ///< in a single call to Receive(), it can call SetMultiPacket(true) (typically
+               ///< in its constructor). The cDevice will then deliver runs of TS packets
+               ///< in one call, which reduces the per packet overhead on busy transponders.
   virtual void Activate(bool On) {}
                ///< This function is called just before the cReceiver gets attached to
                ///< (On == true) and right after it gets detached from (On == false) a cDevice. It can be used
@@ -39,6 +45,8 @@ protected:
   virtual void Receive(const uchar *Data, int Length) = 0;
                ///< This function is called from the cDevice we are attached to, and
                ///< delivers one TS packet from the set of PIDs the cReceiver has requested.
+               ///< If SetMultiPacket(true) has been called, Data may contain several
+               ///< consecutive TS packets, and Length is a multiple of TS_SIZE.
                ///< The data packet must be accepted immediately, and the call must return
                ///< as soon as possible, without any unnecessary delay. Each TS packet
                ///< will be delivered only ONCE, so the cReceiver must make sure that
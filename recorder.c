@@ -8,9 +8,18 @@
  */
 
 #include "recorder.h"
+#include "membudget.h"
+#include "metrics.h"
 #include "shutdown.h"
+#include "trace.h"
+#include "videodir.h"
 
-#define RECORDERBUFSIZE  (MEGABYTE(20) / TS_SIZE * TS_SIZE) // multiple of TS_SIZE
+// The size of the recorder's ring buffer depends on the kind of stream, so that it
+// can hold roughly the same number of seconds for radio as well as for UHD:
+#define RECORDERBUFSIZE      (MEGABYTE(20) / TS_SIZE * TS_SIZE) // multiple of TS_SIZE
+#define RECORDERBUFSIZEMIN   (MEGABYTE(2) / TS_SIZE * TS_SIZE) // audio only
+#define RECORDERBUFSIZESD    (MEGABYTE(10) / TS_SIZE * TS_SIZE) // MPEG-1/2 video
+#define RECORDERBUFSIZEUHD   (MEGABYTE(40) / TS_SIZE * TS_SIZE) // H.265 video
 
 // The maximum time we wait before assuming that a recorded video data stream
 // is broken:
@@ -20,75 +29,961 @@
 #define MINFREEDISKSPACE    (512) // MB
 #define DISKCHECKINTERVAL   100 // seconds
 
+#define TIMESHIFTFILES        16 // number of files a time shift buffer is split into
+#define TIMESHIFTMINFILESIZE  16 // MB
+
+#define RECORDERQUEUESIZE     MEGABYTE(16) // maximum amount of data waiting to be written per recording
+#define RECORDERWRITEQUANTUM  MEGABYTE(4)  // amount of data written per recording in one turn
+#define RECORDERMAXDELAY      1000 // ms before queued data is written, even if it's less than RECORDERWRITEQUANTUM
+#define RECORDERIDLETIME      50 // ms the i/o scheduler sleeps if there is nothing to write
+#define RECORDERMAXENTRIES    4096 // maximum number of index entries per turn
+#define MAXWRITERDRAINTIME    10 // seconds
+
+// --- cRecorderWriter -------------------------------------------------------
+
+static cLatencyHistogram RecorderWriteLatency;
+
+// Chunk flags:
+#define RW_NEXTFILE       0x01 // continue with the next file before writing this chunk
+#define RW_NEWFRAME       0x02 // this chunk starts a new frame
+#define RW_INDEPENDENT    0x04 // the new frame is an independent frame
+#define RW_PREVIOUSERRORS 0x08 // the previous frame contained errors
+#define RW_MISSING        0x10 // frames are missing before the new frame
+#define RW_FLUSHINDEX     0x20 // write the pending index entry
+
+struct tRecorderChunk {
+  tRecorderChunk *next;
+  int flags;
+  int length;
+  uchar *Data(void) { return (uchar *)(this + 1); }
+  };
+
+struct tRecorderIndexEntry {
+  bool independent;
+  uint16_t number;
+  off_t offset;
+  bool errors;
+  bool missing;
+  };
+
+class cRecorderWriter : public cListObject {
+private:
+  cFileName *fileName;
+  cUnbufferedFile *recordFile;
+  cIndexFile *index;
+  off_t fileSize;
+  bool pendIndependentFrame;
+  uint16_t pendNumber;
+  off_t pendFileSize;
+  bool pendMissing;
+  uchar *buffer;
+  int buffered;
+  tRecorderIndexEntry entries[RECORDERMAXENTRIES];
+  int numEntries;
+  cMutex mutex;
+  cCondVar queueChanged;
+  tRecorderChunk *head;
+  tRecorderChunk *tail;
+  int queued;
+  uint64_t firstQueued;
+  bool finishing;
+  bool failed;
+  int maxLatency;
+  off_t maxSize;
+  off_t totalSize;
+  int firstFile;
+  bool WriteFile(const uchar *Data, int Length);
+  void Trim(void);
+  bool Flush(void);
+  bool Write(tRecorderChunk *Chunk);
+public:
+  cRecorderWriter(cFileName *FileName, cUnbufferedFile *RecordFile, cIndexFile *Index);
+  virtual ~cRecorderWriter() override;
+  bool Put(const uchar *Data, int Length, int Flags = 0);
+       ///< Appends Length bytes of Data to the queue of data to be written.
+       ///< Flags is a combination of RW_... and tells the writer how to
+       ///< maintain the index and when to continue with the next file.
+       ///< Blocks while the queue is full.
+       ///< Returns false if writing has failed, in which case the recording
+       ///< can't be continued.
+  void Finish(void);
+       ///< Waits until all data that is still in the queue has been written.
+  int Queued(void) { return queued; }
+  int MaxLatency(void) { return maxLatency; }
+       ///< Returns the longest time (in microseconds) a write to the file has taken.
+       ///< Returns the number of bytes waiting to be written.
+  void SetMaxSize(off_t MaxSize) { maxSize = MaxSize; }
+       ///< Makes the writer remove the oldest files of the recording whenever it
+       ///< continues with the next file and all files together hold more than
+       ///< MaxSize bytes. A MaxSize of 0 keeps all files.
+  bool Ready(void);
+       ///< Returns true if this writer has enough data (or has waited long
+       ///< enough) to be given a turn by the i/o scheduler.
+  int Process(void);
+       ///< Writes up to RECORDERWRITEQUANTUM bytes from the queue in one go.
+       ///< Returns the number of bytes taken from the queue.
+  };
+
+// --- cRecorderIoScheduler --------------------------------------------------
+
+// All recordings hand their data to a single thread, which writes
+// RECORDERWRITEQUANTUM bytes per recording and turn, so that the disk
+// sees a few large sequential writes instead of many small interleaved ones.
+
+class cRecorderIoScheduler : public cThread {
+private:
+  static cMutex mutex;
+  static cCondVar idle;
+  static cRecorderIoScheduler *scheduler;
+  cList<cRecorderWriter> writers;
+  cRecorderWriter *current;
+  int turn;
+  cIoThrottle ioThrottle;
+protected:
+  virtual void Action(void) override;
+public:
+  cRecorderIoScheduler(void);
+  virtual ~cRecorderIoScheduler() override;
+  static void Register(cRecorderWriter *Writer);
+       ///< Adds the given Writer to the writers served by the i/o scheduler,
+       ///< starting the scheduler thread if necessary.
+  static void Unregister(cRecorderWriter *Writer);
+       ///< Removes the given Writer, waiting until it is no longer being
+       ///< processed. The scheduler thread is stopped when the last
+       ///< writer has been removed.
+  };
+
+cMutex cRecorderIoScheduler::mutex;
+cCondVar cRecorderIoScheduler::idle;
+cRecorderIoScheduler *cRecorderIoScheduler::scheduler = NULL;
+
+cRecorderIoScheduler::cRecorderIoScheduler(void)
+:cThread("recording i/o")
+{
+  current = NULL;
+  turn = 0;
+}
+
+cRecorderIoScheduler::~cRecorderIoScheduler()
+{
+  Cancel(3);
+  // the writers are owned by their recorders:
+  while (cRecorderWriter *Writer = writers.First())
+        writers.Del(Writer, false);
+}
+
+void cRecorderIoScheduler::Register(cRecorderWriter *Writer)
+{
+  cMutexLock MutexLock(&mutex);
+  if (!scheduler) {
+     scheduler = new cRecorderIoScheduler;
+     scheduler->Start();
+     }
+  scheduler->writers.Add(Writer);
+}
+
+void cRecorderIoScheduler::Unregister(cRecorderWriter *Writer)
+{
+  cRecorderIoScheduler *Scheduler = NULL;
+  mutex.Lock();
+  if (scheduler) {
+     while (scheduler->current == Writer)
+           idle.Wait(mutex);
+     scheduler->writers.Del(Writer, false);
+     if (!scheduler->writers.Count()) {
+        Scheduler = scheduler;
+        scheduler = NULL;
+        }
+     }
+  mutex.Unlock();
+  delete Scheduler;
+}
+
+void cRecorderIoScheduler::Action(void)
+{
+  while (Running()) {
+        // Pick the next writer that is ready, in round-robin order:
+        int MaxQueued = 0;
+        mutex.Lock();
+        int n = writers.Count();
+        for (int i = 0; i < n; i++) {
+            cRecorderWriter *Writer = writers.Get((turn + i) % n);
+            MaxQueued = max(MaxQueued, Writer->Queued());
+            if (!current && Writer->Ready()) {
+               current = Writer;
+               turn = (turn + i + 1) % n;
+               }
+            }
+        cRecorderWriter *Writer = current;
+        mutex.Unlock();
+        // Let other i/o intensive tasks back off if we can't keep up:
+        if (MaxQueued >= RECORDERQUEUESIZE / 2)
+           ioThrottle.Activate();
+        else if (MaxQueued < RECORDERQUEUESIZE / 4)
+           ioThrottle.Release();
+        if (Writer) {
+           Writer->Process();
+           mutex.Lock();
+           current = NULL;
+           idle.Broadcast();
+           mutex.Unlock();
+           }
+        else
+           cCondWait::SleepMs(RECORDERIDLETIME);
+        }
+}
+
+// --- cRecorderWriter -------------------------------------------------------
+
+cRecorderWriter::cRecorderWriter(cFileName *FileName, cUnbufferedFile *RecordFile, cIndexFile *Index)
+{
+  fileName = FileName;
+  recordFile = RecordFile;
+  index = Index;
+  fileSize = 0;
+  pendIndependentFrame = false;
+  pendNumber = 0;
+  pendFileSize = 0;
+  pendMissing = false;
+  buffer = MALLOC(uchar, RECORDERWRITEQUANTUM);
+  buffered = 0;
+  numEntries = 0;
+  head = tail = NULL;
+  queued = 0;
+  firstQueued = 0;
+  finishing = false;
+  failed = !buffer;
+  maxLatency = 0;
+  maxSize = 0;
+  totalSize = 0;
+  firstFile = fileName->Number();
+  if (failed)
+     esyslog("ERROR: can't allocate recorder write buffer");
+  cRecorderIoScheduler::Register(this);
+}
+
+cRecorderWriter::~cRecorderWriter()
+{
+  Finish();
+  cRecorderIoScheduler::Unregister(this);
+  while (head) {
+        tRecorderChunk *Chunk = head;
+        head = Chunk->next;
+        free(Chunk);
+        }
+  free(buffer);
+}
+
+void cRecorderWriter::Finish(void)
+{
+  cMutexLock MutexLock(&mutex);
+  finishing = true;
+  cTimeMs Timeout(MAXWRITERDRAINTIME * 1000);
+  while (queued && !failed) {
+        if (Timeout.TimedOut()) {
+           esyslog("ERROR: %s: %d bytes still waiting to be written", fileName->Name(), queued);
+           break;
+           }
+        queueChanged.TimedWait(mutex, 100);
+        }
+}
+
+bool cRecorderWriter::Put(const uchar *Data, int Length, int Flags)
+{
+  tRecorderChunk *Chunk = (tRecorderChunk *)malloc(sizeof(tRecorderChunk) + Length);
+  if (!Chunk) {
+     esyslog("ERROR: can't allocate recorder chunk");
+     return false;
+     }
+  Chunk->next = NULL;
+  Chunk->flags = Flags;
+  Chunk->length = Length;
+  if (Length)
+     memcpy(Chunk->Data(), Data, Length);
+  cMutexLock MutexLock(&mutex);
+  while (queued >= RECORDERQUEUESIZE && !failed)
+        queueChanged.TimedWait(mutex, 100);
+  if (failed) {
+     free(Chunk);
+     return false;
+     }
+  if (tail)
+     tail->next = Chunk;
+  else {
+     head = Chunk;
+     firstQueued = cTimeMs::Now();
+     }
+  tail = Chunk;
+  queued += Length;
+  return true;
+}
+
+bool cRecorderWriter::Ready(void)
+{
+  cMutexLock MutexLock(&mutex);
+  return head && (queued >= RECORDERWRITEQUANTUM || finishing || cTimeMs::Now() - firstQueued >= RECORDERMAXDELAY);
+}
+
+bool cRecorderWriter::WriteFile(const uchar *Data, int Length)
+{
+  uint64_t t = cTimeMs::NowUs();
+  if (recordFile->Write(Data, Length) < 0) {
+     LOG_ERROR_STR(fileName->Name());
+     return false;
+     }
+  uint64_t Latency = cTimeMs::NowUs() - t;
+  RecorderWriteLatency.Add(Latency);
+  cIoBudget::Recorded(Length);
+  maxLatency = max(maxLatency, int(Latency));
+  totalSize += Length;
+  cVideoDiskUsage::Written(Length);
+  return true;
+}
+
+void cRecorderWriter::Trim(void)
+{
+  while (maxSize && totalSize > maxSize && firstFile < fileName->Number()) {
+        off_t Size = fileName->Remove(firstFile++);
+        if (Size > 0)
+           totalSize -= Size;
+        }
+}
+
+bool cRecorderWriter::Flush(void)
+{
+  if (buffered) {
+     if (!WriteFile(buffer, buffered))
+        return false;
+     VDR_TRACE(recorder_write, this, buffered, numEntries);
+     buffered = 0;
+     }
+  // The index entries are written after the data they refer to, so that
+  // a replay of the ongoing recording never tries to read beyond the
+  // end of the file:
+  for (int i = 0; i < numEntries; i++) {
+      tRecorderIndexEntry *e = &entries[i];
+      index->Write(e->independent, e->number, e->offset, e->errors, e->missing);
+      }
+  if (numEntries)
+     index->Flush();
+  numEntries = 0;
+  return true;
+}
+
+bool cRecorderWriter::Write(tRecorderChunk *Chunk)
+{
+  if (Chunk->flags & RW_NEXTFILE) {
+     if (!Flush())
+        return false;
+     recordFile = fileName->NextFile();
+     fileSize = 0;
+     if (!recordFile)
+        return false;
+     Trim();
+     }
+  if (index) {
+     if (Chunk->flags & (RW_NEWFRAME | RW_FLUSHINDEX)) {
+        if (pendNumber > 0) {
+           if (numEntries >= RECORDERMAXENTRIES && !Flush())
+              return false;
+           tRecorderIndexEntry *e = &entries[numEntries++];
+           e->independent = pendIndependentFrame;
+           e->number = pendNumber;
+           e->offset = pendFileSize;
+           e->errors = Chunk->flags & RW_PREVIOUSERRORS;
+           e->missing = pendMissing;
+           }
+        pendNumber = 0;
+        }
+     if (Chunk->flags & RW_NEWFRAME) {
+        pendIndependentFrame = Chunk->flags & RW_INDEPENDENT;
+        pendNumber = fileName->Number();
+        pendFileSize = fileSize;
+        pendMissing = Chunk->flags & RW_MISSING;
+        }
+     }
+  if (Chunk->length) {
+     if (buffered + Chunk->length > RECORDERWRITEQUANTUM && !Flush())
+        return false;
+     if (Chunk->length > RECORDERWRITEQUANTUM) {
+        if (!WriteFile(Chunk->Data(), Chunk->length))
+           return false;
+        }
+     else {
+        memcpy(buffer + buffered, Chunk->Data(), Chunk->length);
+        buffered += Chunk->length;
+        }
+     fileSize += Chunk->length;
+     }
+  return true;
+}
+
+int cRecorderWriter::Process(void)
+{
+  // Take up to RECORDERWRITEQUANTUM bytes from the queue:
+  mutex.Lock();
+  tRecorderChunk *Chunks = head;
+  tRecorderChunk *Last = NULL;
+  int Length = 0;
+  for (tRecorderChunk *Chunk = head; Chunk && (!Last || Length + Chunk->length <= RECORDERWRITEQUANTUM); Chunk = Chunk->next) {
+      Length += Chunk->length;
+      Last = Chunk;
+      }
+  if (Last) {
+     head = Last->next;
+     Last->next = NULL;
+     if (!head)
+        tail = NULL;
+     firstQueued = cTimeMs::Now();
+     }
+  bool Ok = !failed;
+  mutex.Unlock();
+  // Write them without blocking the recorder:
+  while (Chunks) {
+        tRecorderChunk *Chunk = Chunks;
+        Chunks = Chunk->next;
+        Ok = Ok && Write(Chunk);
+        free(Chunk);
+        }
+  Ok = Ok && Flush();
+  cMutexLock MutexLock(&mutex);
+  queued -= Length;
+  if (!Ok)
+     failed = true;
+  queueChanged.Broadcast();
+  return Length;
+}
+
+// --- cRecorderStream -------------------------------------------------------
+
+// Recorders that record the same channel from the same device (like the
+// overlapping margins of consecutive timers) share one cRecorderStream, which
+// buffers the data and runs the frame detector only once for all of them.
+// Each of these recorders is a receiver of its own and gets the very same
+// data from the device, but only the one acting as the "feeder" puts it into
+// the ring buffer. When the feeder leaves, another recorder takes over with
+// the first run of data the feeder hasn't already delivered.
+
+#define MAXSTOPTIME    3 // seconds to wait for a recording to end at an independent frame
+#define MAXFEEDERRUNS  1000 // maximum number of runs of data remembered for handing over
+
+static int RecorderBufferSize(int Type)
+{
+  switch (Type) {
+    case 0x01:
+    case 0x02: return RECORDERBUFSIZESD;
+    case 0x1B: return RECORDERBUFSIZE;
+    case 0x24: return RECORDERBUFSIZEUHD;
+    default: ;
+    }
+  return RECORDERBUFSIZEMIN; // audio or unknown
+}
+
+class cRecorderStream : public cThread {
+private:
+  static cMutex streamsMutex;
+  static cVector<cRecorderStream *> streams;
+  int references;
+  cDevice *device;
+  tChannelID channelID;
+  int pid;
+  int type;
+  bool shared;
+  cMemoryClient *memory;
+  cRingBufferLinear *ringBuffer;
+  cFrameDetector *frameDetector;
+  cMutex mutex; // protects the list of recorders
+  cCondVar recorderFinished;
+  cVector<cRecorder *> recorders;
+  cTimeMs brokenTimer;
+  cMutex receiveMutex;
+  bool working;
+  cRecorder *feeder;
+  bool handOver;
+  cRecorder *lastReceiver;
+  cVector<const uchar *> feederRuns;
+  void Remove(cRecorder *Recorder);
+  void PutData(const uchar *Data, int Length);
+  static void Unref(cRecorderStream *Stream);
+protected:
+  virtual void Action(void) override;
+public:
+  cRecorderStream(cDevice *Device, cRecorder *Recorder);
+  virtual ~cRecorderStream() override;
+  static cRecorderStream *Join(cRecorder *Recorder, cDevice *Device);
+       ///< Adds the given Recorder to the stream that is already recording its
+       ///< channel from Device, or creates a new stream for it. Resumed recordings
+       ///< always get a stream of their own, because their frame detector needs
+       ///< to know the last PTS of the previous part.
+  static void Stop(cRecorder *Recorder);
+       ///< Lets the recording of Recorder end before the next independent frame, or
+       ///< after MAXSTOPTIME seconds at the latest.
+  static void Release(cRecorder *Recorder);
+       ///< Removes Recorder from its stream. The stream is deleted together with the
+       ///< last recorder that uses it.
+  static bool GetBufferStats(cRecorder *Recorder, int &Size, int &MaxFill, int &Overflows, int64_t &OverflowBytes);
+  void Receive(cRecorder *Recorder, const uchar *Data, int Length);
+  };
+
+cMutex cRecorderStream::streamsMutex;
+cVector<cRecorderStream *> cRecorderStream::streams;
+
+cRecorderStream::cRecorderStream(cDevice *Device, cRecorder *Recorder)
+:cThread("recording")
+{
+  references = 0;
+  device = Device;
+  channelID = Recorder->ChannelID();
+  pid = Recorder->pid;
+  type = Recorder->type;
+  shared = !Recorder->resumed;
+  cString Name = cString::sprintf("Recorder %s", *channelID.ToString());
+  memory = new cMemoryClient(Name, mpRecording, RECORDERBUFSIZEMIN, RecorderBufferSize(type), RecorderBufferSize(type));
+  ringBuffer = new cRingBufferLinear(memory->Size() / TS_SIZE * TS_SIZE, MIN_TS_PACKETS_FOR_FRAME_DETECTOR * TS_SIZE, true, Name);
+  if (Device)
+     ringBuffer->SetNumaNode(Device->NumaNode());
+  ringBuffer->SetTimeouts(0, 100);
+  ringBuffer->SetSpsc();
+  ringBuffer->SetIoThrottle();
+  frameDetector = new cFrameDetector(pid, type);
+  if (Recorder->resumed)
+     frameDetector->SetLastPts(Recorder->lastPts);
+  brokenTimer.Set(MAXBROKENTIMEOUT);
+  working = false;
+  feeder = NULL;
+  handOver = false;
+  lastReceiver = NULL;
+}
+
+cRecorderStream::~cRecorderStream()
+{
+  Cancel(3);
+  isyslog("recording buffer of channel %s: %d MB, max. %d%% used, %d overflow%s (%" PRId64 " bytes dropped)", *channelID.ToString(), int(ringBuffer->Size() / MEGABYTE(1)), int(int64_t(ringBuffer->MaxFill()) * 100 / ringBuffer->Size()), ringBuffer->Overflows(), ringBuffer->Overflows() != 1 ? "s" : "", ringBuffer->OverflowBytes());
+  delete frameDetector;
+  delete ringBuffer;
+  delete memory;
+}
+
+cRecorderStream *cRecorderStream::Join(cRecorder *Recorder, cDevice *Device)
+{
+  cMutexLock MutexLock(&streamsMutex);
+  cRecorderStream *Stream = NULL;
+  if (!Recorder->resumed) {
+     for (int i = 0; i < streams.Size(); i++) {
+         cRecorderStream *s = streams[i];
+         if (s->shared && s->device == Device && s->channelID == Recorder->ChannelID() && s->pid == Recorder->pid && s->type == Recorder->type) {
+            Stream = s;
+            dsyslog("%s: sharing the data stream of channel %s", Recorder->recordingName, *Recorder->ChannelID().ToString());
+            break;
+            }
+         }
+     }
+  if (!Stream) {
+     Stream = new cRecorderStream(Device, Recorder);
+     streams.Append(Stream);
+     Stream->working = true; // the data may arrive before the thread is running
+     Stream->Start();
+     }
+  Stream->references++;
+  Stream->mutex.Lock();
+  Recorder->errorBase = Stream->frameDetector->Errors();
+  Recorder->overflowBase = Stream->ringBuffer->Overflows();
+  Stream->recorders.Append(Recorder);
+  Stream->mutex.Unlock();
+  Stream->receiveMutex.Lock();
+  if (!Stream->feeder && !Stream->handOver)
+     Stream->feeder = Recorder;
+  Stream->receiveMutex.Unlock();
+  return Stream;
+}
+
+void cRecorderStream::Unref(cRecorderStream *Stream)
+{
+  streamsMutex.Lock();
+  bool Last = --Stream->references == 0;
+  if (Last)
+     streams.RemoveElement(Stream);
+  streamsMutex.Unlock();
+  if (Last)
+     delete Stream;
+}
+
+void cRecorderStream::Remove(cRecorder *Recorder)
+{
+  // mutex must be locked!
+  if (!Recorder->left) {
+     if (!Recorder->finished) {
+        Recorder->Finish(frameDetector, brokenTimer.Elapsed());
+        Recorder->finished = true;
+        }
+     recorders.RemoveElement(Recorder);
+     Recorder->left = true;
+     cMutexLock MutexLock(&receiveMutex);
+     if (feeder == Recorder)
+        handOver = true; // it keeps delivering data until another recorder takes over
+     }
+}
+
+void cRecorderStream::Stop(cRecorder *Recorder)
+{
+  streamsMutex.Lock();
+  cRecorderStream *Stream = Recorder->stream;
+  if (Stream)
+     Stream->references++;
+  streamsMutex.Unlock();
+  if (Stream) {
+     Stream->mutex.Lock();
+     Recorder->stopping = true;
+     cTimeMs Timeout(MAXSTOPTIME * 1000);
+     while (!Recorder->finished && !Timeout.TimedOut())
+           Stream->recorderFinished.TimedWait(Stream->mutex, 100);
+     Stream->Remove(Recorder);
+     Stream->mutex.Unlock();
+     Unref(Stream);
+     }
+}
+
+void cRecorderStream::Release(cRecorder *Recorder)
+{
+  streamsMutex.Lock();
+  cRecorderStream *Stream = Recorder->stream;
+  Recorder->stream = NULL;
+  streamsMutex.Unlock();
+  if (Stream) {
+     Stream->mutex.Lock();
+     Stream->Remove(Recorder);
+     Stream->mutex.Unlock();
+     Stream->receiveMutex.Lock();
+     if (Stream->feeder == Recorder) {
+        Stream->feeder = NULL;
+        Stream->handOver = true;
+        }
+     if (Stream->lastReceiver == Recorder)
+        Stream->lastReceiver = NULL;
+     Stream->receiveMutex.Unlock();
+     Unref(Stream);
+     }
+}
+
+bool cRecorderStream::GetBufferStats(cRecorder *Recorder, int &Size, int &MaxFill, int &Overflows, int64_t &OverflowBytes)
+{
+  cMutexLock MutexLock(&streamsMutex);
+  if (cRecorderStream *Stream = Recorder->stream) {
+     Size = Stream->ringBuffer->Size();
+     MaxFill = Stream->ringBuffer->MaxFill();
+     Overflows = Stream->ringBuffer->Overflows();
+     OverflowBytes = Stream->ringBuffer->OverflowBytes();
+     return true;
+     }
+  return false;
+}
+
+void cRecorderStream::Receive(cRecorder *Recorder, const uchar *Data, int Length)
+{
+  cMutexLock MutexLock(&receiveMutex);
+  if (Recorder != feeder) {
+     // The device delivers each run of data to all recorders, one after the other.
+     // A new feeder takes over with the first run the previous one hasn't delivered:
+     if (!handOver || Recorder->left || feederRuns.IndexOf(Data) >= 0) {
+        lastReceiver = Recorder;
+        return;
+        }
+     feeder = Recorder;
+     handOver = false;
+     feederRuns.Clear();
+     }
+  if (lastReceiver != Recorder || feederRuns.Size() >= MAXFEEDERRUNS)
+     feederRuns.Clear(); // the device has started delivering its next chunk of data
+  lastReceiver = Recorder;
+  if (references > 1)
+     feederRuns.Append(Data);
+  if (working) {
+     static const uchar aff[TS_SIZE - 4] = { 0xB7, 0x00,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+       0xFF, 0xFF};
+     // Data may contain several TS packets, so we put runs of packets into the ring buffer
+     // in one go and only skip the Adaptation Field Fillers:
+     const uchar *Run = Data;
+     for (const uchar *d = Data; d < Data + Length; d += TS_SIZE) {
+         if ((d[3] & 0b00110000) == 0b00100000 && !memcmp(d + 4, aff, sizeof(aff))) { // Adaptation Field Filler found, skipping
+            if (d > Run)
+               PutData(Run, d - Run);
+            Run = d + TS_SIZE;
+            }
+         }
+     if (Run < Data + Length)
+        PutData(Run, Data + Length - Run);
+     }
+}
+
+void cRecorderStream::PutData(const uchar *Data, int Length)
+{
+  int p = ringBuffer->Put(Data, Length);
+  if (p != Length && working)
+     ringBuffer->ReportOverflow(Length - p);
+}
+
+void cRecorderStream::Action(void)
+{
+//#define TEST_VDSB 40000 // 40000 to test VDSB without restart, 70000 for VDSB with restart
+#ifdef TEST_VDSB
+  cTimeMs VdsbTimer;
+#endif
+  brokenTimer.Set(MAXBROKENTIMEOUT);
+  while (Running()) {
+#ifdef TEST_VDSB
+        int Vdsb = VdsbTimer.Elapsed();
+        if (Vdsb > 30000 && Vdsb < TEST_VDSB) {
+           working = false;
+           cCondWait::SleepMs(100);
+           }
+        working = true;
+#endif
+        int r;
+        uchar *b = ringBuffer->Get(r);
+        if (b) {
+           int Count = frameDetector->Analyze(b, r);
+           if (Count) {
+              cMutexLock MutexLock(&mutex);
+              for (int i = 0; i < recorders.Size(); i++) {
+                  cRecorder *Recorder = recorders[i];
+                  if (!Recorder->finished && !Recorder->Process(frameDetector, b, Count)) {
+                     Recorder->Finish(frameDetector, brokenTimer.Elapsed());
+                     Recorder->finished = true;
+                     recorderFinished.Broadcast();
+                     }
+                  }
+              if (frameDetector->Synced() && frameDetector->IndependentFrame())
+                 brokenTimer.Reset();
+              ringBuffer->Del(Count);
+              }
+           }
+        if (brokenTimer.TimedOut()) {
+           esyslog("ERROR: video data stream broken");
+           cMutexLock MutexLock(&mutex);
+           for (int i = 0; i < recorders.Size(); i++) {
+               cRecorder *Recorder = recorders[i];
+               if (!Recorder->finished)
+                  Recorder->StreamBroken(frameDetector, brokenTimer.Elapsed());
+               }
+           ShutdownHandler.RequestEmergencyExit();
+           brokenTimer.Reset();
+           }
+        }
+  working = false;
+}
+
 // --- cRecorder -------------------------------------------------------------
 
+cMutex cRecorder::recordersMutex;
+cVector<cRecorder *> cRecorder::recorders;
+
+cLatencyHistogram &cRecorder::WriteLatency(void)
+{
+  return RecorderWriteLatency;
+}
+
 cRecorder::cRecorder(const char *FileName, const cChannel *Channel, int Priority)
 :cReceiver(Channel, Priority)
-,cThread("recording")
 {
+  stream = NULL;
   recordingName = strdup(FileName);
   recordingInfo = new cRecordingInfo(recordingName);
   recordingInfo->Read();
   tmpErrors = recordingInfo->TmpErrors();
   oldErrors = max(0, recordingInfo->Errors()) - tmpErrors; // in case this is a re-started recording
   errors = 0;
+  errorBase = 0;
   lastErrors = oldErrors + tmpErrors;
-  working = false;
+  overflowBase = 0;
+  oldOverflows = recordingInfo->Overflows(); // in case this is a re-started recording
+  maxBufferFill = 0;
+  overflows = 0;
+  receiveStart = 0;
+  receiveSecond = 0;
+  bytesReceived = 0;
+  bytesThisSecond = 0;
+  maxBitRate = 0;
+  memset(lastCc, 0xFF, sizeof(lastCc));
+  if (const char *s = recordingInfo->ContinuityErrors()) {
+     int Pid, Errors, n;
+     while (sscanf(s, "%d:%d%n", &Pid, &Errors, &n) == 2) {
+           ccPids.Append(Pid);
+           ccErrors.Append(Errors);
+           s += n;
+           }
+     }
+  stopping = false;
+  finished = false;
+  left = false;
   firstIframeSeen = false;
+  infoWritten = false;
+  indexPending = false;
+  numIframesSeen = 0;
 
   // Make sure the disk is up and running:
 
   SpinUpDisk(FileName);
 
-  ringBuffer = new cRingBufferLinear(RECORDERBUFSIZE, MIN_TS_PACKETS_FOR_FRAME_DETECTOR * TS_SIZE, true, "Recorder");
-  ringBuffer->SetTimeouts(0, 100);
-  ringBuffer->SetIoThrottle();
+  SetMultiPacket(true);
 
-  int Pid = Channel->Vpid();
-  int Type = Channel->Vtype();
-  if (!Pid && Channel->Apid(0)) {
-     Pid = Channel->Apid(0);
-     Type = 0x04;
+  pid = Channel->Vpid();
+  type = Channel->Vtype();
+  if (!pid && Channel->Apid(0)) {
+     pid = Channel->Apid(0);
+     type = 0x04;
      }
-  if (!Pid && Channel->Dpid(0)) {
-     Pid = Channel->Dpid(0);
-     Type = 0x06;
+  if (!pid && Channel->Dpid(0)) {
+     pid = Channel->Dpid(0);
+     type = 0x06;
      }
-  frameDetector = new cFrameDetector(Pid, Type);
   index = NULL;
   fileSize = 0;
+  timeshiftSize = 0;
+  bytesWritten = 0;
   lastDiskSpaceCheck = time(NULL);
   lastErrorLog = 0;
+  writer = NULL;
+  lastPts = -1;
   fileName = new cFileName(FileName, true);
   // Check if this is a resumed recording, in which case we definitely missed frames:
-  NextFile();
-  if (fileName->Number() > 1 || oldErrors)
+  resumed = fileName->Number() > 1 || oldErrors;
+  if (resumed)
      GetLastPts(recordingName);
   patPmtGenerator.SetChannel(Channel);
-  recordFile = fileName->Open();
-  if (!recordFile)
+  recordersMutex.Lock();
+  recorders.Append(this);
+  recordersMutex.Unlock();
+  cUnbufferedFile *RecordFile = fileName->Open();
+  if (!RecordFile)
      return;
   // Create the index file:
   index = new cIndexFile(FileName, true);
   if (!index)
      esyslog("ERROR: can't allocate index");
      // let's continue without index, so we'll at least have the recording
+  writer = new cRecorderWriter(fileName, RecordFile, index);
 }
 
 cRecorder::~cRecorder()
 {
-  Cancel(3); // in case the caller didn't call Stop()
+  recordersMutex.Lock();
+  recorders.RemoveElement(this);
+  recordersMutex.Unlock();
+  UpdateStats(); // while the buffer statistics are still available
   Detach();
+  cRecorderStream::Release(this); // in case we have never been attached
+  if (writer) {
+     writer->Finish(); // writes whatever is still waiting in the queue
+     if (bytesWritten) {
+        UpdateStats();
+        recordingInfo->Write();
+        LOCK_RECORDINGS_WRITE;
+        Recordings->UpdateByName(recordingName);
+        }
+     }
+  delete writer;
   delete index;
   delete fileName;
-  delete frameDetector;
-  delete ringBuffer;
+  delete recordingInfo;
   free(recordingName);
 }
 
 void cRecorder::Stop(void)
 {
-  Cancel(3);
+  cRecorderStream::Stop(this);
+}
+
+bool cRecorder::GetBufferStats(int &Size, int &MaxFill, int &Overflows, int64_t &OverflowBytes)
+{
+  return cRecorderStream::GetBufferStats(this, Size, MaxFill, Overflows, OverflowBytes);
+}
+
+void cRecorder::AddMetrics(cMetrics &Metrics)
+{
+  cMutexLock MutexLock(&recordersMutex);
+  Metrics.Family("vdr_recording_written_bytes", "counter", "Bytes written by an active recording");
+  for (int i = 0; i < recorders.Size(); i++)
+      Metrics.Add(recorders[i]->BytesWritten(), cMetrics::Label("recording", recorders[i]->recordingName));
+  Metrics.Family("vdr_recording_errors", "gauge", "Errors (broken or missing frames) of an active recording");
+  for (int i = 0; i < recorders.Size(); i++)
+      Metrics.Add(recorders[i]->Errors(), cMetrics::Label("recording", recorders[i]->recordingName));
+}
+
+void cRecorder::CountReceived(int Length)
+{
+  time_t Now = time(NULL);
+  if (!receiveStart)
+     receiveStart = receiveSecond = Now;
+  if (Now != receiveSecond) {
+     // The first second is incomplete, so it doesn't count for the peak:
+     if (receiveSecond != receiveStart)
+        maxBitRate = max(maxBitRate, int(bytesThisSecond * 8 / 1000));
+     receiveSecond = Now;
+     bytesThisSecond = 0;
+     }
+  bytesReceived += Length;
+  bytesThisSecond += Length;
+}
+
+void cRecorder::CheckContinuity(const uchar *Data, int Length)
+{
+  for (const uchar *p = Data; p < Data + Length; p += TS_SIZE) {
+      if (TsHasPayload(p)) {
+         int Pid = TsPid(p);
+         uchar Cc = TsContinuityCounter(p);
+         uchar LastCc = lastCc[Pid];
+         if (LastCc != 0xFF && Cc != ((LastCc + 1) & TS_CONT_CNT_MASK) && Cc != LastCc) { // a repeated counter marks a duplicate packet
+            int i = ccPids.IndexOf(Pid);
+            if (i < 0) {
+               ccPids.Append(Pid);
+               ccErrors.Append(0);
+               i = ccPids.Size() - 1;
+               }
+            ccErrors[i]++;
+            }
+         lastCc[Pid] = Cc;
+         }
+      }
+}
+
+void cRecorder::UpdateStats(void)
+{
+  int Size, MaxFill, Overflows;
+  int64_t OverflowBytes;
+  if (GetBufferStats(Size, MaxFill, Overflows, OverflowBytes)) {
+     maxBufferFill = max(maxBufferFill, Size ? int(int64_t(MaxFill) * 100 / Size) : 0);
+     overflows = Overflows - overflowBase;
+     }
+  int Elapsed = receiveStart ? int(time(NULL) - receiveStart) : 0;
+  int BitRate = Elapsed > 0 ? int(bytesReceived * 8 / 1000 / Elapsed) : 0;
+  cString ContinuityErrors;
+  for (int i = 0; i < ccPids.Size(); i++)
+      ContinuityErrors.Append(cString::sprintf("%s%d:%d", i ? " " : "", ccPids[i], ccErrors[i]));
+  // The maximum values of a re-started recording also cover its previous parts:
+  recordingInfo->SetStats(BitRate,
+                          max(maxBitRate, recordingInfo->MaxBitRate()),
+                          max(maxBufferFill, recordingInfo->MaxBufferFill()),
+                          oldOverflows + overflows,
+                          max(writer ? writer->MaxLatency() / 1000 : 0, recordingInfo->MaxWriteLatency()),
+                          ContinuityErrors);
 }
 
 #define ERROR_LOG_DELTA 1 // seconds between logging errors
@@ -102,6 +997,7 @@ void cRecorder::HandleErrors(bool Force)
         int d = AllErrors - lastErrors;
         esyslog("%s: %d new error%s (total %d)", recordingName, d, d > 1 ? "s" : "", AllErrors);
         recordingInfo->SetErrors(AllErrors, tmpErrors);
+        UpdateStats();
         recordingInfo->Write();
         LOCK_RECORDINGS_WRITE;
         Recordings->UpdateByName(recordingName);
@@ -114,7 +1010,7 @@ void cRecorder::HandleErrors(bool Force)
 bool cRecorder::RunningLowOnDiskSpace(void)
 {
   if (time(NULL) > lastDiskSpaceCheck + DISKCHECKINTERVAL) {
-     int Free = FreeDiskSpaceMB(fileName->Name());
+     int Free = cVideoDiskUsage::AvailableMB();
      lastDiskSpaceCheck = time(NULL);
      if (Free < MINFREEDISKSPACE) {
         dsyslog("low disk space (%d MB, limit is %d MB)", Free, MINFREEDISKSPACE);
@@ -124,54 +1020,41 @@ bool cRecorder::RunningLowOnDiskSpace(void)
   return false;
 }
 
-bool cRecorder::NextFile(void)
+void cRecorder::SetTimeshiftSize(int SizeMB)
 {
-  if (recordFile && frameDetector->IndependentFrame()) { // every file shall start with an independent frame
-     if (fileSize > MEGABYTE(off_t(Setup.MaxVideoFileSize)) || RunningLowOnDiskSpace()) {
-        recordFile = fileName->NextFile();
+  timeshiftSize = MEGABYTE(off_t(SizeMB));
+  if (writer)
+     writer->SetMaxSize(timeshiftSize);
+}
+
+bool cRecorder::NeedNextFile(cFrameDetector *FrameDetector)
+{
+  if (FrameDetector->IndependentFrame()) { // every file shall start with an independent frame
+     // A time shift buffer is split into smaller files, so that it can be trimmed in small steps:
+     off_t MaxFileSize = timeshiftSize ? max(timeshiftSize / TIMESHIFTFILES, off_t(MEGABYTE(TIMESHIFTMINFILESIZE))) : MEGABYTE(off_t(Setup.MaxVideoFileSize));
+     if (fileSize > MaxFileSize || RunningLowOnDiskSpace()) {
         fileSize = 0;
+        return true;
         }
      }
-  return recordFile != NULL;
+  return false;
 }
 
 void cRecorder::Activate(bool On)
 {
-  if (On)
-     Start();
-  else
-     Cancel(3);
+  if (!On)
+     cRecorderStream::Release(this);
 }
 
 void cRecorder::Receive(const uchar *Data, int Length)
 {
-  if (working) {
-     static const uchar aff[TS_SIZE - 4] = { 0xB7, 0x00,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF}; // Length is always TS_SIZE!
-     if ((Data[3] & 0b00110000) == 0b00100000 && !memcmp(Data + 4, aff, sizeof(aff)))
-        return; // Adaptation Field Filler found, skipping
-     int p = ringBuffer->Put(Data, Length);
-     if (p != Length && working)
-        ringBuffer->ReportOverflow(Length - p);
+  CountReceived(Length);
+  if (!stream) {
+     if (left || !writer)
+        return;
+     stream = cRecorderStream::Join(this, Device());
      }
+  stream->Receive(this, Data, Length);
 }
 
 #define MIN_IFRAMES_FOR_LAST_PTS 2
@@ -222,125 +1105,95 @@ void cRecorder::GetLastPts(const char *RecordingName)
          else
             break;
          }
-     frameDetector->SetLastPts(LastPts);
+     lastPts = LastPts;
      delete FileName;
      delete Index;
      }
 }
 
-void cRecorder::Action(void)
+bool cRecorder::Process(cFrameDetector *FrameDetector, const uchar *Data, int Count)
 {
-//#define TEST_VDSB 40000 // 40000 to test VDSB without restart, 70000 for VDSB with restart
-#ifdef TEST_VDSB
-  cTimeMs VdsbTimer;
-#endif
-  cTimeMs t(MAXBROKENTIMEOUT);
-  bool InfoWritten = false;
-  bool pendIndependentFrame = false;
-  uint16_t pendNumber = 0;
-  off_t pendFileSize = 0;
-  bool pendMissing = false;
-  int NumIframesSeen = 0;
-  working = true;
-  while (true) {
-#ifdef TEST_VDSB
-        int Vdsb = VdsbTimer.Elapsed();
-        if (Vdsb > 30000 && Vdsb < TEST_VDSB) {
-           working = false;
-           cCondWait::SleepMs(100);
+  if (stopping && FrameDetector->IndependentFrame()) // finish the recording before the next independent frame
+     return false;
+  if (FrameDetector->Synced()) {
+     if (!infoWritten) {
+        if ((FrameDetector->FramesPerSecond() > 0 && DoubleEqual(recordingInfo->FramesPerSecond(), DEFAULTFRAMESPERSECOND) && !DoubleEqual(recordingInfo->FramesPerSecond(), FrameDetector->FramesPerSecond())) ||
+            FrameDetector->FrameWidth()  != recordingInfo->FrameWidth()  ||
+            FrameDetector->FrameHeight() != recordingInfo->FrameHeight() ||
+            FrameDetector->AspectRatio() != recordingInfo->AspectRatio()) {
+           recordingInfo->SetFramesPerSecond(FrameDetector->FramesPerSecond());
+           recordingInfo->SetFrameParams(FrameDetector->FrameWidth(), FrameDetector->FrameHeight(), FrameDetector->ScanType(), FrameDetector->AspectRatio());
+           UpdateStats();
+           recordingInfo->Write();
+           LOCK_RECORDINGS_WRITE;
+           Recordings->UpdateByName(recordingName);
            }
-        working = true;
-#endif
-        int r;
-        uchar *b = ringBuffer->Get(r);
-        if (b) {
-           int Count = frameDetector->Analyze(b, r);
-           if (Count) {
-              if (!Running() && frameDetector->IndependentFrame()) { // finish the recording before the next independent frame
-                 working = false;
-                 break;
-                 }
-              if (frameDetector->Synced()) {
-                 if (!InfoWritten) {
-                    if ((frameDetector->FramesPerSecond() > 0 && DoubleEqual(recordingInfo->FramesPerSecond(), DEFAULTFRAMESPERSECOND) && !DoubleEqual(recordingInfo->FramesPerSecond(), frameDetector->FramesPerSecond())) ||
-                        frameDetector->FrameWidth()  != recordingInfo->FrameWidth()  ||
-                        frameDetector->FrameHeight() != recordingInfo->FrameHeight() ||
-                        frameDetector->AspectRatio() != recordingInfo->AspectRatio()) {
-                       recordingInfo->SetFramesPerSecond(frameDetector->FramesPerSecond());
-                       recordingInfo->SetFrameParams(frameDetector->FrameWidth(), frameDetector->FrameHeight(), frameDetector->ScanType(), frameDetector->AspectRatio());
-                       recordingInfo->Write();
-                       LOCK_RECORDINGS_WRITE;
-                       Recordings->UpdateByName(recordingName);
-                       }
-                    InfoWritten = true;
-                    cRecordingUserCommand::InvokeCommand(RUC_STARTRECORDING, recordingName);
-                    }
-                 if (firstIframeSeen || frameDetector->IndependentFrame()) {
-                    firstIframeSeen = true; // start recording with the first I-frame
-                    if (!NextFile())
-                       break;
-                    bool PreviousErrors = false;
-                    bool MissingFrames = false;
-                    if (frameDetector->NewFrame(PreviousErrors, MissingFrames)) {
-                       if (index) {
-                          if (pendNumber > 0)
-                             index->Write(pendIndependentFrame, pendNumber, pendFileSize, PreviousErrors, pendMissing);
-                          pendIndependentFrame = frameDetector->IndependentFrame();
-                          pendNumber = fileName->Number();
-                          pendFileSize = fileSize;
-                          pendMissing = MissingFrames;
-                          }
-                       errors = frameDetector->Errors();
-                       }
-                    if (frameDetector->IndependentFrame()) {
-                       NumIframesSeen++;
-                       tmpErrors = 0;
-                       recordFile->Write(patPmtGenerator.GetPat(), TS_SIZE);
-                       fileSize += TS_SIZE;
-                       int Index = 0;
-                       while (uchar *pmt = patPmtGenerator.GetPmt(Index)) {
-                             recordFile->Write(pmt, TS_SIZE);
-                             fileSize += TS_SIZE;
-                             }
-                       t.Reset();
-                       }
-                    if (recordFile->Write(b, Count) < 0) {
-                       LOG_ERROR_STR(fileName->Name());
-                       break;
-                       }
-                    if (NumIframesSeen >= 2) // avoids extra log entry when resuming a recording
-                       HandleErrors();
-                    fileSize += Count;
-                    }
-                 }
-              ringBuffer->Del(Count);
-              }
+        infoWritten = true;
+        cRecordingUserCommand::InvokeCommand(RUC_STARTRECORDING, recordingName);
+        }
+     if (firstIframeSeen || FrameDetector->IndependentFrame()) {
+        firstIframeSeen = true; // start recording with the first I-frame
+        int Flags = NeedNextFile(FrameDetector) ? RW_NEXTFILE : 0;
+        bool PreviousErrors = false;
+        bool MissingFrames = false;
+        if (FrameDetector->NewFrame(PreviousErrors, MissingFrames)) {
+           Flags |= RW_NEWFRAME;
+           if (FrameDetector->IndependentFrame())
+              Flags |= RW_INDEPENDENT;
+           if (PreviousErrors)
+              Flags |= RW_PREVIOUSERRORS;
+           if (MissingFrames)
+              Flags |= RW_MISSING;
+           VDR_TRACE(recorder_frame, this, FrameDetector->IndependentFrame(), PreviousErrors, MissingFrames);
+           indexPending = true;
+           errors = FrameDetector->Errors() - errorBase;
            }
-        if (t.TimedOut()) {
-           esyslog("ERROR: video data stream broken");
-           tmpErrors += int(round(frameDetector->FramesPerSecond() * t.Elapsed() / 1000));
-           if (pendNumber > 0) {
-              bool PreviousErrors = false;
-              errors = frameDetector->Errors(&PreviousErrors);
-              index->Write(pendIndependentFrame, pendNumber, pendFileSize, PreviousErrors, pendMissing);
-              pendNumber = 0;
-              }
-           HandleErrors(true);
-           ShutdownHandler.RequestEmergencyExit();
-           t.Reset();
+        if (FrameDetector->IndependentFrame()) {
+           numIframesSeen++;
+           tmpErrors = 0;
+           int Length;
+           uchar *PatPmt = patPmtGenerator.GetPatPmt(Length);
+           if (!writer->Put(PatPmt, Length, Flags))
+              return false;
+           Flags = 0;
+           fileSize += Length;
+           bytesWritten += Length;
            }
-        if (!Running() && ShutdownHandler.EmergencyExitRequested())
-           break;
+        if (!writer->Put(Data, Count, Flags))
+           return false;
+        CheckContinuity(Data, Count);
+        if (numIframesSeen >= 2) // avoids extra log entry when resuming a recording
+           HandleErrors();
+        fileSize += Count;
+        bytesWritten += Count;
         }
+     }
+  return true;
+}
+
+void cRecorder::StreamBroken(cFrameDetector *FrameDetector, int Elapsed)
+{
+  tmpErrors += int(round(FrameDetector->FramesPerSecond() * Elapsed / 1000));
+  if (indexPending) {
+     bool PreviousErrors = false;
+     errors = FrameDetector->Errors(&PreviousErrors) - errorBase;
+     writer->Put(NULL, 0, RW_FLUSHINDEX | (PreviousErrors ? RW_PREVIOUSERRORS : 0));
+     indexPending = false;
+     }
+  HandleErrors(true);
+}
+
+void cRecorder::Finish(cFrameDetector *FrameDetector, int Elapsed)
+{
   // Estimate the number of missing frames in case the data stream was broken, but the timer
   // didn't reach the timeout, yet:
-  int dt = t.Elapsed();
-  if (dt > LEFTOVERTIMEOUT)
-     tmpErrors += int(round(frameDetector->FramesPerSecond() * dt / 1000));
-  if (pendNumber > 0) {
+  if (Elapsed > LEFTOVERTIMEOUT)
+     tmpErrors += int(round(FrameDetector->FramesPerSecond() * Elapsed / 1000));
+  if (indexPending) {
      bool PreviousErrors = false;
-     errors = frameDetector->Errors(&PreviousErrors);
-     index->Write(pendIndependentFrame, pendNumber, pendFileSize, PreviousErrors, pendMissing);
+     errors = FrameDetector->Errors(&PreviousErrors) - errorBase;
+     writer->Put(NULL, 0, RW_FLUSHINDEX | (PreviousErrors ? RW_PREVIOUSERRORS : 0));
+     indexPending = false;
      }
   HandleErrors(true);
 }
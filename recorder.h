@@ -16,29 +16,67 @@
 #include "ringbuffer.h"
 #include "thread.h"
 
-class cRecorder : public cReceiver, cThread {
+class cMetrics;
+class cRecorderWriter;
+class cRecorderStream;
+
+class cRecorder : public cReceiver {
+  friend class cRecorderStream;
 private:
-  cRingBufferLinear *ringBuffer;
-  cFrameDetector *frameDetector;
+  static cMutex recordersMutex;
+  static cVector<cRecorder *> recorders;
+  cRecorderStream *stream;
+  int pid;
+  int type;
+  bool resumed;
+  int64_t lastPts;
   cPatPmtGenerator patPmtGenerator;
   cFileName *fileName;
   cRecordingInfo *recordingInfo;
   cIndexFile *index;
-  cUnbufferedFile *recordFile;
+  cRecorderWriter *writer;
   char *recordingName;
-  bool working;
+  bool stopping;
+  bool finished;
+  bool left;
   bool firstIframeSeen;
+  bool infoWritten;
+  bool indexPending;
+  int numIframesSeen;
   off_t fileSize;
+  off_t timeshiftSize;
+  int64_t bytesWritten;
   time_t lastDiskSpaceCheck;
   time_t lastErrorLog;
   int oldErrors;
   int tmpErrors;
   int errors;
+  int errorBase;
   int lastErrors;
+  int overflowBase;
+  int oldOverflows;
+  int maxBufferFill;
+  int overflows;
+  time_t receiveStart;
+  time_t receiveSecond;
+  int64_t bytesReceived;
+  int64_t bytesThisSecond;
+  int maxBitRate;
+  uchar lastCc[MAXPID];
+  cVector<int> ccPids;
+  cVector<int> ccErrors;
   void GetLastPts(const char *RecordingName);
+  void CheckContinuity(const uchar *Data, int Length);
+  void CountReceived(int Length);
+  void UpdateStats(void);
+       ///< Stores the bit rates, the buffer and write statistics and the continuity
+       ///< errors measured so far in the recording's info.
   bool RunningLowOnDiskSpace(void);
-  bool NextFile(void);
+  bool NeedNextFile(cFrameDetector *FrameDetector);
   void HandleErrors(bool Force = false);
+  bool Process(cFrameDetector *FrameDetector, const uchar *Data, int Count);
+  void StreamBroken(cFrameDetector *FrameDetector, int Elapsed);
+  void Finish(cFrameDetector *FrameDetector, int Elapsed);
 protected:
   virtual void Activate(bool On) override;
        ///< If you override Activate() you need to call Detach() (which is a
@@ -46,20 +84,40 @@ protected:
        ///< to properly get a call to Activate(false) when your object is
        ///< destroyed.
   virtual void Receive(const uchar *Data, int Length) override;
-  virtual void Action(void) override;
 public:
   cRecorder(const char *FileName, const cChannel *Channel, int Priority);
        ///< Creates a new recorder for the given Channel and
        ///< the given Priority that will record into the file FileName.
+       ///< If several recorders record the same channel from the same device,
+       ///< they share the buffering and frame detection of the data stream.
   virtual ~cRecorder() override;
   void Stop(void);
        ///< Stops the recorder. Call this before calling Errors() to allow the recording
-       ///< thread to end gracefully.
+       ///< to end gracefully.
+  void SetTimeshiftSize(int SizeMB);
+       ///< Turns this recording into a time shift buffer that holds about the last
+       ///< SizeMB megabytes of data, by removing its oldest files as new ones are
+       ///< written. A SizeMB of 0 turns it back into a regular recording, which
+       ///< keeps whatever is left of the buffer.
+  bool GetBufferStats(int &Size, int &MaxFill, int &Overflows, int64_t &OverflowBytes);
+       ///< Returns the Size of the ring buffer this recorder uses, the highest number of
+       ///< bytes it has held so far (MaxFill), and how many times (Overflows) and how
+       ///< much data (OverflowBytes) had to be dropped because it was full. If several
+       ///< recorders share the same data stream, they also share these values.
+       ///< Returns false if the recorder hasn't received any data, yet.
   int Errors(void) { return oldErrors + errors + tmpErrors; };
        ///< Returns the number of errors that were detected during recording.
        ///< Each frame that is missing or contains (any number of) errors counts as one error.
        ///< If this is a resumed recording, this includes errors that occurred
        ///< in the previous parts.
+  int64_t BytesWritten(void) { return bytesWritten; }
+       ///< Returns the number of bytes this recorder has written so far.
+  static void AddMetrics(cMetrics &Metrics);
+       ///< Adds the number of bytes written and errors of all active recorders
+       ///< to Metrics.
+  static cLatencyHistogram &WriteLatency(void);
+       ///< Returns the histogram of the time each write to the file of any
+       ///< recording has taken.
   };
 
 #endif //__RECORDER_H
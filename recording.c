@@ -14,20 +14,28 @@
 #include <fcntl.h>
 #define __STDC_FORMAT_MACROS // Required for format specifiers
 #include <inttypes.h>
+#include <linux/fs.h>
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include "channels.h"
 #include "cutter.h"
+#include "device.h"
 #include "i18n.h"
 #include "interface.h"
 #include "menu.h"
 #include "ringbuffer.h"
 #include "skins.h"
+#include "startup.h"
 #include "svdrp.h"
+#include "taskpool.h"
 #include "tools.h"
+#include "trace.h"
 #include "videodir.h"
 
 #define SUMMARYFALLBACK
@@ -66,6 +74,7 @@
 #define REMOVELATENCY      10 // seconds to wait until next check after removing a file
 #define MARKSUPDATEDELTA   10 // seconds between checks for updating editing marks
 #define MAXREMOVETIME      10 // seconds after which to return from removing deleted recordings
+#define REMOVESTEPDELAY   100 // ms to wait after each step when gradually truncating large files
 
 #define MAX_LINK_LEVEL  6
 
@@ -76,21 +85,52 @@ int DirectoryNameMax = NAME_MAX;
 bool DirectoryEncoding = false;
 int InstanceId = 0;
 
-// --- cRemoveDeletedRecordingsThread ----------------------------------------
+// --- cRemoveDeletedRecordingsTask ------------------------------------------
 
-class cRemoveDeletedRecordingsThread : public cThread {
+class cRemoveDeletedRecordingsTask : public cTask {
+private:
+  bool Shrink(const char *DirName, time_t StartTime);
 protected:
   virtual void Action(void) override;
 public:
-  cRemoveDeletedRecordingsThread(void);
+  cRemoveDeletedRecordingsTask(void);
   };
 
-cRemoveDeletedRecordingsThread::cRemoveDeletedRecordingsThread(void)
-:cThread("remove deleted recordings", true)
+cRemoveDeletedRecordingsTask::cRemoveDeletedRecordingsTask(void)
+:cTask(tpLow)
+{
+}
+
+bool cRemoveDeletedRecordingsTask::Shrink(const char *DirName, time_t StartTime)
 {
+  // Truncates the large files in the given directory step by step, so that the
+  // file system doesn't stall for a long time when they are finally removed:
+  off_t Step = off_t(MEGABYTE(Setup.RemoveStepSize));
+  cReadDir d(DirName);
+  struct dirent *e;
+  while ((e = d.Next()) != NULL) {
+        cString FileName = AddDirectory(DirName, e->d_name);
+        struct stat st;
+        if (stat(FileName, &st) == 0 && S_ISREG(st.st_mode)) { // follows symbolic links
+           off_t Size = st.st_size;
+           while (Size > Step) {
+                 if (!Running() || time(NULL) - StartTime > MAXREMOVETIME || cRecordControls::Active())
+                    return false;
+                 if (!cIoThrottle::Engaged()) {
+                    Size -= Step;
+                    if (truncate(FileName, Size) < 0) {
+                       LOG_ERROR_STR(*FileName);
+                       break;
+                       }
+                    }
+                 cCondWait::SleepMs(REMOVESTEPDELAY);
+                 }
+           }
+        }
+  return true;
 }
 
-void cRemoveDeletedRecordingsThread::Action(void)
+void cRemoveDeletedRecordingsTask::Action(void)
 {
   // Make sure only one instance of VDR does this:
   cLockFile LockFile(cVideoDirectory::Name());
@@ -98,6 +138,28 @@ void cRemoveDeletedRecordingsThread::Action(void)
      time_t StartTime = time(NULL);
      bool deleted = false;
      bool interrupted = false;
+     bool Gradually = Setup.RemoveStepSize > 0;
+     cStringList Shrunk;
+     if (Gradually) {
+        if (cRecordControls::Active())
+           return; // we'll try again when no recording is active
+        cStringList FileNames;
+        {
+          LOCK_DELETEDRECORDINGS_READ;
+          for (const cRecording *r = DeletedRecordings->First(); r; r = DeletedRecordings->Next(r)) {
+              if (r->RetentionExpired())
+                 FileNames.Append(strdup(r->FileName()));
+              }
+        }
+        // This is done without holding a lock, since it may take a while:
+        for (int i = 0; i < FileNames.Size(); i++) {
+            if (!Shrink(FileNames[i], StartTime)) {
+               interrupted = true;
+               break;
+               }
+            Shrunk.Append(strdup(FileNames[i]));
+            }
+        }
      LOCK_DELETEDRECORDINGS_WRITE;
      for (cRecording *r = DeletedRecordings->First(); r; ) {
          if (cIoThrottle::Engaged())
@@ -106,9 +168,9 @@ void cRemoveDeletedRecordingsThread::Action(void)
             interrupted = true; // don't stay here too long
          else if (cRemote::HasKeys())
             interrupted = true; // react immediately on user input
-         if (interrupted)
+         if (interrupted && !Gradually)
             break;
-         if (r->RetentionExpired()) {
+         if (r->RetentionExpired() && (!Gradually || Shrunk.Find(r->FileName()) >= 0)) {
             cRecording *next = DeletedRecordings->Next(r);
             r->Remove();
             DeletedRecordings->Del(r);
@@ -128,7 +190,7 @@ void cRemoveDeletedRecordingsThread::Action(void)
      }
 }
 
-static cRemoveDeletedRecordingsThread RemoveDeletedRecordingsThread;
+static cRemoveDeletedRecordingsTask RemoveDeletedRecordingsTask;
 
 // ---
 
@@ -136,11 +198,11 @@ void RemoveDeletedRecordings(void)
 {
   static time_t LastRemoveCheck = 0;
   if (time(NULL) - LastRemoveCheck > REMOVECHECKDELTA) {
-     if (!RemoveDeletedRecordingsThread.Active()) {
+     if (!RemoveDeletedRecordingsTask.Active()) {
         LOCK_DELETEDRECORDINGS_READ;
         for (const cRecording *r = DeletedRecordings->First(); r; r = DeletedRecordings->Next(r)) {
             if (r->RetentionExpired()) {
-               RemoveDeletedRecordingsThread.Start();
+               RemoveDeletedRecordingsTask.Start();
                break;
                }
             }
@@ -369,6 +431,12 @@ cRecordingInfo::cRecordingInfo(const cChannel *Channel, const cEvent *Event)
   aspectRatio = arUnknown;
   priority = MAXPRIORITY;
   lifetime = MAXLIFETIME;
+  bitRate = 0;
+  maxBitRate = 0;
+  maxBufferFill = 0;
+  overflows = 0;
+  maxWriteLatency = 0;
+  continuityErrors = NULL;
   fileName = NULL;
   errors = -1;
   if (Channel) {
@@ -436,6 +504,12 @@ cRecordingInfo::cRecordingInfo(const char *FileName)
   aspectRatio = arUnknown;
   priority = MAXPRIORITY;
   lifetime = MAXLIFETIME;
+  bitRate = 0;
+  maxBitRate = 0;
+  maxBufferFill = 0;
+  overflows = 0;
+  maxWriteLatency = 0;
+  continuityErrors = NULL;
   fileName = strdup(cString::sprintf("%s%s", FileName, INFOFILESUFFIX));
 }
 
@@ -444,6 +518,7 @@ cRecordingInfo::~cRecordingInfo()
   delete ownEvent;
   free(aux);
   free(channelName);
+  free(continuityErrors);
   free(fileName);
 }
 
@@ -499,6 +574,17 @@ void cRecordingInfo::SetErrors(int Errors, int TmpErrors)
   tmpErrors = TmpErrors;
 }
 
+void cRecordingInfo::SetStats(int BitRate, int MaxBitRate, int MaxBufferFill, int Overflows, int MaxWriteLatency, const char *ContinuityErrors)
+{
+  bitRate = BitRate;
+  maxBitRate = MaxBitRate;
+  maxBufferFill = MaxBufferFill;
+  overflows = Overflows;
+  maxWriteLatency = MaxWriteLatency;
+  free(continuityErrors);
+  continuityErrors = !isempty(ContinuityErrors) ? strdup(ContinuityErrors) : NULL;
+}
+
 bool cRecordingInfo::Read(FILE *f, bool Force)
 {
   if (ownEvent) {
@@ -516,93 +602,108 @@ bool cRecordingInfo::Read(FILE *f, bool Force)
      char *s;
      int line = 0;
      while ((s = ReadLine.Read(f)) != NULL) {
-           ++line;
-           char *t = skipspace(s + 1);
-           switch (*s) {
-             case 'C': {
-                         char *p = strchr(t, ' ');
-                         if (p) {
-                            free(channelName);
-                            channelName = strdup(compactspace(p));
-                            *p = 0; // strips optional channel name
-                            }
-                         if (*t)
-                            channelID = tChannelID::FromString(t);
-                       }
-                       break;
-             case 'E': {
-                         unsigned int EventID;
-                         intmax_t StartTime; // actually time_t, but intmax_t for scanning with "%jd"
-                         int Duration;
-                         unsigned int TableID = 0;
-                         unsigned int Version = 0xFF;
-                         int n = sscanf(t, "%u %jd %d %X %X", &EventID, &StartTime, &Duration, &TableID, &Version);
-                         if (n >= 3 && n <= 5) {
-                            ownEvent->SetEventID(EventID);
-                            ownEvent->SetStartTime(StartTime);
-                            ownEvent->SetDuration(Duration);
-                            ownEvent->SetTableID(uchar(TableID));
-                            ownEvent->SetVersion(uchar(Version));
-                            ownEvent->SetComponents(NULL);
-                            }
-                       }
-                       break;
-             case 'F': {
-                         char *fpsBuf = NULL;
-                         char scanTypeCode;
-                         char *arBuf = NULL;
-                         int n = sscanf(t, "%m[^ ] %hu %hu %c %m[^\n]", &fpsBuf, &frameWidth, &frameHeight, &scanTypeCode, &arBuf);
-                         if (n >= 1) {
-                            framesPerSecond = atod(fpsBuf);
-                            if (n >= 4) {
-                               scanType = stUnknown;
-                               for (int st = stUnknown + 1; st < stMax; st++) {
-                                   if (ScanTypeChars[st] == scanTypeCode) {
-                                      scanType = eScanType(st);
-                                      break;
-                                      }
-                                   }
-                               aspectRatio = arUnknown;
-                               if (n == 5) {
-                                  for (int ar = arUnknown + 1; ar < arMax; ar++) {
-                                      if (strcmp(arBuf, AspectRatioTexts[ar]) == 0) {
-                                         aspectRatio = eAspectRatio(ar);
-                                         break;
-                                         }
-                                      }
-                                  }
-                               }
-                            }
-                         free(fpsBuf);
-                         free(arBuf);
-                       }
-                       break;
-             case 'L': lifetime = atoi(t);
-                       break;
-             case 'P': priority = atoi(t);
-                       break;
-             case 'O': errors = atoi(t);
-                       if (t = strchr(t, ' '))
-                          tmpErrors = atoi(t);
-                       else
-                          tmpErrors = 0;
-                       break;
-             case '@': free(aux);
-                       aux = strdup(t);
-                       break;
-             case '#': break; // comments are ignored
-             default: if (!ownEvent->Parse(s)) {
-                         esyslog("ERROR: EPG data problem in line %d", line);
-                         return false;
-                         }
-                      break;
-             }
+           if (!Parse(s, ++line))
+              return false;
            }
      return true;
      }
   return false;
 }
 
+bool cRecordingInfo::Parse(char *s, int Line)
+{
+  char *t = skipspace(s + 1);
+  switch (*s) {
+    case 'C': {
+                char *p = strchr(t, ' ');
+                if (p) {
+                   free(channelName);
+                   channelName = strdup(compactspace(p));
+                   *p = 0; // strips optional channel name
+                   }
+                if (*t)
+                   channelID = tChannelID::FromString(t);
+              }
+              break;
+    case 'E': {
+                unsigned int EventID;
+                intmax_t StartTime; // actually time_t, but intmax_t for scanning with "%jd"
+                int Duration;
+                unsigned int TableID = 0;
+                unsigned int Version = 0xFF;
+                int n = sscanf(t, "%u %jd %d %X %X", &EventID, &StartTime, &Duration, &TableID, &Version);
+                if (n >= 3 && n <= 5) {
+                   ownEvent->SetEventID(EventID);
+                   ownEvent->SetStartTime(StartTime);
+                   ownEvent->SetDuration(Duration);
+                   ownEvent->SetTableID(uchar(TableID));
+                   ownEvent->SetVersion(uchar(Version));
+                   ownEvent->SetComponents(NULL);
+                   }
+              }
+              break;
+    case 'F': {
+                char *fpsBuf = NULL;
+                char scanTypeCode;
+                char *arBuf = NULL;
+                int n = sscanf(t, "%m[^ ] %hu %hu %c %m[^\n]", &fpsBuf, &frameWidth, &frameHeight, &scanTypeCode, &arBuf);
+                if (n >= 1) {
+                   framesPerSecond = atod(fpsBuf);
+                   if (n >= 4) {
+                      scanType = stUnknown;
+                      for (int st = stUnknown + 1; st < stMax; st++) {
+                          if (ScanTypeChars[st] == scanTypeCode) {
+                             scanType = eScanType(st);
+                             break;
+                             }
+                          }
+                      aspectRatio = arUnknown;
+                      if (n == 5) {
+                         for (int ar = arUnknown + 1; ar < arMax; ar++) {
+                             if (strcmp(arBuf, AspectRatioTexts[ar]) == 0) {
+                                aspectRatio = eAspectRatio(ar);
+                                break;
+                                }
+                             }
+                         }
+                      }
+                   }
+                free(fpsBuf);
+                free(arBuf);
+              }
+              break;
+    case 'L': lifetime = atoi(t);
+              break;
+    case 'P': priority = atoi(t);
+              break;
+    case 'O': errors = atoi(t);
+              if (t = strchr(t, ' '))
+                 tmpErrors = atoi(t);
+              else
+                 tmpErrors = 0;
+              break;
+    case 'B': bitRate = maxBitRate = 0;
+              sscanf(t, "%d %d", &bitRate, &maxBitRate);
+              break;
+    case 'W': maxBufferFill = overflows = maxWriteLatency = 0;
+              sscanf(t, "%d %d %d", &maxBufferFill, &overflows, &maxWriteLatency);
+              break;
+    case 'Q': free(continuityErrors);
+              continuityErrors = strdup(t);
+              break;
+    case '@': free(aux);
+              aux = strdup(t);
+              break;
+    case '#': break; // comments are ignored
+    default: if (!ownEvent->Parse(s)) {
+                esyslog("ERROR: EPG data problem in line %d", Line);
+                return false;
+                }
+             break;
+    }
+  return true;
+}
+
 bool cRecordingInfo::Write(FILE *f, const char *Prefix) const
 {
   if (channelID.Valid())
@@ -618,6 +719,12 @@ bool cRecordingInfo::Write(FILE *f, const char *Prefix) const
   if (tmpErrors)
      fprintf(f, " %d", tmpErrors);
   fprintf(f, "\n");
+  if (maxBitRate > 0) {
+     fprintf(f, "%sB %d %d\n", Prefix, bitRate, maxBitRate);
+     fprintf(f, "%sW %d %d %d\n", Prefix, maxBufferFill, overflows, maxWriteLatency);
+     }
+  if (continuityErrors)
+     fprintf(f, "%sQ %s\n", Prefix, continuityErrors);
   if (aux)
      fprintf(f, "%s@ %s\n", Prefix, aux);
   return true;
@@ -890,6 +997,7 @@ cRecording::cRecording(cTimer *Timer, const cEvent *Event)
   isOnVideoDirectoryFileSystem = -1; // unknown
   numFrames = -1;
   deleted = 0;
+  dirModified = 0;
   // set up the actual name:
   const char *Title = Event ? Event->Title() : NULL;
   const char *Subtitle = Event ? Event->ShortText() : NULL;
@@ -926,6 +1034,10 @@ cRecording::cRecording(cTimer *Timer, const cEvent *Event)
   info->SetAux(Timer->Aux());
   info->SetPriority(Timer->Priority());
   info->SetLifetime(Timer->Lifetime());
+  infoLoaded = true;
+  hasSummary = false;
+  hashedIn = NULL;
+  hashedId = 0;
 }
 
 cRecording::cRecording(const char *FileName)
@@ -939,6 +1051,11 @@ cRecording::cRecording(const char *FileName)
   isOnVideoDirectoryFileSystem = -1; // unknown
   numFrames = -1;
   deleted = 0;
+  dirModified = 0;
+  infoLoaded = false;
+  hasSummary = false;
+  hashedIn = NULL;
+  hashedId = 0;
   titleBuffer = NULL;
   sortBufferName = sortBufferTime = NULL;
   FileName = fileName = strdup(FileName);
@@ -968,87 +1085,119 @@ cRecording::cRecording(const char *FileName)
         name[p - FileName] = 0;
         name = ExchangeChars(name, false);
         isPesRecording = instanceId < 0;
-        }
-     else
-        return;
-     GetResume();
-     // read an optional info file:
-     cString InfoFileName = cString::sprintf("%s%s", fileName, isPesRecording ? INFOFILESUFFIX ".vdr" : INFOFILESUFFIX);
-     FILE *f = fopen(InfoFileName, "r");
-     if (f) {
-        if (!info->Read(f))
-           esyslog("ERROR: EPG data problem in file %s", *InfoFileName);
-        else if (isPesRecording) {
+        if (isPesRecording) {
            info->SetPriority(priority);
            info->SetLifetime(lifetime);
            }
-        fclose(f);
         }
-     else if (errno != ENOENT)
-        LOG_ERROR_STR(*InfoFileName);
+     }
+}
+
+cMutex cRecording::infoMutex;
+
+void cRecording::ReadInfoFile(void) const
+{
+  if (!name) {
+     infoLoaded = true; // not a valid recording
+     return;
+     }
+  // read an optional info file:
+  cString InfoFileName = cString::sprintf("%s%s", fileName, isPesRecording ? INFOFILESUFFIX ".vdr" : INFOFILESUFFIX);
+  FILE *f = fopen(InfoFileName, "r");
+  if (f) {
+     // the priority and lifetime of PES recordings are taken from the file name:
+     int Priority = info->Priority();
+     int Lifetime = info->Lifetime();
+     if (!info->Read(f))
+        esyslog("ERROR: EPG data problem in file %s", *InfoFileName);
+     else if (isPesRecording) {
+        info->SetPriority(Priority);
+        info->SetLifetime(Lifetime);
+        }
+     fclose(f);
+     }
+  else if (errno != ENOENT)
+     LOG_ERROR_STR(*InfoFileName);
 #ifdef SUMMARYFALLBACK
-     // fall back to the old 'summary.vdr' if there was no 'info.vdr':
-     if (isempty(info->Title())) {
-        cString SummaryFileName = cString::sprintf("%s%s", fileName, SUMMARYFILESUFFIX);
-        FILE *f = fopen(SummaryFileName, "r");
-        if (f) {
-           int line = 0;
-           char *data[3] = { NULL };
-           cReadLine ReadLine;
-           char *s;
-           while ((s = ReadLine.Read(f)) != NULL) {
-                 if (*s || line > 1) {
-                    if (data[line]) {
-                       int len = strlen(s);
-                       len += strlen(data[line]) + 1;
-                       if (char *NewBuffer = (char *)realloc(data[line], len + 1)) {
-                          data[line] = NewBuffer;
-                          strcat(data[line], "\n");
-                          strcat(data[line], s);
-                          }
-                       else
-                          esyslog("ERROR: out of memory");
+  // fall back to the old 'summary.vdr' if there was no 'info.vdr':
+  if (isempty(info->Title())) {
+     cString SummaryFileName = cString::sprintf("%s%s", fileName, SUMMARYFILESUFFIX);
+     FILE *f = fopen(SummaryFileName, "r");
+     if (f) {
+        int line = 0;
+        char *data[3] = { NULL };
+        cReadLine ReadLine;
+        char *s;
+        while ((s = ReadLine.Read(f)) != NULL) {
+              if (*s || line > 1) {
+                 if (data[line]) {
+                    int len = strlen(s);
+                    len += strlen(data[line]) + 1;
+                    if (char *NewBuffer = (char *)realloc(data[line], len + 1)) {
+                       data[line] = NewBuffer;
+                       strcat(data[line], "\n");
+                       strcat(data[line], s);
                        }
                     else
-                       data[line] = strdup(s);
+                       esyslog("ERROR: out of memory");
                     }
                  else
-                    line++;
+                    data[line] = strdup(s);
                  }
-           fclose(f);
-           if (!data[2]) {
-              data[2] = data[1];
-              data[1] = NULL;
+              else
+                 line++;
               }
-           else if (data[1] && data[2]) {
-              // if line 1 is too long, it can't be the short text,
-              // so assume the short text is missing and concatenate
-              // line 1 and line 2 to be the long text:
-              int len = strlen(data[1]);
-              if (len > 80) {
-                 if (char *NewBuffer = (char *)realloc(data[1], len + 1 + strlen(data[2]) + 1)) {
-                    data[1] = NewBuffer;
-                    strcat(data[1], "\n");
-                    strcat(data[1], data[2]);
-                    free(data[2]);
-                    data[2] = data[1];
-                    data[1] = NULL;
-                    }
-                 else
-                    esyslog("ERROR: out of memory");
+        fclose(f);
+        if (!data[2]) {
+           data[2] = data[1];
+           data[1] = NULL;
+           }
+        else if (data[1] && data[2]) {
+           // if line 1 is too long, it can't be the short text,
+           // so assume the short text is missing and concatenate
+           // line 1 and line 2 to be the long text:
+           int len = strlen(data[1]);
+           if (len > 80) {
+              if (char *NewBuffer = (char *)realloc(data[1], len + 1 + strlen(data[2]) + 1)) {
+                 data[1] = NewBuffer;
+                 strcat(data[1], "\n");
+                 strcat(data[1], data[2]);
+                 free(data[2]);
+                 data[2] = data[1];
+                 data[1] = NULL;
                  }
+              else
+                 esyslog("ERROR: out of memory");
               }
-           info->SetData(data[0], data[1], data[2]);
-           for (int i = 0; i < 3; i ++)
-               free(data[i]);
            }
-        else if (errno != ENOENT)
-           LOG_ERROR_STR(*SummaryFileName);
+        info->SetData(data[0], data[1], data[2]);
+        for (int i = 0; i < 3; i ++)
+            free(data[i]);
         }
+     else if (errno != ENOENT)
+        LOG_ERROR_STR(*SummaryFileName);
+     }
 #endif
-     if (isempty(info->Title()))
-        info->ownEvent->SetTitle(strgetlast(name, FOLDERDELIMCHAR));
+  if (isempty(info->Title()))
+     info->ownEvent->SetTitle(strgetlast(name, FOLDERDELIMCHAR));
+  infoLoaded = true;
+}
+
+const cRecordingInfo *cRecording::Summary(void) const
+{
+  if (hasSummary)
+     return info;
+  return Info();
+}
+
+cRecordingInfo *cRecording::Info(void) const
+{
+  if (!infoLoaded) {
+     cMutexLock MutexLock(&infoMutex);
+     if (!infoLoaded)
+        ReadInfoFile();
      }
+  return info;
 }
 
 cRecording::~cRecording()
@@ -1090,11 +1239,11 @@ char *cRecording::StripEpisodeName(char *s, bool Strip)
   return s;
 }
 
-char *cRecording::SortName(void) const
+char *cRecording::SortName(eRecordingsSortMode SortMode) const
 {
-  char **sb = (RecordingsSortMode == rsmName) ? &sortBufferName : &sortBufferTime;
+  char **sb = (SortMode == rsmName) ? &sortBufferName : &sortBufferTime;
   if (!*sb) {
-     if (RecordingsSortMode == rsmTime && !Setup.RecordingDirs) {
+     if (SortMode == rsmTime && !Setup.RecordingDirs) {
         char buf[32];
         struct tm tm_r;
         strftime(buf, sizeof(buf), "%Y%m%d%H%I", localtime_r(&start, &tm_r));
@@ -1102,8 +1251,8 @@ char *cRecording::SortName(void) const
         }
      else {
         char *s = strdup(FileName() + strlen(cVideoDirectory::Name()));
-        if (RecordingsSortMode != rsmName || Setup.AlwaysSortFoldersFirst)
-           s = StripEpisodeName(s, RecordingsSortMode != rsmName);
+        if (SortMode != rsmName || Setup.AlwaysSortFoldersFirst)
+           s = StripEpisodeName(s, SortMode != rsmName);
         strreplace(s, '/', (Setup.RecSortingDirection == rsdAscending) ? '0' : '1'); // some locales ignore '/' when sorting
         int l = strxfrm(NULL, s, 0) + 1;
         *sb = MALLOC(char, l);
@@ -1153,9 +1302,9 @@ int cRecording::Compare(const cListObject &ListObject) const
 {
   cRecording *r = (cRecording *)&ListObject;
   if (Setup.RecSortingDirection == rsdAscending)
-     return strcmp(SortName(), r->SortName());
+     return strcmp(SortName(RecordingsSortMode), r->SortName(RecordingsSortMode));
   else
-     return strcmp(r->SortName(), SortName());
+     return strcmp(r->SortName(RecordingsSortMode), SortName(RecordingsSortMode));
 }
 
 bool cRecording::IsInPath(const char *Path) const
@@ -1199,7 +1348,7 @@ const char *cRecording::FileName(void) const
 const char *cRecording::Title(char Delimiter, bool NewIndicator, int Level) const
 {
   const char *New = NewIndicator && IsNew() ? "*" : "";
-  const char *Err = NewIndicator && (info->Errors() > 0) ? "!" : "";
+  const char *Err = NewIndicator && (Summary()->Errors() > 0) ? "!" : "";
   free(titleBuffer);
   titleBuffer = NULL;
   if (Level < 0 || Level == HierarchyLevels()) {
@@ -1306,11 +1455,15 @@ bool cRecording::DeleteMarks(void)
 
 void cRecording::ReadInfo(bool Force)
 {
-  info->Read(Force);
+  if (infoLoaded)
+     info->Read(Force);
+  else
+     Info();
 }
 
 bool cRecording::WriteInfo(const char *OtherFileName)
 {
+  Info(); // makes sure the info file has been read
   cString InfoFileName = cString::sprintf("%s%s", OtherFileName ? OtherFileName : FileName(), isPesRecording ? INFOFILESUFFIX ".vdr" : INFOFILESUFFIX);
   if (!OtherFileName) {
      // Let's keep the error counter if this is a re-started recording:
@@ -1330,15 +1483,28 @@ bool cRecording::WriteInfo(const char *OtherFileName)
   return true;
 }
 
+void cRecording::FileNameChanged(void)
+{
+  ClearSortName();
+  if (hashedIn) {
+     cRecordings *Recordings = hashedIn;
+     Recordings->UnhashRecording(this);
+     Recordings->HashRecording(this);
+     Recordings->ResortRecording(this);
+     }
+}
+
 void cRecording::SetStartTime(time_t Start)
 {
   start = Start;
   free(fileName);
   fileName = NULL;
+  FileNameChanged();
 }
 
 bool cRecording::ChangePriorityLifetime(int NewPriority, int NewLifetime)
 {
+  Info(); // makes sure the info file has been read
   if (NewPriority != Priority() || NewLifetime != Lifetime()) {
      dsyslog("changing priority/lifetime of '%s' to %d/%d", Name(), NewPriority, NewLifetime);
      info->SetPriority(NewPriority);
@@ -1348,6 +1514,7 @@ bool cRecording::ChangePriorityLifetime(int NewPriority, int NewLifetime)
         free(fileName);
         fileName = NULL;
         cString NewFileName = FileName();
+        FileNameChanged();
         if (!cVideoDirectory::RenameVideoFile(OldFileName, NewFileName))
            return false;
         info->SetFileName(NewFileName);
@@ -1383,7 +1550,7 @@ bool cRecording::ChangeName(const char *NewName)
         }
      info->SetFileName(NewFileName);
      isOnVideoDirectoryFileSystem = -1; // it might have been moved to a different file system
-     ClearSortName();
+     FileNameChanged();
      }
   return true;
 }
@@ -1413,6 +1580,7 @@ bool cRecording::Delete(void)
         }
      if (result) {
         strncpy(fileName + (ext - NewName), DELEXT, strlen(ext));
+        FileNameChanged();
         SetDeleted();
         }
      }
@@ -1428,7 +1596,12 @@ bool cRecording::Remove(void)
      return false;
      }
   isyslog("removing recording %s", FileName());
-  return cVideoDirectory::RemoveVideoFile(FileName());
+  int FileSizeMB = IsOnVideoDirectoryFileSystem() ? this->FileSizeMB() : 0;
+  if (!cVideoDirectory::RemoveVideoFile(FileName()))
+     return false;
+  if (FileSizeMB > 0)
+     cVideoDiskUsage::Removed(FileSizeMB);
+  return true;
 }
 
 bool cRecording::Undelete(void)
@@ -1454,8 +1627,10 @@ bool cRecording::Undelete(void)
            result = false;
            }
         }
-     if (result)
+     if (result) {
         strncpy(fileName + (ext - NewName), RECEXT, strlen(ext));
+        FileNameChanged();
+        }
      }
   free(NewName);
   return result;
@@ -1531,169 +1706,639 @@ int cRecording::FileSizeMB(void) const
   return fileSizeMB;
 }
 
-// --- cVideoDirectoryScannerThread ------------------------------------------
+// --- cVideoDirectoryWatcher ------------------------------------------------
 
-class cVideoDirectoryScannerThread : public cThread {
+#define WATCHMASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | IN_ONLYDIR)
+#define WATCHBUFSIZE     (64 * 1024)
+#define WATCHCACHEDELAY  10 // seconds after the last change before the recordings cache is written
+
+class cVideoDirectoryWatcher : public cThread {
 private:
-  cRecordings *recordings;
-  cRecordings *deletedRecordings;
-  int count;
-  bool initial;
-  void ScanVideoDir(const char *DirName, int LinkLevel = 0, int DirLevel = 0);
+  int fd;
+  bool failed;
+  cMutex mutex;
+  cVector<char *> watchedDirs; // indexed by watch descriptor
+  time_t lastChange;
+  cStateKey cacheStateKey;
+  void Clear(void);
+  cString WatchedDir(int Wd);
+  void Unwatch(const char *Path);
+  void ScanDir(const char *DirName, int LinkLevel = 0);
+  void RecordingAdded(const char *FileName);
+  void RecordingRemoved(const char *Path, bool Prefix);
+  void HandleEvent(const struct inotify_event *Event);
 protected:
   virtual void Action(void) override;
 public:
-  cVideoDirectoryScannerThread(cRecordings *Recordings, cRecordings *DeletedRecordings);
-  ~cVideoDirectoryScannerThread();
+  cVideoDirectoryWatcher(void);
+  virtual ~cVideoDirectoryWatcher() override;
+  bool Watching(void);
+       ///< Returns true if changes in the video directory are currently being
+       ///< reported to this watcher.
+  bool Watches(const char *DirName);
+       ///< Returns true if the directory DirName is being watched.
+  void Watch(const char *DirName);
+       ///< Adds the directory DirName to the watched directories. If the limit of
+       ///< inotify watches is exceeded, the watcher stops, and changes made by other
+       ///< processes are again detected through the '.update' file only.
   };
 
-cVideoDirectoryScannerThread::cVideoDirectoryScannerThread(cRecordings *Recordings, cRecordings *DeletedRecordings)
-:cThread("video directory scanner", true)
+cVideoDirectoryWatcher::cVideoDirectoryWatcher(void)
+:cThread("video directory watcher", true)
 {
-  recordings = Recordings;
-  deletedRecordings = DeletedRecordings;
-  count = 0;
-  initial = true;
+  failed = false;
+  lastChange = 0;
+  fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+     LOG_ERROR_STR("inotify");
 }
 
-cVideoDirectoryScannerThread::~cVideoDirectoryScannerThread()
+cVideoDirectoryWatcher::~cVideoDirectoryWatcher()
 {
   Cancel(3);
+  Clear();
 }
 
-void cVideoDirectoryScannerThread::Action(void)
+void cVideoDirectoryWatcher::Clear(void)
 {
-  cStateKey StateKey;
-  recordings->Lock(StateKey);
-  count = recordings->Count();
-  initial = count == 0; // no name checking if the list is initially empty
-  StateKey.Remove();
-  deletedRecordings->Lock(StateKey, true);
-  deletedRecordings->Clear();
-  StateKey.Remove();
-  ScanVideoDir(cVideoDirectory::Name());
+  cMutexLock MutexLock(&mutex);
+  if (fd >= 0)
+     close(fd);
+  fd = -1;
+  for (int i = 0; i < watchedDirs.Size(); i++) {
+      free(watchedDirs[i]);
+      watchedDirs[i] = NULL;
+      }
 }
 
-void cVideoDirectoryScannerThread::ScanVideoDir(const char *DirName, int LinkLevel, int DirLevel)
+bool cVideoDirectoryWatcher::Watching(void)
 {
-  // Find any new recordings:
+  cMutexLock MutexLock(&mutex);
+  return fd >= 0 && !failed;
+}
+
+void cVideoDirectoryWatcher::Watch(const char *DirName)
+{
+  cMutexLock MutexLock(&mutex);
+  if (fd < 0 || failed)
+     return;
+  int wd = inotify_add_watch(fd, DirName, WATCHMASK);
+  if (wd >= 0) {
+     if (!watchedDirs[wd] || strcmp(watchedDirs[wd], DirName) != 0) {
+        free(watchedDirs[wd]);
+        watchedDirs[wd] = strdup(DirName);
+        }
+     }
+  else if (errno == ENOSPC) {
+     isyslog("inotify watch limit exceeded - watching the video directory via '.update' only");
+     failed = true;
+     }
+  else if (errno != ENOENT)
+     LOG_ERROR_STR(DirName);
+}
+
+bool cVideoDirectoryWatcher::Watches(const char *DirName)
+{
+  cMutexLock MutexLock(&mutex);
+  for (int i = 0; i < watchedDirs.Size(); i++) {
+      if (watchedDirs[i] && strcmp(watchedDirs[i], DirName) == 0)
+         return true;
+      }
+  return false;
+}
+
+cString cVideoDirectoryWatcher::WatchedDir(int Wd)
+{
+  cMutexLock MutexLock(&mutex);
+  if (Wd >= 0 && Wd < watchedDirs.Size())
+     return watchedDirs[Wd];
+  return NULL;
+}
+
+void cVideoDirectoryWatcher::Unwatch(const char *Path)
+{
+  cMutexLock MutexLock(&mutex);
+  int l = strlen(Path);
+  for (int i = 0; i < watchedDirs.Size(); i++) {
+      if (char *d = watchedDirs[i]) {
+         if (strncmp(d, Path, l) == 0 && (d[l] == 0 || d[l] == '/')) {
+            inotify_rm_watch(fd, i);
+            free(d);
+            watchedDirs[i] = NULL;
+            }
+         }
+      }
+}
+
+void cVideoDirectoryWatcher::ScanDir(const char *DirName, int LinkLevel)
+{
+  Watch(DirName);
   cReadDir d(DirName);
   struct dirent *e;
   while (Running() && (e = d.Next()) != NULL) {
-        if (cIoThrottle::Engaged())
-           cCondWait::SleepMs(100);
         cString buffer = AddDirectory(DirName, e->d_name);
         struct stat st;
         if (lstat(buffer, &st) == 0) {
            int Link = 0;
            if (S_ISLNK(st.st_mode)) {
-              if (LinkLevel > MAX_LINK_LEVEL) {
-                 isyslog("max link level exceeded - not scanning %s", *buffer);
+              if (LinkLevel > MAX_LINK_LEVEL)
                  continue;
-                 }
               Link = 1;
               if (stat(buffer, &st) != 0)
                  continue;
               }
            if (S_ISDIR(st.st_mode)) {
-              cRecordings *Recordings = NULL;
-              if (endswith(buffer, RECEXT))
-                 Recordings = recordings;
-              else if (endswith(buffer, DELEXT))
-                 Recordings = deletedRecordings;
-              if (Recordings) {
-                 cStateKey StateKey;
-                 Recordings->Lock(StateKey, true);
-                 if (initial && count != recordings->Count()) {
-                    dsyslog("activated name checking for initial read of video directory");
-                    initial = false;
-                    }
-                 cRecording *Recording = NULL;
-                 if (Recordings == deletedRecordings || initial || !(Recording = Recordings->GetByName(buffer))) {
-                    cRecording *r = new cRecording(buffer);
-                    if (r->Name()) {
-                       r->NumFrames(); // initializes the numFrames member
-                       r->FileSizeMB(); // initializes the fileSizeMB member
-                       r->IsOnVideoDirectoryFileSystem(); // initializes the isOnVideoDirectoryFileSystem member
-                       if (Recordings == deletedRecordings)
-                          r->SetDeleted();
-                       Recordings->Add(r);
-                       count = recordings->Count();
-                       }
-                    else
-                       delete r;
-                    }
-                 else if (Recording)
-                    Recording->ReadInfo();
-                 StateKey.Remove();
-                 }
+              if (endswith(buffer, RECEXT) || endswith(buffer, DELEXT))
+                 RecordingAdded(buffer);
               else
-                 ScanVideoDir(buffer, LinkLevel + Link, DirLevel + 1);
+                 ScanDir(buffer, LinkLevel + Link);
               }
            }
         }
-  // Handle any vanished recordings:
-  if (!initial && DirLevel == 0) {
-     cStateKey StateKey;
-     recordings->Lock(StateKey, true);
-     recordings->SetExplicitModify();
-     for (cRecording *Recording = recordings->First(); Recording; ) {
-         cRecording *r = Recording;
-         Recording = recordings->Next(Recording);
-         if (access(r->FileName(), F_OK) != 0) {
-            recordings->Del(r);
-            recordings->SetModified();
-            }
-         }
-     StateKey.Remove();
-     deletedRecordings->Lock(StateKey, true);
-     deletedRecordings->SetExplicitModify();
-     for (cRecording *Recording = deletedRecordings->First(); Recording; ) {
-         cRecording *r = Recording;
-         Recording = deletedRecordings->Next(Recording);
-         if (access(r->FileName(), F_OK) != 0) {
-            deletedRecordings->Del(r);
-            deletedRecordings->SetModified();
-            }
-         }
-     StateKey.Remove();
-     }
 }
 
-// --- cRecordings -----------------------------------------------------------
-
-cRecordings cRecordings::recordings;
-cRecordings cRecordings::deletedRecordings(true);
-int cRecordings::lastRecordingId = 0;
-char *cRecordings::updateFileName = NULL;
-cVideoDirectoryScannerThread *cRecordings::videoDirectoryScannerThread = NULL;
-time_t cRecordings::lastUpdate = 0;
-
-cRecordings::cRecordings(bool Deleted)
-:cList<cRecording>(Deleted ? "4 DelRecs" : "3 Recordings")
+void cVideoDirectoryWatcher::RecordingAdded(const char *FileName)
 {
+  struct stat st;
+  if (stat(FileName, &st) != 0)
+     return;
+  if (endswith(FileName, RECEXT)) {
+     Watch(FileName);
+     LOCK_RECORDINGS_WRITE;
+     cRecording *Recording = Recordings->GetByName(FileName);
+     if (!Recording) {
+        Recording = new cRecording(FileName);
+        if (!Recording->Name()) {
+           delete Recording;
+           return;
+           }
+        Recordings->Add(Recording);
+        }
+     else
+        Recordings->UpdateByName(FileName);
+     Recording->dirModified = st.st_mtime;
+     }
+  else {
+     LOCK_DELETEDRECORDINGS_WRITE;
+     if (!DeletedRecordings->GetByName(FileName)) {
+        cRecording *Recording = new cRecording(FileName);
+        if (Recording->Name()) {
+           Recording->SetDeleted();
+           DeletedRecordings->Add(Recording);
+           }
+        else
+           delete Recording;
+        }
+     }
 }
 
-cRecordings::~cRecordings()
+static void DelRecordingsByPath(cRecordings *Recordings, const char *Path, bool Prefix)
 {
-  // The first one to be destructed deletes it:
-  delete videoDirectoryScannerThread;
-  videoDirectoryScannerThread = NULL;
+  int l = strlen(Path);
+  Recordings->SetExplicitModify();
+  for (cRecording *Recording = Recordings->First(); Recording; ) {
+      cRecording *r = Recording;
+      Recording = Recordings->Next(Recording);
+      if (Prefix ? strncmp(r->FileName(), Path, l) == 0 && r->FileName()[l] == '/' : strcmp(r->FileName(), Path) == 0) {
+         Recordings->Del(r);
+         Recordings->SetModified();
+         }
+      }
 }
 
-const char *cRecordings::UpdateFileName(void)
+void cVideoDirectoryWatcher::RecordingRemoved(const char *Path, bool Prefix)
 {
-  if (!updateFileName)
-     updateFileName = strdup(AddDirectory(cVideoDirectory::Name(), ".update"));
-  return updateFileName;
+  if (Prefix || endswith(Path, RECEXT)) {
+     LOCK_RECORDINGS_WRITE;
+     DelRecordingsByPath(Recordings, Path, Prefix);
+     }
+  if (Prefix || endswith(Path, DELEXT)) {
+     LOCK_DELETEDRECORDINGS_WRITE;
+     DelRecordingsByPath(DeletedRecordings, Path, Prefix);
+     }
 }
 
-void cRecordings::TouchUpdate(void)
+void cVideoDirectoryWatcher::HandleEvent(const struct inotify_event *Event)
 {
-  bool needsUpdate = NeedsUpdate();
-  TouchFile(UpdateFileName(), true);
-  if (!needsUpdate)
-     lastUpdate = time(NULL); // make sure we don't trigger ourselves
+  if (Event->mask & IN_Q_OVERFLOW) {
+     isyslog("inotify event queue overflow - rescanning video directory");
+     cRecordings::Update();
+     return;
+     }
+  if (Event->mask & IN_IGNORED) {
+     cMutexLock MutexLock(&mutex);
+     if (Event->wd < watchedDirs.Size()) {
+        free(watchedDirs[Event->wd]);
+        watchedDirs[Event->wd] = NULL;
+        }
+     return;
+     }
+  if (!Event->len)
+     return;
+  cString DirName = WatchedDir(Event->wd);
+  if (!*DirName)
+     return;
+  const char *Name = Event->name;
+  cString FileName = AddDirectory(DirName, Name);
+  bool Added = Event->mask & (IN_CREATE | IN_MOVED_TO);
+  bool Removed = Event->mask & (IN_DELETE | IN_MOVED_FROM);
+  if (endswith(DirName, RECEXT)) {
+     // a file in a recording's directory:
+     if (strcmp(Name, INFOFILESUFFIX + 1) == 0 || strcmp(Name, INFOFILESUFFIX ".vdr" + 1) == 0) {
+        if (Event->mask & (IN_MOVED_TO | IN_CLOSE_WRITE)) {
+           LOCK_RECORDINGS_WRITE;
+           if (cRecording *Recording = Recordings->GetByName(DirName)) {
+              Recordings->UpdateByName(DirName);
+              Recording->dirModified = LastModifiedTime(DirName);
+              lastChange = time(NULL);
+              }
+           }
+        }
+     else if (strcmp(Name, MARKSFILESUFFIX + 1) == 0 || strcmp(Name, MARKSFILESUFFIX ".vdr" + 1) == 0)
+        cMarks::FileChanged(DirName);
+     else if (startswith(Name, "resume")) {
+        LOCK_RECORDINGS_WRITE;
+        Recordings->SetExplicitModify();
+        if (cRecording *Recording = Recordings->GetByName(DirName))
+           Recording->ResetResume();
+        }
+     return;
+     }
+  if (Event->mask & IN_ISDIR) {
+     if (endswith(FileName, RECEXT) || endswith(FileName, DELEXT)) {
+        if (Added)
+           RecordingAdded(FileName);
+        else if (Removed)
+           RecordingRemoved(FileName, false);
+        }
+     else if (Added)
+        ScanDir(FileName);
+     else if (Removed) {
+        Unwatch(FileName);
+        RecordingRemoved(FileName, true);
+        }
+     lastChange = time(NULL);
+     }
+  else if (strcmp(FileName, cRecordings::UpdateFileName()) == 0)
+     cRecordings::lastUpdate = time(NULL); // the actual changes have already been reported to us
+}
+
+void cVideoDirectoryWatcher::Action(void)
+{
+  cPoller Poller(fd);
+  uchar *Buffer = MALLOC(uchar, WATCHBUFSIZE);
+  while (Running() && Watching()) {
+        if (Poller.Poll(1000)) {
+           int r = safe_read(fd, Buffer, WATCHBUFSIZE);
+           if (r < 0) {
+              if (errno == EAGAIN)
+                 continue;
+              LOG_ERROR;
+              break;
+              }
+           for (uchar *p = Buffer; Running() && p < Buffer + r; ) {
+               const struct inotify_event *Event = (const struct inotify_event *)p;
+               HandleEvent(Event);
+               p += sizeof(struct inotify_event) + Event->len;
+               }
+           }
+        else if (lastChange && time(NULL) - lastChange >= WATCHCACHEDELAY) {
+           if (const cRecordings *Recordings = cRecordings::GetRecordingsRead(cacheStateKey)) {
+              Recordings->SaveCache();
+              cacheStateKey.Remove();
+              }
+           lastChange = 0;
+           }
+        }
+  free(Buffer);
+  Clear();
+}
+
+// --- cVideoDirectoryScannerThread ------------------------------------------
+
+static unsigned int FileNameHash(const char *FileName)
+{
+  unsigned int h = 2166136261u; // FNV-1a
+  while (*FileName)
+        h = (h ^ uchar(*FileName++)) * 16777619u;
+  return h;
+}
+
+class cKnownRecordingDir : public cListObject {
+public:
+  cString fileName;
+  time_t modified;
+  cKnownRecordingDir(const char *FileName, time_t Modified) : fileName(FileName) { modified = Modified; }
+  };
+
+#define SCANTHREADS  4 // the number of tasks (including the scanner thread itself) that scan the video directory in parallel
+#define SCANBATCH   50 // the maximum number of recordings added to the list under one lock
+
+class cScanDir : public cListObject {
+public:
+  cString dirName;
+  int linkLevel;
+  cScanDir(const char *DirName, int LinkLevel) : dirName(DirName) { linkLevel = LinkLevel; }
+  };
+
+class cScanWorker : public cTask {
+private:
+  cVideoDirectoryScannerThread *scanner;
+protected:
+  virtual void Action(void) override;
+public:
+  cScanWorker(cVideoDirectoryScannerThread *Scanner) { scanner = Scanner; }
+  };
+
+class cVideoDirectoryScannerThread : public cThread {
+  friend class cScanWorker;
+private:
+  cRecordings *recordings;
+  cRecordings *deletedRecordings;
+  cVideoDirectoryWatcher *watcher;
+  int count;
+  bool initial;
+  cHash<cKnownRecordingDir> knownDirs; // the directories of the recordings known at the beginning of a scan
+  cStateKey cacheStateKey;
+  cMutex scanMutex;
+  cCondVar scanCond;
+  cList<cScanDir> pendingDirs; // directories that still need to be scanned
+  int busyScanners;
+  time_t KnownModified(const char *FileName);
+  void Work(void);
+  void Merge(cRecordings *Recordings, cVector<cRecording *> &NewRecordings);
+  void ScanVideoDir(const char *DirName, int LinkLevel);
+protected:
+  virtual void Action(void) override;
+public:
+  cVideoDirectoryScannerThread(cRecordings *Recordings, cRecordings *DeletedRecordings, cVideoDirectoryWatcher *Watcher);
+  ~cVideoDirectoryScannerThread();
+  };
+
+void cScanWorker::Action(void)
+{
+  scanner->Work();
+}
+
+cVideoDirectoryScannerThread::cVideoDirectoryScannerThread(cRecordings *Recordings, cRecordings *DeletedRecordings, cVideoDirectoryWatcher *Watcher)
+:cThread("video directory scanner", true)
+,knownDirs(HASHSIZE, true)
+{
+  recordings = Recordings;
+  deletedRecordings = DeletedRecordings;
+  watcher = Watcher;
+  count = 0;
+  initial = true;
+  busyScanners = 0;
+}
+
+cVideoDirectoryScannerThread::~cVideoDirectoryScannerThread()
+{
+  Cancel(3);
+}
+
+time_t cVideoDirectoryScannerThread::KnownModified(const char *FileName)
+{
+  unsigned int Hash = FileNameHash(FileName);
+  for (cKnownRecordingDir *KnownDir = knownDirs.Get(Hash); KnownDir; KnownDir = knownDirs.GetNext(Hash, KnownDir)) {
+      if (strcmp(KnownDir->fileName, FileName) == 0)
+         return KnownDir->modified;
+      }
+  return 0;
+}
+
+void cVideoDirectoryScannerThread::Action(void)
+{
+  static bool FirstScan = true;
+  uint64_t StartupBegin = cStartupTimes::Now();
+  cStateKey StateKey;
+  recordings->Lock(StateKey);
+  count = recordings->Count();
+  initial = count == 0; // no name checking if the list is initially empty
+  knownDirs.Clear();
+  for (const cRecording *Recording = recordings->First(); Recording; Recording = recordings->Next(Recording)) {
+      if (Recording->dirModified)
+         knownDirs.Add(new cKnownRecordingDir(Recording->FileName(), Recording->dirModified), FileNameHash(Recording->FileName()));
+      }
+  StateKey.Remove();
+  deletedRecordings->Lock(StateKey, true);
+  deletedRecordings->Clear();
+  StateKey.Remove();
+  // Find any new recordings:
+  pendingDirs.Add(new cScanDir(cVideoDirectory::Name(), 0));
+  cScanWorker *Workers[SCANTHREADS - 1];
+  for (int i = 0; i < SCANTHREADS - 1; i++) {
+      Workers[i] = new cScanWorker(this);
+      Workers[i]->Start();
+      }
+  Work();
+  for (int i = 0; i < SCANTHREADS - 1; i++)
+      delete Workers[i]; // a worker that hasn't been started by now is no longer needed
+  pendingDirs.Clear();
+  knownDirs.Clear();
+  // Handle any vanished recordings:
+  if (Running() && !initial) {
+     recordings->Lock(StateKey, true);
+     recordings->SetExplicitModify();
+     for (cRecording *Recording = recordings->First(); Recording; ) {
+         cRecording *r = Recording;
+         Recording = recordings->Next(Recording);
+         if (access(r->FileName(), F_OK) != 0) {
+            recordings->Del(r);
+            recordings->SetModified();
+            }
+         }
+     StateKey.Remove();
+     deletedRecordings->Lock(StateKey, true);
+     deletedRecordings->SetExplicitModify();
+     for (cRecording *Recording = deletedRecordings->First(); Recording; ) {
+         cRecording *r = Recording;
+         Recording = deletedRecordings->Next(Recording);
+         if (access(r->FileName(), F_OK) != 0) {
+            deletedRecordings->Del(r);
+            deletedRecordings->SetModified();
+            }
+         }
+     StateKey.Remove();
+     }
+  if (Running() && recordings->Lock(cacheStateKey)) {
+     recordings->SaveCache();
+     cacheStateKey.Remove();
+     }
+  if (FirstScan) {
+     cStartupTimes::Add("scan recordings", StartupBegin);
+     FirstScan = false;
+     }
+}
+
+void cVideoDirectoryScannerThread::Work(void)
+{
+  for (;;) {
+      cScanDir *ScanDir = NULL;
+      scanMutex.Lock();
+      while (Running() && !(ScanDir = pendingDirs.First()) && busyScanners > 0)
+            scanCond.TimedWait(scanMutex, 100);
+      if (ScanDir) {
+         pendingDirs.Del(ScanDir, false);
+         busyScanners++;
+         }
+      scanMutex.Unlock();
+      if (!ScanDir)
+         break; // all directories have been scanned (or we have been cancelled)
+      ScanVideoDir(ScanDir->dirName, ScanDir->linkLevel);
+      delete ScanDir;
+      scanMutex.Lock();
+      busyScanners--;
+      scanCond.Broadcast();
+      scanMutex.Unlock();
+      }
+}
+
+void cVideoDirectoryScannerThread::Merge(cRecordings *Recordings, cVector<cRecording *> &NewRecordings)
+{
+  if (NewRecordings.Size() == 0)
+     return;
+  cStateKey StateKey;
+  Recordings->Lock(StateKey, true);
+  if (Recordings == recordings && initial && count != recordings->Count()) {
+     dsyslog("activated name checking for initial read of video directory");
+     initial = false;
+     }
+  for (int i = 0; i < NewRecordings.Size(); i++) {
+      cRecording *r = NewRecordings[i];
+      cRecording *Recording = NULL;
+      if (Recordings == deletedRecordings || initial || !(Recording = Recordings->GetByName(r->FileName())))
+         Recordings->Add(r);
+      else {
+         if (Recording->dirModified && Recording->dirModified != r->dirModified) {
+            // the resume, index or size data may have changed:
+            Recording->ResetResume();
+            Recording->numFrames = -1;
+            Recording->fileSizeMB = -1;
+            }
+         Recording->dirModified = r->dirModified;
+         Recording->ReadInfo();
+         delete r;
+         }
+      }
+  if (Recordings == recordings)
+     count = recordings->Count();
+  StateKey.Remove();
+  NewRecordings.Clear();
+}
+
+void cVideoDirectoryScannerThread::ScanVideoDir(const char *DirName, int LinkLevel)
+{
+  cVector<cRecording *> NewRecordings[2]; // 0 = recordings, 1 = deleted recordings
+  watcher->Watch(DirName); // before reading the directory, so that no changes get lost
+  cReadDir d(DirName);
+  struct dirent *e;
+  while (Running() && (e = d.Next()) != NULL) {
+        if (cIoThrottle::Engaged())
+           cCondWait::SleepMs(100);
+        cString buffer = AddDirectory(DirName, e->d_name);
+        struct stat st;
+        if (lstat(buffer, &st) == 0) {
+           int Link = 0;
+           if (S_ISLNK(st.st_mode)) {
+              if (LinkLevel > MAX_LINK_LEVEL) {
+                 isyslog("max link level exceeded - not scanning %s", *buffer);
+                 continue;
+                 }
+              Link = 1;
+              if (stat(buffer, &st) != 0)
+                 continue;
+              }
+           if (S_ISDIR(st.st_mode)) {
+              int Deleted = -1;
+              if (endswith(buffer, RECEXT))
+                 Deleted = 0;
+              else if (endswith(buffer, DELEXT))
+                 Deleted = 1;
+              if (Deleted == 0) {
+                 watcher->Watch(buffer);
+                 if (KnownModified(buffer) == st.st_mtime)
+                    continue; // this recording hasn't changed since it was last scanned
+                 }
+              if (Deleted >= 0) {
+                 // the time consuming part is done without holding a lock:
+                 cRecording *r = new cRecording(buffer);
+                 if (r->Name()) {
+                    r->ReadInfoFile(); // nobody else knows this recording yet, so no need to lock
+                    r->GetResume(); // initializes the resume member
+                    r->NumFrames(); // initializes the numFrames member
+                    r->FileSizeMB(); // initializes the fileSizeMB member
+                    r->IsOnVideoDirectoryFileSystem(); // initializes the isOnVideoDirectoryFileSystem member
+                    if (Deleted)
+                       r->SetDeleted();
+                    else
+                       r->dirModified = st.st_mtime;
+                    NewRecordings[Deleted].Append(r);
+                    if (NewRecordings[Deleted].Size() >= SCANBATCH)
+                       Merge(Deleted ? deletedRecordings : recordings, NewRecordings[Deleted]);
+                    }
+                 else
+                    delete r;
+                 }
+              else {
+                 cMutexLock MutexLock(&scanMutex);
+                 pendingDirs.Add(new cScanDir(buffer, LinkLevel + Link));
+                 scanCond.Broadcast();
+                 }
+              }
+           }
+        }
+  Merge(recordings, NewRecordings[0]);
+  Merge(deletedRecordings, NewRecordings[1]);
+}
+
+// --- cRecordings -----------------------------------------------------------
+
+cRecordings cRecordings::recordings;
+cRecordings cRecordings::deletedRecordings(true);
+int cRecordings::lastRecordingId = 0;
+char *cRecordings::updateFileName = NULL;
+char *cRecordings::cacheFileName = NULL;
+cVideoDirectoryScannerThread *cRecordings::videoDirectoryScannerThread = NULL;
+cVideoDirectoryWatcher *cRecordings::videoDirectoryWatcher = NULL;
+std::atomic<time_t> cRecordings::lastUpdate(0);
+
+cRecordings::cRecordings(bool Deleted)
+:cList<cRecording>(Deleted ? "4 DelRecs" : "3 Recordings")
+{
+  sortIndexValid[rsmName] = sortIndexValid[rsmTime] = false;
+  listSortMode = -1;
+}
+
+cRecordings::~cRecordings()
+{
+  // The first one to be destructed deletes it:
+  delete videoDirectoryScannerThread;
+  videoDirectoryScannerThread = NULL;
+  delete videoDirectoryWatcher;
+  videoDirectoryWatcher = NULL;
+}
+
+bool cRecordings::Watching(const char *DirName)
+{
+  if (videoDirectoryWatcher && videoDirectoryWatcher->Watching())
+     return !DirName || videoDirectoryWatcher->Watches(DirName);
+  return false;
+}
+
+const char *cRecordings::UpdateFileName(void)
+{
+  if (!updateFileName)
+     updateFileName = strdup(AddDirectory(cVideoDirectory::Name(), ".update"));
+  return updateFileName;
+}
+
+void cRecordings::TouchUpdate(void)
+{
+  bool needsUpdate = NeedsUpdate();
+  TouchFile(UpdateFileName(), true);
+  if (!needsUpdate)
+     lastUpdate = time(NULL); // make sure we don't trigger ourselves
 }
 
 bool cRecordings::NeedsUpdate(void)
@@ -1704,10 +2349,107 @@ bool cRecordings::NeedsUpdate(void)
   return lastUpdate < lastModified;
 }
 
+void cRecordings::SetCacheFileName(const char *FileName)
+{
+  free(cacheFileName);
+  cacheFileName = FileName ? strdup(FileName) : NULL;
+}
+
+#define RECORDINGSCACHEVERSION 2
+
+bool cRecordings::LoadCache(void)
+{
+  if (!cacheFileName)
+     return false;
+  FILE *f = fopen(cacheFileName, "r");
+  if (!f) {
+     if (errno != ENOENT)
+        LOG_ERROR_STR(cacheFileName);
+     return false;
+     }
+  cStateKey StateKey;
+  Lock(StateKey, true);
+  bool Result = false;
+  cReadLine ReadLine;
+  char *s;
+  int line = 0;
+  while ((s = ReadLine.Read(f)) != NULL) {
+        line++;
+        if (line == 1) {
+           int Version = 0;
+           int n = 0;
+           if (sscanf(s, "V %d %n", &Version, &n) != 1 || !n || Version != RECORDINGSCACHEVERSION || strcmp(s + n, cVideoDirectory::Name()) != 0) {
+              isyslog("recordings cache %s is outdated - ignored", cacheFileName);
+              break;
+              }
+           Result = true;
+           continue;
+           }
+        intmax_t DirModified; // actually time_t, but intmax_t for scanning with "%jd"
+        int Resume, NumFrames, FileSizeMB, IsOnVideoDirectoryFileSystem;
+        char *FramesPerSecond = NULL;
+        int Priority, Lifetime, Errors;
+        int n = 0;
+        if (sscanf(s, "R %jd %d %d %d %d %ms %d %d %d %n", &DirModified, &Resume, &NumFrames, &FileSizeMB, &IsOnVideoDirectoryFileSystem, &FramesPerSecond, &Priority, &Lifetime, &Errors, &n) == 9 && n) {
+           cRecording *Recording = new cRecording(s + n);
+           if (Recording->Name()) {
+              Recording->dirModified = DirModified;
+              Recording->resume = Resume;
+              Recording->numFrames = NumFrames;
+              Recording->fileSizeMB = FileSizeMB;
+              Recording->isOnVideoDirectoryFileSystem = IsOnVideoDirectoryFileSystem;
+              Recording->info->SetFramesPerSecond(atod(FramesPerSecond));
+              Recording->info->SetPriority(Priority);
+              Recording->info->SetLifetime(Lifetime);
+              Recording->info->SetErrors(Errors);
+              Recording->hasSummary = true;
+              Add(Recording);
+              free(FramesPerSecond);
+              continue;
+              }
+           delete Recording;
+           }
+        free(FramesPerSecond);
+        esyslog("ERROR: error in %s, line %d", cacheFileName, line);
+        Result = false;
+        break;
+        }
+  fclose(f);
+  if (Result)
+     dsyslog("loaded %d recordings from %s", Count(), cacheFileName);
+  else
+     Clear();
+  StateKey.Remove();
+  return Result;
+}
+
+bool cRecordings::SaveCache(void) const
+{
+  if (!cacheFileName)
+     return false;
+  cSafeFile f(cacheFileName);
+  if (f.Open()) {
+     fprintf(f, "V %d %s\n", RECORDINGSCACHEVERSION, cVideoDirectory::Name());
+     for (const cRecording *Recording = First(); Recording; Recording = Next(Recording)) {
+         if (Recording->dirModified) {
+            const cRecordingInfo *Summary = Recording->Summary();
+            fprintf(f, "R %jd %d %d %d %d %s %d %d %d %s\n", intmax_t(Recording->dirModified), Recording->resume, Recording->numFrames, Recording->fileSizeMB, Recording->isOnVideoDirectoryFileSystem, *dtoa(Summary->FramesPerSecond(), "%.10g"), Summary->Priority(), Summary->Lifetime(), Summary->Errors(), Recording->FileName());
+            }
+         }
+     return f.Close();
+     }
+  return false;
+}
+
 void cRecordings::Update(bool Wait)
 {
-  if (!videoDirectoryScannerThread)
-     videoDirectoryScannerThread = new cVideoDirectoryScannerThread(&recordings, &deletedRecordings);
+  if (!videoDirectoryScannerThread) {
+     recordings.LoadCache();
+     UpdateFileName(); // initializes updateFileName before the watcher uses it
+     videoDirectoryWatcher = new cVideoDirectoryWatcher;
+     videoDirectoryWatcher->Start();
+     videoDirectoryScannerThread = new cVideoDirectoryScannerThread(&recordings, &deletedRecordings, videoDirectoryWatcher);
+     }
   lastUpdate = time(NULL); // doing this first to make sure we don't miss anything
   videoDirectoryScannerThread->Start();
   if (Wait) {
@@ -1716,30 +2458,136 @@ void cRecordings::Update(bool Wait)
      }
 }
 
-const cRecording *cRecordings::GetById(int Id) const
+const cRecording *cRecordings::GetById(int Id) const
+{
+  for (const cRecording *Recording = First(); Recording; Recording = Next(Recording)) {
+      if (Recording->Id() == Id)
+         return Recording;
+      }
+  return NULL;
+}
+
+const cRecording *cRecordings::GetByName(const char *FileName) const
+{
+  if (FileName) {
+     unsigned int Hash = FileNameHash(FileName);
+     for (const cRecording *Recording = recordingsByName.Get(Hash); Recording; Recording = recordingsByName.GetNext(Hash, Recording)) {
+         if (strcmp(Recording->FileName(), FileName) == 0)
+            return Recording;
+         }
+     }
+  return NULL;
+}
+
+void cRecordings::HashRecording(cRecording *Recording)
+{
+  Recording->hashedId = FileNameHash(Recording->FileName());
+  Recording->hashedIn = this;
+  recordingsByName.Add(Recording, Recording->hashedId);
+}
+
+void cRecordings::UnhashRecording(cRecording *Recording)
+{
+  if (Recording->hashedIn == this) {
+     recordingsByName.Del(Recording, Recording->hashedId);
+     Recording->hashedIn = NULL;
+     }
+}
+
+int cRecordings::CompareRecordings(const cRecording *Recording1, const cRecording *Recording2, eRecordingsSortMode SortMode)
+{
+  if (Setup.RecSortingDirection == rsdAscending)
+     return strcmp(Recording1->SortName(SortMode), Recording2->SortName(SortMode));
+  else
+     return strcmp(Recording2->SortName(SortMode), Recording1->SortName(SortMode));
+}
+
+int cRecordings::IndexRecording(cRecording *Recording)
+{
+  int Position = -1;
+  for (int m = rsmName; m <= rsmTime; m++) {
+      if (sortIndexValid[m]) {
+         cVector<cRecording *> &Index = sortIndex[m];
+         // Binary search for the position behind all recordings that are not
+         // greater than the new one, so that equal ones stay in the order they
+         // were added in (like with the stable cListBase::Sort()):
+         int Lo = 0;
+         int Hi = Index.Size();
+         while (Lo < Hi) {
+               int i = (Lo + Hi) / 2;
+               if (CompareRecordings(Index[i], Recording, eRecordingsSortMode(m)) <= 0)
+                  Lo = i + 1;
+               else
+                  Hi = i;
+               }
+         Index.Insert(Recording, Lo);
+         if (m == listSortMode)
+            Position = Lo;
+         }
+      }
+  return Position;
+}
+
+void cRecordings::UnindexRecording(cRecording *Recording)
+{
+  for (int m = rsmName; m <= rsmTime; m++) {
+      if (sortIndexValid[m])
+         sortIndex[m].RemoveElement(Recording);
+      }
+}
+
+void cRecordings::InsertRecording(cRecording *Recording)
+{
+  int Position = IndexRecording(Recording);
+  if (Position > 0)
+     cList<cRecording>::Add(Recording, sortIndex[listSortMode][Position - 1]);
+  else if (Position == 0)
+     cList<cRecording>::Ins(Recording);
+  else
+     cList<cRecording>::Add(Recording);
+}
+
+void cRecordings::ResortRecording(cRecording *Recording)
+{
+  UnindexRecording(Recording);
+  if (listSortMode >= 0) {
+     cList<cRecording>::Del(Recording, false);
+     InsertRecording(Recording);
+     }
+  else
+     IndexRecording(Recording);
+}
+
+void cRecordings::InvalidateSortIndexes(void)
 {
-  for (const cRecording *Recording = First(); Recording; Recording = Next(Recording)) {
-      if (Recording->Id() == Id)
-         return Recording;
+  for (int m = rsmName; m <= rsmTime; m++) {
+      sortIndex[m].Clear();
+      sortIndexValid[m] = false;
       }
-  return NULL;
+  listSortMode = -1;
 }
 
-const cRecording *cRecordings::GetByName(const char *FileName) const
+void cRecordings::Add(cRecording *Recording)
 {
-  if (FileName) {
-     for (const cRecording *Recording = First(); Recording; Recording = Next(Recording)) {
-         if (strcmp(Recording->FileName(), FileName) == 0)
-            return Recording;
-         }
-     }
-  return NULL;
+  Recording->SetId(++lastRecordingId);
+  InsertRecording(Recording);
+  HashRecording(Recording);
 }
 
-void cRecordings::Add(cRecording *Recording)
+void cRecordings::Del(cRecording *Recording, bool DeleteObject)
 {
-  Recording->SetId(++lastRecordingId);
-  cList<cRecording>::Add(Recording);
+  UnhashRecording(Recording);
+  UnindexRecording(Recording);
+  cList<cRecording>::Del(Recording, DeleteObject);
+}
+
+void cRecordings::Clear(void)
+{
+  recordingsByName.Clear();
+  for (cRecording *Recording = First(); Recording; Recording = Next(Recording))
+      Recording->hashedIn = NULL;
+  InvalidateSortIndexes();
+  cList<cRecording>::Clear();
 }
 
 void cRecordings::AddByName(const char *FileName, bool TriggerUpdate)
@@ -1881,6 +2729,31 @@ void cRecordings::ClearSortNames(void)
 {
   for (cRecording *Recording = First(); Recording; Recording = Next(Recording))
       Recording->ClearSortName();
+  InvalidateSortIndexes();
+}
+
+void cRecordings::Sort(void)
+{
+  if (listSortMode == RecordingsSortMode)
+     return; // new recordings have been inserted at their proper position
+  cVector<cRecording *> &Index = sortIndex[RecordingsSortMode];
+  if (sortIndexValid[RecordingsSortMode]) {
+     // Relink the list in the order of the index:
+     for (int i = 0; i < Index.Size(); i++)
+         Index[i]->Unlink();
+     objects = lastObject = NULL;
+     count = 0;
+     for (int i = 0; i < Index.Size(); i++)
+         cList<cRecording>::Add(Index[i]);
+     }
+  else {
+     cList<cRecording>::Sort();
+     Index.Clear();
+     for (cRecording *Recording = First(); Recording; Recording = Next(Recording))
+         Index.Append(Recording);
+     sortIndexValid[RecordingsSortMode] = true;
+     }
+  listSortMode = RecordingsSortMode;
 }
 
 // --- cDirCopier ------------------------------------------------------------
@@ -1926,9 +2799,11 @@ bool cDirCopier::Throttled(void)
      dsyslog("resuming copy thread");
      suspensionLogged = false;
      }
-  return false;
+  return cIoBudget::Exhausted();
 }
 
+#define DIRCOPYCHUNK MEGABYTE(4) // bytes copied in one go by copy_file_range()
+
 void cDirCopier::Action(void)
 {
   if (DirectoryOk(dirNameDst, true)) {
@@ -1942,6 +2817,7 @@ void cDirCopier::Action(void)
         int To = -1;
         size_t BufferSize = BUFSIZ;
         uchar *Buffer = NULL;
+        bool CopyFileRange = true;
         while (Running()) {
               // Suspend copying if we have severe throughput problems:
               if (Throttled()) {
@@ -1955,15 +2831,28 @@ void cDirCopier::Action(void)
                     esyslog("ERROR: no buffer");
                     break;
                     }
-                 size_t Read = safe_read(From, Buffer, BufferSize);
-                 if (Read > 0) {
-                    size_t Written = safe_write(To, Buffer, Read);
-                    if (Written != Read) {
-                       esyslog("ERROR: can't write to destination file '%s': %m", *FileNameDst);
-                       break;
+                 ssize_t Read;
+                 if (CopyFileRange) {
+                    // Let the kernel copy the data (or share it, if the file system can):
+                    Read = copy_file_range(From, NULL, To, NULL, DIRCOPYCHUNK, 0);
+                    if (Read < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+                       CopyFileRange = false; // not supported here, so we do it the traditional way
+                       continue;
+                       }
+                    }
+                 else {
+                    Read = safe_read(From, Buffer, BufferSize);
+                    if (Read > 0) {
+                       ssize_t Written = safe_write(To, Buffer, Read);
+                       if (Written != Read) {
+                          esyslog("ERROR: can't write to destination file '%s': %m", *FileNameDst);
+                          break;
+                          }
                        }
                     }
-                 else if (Read == 0) { // EOF on From
+                 if (Read > 0)
+                    cIoBudget::Consumed(Read);
+                 if (Read == 0) { // EOF on From
                     e = NULL; // triggers switch to next entry
                     if (fsync(To) < 0) {
                        esyslog("ERROR: can't sync destination file '%s': %m", *FileNameDst);
@@ -1985,7 +2874,7 @@ void cDirCopier::Action(void)
                        break;
                        }
                     }
-                 else {
+                 else if (Read < 0) {
                     esyslog("ERROR: can't read from source file '%s': %m", *FileNameSrc);
                     break;
                     }
@@ -2025,6 +2914,16 @@ void cDirCopier::Action(void)
                     close(From);
                     break;
                     }
+                 // On file systems like btrfs and XFS the destination file can simply share
+                 // the data blocks of the source file, in which case we're done right away:
+                 if (ioctl(To, FICLONE, From) == 0) {
+                    dsyslog("cloned file '%s'", *FileNameSrc);
+                    if (lseek(From, 0, SEEK_END) < 0) { // the next read will report EOF
+                       esyslog("ERROR: can't seek in source file '%s': %m", *FileNameSrc);
+                       break;
+                       }
+                    }
+                 CopyFileRange = true;
                  }
               else {
                  // We're done:
@@ -2046,21 +2945,185 @@ void cDirCopier::Action(void)
      esyslog("ERROR: can't access '%s'", *dirNameDst);
 }
 
+// --- cPreviewGenerator -----------------------------------------------------
+
+#define PREVIEWFILESUFFIX    "/preview.ts"
+#define THUMBNAILFILESUFFIX  "/thumbnail.jpg"
+#define PREVIEWINTERVAL      10 // minimum number of seconds between two frames of the preview
+#define THUMBNAILPOSITION    10 // percent of the recording at which the thumbnail is taken
+#define THUMBNAILWIDTH      320
+#define THUMBNAILHEIGHT     180
+#define THUMBNAILQUALITY     70
+
+// The preview file contains a copy of the independent frames (including the PAT
+// and PMT that precede each of them) at regular intervals, so it is a valid TS
+// file that any player can show as a slide show.
+
+class cPreviewGenerator : public cThread {
+private:
+  cString recordingName;
+  bool error;
+  bool suspensionLogged;
+  bool Throttled(void);
+  virtual void Action(void) override;
+public:
+  cPreviewGenerator(const char *RecordingName);
+  virtual ~cPreviewGenerator() override;
+  bool Error(void) { return error; }
+  };
+
+cPreviewGenerator::cPreviewGenerator(const char *RecordingName)
+:cThread("preview generator", true)
+,recordingName(RecordingName)
+{
+  error = true; // prepare for the worst!
+  suspensionLogged = false;
+}
+
+cPreviewGenerator::~cPreviewGenerator()
+{
+  Cancel(3);
+}
+
+bool cPreviewGenerator::Throttled(void)
+{
+  if (cIoThrottle::Engaged()) {
+     if (!suspensionLogged) {
+        dsyslog("suspending preview generator");
+        suspensionLogged = true;
+        }
+     return true;
+     }
+  else if (suspensionLogged) {
+     dsyslog("resuming preview generator");
+     suspensionLogged = false;
+     }
+  return cIoBudget::Exhausted();
+}
+
+void cPreviewGenerator::Action(void)
+{
+  cIndexFile IndexFile(recordingName, false);
+  if (!IndexFile.Ok() || IndexFile.IsStillRecording()) {
+     error = false; // PES recordings and ongoing recordings don't get a preview
+     return;
+     }
+  cString PreviewFileName = cString::sprintf("%s%s", *recordingName, PREVIEWFILESUFFIX);
+  struct stat stPreview, stIndex;
+  if (stat(PreviewFileName, &stPreview) == 0 && stat(cIndexFile::IndexFileName(recordingName, false), &stIndex) == 0 && stPreview.st_mtime >= stIndex.st_mtime) {
+     error = false; // the preview is up to date
+     return;
+     }
+  int Last = IndexFile.Last();
+  cRecordingInfo RecordingInfo(recordingName);
+  RecordingInfo.Read();
+  int Step = max(SecondsToFrames(PREVIEWINTERVAL, RecordingInfo.FramesPerSecond()), (Last + PREVIEWFRAMES - 1) / PREVIEWFRAMES);
+  int ThumbnailIndex = Last * THUMBNAILPOSITION / 100;
+  cString TmpFileName = cString::sprintf("%s.tmp", *PreviewFileName);
+  cUnbufferedFile *f = cUnbufferedFile::Create(TmpFileName, O_WRONLY | O_CREAT | O_TRUNC);
+  if (!f)
+     return;
+  dsyslog("generating preview '%s'", *PreviewFileName);
+  cFileName FileName(recordingName, false);
+  uchar *Buffer = MALLOC(uchar, MAXFRAMESIZE);
+  bool Ok = Buffer != NULL;
+  bool Thumbnail = false;
+  int Frames = 0;
+  int Index = -1;
+  int Next = 0;
+  while (Ok && Running()) {
+        if (Throttled()) {
+           cCondWait::SleepMs(100);
+           continue;
+           }
+        uint16_t FileNumber;
+        off_t FileOffset;
+        int Length;
+        Index = IndexFile.GetNextIFrame(Next - 1, true, &FileNumber, &FileOffset, &Length);
+        if (Index < 0)
+           break;
+        if (Length < 0 || Length > MAXFRAMESIZE)
+           Length = MAXFRAMESIZE; // see cDvbPlayer::Action()
+        cUnbufferedFile *r = FileName.SetOffset(FileNumber, FileOffset);
+        int n = r ? ReadFrame(r, Buffer, Length, MAXFRAMESIZE) : -1;
+        if (n > 0) {
+           cIoBudget::Consumed(n);
+           Ok = f->Write(Buffer, n) == n;
+           Frames++;
+           if (!Thumbnail && Index >= ThumbnailIndex) {
+              // Let the primary device decode the frame, if it can:
+              Thumbnail = true;
+              int Size;
+              cDevice *PrimaryDevice = cDevice::PrimaryDevice();
+              if (uchar *Image = PrimaryDevice ? PrimaryDevice->DecodeImage(Buffer, n, Size, true, THUMBNAILQUALITY, THUMBNAILWIDTH, THUMBNAILHEIGHT) : NULL) {
+                 cString ThumbnailFileName = cString::sprintf("%s%s", *recordingName, THUMBNAILFILESUFFIX);
+                 cSafeFile t(ThumbnailFileName);
+                 if (!t.Open() || fwrite(Image, Size, 1, t) != 1 || !t.Close())
+                    esyslog("ERROR: can't write thumbnail '%s'", *ThumbnailFileName);
+                 free(Image);
+                 }
+              }
+           }
+        else
+           Ok = false;
+        Next = Index + Step;
+        }
+  free(Buffer);
+  if (Ok && Index >= 0)
+     Ok = false; // we have been canceled
+  if (f->Close() < 0)
+     Ok = false;
+  delete f;
+  if (Ok && rename(TmpFileName, PreviewFileName) == 0) {
+     dsyslog("finished generating preview '%s' (%d frames)", *PreviewFileName, Frames);
+     error = false;
+     }
+  else {
+     unlink(TmpFileName);
+     if (Running())
+        esyslog("ERROR: can't generate preview '%s'", *PreviewFileName);
+     }
+}
+
 // --- cRecordingsHandlerEntry -----------------------------------------------
 
+static dev_t FileSystemOf(const char *FileName)
+{
+  // The given file may not exist yet, so we use the first existing directory above it:
+  char Name[PATH_MAX];
+  strn0cpy(Name, FileName, sizeof(Name));
+  struct stat st;
+  while (stat(Name, &st) < 0) {
+        char *p = strrchr(Name, '/');
+        if (!p || p == Name)
+           return 0;
+        *p = 0;
+        }
+  return st.st_dev;
+}
+
 class cRecordingsHandlerEntry : public cListObject {
 private:
   int usage;
   cString fileNameSrc;
   cString fileNameDst;
+  dev_t device;
   cCutter *cutter;
   cDirCopier *copier;
+  cPreviewGenerator *previewer;
   bool error;
   void ClearPending(void) { usage &= ~ruPending; }
 public:
   cRecordingsHandlerEntry(int Usage, const char *FileNameSrc, const char *FileNameDst);
   ~cRecordingsHandlerEntry();
   int Usage(const char *FileName = NULL) const;
+  int Priority(void) const { return (usage & ruCut) ? 0 : (usage & ruMove) ? 1 : (usage & ruCopy) ? 2 : 3; }
+       ///< Lower values are started first.
+  bool Pending(void) const { return (usage & (ruPending | ruCanceled)) == ruPending; }
+  bool Running(void) const { return cutter || copier || previewer; }
+  bool IsPreview(void) const { return (usage & ruPreview) != 0; }
+  dev_t Device(void) const { return device; }
+       ///< The file system the result of this operation is written to.
   bool Error(void) const { return error; }
   void SetCanceled(void) { usage |= ruCanceled; }
   const char *FileNameSrc(void) const { return fileNameSrc; }
@@ -2074,8 +3137,10 @@ cRecordingsHandlerEntry::cRecordingsHandlerEntry(int Usage, const char *FileName
   usage = Usage;
   fileNameSrc = FileNameSrc;
   fileNameDst = FileNameDst;
+  device = FileSystemOf(fileNameDst);
   cutter = NULL;
   copier = NULL;
+  previewer = NULL;
   error = false;
 }
 
@@ -2083,6 +3148,7 @@ cRecordingsHandlerEntry::~cRecordingsHandlerEntry()
 {
   delete cutter;
   delete copier;
+  delete previewer;
 }
 
 int cRecordingsHandlerEntry::Usage(const char *FileName) const
@@ -2116,6 +3182,13 @@ bool cRecordingsHandlerEntry::Active(cRecordings *Recordings)
      delete copier;
      copier = NULL;
      }
+  else if (previewer) {
+     if (previewer->Active())
+        return true;
+     error = previewer->Error();
+     delete previewer;
+     previewer = NULL;
+     }
   // Now check if there is something to start:
   if ((Usage() & ruPending) != 0) {
      if ((Usage() & ruCut) != 0) {
@@ -2132,12 +3205,22 @@ bool cRecordingsHandlerEntry::Active(cRecordings *Recordings)
         copier = new cDirCopier(FileNameSrc(), FileNameDst());
         copier->Start();
         }
+     else if ((Usage() & ruPreview) != 0) {
+        previewer = new cPreviewGenerator(FileNameSrc());
+        previewer->Start();
+        ClearPending();
+        return true; // the list of recordings doesn't change
+        }
      ClearPending();
      Recordings->SetModified(); // to trigger a state change
      return true;
      }
   // We're done:
+  if ((usage & ruPreview) != 0)
+     return false;
   if (!error) {
+     if ((usage & ruCut) != 0)
+        RecordingsHandler.Add(ruPreview, FileNameDst());
      if ((usage & (ruMove | ruCopy)) != 0)
         cRecordingUserCommand::InvokeCommand(RUC_COPIEDRECORDING, FileNameDst(), FileNameSrc());
      if ((usage & ruMove) != 0) {
@@ -2169,6 +3252,10 @@ void cRecordingsHandlerEntry::Cleanup(cRecordings *Recordings)
            }
         }
      }
+  if (previewer) {                // this was a preview that had not yet finished
+     delete previewer;            // (the generator removes its temporary file)
+     previewer = NULL;
+     }
   if ((usage & (ruMove | ruCopy)) // this was a move/copy operation...
      && ((usage & ruPending)      // ...which had not yet started...
         || copier                 // ...or not yet finished...
@@ -2211,17 +3298,29 @@ void cRecordingsHandler::Action(void)
           LOCK_RECORDINGS_WRITE;
           Recordings->SetExplicitModify();
           cMutexLock MutexLock(&mutex);
-          if (cRecordingsHandlerEntry *r = operations.First()) {
-             if (!r->Active(Recordings)) {
-                error |= r->Error();
-                r->Cleanup(Recordings);
-                operations.Del(r);
-                }
-             else
-                Sleep = true;
-             }
-          else
+          if (!operations.First())
              break;
+          cIoBudget::SetLimit(Setup.JobBandwidth);
+          // Check the operations that are in progress (or have been canceled):
+          for (cRecordingsHandlerEntry *r = operations.First(); r; ) {
+              cRecordingsHandlerEntry *Next = operations.Next(r);
+              if (!r->Pending()) {
+                 if (!r->Active(Recordings)) {
+                    if (!r->IsPreview())
+                       error |= r->Error();
+                    r->Cleanup(Recordings);
+                    operations.Del(r);
+                    }
+                 else
+                    Sleep = true;
+                 }
+              r = Next;
+              }
+          // Start as many pending operations as the target file systems allow:
+          while (cRecordingsHandlerEntry *r = NextPending()) {
+                r->Active(Recordings);
+                Sleep = true;
+                }
         }
         if (Sleep)
            cCondWait::SleepMs(100);
@@ -2241,16 +3340,66 @@ cRecordingsHandlerEntry *cRecordingsHandler::Get(const char *FileName)
   return NULL;
 }
 
+cRecordingsHandlerEntry *cRecordingsHandler::NextPending(void)
+{
+  cRecordingsHandlerEntry *Next = NULL;
+  for (cRecordingsHandlerEntry *r = operations.First(); r; r = operations.Next(r)) {
+      if (r->Pending() && (!Next || r->Priority() < Next->Priority())) {
+         int Running = 0;
+         for (cRecordingsHandlerEntry *e = operations.First(); e; e = operations.Next(e)) {
+             if (e->Running() && e->Device() == r->Device())
+                Running++;
+             }
+         if (Running < max(Setup.JobsPerDisk, 1))
+            Next = r;
+         }
+      }
+  return Next;
+}
+
+bool cRecordingsHandler::Editing(void)
+{
+  // mutex must be locked!
+  for (cRecordingsHandlerEntry *r = operations.First(); r; r = operations.Next(r)) {
+      if (!r->IsPreview())
+         return true;
+      }
+  return false;
+}
+
+void cRecordingsHandler::CancelPreview(const char *FileName)
+{
+  // mutex must be locked!
+  if (FileName && *FileName) {
+     cRecordingsHandlerEntry *r = Get(FileName);
+     if (r && r->IsPreview())
+        r->SetCanceled();
+     }
+}
+
 bool cRecordingsHandler::Add(int Usage, const char *FileNameSrc, const char *FileNameDst)
 {
   dsyslog("recordings handler add %d '%s' '%s'", Usage, FileNameSrc, FileNameDst);
   cMutexLock MutexLock(&mutex);
-  if (Usage == ruCut || Usage == ruMove || Usage == ruCopy) {
+  if (Usage == ruPreview) {
+     if (FileNameSrc && *FileNameSrc) {
+        if (!Get(FileNameSrc)) {
+           operations.Add(new cRecordingsHandlerEntry(Usage | ruPending, FileNameSrc, FileNameSrc));
+           Start();
+           return true;
+           }
+        }
+     else
+        esyslog("ERROR: missing src file name in recordings handler add %d '%s' '%s'", Usage, FileNameSrc, FileNameDst);
+     }
+  else if (Usage == ruCut || Usage == ruMove || Usage == ruCopy) {
      if (FileNameSrc && *FileNameSrc) {
         if (Usage == ruCut || FileNameDst && *FileNameDst) {
            cString fnd;
            if (Usage == ruCut && !FileNameDst)
               FileNameDst = fnd = cCutter::EditedFileName(FileNameSrc);
+           CancelPreview(FileNameSrc);
+           CancelPreview(FileNameDst);
            if (!Get(FileNameSrc) && !Get(FileNameDst)) {
               Usage |= ruPending;
               operations.Add(new cRecordingsHandlerEntry(Usage, FileNameSrc, FileNameDst));
@@ -2286,10 +3435,17 @@ void cRecordingsHandler::DelAll(void)
       r->SetCanceled();
 }
 
+bool cRecordingsHandler::Active(void)
+{
+  cMutexLock MutexLock(&mutex);
+  return Editing();
+}
+
 int cRecordingsHandler::GetUsage(const char *FileName)
 {
   cMutexLock MutexLock(&mutex);
-  if (cRecordingsHandlerEntry *r = Get(FileName))
+  cRecordingsHandlerEntry *r = Get(FileName);
+  if (r && !r->IsPreview())
      return r->Usage(FileName);
   return ruNone;
 }
@@ -2315,7 +3471,7 @@ int cRecordingsHandler::GetRequiredDiskSpaceMB(const char *FileName)
 bool cRecordingsHandler::Finished(bool &Error)
 {
   cMutexLock MutexLock(&mutex);
-  if (!finished && operations.Count() == 0) {
+  if (!finished && !Editing()) {
      finished = true;
      Error = error;
      error = false;
@@ -2366,6 +3522,36 @@ bool cMark::Save(FILE *f)
 
 // --- cMarks ----------------------------------------------------------------
 
+cMutex cMarks::marksMutex;
+cVector<cMarks *> cMarks::loadedMarks;
+
+cMarks::cMarks(void)
+:cConfig<cMark>("Marks")
+{
+  framesPerSecond = DEFAULTFRAMESPERSECOND;
+  isPesRecording = false;
+  nextUpdate = 0;
+  lastFileTime = -1;
+  lastChange = 0;
+  watched = false;
+  changed = false;
+}
+
+cMarks::~cMarks()
+{
+  cMutexLock MutexLock(&marksMutex);
+  loadedMarks.RemoveElement(this);
+}
+
+void cMarks::FileChanged(const char *RecordingFileName)
+{
+  cMutexLock MutexLock(&marksMutex);
+  for (int i = 0; i < loadedMarks.Size(); i++) {
+      if (strcmp(loadedMarks[i]->recordingFileName, RecordingFileName) == 0)
+         loadedMarks[i]->changed = true;
+      }
+}
+
 cString cMarks::MarksFileName(const cRecording *Recording)
 {
   return AddDirectory(Recording->FileName(), Recording->IsPesRecording() ? MARKSFILESUFFIX ".vdr" : MARKSFILESUFFIX);
@@ -2391,11 +3577,25 @@ bool cMarks::Load(const char *RecordingFileName, double FramesPerSecond, bool Is
   nextUpdate = 0;
   lastFileTime = -1; // the first call to Load() must take place!
   lastChange = 0;
+  watched = cRecordings::Watching(RecordingFileName);
+  {
+    cMutexLock MutexLock(&marksMutex);
+    loadedMarks.AppendUnique(this);
+    changed = false;
+  }
   return Update();
 }
 
 bool cMarks::Update(void)
 {
+  if (watched && lastFileTime >= 0 && cRecordings::Watching()) {
+     // Changes of the marks file are reported by the video directory watcher:
+     cMutexLock MutexLock(&marksMutex);
+     if (!changed)
+        return false;
+     changed = false;
+     nextUpdate = 0;
+     }
   time_t t = time(NULL);
   if (t > nextUpdate && *fileName) {
      time_t LastModified = LastModifiedTime(fileName);
@@ -2574,6 +3774,100 @@ int cMarks::GetFrameAfterEdit(int Frame, int LastFrame) const
   return EditedFrame;
 }
 
+// --- cErrors ---------------------------------------------------------------
+
+cErrors::cErrors(void)
+{
+  size = 0;
+}
+
+void cErrors::Clear(void)
+{
+  first.Clear();
+  last.Clear();
+  count.Clear();
+  size = 0;
+}
+
+void cErrors::Append(int Position)
+{
+  int n = first.Size();
+  if (n && Position <= last[n - 1] + 1) {
+     if (Position > last[n - 1]) {
+        last[n - 1] = Position;
+        size++;
+        }
+     return;
+     }
+  first.Append(Position);
+  last.Append(Position);
+  count.Append(size);
+  size++;
+}
+
+int cErrors::Find(int Position) const
+{
+  // Returns the index of the last run that begins at or before Position, or -1:
+  int Lo = 0;
+  int Hi = first.Size() - 1;
+  int Run = -1;
+  while (Lo <= Hi) {
+        int m = (Lo + Hi) / 2;
+        if (first[m] <= Position) {
+           Run = m;
+           Lo = m + 1;
+           }
+        else
+           Hi = m - 1;
+        }
+  return Run;
+}
+
+int cErrors::At(int Index) const
+{
+  if (Index < 0 || Index >= size)
+     return -1;
+  int Lo = 0;
+  int Hi = count.Size() - 1;
+  while (Lo < Hi) {
+        int m = (Lo + Hi + 1) / 2;
+        if (count[m] <= Index)
+           Lo = m;
+        else
+           Hi = m - 1;
+        }
+  return first[Lo] + Index - count[Lo];
+}
+
+int cErrors::Next(int Position) const
+{
+  int Run = Find(Position);
+  if (Run >= 0 && Position < last[Run])
+     return Position + 1;
+  return Run + 1 < first.Size() ? first[Run + 1] : -1;
+}
+
+int cErrors::Prev(int Position) const
+{
+  int Run = Find(Position - 1);
+  if (Run < 0)
+     return -1;
+  return min(Position - 1, last[Run]);
+}
+
+int cErrors::Before(int Position) const
+{
+  int Run = Find(Position - 1);
+  if (Run < 0)
+     return 0;
+  return count[Run] + min(Position - 1, last[Run]) - first[Run] + 1;
+}
+
+int cErrors::Count(int From, int To) const
+{
+  return To >= From ? Before(To + 1) - Before(From) : 0;
+}
+
 // --- cRecordingUserCommand -------------------------------------------------
 
 const char *cRecordingUserCommand::command = NULL;
@@ -2591,44 +3885,119 @@ void cRecordingUserCommand::InvokeCommand(const char *State, const char *Recordi
   }
 }
 
-// --- cIndexFileGenerator ---------------------------------------------------
+// --- cIndexSegmentGenerator ------------------------------------------------
 
 #define IFG_BUFFER_SIZE KILOBYTE(100)
+#define IFG_MAXTHREADS  8 // the maximum number of threads used to generate an index file
+#define IFG_MAXPENDING  2 // the number of finished segments per thread that may wait for being written
 
-class cIndexFileGenerator : public cThread {
+// Generates the index entries for the recording files FirstFile...LastFile
+// (or all files from FirstFile on, if LastFile is 0). Since each file of a TS
+// recording starts with a PAT/PMT and an independent frame, any range of files
+// can be processed independently. If an index file is given, the entries are
+// written directly into it, otherwise they are collected until WriteTo() is
+// called.
+
+class cIndexSegmentGenerator : public cThread {
 private:
+  struct tEntry {
+    off_t offset;
+    uint16_t number;
+    bool independent;
+    bool errors;
+    bool missing;
+    };
   cString recordingName;
-  bool update;
+  int firstFile;
+  int lastFile;
+  cIndexFile *indexFile;
+  tEntry *entries;
+  int numEntries;
+  int maxEntries;
+  cFrameDetector frameDetector;
+  int errors;
+  bool written;
+  bool complete;
+  void Put(bool Independent, uint16_t Number, off_t Offset, bool Errors, bool Missing);
 protected:
   virtual void Action(void) override;
 public:
-  cIndexFileGenerator(const char *RecordingName);
-  ~cIndexFileGenerator();
+  cIndexSegmentGenerator(const char *RecordingName, int FirstFile, int LastFile, cIndexFile *IndexFile = NULL);
+  ~cIndexSegmentGenerator();
+  cFrameDetector *FrameDetector(void) { return &frameDetector; }
+  int Errors(void) { return errors; }
+       ///< Returns the number of errors in this segment.
+  bool Written(void) { return written; }
+       ///< Returns true if at least one index entry has been generated.
+  bool Complete(void) { return complete; }
+       ///< Returns true if all files of this segment have been processed.
+  bool WriteTo(cIndexFile *IndexFile);
+       ///< Writes the collected index entries to the given IndexFile.
   };
 
-cIndexFileGenerator::cIndexFileGenerator(const char *RecordingName)
-:cThread("index file generator")
+cIndexSegmentGenerator::cIndexSegmentGenerator(const char *RecordingName, int FirstFile, int LastFile, cIndexFile *IndexFile)
+:cThread("index segment generator")
 ,recordingName(RecordingName)
 {
-  Start();
+  firstFile = FirstFile;
+  lastFile = LastFile;
+  indexFile = IndexFile;
+  entries = NULL;
+  numEntries = maxEntries = 0;
+  errors = 0;
+  written = false;
+  complete = false;
 }
 
-cIndexFileGenerator::~cIndexFileGenerator()
+cIndexSegmentGenerator::~cIndexSegmentGenerator()
 {
   Cancel(3);
+  free(entries);
 }
 
-void cIndexFileGenerator::Action(void)
+void cIndexSegmentGenerator::Put(bool Independent, uint16_t Number, off_t Offset, bool Errors, bool Missing)
+{
+  if (indexFile)
+     indexFile->Write(Independent, Number, Offset, Errors, Missing);
+  else {
+     if (numEntries >= maxEntries) {
+        int NewMax = maxEntries ? maxEntries * 2 : KILOBYTE(16);
+        if (tEntry *NewEntries = (tEntry *)realloc(entries, NewMax * sizeof(tEntry))) {
+           entries = NewEntries;
+           maxEntries = NewMax;
+           }
+        else {
+           esyslog("ERROR: out of memory while generating index");
+           Cancel(-1);
+           return;
+           }
+        }
+     tEntry &e = entries[numEntries++];
+     e.offset = Offset;
+     e.number = Number;
+     e.independent = Independent;
+     e.errors = Errors;
+     e.missing = Missing;
+     }
+}
+
+bool cIndexSegmentGenerator::WriteTo(cIndexFile *IndexFile)
+{
+  for (int i = 0; i < numEntries; i++) {
+      tEntry &e = entries[i];
+      if (!IndexFile->Write(e.independent, e.number, e.offset, e.errors, e.missing))
+         return false;
+      }
+  return IndexFile->Flush();
+}
+
+void cIndexSegmentGenerator::Action(void)
 {
-  bool IndexFileComplete = false;
-  bool IndexFileWritten = false;
   bool Rewind = false;
   cFileName FileName(recordingName, false);
-  cUnbufferedFile *ReplayFile = FileName.Open();
+  cUnbufferedFile *ReplayFile = FileName.SetOffset(firstFile);
   cRingBufferLinear Buffer(IFG_BUFFER_SIZE, MIN_TS_PACKETS_FOR_FRAME_DETECTOR * TS_SIZE);
   cPatPmtParser PatPmtParser;
-  cFrameDetector FrameDetector;
-  cIndexFile IndexFile(recordingName, true);
   int BufferChunks = KILOBYTE(1); // no need to read a lot at the beginning when parsing PAT/PMT
   off_t FileSize = 0;
   off_t FrameOffset = -1;
@@ -2636,14 +4005,11 @@ void cIndexFileGenerator::Action(void)
   uint16_t pendNumber = 0;
   off_t pendFileSize = 0;
   bool pendMissing = false;
-  int Errors = 0;
-  Skins.QueueMessage(mtInfo, tr("Regenerating index file"));
-  SetRecordingTimerId(recordingName, cString::sprintf("%d@%s", 0, Setup.SVDRPHostName));
   bool Stuffed = false;
   while (Running()) {
         // Rewind input file:
         if (Rewind) {
-           ReplayFile = FileName.SetOffset(1);
+           ReplayFile = FileName.SetOffset(firstFile);
            Buffer.Clear();
            Rewind = false;
            }
@@ -2651,7 +4017,7 @@ void cIndexFileGenerator::Action(void)
         int Length;
         uchar *Data = Buffer.Get(Length);
         if (Data) {
-           if (FrameDetector.Synced()) {
+           if (frameDetector.Synced()) {
               // Step 3 - generate the index:
               if (TsPid(Data) == PATPID) {
                  int OldPatVersion, OldPmtVersion;
@@ -2661,26 +4027,26 @@ void cIndexFileGenerator::Action(void)
                     if (PatPmtParser.GetVersions(NewPatVersion, NewPmtVersion)) {
                        if (NewPatVersion != OldPatVersion || NewPmtVersion != OldPmtVersion) {
                           dsyslog("PAT/PMT version change while generating index");
-                          FrameDetector.SetPid(PatPmtParser.Vpid() ? PatPmtParser.Vpid() : PatPmtParser.Apid(0), PatPmtParser.Vpid() ? PatPmtParser.Vtype() : PatPmtParser.Atype(0));
+                          frameDetector.SetPid(PatPmtParser.Vpid() ? PatPmtParser.Vpid() : PatPmtParser.Apid(0), PatPmtParser.Vpid() ? PatPmtParser.Vtype() : PatPmtParser.Atype(0));
                           }
                        }
                     }
                  FrameOffset = FileSize; // the PAT/PMT is at the beginning of an I-frame
                  }
-              int Processed = FrameDetector.Analyze(Data, Length);
+              int Processed = frameDetector.Analyze(Data, Length);
               if (Processed > 0) {
                  bool PreviousErrors = false;
                  bool MissingFrames = false;
-                 if (FrameDetector.NewFrame(PreviousErrors, MissingFrames)) {
+                 if (frameDetector.NewFrame(PreviousErrors, MissingFrames)) {
                     if (pendNumber > 0)
-                       IndexFile.Write(pendIndependentFrame, pendNumber, pendFileSize, PreviousErrors, pendMissing);
-                    pendIndependentFrame = FrameDetector.IndependentFrame();
+                       Put(pendIndependentFrame, pendNumber, pendFileSize, PreviousErrors, pendMissing);
+                    pendIndependentFrame = frameDetector.IndependentFrame();
                     pendNumber = FileName.Number();
                     pendFileSize = FrameOffset >= 0 ? FrameOffset : FileSize;
                     pendMissing = MissingFrames;
                     FrameOffset = -1;
-                    IndexFileWritten = true;
-                    Errors = FrameDetector.Errors();
+                    written = true;
+                    errors = frameDetector.Errors();
                     }
                  FileSize += Processed;
                  Buffer.Del(Processed);
@@ -2688,9 +4054,9 @@ void cIndexFileGenerator::Action(void)
               }
            else if (PatPmtParser.Completed()) {
               // Step 2 - sync FrameDetector:
-              int Processed = FrameDetector.Analyze(Data, Length, false);
+              int Processed = frameDetector.Analyze(Data, Length, false);
               if (Processed > 0) {
-                 if (FrameDetector.Synced()) {
+                 if (frameDetector.Synced()) {
                     // Synced FrameDetector, so rewind for actual processing:
                     Rewind = true;
                     }
@@ -2710,7 +4076,7 @@ void cIndexFileGenerator::Action(void)
                     p += TS_SIZE;
                     if (PatPmtParser.Completed()) {
                        // Found pid, so rewind to sync FrameDetector:
-                       FrameDetector.SetPid(PatPmtParser.Vpid() ? PatPmtParser.Vpid() : PatPmtParser.Apid(0), PatPmtParser.Vpid() ? PatPmtParser.Vtype() : PatPmtParser.Atype(0));
+                       frameDetector.SetPid(PatPmtParser.Vpid() ? PatPmtParser.Vpid() : PatPmtParser.Apid(0), PatPmtParser.Vpid() ? PatPmtParser.Vtype() : PatPmtParser.Atype(0));
                        BufferChunks = IFG_BUFFER_SIZE;
                        Rewind = true;
                        break;
@@ -2736,7 +4102,7 @@ void cIndexFileGenerator::Action(void)
                  Stuffed = true;
                  }
               else {
-                 ReplayFile = FileName.NextFile();
+                 ReplayFile = lastFile && FileName.Number() >= lastFile ? NULL : FileName.NextFile();
                  FileSize = 0;
                  FrameOffset = -1;
                  Buffer.Clear();
@@ -2744,41 +4110,135 @@ void cIndexFileGenerator::Action(void)
                  }
               }
            }
-        // Recording has been processed:
-        else {
-           bool PreviousErrors = false;
-           bool MissingFrames = false;
-           Errors = FrameDetector.Errors(&PreviousErrors, &MissingFrames);
-           if (pendNumber > 0)
-              IndexFile.Write(pendIndependentFrame, pendNumber, pendFileSize, PreviousErrors, pendMissing || MissingFrames);
-           IndexFileComplete = true;
-           break;
-           }
+        // Segment has been processed:
+        else {
+           bool PreviousErrors = false;
+           bool MissingFrames = false;
+           errors = frameDetector.Errors(&PreviousErrors, &MissingFrames);
+           if (pendNumber > 0)
+              Put(pendIndependentFrame, pendNumber, pendFileSize, PreviousErrors, pendMissing || MissingFrames);
+           complete = Running(); // Put() may have failed
+           break;
+           }
+        }
+}
+
+// --- cIndexFileGenerator ---------------------------------------------------
+
+class cIndexFileGenerator : public cThread {
+private:
+  cString recordingName;
+  int threads;
+  int NumFiles(void);
+protected:
+  virtual void Action(void) override;
+public:
+  cIndexFileGenerator(const char *RecordingName, int Threads = 0);
+  ~cIndexFileGenerator();
+  };
+
+cIndexFileGenerator::cIndexFileGenerator(const char *RecordingName, int Threads)
+:cThread("index file generator")
+,recordingName(RecordingName)
+{
+  threads = Threads > 0 ? Threads : int(sysconf(_SC_NPROCESSORS_ONLN));
+  threads = constrain(threads, 1, IFG_MAXTHREADS);
+  Start();
+}
+
+cIndexFileGenerator::~cIndexFileGenerator()
+{
+  Cancel(3);
+}
+
+int cIndexFileGenerator::NumFiles(void)
+{
+  cFileName FileName(recordingName, false);
+  int n = 0;
+  while (FileName.SetOffset(n + 1))
+        n++;
+  return n;
+}
+
+void cIndexFileGenerator::Action(void)
+{
+  bool IndexFileComplete = false;
+  bool IndexFileWritten = false;
+  cIndexFile IndexFile(recordingName, true);
+  int Errors = 0;
+  Skins.QueueMessage(mtInfo, tr("Regenerating index file"));
+  SetRecordingTimerId(recordingName, cString::sprintf("%d@%s", 0, Setup.SVDRPHostName));
+  // If there are several files and threads, each file is processed by a separate
+  // segment generator. The first one writes directly into the index file, so that
+  // a replay that is waiting for the index can start right away, while the results
+  // of the others are appended in the proper order as soon as all their predecessors
+  // have been written:
+  int Segments = threads > 1 ? max(NumFiles(), 1) : 1;
+  if (Segments > 1)
+     dsyslog("generating index of '%s' with %d threads", *recordingName, min(threads, Segments));
+  cVector<cIndexSegmentGenerator *> Generators(Segments);
+  cIndexSegmentGenerator *First = NULL;
+  int Next = 0;    // the next segment to be written into the index file
+  int Started = 0; // the number of segment generators started so far
+  while (Running() && Next < Segments) {
+        // Start new segment generators:
+        int Active = 0;
+        for (int i = Next; i < Started; i++) {
+            if (Generators[i]->Active())
+               Active++;
+            }
+        while (Active < threads && Started < Segments && Started - Next < threads * IFG_MAXPENDING) {
+              cIndexSegmentGenerator *g = Segments > 1 ? new cIndexSegmentGenerator(recordingName, Started + 1, Started + 1, Started ? NULL : &IndexFile) : new cIndexSegmentGenerator(recordingName, 1, 0, &IndexFile);
+              Generators[Started++] = g;
+              g->Start();
+              Active++;
+              }
+        // Write finished segments:
+        cIndexSegmentGenerator *g = Generators[Next];
+        if (!g->Active()) {
+           if (!g->Complete() || Next > 0 && !g->WriteTo(&IndexFile))
+              break;
+           IndexFileWritten |= g->Written();
+           Errors += g->Errors();
+           if (Next == 0)
+              First = g; // keep the frame parameters
+           else
+              delete g;
+           Generators[Next++] = NULL;
+           continue;
+           }
+        cCondWait::SleepMs(10);
         }
+  IndexFileComplete = Running() && Segments > 0 && Next == Segments;
+  for (int i = Next; i < Started; i++)
+      delete Generators[i];
   SetRecordingTimerId(recordingName, NULL);
   if (IndexFileComplete) {
      if (IndexFileWritten) {
+        cFrameDetector *FrameDetector = First->FrameDetector();
         cRecordingInfo RecordingInfo(recordingName);
         if (RecordingInfo.Read()) {
-           if ((FrameDetector.FramesPerSecond() > 0 && !DoubleEqual(RecordingInfo.FramesPerSecond(), FrameDetector.FramesPerSecond())) ||
-               FrameDetector.FrameWidth()  != RecordingInfo.FrameWidth()  ||
-               FrameDetector.FrameHeight() != RecordingInfo.FrameHeight() ||
-               FrameDetector.AspectRatio() != RecordingInfo.AspectRatio() ||
+           if ((FrameDetector->FramesPerSecond() > 0 && !DoubleEqual(RecordingInfo.FramesPerSecond(), FrameDetector->FramesPerSecond())) ||
+               FrameDetector->FrameWidth()  != RecordingInfo.FrameWidth()  ||
+               FrameDetector->FrameHeight() != RecordingInfo.FrameHeight() ||
+               FrameDetector->AspectRatio() != RecordingInfo.AspectRatio() ||
                Errors != RecordingInfo.Errors()) {
-              RecordingInfo.SetFramesPerSecond(FrameDetector.FramesPerSecond());
-              RecordingInfo.SetFrameParams(FrameDetector.FrameWidth(), FrameDetector.FrameHeight(), FrameDetector.ScanType(), FrameDetector.AspectRatio());
+              RecordingInfo.SetFramesPerSecond(FrameDetector->FramesPerSecond());
+              RecordingInfo.SetFrameParams(FrameDetector->FrameWidth(), FrameDetector->FrameHeight(), FrameDetector->ScanType(), FrameDetector->AspectRatio());
               RecordingInfo.SetErrors(Errors);
               RecordingInfo.Write();
               LOCK_RECORDINGS_WRITE;
               Recordings->UpdateByName(recordingName);
               }
            }
+        delete First;
         Skins.QueueMessage(mtInfo, tr("Index file regeneration complete"));
         return;
         }
      else
         Skins.QueueMessage(mtError, tr("Index file regeneration failed!"));
      }
+  delete First;
   // Delete the index file if the recording has not been processed entirely:
   IndexFile.Delete();
 }
@@ -2820,6 +4280,10 @@ struct __attribute__((packed)) tIndexTs {
 #define INDEXFILECHECKINTERVAL 500 // ms between checks for existence of the regenerated index file
 #define INDEXFILETESTINTERVAL   10 // ms between tests for the size of the index file in case of pausing live video
 
+// When recording, index entries are collected and written to the file in blocks:
+#define INDEXWRITEBUFSIZE     1024 // number of entries
+#define INDEXWRITEDELAY       1000 // ms after which buffered entries are written, even if the buffer isn't full
+
 cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, bool PauseLive)
 :resumeFile(FileName, IsPesRecording)
 {
@@ -2827,7 +4291,12 @@ cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, b
   size = 0;
   last = -1;
   lastErrorIndex = last;
+  lastIFrameIndex = last;
   index = NULL;
+  mapped = false;
+  writeBuffer = NULL;
+  numBuffered = 0;
+  firstBuffered = 0;
   isPesRecording = IsPesRecording;
   indexFileGenerator = NULL;
   if (FileName) {
@@ -2860,7 +4329,31 @@ cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, b
               esyslog("ERROR: invalid file size (%" PRId64 ") in '%s'", buf.st_size, *fileName);
               }
            last = int((buf.st_size + delta) / sizeof(tIndexTs) - 1);
-           if (!Record && last >= 0) {
+           if (!Record && last >= 0 && !isPesRecording && !delta) {
+              // TS index files are mapped into memory, so that opening a recording
+              // doesn't need to read the entire file, and only the pages that are
+              // actually accessed are loaded:
+              f = open(fileName, O_RDONLY);
+              if (f >= 0) {
+                 void *p = mmap(NULL, size_t(buf.st_size), PROT_READ, MAP_SHARED, f, 0);
+                 if (p != MAP_FAILED) {
+                    index = (tIndexTs *)p;
+                    size = last + 1;
+                    mapped = true;
+                    if (!StillRecording(FileName)) {
+                       close(f);
+                       f = -1;
+                       }
+                    // otherwise we don't close f here, see CatchUp()!
+                    }
+                 else {
+                    LOG_ERROR_STR(*fileName);
+                    close(f);
+                    f = -1;
+                    }
+                 }
+              }
+           if (!Record && last >= 0 && !mapped) {
               size = last + 1;
               index = MALLOC(tIndexTs, size);
               if (index) {
@@ -2903,6 +4396,7 @@ cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, b
               while (delta--)
                     writechar(f, 0);
               }
+           writeBuffer = MALLOC(tIndexTs, INDEXWRITEBUFSIZE); // without it, each entry is written separately
            }
         else
            LOG_ERROR_STR(*fileName);
@@ -2912,9 +4406,14 @@ cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, b
 
 cIndexFile::~cIndexFile()
 {
+  Flush();
   if (f >= 0)
      close(f);
-  free(index);
+  if (mapped)
+     munmap(index, size * sizeof(tIndexTs));
+  else
+     free(index);
+  free(writeBuffer);
   delete indexFileGenerator;
 }
 
@@ -2966,7 +4465,20 @@ bool cIndexFile::CatchUp(int Index)
                   if (NewSize <= newLast)
                      NewSize = newLast + 1;
                   }
-               if (tIndexTs *NewBuffer = (tIndexTs *)realloc(index, NewSize * sizeof(tIndexTs))) {
+               if (mapped) {
+                  // the new entries are directly visible through the mapping, which may only need to grow:
+                  if (NewSize > size) {
+                     void *p = mremap(index, size * sizeof(tIndexTs), NewSize * sizeof(tIndexTs), MREMAP_MAYMOVE);
+                     if (p == MAP_FAILED) {
+                        LOG_ERROR_STR(*fileName);
+                        break;
+                        }
+                     size = NewSize;
+                     index = (tIndexTs *)p;
+                     }
+                  last = newLast;
+                  }
+               else if (tIndexTs *NewBuffer = (tIndexTs *)realloc(index, NewSize * sizeof(tIndexTs))) {
                   size = NewSize;
                   index = NewBuffer;
                   int offset = (last + 1) * sizeof(tIndexTs);
@@ -3010,13 +4522,37 @@ bool cIndexFile::Write(bool Independent, uint16_t FileNumber, off_t FileOffset,
      tIndexTs i(FileOffset, Independent, FileNumber, Errors, Missing);
      if (isPesRecording)
         ConvertToPes(&i, 1);
-     if (safe_write(f, &i, sizeof(i)) < 0) {
+     if (writeBuffer) {
+        if (!numBuffered)
+           firstBuffered = cTimeMs::Now();
+        writeBuffer[numBuffered++] = i;
+        // Replaying an ongoing recording shall see every new independent frame right away:
+        if (Independent || numBuffered >= INDEXWRITEBUFSIZE || cTimeMs::Now() - firstBuffered >= INDEXWRITEDELAY) {
+           if (!Flush())
+              return false;
+           }
+        }
+     else if (safe_write(f, &i, sizeof(i)) < 0) {
         LOG_ERROR_STR(*fileName);
         close(f);
         f = -1;
         return false;
         }
      last++;
+     VDR_TRACE(index_write, last, FileNumber, FileOffset, Independent);
+     }
+  return f >= 0;
+}
+
+bool cIndexFile::Flush(void)
+{
+  if (f >= 0 && numBuffered) {
+     if (safe_write(f, writeBuffer, numBuffered * sizeof(tIndexTs)) < 0) {
+        LOG_ERROR_STR(*fileName);
+        close(f);
+        f = -1;
+        }
+     numBuffered = 0;
      }
   return f >= 0;
 }
@@ -3062,40 +4598,68 @@ const cErrors *cIndexFile::GetErrors(void)
   return &errors;
 }
 
+void cIndexFile::UpdateIFrames(void)
+{
+  cMutexLock MutexLock(&mutex);
+  if (index) {
+     for (int Index = lastIFrameIndex + 1; Index <= last; Index++) {
+         if (index[Index].independent)
+            iFrames.Append(Index);
+         }
+     lastIFrameIndex = last;
+     }
+}
+
+int cIndexFile::FindIFrame(int Index)
+{
+  int l = 0;
+  int h = iFrames.Size();
+  while (l < h) {
+        int m = (l + h) / 2;
+        if (iFrames[m] < Index)
+           l = m + 1;
+        else
+           h = m;
+        }
+  return l;
+}
+
 int cIndexFile::GetNextIFrame(int Index, bool Forward, uint16_t *FileNumber, off_t *FileOffset, int *Length)
 {
   if (CatchUp()) {
-     int d = Forward ? 1 : -1;
-     for (;;) {
-         Index += d;
-         if (Index >= 0 && Index <= last) {
-            if (index[Index].independent) {
-               uint16_t fn;
-               if (!FileNumber)
-                  FileNumber = &fn;
-               off_t fo;
-               if (!FileOffset)
-                  FileOffset = &fo;
-               *FileNumber = index[Index].number;
-               *FileOffset = index[Index].offset;
-               if (Length) {
-                  if (Index < last) {
-                     uint16_t fn = index[Index + 1].number;
-                     off_t fo = index[Index + 1].offset;
-                     if (fn == *FileNumber)
-                        *Length = int(fo - *FileOffset);
-                     else
-                        *Length = -1; // this means "everything up to EOF" (the buffer's Read function will act accordingly)
-                     }
-                  else
-                     *Length = -1;
-                  }
-               return Index;
-               }
-            }
-         else
-            break;
-         }
+     Index += Forward ? 1 : -1;
+     if (Index >= 0 && Index <= last) {
+        UpdateIFrames();
+        cMutexLock MutexLock(&mutex);
+        int i = FindIFrame(Index);
+        if (Forward)
+           Index = i < iFrames.Size() ? iFrames[i] : -1;
+        else
+           Index = i < iFrames.Size() && iFrames[i] == Index ? Index : i > 0 ? iFrames[i - 1] : -1;
+        if (Index >= 0) {
+           uint16_t fn;
+           if (!FileNumber)
+              FileNumber = &fn;
+           off_t fo;
+           if (!FileOffset)
+              FileOffset = &fo;
+           *FileNumber = index[Index].number;
+           *FileOffset = index[Index].offset;
+           if (Length) {
+              if (Index < last) {
+                 uint16_t fn = index[Index + 1].number;
+                 off_t fo = index[Index + 1].offset;
+                 if (fn == *FileNumber)
+                    *Length = int(fo - *FileOffset);
+                 else
+                    *Length = -1; // this means "everything up to EOF" (the buffer's Read function will act accordingly)
+                 }
+              else
+                 *Length = -1;
+              }
+           return Index;
+           }
+        }
      }
   return -1;
 }
@@ -3104,26 +4668,17 @@ int cIndexFile::GetClosestIFrame(int Index)
 {
   if (index && last > 0) {
      Index = constrain(Index, 0, last);
-     if (index[Index].independent)
+     UpdateIFrames();
+     cMutexLock MutexLock(&mutex);
+     int i = FindIFrame(Index);
+     int ih = i < iFrames.Size() ? iFrames[i] : -1;
+     int il = i > 0 ? iFrames[i - 1] : -1;
+     if (ih == Index)
         return Index;
-     int il = Index - 1;
-     int ih = Index + 1;
-     for (;;) {
-         if (il >= 0) {
-            if (index[il].independent)
-               return il;
-            il--;
-            }
-         else if (ih > last)
-            break;
-         if (ih <= last) {
-            if (index[ih].independent)
-               return ih;
-            ih++;
-            }
-         else if (il < 0)
-            break;
-         }
+     if (il >= 0 && (ih < 0 || Index - il <= ih - Index))
+        return il;
+     if (ih >= 0)
+        return ih;
      }
   return 0;
 }
@@ -3151,6 +4706,7 @@ void cIndexFile::Delete(void)
 {
   if (*fileName) {
      dsyslog("deleting index file '%s'", *fileName);
+     numBuffered = 0;
      if (f >= 0) {
         close(f);
         f = -1;
@@ -3168,7 +4724,7 @@ int cIndexFile::GetLength(const char *FileName, bool IsPesRecording)
   return -1;
 }
 
-bool GenerateIndex(const char *FileName)
+bool GenerateIndex(const char *FileName, int Threads)
 {
   if (DirectoryOk(FileName)) {
      cRecording Recording(FileName);
@@ -3176,7 +4732,7 @@ bool GenerateIndex(const char *FileName)
         if (!Recording.IsPesRecording()) {
            cString IndexFileName = AddDirectory(FileName, INDEXFILESUFFIX);
            unlink(IndexFileName);
-           cIndexFileGenerator *IndexFileGenerator = new cIndexFileGenerator(FileName);
+           cIndexFileGenerator *IndexFileGenerator = new cIndexFileGenerator(FileName, Threads);
            while (IndexFileGenerator->Active())
                  cCondWait::SleepMs(INDEXFILECHECKINTERVAL);
            if (access(IndexFileName, R_OK) == 0)
@@ -3287,6 +4843,14 @@ cUnbufferedFile *cFileName::Open(void)
         file = cVideoDirectory::OpenVideoFile(fileName, O_RDWR | O_CREAT | O_LARGEFILE | BlockingFlag);
         if (!file)
            LOG_ERROR_STR(fileName);
+        else {
+           if (Setup.PreallocateMB && !file->Preallocate(MEGABYTE(off_t(Setup.PreallocateMB))))
+              dsyslog("fallocate() not available, can't preallocate '%s'", fileName);
+           if (Setup.UseDirectIo && !file->UseDirectIo())
+              dsyslog("O_DIRECT not available, writing '%s' through the page cache", fileName);
+           if (Setup.UseIoUring && !file->UseIoUring())
+              dsyslog("io_uring not available, writing '%s' synchronously", fileName);
+           }
         }
      else {
         if (access(fileName, R_OK) == 0) {
@@ -3359,6 +4923,428 @@ cUnbufferedFile *cFileName::NextFile(void)
   return SetOffset(fileNumber + 1);
 }
 
+cString cFileName::NameOf(int Number)
+{
+  return cString::sprintf(isPesRecording ? "%.*s" RECORDFILESUFFIXPES : "%.*s" RECORDFILESUFFIXTS, int(pFileNumber - fileName), fileName, Number);
+}
+
+bool cFileName::Exists(int Number)
+{
+  return access(NameOf(Number), F_OK) == 0;
+}
+
+off_t cFileName::Remove(int Number)
+{
+  if (Number == fileNumber && file)
+     return -1;
+  cString Name = NameOf(Number);
+  struct stat st;
+  if (stat(Name, &st) == 0) {
+     dsyslog("removing %s", *Name);
+     if (unlink(Name) == 0)
+        return st.st_size;
+     }
+  LOG_ERROR_STR(*Name);
+  return -1;
+}
+
+// --- cIFrameFileGenerator --------------------------------------------------
+
+#define IFRAMEFILESUFFIX  "/iframes"
+#define IFRAMEFILEMAGIC   0x4D524649 // "IFRM"
+
+// The I-frame file contains the data of all independent frames, followed by a table
+// with the index and length of each of them, and a trailer with the number of entries
+// in the table and IFRAMEFILEMAGIC (all in host byte order, as in the index file).
+
+class cIFrameFileGenerator : public cThread {
+private:
+  cString recordingName;
+  bool isPesRecording;
+protected:
+  virtual void Action(void) override;
+public:
+  cIFrameFileGenerator(const char *RecordingName, bool IsPesRecording);
+  ~cIFrameFileGenerator();
+  };
+
+cIFrameFileGenerator::cIFrameFileGenerator(const char *RecordingName, bool IsPesRecording)
+:cThread("I-frame file generator")
+,recordingName(RecordingName)
+{
+  isPesRecording = IsPesRecording;
+  Start();
+}
+
+cIFrameFileGenerator::~cIFrameFileGenerator()
+{
+  Cancel(3);
+}
+
+void cIFrameFileGenerator::Action(void)
+{
+  cIndexFile IndexFile(recordingName, false, isPesRecording);
+  if (!IndexFile.Ok())
+     return;
+  cFileName FileName(recordingName, false, false, isPesRecording);
+  cString IFrameFileName = cString::sprintf("%s%s", *recordingName, IFRAMEFILESUFFIX);
+  cString TmpFileName = cString::sprintf("%s.tmp", *IFrameFileName);
+  cUnbufferedFile *f = cUnbufferedFile::Create(TmpFileName, O_WRONLY | O_CREAT | O_TRUNC);
+  if (!f)
+     return;
+  dsyslog("generating I-frame file '%s'", *IFrameFileName);
+  uchar *Buffer = MALLOC(uchar, MAXFRAMESIZE);
+  cVector<uint32_t> Table;
+  bool Ok = Buffer != NULL;
+  int Index = -1;
+  while (Ok && Running()) {
+        if (cIoThrottle::Engaged()) {
+           cCondWait::SleepMs(100);
+           continue;
+           }
+        uint16_t FileNumber;
+        off_t FileOffset;
+        int Length;
+        Index = IndexFile.GetNextIFrame(Index, true, &FileNumber, &FileOffset, &Length);
+        if (Index < 0)
+           break;
+        if (Length < 0 || Length > MAXFRAMESIZE)
+           Length = MAXFRAMESIZE; // see cDvbPlayer::Action()
+        cUnbufferedFile *r = FileName.SetOffset(FileNumber, FileOffset);
+        int n = 0;
+        while (r && n < Length) {
+              int l = r->Read(Buffer + n, Length - n);
+              if (l <= 0) {
+                 if (l < 0)
+                    LOG_ERROR_STR(FileName.Name());
+                 break;
+                 }
+              n += l;
+              }
+        if (n > 0 && f->Write(Buffer, n) == n) {
+           Table.Append(Index);
+           Table.Append(n);
+           }
+        else
+           Ok = false;
+        }
+  free(Buffer);
+  if (Ok && Index < 0) {
+     Table.Append(Table.Size() / 2);
+     Table.Append(IFRAMEFILEMAGIC);
+     int n = Table.Size() * sizeof(uint32_t);
+     Ok = f->Write(&Table[0], n) == n;
+     }
+  else
+     Ok = false;
+  if (f->Close() < 0)
+     Ok = false;
+  delete f;
+  if (Ok && rename(TmpFileName, IFrameFileName) == 0)
+     dsyslog("finished generating I-frame file '%s'", *IFrameFileName);
+  else
+     unlink(TmpFileName);
+}
+
+// --- cIFrameFile -----------------------------------------------------------
+
+cIFrameFile::cIFrameFile(const char *RecordingName, cIndexFile *IndexFile, bool IsPesRecording)
+:recordingName(RecordingName)
+{
+  isPesRecording = IsPesRecording;
+  indexFile = IndexFile;
+  file = NULL;
+  iFrames = NULL;
+  numIFrames = 0;
+  iFrameFileGenerator = NULL;
+  if (!Load() && !indexFile->IsStillRecording())
+     iFrameFileGenerator = new cIFrameFileGenerator(recordingName, isPesRecording);
+}
+
+cIFrameFile::~cIFrameFile()
+{
+  delete iFrameFileGenerator;
+  delete file;
+  free(iFrames);
+}
+
+bool cIFrameFile::Load(void)
+{
+  cString IFrameFileName = cString::sprintf("%s%s", *recordingName, IFRAMEFILESUFFIX);
+  int fd = open(IFrameFileName, O_RDONLY);
+  if (fd < 0) {
+     if (errno != ENOENT)
+        LOG_ERROR_STR(*IFrameFileName);
+     return false;
+     }
+  bool Ok = false;
+  struct stat st;
+  uint32_t Trailer[2];
+  if (fstat(fd, &st) == 0 && st.st_size >= off_t(sizeof(Trailer)) && pread(fd, Trailer, sizeof(Trailer), st.st_size - sizeof(Trailer)) == sizeof(Trailer) && Trailer[1] == IFRAMEFILEMAGIC) {
+     int n = Trailer[0];
+     off_t TableSize = off_t(n) * 2 * sizeof(uint32_t);
+     off_t DataSize = st.st_size - sizeof(Trailer) - TableSize;
+     uint32_t *Table = DataSize >= 0 ? MALLOC(uint32_t, 2 * n) : NULL;
+     if (Table && pread(fd, Table, TableSize, DataSize) == TableSize) {
+        iFrames = MALLOC(tIFrame, n);
+        Ok = iFrames != NULL;
+        off_t Offset = 0;
+        for (int i = 0; Ok && i < n; i++) {
+            tIFrame &f = iFrames[i];
+            f.index = Table[2 * i];
+            f.length = Table[2 * i + 1];
+            f.offset = Offset;
+            Offset += f.length;
+            // Make sure the file still matches the index:
+            uint16_t FileNumber;
+            off_t FileOffset;
+            bool Independent;
+            int Length;
+            Ok = indexFile->Get(f.index, &FileNumber, &FileOffset, &Independent, &Length) && Independent && (i == 0 || f.index > iFrames[i - 1].index) && (Length < 0 || min(Length, MAXFRAMESIZE) == f.length);
+            }
+        if (Ok && Offset == DataSize)
+           numIFrames = n;
+        else {
+           esyslog("ERROR: I-frame file '%s' doesn't match the index", *IFrameFileName);
+           free(iFrames);
+           iFrames = NULL;
+           Ok = false;
+           }
+        }
+     free(Table);
+     }
+  close(fd);
+  if (Ok) {
+     file = cUnbufferedFile::Create(IFrameFileName, O_RDONLY);
+     if (!file) {
+        free(iFrames);
+        iFrames = NULL;
+        numIFrames = 0;
+        return false;
+        }
+     dsyslog("using I-frame file '%s' (%d frames)", *IFrameFileName, numIFrames);
+     }
+  return Ok;
+}
+
+cUnbufferedFile *cIFrameFile::Seek(int Index, int &Length)
+{
+  if (!file && iFrameFileGenerator && !iFrameFileGenerator->Active()) {
+     delete iFrameFileGenerator;
+     iFrameFileGenerator = NULL;
+     Load();
+     }
+  if (file) {
+     int l = 0;
+     int h = numIFrames - 1;
+     while (l <= h) {
+           int m = (l + h) / 2;
+           if (iFrames[m].index < Index)
+              l = m + 1;
+           else if (iFrames[m].index > Index)
+              h = m - 1;
+           else if (file->Seek(iFrames[m].offset, SEEK_SET) == iFrames[m].offset) {
+              Length = iFrames[m].length;
+              return file;
+              }
+           else
+              break;
+           }
+     }
+  return NULL;
+}
+
+// --- cTimeIndexFileGenerator -----------------------------------------------
+
+#define TIMEINDEXFILESUFFIX  "/timeindex"
+#define TIMEINDEXFILEMAGIC   0x58444954 // "TIDX"
+#define TIMEINDEXSCANSIZE    (16 * TS_SIZE) // the PTS is in the first video packet of an independent frame, right after the PAT/PMT
+#define TIMEINDEXMAXGAP      (10 * PTSTICKS) // larger gaps between independent frames are PTS discontinuities
+
+// The time index file contains a table with the index of the independent frame
+// at which each second of the recording begins, followed by a trailer with the
+// number of entries in the table and TIMEINDEXFILEMAGIC (all in host byte order,
+// as in the index file).
+
+class cTimeIndexFileGenerator : public cThread {
+private:
+  cString recordingName;
+  bool isPesRecording;
+protected:
+  virtual void Action(void) override;
+public:
+  cTimeIndexFileGenerator(const char *RecordingName, bool IsPesRecording);
+  ~cTimeIndexFileGenerator();
+  };
+
+cTimeIndexFileGenerator::cTimeIndexFileGenerator(const char *RecordingName, bool IsPesRecording)
+:cThread("time index file generator")
+,recordingName(RecordingName)
+{
+  isPesRecording = IsPesRecording;
+  Start();
+}
+
+cTimeIndexFileGenerator::~cTimeIndexFileGenerator()
+{
+  Cancel(3);
+}
+
+void cTimeIndexFileGenerator::Action(void)
+{
+  cIndexFile IndexFile(recordingName, false, isPesRecording);
+  if (!IndexFile.Ok())
+     return;
+  cRecordingInfo RecordingInfo(recordingName);
+  RecordingInfo.Read();
+  double FramesPerSecond = RecordingInfo.FramesPerSecond();
+  cFileName FileName(recordingName, false, false, isPesRecording);
+  cString TimeIndexFileName = cString::sprintf("%s%s", *recordingName, TIMEINDEXFILESUFFIX);
+  dsyslog("generating time index file '%s'", *TimeIndexFileName);
+  uchar Buffer[TIMEINDEXSCANSIZE];
+  cVector<uint32_t> Table;
+  int64_t Elapsed = 0; // PTS ticks since the first independent frame
+  int64_t LastPts = -1;
+  int LastIndex = -1;
+  int Index = -1;
+  while (Running()) {
+        if (cIoThrottle::Engaged()) {
+           cCondWait::SleepMs(100);
+           continue;
+           }
+        uint16_t FileNumber;
+        off_t FileOffset;
+        int Length;
+        Index = IndexFile.GetNextIFrame(Index, true, &FileNumber, &FileOffset, &Length);
+        if (Index < 0)
+           break;
+        cUnbufferedFile *r = FileName.SetOffset(FileNumber, FileOffset);
+        int l = r ? r->Read(Buffer, Length < 0 ? sizeof(Buffer) : min(Length, int(sizeof(Buffer)))) : -1;
+        if (l < 0) {
+           LOG_ERROR_STR(FileName.Name());
+           break;
+           }
+        int64_t Pts = TsGetPts(Buffer, l);
+        if (Pts < 0)
+           continue;
+        if (LastPts >= 0) {
+           int64_t d = PtsDiff(LastPts, Pts);
+           if (d <= 0 || d > TIMEINDEXMAXGAP)
+              d = int64_t((Index - LastIndex) * PTSTICKS / FramesPerSecond); // bridge a discontinuity with the frame rate
+           Elapsed += d;
+           }
+        // The seconds up to this frame begin at the previous one:
+        while (LastIndex >= 0 && int64_t(Table.Size()) * PTSTICKS < Elapsed)
+              Table.Append(LastIndex);
+        LastPts = Pts;
+        LastIndex = Index;
+        }
+  if (Index >= 0 || LastIndex < 0)
+     return; // cancelled, or nothing to index
+  if (int64_t(Table.Size()) * PTSTICKS <= Elapsed)
+     Table.Append(LastIndex);
+  Table.Append(Table.Size());
+  Table.Append(TIMEINDEXFILEMAGIC);
+  cSafeFile f(TimeIndexFileName);
+  if (f.Open()) {
+     fwrite(&Table[0], sizeof(uint32_t), Table.Size(), f);
+     if (f.Close())
+        dsyslog("finished generating time index file '%s' (%d seconds)", *TimeIndexFileName, Table.Size() - 2);
+     }
+}
+
+// --- cTimeIndexFile --------------------------------------------------------
+
+cTimeIndexFile::cTimeIndexFile(const char *RecordingName, cIndexFile *IndexFile, bool IsPesRecording, bool Generate)
+:recordingName(RecordingName)
+{
+  isPesRecording = IsPesRecording;
+  indexFile = IndexFile;
+  seconds = NULL;
+  numSeconds = 0;
+  timeIndexFileGenerator = NULL;
+  if (!Load() && Generate && !isPesRecording && !indexFile->IsStillRecording())
+     timeIndexFileGenerator = new cTimeIndexFileGenerator(recordingName, isPesRecording);
+}
+
+cTimeIndexFile::~cTimeIndexFile()
+{
+  delete timeIndexFileGenerator;
+  free(seconds);
+}
+
+bool cTimeIndexFile::Load(void)
+{
+  cString TimeIndexFileName = cString::sprintf("%s%s", *recordingName, TIMEINDEXFILESUFFIX);
+  int fd = open(TimeIndexFileName, O_RDONLY);
+  if (fd < 0) {
+     if (errno != ENOENT)
+        LOG_ERROR_STR(*TimeIndexFileName);
+     return false;
+     }
+  bool Ok = false;
+  struct stat st;
+  uint32_t Trailer[2];
+  if (fstat(fd, &st) == 0 && st.st_size >= off_t(sizeof(Trailer)) && pread(fd, Trailer, sizeof(Trailer), st.st_size - sizeof(Trailer)) == sizeof(Trailer) && Trailer[1] == TIMEINDEXFILEMAGIC) {
+     int n = Trailer[0];
+     off_t TableSize = off_t(n) * sizeof(uint32_t);
+     if (n > 0 && TableSize == st.st_size - off_t(sizeof(Trailer))) {
+        seconds = MALLOC(uint32_t, n);
+        if (seconds && pread(fd, seconds, TableSize, 0) == TableSize) {
+           // Make sure the file still matches the index:
+           uint16_t FileNumber;
+           off_t FileOffset;
+           bool Independent;
+           Ok = int(seconds[n - 1]) <= indexFile->Last() && indexFile->Get(seconds[n - 1], &FileNumber, &FileOffset, &Independent) && Independent;
+           for (int i = 1; Ok && i < n; i++)
+               Ok = seconds[i] >= seconds[i - 1];
+           }
+        }
+     if (Ok)
+        numSeconds = n;
+     else {
+        esyslog("ERROR: time index file '%s' doesn't match the index", *TimeIndexFileName);
+        free(seconds);
+        seconds = NULL;
+        }
+     }
+  close(fd);
+  if (Ok)
+     dsyslog("using time index file '%s' (%d seconds)", *TimeIndexFileName, numSeconds);
+  return Ok;
+}
+
+int cTimeIndexFile::GetIndex(int Seconds)
+{
+  if (!seconds && timeIndexFileGenerator && !timeIndexFileGenerator->Active()) {
+     delete timeIndexFileGenerator;
+     timeIndexFileGenerator = NULL;
+     Load();
+     }
+  if (seconds && Seconds < numSeconds)
+     return seconds[max(Seconds, 0)];
+  return -1;
+}
+
+int cTimeIndexFile::GetSeconds(int Index)
+{
+  if (GetIndex(0) < 0)
+     return -1;
+  // Find the first second that begins at or after Index:
+  int l = 0;
+  int h = numSeconds;
+  while (l < h) {
+        int m = (l + h) / 2;
+        if (int(seconds[m]) < Index)
+           l = m + 1;
+        else
+           h = m;
+        }
+  if (l < numSeconds && int(seconds[l]) == Index)
+     return l;
+  return max(l - 1, 0);
+}
+
 // --- cDoneRecordings -------------------------------------------------------
 
 cDoneRecordings DoneRecordingsPattern;
@@ -3403,9 +5389,18 @@ bool cDoneRecordings::Save(void) const
   return result;
 }
 
+static unsigned int FuzzyHash(const char *Title);
+
+cDoneRecordings::cDoneRecordings(void)
+:titles(HASHSIZE, true)
+{
+}
+
 void cDoneRecordings::Add(const char *Title)
 {
-  doneRecordings.Append(strdup(Title));
+  char *s = strdup(Title);
+  doneRecordings.Append(s);
+  titles.Add(new cDoneRecordingsTitle(s), FuzzyHash(s));
 }
 
 void cDoneRecordings::Append(const char *Title)
@@ -3431,22 +5426,44 @@ static const char *SkipFuzzyChars(const char *s)
   return s;
 }
 
+static bool FuzzyMatch(const char *s, const char *t)
+{
+  while (*s && *t) {
+        s = SkipFuzzyChars(s);
+        t = SkipFuzzyChars(t);
+        if (!*s || !*t)
+           break;
+        if (toupper(uchar(*s)) != toupper(uchar(*t)))
+           break;
+        s++;
+        t++;
+        }
+  return !*s && !*t;
+}
+
+static unsigned int FuzzyHash(const char *Title)
+{
+  // Two titles that match according to FuzzyMatch() have the same characters
+  // (ignoring case and FuzzyChars), and either both or none of them ends with
+  // FuzzyChars:
+  unsigned int h = 2166136261u; // FNV-1a
+  bool Trailing = false;
+  for (const char *s = Title; *s; s++) {
+      if (strchr(FuzzyChars, *s))
+         Trailing = true;
+      else {
+         h = (h ^ uchar(toupper(uchar(*s)))) * 16777619u;
+         Trailing = false;
+         }
+      }
+  return Trailing ? ~h : h;
+}
+
 bool cDoneRecordings::Contains(const char *Title) const
 {
-  for (int i = 0; i < doneRecordings.Size(); i++) {
-      const char *s = doneRecordings[i];
-      const char *t = Title;
-      while (*s && *t) {
-            s = SkipFuzzyChars(s);
-            t = SkipFuzzyChars(t);
-            if (!*s || !*t)
-               break;
-            if (toupper(uchar(*s)) != toupper(uchar(*t)))
-               break;
-            s++;
-            t++;
-            }
-      if (!*s && !*t)
+  unsigned int Hash = FuzzyHash(Title);
+  for (const cDoneRecordingsTitle *t = titles.Get(Hash); t; t = titles.GetNext(Hash, t)) {
+      if (FuzzyMatch(t->title, Title))
          return true;
       }
   return false;
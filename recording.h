@@ -10,6 +10,7 @@
 #ifndef __RECORDING_H
 #define __RECORDING_H
 
+#include <atomic>
 #include <time.h>
 #include "channels.h"
 #include "config.h"
@@ -34,6 +35,7 @@ enum eRecordingUsage {
   ruCut      = 0x0004, // the recording is being cut
   ruMove     = 0x0008, // the recording is being moved
   ruCopy     = 0x0010, // the recording is being copied
+  ruPreview  = 0x0100, // a preview of the recording is being generated
   // mutually exclusive:
   ruSrc      = 0x0020, // the recording is the source of a cut, move or copy process
   ruDst      = 0x0040, // the recording is the destination of a cut, move or copy process
@@ -80,8 +82,15 @@ private:
   char *fileName;
   int errors;
   int tmpErrors;
+  int bitRate;
+  int maxBitRate;
+  int maxBufferFill;
+  int overflows;
+  int maxWriteLatency;
+  char *continuityErrors;
   cRecordingInfo(const cChannel *Channel = NULL, const cEvent *Event = NULL);
   bool Read(FILE *f, bool Force = false);
+  bool Parse(char *s, int Line);
 public:
   cRecordingInfo(const char *FileName);
   ~cRecordingInfo();
@@ -111,6 +120,22 @@ public:
   int Errors(void) const { return errors; } // returns -1 if undefined
   int TmpErrors(void) const { return tmpErrors; } // returns -1 if undefined
   void SetErrors(int Errors, int TmpErrors = 0);
+  int BitRate(void) const { return bitRate; }
+       ///< Returns the average bit rate of the recording (in kbit/s), or 0 if unknown.
+  int MaxBitRate(void) const { return maxBitRate; }
+       ///< Returns the highest bit rate within one second (in kbit/s), or 0 if unknown.
+  int MaxBufferFill(void) const { return maxBufferFill; }
+       ///< Returns the highest fill level of the recording's ring buffer (in percent).
+  int Overflows(void) const { return overflows; }
+       ///< Returns the number of times data had to be dropped because the ring buffer
+       ///< was full.
+  int MaxWriteLatency(void) const { return maxWriteLatency; }
+       ///< Returns the longest time a write to the recording's files took (in ms).
+  const char *ContinuityErrors(void) const { return continuityErrors; }
+       ///< Returns the continuity errors of all PIDs that had any, as a list of
+       ///< "pid:errors" pairs separated by blanks, or NULL if there were none.
+  void SetStats(int BitRate, int MaxBitRate, int MaxBufferFill, int Overflows, int MaxWriteLatency, const char *ContinuityErrors);
+       ///< Sets the statistics the recorder has measured while recording.
   bool Write(FILE *f, const char *Prefix = "") const;
   bool Read(bool Force = false);
   bool Write(void) const;
@@ -118,8 +143,14 @@ public:
   void SetAux(const char *Aux);
   };
 
+class cRecordings;
+
+enum eRecordingsSortMode { rsmName, rsmTime };
+
 class cRecording : public cListObject {
   friend class cRecordings;
+  friend class cVideoDirectoryScannerThread;
+  friend class cVideoDirectoryWatcher;
 private:
   int id;
   mutable int resume;
@@ -135,10 +166,21 @@ private:
   bool isPesRecording;
   mutable int isOnVideoDirectoryFileSystem; // -1 = unknown, 0 = no, 1 = yes
   cRecordingInfo *info;
+  mutable std::atomic_bool infoLoaded; // true if the info file has been read
+  bool hasSummary; // true if the priority, lifetime, frame rate and errors in info are known without reading the info file
+  static cMutex infoMutex;
+  cRecordings *hashedIn; // the list in which this recording is hashed by its file name
+  unsigned int hashedId; // the hash value it is stored under
+  time_t dirModified; // modification time of the recording's directory when it was last scanned (0 = not scanned)
   cRecording(const cRecording&); // can't copy cRecording
   cRecording &operator=(const cRecording &); // can't assign cRecording
   static char *StripEpisodeName(char *s, bool Strip);
-  char *SortName(void) const;
+  void ReadInfoFile(void) const;
+  const cRecordingInfo *Summary(void) const;
+  void FileNameChanged(void);
+  char *SortName(eRecordingsSortMode SortMode) const;
+       ///< Returns the key this recording is sorted by in the given SortMode. The key
+       ///< is computed only once and can be compared with strcmp().
   void ClearSortName(void);
   void SetId(int Id); // should only be set by cRecordings
   time_t start;
@@ -146,11 +188,15 @@ private:
 public:
   cRecording(cTimer *Timer, const cEvent *Event);
   cRecording(const char *FileName);
+       ///< Creates a recording from the directory with the given FileName.
+       ///< Only the data that can be derived from the FileName itself is set up
+       ///< here. The info file is read when Info() is called for the first time,
+       ///< and the resume, index and size data is read when it is first needed.
   virtual ~cRecording() override;
   int Id(void) const { return id; }
   time_t Start(void) const { return start; }
-  int Priority(void) const { return info->Priority(); }
-  int Lifetime(void) const { return info->Lifetime(); }
+  int Priority(void) const { return Summary()->Priority(); }
+  int Lifetime(void) const { return Summary()->Lifetime(); }
   time_t Deleted(void) const { return deleted; }
   bool RetentionExpired(void) const;
   void SetDeleted(void);
@@ -171,11 +217,13 @@ public:
        ///< Returns the full path name to the recording directory, including the
        ///< video directory and the actual '*.rec'. For disk file access use.
   const char *Title(char Delimiter = ' ', bool NewIndicator = false, int Level = -1) const;
-  cRecordingInfo *Info(void) const { return info; }
+  cRecordingInfo *Info(void) const;
+       ///< Returns the info of this recording, reading the info file if this
+       ///< hasn't been done yet.
   const char *PrefixFileName(char Prefix);
   int HierarchyLevels(void) const;
   void ResetResume(void) const;
-  double FramesPerSecond(void) const { return info->FramesPerSecond(); }
+  double FramesPerSecond(void) const { return Summary()->FramesPerSecond(); }
   int NumFrames(void) const;
        ///< Returns the number of frames in this recording.
        ///< If the number of frames is unknown, -1 will be returned.
@@ -253,16 +301,43 @@ public:
   };
 
 class cVideoDirectoryScannerThread;
+class cVideoDirectoryWatcher;
 
 class cRecordings : public cList<cRecording> {
+  friend class cRecording;
+  friend class cVideoDirectoryScannerThread;
+  friend class cVideoDirectoryWatcher;
 private:
   static cRecordings recordings;
   static cRecordings deletedRecordings;
   static int lastRecordingId;
   static char *updateFileName;
-  static time_t lastUpdate;
+  static char *cacheFileName;
+  static std::atomic<time_t> lastUpdate; // also set by the video directory watcher
   static cVideoDirectoryScannerThread *videoDirectoryScannerThread;
+  static cVideoDirectoryWatcher *videoDirectoryWatcher;
   static const char *UpdateFileName(void);
+  cHash<cRecording> recordingsByName;
+  cVector<cRecording *> sortIndex[2]; // the recordings in the order of each eRecordingsSortMode
+  bool sortIndexValid[2];
+  int listSortMode; // the eRecordingsSortMode the list itself is sorted by, -1 if it is not sorted
+  void HashRecording(cRecording *Recording);
+  void UnhashRecording(cRecording *Recording);
+  static int CompareRecordings(const cRecording *Recording1, const cRecording *Recording2, eRecordingsSortMode SortMode);
+  int IndexRecording(cRecording *Recording);
+       ///< Inserts Recording into the valid sort indexes and returns its position
+       ///< in the index of listSortMode, or -1 if the list is not sorted.
+  void UnindexRecording(cRecording *Recording);
+       ///< Removes Recording from the sort indexes.
+  void InsertRecording(cRecording *Recording);
+       ///< Inserts Recording into the sort indexes and into the list itself. If the
+       ///< list is sorted, Recording is inserted at its proper position, otherwise
+       ///< it is appended.
+  void ResortRecording(cRecording *Recording);
+       ///< Moves Recording to its new position after its sort name has changed.
+  void InvalidateSortIndexes(void);
+  bool LoadCache(void);
+  bool SaveCache(void) const;
 public:
   cRecordings(bool Deleted = false);
   virtual ~cRecordings() override;
@@ -278,6 +353,12 @@ public:
   static cRecordings *GetDeletedRecordingsWrite(cStateKey &StateKey, int TimeoutMs = 0) { return deletedRecordings.Lock(StateKey, true, TimeoutMs) ? &deletedRecordings : NULL; }
        ///< Gets the list of deleted recordings for write access.
        ///< See cTimers::GetTimersWrite() for details.
+  static void SetCacheFileName(const char *FileName);
+       ///< Sets the name of the file that caches the list of recordings between
+       ///< sessions. If a cache file is set, the first call to Update() loads the
+       ///< cached list immediately, and the video directory scanner then only
+       ///< re-reads the recording directories that have been modified since the
+       ///< cache was written.
   static void Update(bool Wait = false);
        ///< Triggers an update of the list of recordings, which will run
        ///< as a separate thread if Wait is false. If Wait is true, the
@@ -287,13 +368,27 @@ public:
        ///< instances of VDR that access the same video directory can be triggered
        ///< to update their recordings list.
   static bool NeedsUpdate(void);
+  static bool Watching(const char *DirName = NULL);
+       ///< Returns true if changes in the video directory are currently reported by
+       ///< the video directory watcher. If DirName is given, it must also report
+       ///< changes of the files in that directory.
   void ResetResume(const char *ResumeFileName = NULL);
   void ClearSortNames(void);
+  void Sort(void);
+       ///< Sorts the list according to the current RecordingsSortMode. The order of
+       ///< each sort mode is kept in an index, and recordings that are added or
+       ///< renamed later are inserted at their proper position in these indexes
+       ///< and in the list. So once a sort mode has been used, switching back to it
+       ///< or sorting again only takes a single pass over the list.
   const cRecording *GetById(int Id) const;
   cRecording *GetById(int Id) { return const_cast<cRecording *>(static_cast<const cRecordings *>(this)->GetById(Id)); };
   const cRecording *GetByName(const char *FileName) const;
   cRecording *GetByName(const char *FileName) { return const_cast<cRecording *>(static_cast<const cRecordings *>(this)->GetByName(FileName)); }
   void Add(cRecording *Recording);
+  void Del(cRecording *Recording, bool DeleteObject = true);
+       ///< Deletes the given Recording from this list (see cListBase::Del()).
+       ///< Add(), Del() and Clear() keep the index used by GetByName() up to date.
+  virtual void Clear(void) override;
   void AddByName(const char *FileName, bool TriggerUpdate = true);
   [[deprecated("use explicit locking, deleting etc.")]] void DelByName(const char *FileName);
   void UpdateByName(const char *FileName);
@@ -340,13 +435,23 @@ DEF_LIST_LOCK2(Recordings, DeletedRecordings);
 
 class cRecordingsHandlerEntry;
 
+#define MAXJOBSPERDISK 8 // max. number of operations running in parallel on the same file system
+
 class cRecordingsHandler : public cThread {
 private:
   cMutex mutex;
   cList<cRecordingsHandlerEntry> operations;
   bool finished;
   bool error;
+  bool Editing(void);
+  void CancelPreview(const char *FileName);
   cRecordingsHandlerEntry *Get(const char *FileName);
+  cRecordingsHandlerEntry *NextPending(void);
+       ///< Returns the pending operation that shall be started next, or NULL if
+       ///< there is none, or all of them would exceed Setup.JobsPerDisk on their
+       ///< target file system. Cutting comes before moving, which comes before
+       ///< copying, which comes before generating previews, and operations of equal priority are started in the order
+       ///< they have been added.
 protected:
   virtual void Action(void) override;
 public:
@@ -354,11 +459,21 @@ public:
   virtual ~cRecordingsHandler() override;
   bool Add(int Usage, const char *FileNameSrc, const char *FileNameDst = NULL);
        ///< Adds the given FileNameSrc to the recordings handler for (later)
-       ///< processing. Usage can be either ruCut, ruMove or ruCopy. FileNameDst
-       ///< is only applicable for ruMove and ruCopy.
+       ///< processing. Usage can be either ruCut, ruMove, ruCopy or ruPreview.
+       ///< FileNameDst is only applicable for ruMove and ruCopy.
+       ///< ruPreview generates the file 'preview.ts' in the recording's directory,
+       ///< which contains a copy of one independent frame every few seconds (up to
+       ///< PREVIEWFRAMES frames), so that frontends can show previews without
+       ///< having to read the whole recording. If the primary device can decode
+       ///< images (see cDevice::DecodeImage()), the file 'thumbnail.jpg' is generated,
+       ///< too. Previews are generated automatically when a recording or a cut has
+       ///< ended. They don't count as editing (see Active()), and a preview that is
+       ///< being generated is canceled if the recording is cut, moved or copied.
        ///< At any given time there can be only one operation for any FileNameSrc
        ///< or FileNameDst in the list. An attempt to add a file name twice will
        ///< result in an error.
+       ///< Operations on different file systems run in parallel, and up to
+       ///< Setup.JobsPerDisk operations may run on the same file system.
        ///< Returns true if the operation was successfully added to the list.
   void Del(const char *FileName);
        ///< Deletes the given FileName from the list of operations.
@@ -367,8 +482,12 @@ public:
        ///< that was given when the operation was added with Add().
   void DelAll(void);
        ///< Deletes/terminates all operations.
+  bool Active(void);
+       ///< Returns true if any cut, move or copy operations are pending or
+       ///< in progress.
   int GetUsage(const char *FileName);
-       ///< Returns the usage type for the given FileName.
+       ///< Returns the usage type for the given FileName. Previews that are
+       ///< being generated are not reported.
   int GetRequiredDiskSpaceMB(const char *FileName = NULL);
        ///< Returns the total disk space required to process all actions.
        ///< If FileName is given, only the drive that contains that file is taken
@@ -382,6 +501,8 @@ public:
 
 extern cRecordingsHandler RecordingsHandler;
 
+#define PREVIEWFRAMES 100 // the maximum number of frames in the preview of a recording
+
 #define DEFAULTFRAMESPERSECOND 25.0
 
 class cMark : public cListObject {
@@ -411,12 +532,23 @@ private:
   time_t nextUpdate;
   time_t lastFileTime;
   time_t lastChange;
+  bool watched;
+  bool changed;
+  static cMutex marksMutex;
+  static cVector<cMarks *> loadedMarks;
 public:
-  cMarks(void): cConfig<cMark>("Marks") {};
+  cMarks(void);
+  virtual ~cMarks() override;
   static cString MarksFileName(const cRecording *Recording);
        ///< Returns the marks file name for the given Recording (regardless whether such
        ///< a file actually exists).
   static bool DeleteMarksFile(const cRecording *Recording);
+  static void FileChanged(const char *RecordingFileName);
+       ///< Tells all loaded marks of the recording with the given RecordingFileName
+       ///< that their file has been changed, so that the next call to Update()
+       ///< reads it again. This is called by the video directory watcher, and as
+       ///< long as it watches a recording, Update() doesn't need to check the file
+       ///< modification time of its marks.
   bool Load(const char *RecordingFileName, double FramesPerSecond = DEFAULTFRAMESPERSECOND, bool IsPesRecording = false);
   bool Update(void);
   bool Save(void);
@@ -455,7 +587,36 @@ public:
   cMark *GetNextEnd(const cMark *BeginMark) { return const_cast<cMark *>(static_cast<const cMarks *>(this)->GetNextEnd(BeginMark)); }
   };
 
-class cErrors : public cVector<int> {
+class cErrors {
+private:
+  cVector<int> first; // the first frame of each run of consecutive errors
+  cVector<int> last;  // the last frame of each run
+  cVector<int> count; // the number of frames in all runs before this one
+  int size;
+  int Find(int Position) const;
+  int Before(int Position) const;
+public:
+  cErrors(void);
+  void Clear(void);
+  void Append(int Position);
+       ///< Adds the frame at the given Position. Positions must be appended in
+       ///< ascending order, and consecutive ones are stored as a single run.
+  int Size(void) const { return size; }
+       ///< Returns the total number of frames with errors.
+  int At(int Index) const;
+       ///< Returns the position of the frame with the given Index (0...Size() - 1)
+       ///< among all frames with errors.
+  int Runs(void) const { return first.Size(); }
+       ///< Returns the number of runs of consecutive frames with errors.
+  int RunFirst(int Run) const { return first[Run]; }
+  int RunLast(int Run) const { return last[Run]; }
+       ///< Return the first and last frame of the given Run (0...Runs() - 1).
+  int Next(int Position) const;
+       ///< Returns the first frame with errors after Position, or -1 if there is none.
+  int Prev(int Position) const;
+       ///< Returns the last frame with errors before Position, or -1 if there is none.
+  int Count(int From, int To) const;
+       ///< Returns the number of frames with errors in the range From...To (inclusive).
   };
 
 #define RUC_BEFORERECORDING  "before"
@@ -499,15 +660,25 @@ private:
   cString fileName;
   int size, last;
   int lastErrorIndex;
+  int lastIFrameIndex;
   tIndexTs *index;
+  bool mapped; // index is mapped into memory, rather than read into a buffer
   bool isPesRecording;
+  tIndexTs *writeBuffer;
+  int numBuffered;
+  uint64_t firstBuffered;
   cResumeFile resumeFile;
   cErrors errors;
+  cVector<int> iFrames; // indexes of all independent frames up to lastIFrameIndex, in ascending order
   cIndexFileGenerator *indexFileGenerator;
   cMutex mutex;
   void ConvertFromPes(tIndexTs *IndexTs, int Count);
   void ConvertToPes(tIndexTs *IndexTs, int Count);
   bool CatchUp(int Index = -1);
+  void UpdateIFrames(void);
+  int FindIFrame(int Index);
+       ///< Returns the position within iFrames of the first independent frame at or after
+       ///< the given Index (or iFrames.Size(), if there is none).
 public:
   cIndexFile(const char *FileName, bool Record, bool IsPesRecording = false, bool PauseLive = false);
   [[deprecated("use cIndexFile(::cIndexFile(const char *, bool, bool, bool) instead")]]
@@ -516,6 +687,13 @@ public:
   ~cIndexFile();
   bool Ok(void) { return index != NULL; }
   bool Write(bool Independent, uint16_t FileNumber, off_t FileOffset, bool Errors = false, bool Missing = false);
+       ///< Appends an entry to the index. Entries are collected and written to the
+       ///< file in blocks, but each independent frame is written right away, together
+       ///< with the entries before it, so that a replay of the ongoing recording can
+       ///< see it.
+  bool Flush(void);
+       ///< Writes any entries that have been collected by Write(), but not yet written
+       ///< to the file. This is also done when the index file is destroyed.
   bool Get(int Index, uint16_t *FileNumber, off_t *FileOffset, bool *Independent = NULL, int *Length = NULL, bool *Errors = NULL, bool *Missing = NULL);
   const cErrors *GetErrors(void);
        ///< Returns the frame indexes of errors in the recording (if any).
@@ -550,6 +728,8 @@ public:
   cFileName(const char *FileName, bool Record, bool Blocking = false, bool IsPesRecording = false);
   ~cFileName();
   const char *Name(void) { return fileName; }
+  cString NameOf(int Number);
+       ///< Returns the full path name of the file with the given Number.
   uint16_t Number(void) { return fileNumber; }
   [[deprecated("will be removed in a future version, if your plugin uses this function, contact vdr@tvdr.de")]]
   bool GetLastPatPmtVersions(int &PatVersion, int &PmtVersion);
@@ -557,14 +737,89 @@ public:
   void Close(void);
   cUnbufferedFile *SetOffset(int Number, off_t Offset = 0); // yes, Number is int for easier internal calculating
   cUnbufferedFile *NextFile(void);
+  bool Exists(int Number);
+       ///< Returns true if the file with the given Number exists.
+  off_t Remove(int Number);
+       ///< Removes the file with the given Number, which must not be the one that is
+       ///< currently open. Returns the size of the removed file, or -1 in case of error.
+  };
+
+class cIFrameFileGenerator;
+
+class cIFrameFile {
+private:
+  struct tIFrame {
+    int index;
+    int length;
+    off_t offset;
+    };
+  cString recordingName;
+  bool isPesRecording;
+  cIndexFile *indexFile;
+  cUnbufferedFile *file;
+  tIFrame *iFrames;
+  int numIFrames;
+  cIFrameFileGenerator *iFrameFileGenerator;
+  bool Load(void);
+public:
+  cIFrameFile(const char *RecordingName, cIndexFile *IndexFile, bool IsPesRecording = false);
+       ///< Sets up access to the file that contains copies of all independent frames of
+       ///< the recording with the given RecordingName, packed one after the other, so that
+       ///< trick modes can read them sequentially instead of seeking all over the recording.
+       ///< If there is no such file (or it doesn't match the IndexFile), and the recording
+       ///< is finished, it is generated in the background.
+       ///< IndexFile must stay valid as long as this object exists.
+  ~cIFrameFile();
+  cUnbufferedFile *Seek(int Index, int &Length);
+       ///< If the independent frame with the given Index is available, the file is positioned
+       ///< to it, its length is returned in Length, and the file is returned, so that the frame
+       ///< can be read from it. Otherwise NULL is returned.
+  };
+
+class cTimeIndexFileGenerator;
+
+class cTimeIndexFile {
+private:
+  cString recordingName;
+  bool isPesRecording;
+  cIndexFile *indexFile;
+  uint32_t *seconds; // the index of the independent frame at which each second begins
+  int numSeconds;
+  cTimeIndexFileGenerator *timeIndexFileGenerator;
+  bool Load(void);
+public:
+  cTimeIndexFile(const char *RecordingName, cIndexFile *IndexFile, bool IsPesRecording = false, bool Generate = true);
+       ///< Sets up access to the file that maps each second of the recording with the
+       ///< given RecordingName to the independent frame at which that second begins.
+       ///< The time is taken from the PTS of the independent frames, so that jumping by
+       ///< time works even if the frame rate varies or the PTS has discontinuities.
+       ///< If there is no such file (or it doesn't match the IndexFile), the recording
+       ///< is finished and Generate is true, it is generated in the background.
+       ///< IndexFile must stay valid as long as this object exists.
+  ~cTimeIndexFile();
+  int GetIndex(int Seconds);
+       ///< Returns the index of the independent frame at which the given number of
+       ///< Seconds into the recording begins, or -1 if that isn't known, in which case
+       ///< the caller has to fall back to calculating it from the frame rate.
+  int GetSeconds(int Index);
+       ///< Returns the number of seconds into the recording at the frame with the given
+       ///< Index, or -1 if that isn't known.
+  };
+
+class cDoneRecordingsTitle : public cListObject {
+public:
+  const char *title; // points to the string stored in cDoneRecordings::doneRecordings
+  cDoneRecordingsTitle(const char *Title) { title = Title; }
   };
 
 class cDoneRecordings {
 private:
   cString fileName;
   cStringList doneRecordings;
+  cHash<cDoneRecordingsTitle> titles; // indexed by the "fuzzy" hash of the title
   void Add(const char *Title);
 public:
+  cDoneRecordings(void);
   bool Load(const char *FileName);
   bool Save(void) const;
   void Append(const char *Title);
@@ -588,14 +843,15 @@ char *ExchangeChars(char *s, bool ToFileSystem);
       // be modified and may be reallocated if more space is needed. The return
       // value points to the resulting string, which may be different from s.
 
-bool GenerateIndex(const char *FileName);
+bool GenerateIndex(const char *FileName, int Threads = 0);
        ///< Generates the index of the existing recording with the given FileName.
        ///< An existing index file will be removed before a new one is generated.
+       ///< If the recording consists of several files, up to Threads of them are
+       ///< processed in parallel (0 means one thread per CPU).
 [[deprecated("use GenerateIndex(const char *FileName) instead")]]
 inline bool GenerateIndex(const char *FileName, bool Update) { return GenerateIndex(FileName); }
 
 enum eRecordingsSortDir { rsdAscending, rsdDescending };
-enum eRecordingsSortMode { rsmName, rsmTime };
 extern eRecordingsSortMode RecordingsSortMode;
 bool HasRecordingsSortMode(const char *Directory);
 void GetRecordingsSortMode(const char *Directory);
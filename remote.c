@@ -16,6 +16,7 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include "metrics.h"
 #include "tools.h"
 
 // --- cRemote ---------------------------------------------------------------
@@ -24,6 +25,7 @@
 #define REPEATTIMEOUT  1000 // ms
 
 eKeys cRemote::keys[MaxKeys];
+uint64_t cRemote::keyTimes[MaxKeys];
 int cRemote::in = 0;
 int cRemote::out = 0;
 cTimeMs cRemote::repeatTimeout(-1);
@@ -34,6 +36,15 @@ cCondVar cRemote::keyPressed;
 const char *cRemote::keyMacroPlugin = NULL;
 const char *cRemote::callPlugin = NULL;
 bool cRemote::enabled = true;
+bool cRemote::wakeup = false;
+uint64_t cRemote::keyTime = 0;
+bool cRemote::keyPending = false;
+int cRemote::numKeys = 0;
+int cRemote::numResponses = 0;
+uint64_t cRemote::deliveryTime = 0;
+uint64_t cRemote::maxDeliveryTime = 0;
+uint64_t cRemote::responseTime = 0;
+uint64_t cRemote::maxResponseTime = 0;
 time_t cRemote::lastActivity = 0;
 
 cRemote::cRemote(const char *Name)
@@ -80,6 +91,11 @@ void cRemote::Clear(void)
 }
 
 bool cRemote::Put(eKeys Key, bool AtFront)
+{
+  return Enqueue(Key, AtFront, cTimeMs::Now());
+}
+
+bool cRemote::Enqueue(eKeys Key, bool AtFront, uint64_t Time)
 {
   if (Key != kNone) {
      cMutexLock MutexLock(&mutex);
@@ -93,9 +109,11 @@ bool cRemote::Put(eKeys Key, bool AtFront)
            if (--out < 0)
               out = MaxKeys - 1;
            keys[out] = Key;
+           keyTimes[out] = Time;
            }
         else {
            keys[in] = Key;
+           keyTimes[in] = Time;
            if (++in >= MaxKeys)
               in = 0;
            }
@@ -121,14 +139,14 @@ bool cRemote::PutMacro(eKeys Key)
   return true;
 }
 
-bool cRemote::Put(uint64_t Code, bool Repeat, bool Release)
+bool cRemote::Put(uint64_t Code, bool Repeat, bool Release, uint64_t Time)
 {
   char buffer[32];
   snprintf(buffer, sizeof(buffer), "%016" PRIX64, Code);
-  return Put(buffer, Repeat, Release);
+  return Put(buffer, Repeat, Release, Time);
 }
 
-bool cRemote::Put(const char *Code, bool Repeat, bool Release)
+bool cRemote::Put(const char *Code, bool Repeat, bool Release, uint64_t Time)
 {
   if (learning && this != learning)
      return false;
@@ -138,7 +156,7 @@ bool cRemote::Put(const char *Code, bool Repeat, bool Release)
         Key = eKeys(Key | k_Repeat);
      if (Release)
         Key = eKeys(Key | k_Release);
-     return Put(Key);
+     return Enqueue(Key, false, Time ? Time : cTimeMs::Now());
      }
   if (learning) {
      free(unknownCode);
@@ -184,13 +202,25 @@ eKeys cRemote::Get(int WaitMs, char **UnknownCode)
       cMutexLock MutexLock(&mutex);
       if (in != out) {
          eKeys k = keys[out];
+         keyTime = keyTimes[out];
          if (++out >= MaxKeys)
             out = 0;
          if ((k & k_Repeat) != 0)
             repeatTimeout.Set(REPEATTIMEOUT);
          TriggerLastActivity();
+         if (enabled && k != k_Plugin) {
+            uint64_t Delay = cTimeMs::Now() - keyTime;
+            numKeys++;
+            deliveryTime += Delay;
+            maxDeliveryTime = max(maxDeliveryTime, Delay);
+            keyPending = true;
+            }
          return enabled ? k : kNone;
          }
+      else if (wakeup) {
+         wakeup = false;
+         return kNone;
+         }
       else if (!WaitMs || !keyPressed.TimedWait(mutex, WaitMs) && repeatTimeout.TimedOut())
          return kNone;
       else if (learning && UnknownCode && unknownCode) {
@@ -201,6 +231,42 @@ eKeys cRemote::Get(int WaitMs, char **UnknownCode)
       }
 }
 
+void cRemote::Wakeup(void)
+{
+  cMutexLock MutexLock(&mutex);
+  wakeup = true;
+  keyPressed.Broadcast();
+}
+
+void cRemote::KeyProcessed(void)
+{
+  cMutexLock MutexLock(&mutex);
+  if (keyPending) {
+     uint64_t Delay = cTimeMs::Now() - keyTime;
+     numResponses++;
+     responseTime += Delay;
+     maxResponseTime = max(maxResponseTime, Delay);
+     keyPending = false;
+     }
+}
+
+void cRemote::AddMetrics(cMetrics &Metrics)
+{
+  cMutexLock MutexLock(&mutex);
+  Metrics.Family("vdr_remote_keys", "counter", "Keys delivered to the main loop by the remote controls");
+  Metrics.Add(numKeys);
+  Metrics.Family("vdr_remote_key_delivery_seconds", "counter", "Time from capturing a key to delivering it to the main loop");
+  Metrics.Add(deliveryTime / 1000.0);
+  Metrics.Family("vdr_remote_key_max_delivery_seconds", "gauge", "Longest time from capturing a key to delivering it to the main loop");
+  Metrics.Add(maxDeliveryTime / 1000.0);
+  Metrics.Family("vdr_remote_key_responses", "counter", "Keys the result of which has been flushed to the OSD");
+  Metrics.Add(numResponses);
+  Metrics.Family("vdr_remote_key_response_seconds", "counter", "Time from capturing a key to flushing its result to the OSD");
+  Metrics.Add(responseTime / 1000.0);
+  Metrics.Family("vdr_remote_key_max_response_seconds", "gauge", "Longest time from capturing a key to flushing its result to the OSD");
+  Metrics.Add(maxResponseTime / 1000.0);
+}
+
 void cRemote::TriggerLastActivity(void)
 {
   lastActivity = time(NULL);
@@ -296,11 +362,11 @@ int cKbdRemote::MapCodeToFunc(uint64_t Code)
   return kfNone;
 }
 
-void cKbdRemote::PutKey(uint64_t Code, bool Repeat, bool Release)
+void cKbdRemote::PutKey(uint64_t Code, bool Repeat, bool Release, uint64_t Time)
 {
-  if (rawMode || (!Put(Code, Repeat, Release) && !IsLearning())) {
+  if (rawMode || (!Put(Code, Repeat, Release, Time) && !IsLearning())) {
      if (int func = MapCodeToFunc(Code))
-        Put(KBDKEY(func), Repeat, Release);
+        Put(KBDKEY(func), Repeat, Release, Time);
      }
 }
 
@@ -385,11 +451,13 @@ void cKbdRemote::Action(void)
   cTimeMs LastTime;
   uint64_t FirstCommand = 0;
   uint64_t LastCommand = 0;
+  uint64_t DelayedTime = 0;
   bool Delayed = false;
   bool Repeat = false;
 
   while (Running()) {
         uint64_t Command = ReadKeySequence();
+        uint64_t Now = cTimeMs::Now(); // the time at which the key has been captured
         if (Command) {
            if (Command == LastCommand) {
               // If two keyboard events with the same command come in without an intermediate
@@ -400,7 +468,7 @@ void cKbdRemote::Action(void)
                  continue; // repeat function kicks in after a short delay
               if (LastTime.Elapsed() < (uint)Setup.RcRepeatDelta)
                  continue; // skip same keys coming in too fast
-              PutKey(Command, true);
+              PutKey(Command, true, false, Now);
               Repeat = true;
               LastTime.Set();
               }
@@ -409,10 +477,11 @@ void cKbdRemote::Action(void)
               // need to delay the second command to see whether it is going to be
               // a repeat function or a separate key press:
               Delayed = true;
+              DelayedTime = Now;
               }
            else {
               // This is a totally new key press, so we accept it immediately:
-              PutKey(Command);
+              PutKey(Command, false, false, Now);
               Delayed = false;
               FirstCommand = Command;
               FirstTime.Set();
@@ -426,7 +495,7 @@ void cKbdRemote::Action(void)
         else if (Delayed && FirstCommand) {
            // Timeout after two normal key presses of the same key, so accept the
            // delayed key:
-           PutKey(FirstCommand);
+           PutKey(FirstCommand, false, false, DelayedTime);
            Delayed = false;
            FirstCommand = 0;
            FirstTime.Set();
@@ -17,10 +17,13 @@
 #include "thread.h"
 #include "tools.h"
 
+class cMetrics;
+
 class cRemote : public cListObject {
 private:
   enum { MaxKeys = 2 * MAXKEYSINMACRO };
   static eKeys keys[MaxKeys];
+  static uint64_t keyTimes[MaxKeys]; // the times at which the keys have been captured
   static int in;
   static int out;
   static cTimeMs repeatTimeout;
@@ -32,13 +35,26 @@ private:
   static const char *keyMacroPlugin;
   static const char *callPlugin;
   static bool enabled;
+  static bool wakeup;
+  static uint64_t keyTime;
+  static bool keyPending;
+  static int numKeys;
+  static int numResponses;
+  static uint64_t deliveryTime;
+  static uint64_t maxDeliveryTime;
+  static uint64_t responseTime;
+  static uint64_t maxResponseTime;
   char *name;
+  static bool Enqueue(eKeys Key, bool AtFront, uint64_t Time);
 protected:
   cRemote(const char *Name);
   const char *GetSetup(void);
   void PutSetup(const char *Setup);
-  bool Put(uint64_t Code, bool Repeat = false, bool Release = false);
-  bool Put(const char *Code, bool Repeat = false, bool Release = false);
+  bool Put(uint64_t Code, bool Repeat = false, bool Release = false, uint64_t Time = 0);
+  bool Put(const char *Code, bool Repeat = false, bool Release = false, uint64_t Time = 0);
+       ///< Puts the key with the given Code into the key queue. Time is the
+       ///< time (as given by cTimeMs::Now()) at which the key has been captured
+       ///< by the remote control. If it is 0, the current time is used.
 public:
   virtual ~cRemote() override;
   virtual bool Ready(void) { return true; }
@@ -65,6 +81,21 @@ public:
       ///< plugin name will be reset to NULL by this call.
   static bool HasKeys(void);
   static eKeys Get(int WaitMs = 1000, char **UnknownCode = NULL);
+  static void Wakeup(void);
+      ///< Makes a call to Get() that is currently waiting for a key (or the next
+      ///< one, if there is none) return kNone right away. This can be used by
+      ///< background threads to have VDR's main loop react to something that
+      ///< needs its attention without any delay.
+  static uint64_t KeyTime(void) { return keyTime; }
+      ///< Returns the time (as given by cTimeMs::Now()) at which the key most
+      ///< recently delivered by Get() has been captured by its remote control.
+  static void KeyProcessed(void);
+      ///< Tells the remote control handling that the key most recently delivered
+      ///< by Get() has been processed and its result has been flushed to the OSD.
+      ///< This is used to measure the response time to key presses.
+  static void AddMetrics(cMetrics &Metrics);
+      ///< Adds the number of keys and their delivery and response times to
+      ///< Metrics.
   static time_t LastActivity(void) { return lastActivity; }
       ///< Absolute time when last key was delivered by Get().
   static void TriggerLastActivity(void);
@@ -112,7 +143,7 @@ private:
   int ReadKey(void);
   uint64_t ReadKeySequence(void);
   int MapCodeToFunc(uint64_t Code);
-  void PutKey(uint64_t Code, bool Repeat = false, bool Release = false);
+  void PutKey(uint64_t Code, bool Repeat = false, bool Release = false, uint64_t Time = 0);
 public:
   cKbdRemote(void);
   virtual ~cKbdRemote() override;
@@ -8,6 +8,11 @@
  */
 
 #include "remux.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 #include "device.h"
 #include "libsi/si.h"
 #include "libsi/section.h"
@@ -146,17 +151,57 @@ void TsSetPcr(uchar *p, int64_t Pcr)
 
 int TsSync(const uchar *Data, int Length, const char *File, const char *Function, int Line)
 {
-  int Skipped = 0;
-  while (Length > 0 && (*Data != TS_SYNC_BYTE || Length > TS_SIZE && Data[TS_SIZE] != TS_SYNC_BYTE)) {
-        Data++;
-        Length--;
-        Skipped++;
-        }
+  int Skipped = Length > 0 ? TsFindSync(Data, Length) : 0;
   if (Skipped && File && Function && Line)
      esyslog("ERROR: skipped %d bytes to sync on start of TS packet at %s/%s(%d)", Skipped, File, Function, Line);
   return Skipped;
 }
 
+int TsFindSync(const uchar *Data, int Length)
+{
+  int i = 0;
+#if defined(__SSE2__)
+  // Check 16 positions at a time for sync bytes at three consecutive packet starts:
+  const __m128i Sync = _mm_set1_epi8(TS_SYNC_BYTE);
+  for (; i + 2 * TS_SIZE + 16 <= Length; i += 16) {
+      __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(Data + i)), Sync);
+      __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(Data + i + TS_SIZE)), Sync);
+      __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(Data + i + 2 * TS_SIZE)), Sync);
+      if (int m = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(a, b), c)))
+         return i + __builtin_ctz(m);
+      }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint8x16_t Sync = vdupq_n_u8(TS_SYNC_BYTE);
+  for (; i + 2 * TS_SIZE + 16 <= Length; i += 16) {
+      uint8x16_t a = vceqq_u8(vld1q_u8(Data + i), Sync);
+      uint8x16_t b = vceqq_u8(vld1q_u8(Data + i + TS_SIZE), Sync);
+      uint8x16_t c = vceqq_u8(vld1q_u8(Data + i + 2 * TS_SIZE), Sync);
+      if (vmaxvq_u8(vandq_u8(vandq_u8(a, b), c)))
+         break; // the loop below finds the actual position within these 16 bytes
+      }
+#endif
+  for (; i < Length; i++) {
+      if (Data[i] == TS_SYNC_BYTE) {
+         if (i + TS_SIZE >= Length || Data[i + TS_SIZE] == TS_SYNC_BYTE && (i + 2 * TS_SIZE >= Length || Data[i + 2 * TS_SIZE] == TS_SYNC_BYTE))
+            return i;
+         }
+      }
+  return Length;
+}
+
+int TsSyncedLength(const uchar *Data, int Length)
+{
+  int n = 0;
+  // Check four packets at a time, which avoids most of the branches:
+  for (; n + 4 * TS_SIZE <= Length; n += 4 * TS_SIZE) {
+      if ((Data[n] ^ TS_SYNC_BYTE) | (Data[n + TS_SIZE] ^ TS_SYNC_BYTE) | (Data[n + 2 * TS_SIZE] ^ TS_SYNC_BYTE) | (Data[n + 3 * TS_SIZE] ^ TS_SYNC_BYTE))
+         break;
+      }
+  for (; n + TS_SIZE <= Length && Data[n] == TS_SYNC_BYTE; n += TS_SIZE)
+      ;
+  return n;
+}
+
 int64_t TsGetPts(const uchar *p, int l)
 {
   // Find the first packet with a PTS and use it:
@@ -277,43 +322,105 @@ void cTsPayload::Setup(uchar *Data, int Length, int Pid)
   Reset();
 }
 
+bool cTsPayload::NextPacket(void)
+{
+  for (;; index += TS_SIZE) {
+      if (index + TS_SIZE <= length && data[index] == TS_SYNC_BYTE) { // to make sure we are at a TS header start and drop incomplete TS packets at the end
+         uchar *p = data + index;
+         if (TsPid(p) == pid) { // only handle TS packets for the initial PID
+            if (++numPacketsPid > MAX_TS_PACKETS_FOR_VIDEO_FRAME_DETECTION)
+               break;
+            if (TsError(p))
+               break; // don't parse TS packets with errors
+            if (TsHasPayload(p)) {
+               if (index > 0 && TsPayloadStart(p)) // checking index to not skip the very first TS packet
+                  break;
+               index += TsPayloadOffset(p);
+               return true;
+               }
+            }
+         else if (TsPid(p) == PATPID)
+            break; // caller must see PAT packets in case of index regeneration
+         else
+            numPacketsOther++;
+         }
+      else
+         break;
+      }
+  SetEof();
+  return false;
+}
+
 uchar cTsPayload::GetByte(void)
 {
   if (!Eof()) {
-     if (index % TS_SIZE == 0) { // encountered the next TS header
-        for (;; index += TS_SIZE) {
-            if (data[index] == TS_SYNC_BYTE && index + TS_SIZE <= length) { // to make sure we are at a TS header start and drop incomplete TS packets at the end
-               uchar *p = data + index;
-               if (TsPid(p) == pid) { // only handle TS packets for the initial PID
-                  if (++numPacketsPid > MAX_TS_PACKETS_FOR_VIDEO_FRAME_DETECTION)
-                     return SetEof();
-                  if (TsError(p))
-                     return SetEof(); // don't parse TS packets with errors
-                  if (TsHasPayload(p)) {
-                     if (index > 0 && TsPayloadStart(p)) // checking index to not skip the very first TS packet
-                        return SetEof();
-                     index += TsPayloadOffset(p);
-                     break;
-                     }
-                  }
-               else if (TsPid(p) == PATPID)
-                  return SetEof(); // caller must see PAT packets in case of index regeneration
-               else
-                  numPacketsOther++;
-               }
-            else
-               return SetEof();
-           }
-        }
+     if (index % TS_SIZE == 0 && !NextPacket()) // encountered the next TS header
+        return 0x00;
      return data[index++];
      }
   return 0x00;
 }
 
+int cTsPayload::GetData(const uchar *&Data, int Max)
+{
+  while (Max > 0 && !Eof()) {
+        if (index % TS_SIZE == 0) { // encountered the next TS header
+           if (!NextPacket())
+              break;
+           if (index % TS_SIZE == 0)
+              continue; // the adaptation field filled the entire packet
+           }
+        int n = min(TS_SIZE - index % TS_SIZE, Max);
+        Data = data + index;
+        index += n;
+        return n;
+        }
+  return 0;
+}
+
+void cTsPayload::ScanStartCode(uint32_t &Scanner)
+{
+  if (index % TS_SIZE == 0 || Eof()) { // GetByte() handles the TS header (and EOF)
+     Scanner = (Scanner << 8) | GetByte();
+     return;
+     }
+  const uchar *p = data + index;
+  int n = TS_SIZE - index % TS_SIZE; // the rest of the current TS packet
+  int End = index + n;
+  // The first three bytes may complete a start code with the bytes already in Scanner:
+  for (int i = 0; i < 3 && i < n; i++) {
+      Scanner = (Scanner << 8) | p[i];
+      index++;
+      if ((Scanner & 0xFFFFFF00) == 0x00000100)
+         return;
+      }
+  if (index >= End)
+     return;
+  // From here on the whole start code prefix is within this packet, so we look for
+  // its 0x01, which needs to be followed by at least one more byte in this packet:
+  const uchar *q = p + 2;
+  const uchar *e = p + n - 1;
+  while (q < e && (q = (const uchar *)memchr(q, 0x01, e - q)) != NULL) {
+        if (q[-1] == 0x00 && q[-2] == 0x00) {
+           index = q + 2 - data;
+           Scanner = 0x00000100 | q[1];
+           return;
+           }
+        q++;
+        }
+  index = End;
+  Scanner = (p[n - 4] << 24) | (p[n - 3] << 16) | (p[n - 2] << 8) | p[n - 1];
+}
+
 bool cTsPayload::SkipBytes(int Bytes)
 {
-  while (Bytes-- > 0)
-        GetByte();
+  const uchar *Data;
+  while (Bytes > 0) {
+        int n = GetData(Data, Bytes);
+        if (!n)
+           break;
+        Bytes -= n;
+        }
   return !Eof();
 }
 
@@ -339,8 +446,12 @@ bool cTsPayload::Find(uint32_t Code)
   int OldNumPacketsPid = numPacketsPid;
   int OldNumPacketsOther = numPacketsOther;
   uint32_t Scanner = EMPTY_SCANNER;
+  bool StartCode = (Code & 0xFFFFFF00) == 0x00000100;
   while (!Eof()) {
-        Scanner = (Scanner << 8) | GetByte();
+        if (StartCode)
+           ScanStartCode(Scanner);
+        else
+           Scanner = (Scanner << 8) | GetByte();
         if (Scanner == Code)
            return true;
         }
@@ -482,7 +593,8 @@ void cPatPmtGenerator::GeneratePmtPid(const cChannel *Channel)
 
 void cPatPmtGenerator::GeneratePat(void)
 {
-  memset(pat, 0xFF, sizeof(pat));
+  uchar *pat = patPmt[0];
+  memset(pat, 0xFF, TS_SIZE);
   uchar *p = pat;
   int i = 0;
   p[i++] = TS_SYNC_BYTE; // TS indicator
@@ -559,7 +671,7 @@ void cPatPmtGenerator::GeneratePmt(const cChannel *Channel)
      uchar *q = buf;
      bool pusi = true;
      while (i > 0) {
-           uchar *p = pmt[numPmtPackets++];
+           uchar *p = patPmt[1 + numPmtPackets++];
            int j = 0;
            p[j++] = TS_SYNC_BYTE; // TS indicator
            p[j++] = (pusi ? TS_PAYLOAD_START : 0x00) | (pmtPid >> 8); // flags (3), pid hi (5)
@@ -595,19 +707,28 @@ void cPatPmtGenerator::SetChannel(const cChannel *Channel)
 
 uchar *cPatPmtGenerator::GetPat(void)
 {
-  IncCounter(patCounter, pat);
-  return pat;
+  IncCounter(patCounter, patPmt[0]);
+  return patPmt[0];
 }
 
 uchar *cPatPmtGenerator::GetPmt(int &Index)
 {
   if (Index < numPmtPackets) {
-     IncCounter(pmtCounter, pmt[Index]);
-     return pmt[Index++];
+     IncCounter(pmtCounter, patPmt[1 + Index]);
+     return patPmt[1 + Index++];
      }
   return NULL;
 }
 
+uchar *cPatPmtGenerator::GetPatPmt(int &Length)
+{
+  IncCounter(patCounter, patPmt[0]);
+  for (int i = 1; i <= numPmtPackets; i++)
+      IncCounter(pmtCounter, patPmt[i]);
+  Length = (1 + numPmtPackets) * TS_SIZE;
+  return patPmt[0];
+}
+
 // --- cPatPmtParser ---------------------------------------------------------
 
 cPatPmtParser::cPatPmtParser(bool UpdatePrimaryDevice)
@@ -621,6 +742,8 @@ void cPatPmtParser::Reset(void)
   completed = false;
   pmtSize = 0;
   patVersion = pmtVersion = -1;
+  patLength = pmtLength = 0;
+  patCrc = pmtCrc = 0;
   pmtPids[0] = 0;
   vpid = vtype = 0;
   ppid = 0;
@@ -636,9 +759,15 @@ void cPatPmtParser::ParsePat(const uchar *Data, int Length)
   if ((Length -= Data[0] + 1) <= 0)
      return;
   Data += Data[0] + 1; // process pointer_field
+  int SectionLen = SectionLength(Data, Length);
+  uint32_t Crc = SectionCrc(Data, Length);
+  if (patVersion >= 0 && SectionLen == patLength && Crc == patCrc)
+     return; // the same PAT as before
   SI::PAT Pat(Data, false);
   if (Pat.CheckCRCAndParse()) {
      dbgpatpmt("PAT: TSid = %d, c/n = %d, v = %d, s = %d, ls = %d\n", Pat.getTransportStreamId(), Pat.getCurrentNextIndicator(), Pat.getVersionNumber(), Pat.getSectionNumber(), Pat.getLastSectionNumber());
+     patLength = SectionLen;
+     patCrc = Crc;
      if (patVersion == Pat.getVersionNumber())
         return;
      int NumPmtPids = 0;
@@ -699,10 +828,20 @@ void cPatPmtParser::ParsePmt(const uchar *Data, int Length)
      }
   else
      return; // fragment of broken packet - ignore
+  if (Data == pmt)
+     Length = pmtSize;
+  int SectionLen = SectionLength(Data, Length);
+  uint32_t Crc = SectionCrc(Data, Length);
+  if (pmtVersion >= 0 && SectionLen == pmtLength && Crc == pmtCrc) {
+     pmtSize = 0;
+     return; // the same PMT as before
+     }
   SI::PMT Pmt(Data, false);
   if (Pmt.CheckCRCAndParse()) {
      dbgpatpmt("PMT: sid = %d, c/n = %d, v = %d, s = %d, ls = %d\n", Pmt.getServiceId(), Pmt.getCurrentNextIndicator(), Pmt.getVersionNumber(), Pmt.getSectionNumber(), Pmt.getLastSectionNumber());
      dbgpatpmt("     pcr = %d\n", Pmt.getPCRPid());
+     pmtLength = SectionLen;
+     pmtCrc = Crc;
      if (pmtVersion == Pmt.getVersionNumber())
         return;
      if (updatePrimaryDevice)
@@ -1135,6 +1274,18 @@ void cTsToPes::Reset(void)
   repeatLast = false;
 }
 
+const uchar *cTsToPes::PesInTs(const uchar *Data, int &Length)
+{
+  if (!TsError(Data) && TsPayloadStart(Data)) {
+     int l = TsGetPayload(&Data);
+     if (PesLongEnough(l) && PesHasLength(Data) && PesLength(Data) <= l) {
+        Length = PesLength(Data);
+        return Data;
+        }
+     }
+  return NULL;
+}
+
 // --- Some helper functions for debugging -----------------------------------
 
 void BlockDump(const char *Name, const u_char *Data, int Length)
@@ -1287,7 +1438,7 @@ int cMpeg2Parser::Parse(const uchar *Data, int Length, int Pid)
   for (;;) {
       if (!SeenPayloadStart && tsPayload.AtTsStart())
          OldScanner = scanner;
-      scanner = (scanner << 8) | tsPayload.GetByte();
+      tsPayload.ScanStartCode(scanner);
       if (scanner == 0x00000100) { // Picture Start Code
          if (!SeenPayloadStart && tsPayload.GetLastIndex() > TS_SIZE) {
             scanner = OldScanner;
@@ -1383,6 +1534,9 @@ protected:
        ///< Gets the next data byte. If Raw is true, no filtering will be done.
        ///< With Raw set to false, if the byte sequence 0x000003 is encountered,
        ///< the byte with 0x03 will be skipped.
+  void ScanStartCode(void);
+       ///< Reads raw bytes into scanner until it contains the next NAL unit start code,
+       ///< or the end of the current TS packet has been reached.
   uchar GetBit(void);
   uint32_t GetBits(int Bits);
   uint32_t GetGolombUe(void);
@@ -1430,6 +1584,13 @@ uchar cH264Parser::GetByte(bool Raw)
   return b;
 }
 
+void cH264Parser::ScanStartCode(void)
+{
+  tsPayload.ScanStartCode(scanner);
+  zeroBytes = 0; // just like GetByte(true)
+  bit = -1;
+}
+
 uchar cH264Parser::GetBit(void)
 {
   if (bit < 0) {
@@ -1479,7 +1640,7 @@ int cH264Parser::Parse(const uchar *Data, int Length, int Pid)
         }
      }
   for (;;) {
-      scanner = (scanner << 8) | GetByte(true);
+      ScanStartCode();
       if ((scanner & 0xFFFFFF00) == 0x00000100) { // NAL unit start
          uchar NalUnitType = scanner & 0x1F;
          switch (NalUnitType) {
@@ -1714,7 +1875,7 @@ int cH265Parser::Parse(const uchar *Data, int Length, int Pid)
      scanner = EMPTY_SCANNER;
      }
   for (;;) {
-      scanner = (scanner << 8) | GetByte(true);
+      ScanStartCode();
       if ((scanner & 0xFFFFFF00) == 0x00000100) { // NAL unit start
          uchar NalUnitType = (scanner >> 1) & 0x3F;
          GetByte(); // nuh_layer_id + nuh_temporal_id_plus1
@@ -2037,6 +2198,7 @@ public:
   void SetFrameDelta(int FrameDelta) { frameDelta = FrameDelta; }
   void Process(void);
   void AddPts(int64_t Pts, bool IndependentFrame = false);
+  void Resync(void);
   bool NewMissing(void);
   int Missing(void);
   };
@@ -2110,6 +2272,14 @@ void cPtsChecker::AddPts(int64_t Pts, bool IndependentFrame)
      pts.Append(Pts);
 }
 
+void cPtsChecker::Resync(void)
+{
+  Process();
+  pts.Clear();
+  lastPts = -1;
+  iFrameNoPts = false;
+}
+
 bool cPtsChecker::NewMissing(void)
 {
   bool m = oldMissing < totalMissing;
@@ -2141,6 +2311,12 @@ void cFrameChecker::Reset(void)
   tsChecker->Reset();
 }
 
+void cFrameChecker::Resync(void)
+{
+  tsChecker->Reset();
+  ptsChecker->Resync();
+}
+
 bool cFrameChecker::Check(const uchar *Data, int Length, bool Independent, bool &Errors, bool &Missing, bool Final)
 {
   tsChecker->CheckTs(Data, Length);
@@ -2193,6 +2369,7 @@ cFrameDetector::cFrameDetector(int Pid, int Type)
 
 cFrameDetector::~cFrameDetector()
 {
+  delete parser;
   delete ptsChecker;
   delete tsChecker;
 }
@@ -149,6 +149,15 @@ void TsSetPcr(uchar *p, int64_t Pcr);
 #define TS_SYNC(Data, Length) (*Data == TS_SYNC_BYTE ? 0 : TsSync(Data, Length, __FILE__, __FUNCTION__, __LINE__))
 int TsSync(const uchar *Data, int Length, const char *File = NULL, const char *Function = NULL, int Line = 0);
 
+int TsFindSync(const uchar *Data, int Length);
+   ///< Returns the offset of the first TS_SYNC_BYTE in Data that is followed by
+   ///< TS_SYNC_BYTEs at the beginning of the next two TS packets (as far as these
+   ///< are within Length), or Length if there is no such byte. This is used to
+   ///< resynchronize after broken packets, and is vectorized where possible.
+int TsSyncedLength(const uchar *Data, int Length);
+   ///< Returns the number of bytes (a multiple of TS_SIZE) of the complete TS packets
+   ///< at the beginning of Data that all start with a TS_SYNC_BYTE.
+
 // The following functions all take a pointer to a sequence of complete TS packets.
 
 int64_t TsGetPts(const uchar *p, int l);
@@ -232,6 +241,10 @@ private:
   int numPacketsPid; // the number of TS packets with the given PID (for statistical purposes)
   int numPacketsOther; // the number of TS packets with other PIDs (for statistical purposes)
   uchar SetEof(void);
+  bool NextPacket(void);
+       ///< Moves the read position from the header of a TS packet to the start of the
+       ///< payload of the next TS packet with the proper PID. Returns false (and sets
+       ///< EOF) if there is no such packet.
 protected:
   void Reset(void);
 public:
@@ -267,6 +280,20 @@ public:
        ///< some safety limits.
   uchar GetByte(void);
        ///< Gets the next byte of the TS payload, skipping any intermediate TS header data.
+  int GetData(const uchar *&Data, int Max = TS_SIZE);
+       ///< Gets up to Max of the next bytes of the TS payload that are contiguous in
+       ///< memory, i.e. at most the rest of the payload of the current TS packet.
+       ///< Data is set to point to the first byte, and the number of bytes is returned.
+       ///< The TS headers are handled just like in GetByte(), so the caller can process
+       ///< the payload in runs instead of byte by byte. Returns 0 at the end of the
+       ///< payload.
+  void ScanStartCode(uint32_t &Scanner);
+       ///< Shifts the next payload bytes into Scanner (just like calling
+       ///< Scanner = (Scanner << 8) | GetByte() repeatedly) until Scanner contains
+       ///< a start code (0x000001xx), or the end of the current TS packet has been
+       ///< reached. Within a TS packet the start code prefix is searched for in one
+       ///< go, since GetByte() only needs to be called at packet boundaries. A start
+       ///< code that spans two TS packets is found with the next call.
   bool SkipBytes(int Bytes);
        ///< Skips the given number of bytes in the payload and returns true if there
        ///< is still data left to read.
@@ -297,8 +324,7 @@ public:
 
 class cPatPmtGenerator {
 private:
-  uchar pat[TS_SIZE]; // the PAT always fits into a single TS packet
-  uchar pmt[MAX_PMT_TS][TS_SIZE]; // the PMT may well extend over several TS packets
+  uchar patPmt[1 + MAX_PMT_TS][TS_SIZE]; // the PAT always fits into a single TS packet, the PMT that follows it may well extend over several
   int numPmtPackets;
   int patCounter;
   int pmtCounter;
@@ -344,6 +370,11 @@ public:
        ///< Index must be initialized to 0 and will be incremented by each
        ///< call to GetPmt(). Returns NULL if all packets of the PMT section
        ///< have been fetched.
+  uchar *GetPatPmt(int &Length);
+       ///< Returns a pointer to the PAT section, immediately followed by all
+       ///< TS packets of the PMT section. Length receives the total number of
+       ///< bytes. The packets are only generated when the channel is set, so
+       ///< this merely updates their continuity counters.
   };
 
 // PAT/PMT Parser:
@@ -356,6 +387,8 @@ private:
   int pmtSize;
   int patVersion;
   int pmtVersion;
+  int patLength, pmtLength; // the section length of the most recently parsed PAT/PMT
+  uint32_t patCrc, pmtCrc;  // the CRC of the most recently parsed PAT/PMT
   int pmtPids[MAX_PMT_PIDS + 1]; // list is zero-terminated
   int vpid;
   int ppid;
@@ -375,6 +408,8 @@ private:
   bool completed;
 protected:
   int SectionLength(const uchar *Data, int Length) { return (Length >= 3) ? ((int(Data[1]) & 0x0F) << 8)| Data[2] : 0; }
+  uint32_t SectionCrc(const uchar *Data, int Length) { int l = SectionLength(Data, Length) + 3; return (l >= 7 && l <= Length) ? (uint32_t(Data[l - 4]) << 24) | (Data[l - 3] << 16) | (Data[l - 2] << 8) | Data[l - 1] : 0; }
+       ///< Returns the CRC stored at the end of the section in Data, or 0 if the section is incomplete.
 public:
   cPatPmtParser(bool UpdatePrimaryDevice = false);
   void Reset(void);
@@ -390,6 +425,9 @@ public:
        ///< are delivered to the parser through several subsequent calls to
        ///< ParsePmt(). The whole PMT data will be processed once the last packet
        ///< has been received.
+       ///< A section that has the same length and CRC as the most recently parsed
+       ///< one (which is the case for every repetition of an unchanged PAT or PMT)
+       ///< is skipped without checking and parsing it again.
   bool ParsePatPmt(const uchar *Data, int Length);
        ///< Parses the given Data (which may consist of several TS packets, typically
        ///< an entire frame) and extracts the PAT and PMT.
@@ -490,6 +528,13 @@ public:
        ///< Resets the converter. This needs to be called after a PES packet has
        ///< been fetched by a call to GetPes(), and before the next call to
        ///< PutTs().
+  static const uchar *PesInTs(const uchar *Data, int &Length);
+       ///< If the single TS packet at Data contains a complete PES packet (as is
+       ///< typically the case with subtitles and small audio frames), a pointer to
+       ///< that PES packet within Data is returned, and Length is set to its length.
+       ///< Otherwise NULL is returned. This allows a caller that processes the
+       ///< PES packet right away to do so without copying it via PutTs() and
+       ///< GetPes(). Note that this doesn't Reset() any converter.
   };
 
 // Some helper functions for debugging:
@@ -534,6 +579,10 @@ public:
   cFrameChecker(void);
   ~cFrameChecker();
   void Reset(void);
+  void Resync(void);
+      ///< Tells the checker that frames have been skipped since the last call to Check()
+      ///< (e.g. because they have been copied without looking at their content), so that
+      ///< the resulting gap is not reported as errors or missing frames.
   bool Check(const uchar *Data, int Length, bool Independent, bool &Errors, bool &Missing, bool Final);
       ///< Check Length bytes of the given Data (which must be a complete frame), with
       ///< Independent telling whether this is an I-frame. Errors returns true if this frame
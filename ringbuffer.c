@@ -11,8 +11,10 @@
  */
 
 #include "ringbuffer.h"
+#include <inttypes.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include "metrics.h"
 #include "tools.h"
 
 // --- cRingBuffer -----------------------------------------------------------
@@ -23,8 +25,12 @@
 #define IOTHROTTLELOW       20
 #define IOTHROTTLEHIGH      50
 
-cRingBuffer::cRingBuffer(int Size, bool Statistics)
+cMutex cRingBuffer::ringBuffersMutex;
+cVector<cRingBuffer *> cRingBuffer::ringBuffers;
+
+cRingBuffer::cRingBuffer(int Size, bool Statistics, const char *Description)
 {
+  description = Description ? strdup(Description) : NULL;
   size = Size;
   statistics = Statistics;
   getThreadTid = 0;
@@ -33,14 +39,28 @@ cRingBuffer::cRingBuffer(int Size, bool Statistics)
   putTimeout = getTimeout = 0;
   lastOverflowReport = 0;
   overflowCount = overflowBytes = 0;
+  totalOverflowCount = 0;
+  totalOverflowBytes = 0;
   ioThrottle = NULL;
+  getWaiting = false;
+  putWaiting = false;
+  highWater = 0;
+  putWaitTime = getWaitTime = 0;
+  bytesIn = bytesOut = 0;
+  spsc = false;
+  cMutexLock MutexLock(&ringBuffersMutex);
+  ringBuffers.Append(this);
 }
 
 cRingBuffer::~cRingBuffer()
 {
+  ringBuffersMutex.Lock();
+  ringBuffers.RemoveElement(this);
+  ringBuffersMutex.Unlock();
   delete ioThrottle;
   if (statistics)
      dsyslog("buffer stats: %d (%d%%) used", maxFill, maxFill * 100 / (size - 1));
+  free(description);
 }
 
 void cRingBuffer::UpdatePercentage(int Fill)
@@ -62,28 +82,72 @@ void cRingBuffer::UpdatePercentage(int Fill)
      }
 }
 
+void cRingBuffer::UpdateFill(int Fill)
+{
+  if (Fill > highWater)
+     highWater = Fill;
+  if (statistics)
+     UpdatePercentage(Fill);
+}
+
 void cRingBuffer::WaitForPut(void)
 {
-  if (putTimeout)
-     readyForPut.Wait(putTimeout);
+  if (putTimeout) {
+     uint64_t Start = cTimeMs::Now();
+     if (spsc) {
+        putWaiting = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (Free() <= Size() / 10) // the consumer may have freed space in the meantime
+           readyForPut.Wait(putTimeout);
+        putWaiting = false;
+        }
+     else
+        readyForPut.Wait(putTimeout);
+     putWaitTime += cTimeMs::Now() - Start;
+     }
 }
 
 void cRingBuffer::WaitForGet(void)
 {
-  if (getTimeout)
-     readyForGet.Wait(getTimeout);
+  if (getTimeout) {
+     uint64_t Start = cTimeMs::Now();
+     if (spsc) {
+        getWaiting = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (Available() <= Size() / 10) // the producer may have added data in the meantime
+           readyForGet.Wait(getTimeout);
+        getWaiting = false;
+        }
+     else
+        readyForGet.Wait(getTimeout);
+     getWaitTime += cTimeMs::Now() - Start;
+     }
 }
 
 void cRingBuffer::EnablePut(void)
 {
-  if (putTimeout && Free() > Size() / 10)
-     readyForPut.Signal();
+  if (putTimeout) {
+     if (spsc) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!putWaiting)
+           return;
+        }
+     if (Free() > Size() / 10)
+        readyForPut.Signal();
+     }
 }
 
 void cRingBuffer::EnableGet(void)
 {
-  if (getTimeout && Available() > Size() / 10)
-     readyForGet.Signal();
+  if (getTimeout) {
+     if (spsc) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!getWaiting)
+           return;
+        }
+     if (Available() > Size() / 10)
+        readyForGet.Signal();
+     }
 }
 
 void cRingBuffer::SetTimeouts(int PutTimeout, int GetTimeout)
@@ -102,6 +166,8 @@ void cRingBuffer::ReportOverflow(int Bytes)
 {
   overflowCount++;
   overflowBytes += Bytes;
+  totalOverflowCount++;
+  totalOverflowBytes += Bytes;
   if (time(NULL) - lastOverflowReport > OVERFLOWREPORTDELTA) {
      esyslog("ERROR: %d ring buffer overflow%s (%d bytes dropped)", overflowCount, overflowCount > 1 ? "s" : "", overflowBytes);
      overflowCount = overflowBytes = 0;
@@ -109,6 +175,52 @@ void cRingBuffer::ReportOverflow(int Bytes)
      }
 }
 
+void cRingBuffer::GetStatistics(cStringList &Lines)
+{
+  cMutexLock MutexLock(&ringBuffersMutex);
+  for (int i = 0; i < ringBuffers.Size(); i++) {
+      cRingBuffer *r = ringBuffers[i];
+      Lines.Append(strdup(cString::sprintf("%-24s size %9d, high water %9d (%3d%%), in %14" PRId64 ", out %14" PRId64 ", overflows %6d (%" PRId64 " bytes), waited for put %8" PRId64 " ms, for get %8" PRId64 " ms",
+        r->description ? r->description : "unnamed",
+        r->size, r->highWater, r->size > 1 ? int(r->highWater * 100LL / (r->size - 1)) : 0,
+        r->bytesIn, r->bytesOut,
+        r->totalOverflowCount, r->totalOverflowBytes,
+        r->putWaitTime, r->getWaitTime)));
+      }
+}
+
+void cRingBuffer::AddMetrics(cMetrics &Metrics)
+{
+  cMutexLock MutexLock(&ringBuffersMutex);
+  cStringList Labels;
+  for (int i = 0; i < ringBuffers.Size(); i++)
+      Labels.Append(strdup(cMetrics::Label("buffer", ringBuffers[i]->description ? ringBuffers[i]->description : "unnamed")));
+  Metrics.Family("vdr_ringbuffer_size_bytes", "gauge", "Size of a ring buffer");
+  for (int i = 0; i < ringBuffers.Size(); i++)
+      Metrics.Add(ringBuffers[i]->size, Labels[i]);
+  Metrics.Family("vdr_ringbuffer_fill_bytes", "gauge", "Number of bytes currently in a ring buffer");
+  for (int i = 0; i < ringBuffers.Size(); i++)
+      Metrics.Add(ringBuffers[i]->Available(), Labels[i]);
+  Metrics.Family("vdr_ringbuffer_high_water_bytes", "gauge", "Highest number of bytes that have been in a ring buffer");
+  for (int i = 0; i < ringBuffers.Size(); i++)
+      Metrics.Add(ringBuffers[i]->highWater, Labels[i]);
+  Metrics.Family("vdr_ringbuffer_in_bytes", "counter", "Bytes put into a ring buffer");
+  for (int i = 0; i < ringBuffers.Size(); i++)
+      Metrics.Add(ringBuffers[i]->bytesIn, Labels[i]);
+  Metrics.Family("vdr_ringbuffer_out_bytes", "counter", "Bytes taken out of a ring buffer");
+  for (int i = 0; i < ringBuffers.Size(); i++)
+      Metrics.Add(ringBuffers[i]->bytesOut, Labels[i]);
+  Metrics.Family("vdr_ringbuffer_overflows", "counter", "Overflows of a ring buffer");
+  for (int i = 0; i < ringBuffers.Size(); i++)
+      Metrics.Add(ringBuffers[i]->totalOverflowCount, Labels[i]);
+  Metrics.Family("vdr_ringbuffer_put_wait_seconds", "counter", "Time the producer of a ring buffer has waited for free space");
+  for (int i = 0; i < ringBuffers.Size(); i++)
+      Metrics.Add(ringBuffers[i]->putWaitTime / 1000.0, Labels[i]);
+  Metrics.Family("vdr_ringbuffer_get_wait_seconds", "counter", "Time the consumer of a ring buffer has waited for data");
+  for (int i = 0; i < ringBuffers.Size(); i++)
+      Metrics.Add(ringBuffers[i]->getWaitTime / 1000.0, Labels[i]);
+}
+
 // --- cRingBufferLinear -----------------------------------------------------
 
 #ifdef DEBUGRINGBUFFERS
@@ -159,7 +271,7 @@ void cRingBufferLinear::PrintDebugRBL(void)
          buf[t] = '<';
          buf[h] = '>';
          buf[DEBUGRBLWIDTH] = 0;
-         printf("%2d %s %8d %8d %s\n", i, buf, p->lastPut, p->lastGet, p->description);
+         printf("%2d %s %8d %8d %s\n", i, buf, p->lastPut, p->lastGet, p->description ? p->description : "");
          }
       }
   if (printed)
@@ -168,15 +280,14 @@ void cRingBufferLinear::PrintDebugRBL(void)
 #endif
 
 cRingBufferLinear::cRingBufferLinear(int Size, int Margin, bool Statistics, const char *Description)
-:cRingBuffer(Size, Statistics)
+:cRingBuffer(Size, Statistics, Description)
 {
-  description = Description ? strdup(Description) : NULL;
   tail = head = margin = Margin;
   gotten = 0;
   buffer = NULL;
   if (Size > 1) { // 'Size - 1' must not be 0!
      if (Margin <= Size / 2) {
-        buffer = MALLOC(uchar, Size);
+        buffer = AllocLargeBuffer(Size);
         if (!buffer)
            esyslog("ERROR: can't allocate ring buffer (size=%d)", Size);
         Clear();
@@ -199,8 +310,13 @@ cRingBufferLinear::~cRingBufferLinear()
 #ifdef DEBUGRINGBUFFERS
   DelDebugRBL(this);
 #endif
-  free(buffer);
-  free(description);
+  FreeLargeBuffer(buffer, Size());
+}
+
+void cRingBufferLinear::SetNumaNode(int Node)
+{
+  if (SetLargeBufferNode(buffer, Size(), Node))
+     dsyslog("ring buffer %s bound to NUMA node %d", Description() ? Description() : "", Node);
 }
 
 int cRingBufferLinear::DataReady(const uchar *Data, int Count)
@@ -210,14 +326,14 @@ int cRingBufferLinear::DataReady(const uchar *Data, int Count)
 
 int cRingBufferLinear::Available(void)
 {
-  int diff = head - tail;
+  int diff = head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
   return (diff >= 0) ? diff : Size() + diff - margin;
 }
 
 void cRingBufferLinear::Clear(void)
 {
-  int Head = head;
-  tail = Head;
+  int Head = head.load(std::memory_order_acquire);
+  tail.store(Head, std::memory_order_release);
 #ifdef DEBUGRINGBUFFERS
   lastHead = Head;
   lastTail = tail;
@@ -229,9 +345,10 @@ void cRingBufferLinear::Clear(void)
 
 int cRingBufferLinear::Read(int FileHandle, int Max)
 {
-  int Tail = tail;
-  int diff = Tail - head;
-  int free = (diff > 0) ? diff - 1 : Size() - head;
+  int Tail = tail.load(std::memory_order_acquire);
+  int Head = head.load(std::memory_order_relaxed);
+  int diff = Tail - Head;
+  int free = (diff > 0) ? diff - 1 : Size() - Head;
   if (Tail <= margin)
      free--;
   int Count = -1;
@@ -239,20 +356,19 @@ int cRingBufferLinear::Read(int FileHandle, int Max)
   if (free > 0) {
      if (0 < Max && Max < free)
         free = Max;
-     Count = safe_read(FileHandle, buffer + head, free);
+     Count = safe_read(FileHandle, buffer + Head, free);
      if (Count > 0) {
-        int Head = head + Count;
+        Head += Count;
         if (Head >= Size())
            Head = margin;
-        head = Head;
-        if (statistics) {
-           int fill = head - Tail;
-           if (fill < 0)
-              fill = Size() + fill;
-           else if (fill >= Size())
-              fill = Size() - 1;
-           UpdatePercentage(fill);
-           }
+        head.store(Head, std::memory_order_release);
+        bytesIn += Count;
+        int fill = Head - Tail;
+        if (fill < 0)
+           fill = Size() + fill;
+        else if (fill >= Size())
+           fill = Size() - 1;
+        UpdateFill(fill);
         }
      }
 #ifdef DEBUGRINGBUFFERS
@@ -267,9 +383,10 @@ int cRingBufferLinear::Read(int FileHandle, int Max)
 
 int cRingBufferLinear::Read(cUnbufferedFile *File, int Max)
 {
-  int Tail = tail;
-  int diff = Tail - head;
-  int free = (diff > 0) ? diff - 1 : Size() - head;
+  int Tail = tail.load(std::memory_order_acquire);
+  int Head = head.load(std::memory_order_relaxed);
+  int diff = Tail - Head;
+  int free = (diff > 0) ? diff - 1 : Size() - Head;
   if (Tail <= margin)
      free--;
   int Count = -1;
@@ -277,20 +394,19 @@ int cRingBufferLinear::Read(cUnbufferedFile *File, int Max)
   if (free > 0) {
      if (0 < Max && Max < free)
         free = Max;
-     Count = File->Read(buffer + head, free);
+     Count = File->Read(buffer + Head, free);
      if (Count > 0) {
-        int Head = head + Count;
+        Head += Count;
         if (Head >= Size())
            Head = margin;
-        head = Head;
-        if (statistics) {
-           int fill = head - Tail;
-           if (fill < 0)
-              fill = Size() + fill;
-           else if (fill >= Size())
-              fill = Size() - 1;
-           UpdatePercentage(fill);
-           }
+        head.store(Head, std::memory_order_release);
+        bytesIn += Count;
+        int fill = Head - Tail;
+        if (fill < 0)
+           fill = Size() + fill;
+        else if (fill >= Size())
+           fill = Size() - 1;
+        UpdateFill(fill);
         }
      }
 #ifdef DEBUGRINGBUFFERS
@@ -306,32 +422,32 @@ int cRingBufferLinear::Read(cUnbufferedFile *File, int Max)
 int cRingBufferLinear::Put(const uchar *Data, int Count)
 {
   if (Count > 0) {
-     int Tail = tail;
-     int rest = Size() - head;
-     int diff = Tail - head;
+     int Tail = tail.load(std::memory_order_acquire);
+     int Head = head.load(std::memory_order_relaxed);
+     int rest = Size() - Head;
+     int diff = Tail - Head;
      int free = ((Tail < margin) ? rest : (diff > 0) ? diff : Size() + diff - margin) - 1;
-     if (statistics) {
-        int fill = Size() - free - 1 + Count;
-        if (fill >= Size())
-           fill = Size() - 1;
-        UpdatePercentage(fill);
-        }
+     int fill = Size() - free - 1 + Count;
+     if (fill >= Size())
+        fill = Size() - 1;
+     UpdateFill(fill);
      if (free > 0) {
         if (free < Count)
            Count = free;
         if (Count >= rest) {
-           memcpy(buffer + head, Data, rest);
+           memcpy(buffer + Head, Data, rest);
            if (Count - rest)
               memcpy(buffer + margin, Data + rest, Count - rest);
-           head = margin + Count - rest;
+           head.store(margin + Count - rest, std::memory_order_release);
            }
         else {
-           memcpy(buffer + head, Data, Count);
-           head += Count;
+           memcpy(buffer + Head, Data, Count);
+           head.store(Head + Count, std::memory_order_release);
            }
         }
      else
         Count = 0;
+     bytesIn += Count;
 #ifdef DEBUGRINGBUFFERS
      lastHead = head;
      lastPut = Count;
@@ -345,21 +461,23 @@ int cRingBufferLinear::Put(const uchar *Data, int Count)
 
 uchar *cRingBufferLinear::Get(int &Count)
 {
-  int Head = head;
+  int Head = head.load(std::memory_order_acquire);
+  int Tail = tail.load(std::memory_order_relaxed);
   if (getThreadTid <= 0)
      getThreadTid = cThread::ThreadId();
-  int rest = Size() - tail;
-  if (rest < margin && Head < tail) {
+  int rest = Size() - Tail;
+  if (rest < margin && Head < Tail) {
      int t = margin - rest;
-     memcpy(buffer + t, buffer + tail, rest);
-     tail = t;
-     rest = Head - tail;
+     memcpy(buffer + t, buffer + Tail, rest);
+     Tail = t;
+     tail.store(Tail, std::memory_order_release);
+     rest = Head - Tail;
      }
-  int diff = Head - tail;
+  int diff = Head - Tail;
   int cont = (diff >= 0) ? diff : Size() + diff - margin;
   if (cont > rest)
      cont = rest;
-  uchar *p = buffer + tail;
+  uchar *p = buffer + Tail;
   if ((cont = DataReady(p, cont)) > 0) {
      Count = gotten = cont;
      return p;
@@ -375,12 +493,13 @@ void cRingBufferLinear::Del(int Count)
      Count = gotten;
      }
   if (Count > 0) {
-     int Tail = tail;
+     int Tail = tail.load(std::memory_order_relaxed);
      Tail += Count;
      gotten -= Count;
      if (Tail >= Size())
         Tail = margin;
-     tail = Tail;
+     tail.store(Tail, std::memory_order_release);
+     bytesOut += Count;
      EnablePut();
      }
 #ifdef DEBUGRINGBUFFERS
@@ -389,19 +508,103 @@ void cRingBufferLinear::Del(int Count)
 #endif
 }
 
+// --- cFramePool ------------------------------------------------------------
+
+#define FRAMEPOOLALIGN 16 // the size of a block header, and the alignment of all blocks
+
+struct tFramePoolBlock {
+  int size; // including this header
+  bool used;
+  };
+
+cFramePool::cFramePool(int Size)
+{
+  size = Size / FRAMEPOOLALIGN * FRAMEPOOLALIGN;
+  memory = AllocLargeBuffer(size);
+  if (!memory)
+     esyslog("ERROR: can't allocate frame pool (size=%d)", size);
+  head = tail = 0;
+  end = size;
+  numBlocks = 0;
+}
+
+cFramePool::~cFramePool()
+{
+  if (numBlocks)
+     esyslog("ERROR: %d blocks still in use when deleting frame pool", numBlocks);
+  FreeLargeBuffer(memory, size);
+}
+
+uchar *cFramePool::Alloc(int Size)
+{
+  int Need = FRAMEPOOLALIGN + (Size + FRAMEPOOLALIGN - 1) / FRAMEPOOLALIGN * FRAMEPOOLALIGN;
+  if (memory) {
+     cMutexLock MutexLock(&mutex);
+     int Pos = -1;
+     if (head >= tail) { // the blocks in use are [tail, head)
+        if (size - head >= Need)
+           Pos = head;
+        else if (tail > Need) { // wrap around
+           end = head;
+           Pos = 0;
+           }
+        }
+     else if (tail - head > Need) // the blocks in use are [tail, end) and [0, head)
+        Pos = head;
+     if (Pos >= 0) {
+        tFramePoolBlock *b = (tFramePoolBlock *)(memory + Pos);
+        b->size = Need;
+        b->used = true;
+        head = Pos + Need;
+        numBlocks++;
+        return memory + Pos + FRAMEPOOLALIGN;
+        }
+     }
+  return MALLOC(uchar, Size);
+}
+
+void cFramePool::Free(uchar *Data)
+{
+  if (memory && Data >= memory && Data < memory + size) {
+     cMutexLock MutexLock(&mutex);
+     ((tFramePoolBlock *)(Data - FRAMEPOOLALIGN))->used = false;
+     if (--numBlocks) {
+        // Skip all blocks at the tail that are no longer in use:
+        while (tail != head) {
+              if (tail == end && head < tail) {
+                 tail = 0;
+                 end = size;
+                 continue;
+                 }
+              tFramePoolBlock *b = (tFramePoolBlock *)(memory + tail);
+              if (b->used)
+                 break;
+              tail += b->size;
+              }
+        }
+     else {
+        head = tail = 0;
+        end = size;
+        }
+     }
+  else
+     free(Data);
+}
+
 // --- cFrame ----------------------------------------------------------------
 
-cFrame::cFrame(const uchar *Data, int Count, eFrameType Type, int Index, uint32_t Pts, bool Independent)
+cFrame::cFrame(const uchar *Data, int Count, eFrameType Type, int Index, uint32_t Pts, bool Independent, cFramePool *Pool)
 {
   count = abs(Count);
   type = Type;
   index = Index;
   pts = Pts;
   independent = Type == ftAudio ? true : Independent;
+  pool = Pool;
   if (Count < 0)
      data = (uchar *)Data;
   else {
-     data = MALLOC(uchar, count);
+     data = pool ? pool->Alloc(count) : MALLOC(uchar, count);
      if (data)
         memcpy(data, Data, count);
      else
@@ -412,13 +615,49 @@ cFrame::cFrame(const uchar *Data, int Count, eFrameType Type, int Index, uint32_
 
 cFrame::~cFrame()
 {
-  free(data);
+  if (pool)
+     pool->Free(data);
+  else
+     free(data);
+}
+
+#define MAXFREEFRAMES 1024 // max. number of cFrame objects kept for recycling
+
+static cMutex FreeFramesMutex;
+static void *FreeFrames = NULL; // a list, linked through the first bytes of each object
+static int NumFreeFrames = 0;
+
+void *cFrame::operator new(size_t Size)
+{
+  if (Size == sizeof(cFrame)) {
+     cMutexLock MutexLock(&FreeFramesMutex);
+     if (void *Frame = FreeFrames) {
+        FreeFrames = *(void **)Frame;
+        NumFreeFrames--;
+        return Frame;
+        }
+     }
+  return ::operator new(Size);
+}
+
+void cFrame::operator delete(void *Frame, size_t Size)
+{
+  if (Frame && Size == sizeof(cFrame)) {
+     cMutexLock MutexLock(&FreeFramesMutex);
+     if (NumFreeFrames < MAXFREEFRAMES) {
+        *(void **)Frame = FreeFrames;
+        FreeFrames = Frame;
+        NumFreeFrames++;
+        return;
+        }
+     }
+  ::operator delete(Frame);
 }
 
 // --- cRingBufferFrame ------------------------------------------------------
 
-cRingBufferFrame::cRingBufferFrame(int Size, bool Statistics)
-:cRingBuffer(Size, Statistics)
+cRingBufferFrame::cRingBufferFrame(int Size, bool Statistics, const char *Description)
+:cRingBuffer(Size, Statistics, Description)
 {
   head = NULL;
   currentFill = 0;
@@ -453,6 +692,8 @@ bool cRingBufferFrame::Put(cFrame *Frame)
         head = Frame->next = Frame;
         }
      currentFill += Frame->Count();
+     bytesIn += Frame->Count();
+     UpdateFill(currentFill);
      Unlock();
      EnableGet();
      return true;
@@ -471,6 +712,7 @@ cFrame *cRingBufferFrame::Get(void)
 void cRingBufferFrame::Delete(cFrame *Frame)
 {
   currentFill -= Frame->Count();
+  bytesOut += Frame->Count();
   delete Frame;
 }
 
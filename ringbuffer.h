@@ -10,11 +10,22 @@
 #ifndef __RINGBUFFER_H
 #define __RINGBUFFER_H
 
+#include <atomic>
 #include "thread.h"
 #include "tools.h"
 
+class cMetrics;
+
+// Every ring buffer keeps a few lightweight counters (high water mark, bytes
+// put into and taken out of it, overflows and the time its producer and consumer
+// had to wait), no matter whether Statistics is set. All existing ring buffers
+// can be listed with GetStatistics(), which is what the SVDRP command STAT BUFFERS
+// does.
+
 class cRingBuffer {
 private:
+  static cMutex ringBuffersMutex;
+  static cVector<cRingBuffer *> ringBuffers;
   cCondWait readyForPut, readyForGet;
   int putTimeout;
   int getTimeout;
@@ -22,13 +33,27 @@ private:
   time_t lastOverflowReport;
   int overflowCount;
   int overflowBytes;
+  int totalOverflowCount;
+  int64_t totalOverflowBytes;
   cIoThrottle *ioThrottle;
+  std::atomic_bool getWaiting;
+  std::atomic_bool putWaiting;
+  int highWater;
+  int64_t putWaitTime; // ms
+  int64_t getWaitTime; // ms
 protected:
+  char *description;
+  int64_t bytesIn;
+  int64_t bytesOut;
+  bool spsc;
   tThreadId getThreadTid;
   int maxFill;//XXX
   int lastPercent;
   bool statistics;//XXX
   void UpdatePercentage(int Fill);
+  void UpdateFill(int Fill);
+       ///< Records the current Fill level of the buffer, and calls UpdatePercentage()
+       ///< if statistics are active.
   void WaitForPut(void);
   void WaitForGet(void);
   void EnablePut(void);
@@ -36,13 +61,38 @@ protected:
   virtual void Clear(void) = 0;
   virtual int Available(void) = 0;
   virtual int Free(void) { return Size() - Available() - 1; }
-  int Size(void) { return size; }
 public:
-  cRingBuffer(int Size, bool Statistics = false);
+  cRingBuffer(int Size, bool Statistics = false, const char *Description = NULL);
   virtual ~cRingBuffer();
   void SetTimeouts(int PutTimeout, int GetTimeout);
   void SetIoThrottle(void);
   void ReportOverflow(int Bytes);
+  int Size(void) { return size; }
+  int MaxFill(void) { return maxFill; }
+       ///< Returns the highest number of bytes that have been in the buffer at
+       ///< the same time (only available if Statistics was given as true).
+  int Overflows(void) { return totalOverflowCount; }
+       ///< Returns the total number of overflows reported through ReportOverflow().
+  int64_t OverflowBytes(void) { return totalOverflowBytes; }
+       ///< Returns the total number of bytes reported through ReportOverflow().
+  const char *Description(void) { return description; }
+  int HighWater(void) { return highWater; }
+       ///< Returns the highest number of bytes that have ever been in the buffer at
+       ///< the same time (regardless of Statistics, and not reset by Clear()).
+  int64_t BytesIn(void) { return bytesIn; }
+       ///< Returns the total number of bytes that have been put into the buffer.
+  int64_t BytesOut(void) { return bytesOut; }
+       ///< Returns the total number of bytes that have been taken out of the buffer.
+  int64_t PutWaitTime(void) { return putWaitTime; }
+       ///< Returns the total time (in ms) the producer has waited for free space.
+  int64_t GetWaitTime(void) { return getWaitTime; }
+       ///< Returns the total time (in ms) the consumer has waited for data.
+  static void GetStatistics(cStringList &Lines);
+       ///< Appends one line for each existing ring buffer to Lines, containing the
+       ///< values of the above counters.
+  static void AddMetrics(cMetrics &Metrics);
+       ///< Adds the current fill level and the above counters of all existing ring
+       ///< buffers to Metrics.
   };
 
 class cRingBufferLinear : public cRingBuffer {
@@ -58,10 +108,10 @@ public:
   static void PrintDebugRBL(void);
 #endif
 private:
-  int margin, head, tail;
+  int margin;
+  std::atomic_int head, tail;
   int gotten;
   uchar *buffer;
-  char *description;
 protected:
   virtual int DataReady(const uchar *Data, int Count);
     ///< By default a ring buffer has data ready as soon as there are at least
@@ -74,8 +124,18 @@ public:
     ///< Creates a linear ring buffer.
     ///< The buffer will be able to hold at most Size-Margin-1 bytes of data, and will
     ///< be guaranteed to return at least Margin bytes in one consecutive block.
-    ///< The optional Description is used for debugging only.
+    ///< The optional Description is used for debugging and statistics only.
   virtual ~cRingBufferLinear() override;
+  void SetSpsc(bool On = true) { spsc = On; }
+    ///< Declares that this ring buffer is used by exactly one producer thread
+    ///< (calling Read() or Put()) and one consumer thread (calling Get() and Del()).
+    ///< In this mode the waiting thread is only woken up if it actually sleeps in
+    ///< WaitForGet() or WaitForPut(), rather than signaling the other side on every
+    ///< single Put() or Del(). Statistics and the margin are not affected.
+  void SetNumaNode(int Node);
+    ///< Makes the memory of this ring buffer preferably come from the given NUMA
+    ///< Node (typically the one the device that fills it is attached to). This
+    ///< should be called before the buffer is used. A negative Node does nothing.
   virtual int Available(void) override;
   virtual int Free(void) override { return Size() - Available() - 1 - margin; }
   virtual void Clear(void) override;
@@ -106,6 +166,29 @@ public:
 
 enum eFrameType { ftUnknown, ftVideo, ftAudio, ftDolby };
 
+class cFramePool {
+private:
+  cMutex mutex;
+  uchar *memory;
+  int size;
+  int head;      // where the next block will be allocated
+  int tail;      // the oldest block that is still in use
+  int end;       // the end of the blocks at the top of the memory, if head has wrapped around
+  int numBlocks; // the number of blocks in use
+public:
+  cFramePool(int Size);
+    ///< Creates a pool of Size bytes of memory for the data of cFrame objects.
+    ///< Blocks are allocated from the pool like in a ring buffer, so this works best
+    ///< if they are given back in (roughly) the same order they were allocated.
+    ///< Size should be large enough to hold all frames in use at any given time.
+  ~cFramePool();
+  uchar *Alloc(int Size);
+    ///< Returns a block of at least Size bytes. If the pool is exhausted, the
+    ///< block is allocated with malloc().
+  void Free(uchar *Data);
+    ///< Gives back the given Data, which must have been returned by Alloc().
+  };
+
 class cFrame {
   friend class cRingBufferFrame;
 private:
@@ -116,12 +199,21 @@ private:
   int index;
   uint32_t pts;
   bool independent;
+  cFramePool *pool;
 public:
-  cFrame(const uchar *Data, int Count, eFrameType = ftUnknown, int Index = -1, uint32_t Pts = 0, bool independent = false);
+  cFrame(const uchar *Data, int Count, eFrameType = ftUnknown, int Index = -1, uint32_t Pts = 0, bool independent = false, cFramePool *Pool = NULL);
     ///< Creates a new cFrame object.
     ///< If Count is negative, the cFrame object will take ownership of the given
     ///< Data. Otherwise it will allocate Count bytes of memory and copy Data.
+    ///< If a Pool is given, the copy is allocated from that pool (and if Count is
+    ///< negative, Data must have been allocated with Pool->Alloc()), and the data
+    ///< is given back to the Pool when the frame is deleted, which must be done
+    ///< before the Pool itself is deleted.
   ~cFrame();
+  static void *operator new(size_t Size);
+  static void operator delete(void *Frame, size_t Size);
+    ///< cFrame objects are recycled, so that no memory needs to be allocated for
+    ///< them in steady state.
   uchar *Data(void) const { return data; }
   int Count(void) const { return count; }
   eFrameType Type(void) const { return type; }
@@ -139,7 +231,7 @@ private:
   void Lock(void) { mutex.Lock(); }
   void Unlock(void) { mutex.Unlock(); }
 public:
-  cRingBufferFrame(int Size, bool Statistics = false);
+  cRingBufferFrame(int Size, bool Statistics = false, const char *Description = NULL);
   virtual ~cRingBufferFrame() override;
   virtual int Available(void) override;
   virtual void Clear(void) override;
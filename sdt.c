@@ -37,6 +37,7 @@ void cSdtFilter::SetStatus(bool On)
   cMutexLock MutexLock(&mutex);
   cFilter::SetStatus(On);
   sectionSyncer.Reset();
+  sectionCollector.Clear();
   if (!On)
      source = cSource::stNone;
   transponderState = tsUnknown;
@@ -48,7 +49,7 @@ void cSdtFilter::Trigger(int Source)
   source = Source;
 }
 
-void cSdtFilter::Process(u_short /*Pid*/, u_char /*Tid*/, const u_char *Data, int /*Length*/)
+void cSdtFilter::Process(u_short /*Pid*/, u_char /*Tid*/, const u_char *Data, int Length)
 {
   cMutexLock MutexLock(&mutex);
   SI::SDT sdt(Data, false);
@@ -84,13 +85,42 @@ void cSdtFilter::Process(u_short /*Pid*/, u_char /*Tid*/, const u_char *Data, in
      return;
   if (!sectionSyncer.Check(sdt.getVersionNumber(), sdt.getSectionNumber()))
      return;
+  dbgsdt("SDT: %2d %2d %2d %s %d\n", sdt.getVersionNumber(), sdt.getSectionNumber(), sdt.getLastSectionNumber(), *cSource::ToString(source), Transponder());
+  sectionCollector.Add(sdt.getVersionNumber(), sdt.getSectionNumber(), Data, Length);
+  if (!sectionSyncer.Processed(sdt.getSectionNumber(), sdt.getLastSectionNumber()))
+     return;
+  // The table is complete, so all of its sections are applied to the channels at once:
   cStateKey StateKey;
   cChannels *Channels = cChannels::GetChannelsWrite(StateKey, 10);
-  if (!Channels)
+  if (!Channels) {
+     // we'll try again with the next repetition of this table:
+     sectionSyncer.Reset();
+     sectionCollector.Clear();
      return;
-  dbgsdt("SDT: %2d %2d %2d %s %d\n", sdt.getVersionNumber(), sdt.getSectionNumber(), sdt.getLastSectionNumber(), *cSource::ToString(source), Transponder());
+     }
   bool ChannelsModified = false;
   bool TriggerPat = false;
+  for (int i = 0; i <= sdt.getLastSectionNumber(); i++) {
+      if (const u_char *SectionData = sectionCollector.Get(i)) {
+         SI::SDT Section(SectionData, false);
+         if (Section.CheckCRCAndParse())
+            ChannelsModified |= ProcessServices(Channels, Section, TriggerPat);
+         }
+      }
+  sectionCollector.Clear();
+  if (TriggerPat)
+     patFilter->Trigger();
+  if (Setup.UpdateChannels == 1 || Setup.UpdateChannels >= 3) {
+     ChannelsModified |= Channels->MarkObsoleteChannels(source, sdt.getOriginalNetworkId(), sdt.getTransportStreamId());
+     if (source != Source())
+        ChannelsModified |= Channels->MarkObsoleteChannels(Source(), sdt.getOriginalNetworkId(), sdt.getTransportStreamId());
+     }
+  StateKey.Remove(ChannelsModified);
+}
+
+bool cSdtFilter::ProcessServices(cChannels *Channels, SI::SDT &sdt, bool &TriggerPat)
+{
+  bool ChannelsModified = false;
   SI::SDT::Service SiSdtService;
   for (SI::Loop::Iterator it; sdt.serviceLoop.getNext(SiSdtService, it); ) {
       cChannel *Channel = Channels->GetByChannelID(tChannelID(source, sdt.getOriginalNetworkId(), sdt.getTransportStreamId(), SiSdtService.getServiceId()));
@@ -202,14 +232,5 @@ void cSdtFilter::Process(u_short /*Pid*/, u_char /*Tid*/, const u_char *Data, in
             delete LinkChannels;
          }
       }
-  if (TriggerPat)
-     patFilter->Trigger();
-  if (sectionSyncer.Processed(sdt.getSectionNumber(), sdt.getLastSectionNumber())) {
-     if (Setup.UpdateChannels == 1 || Setup.UpdateChannels >= 3) {
-        ChannelsModified |= Channels->MarkObsoleteChannels(source, sdt.getOriginalNetworkId(), sdt.getTransportStreamId());
-        if (source != Source())
-           ChannelsModified |= Channels->MarkObsoleteChannels(Source(), sdt.getOriginalNetworkId(), sdt.getTransportStreamId());
-        }
-     }
-  StateKey.Remove(ChannelsModified);
+  return ChannelsModified;
 }
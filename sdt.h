@@ -10,7 +10,9 @@
 #ifndef __SDT_H
 #define __SDT_H
 
+#include "channels.h"
 #include "filter.h"
+#include "libsi/section.h"
 #include "pat.h"
 
 class cSdtFilter : public cFilter {
@@ -18,6 +20,7 @@ private:
   enum eTransponderState { tsUnknown, tsWrong, tsAccepted, tsVerified };
   cMutex mutex;
   cSectionSyncer sectionSyncer;
+  cSectionCollector sectionCollector;
   int source;
   int lastSource;
   int lastTransponder;
@@ -25,6 +28,9 @@ private:
   int lastTid;
   cPatFilter *patFilter;
   enum eTransponderState transponderState;
+  bool ProcessServices(cChannels *Channels, SI::SDT &sdt, bool &TriggerPat);
+       ///< Applies the services of the given SDT section to Channels.
+       ///< Returns true if any channel has been modified.
 protected:
   virtual void Process(u_short Pid, u_char Tid, const u_char *Data, int Length) override;
 public:
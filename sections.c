@@ -8,10 +8,13 @@
  */
 
 #include "sections.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include <unistd.h>
 #include "channels.h"
 #include "device.h"
 #include "thread.h"
+#include "trace.h"
 
 // --- cFilterHandle----------------------------------------------------------
 
@@ -35,14 +38,29 @@ cFilterHandle::cFilterHandle(const cFilterData &FilterData)
 class cSectionHandlerPrivate {
 public:
   cChannel channel;
+  int epollFd; // all filter handles are in this epoll set, with their cFilterHandle as data
+  cWakeup wakeup; // also in the epoll set (with NULL as data), signaled whenever the filters change
   };
 
 // --- cSectionHandler -------------------------------------------------------
 
+static cMutex SharedFiltersMutex; // protects SectionHandlers and the 'shared...' members
+static cVector<cSectionHandler *> SectionHandlers;
+
 cSectionHandler::cSectionHandler(cDevice *Device)
 :cThread(NULL, true)
 {
   shp = new cSectionHandlerPrivate;
+  shp->epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (shp->epollFd < 0)
+     LOG_ERROR;
+  else if (shp->wakeup.Fd() >= 0) {
+     epoll_event ev;
+     ev.events = EPOLLIN;
+     ev.data.ptr = NULL;
+     if (epoll_ctl(shp->epollFd, EPOLL_CTL_ADD, shp->wakeup.Fd(), &ev) < 0)
+        LOG_ERROR;
+     }
   device = Device;
   SetDescription("device %d section handler", device->DeviceNumber() + 1);
   statusCount = 0;
@@ -50,15 +68,31 @@ cSectionHandler::cSectionHandler(cDevice *Device)
   waitForLock = false;
   flush = false;
   startFilters = false;
+  sharedOn = false;
+  sharedSource = 0;
+  sharedTransponder = 0;
+  sharedOwner = false;
+  sections = 0;
+  SharedFiltersMutex.Lock();
+  SectionHandlers.Append(this);
+  SharedFiltersMutex.Unlock();
   Start();
 }
 
 cSectionHandler::~cSectionHandler()
 {
+  Cancel(-1);
+  shp->wakeup.Signal();
   Cancel(3);
+  SharedFiltersMutex.Lock();
+  SectionHandlers.RemoveElement(this);
+  SharedFiltersMutex.Unlock();
+  DistributeSharedFilters();
   cFilter *fi;
   while ((fi = filters.First()) != NULL)
         Detach(fi);
+  if (shp->epollFd >= 0)
+     close(shp->epollFd);
   delete shp;
 }
 
@@ -92,10 +126,18 @@ void cSectionHandler::Add(const cFilterData *FilterData)
         fh = new cFilterHandle(*FilterData);
         fh->handle = handle;
         filterHandles.Add(fh);
+        if (shp->epollFd >= 0) {
+           epoll_event ev;
+           ev.events = EPOLLIN;
+           ev.data.ptr = fh;
+           if (epoll_ctl(shp->epollFd, EPOLL_CTL_ADD, handle, &ev) < 0)
+              LOG_ERROR;
+           }
         }
      }
   if (fh)
      fh->used++;
+  shp->wakeup.Signal();
   Unlock();
 }
 
@@ -107,22 +149,27 @@ void cSectionHandler::Del(const cFilterData *FilterData)
   for (fh = filterHandles.First(); fh; fh = filterHandles.Next(fh)) {
       if (fh->filterData.Is(FilterData->pid, FilterData->tid, FilterData->mask)) {
          if (--fh->used <= 0) {
+            if (shp->epollFd >= 0)
+               epoll_ctl(shp->epollFd, EPOLL_CTL_DEL, fh->handle, NULL);
             device->CloseFilter(fh->handle);
             filterHandles.Del(fh);
             break;
             }
          }
       }
+  shp->wakeup.Signal();
   Unlock();
 }
 
-void cSectionHandler::Attach(cFilter *Filter)
+void cSectionHandler::Attach(cFilter *Filter, bool Shared)
 {
   Lock();
   statusCount++;
   filters.Add(Filter);
+  if (Shared)
+     sharedFilters.Append(Filter);
   Filter->sectionHandler = this;
-  if (on)
+  if (on && (!Shared || sharedOn))
      Filter->SetStatus(true);
   Unlock();
 }
@@ -134,9 +181,57 @@ void cSectionHandler::Detach(cFilter *Filter)
   Filter->SetStatus(false);
   Filter->sectionHandler = NULL;
   filters.Del(Filter, false);
+  sharedFilters.RemoveElement(Filter);
   Unlock();
 }
 
+void cSectionHandler::SetSharedStatus(bool On)
+{
+  Lock();
+  if (sharedOn != On) {
+     statusCount++;
+     for (int i = 0; i < sharedFilters.Size(); i++)
+         sharedFilters[i]->SetStatus(On);
+     sharedOn = On;
+     dsyslog("device %d %s collecting transponder wide SI data", device->DeviceNumber() + 1, On ? "starts" : "stops");
+     }
+  Unlock();
+}
+
+void cSectionHandler::SetSharedTransponder(int Source, int Transponder)
+{
+  SharedFiltersMutex.Lock();
+  sharedSource = Source;
+  sharedTransponder = Transponder;
+  SharedFiltersMutex.Unlock();
+  DistributeSharedFilters();
+}
+
+void cSectionHandler::DistributeSharedFilters(void)
+{
+  cMutexLock MutexLock(&SharedFiltersMutex);
+  int n = SectionHandlers.Size();
+  bool Owner[n];
+  for (int i = 0; i < n; i++) {
+      cSectionHandler *h = SectionHandlers[i];
+      Owner[i] = h->sharedTransponder != 0;
+      for (int j = 0; Owner[i] && j < n; j++) {
+          cSectionHandler *g = SectionHandlers[j];
+          if (j != i && g->sharedTransponder && g->sharedSource == h->sharedSource && ISTRANSPONDER(g->sharedTransponder, h->sharedTransponder)) {
+             if (g->sharedOwner > h->sharedOwner || (g->sharedOwner == h->sharedOwner && j < i))
+                Owner[i] = false;
+             }
+          }
+      }
+  for (int i = 0; i < n; i++) {
+      cSectionHandler *h = SectionHandlers[i];
+      if (h->sharedOwner != Owner[i]) {
+         h->sharedOwner = Owner[i];
+         h->shp->wakeup.Signal();
+         }
+      }
+}
+
 void cSectionHandler::SetChannel(const cChannel *Channel)
 {
   Lock();
@@ -152,22 +247,26 @@ void cSectionHandler::SetStatus(bool On)
         statusCount++;
         for (cFilter *fi = filters.First(); fi; fi = filters.Next(fi)) {
             fi->SetStatus(false);
-            if (On)
+            if (On && sharedFilters.IndexOf(fi) < 0)
                fi->SetStatus(true);
             }
+        sharedOn = false; // turned on again in Action() if this is the only section handler on this transponder
         flush = On;
         if (flush)
            flushTimer.Set();
         on = On;
         waitForLock = false;
+        SetSharedTransponder(On ? Source() : 0, On ? Transponder() : 0);
         }
      else
         waitForLock = On;
+     shp->wakeup.Signal();
      }
   Unlock();
 }
 
 #define FLUSH_TIME 100 // ms
+#define MAX_EVENTS   64 // max. number of filter handles to process per call to epoll_wait()
 
 void cSectionHandler::Action(void)
 {
@@ -179,53 +278,53 @@ void cSectionHandler::Action(void)
            SetStatus(true);
            startFilters = false;
            }
-        int NumFilters = filterHandles.Count();
-        if (NumFilters == 0) {
+        SharedFiltersMutex.Lock();
+        bool SharedOn = on && sharedOwner;
+        SharedFiltersMutex.Unlock();
+        if (SharedOn != sharedOn)
+           SetSharedStatus(SharedOn);
+        if (shp->epollFd < 0) {
            Unlock();
            cCondWait::SleepMs(100);
            continue;
            }
-        pollfd pfd[NumFilters];
-        for (cFilterHandle *fh = filterHandles.First(); fh; fh = filterHandles.Next(fh)) {
-            int i = fh->Index();
-            pfd[i].fd = fh->handle;
-            pfd[i].events = POLLIN;
-            pfd[i].revents = 0;
-            }
         int oldStatusCount = statusCount;
         Unlock();
 
-        if (poll(pfd, NumFilters, (!on || waitForLock) ? 100 : 1000) > 0) {
-           for (int i = 0; i < NumFilters; i++) {
-               if (pfd[i].revents & POLLIN) {
-                  cFilterHandle *fh = NULL;
+        epoll_event events[MAX_EVENTS];
+        // Changes to the filters wake us up, so we only need to poll while waiting for the device to get a lock:
+        int NumEvents = epoll_wait(shp->epollFd, events, MAX_EVENTS, waitForLock ? 100 : 1000);
+        if (NumEvents > 0) {
+           for (int i = 0; i < NumEvents; i++) {
+               if (events[i].events & EPOLLIN) {
+                  cFilterHandle *fh = (cFilterHandle *)events[i].data.ptr;
+                  if (!fh) {
+                     shp->wakeup.Clear();
+                     continue;
+                     }
                   LOCK_THREAD;
                   if (statusCount != oldStatusCount)
-                     break;
-                  for (fh = filterHandles.First(); fh; fh = filterHandles.Next(fh)) {
-                      if (pfd[i].fd == fh->handle)
-                         break;
-                      }
-                  if (fh) {
-                     // Read section data:
-                     unsigned char buf[4096]; // max. allowed size for any EIT section
-                     int r = device->ReadFilter(fh->handle, buf, sizeof(buf));
-                     if (flush)
-                        continue; // we do the read anyway, to flush any data that might have come from a different transponder
-                     if (r > 3) { // minimum number of bytes necessary to get section length
-                        int len = (((buf[1] & 0x0F) << 8) | (buf[2] & 0xFF)) + 3;
-                        if (len == r) {
-                           // Distribute data to all attached filters:
-                           int pid = fh->filterData.pid;
-                           int tid = buf[0];
-                           for (cFilter *fi = filters.First(); fi; fi = filters.Next(fi)) {
-                               if (fi->Matches(pid, tid))
-                                  fi->Process(pid, tid, buf, len);
-                               }
-                           }
-                        else
-                           dsyslog("tp %d (%d/%02X) read incomplete section - len = %d, r = %d", Transponder(), fh->filterData.pid, buf[0], len, r);
+                     break; // the filter handles have changed, so events[] might refer to deleted ones
+                  // Read section data:
+                  unsigned char buf[4096]; // max. allowed size for any EIT section
+                  int r = device->ReadFilter(fh->handle, buf, sizeof(buf));
+                  if (flush)
+                     continue; // we do the read anyway, to flush any data that might have come from a different transponder
+                  if (r > 3) { // minimum number of bytes necessary to get section length
+                     int len = (((buf[1] & 0x0F) << 8) | (buf[2] & 0xFF)) + 3;
+                     if (len == r) {
+                        sections++;
+                        // Distribute data to all attached filters:
+                        int pid = fh->filterData.pid;
+                        int tid = buf[0];
+                        VDR_TRACE(section_read, device->DeviceNumber(), pid, tid, len);
+                        for (cFilter *fi = filters.First(); fi; fi = filters.Next(fi)) {
+                            if (fi->Matches(pid, tid))
+                               fi->Process(pid, tid, buf, len);
+                            }
                         }
+                     else
+                        dsyslog("tp %d (%d/%02X) read incomplete section - len = %d, r = %d", Transponder(), fh->filterData.pid, buf[0], len, r);
                      }
                   }
                }
@@ -234,3 +333,230 @@ void cSectionHandler::Action(void)
            }
         }
 }
+
+// --- cSectionDemuxPid ------------------------------------------------------
+
+#define MAX_SECTION_LENGTH 4096 // max. allowed size for any section
+
+class cSectionDemuxPid {
+private:
+  struct tSectionFilter {
+    int handle; // the end that is given to the caller
+    int fd;     // the end the sections are written to
+    uchar tid;
+    uchar mask;
+    };
+  cVector<tSectionFilter *> filters;
+  uchar buffer[MAX_SECTION_LENGTH];
+  int length;
+  bool synced; // we're at the start of a section (or within one)
+  int lastCc;
+  void Deliver(const uchar *Data, int Length);
+  void Put(const uchar *Data, int Length);
+public:
+  int pid;
+  cSectionDemuxPid(int Pid);
+  ~cSectionDemuxPid();
+  int Open(uchar Tid, uchar Mask);
+  bool Close(int Handle);
+  int NumFilters(void) { return filters.Size(); }
+  void Process(const uchar *Data);
+  };
+
+cSectionDemuxPid::cSectionDemuxPid(int Pid)
+{
+  pid = Pid;
+  length = 0;
+  synced = false;
+  lastCc = -1;
+}
+
+cSectionDemuxPid::~cSectionDemuxPid()
+{
+  for (int i = 0; i < filters.Size(); i++) {
+      close(filters[i]->handle);
+      close(filters[i]->fd);
+      delete filters[i];
+      }
+}
+
+int cSectionDemuxPid::Open(uchar Tid, uchar Mask)
+{
+  // A SOCK_SEQPACKET socket pair preserves the boundaries of the sections:
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) < 0) {
+     LOG_ERROR;
+     return -1;
+     }
+  filters.Append(new tSectionFilter { sv[0], sv[1], Tid, Mask });
+  return sv[0];
+}
+
+bool cSectionDemuxPid::Close(int Handle)
+{
+  for (int i = 0; i < filters.Size(); i++) {
+      if (filters[i]->handle == Handle) {
+         close(filters[i]->handle);
+         close(filters[i]->fd);
+         delete filters[i];
+         filters.Remove(i);
+         return true;
+         }
+      }
+  return false;
+}
+
+void cSectionDemuxPid::Deliver(const uchar *Data, int Length)
+{
+  for (int i = 0; i < filters.Size(); i++) {
+      const tSectionFilter *f = filters[i];
+      if (((Data[0] ^ f->tid) & f->mask) == 0)
+         send(f->fd, Data, Length, MSG_DONTWAIT | MSG_NOSIGNAL); // if the reader doesn't keep up, the section is lost, just like with a kernel filter
+      }
+}
+
+void cSectionDemuxPid::Put(const uchar *Data, int Length)
+{
+  while (Length > 0 && synced) {
+        int n = min(Length, MAX_SECTION_LENGTH - length);
+        memcpy(buffer + length, Data, n);
+        length += n;
+        Data += n;
+        Length -= n;
+        while (length >= 3) {
+              if (buffer[0] == 0xFF) { // stuffing up to the end of the TS packet
+                 length = 0;
+                 synced = false;
+                 return;
+                 }
+              int SectionLength = (((buffer[1] & 0x0F) << 8) | buffer[2]) + 3;
+              if (SectionLength > MAX_SECTION_LENGTH) {
+                 length = 0;
+                 synced = false;
+                 return;
+                 }
+              if (length < SectionLength)
+                 break;
+              Deliver(buffer, SectionLength);
+              length -= SectionLength;
+              memmove(buffer, buffer + SectionLength, length);
+              }
+        }
+}
+
+void cSectionDemuxPid::Process(const uchar *Data)
+{
+  if (TsError(Data)) {
+     length = 0;
+     synced = false;
+     return;
+     }
+  if (!TsHasPayload(Data))
+     return;
+  int Cc = TsContinuityCounter(Data);
+  if (Cc == lastCc)
+     return; // duplicate packet
+  if (lastCc >= 0 && Cc != ((lastCc + 1) & TS_CONT_CNT_MASK)) {
+     length = 0; // packets have been lost
+     synced = false;
+     }
+  lastCc = Cc;
+  int Offset = TsPayloadOffset(Data);
+  const uchar *p = Data + Offset;
+  int n = TS_SIZE - Offset;
+  if (TsPayloadStart(Data) && n > 0) {
+     int Pointer = *p++;
+     n--;
+     if (Pointer > n) {
+        length = 0;
+        synced = false;
+        return;
+        }
+     Put(p, Pointer); // the rest of the previous section
+     p += Pointer;
+     n -= Pointer;
+     length = 0;
+     synced = true;
+     }
+  Put(p, n);
+}
+
+// --- cSectionDemux ---------------------------------------------------------
+
+cSectionDemux::cSectionDemux(void)
+{
+  memset(pidMask, 0, sizeof(pidMask));
+}
+
+cSectionDemux::~cSectionDemux()
+{
+  for (int i = 0; i < pids.Size(); i++)
+      delete pids[i];
+}
+
+int cSectionDemux::Open(int Pid, uchar Tid, uchar Mask)
+{
+  cMutexLock MutexLock(&mutex);
+  Pid &= MAXPID - 1;
+  cSectionDemuxPid *dp = NULL;
+  for (int i = 0; i < pids.Size(); i++) {
+      if (pids[i]->pid == Pid) {
+         dp = pids[i];
+         break;
+         }
+      }
+  if (!dp) {
+     dp = new cSectionDemuxPid(Pid);
+     pids.Append(dp);
+     pidMask[Pid / 8] |= 1 << (Pid % 8);
+     }
+  int Handle = dp->Open(Tid, Mask);
+  if (Handle < 0 && !dp->NumFilters()) {
+     pids.RemoveElement(dp);
+     pidMask[Pid / 8] &= ~(1 << (Pid % 8));
+     delete dp;
+     }
+  return Handle;
+}
+
+int cSectionDemux::Close(int Handle)
+{
+  cMutexLock MutexLock(&mutex);
+  for (int i = 0; i < pids.Size(); i++) {
+      cSectionDemuxPid *dp = pids[i];
+      if (dp->Close(Handle)) {
+         int Pid = dp->pid;
+         if (!dp->NumFilters()) {
+            pids.Remove(i);
+            pidMask[Pid / 8] &= ~(1 << (Pid % 8));
+            delete dp;
+            }
+         return Pid;
+         }
+      }
+  return -1;
+}
+
+bool cSectionDemux::Active(void)
+{
+  cMutexLock MutexLock(&mutex);
+  return pids.Size() > 0;
+}
+
+void cSectionDemux::Process(const uchar *Data, int Length)
+{
+  cMutexLock MutexLock(&mutex);
+  if (!pids.Size())
+     return;
+  for (const uchar *p = Data; p < Data + Length; p += TS_SIZE) {
+      int Pid = TsPid(p);
+      if (pidMask[Pid / 8] & (1 << (Pid % 8))) {
+         for (int i = 0; i < pids.Size(); i++) {
+             if (pids[i]->pid == Pid) {
+                pids[i]->Process(p);
+                break;
+                }
+             }
+         }
+      }
+}
@@ -12,6 +12,7 @@
 
 #include <time.h>
 #include "filter.h"
+#include "remux.h"
 #include "thread.h"
 #include "tools.h"
 
@@ -31,9 +32,23 @@ private:
   bool startFilters;
   cTimeMs flushTimer;
   cList<cFilter> filters;
+  cVector<cFilter *> sharedFilters; // the filters in 'filters' that need to run only on one device per transponder
+  bool sharedOn; // the shared filters are currently turned on
+  int sharedSource; // the transponder this section handler is on (only valid while 'on', otherwise 0)...
+  int sharedTransponder;
+  bool sharedOwner; // ...and whether its shared filters shall be turned on (protected by the global mutex)
   cList<cFilterHandle> filterHandles;
+  uint64_t sections;
   void Add(const cFilterData *FilterData);
   void Del(const cFilterData *FilterData);
+  void SetSharedStatus(bool On);
+  void SetSharedTransponder(int Source, int Transponder);
+  static void DistributeSharedFilters(void);
+       ///< Makes sure that on every transponder that is currently received, exactly
+       ///< one section handler has its shared filters turned on. A handler that
+       ///< already has them turned on keeps them, so that they don't move between
+       ///< devices needlessly. The handlers are only notified and apply the change
+       ///< in their own thread.
   virtual void Action(void) override;
 public:
   cSectionHandler(cDevice *Device);
@@ -41,10 +56,44 @@ public:
   int Source(void);
   int Transponder(void);
   const cChannel *Channel(void);
-  void Attach(cFilter *Filter);
+  void Attach(cFilter *Filter, bool Shared = false);
+       ///< Attaches the given Filter to this section handler. If Shared is true, the
+       ///< filter collects data that is the same for all devices tuned to the same
+       ///< transponder (like the EIT), and is only turned on in one of the section
+       ///< handlers that are currently on that transponder.
   void Detach(cFilter *Filter);
   void SetChannel(const cChannel *Channel);
   void SetStatus(bool On);
+  int NumFilters(void) { return filterHandles.Count(); }
+       ///< Returns the number of section filters currently open on the device.
+  uint64_t Sections(void) const { return sections; }
+       ///< Returns the number of complete sections received so far.
+  };
+
+class cSectionDemuxPid;
+
+class cSectionDemux {
+private:
+  cMutex mutex;
+  cVector<cSectionDemuxPid *> pids;
+  uchar pidMask[MAXPID / 8]; // a bit is set for each PID in pids
+public:
+  cSectionDemux(void);
+  ~cSectionDemux();
+  int Open(int Pid, uchar Tid, uchar Mask);
+       ///< Opens a section filter for the given Pid, Tid and Mask, which will be fed
+       ///< with the sections assembled from the TS packets given to Process().
+       ///< Returns a file handle, which can be polled for and read from the same way
+       ///< as a kernel section filter (each read returns one complete section), or
+       ///< -1 in case of error.
+  int Close(int Handle);
+       ///< Closes the given Handle, if it has been returned by Open().
+       ///< Returns the PID of the section filter, or -1 if Handle doesn't belong to
+       ///< this section demultiplexer.
+  bool Active(void);
+       ///< Returns true if there are any open section filters.
+  void Process(const uchar *Data, int Length);
+       ///< Processes the given TS packets (Length must be a multiple of TS_SIZE).
   };
 
 #endif //__SECTIONS_H
@@ -175,12 +175,13 @@ cSkinDisplayReplay::cProgressBar::cProgressBar(int Width, int Height, int Curren
         }
      if (Errors) {
         int LastPos = -1;
-        for (int i = 0; i < Errors->Size(); i++) {
-            int p1 = Errors->At(i);
-            if (p1 != LastPos) {
-               Error(Pos(Errors->At(i)), ColorError);
-               LastPos = p1;
-               }
+        for (int i = 0; i < Errors->Runs(); i++) {
+            // A run of consecutive errors gets a marker at every position it covers:
+            int p1 = max(Pos(Errors->RunFirst(i)), LastPos + 1);
+            int p2 = Pos(Errors->RunLast(i));
+            for (int x = p1; x <= p2; x++)
+                Error(x, ColorError);
+            LastPos = max(LastPos, p2);
             }
         }
      }
@@ -357,6 +358,7 @@ int cSkins::QueueMessage(eMessageType Type, const char *s, int Seconds, int Time
      SkinQueuedMessages.Add(m);
      m->mutex.Lock();
      queueMessageMutex.Unlock();
+     cRemote::Wakeup();
      if (m->condVar.TimedWait(m->mutex, Timeout * 1000))
         k = m->key;
      else
@@ -379,6 +381,8 @@ int cSkins::QueueMessage(eMessageType Type, const char *s, int Seconds, int Time
      // Add the new message:
      SkinQueuedMessages.Add(new cSkinQueuedMessage(Type, s, Seconds, Timeout));
      queueMessageMutex.Unlock();
+     if (!cThread::IsMainThread())
+        cRemote::Wakeup();
      }
   return k;
 }
@@ -0,0 +1,44 @@
+/*
+ * startup.c: Startup phase timing
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#include "startup.h"
+
+// --- cStartupTimes ---------------------------------------------------------
+
+uint64_t cStartupTimes::start = cTimeMs::Now();
+cMutex cStartupTimes::mutex;
+cStringList cStartupTimes::phases;
+
+uint64_t cStartupTimes::Now(void)
+{
+  return cTimeMs::Now() - start;
+}
+
+void cStartupTimes::Add(const char *Phase, uint64_t Begin)
+{
+  uint64_t End = Now();
+  dsyslog("startup: %s took %d ms (%d..%d ms)", Phase, int(End - Begin), int(Begin), int(End));
+  cMutexLock MutexLock(&mutex);
+  phases.Append(strdup(cString::sprintf("%7d %7d %7d %s", int(Begin), int(End), int(End - Begin), Phase)));
+}
+
+void cStartupTimes::Mark(const char *Event)
+{
+  uint64_t Time = Now();
+  dsyslog("startup: %s after %d ms", Event, int(Time));
+  cMutexLock MutexLock(&mutex);
+  phases.Append(strdup(cString::sprintf("%7d %7d %7d %s", int(Time), int(Time), 0, Event)));
+}
+
+void cStartupTimes::Report(cStringList &Lines)
+{
+  cMutexLock MutexLock(&mutex);
+  for (int i = 0; i < phases.Size(); i++)
+      Lines.Append(strdup(phases[i]));
+}
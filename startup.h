@@ -0,0 +1,54 @@
+/*
+ * startup.h: Startup phase timing
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#ifndef __STARTUP_H
+#define __STARTUP_H
+
+#include <stdint.h>
+#include "thread.h"
+#include "tools.h"
+
+// cStartupTimes records how long the individual phases of VDR's startup take
+// (loading, initializing and starting plugins, probing devices, reading the
+// configuration, recordings and EPG data etc.). All times are given in
+// milliseconds since the program has been started. Each phase is logged as
+// soon as it ends, and the whole list can be retrieved via the SVDRP command
+// STAT STARTUP, so that changes in startup time (e.g. after a plugin upgrade)
+// can be traced to the phase that causes them.
+
+class cStartupTimes {
+private:
+  static uint64_t start;
+  static cMutex mutex;
+  static cStringList phases;
+public:
+  static uint64_t Now(void);
+       ///< Returns the number of milliseconds since the program has been started.
+  static void Add(const char *Phase, uint64_t Begin);
+       ///< Records that the given Phase, which has begun at Begin (as returned
+       ///< by Now()), has ended now.
+  static void Mark(const char *Event);
+       ///< Records that the given Event has happened now.
+  static void Report(cStringList &Lines);
+       ///< Appends one line per recorded phase to Lines, in the order in which
+       ///< the phases have ended.
+  };
+
+class cStartupPhase {
+private:
+  cString phase;
+  uint64_t begin;
+public:
+  cStartupPhase(const char *Phase) : phase(Phase) { begin = cStartupTimes::Now(); }
+       ///< Records the given startup Phase, which lasts until this object is
+       ///< destroyed.
+  ~cStartupPhase() { cStartupTimes::Add(phase, begin); }
+  };
+
+#endif //__STARTUP_H
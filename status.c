@@ -9,6 +9,314 @@
 
 #include "status.h"
 #include "thread.h"
+#include "timers.h"
+
+#define MAXSTATUSMESSAGES 256 // max. number of messages queued for an asynchronous status monitor
+
+// --- cStatusMessage --------------------------------------------------------
+
+enum eStatusMessage {
+  smChannelChange,
+  smTimerChange,
+  smChannelSwitch,
+  smRecording,
+  smReplaying,
+  smMarksModified,
+  smSetVolume,
+  smSetAudioTrack,
+  smSetAudioChannel,
+  smSetSubtitleTrack,
+  smOsdClear,
+  smOsdTitle,
+  smOsdStatusMessage,
+  smOsdHelpKeys,
+  smOsdItem,
+  smOsdCurrentItem,
+  smOsdTextItem,
+  smOsdChannel,
+  smOsdProgramme,
+  };
+
+class cStatusMessage : public cListObject {
+private:
+  eStatusMessage type;
+  const cDevice *device;
+  const cControl *control;
+  cChannel *channel;
+  cTimer *timer;
+  cMarks *marks;
+  int i;
+  bool b;
+  time_t t[2];
+  cString s[6];
+  cStringList tracks;
+  bool IsOsd(void) const { return type >= smOsdClear; }
+public:
+  cStatusMessage(eStatusMessage Type);
+  virtual ~cStatusMessage() override;
+  static cStatusMessage *ChannelChange(const cChannel *Channel);
+  static cStatusMessage *TimerChange(const cTimer *Timer, eTimerChange Change);
+  static cStatusMessage *ChannelSwitch(const cDevice *Device, int ChannelNumber, bool LiveView);
+  static cStatusMessage *Recording(const cDevice *Device, const char *Name, const char *FileName, bool On);
+  static cStatusMessage *Replaying(const cControl *Control, const char *Name, const char *FileName, bool On);
+  static cStatusMessage *MarksModified(const cMarks *Marks);
+  static cStatusMessage *Value(eStatusMessage Type, int Value, bool Flag = false, const char *Text = NULL);
+  static cStatusMessage *Tracks(eStatusMessage Type, int Index, const char * const *Tracks);
+  static cStatusMessage *Text(eStatusMessage Type, const char *Text1 = NULL, const char *Text2 = NULL, const char *Text3 = NULL, const char *Text4 = NULL);
+  static cStatusMessage *Programme(time_t PresentTime, const char *PresentTitle, const char *PresentSubtitle, time_t FollowingTime, const char *FollowingTitle, const char *FollowingSubtitle);
+  bool Supersedes(const cStatusMessage *Message) const;
+       ///< Returns true if this message makes the given (earlier) Message redundant.
+  void Deliver(cStatus *Monitor);
+  };
+
+cStatusMessage::cStatusMessage(eStatusMessage Type)
+{
+  type = Type;
+  device = NULL;
+  control = NULL;
+  channel = NULL;
+  timer = NULL;
+  marks = NULL;
+  i = 0;
+  b = false;
+  t[0] = t[1] = 0;
+}
+
+cStatusMessage::~cStatusMessage()
+{
+  delete channel;
+  delete timer;
+  delete marks;
+}
+
+cStatusMessage *cStatusMessage::ChannelChange(const cChannel *Channel)
+{
+  cStatusMessage *m = new cStatusMessage(smChannelChange);
+  if (Channel)
+     m->channel = new cChannel(*Channel);
+  return m;
+}
+
+cStatusMessage *cStatusMessage::TimerChange(const cTimer *Timer, eTimerChange Change)
+{
+  cStatusMessage *m = new cStatusMessage(smTimerChange);
+  if (Timer) {
+     // A copy made with the copy constructor would refer to the timer's event, so we create it from its text:
+     m->timer = new cTimer;
+     if (!m->timer->Parse(Timer->ToText(true))) {
+        delete m->timer;
+        m->timer = NULL;
+        }
+     }
+  m->i = Change;
+  return m;
+}
+
+cStatusMessage *cStatusMessage::ChannelSwitch(const cDevice *Device, int ChannelNumber, bool LiveView)
+{
+  cStatusMessage *m = new cStatusMessage(smChannelSwitch);
+  m->device = Device;
+  m->i = ChannelNumber;
+  m->b = LiveView;
+  return m;
+}
+
+cStatusMessage *cStatusMessage::Recording(const cDevice *Device, const char *Name, const char *FileName, bool On)
+{
+  cStatusMessage *m = new cStatusMessage(smRecording);
+  m->device = Device;
+  m->s[0] = Name;
+  m->s[1] = FileName;
+  m->b = On;
+  return m;
+}
+
+cStatusMessage *cStatusMessage::Replaying(const cControl *Control, const char *Name, const char *FileName, bool On)
+{
+  cStatusMessage *m = new cStatusMessage(smReplaying);
+  m->control = Control;
+  m->s[0] = Name;
+  m->s[1] = FileName;
+  m->b = On;
+  return m;
+}
+
+cStatusMessage *cStatusMessage::MarksModified(const cMarks *Marks)
+{
+  cStatusMessage *m = new cStatusMessage(smMarksModified);
+  if (Marks) {
+     m->marks = new cMarks;
+     for (const cMark *Mark = Marks->First(); Mark; Mark = Marks->Next(Mark))
+         m->marks->cConfig<cMark>::Add(new cMark(Mark->Position(), Mark->Comment()));
+     }
+  return m;
+}
+
+cStatusMessage *cStatusMessage::Value(eStatusMessage Type, int Value, bool Flag, const char *Text)
+{
+  cStatusMessage *m = new cStatusMessage(Type);
+  m->i = Value;
+  m->b = Flag;
+  m->s[0] = Text;
+  return m;
+}
+
+cStatusMessage *cStatusMessage::Tracks(eStatusMessage Type, int Index, const char * const *Tracks)
+{
+  cStatusMessage *m = new cStatusMessage(Type);
+  m->i = Index;
+  if (Tracks) {
+     for (const char * const *t = Tracks; *t; t++)
+         m->tracks.Append(strdup(*t));
+     m->tracks.Append(NULL); // the list handed to the monitor is NULL terminated
+     }
+  return m;
+}
+
+cStatusMessage *cStatusMessage::Text(eStatusMessage Type, const char *Text1, const char *Text2, const char *Text3, const char *Text4)
+{
+  cStatusMessage *m = new cStatusMessage(Type);
+  m->s[0] = Text1;
+  m->s[1] = Text2;
+  m->s[2] = Text3;
+  m->s[3] = Text4;
+  return m;
+}
+
+cStatusMessage *cStatusMessage::Programme(time_t PresentTime, const char *PresentTitle, const char *PresentSubtitle, time_t FollowingTime, const char *FollowingTitle, const char *FollowingSubtitle)
+{
+  cStatusMessage *m = Text(smOsdProgramme, PresentTitle, PresentSubtitle, FollowingTitle, FollowingSubtitle);
+  m->t[0] = PresentTime;
+  m->t[1] = FollowingTime;
+  return m;
+}
+
+bool cStatusMessage::Supersedes(const cStatusMessage *Message) const
+{
+  if (type == smOsdClear)
+     return Message->IsOsd(); // clearing the OSD makes anything displayed before obsolete
+  if (type != Message->type)
+     return false;
+  switch (type) {
+    case smMarksModified:
+    case smSetAudioTrack:
+    case smSetAudioChannel:
+    case smSetSubtitleTrack:
+    case smOsdTitle:
+    case smOsdStatusMessage:
+    case smOsdHelpKeys:
+    case smOsdCurrentItem:
+    case smOsdChannel:
+    case smOsdProgramme:   return true;
+    case smSetVolume:      return b; // only an absolute volume replaces earlier changes
+    case smOsdItem:        return i == Message->i; // the item at the same index
+    case smOsdTextItem:    return *s[0]; // a new text replaces the old one, including scrolling
+    default: ;
+    }
+  return false;
+}
+
+void cStatusMessage::Deliver(cStatus *Monitor)
+{
+  const char * const *Tracks = tracks.Size() ? &tracks.At(0) : NULL;
+  switch (type) {
+    case smChannelChange:    if (channel)
+                                Monitor->ChannelChange(channel);
+                             break;
+    case smTimerChange:      if (timer)
+                                Monitor->TimerChange(timer, eTimerChange(i));
+                             break;
+    case smChannelSwitch:    Monitor->ChannelSwitch(device, i, b); break;
+    case smRecording:        Monitor->Recording(device, s[0], s[1], b); break;
+    case smReplaying:        Monitor->Replaying(control, s[0], s[1], b); break;
+    case smMarksModified:    Monitor->MarksModified(marks); break;
+    case smSetVolume:        Monitor->SetVolume(i, b); break;
+    case smSetAudioTrack:    Monitor->SetAudioTrack(i, Tracks); break;
+    case smSetAudioChannel:  Monitor->SetAudioChannel(i); break;
+    case smSetSubtitleTrack: Monitor->SetSubtitleTrack(i, Tracks); break;
+    case smOsdClear:         Monitor->OsdClear(); break;
+    case smOsdTitle:         Monitor->OsdTitle(s[0]); break;
+    case smOsdStatusMessage: Monitor->OsdStatusMessage(eMessageType(i), s[0]); break;
+    case smOsdHelpKeys:      Monitor->OsdHelpKeys(s[0], s[1], s[2], s[3]); break;
+    case smOsdItem:          Monitor->OsdItem(s[0], i, b); break;
+    case smOsdCurrentItem:   Monitor->OsdCurrentItem(s[0], i); break;
+    case smOsdTextItem:      Monitor->OsdTextItem(s[0], b); break;
+    case smOsdChannel:       Monitor->OsdChannel(s[0]); break;
+    case smOsdProgramme:     Monitor->OsdProgramme(t[0], s[0], s[1], t[1], s[2], s[3]); break;
+    default: ;
+    }
+}
+
+// --- cStatusQueue ----------------------------------------------------------
+
+class cStatusQueue : public cThread {
+private:
+  cStatus *monitor;
+  cMutex mutex;
+  cCondVar available;
+  cList<cStatusMessage> messages;
+  int dropped;
+protected:
+  virtual void Action(void) override;
+public:
+  cStatusQueue(cStatus *Monitor);
+  virtual ~cStatusQueue() override;
+  void Put(cStatusMessage *Message);
+  };
+
+cStatusQueue::cStatusQueue(cStatus *Monitor)
+:cThread("status monitor")
+{
+  monitor = Monitor;
+  dropped = 0;
+  Start();
+}
+
+cStatusQueue::~cStatusQueue()
+{
+  Cancel(-1);
+  available.Broadcast();
+  Cancel(3);
+}
+
+void cStatusQueue::Put(cStatusMessage *Message)
+{
+  cMutexLock MutexLock(&mutex);
+  for (cStatusMessage *m = messages.First(); m; ) {
+      cStatusMessage *Next = messages.Next(m);
+      if (Message->Supersedes(m))
+         messages.Del(m);
+      m = Next;
+      }
+  if (messages.Count() >= MAXSTATUSMESSAGES) {
+     if (!dropped++)
+        esyslog("ERROR: status monitor can't keep up - dropping messages");
+     messages.Del(messages.First());
+     }
+  messages.Add(Message);
+  available.Broadcast();
+}
+
+void cStatusQueue::Action(void)
+{
+  while (Running()) {
+        cStatusMessage *Message = NULL;
+        mutex.Lock();
+        if (!messages.First())
+           available.TimedWait(mutex, 1000);
+        if ((Message = messages.First()) != NULL)
+           messages.Del(Message, false);
+        else if (dropped) {
+           isyslog("status monitor has caught up after dropping %d messages", dropped);
+           dropped = 0;
+           }
+        mutex.Unlock();
+        if (Message) {
+           Message->Deliver(monitor);
+           delete Message;
+           }
+        }
+}
 
 // --- cStatus ---------------------------------------------------------------
 
@@ -16,8 +324,9 @@ cList<cStatus> cStatus::statusMonitors;
 
 static cMutex Mutex;
 
-cStatus::cStatus(void)
+cStatus::cStatus(bool Async)
 {
+  queue = Async ? new cStatusQueue(this) : NULL;
   Mutex.Lock();
   statusMonitors.Add(this);
   Mutex.Unlock();
@@ -28,118 +337,202 @@ cStatus::~cStatus()
   Mutex.Lock();
   statusMonitors.Del(this, false);
   Mutex.Unlock();
+  StopAsync();
+}
+
+void cStatus::StopAsync(void)
+{
+  cStatusQueue *q = queue;
+  queue = NULL; // from now on all messages are delivered directly
+  delete q;
 }
 
 void cStatus::MsgChannelChange(const cChannel *Channel)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->ChannelChange(Channel);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::ChannelChange(Channel));
+      else
+         sm->ChannelChange(Channel);
+      }
 }
 
 void cStatus::MsgTimerChange(const cTimer *Timer, eTimerChange Change)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->TimerChange(Timer, Change);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::TimerChange(Timer, Change));
+      else
+         sm->TimerChange(Timer, Change);
+      }
 }
 
 void cStatus::MsgChannelSwitch(const cDevice *Device, int ChannelNumber, bool LiveView)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->ChannelSwitch(Device, ChannelNumber, LiveView);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::ChannelSwitch(Device, ChannelNumber, LiveView));
+      else
+         sm->ChannelSwitch(Device, ChannelNumber, LiveView);
+      }
 }
 
 void cStatus::MsgRecording(const cDevice *Device, const char *Name, const char *FileName, bool On)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->Recording(Device, Name, FileName, On);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Recording(Device, Name, FileName, On));
+      else
+         sm->Recording(Device, Name, FileName, On);
+      }
 }
 
 void cStatus::MsgReplaying(const cControl *Control, const char *Name, const char *FileName, bool On)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->Replaying(Control, Name, FileName, On);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Replaying(Control, Name, FileName, On));
+      else
+         sm->Replaying(Control, Name, FileName, On);
+      }
 }
 
 void cStatus::MsgMarksModified(const cMarks* Marks)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->MarksModified(Marks);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::MarksModified(Marks));
+      else
+         sm->MarksModified(Marks);
+      }
 }
 
 void cStatus::MsgSetVolume(int Volume, bool Absolute)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->SetVolume(Volume, Absolute);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Value(smSetVolume, Volume, Absolute));
+      else
+         sm->SetVolume(Volume, Absolute);
+      }
 }
 
 void cStatus::MsgSetAudioTrack(int Index, const char * const *Tracks)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->SetAudioTrack(Index, Tracks);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Tracks(smSetAudioTrack, Index, Tracks));
+      else
+         sm->SetAudioTrack(Index, Tracks);
+      }
 }
 
 void cStatus::MsgSetAudioChannel(int AudioChannel)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->SetAudioChannel(AudioChannel);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Value(smSetAudioChannel, AudioChannel));
+      else
+         sm->SetAudioChannel(AudioChannel);
+      }
 }
 
 void cStatus::MsgSetSubtitleTrack(int Index, const char * const *Tracks)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->SetSubtitleTrack(Index, Tracks);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Tracks(smSetSubtitleTrack, Index, Tracks));
+      else
+         sm->SetSubtitleTrack(Index, Tracks);
+      }
 }
 
 void cStatus::MsgOsdClear(void)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->OsdClear();
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Text(smOsdClear));
+      else
+         sm->OsdClear();
+      }
 }
 
 void cStatus::MsgOsdTitle(const char *Title)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->OsdTitle(Title);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Text(smOsdTitle, Title));
+      else
+         sm->OsdTitle(Title);
+      }
 }
 
 void cStatus::MsgOsdStatusMessage(eMessageType Type, const char *Message)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->OsdStatusMessage(Type, Message);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Value(smOsdStatusMessage, Type, false, Message));
+      else
+         sm->OsdStatusMessage(Type, Message);
+      }
 }
 
 void cStatus::MsgOsdHelpKeys(const char *Red, const char *Green, const char *Yellow, const char *Blue)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->OsdHelpKeys(Red, Green, Yellow, Blue);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Text(smOsdHelpKeys, Red, Green, Yellow, Blue));
+      else
+         sm->OsdHelpKeys(Red, Green, Yellow, Blue);
+      }
 }
 
 void cStatus::MsgOsdItem(const char *Text, int Index, bool Selectable)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->OsdItem(Text, Index, Selectable);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Value(smOsdItem, Index, Selectable, Text));
+      else
+         sm->OsdItem(Text, Index, Selectable);
+      }
 }
 
 void cStatus::MsgOsdCurrentItem(const char *Text, int Index)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->OsdCurrentItem(Text, Index);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Value(smOsdCurrentItem, Index, false, Text));
+      else
+         sm->OsdCurrentItem(Text, Index);
+      }
 }
 
 void cStatus::MsgOsdTextItem(const char *Text, bool Scroll)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->OsdTextItem(Text, Scroll);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Value(smOsdTextItem, 0, Scroll, Text));
+      else
+         sm->OsdTextItem(Text, Scroll);
+      }
 }
 
 void cStatus::MsgOsdChannel(const char *Text)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->OsdChannel(Text);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Text(smOsdChannel, Text));
+      else
+         sm->OsdChannel(Text);
+      }
 }
 
 void cStatus::MsgOsdProgramme(time_t PresentTime, const char *PresentTitle, const char *PresentSubtitle, time_t FollowingTime, const char *FollowingTitle, const char *FollowingSubtitle)
 {
-  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
-      sm->OsdProgramme(PresentTime, PresentTitle, PresentSubtitle, FollowingTime, FollowingTitle, FollowingSubtitle);
+  for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm)) {
+      if (sm->queue)
+         sm->queue->Put(cStatusMessage::Programme(PresentTime, PresentTitle, PresentSubtitle, FollowingTime, FollowingTitle, FollowingSubtitle));
+      else
+         sm->OsdProgramme(PresentTime, PresentTitle, PresentSubtitle, FollowingTime, FollowingTitle, FollowingSubtitle);
+      }
 }
@@ -32,10 +32,13 @@
 enum eTimerChange { tcMod, tcAdd, tcDel }; // tcMod is obsolete and no longer used!
 
 class cTimer;
+class cStatusQueue;
 
 class cStatus : public cListObject {
+  friend class cStatusMessage;
 private:
   static cList<cStatus> statusMonitors;
+  cStatusQueue *queue;
 protected:
   // These functions can be implemented by derived classes to receive status information:
   virtual void ChannelChange(const cChannel *Channel) {}
@@ -105,9 +108,28 @@ protected:
                // The OSD displays the single line Text with the current channel information.
   virtual void OsdProgramme(time_t PresentTime, const char *PresentTitle, const char *PresentSubtitle, time_t FollowingTime, const char *FollowingTitle, const char *FollowingSubtitle) {}
                // The OSD displays the given programme information.
+  void StopAsync(void);
+               // A status monitor that has been created with Async = true must call this
+               // function at the beginning of its destructor, to make sure none of its
+               // member functions is called by the delivery thread while it is being
+               // destroyed. Any messages that have not yet been delivered are discarded.
 public:
-  cStatus(void);
+  cStatus(bool Async = false);
+               // Creates a status monitor. If Async is true, the member functions of this
+               // monitor are not called directly by the code that reports a status change,
+               // but rather by a separate thread. The messages are queued with copies of
+               // their parameters, so a cChannel, cTimer or cMarks given to the monitor
+               // is a private copy that doesn't require any locks. Device is a pointer to
+               // an actual device, while Control is only given to identify the player
+               // control and must not be dereferenced, since the control may no longer
+               // exist when the message is delivered. Messages that are superseded by later
+               // ones (like the current menu item or the help keys) are dropped if they
+               // haven't been delivered yet, and if the monitor can't keep up, the oldest
+               // messages are dropped.
   virtual ~cStatus() override;
+  static bool HasMonitors(void) { return statusMonitors.Count() > 0; }
+               // Returns true if there are any status monitors, so that callers can
+               // avoid collecting information nobody will receive.
   // These functions are called whenever the related status information changes:
   static void MsgChannelChange(const cChannel *Channel);
   static void MsgTimerChange(const cTimer *Timer, eTimerChange Change);
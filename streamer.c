@@ -0,0 +1,1160 @@
+/*
+ * streamer.c: HTTP streaming of live channels and recordings
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#include "streamer.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "channels.h"
+#include "config.h"
+#include "device.h"
+#include "receiver.h"
+#include "recording.h"
+#include "remux.h"
+#include "ringbuffer.h"
+#include "thread.h"
+
+#define STREAMBUFSIZE      (TS_SIZE * 348) // the size of the buffers shared by all clients of a channel (~64KB)
+#define STREAMMAXDELAY     100 // ms after which a buffer is delivered, even if it isn't full
+#define STREAMMAXQUEUE      64 // max. number of buffers queued for a client that can't keep up (~4MB)
+#define STREAMSENDFILESIZE  MEGABYTE(1) // bytes sent in one go by sendfile()
+#define STREAMSENDFILECALLS  4 // max. number of sendfile() calls per client in one turn
+#define STREAMMAXREQUEST  1024 // max. length of an HTTP request header
+#define STREAMREQUESTTIMEOUT 10000 // ms a client has to send its request
+#define STREAMPRIORITY       0 // the priority of the receivers used for streaming
+#define STREAMPOLLTIMEOUT  100 // ms
+#define MAXSTREAMCONNECTIONS 128 // max. number of clients (including the ones that haven't sent their request yet)
+
+static cWakeup StreamServerWakeup; // wakes up the server when a receiver has delivered data
+
+static bool AttachToDevice(cReceiver *Receiver, const cChannel *Channel)
+{
+  if (cDevice *Device = cDevice::GetDevice(Channel, STREAMPRIORITY, false)) {
+     dsyslog("streaming: switching device %d to channel %d %s (%s)", Device->DeviceNumber() + 1, Channel->Number(), *Channel->GetChannelID().ToString(), Channel->Name());
+     if (Device->SwitchChannel(Channel, false))
+        return Device->AttachReceiver(Receiver);
+     }
+  return false;
+}
+
+// --- cStreamBuffer ---------------------------------------------------------
+
+class cStreamBuffer {
+private:
+  std::atomic_int refs;
+  uchar *data;
+  int size;
+  int length;
+  ~cStreamBuffer();
+public:
+  cStreamBuffer(int Size);
+       ///< Creates a new buffer with a reference count of 1.
+  const uchar *Data(void) const { return data; }
+  int Length(void) const { return length; }
+  bool Full(void) const { return length >= size; }
+  int Append(const uchar *Data, int Length);
+       ///< Appends as much of the given Data as fits into this buffer and
+       ///< returns the number of bytes actually appended.
+  void Ref(void) { refs++; }
+  void Unref(void) { if (--refs == 0) delete this; }
+       ///< Once a buffer has been handed to the clients, its data is never
+       ///< changed again, so it can be sent by several threads (or the kernel)
+       ///< at the same time. It is deleted when the last reference is dropped.
+  };
+
+cStreamBuffer::cStreamBuffer(int Size)
+{
+  refs = 1;
+  data = MALLOC(uchar, Size);
+  size = data ? Size : 0;
+  length = 0;
+}
+
+cStreamBuffer::~cStreamBuffer()
+{
+  free(data);
+}
+
+int cStreamBuffer::Append(const uchar *Data, int Length)
+{
+  int n = min(Length, size - length);
+  if (n > 0) {
+     memcpy(data + length, Data, n);
+     length += n;
+     }
+  return n;
+}
+
+// --- cStreamClient ---------------------------------------------------------
+
+class cStreamClient {
+protected:
+  int sock;
+  cString address;
+public:
+  cStreamClient(int Socket, const char *Address);
+  virtual ~cStreamClient();
+  int Socket(void) const { return sock; }
+  const char *Address(void) const { return address; }
+  bool Connected(void);
+       ///< Returns false if the client has closed the connection.
+  virtual bool Ready(void) = 0;
+       ///< Returns true if there is data waiting to be sent to the client.
+  virtual bool Process(void) = 0;
+       ///< Sends as much data to the client as the socket takes.
+       ///< Returns false if this client is done and shall be deleted.
+  };
+
+cStreamClient::cStreamClient(int Socket, const char *Address)
+{
+  sock = Socket;
+  address = Address;
+  isyslog("stream client %s connected", *address);
+}
+
+cStreamClient::~cStreamClient()
+{
+  close(sock);
+  isyslog("stream client %s disconnected", *address);
+}
+
+bool cStreamClient::Connected(void)
+{
+  char buf[256];
+  for (;;) {
+      ssize_t n = recv(sock, buf, sizeof(buf), MSG_DONTWAIT); // we don't expect anything after the request, so anything that comes in is ignored
+      if (n > 0)
+         continue;
+      if (n == 0)
+         return false;
+      return !FATALERRNO;
+      }
+}
+
+// --- cStreamLiveClient -----------------------------------------------------
+
+class cStreamReceiver;
+
+class cStreamLiveClient : public cStreamClient {
+private:
+  cStreamReceiver *receiver;
+  cMutex mutex;
+  cVector<cStreamBuffer *> queue;
+  int offset; // the number of bytes of queue[0] that have already been sent
+  int dropped;
+  bool zeroCopy;
+  cVector<cStreamBuffer *> inFlight; // buffers handed to the kernel with MSG_ZEROCOPY
+  uint32_t inFlightFirst; // the MSG_ZEROCOPY sequence number of inFlight[0]
+  void ReleaseCompleted(void);
+public:
+  cStreamLiveClient(int Socket, const char *Address, cStreamReceiver *Receiver);
+  virtual ~cStreamLiveClient() override;
+  cStreamReceiver *Receiver(void) { return receiver; }
+  void Queue(cStreamBuffer *Buffer);
+       ///< Queues the given Buffer for sending to this client. This is called
+       ///< from the thread of the device the receiver is attached to.
+  virtual bool Ready(void) override;
+  virtual bool Process(void) override;
+  };
+
+cStreamLiveClient::cStreamLiveClient(int Socket, const char *Address, cStreamReceiver *Receiver)
+:cStreamClient(Socket, Address)
+{
+  receiver = Receiver;
+  offset = 0;
+  dropped = 0;
+  zeroCopy = false;
+#ifdef SO_ZEROCOPY
+  int One = 1;
+  zeroCopy = setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &One, sizeof(One)) == 0;
+#endif
+  inFlightFirst = 0;
+}
+
+cStreamLiveClient::~cStreamLiveClient()
+{
+  for (int i = 0; i < queue.Size(); i++)
+      queue[i]->Unref();
+  for (int i = 0; i < inFlight.Size(); i++)
+      inFlight[i]->Unref(); // the kernel keeps the pages it still needs pinned
+  if (dropped)
+     isyslog("stream client %s: dropped %d buffers", *address, dropped);
+}
+
+void cStreamLiveClient::Queue(cStreamBuffer *Buffer)
+{
+  cMutexLock MutexLock(&mutex);
+  if (queue.Size() >= STREAMMAXQUEUE) {
+     // The client doesn't keep up, so we drop the oldest buffer that hasn't been started yet
+     // (every buffer begins with a PAT/PMT, so the client can resync right away):
+     queue[1]->Unref();
+     queue.Remove(1);
+     dropped++;
+     }
+  Buffer->Ref();
+  queue.Append(Buffer);
+}
+
+bool cStreamLiveClient::Ready(void)
+{
+  cMutexLock MutexLock(&mutex);
+  return queue.Size() > 0;
+}
+
+void cStreamLiveClient::ReleaseCompleted(void)
+{
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+  while (inFlight.Size()) {
+        char Control[CMSG_SPACE(sizeof(sock_extended_err)) + CMSG_SPACE(sizeof(sockaddr_in6))];
+        msghdr Msg;
+        memset(&Msg, 0, sizeof(Msg));
+        Msg.msg_control = Control;
+        Msg.msg_controllen = sizeof(Control);
+        if (recvmsg(sock, &Msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+           break;
+        for (cmsghdr *Cmsg = CMSG_FIRSTHDR(&Msg); Cmsg; Cmsg = CMSG_NXTHDR(&Msg, Cmsg)) {
+            if (Cmsg->cmsg_level == SOL_IP && Cmsg->cmsg_type == IP_RECVERR) {
+               sock_extended_err *Err = (sock_extended_err *)CMSG_DATA(Cmsg);
+               if (Err->ee_errno == 0 && Err->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+                  if ((Err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0 && zeroCopy) {
+                     // The kernel had to copy the data anyway (as on the loopback device),
+                     // so the additional overhead of MSG_ZEROCOPY isn't worth it:
+                     dsyslog("stream client %s: zero copy not supported, using regular sends", *address);
+                     zeroCopy = false;
+                     }
+                  // The sends with sequence numbers up to ee_data have completed:
+                  while (inFlight.Size() && int32_t(Err->ee_data - inFlightFirst) >= 0) {
+                        inFlight[0]->Unref();
+                        inFlight.Remove(0);
+                        inFlightFirst++;
+                        }
+                  }
+               }
+            }
+        }
+#endif
+}
+
+bool cStreamLiveClient::Process(void)
+{
+  if (!Connected())
+     return false;
+  ReleaseCompleted();
+  for (;;) {
+      cStreamBuffer *Buffer;
+      {
+        cMutexLock MutexLock(&mutex);
+        if (queue.Size() == 0)
+           break;
+        Buffer = queue[0];
+      }
+      int Flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#ifdef MSG_ZEROCOPY
+      if (zeroCopy)
+         Flags |= MSG_ZEROCOPY;
+#endif
+      ssize_t n = send(sock, Buffer->Data() + offset, Buffer->Length() - offset, Flags);
+      if (n < 0) {
+         if (errno == EAGAIN || errno == EINTR)
+            break;
+#ifdef MSG_ZEROCOPY
+         if (errno == ENOBUFS && zeroCopy) {
+            // Too many pages pinned by this socket, so let's fall back to regular sends:
+            dsyslog("stream client %s: zero copy limit reached, using regular sends", *address);
+            zeroCopy = false;
+            continue;
+            }
+#endif
+         dsyslog("stream client %s: %m", *address);
+         return false;
+         }
+#ifdef MSG_ZEROCOPY
+      if (zeroCopy) {
+         // The kernel still references the buffer until the send has been completed:
+         Buffer->Ref();
+         inFlight.Append(Buffer);
+         }
+#endif
+      offset += n;
+      if (offset >= Buffer->Length()) {
+         cMutexLock MutexLock(&mutex);
+         queue.Remove(0);
+         Buffer->Unref();
+         offset = 0;
+         }
+      }
+  return true;
+}
+
+// --- cStreamReceiver -------------------------------------------------------
+
+class cStreamReceiver : public cReceiver {
+private:
+  cMutex mutex;
+  cVector<cStreamLiveClient *> clients;
+  cPatPmtGenerator patPmtGenerator;
+  cStreamBuffer *buffer;
+  cTimeMs bufferTimeout;
+  cString channelName;
+  void Deliver(void);
+protected:
+  virtual void Receive(const uchar *Data, int Length) override;
+public:
+  cStreamReceiver(const cChannel *Channel);
+  virtual ~cStreamReceiver() override;
+  const char *ChannelName(void) { return channelName; }
+  void Add(cStreamLiveClient *Client);
+  void Del(cStreamLiveClient *Client);
+  int NumClients(void);
+  };
+
+cStreamReceiver::cStreamReceiver(const cChannel *Channel)
+:cReceiver(Channel, STREAMPRIORITY)
+,patPmtGenerator(Channel)
+{
+  buffer = NULL;
+  channelName = Channel->Name();
+  SetMultiPacket(true);
+}
+
+cStreamReceiver::~cStreamReceiver()
+{
+  Detach();
+  if (buffer)
+     buffer->Unref();
+}
+
+void cStreamReceiver::Add(cStreamLiveClient *Client)
+{
+  cMutexLock MutexLock(&mutex);
+  clients.Append(Client);
+}
+
+void cStreamReceiver::Del(cStreamLiveClient *Client)
+{
+  cMutexLock MutexLock(&mutex);
+  clients.RemoveElement(Client);
+}
+
+int cStreamReceiver::NumClients(void)
+{
+  cMutexLock MutexLock(&mutex);
+  return clients.Size();
+}
+
+void cStreamReceiver::Deliver(void)
+{
+  cMutexLock MutexLock(&mutex);
+  for (int i = 0; i < clients.Size(); i++)
+      clients[i]->Queue(buffer);
+  buffer->Unref();
+  buffer = NULL;
+  StreamServerWakeup.Signal();
+}
+
+void cStreamReceiver::Receive(const uchar *Data, int Length)
+{
+  while (Length > 0) {
+        if (!buffer) {
+           // Each buffer starts with a PAT/PMT, so that clients can start decoding at any buffer:
+           buffer = new cStreamBuffer(STREAMBUFSIZE);
+           buffer->Append(patPmtGenerator.GetPat(), TS_SIZE);
+           int Index = 0;
+           while (uchar *pmt = patPmtGenerator.GetPmt(Index))
+                 buffer->Append(pmt, TS_SIZE);
+           bufferTimeout.Set(STREAMMAXDELAY);
+           }
+        int n = buffer->Append(Data, Length);
+        Data += n;
+        Length -= n;
+        if (n == 0 || buffer->Full() || bufferTimeout.TimedOut())
+           Deliver();
+        if (n == 0)
+           break; // out of memory
+        }
+}
+
+// --- cStreamRecordingClient ------------------------------------------------
+
+class cStreamRecordingClient : public cStreamClient {
+private:
+  cString recordingName;
+  cFileName fileName;
+  int fileNumber;
+  int fd;
+  off_t offset;
+  bool waiting;
+public:
+  cStreamRecordingClient(int Socket, const char *Address, const char *FileName);
+  virtual ~cStreamRecordingClient() override;
+  virtual bool Ready(void) override { return !waiting; }
+  virtual bool Process(void) override;
+  };
+
+cStreamRecordingClient::cStreamRecordingClient(int Socket, const char *Address, const char *FileName)
+:cStreamClient(Socket, Address)
+,fileName(FileName, false)
+{
+  recordingName = FileName;
+  fileNumber = 1;
+  fd = -1;
+  offset = 0;
+  waiting = false;
+}
+
+cStreamRecordingClient::~cStreamRecordingClient()
+{
+  if (fd >= 0)
+     close(fd);
+}
+
+bool cStreamRecordingClient::Process(void)
+{
+  if (!Connected())
+     return false;
+  waiting = false;
+  for (int i = 0; i < STREAMSENDFILECALLS; i++) {
+      if (fd < 0) {
+         cString Name = fileName.NameOf(fileNumber);
+         fd = open(Name, O_RDONLY);
+         if (fd < 0) {
+            if (errno != ENOENT || fileNumber == 1) {
+               LOG_ERROR_STR(*Name);
+               return false;
+               }
+            if (*GetRecordingTimerId(recordingName)) {
+               waiting = true; // the recording hasn't yet started its next file
+               return true;
+               }
+            return false; // that was the last file
+            }
+         offset = 0;
+         }
+      ssize_t n = sendfile(sock, fd, &offset, STREAMSENDFILESIZE);
+      if (n < 0) {
+         if (errno == EAGAIN || errno == EINTR)
+            return true;
+         dsyslog("stream client %s: %m", *address);
+         return false;
+         }
+      if (n == 0) {
+         // End of file, so let's see whether there is a next one:
+         struct stat st;
+         if (fileName.Exists(fileNumber + 1)) {
+            if (fstat(fd, &st) == 0 && st.st_size > offset)
+               continue; // the file has grown before the recorder switched to the next one
+            close(fd);
+            fd = -1;
+            fileNumber++;
+            }
+         else if (*GetRecordingTimerId(recordingName)) {
+            waiting = true; // the recording is still going on
+            return true;
+            }
+         else
+            return false; // that was the end of the recording
+         }
+      }
+  return true;
+}
+
+// --- cStreamRequest --------------------------------------------------------
+
+class cStreamRequest {
+private:
+  int sock;
+  cString address;
+  char buf[STREAMMAXREQUEST];
+  int length;
+  cTimeMs timeout;
+public:
+  cStreamRequest(int Socket, const char *Address);
+  ~cStreamRequest();
+  int Socket(void) const { return sock; }
+  const char *Address(void) const { return address; }
+  const char *Read(bool &Error);
+       ///< Reads the request from the client and returns the requested path once
+       ///< the complete header has been received. Error is set to true if the
+       ///< request is invalid or the client didn't send it in time.
+  int Detach(void);
+       ///< Hands the socket over to the caller.
+  void Respond(int Code, const char *Text);
+  };
+
+cStreamRequest::cStreamRequest(int Socket, const char *Address)
+{
+  sock = Socket;
+  address = Address;
+  length = 0;
+  timeout.Set(STREAMREQUESTTIMEOUT);
+}
+
+cStreamRequest::~cStreamRequest()
+{
+  if (sock >= 0)
+     close(sock);
+}
+
+int cStreamRequest::Detach(void)
+{
+  int s = sock;
+  sock = -1;
+  return s;
+}
+
+const char *cStreamRequest::Read(bool &Error)
+{
+  Error = false;
+  ssize_t n = recv(sock, buf + length, sizeof(buf) - length - 1, MSG_DONTWAIT);
+  if (n > 0) {
+     length += n;
+     buf[length] = 0;
+     char *End = strstr(buf, "\r\n\r\n");
+     if (!End)
+        End = strstr(buf, "\n\n");
+     if (End) {
+        // We only need the request line:
+        char *s = strchr(buf, '\n');
+        *s = 0;
+        char *Method = buf;
+        char *Path = strchr(Method, ' ');
+        if (Path) {
+           *Path++ = 0;
+           if (char *p = strchr(Path, ' '))
+              *p = 0;
+           stripspace(Path);
+           if (strcmp(Method, "GET") == 0)
+              return Path;
+           Respond(405, "Method Not Allowed");
+           }
+        else
+           Respond(400, "Bad Request");
+        Error = true;
+        }
+     else if (length >= int(sizeof(buf)) - 1) {
+        Respond(400, "Bad Request");
+        Error = true;
+        }
+     }
+  else if (n == 0 || FATALERRNO || timeout.TimedOut())
+     Error = true;
+  return NULL;
+}
+
+void cStreamRequest::Respond(int Code, const char *Text)
+{
+  cString s = cString::sprintf("HTTP/1.0 %d %s\r\n"
+                               "Server: VDR/%s\r\n"
+                               "Content-Type: %s\r\n"
+                               "Connection: close\r\n"
+                               "\r\n"
+                               "%s",
+                               Code, Text, VDRVERSION,
+                               Code == 200 ? "video/mp2t" : "text/plain",
+                               Code == 200 ? "" : *cString::sprintf("%s\n", Text));
+  if (send(sock, s, strlen(s), MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+     dsyslog("stream client %s: %m", *address);
+  isyslog("stream client %s: %d %s", *address, Code, Text);
+}
+
+// --- cStreamServer ---------------------------------------------------------
+
+class cStreamServer : public cThread {
+private:
+  int port;
+  int sock;
+  cVector<cStreamRequest *> requests;
+  cVector<cStreamClient *> clients;
+  cVector<cStreamReceiver *> receivers;
+  pollfd fds[2 + MAXSTREAMCONNECTIONS];
+  bool Listen(void);
+  void Accept(void);
+  void HandleRequest(cStreamRequest *Request, const char *Path);
+  cStreamReceiver *GetReceiver(const cChannel *Channel);
+  void DeleteClient(int Index);
+  void DeleteUnusedReceivers(void);
+protected:
+  virtual void Action(void) override;
+public:
+  cStreamServer(int Port);
+  virtual ~cStreamServer() override;
+  };
+
+cStreamServer::cStreamServer(int Port)
+:cThread("stream server", true)
+{
+  port = Port;
+  sock = -1;
+}
+
+cStreamServer::~cStreamServer()
+{
+  Cancel(3);
+  for (int i = 0; i < requests.Size(); i++)
+      delete requests[i];
+  while (clients.Size())
+        DeleteClient(0);
+  DeleteUnusedReceivers();
+  if (sock >= 0)
+     close(sock);
+}
+
+bool cStreamServer::Listen(void)
+{
+  sock = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK, IPPROTO_IP);
+  if (sock < 0) {
+     LOG_ERROR;
+     return false;
+     }
+  int ReUseAddr = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &ReUseAddr, sizeof(ReUseAddr));
+  sockaddr_in Addr;
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sin_family = AF_INET;
+  Addr.sin_port = htons(port);
+  Addr.sin_addr.s_addr = SVDRPhosts.LocalhostOnly() ? htonl(INADDR_LOOPBACK) : htonl(INADDR_ANY);
+  if (bind(sock, (sockaddr *)&Addr, sizeof(Addr)) < 0 || listen(sock, SOMAXCONN) < 0) {
+     LOG_ERROR;
+     close(sock);
+     sock = -1;
+     return false;
+     }
+  isyslog("stream server listening on port %d", port);
+  return true;
+}
+
+void cStreamServer::Accept(void)
+{
+  for (;;) {
+      sockaddr_in Addr;
+      socklen_t Size = sizeof(Addr);
+      int NewSock = accept4(sock, (sockaddr *)&Addr, &Size, SOCK_NONBLOCK);
+      if (NewSock < 0) {
+         if (FATALERRNO)
+            LOG_ERROR;
+         break;
+         }
+      cString Address = cString::sprintf("%s:%d", inet_ntoa(Addr.sin_addr), ntohs(Addr.sin_port));
+      if (!SVDRPhosts.Acceptable(Addr.sin_addr.s_addr)) {
+         isyslog("stream client %s: access denied", *Address);
+         close(NewSock);
+         continue;
+         }
+      cStreamRequest *Request = new cStreamRequest(NewSock, Address);
+      if (requests.Size() + clients.Size() >= MAXSTREAMCONNECTIONS) {
+         Request->Respond(503, "Service Unavailable");
+         delete Request;
+         continue;
+         }
+      requests.Append(Request);
+      }
+}
+
+cStreamReceiver *cStreamServer::GetReceiver(const cChannel *Channel)
+{
+  for (int i = 0; i < receivers.Size(); i++) {
+      if (receivers[i]->ChannelID() == Channel->GetChannelID() && receivers[i]->IsAttached())
+         return receivers[i];
+      }
+  cStreamReceiver *Receiver = new cStreamReceiver(Channel);
+  if (AttachToDevice(Receiver, Channel)) {
+     receivers.Append(Receiver);
+     return Receiver;
+     }
+  delete Receiver;
+  return NULL;
+}
+
+void cStreamServer::HandleRequest(cStreamRequest *Request, const char *Path)
+{
+  dsyslog("stream client %s: GET %s", Request->Address(), Path);
+  if (startswith(Path, "/channel/")) {
+     const char *Id = Path + 9;
+     LOCK_CHANNELS_READ;
+     const cChannel *Channel = isnumber(Id) ? Channels->GetByNumber(atoi(Id)) : Channels->GetByChannelID(tChannelID::FromString(Id));
+     if (!Channel || Channel->GroupSep()) {
+        Request->Respond(404, "Not Found");
+        return;
+        }
+     cStreamReceiver *Receiver = GetReceiver(Channel);
+     if (!Receiver) {
+        Request->Respond(503, "Service Unavailable");
+        return;
+        }
+     Request->Respond(200, "OK");
+     isyslog("stream client %s: streaming channel %d %s", Request->Address(), Channel->Number(), Channel->Name());
+     cStreamLiveClient *Client = new cStreamLiveClient(Request->Detach(), Request->Address(), Receiver);
+     Receiver->Add(Client);
+     clients.Append(Client);
+     }
+  else if (startswith(Path, "/recording/")) {
+     const char *Id = Path + 11;
+     cString FileName;
+     {
+       LOCK_RECORDINGS_READ;
+       const cRecording *Recording = isnumber(Id) ? Recordings->GetById(atoi(Id)) : NULL;
+       if (!Recording) {
+          Request->Respond(404, "Not Found");
+          return;
+          }
+       if (Recording->IsPesRecording()) {
+          Request->Respond(415, "Unsupported Media Type");
+          return;
+          }
+       FileName = Recording->FileName();
+     }
+     Request->Respond(200, "OK");
+     isyslog("stream client %s: streaming recording %s", Request->Address(), *FileName);
+     clients.Append(new cStreamRecordingClient(Request->Detach(), Request->Address(), FileName));
+     }
+  else
+     Request->Respond(404, "Not Found");
+}
+
+void cStreamServer::DeleteClient(int Index)
+{
+  cStreamClient *Client = clients[Index];
+  if (cStreamLiveClient *LiveClient = dynamic_cast<cStreamLiveClient *>(Client))
+     LiveClient->Receiver()->Del(LiveClient);
+  clients.Remove(Index);
+  delete Client;
+}
+
+void cStreamServer::DeleteUnusedReceivers(void)
+{
+  for (int i = receivers.Size() - 1; i >= 0; i--) {
+      if (receivers[i]->NumClients() == 0) {
+         dsyslog("stream server: releasing channel %s", receivers[i]->ChannelName());
+         delete receivers[i];
+         receivers.Remove(i);
+         }
+      }
+}
+
+void cStreamServer::Action(void)
+{
+  if (!Listen())
+     return;
+  while (Running()) {
+        // Set up the file handles to wait for:
+        int NumFds = 0;
+        fds[NumFds].fd = sock;
+        fds[NumFds++].events = POLLIN;
+        fds[NumFds].fd = StreamServerWakeup.Fd();
+        fds[NumFds++].events = POLLIN;
+        for (int i = 0; i < requests.Size(); i++) {
+            fds[NumFds].fd = requests[i]->Socket();
+            fds[NumFds++].events = POLLIN;
+            }
+        for (int i = 0; i < clients.Size(); i++) {
+            fds[NumFds].fd = clients[i]->Socket();
+            fds[NumFds++].events = POLLIN | (clients[i]->Ready() ? POLLOUT : 0);
+            }
+        if (poll(fds, NumFds, clients.Size() || requests.Size() ? STREAMPOLLTIMEOUT : 1000) < 0 && FATALERRNO) {
+           LOG_ERROR;
+           break;
+           }
+        StreamServerWakeup.Clear();
+        Accept();
+        // Process incoming requests:
+        for (int i = 0; i < requests.Size(); i++) {
+            bool Error;
+            const char *Path = requests[i]->Read(Error);
+            if (Path)
+               HandleRequest(requests[i], Path);
+            if (Path || Error) {
+               delete requests[i];
+               requests.Remove(i--);
+               }
+            }
+        // Send data to the clients:
+        for (int i = 0; i < clients.Size(); i++) {
+            bool Ok = clients[i]->Process();
+            if (Ok) {
+               if (cStreamLiveClient *LiveClient = dynamic_cast<cStreamLiveClient *>(clients[i])) {
+                  if (!LiveClient->Receiver()->IsAttached()) {
+                     isyslog("stream client %s: channel %s is no longer available", LiveClient->Address(), LiveClient->Receiver()->ChannelName());
+                     Ok = false;
+                     }
+                  }
+               }
+            if (!Ok)
+               DeleteClient(i--);
+            }
+        DeleteUnusedReceivers();
+        }
+}
+
+// --- Stream Server ---------------------------------------------------------
+
+static cMutex StreamServerMutex;
+static cStreamServer *StreamServer = NULL;
+
+void StartStreamServer(int Port)
+{
+  cMutexLock MutexLock(&StreamServerMutex);
+  if (Port && !StreamServer) {
+     StreamServer = new cStreamServer(Port);
+     StreamServer->Start();
+     }
+}
+
+void StopStreamServer(void)
+{
+  cMutexLock MutexLock(&StreamServerMutex);
+  delete StreamServer;
+  StreamServer = NULL;
+}
+
+// --- cMulticastStream ------------------------------------------------------
+
+cMulticastStreams MulticastStreams;
+
+cMulticastStream::cMulticastStream(void)
+{
+  memset(&addr, 0, sizeof(addr));
+  ttl = 1;
+}
+
+bool cMulticastStream::Parse(const char *s)
+{
+  char Channel[256];
+  char Address[64];
+  int Port;
+  int n = sscanf(s, "%255s %63[^:]:%d %d", Channel, Address, &Port, &ttl);
+  if (n < 3 || Port <= 0 || Port > 65535 || ttl < 0 || ttl > 255)
+     return false;
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(Port);
+  if (!inet_aton(Address, &addr.sin_addr))
+     return false;
+  channel = Channel;
+  return true;
+}
+
+// --- cMulticastSender ------------------------------------------------------
+
+#define MCTSPERDATAGRAM      7 // TS packets per datagram (7 * 188 + RTP header fits into an Ethernet frame)
+#define MCBATCHSIZE         64 // max. number of datagrams sent in one call to sendmmsg()
+#define MCBUFFERSIZE        MEGABYTE(2)
+#define MCPACINGDELAY   100000 // us by which sending lags behind the PCR, to even out bursts of incoming data
+#define MCMAXDRIFT     1000000 // us the PCR may deviate from the wall clock before pacing is restarted
+#define MCPATPMTINTERVAL   100 // ms between PAT/PMT packets inserted into the stream
+#define RTPHEADERSIZE       12
+#define RTPPAYLOADTYPEMP2T  33 // RFC 3551
+
+class cMulticastSender : public cReceiver, public cThread {
+private:
+  cRingBufferLinear *ringBuffer;
+  cPatPmtGenerator patPmtGenerator;
+  cTimeMs patPmtTimer;
+  int pcrPid;
+  int sock;
+  sockaddr_in addr;
+  cString name;
+  uint16_t sequence;
+  uint32_t ssrc;
+  int64_t firstPcr;
+  uint64_t firstTime;
+  uchar datagrams[MCBATCHSIZE][RTPHEADERSIZE + MCTSPERDATAGRAM * TS_SIZE];
+  int numDatagrams;
+  int numPackets; // in datagrams[numDatagrams]
+  int64_t pcr;
+  bool errorLogged;
+  void Pace(int64_t Pcr);
+  void Flush(void);
+  void AddPacket(const uchar *Data);
+protected:
+  virtual void Activate(bool On) override;
+  virtual void Receive(const uchar *Data, int Length) override;
+  virtual void Action(void) override;
+public:
+  cMulticastSender(const cChannel *Channel, const cMulticastStream *Stream);
+  virtual ~cMulticastSender() override;
+  bool Ok(void) { return sock >= 0; }
+  };
+
+cMulticastSender::cMulticastSender(const cChannel *Channel, const cMulticastStream *Stream)
+:cReceiver(Channel, STREAMPRIORITY)
+,patPmtGenerator(Channel)
+{
+  name = cString::sprintf("multicast %s:%d", inet_ntoa(Stream->Address()->sin_addr), ntohs(Stream->Address()->sin_port));
+  SetDescription("%s", *name);
+  ringBuffer = new cRingBufferLinear(MCBUFFERSIZE, TS_SIZE, true, cString::sprintf("Multicast %d", Channel->Number()));
+  ringBuffer->SetTimeouts(0, 100);
+  pcrPid = Channel->Ppid();
+  addr = *Stream->Address();
+  sequence = random();
+  ssrc = random();
+  firstPcr = -1;
+  firstTime = 0;
+  numDatagrams = 0;
+  numPackets = 0;
+  pcr = -1;
+  errorLogged = false;
+  SetMultiPacket(true);
+  sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock >= 0) {
+     uchar Ttl = Stream->Ttl();
+     if (setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &Ttl, sizeof(Ttl)) < 0)
+        LOG_ERROR;
+     }
+  else
+     LOG_ERROR;
+}
+
+cMulticastSender::~cMulticastSender()
+{
+  Detach();
+  delete ringBuffer;
+  if (sock >= 0)
+     close(sock);
+}
+
+void cMulticastSender::Activate(bool On)
+{
+  if (On)
+     Start();
+  else
+     Cancel(3);
+}
+
+void cMulticastSender::Receive(const uchar *Data, int Length)
+{
+  int p = ringBuffer->Put(Data, Length);
+  if (p != Length && Running())
+     ringBuffer->ReportOverflow(Length - p);
+}
+
+void cMulticastSender::Pace(int64_t Pcr)
+{
+  uint64_t Now = cTimeMs::NowUs();
+  if (firstPcr >= 0) {
+     int64_t Delta = Pcr - firstPcr;
+     if (Delta < 0)
+        Delta += MAX27MHZ + 1; // wrap around
+     int64_t Wait = int64_t(firstTime + Delta / 27) - int64_t(Now);
+     if (-MCMAXDRIFT < Wait && Wait < MCMAXDRIFT) {
+        if (Wait >= 1000)
+           cCondWait::SleepMs(Wait / 1000);
+        return;
+        }
+     dsyslog("%s: restarting PCR pacing (off by %" PRId64 " ms)", *name, Wait / 1000);
+     }
+  // Start pacing (or restart it after a discontinuity):
+  firstPcr = Pcr;
+  firstTime = Now + MCPACINGDELAY;
+}
+
+void cMulticastSender::Flush(void)
+{
+  if (!numDatagrams)
+     return;
+  uint32_t Timestamp = uint32_t(cTimeMs::NowUs() * 9 / 100); // 90kHz
+  mmsghdr Msgs[MCBATCHSIZE];
+  iovec Iovs[MCBATCHSIZE];
+  memset(Msgs, 0, sizeof(Msgs));
+  for (int i = 0; i < numDatagrams; i++) {
+      uchar *d = datagrams[i];
+      d[0]  = 0x80; // version 2
+      d[1]  = RTPPAYLOADTYPEMP2T;
+      d[2]  = sequence >> 8;
+      d[3]  = sequence;
+      d[4]  = Timestamp >> 24;
+      d[5]  = Timestamp >> 16;
+      d[6]  = Timestamp >> 8;
+      d[7]  = Timestamp;
+      d[8]  = ssrc >> 24;
+      d[9]  = ssrc >> 16;
+      d[10] = ssrc >> 8;
+      d[11] = ssrc;
+      sequence++;
+      Iovs[i].iov_base = d;
+      Iovs[i].iov_len = sizeof(datagrams[i]);
+      Msgs[i].msg_hdr.msg_name = &addr;
+      Msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+      Msgs[i].msg_hdr.msg_iov = &Iovs[i];
+      Msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+  for (int i = 0; i < numDatagrams; ) {
+      int n = sendmmsg(sock, Msgs + i, numDatagrams - i, 0);
+      if (n <= 0) {
+         if (errno == EINTR)
+            continue;
+         if (!errorLogged) {
+            LOG_ERROR;
+            errorLogged = true;
+            }
+         break;
+         }
+      errorLogged = false;
+      i += n;
+      }
+  numDatagrams = 0;
+}
+
+void cMulticastSender::AddPacket(const uchar *Data)
+{
+  memcpy(datagrams[numDatagrams] + RTPHEADERSIZE + numPackets * TS_SIZE, Data, TS_SIZE);
+  if (TsPid(Data) == pcrPid) {
+     int64_t Pcr = TsGetPcr(Data);
+     if (Pcr >= 0)
+        pcr = Pcr;
+     }
+  if (++numPackets == MCTSPERDATAGRAM) {
+     numPackets = 0;
+     numDatagrams++;
+     if (pcr >= 0) {
+        // Send everything up to this datagram at the time given by its PCR:
+        Pace(pcr);
+        pcr = -1;
+        Flush();
+        }
+     else if (numDatagrams == MCBATCHSIZE)
+        Flush();
+     }
+}
+
+void cMulticastSender::Action(void)
+{
+  while (Running()) {
+        int r;
+        uchar *b = ringBuffer->Get(r);
+        if (b) {
+           int Count = TS_SYNC(b, r);
+           if (Count) {
+              ringBuffer->Del(Count);
+              continue;
+              }
+           Count = r - r % TS_SIZE;
+           for (int i = 0; i < Count && Running(); i += TS_SIZE) {
+               if (patPmtTimer.TimedOut()) {
+                  AddPacket(patPmtGenerator.GetPat());
+                  int Index = 0;
+                  while (uchar *pmt = patPmtGenerator.GetPmt(Index))
+                        AddPacket(pmt);
+                  patPmtTimer.Set(MCPATPMTINTERVAL);
+                  }
+               AddPacket(b + i);
+               }
+           ringBuffer->Del(Count);
+           }
+        }
+}
+
+// --- cMulticastHandler -----------------------------------------------------
+
+#define MCRETRYINTERVAL 10000 // ms between attempts to get a device for a multicast stream
+
+class cMulticastHandler : public cThread {
+private:
+  cCondWait condWait;
+  cVector<cMulticastSender *> senders; // one for each entry in MulticastStreams
+  cVector<int> failed; // to log failures only once
+  void CheckSenders(void);
+protected:
+  virtual void Action(void) override;
+public:
+  cMulticastHandler(void);
+  virtual ~cMulticastHandler() override;
+  void Stop(void);
+  };
+
+cMulticastHandler::cMulticastHandler(void)
+:cThread("multicast handler", true)
+{
+  for (int i = 0; i < MulticastStreams.Count(); i++) {
+      senders.Append(NULL);
+      failed.Append(false);
+      }
+}
+
+cMulticastHandler::~cMulticastHandler()
+{
+  Stop();
+  for (int i = 0; i < senders.Size(); i++)
+      delete senders[i];
+}
+
+void cMulticastHandler::Stop(void)
+{
+  Cancel(-1);
+  condWait.Signal();
+  Cancel(3);
+}
+
+void cMulticastHandler::CheckSenders(void)
+{
+  int i = 0;
+  for (const cMulticastStream *Stream = MulticastStreams.First(); Stream; Stream = MulticastStreams.Next(Stream), i++) {
+      if (senders[i] && senders[i]->IsAttached())
+         continue;
+      if (senders[i]) {
+         isyslog("multicast %s: channel %s is no longer available", inet_ntoa(Stream->Address()->sin_addr), Stream->Channel());
+         delete senders[i];
+         senders[i] = NULL;
+         }
+      LOCK_CHANNELS_READ;
+      const char *Id = Stream->Channel();
+      const cChannel *Channel = isnumber(Id) ? Channels->GetByNumber(atoi(Id)) : Channels->GetByChannelID(tChannelID::FromString(Id));
+      if (!Channel) {
+         if (!failed[i])
+            esyslog("ERROR: multicast %s: unknown channel %s", inet_ntoa(Stream->Address()->sin_addr), Id);
+         failed[i] = true;
+         continue;
+         }
+      cMulticastSender *Sender = new cMulticastSender(Channel, Stream);
+      if (Sender->Ok() && AttachToDevice(Sender, Channel)) {
+         isyslog("multicast %s:%d: sending channel %d %s", inet_ntoa(Stream->Address()->sin_addr), ntohs(Stream->Address()->sin_port), Channel->Number(), Channel->Name());
+         senders[i] = Sender;
+         failed[i] = false;
+         }
+      else {
+         if (!failed[i])
+            isyslog("multicast %s: no free device for channel %d %s", inet_ntoa(Stream->Address()->sin_addr), Channel->Number(), Channel->Name());
+         failed[i] = true;
+         delete Sender;
+         }
+      }
+}
+
+void cMulticastHandler::Action(void)
+{
+  while (Running()) {
+        CheckSenders();
+        condWait.Wait(MCRETRYINTERVAL);
+        }
+}
+
+static cMutex MulticastHandlerMutex;
+static cMulticastHandler *MulticastHandler = NULL;
+
+void StartMulticastStreams(void)
+{
+  cMutexLock MutexLock(&MulticastHandlerMutex);
+  if (MulticastStreams.Count() && !MulticastHandler) {
+     MulticastHandler = new cMulticastHandler;
+     MulticastHandler->Start();
+     }
+}
+
+void StopMulticastStreams(void)
+{
+  cMutexLock MutexLock(&MulticastHandlerMutex);
+  delete MulticastHandler;
+  MulticastHandler = NULL;
+}
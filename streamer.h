@@ -0,0 +1,70 @@
+/*
+ * streamer.h: HTTP streaming of live channels and recordings
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#ifndef __STREAMER_H
+#define __STREAMER_H
+
+#include <netinet/in.h>
+#include "config.h"
+
+// The stream server delivers live channels and recordings as MPEG transport
+// streams over HTTP. A client requests
+//
+//   GET /channel/<number>       or  GET /channel/<channel id>
+//   GET /recording/<id>         (the id as listed by the SVDRP command LSTR)
+//
+// and receives the TS data until it closes the connection (or the recording
+// ends). Access is controlled by the same 'svdrphosts.conf' as SVDRP.
+// All clients watching the same channel share a single cReceiver, which
+// collects the TS packets into reference counted buffers that are queued for
+// every client, so the data is never copied per client. If the kernel supports
+// it, live data is sent with MSG_ZEROCOPY, and recordings are sent directly
+// from their files with sendfile().
+
+void StartStreamServer(int Port);
+     ///< Starts the stream server on the given TCP Port (if it is not 0).
+void StopStreamServer(void);
+     ///< Disconnects all clients and stops the stream server.
+
+// Channels listed in 'multicast.conf' are sent permanently as RTP over UDP
+// (typically to a multicast group), so that any number of viewers in the
+// network can watch them at the cost of a single receiver. Each line has the
+// format
+//
+//   <channel> <address>:<port> [<ttl>]
+//
+// where <channel> is a channel number or channel id. Each datagram carries
+// 7 TS packets, the datagrams are paced according to the channel's PCR and
+// sent in batches with sendmmsg().
+
+class cMulticastStream : public cListObject {
+private:
+  cString channel;
+  struct sockaddr_in addr;
+  int ttl;
+public:
+  cMulticastStream(void);
+  bool Parse(const char *s);
+  const char *Channel(void) const { return channel; }
+       ///< The channel number or channel id, as given in the config file.
+  const struct sockaddr_in *Address(void) const { return &addr; }
+  int Ttl(void) const { return ttl; }
+  };
+
+class cMulticastStreams : public cConfig<cMulticastStream> {};
+
+extern cMulticastStreams MulticastStreams;
+
+void StartMulticastStreams(void);
+     ///< Starts sending the channels listed in MulticastStreams. Channels that
+     ///< can't be received at the moment (because all devices are in use) are
+     ///< retried periodically.
+void StopMulticastStreams(void);
+
+#endif //__STREAMER_H
@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <ifaddrs.h>
+#include <limits>
 #include <netinet/in.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -27,16 +28,23 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <unistd.h>
+#ifdef ZLIB
+#include <zlib.h>
+#endif
 #include "channels.h"
 #include "config.h"
 #include "device.h"
 #include "eitscan.h"
 #include "keys.h"
+#include "membudget.h"
 #include "menu.h"
+#include "metrics.h"
 #include "plugin.h"
 #include "recording.h"
 #include "remote.h"
 #include "skins.h"
+#include "startup.h"
+#include "taskpool.h"
 #include "timers.h"
 #include "videodir.h"
 
@@ -323,7 +331,10 @@ private:
   cFile file;
   int fetchFlags;
   bool connected;
+  int timersState; // the state of the remote timers as known to this client (-1 if the server doesn't support 'LSTT SINCE')
+  cStringList remoteTimers; // the remote timers as of timersState
   bool Send(const char *Command);
+  bool GetRemoteTimerChanges(cStringList &Response, bool &Supported);
 public:
   cSVDRPClient(const char *Address, int Port, const char *ServerName, int Timeout);
   ~cSVDRPClient();
@@ -352,6 +363,7 @@ cSVDRPClient::cSVDRPClient(const char *Address, int Port, const char *ServerName
   pingTime.Set(timeout);
   fetchFlags = sffNone;
   connected = false;
+  timersState = 0;
   if (socket.Connect(Address)) {
      if (file.Open(socket.Socket())) {
         SVDRPClientPoller.Add(file, false);
@@ -399,6 +411,7 @@ bool cSVDRPClient::Process(cStringList *Response)
   if (file.IsOpen()) {
      int numChars = 0;
 #define SVDRPResonseTimeout 5000 // ms
+#define SVDRPFlushTimeout   1000 // ms to wait for a client to accept pending output before closing the connection
      cTimeMs Timeout(SVDRPResonseTimeout);
      for (;;) {
          if (file.Ready(false)) {
@@ -499,8 +512,68 @@ bool cSVDRPClient::HasFetchFlag(int Flag)
   return Result;
 }
 
+bool cSVDRPClient::GetRemoteTimerChanges(cStringList &Response, bool &Supported)
+{
+  Supported = true;
+  if (Execute(cString::sprintf("LSTT ID SINCE %d", timersState), &Response)) {
+     int n = Response.Size();
+     if (n > 0 && SVDRPCode(Response[0]) == 501) {
+        dsyslog("SVDRP %s < %s remote server '%s' doesn't support timer changes", Setup.SVDRPHostName, serverIpAddress.Connection(), *serverName);
+        Supported = false;
+        return false;
+        }
+     int State;
+     char Mode[8];
+     if (n == 0 || SVDRPCode(Response[n - 1]) != 250 || sscanf(Response[n - 1] + 4, "State %d %7s", &State, Mode) != 2) {
+        esyslog("ERROR: %s: %s", ServerName(), n ? Response[n - 1] : "missing response");
+        return false;
+        }
+     if (strcasecmp(Mode, "full") == 0)
+        remoteTimers.Clear();
+     for (int i = 0; i < n - 1; i++) {
+         char *s = Response[i];
+         if (SVDRPCode(s) != 250) {
+            esyslog("ERROR: %s: %s", ServerName(), s);
+            return false;
+            }
+         s += 4;
+         int Id = atoi(s);
+         int Index = -1;
+         for (int j = 0; j < remoteTimers.Size(); j++) {
+             if (atoi(remoteTimers[j]) == Id) {
+                Index = j;
+                break;
+                }
+             }
+         if (Index >= 0) {
+            free(remoteTimers[Index]);
+            remoteTimers.Remove(Index);
+            }
+         if (strchr(s, ' ')) // a line containing only the id means the timer has been deleted
+            remoteTimers.Append(strdup(s));
+         }
+     remoteTimers.SortNumerically();
+     timersState = State;
+     Response.Clear();
+     for (int i = 0; i < remoteTimers.Size(); i++)
+         Response.Append(strdup(remoteTimers[i]));
+     return true;
+     }
+  return false;
+}
+
 bool cSVDRPClient::GetRemoteTimers(cStringList &Response)
 {
+  if (timersState >= 0) {
+     bool Supported;
+     if (GetRemoteTimerChanges(Response, Supported))
+        return true;
+     if (Supported) {
+        timersState = 0; // start over with the full list next time
+        return false;
+        }
+     timersState = -1;
+     }
   if (Execute("LSTT ID", &Response)) {
      for (int i = 0; i < Response.Size(); i++) {
          char *s = Response[i];
@@ -840,6 +913,9 @@ bool cPUTEhandler::Process(const char *s)
                           // adjust the help for CLRE accordingly if changing this!
 
 const char *HelpPages[] = {
+  "ABRT\n"
+  "    Abort the current batch (see BEGN). The commands given since BEGN are\n"
+  "    discarded without having been executed.",
   "AUDI [ <number> ]\n"
   "    Lists the currently available audio tracks in the format 'number language description'.\n"
   "    The number indicates the track type (1..32 = MP2, 33..48 = Dolby).\n"
@@ -848,16 +924,41 @@ const char *HelpPages[] = {
   "    audio is switched to that track.\n"
   "    Note that the list may not be fully available or current immediately after\n"
   "    switching the channel or starting a replay.",
+  "BEGN\n"
+  "    Begin a batch of timer commands. The following commands are not executed\n"
+  "    and answered right away, but collected until COMT, which executes all of\n"
+  "    them in a row while holding the timers lock only once, so that a bulk\n"
+  "    change results in just a single save of the timers. Only the commands\n"
+  "    CHKT, DELT, LSTT, MODT, NEWT, NEXT and UPDT can be used in a batch.\n"
+  "    Commands may be sent without waiting for their replies, since they are\n"
+  "    always answered in the order in which they have been received.",
   "CHAN [ + | - | <number> | <name> | <id> ]\n"
   "    Switch channel up, down or to the given channel number, name or id.\n"
   "    Without option (or after successfully switching to the channel)\n"
   "    it returns the current channel number and name.",
+  "CHKT [ <days> ]\n"
+  "    Check the timers for conflicts within the given number of days (default\n"
+  "    is 7). For every occurrence of a timer that can't be fully recorded,\n"
+  "    because there is no free device or CAM for it, a line containing the\n"
+  "    timer id, the start and stop time of the recording and the time from\n"
+  "    which on it can't be recorded is listed. Times are given as time_t.",
   "CLRE [ <number> | <name> | <id> ]\n"
   "    Clear the EPG list of the given channel number, name or id.\n"
   "    Without option it clears the entire EPG list.\n"
   "    After a CLRE command, no further EPG processing is done for 10\n"
   "    seconds, so that data sent with subsequent PUTE commands doesn't\n"
   "    interfere with data from the broadcasters.",
+  "COMT\n"
+  "    Commit the current batch (see BEGN). The collected commands are executed\n"
+  "    and their replies are sent in the given order, followed by the reply to\n"
+  "    the COMT command itself.",
+  "COMP [ deflate ]\n"
+  "    Compress all further output on this connection. Without option, the\n"
+  "    supported compression methods are listed. With 'deflate', the reply\n"
+  "    to this command is the last one sent in plain text, and everything\n"
+  "    that follows is a raw deflate stream (RFC 1951), which is flushed\n"
+  "    at the end of every reply. Commands are always sent uncompressed.\n"
+  "    Compression can't be turned off again on the same connection.",
   "CONN name:<name> port:<port> vdrversion:<vdrversion> apiversion:<apiversion> timeout:<timeout>\n"
   "    Used by peer-to-peer connections between VDRs to tell the other VDR\n"
   "    to establish a connection to this VDR. The name is the SVDRP host name\n"
@@ -878,7 +979,7 @@ const char *HelpPages[] = {
   "    Edit the recording with the given id. Before a recording can be\n"
   "    edited, an LSTR command should have been executed in order to retrieve\n"
   "    the recording ids.",
-  "GRAB <filename> [ <quality> [ <sizex> <sizey> ] ]\n"
+  "GRAB <filename> [ <quality> [ <sizex> <sizey> ] ] [ binary ]\n"
   "    Grab the current frame and save it to the given file. Images can\n"
   "    be stored as JPEG or PNM, depending on the given file name extension.\n"
   "    The quality of the grabbed image can be in the range 0..100, where 100\n"
@@ -887,7 +988,10 @@ const char *HelpPages[] = {
   "    If the file name is just an extension (.jpg, .jpeg or .pnm) the image\n"
   "    data will be sent to the SVDRP connection encoded in base64. The same\n"
   "    happens if '-' (a minus sign) is given as file name, in which case the\n"
-  "    image format defaults to JPEG.",
+  "    image format defaults to JPEG. If the keyword 'binary' is given, the\n"
+  "    image data is sent as is instead, after a line that tells the number\n"
+  "    of bytes that follow. A grab with the same parameters within one\n"
+  "    second of a previous one returns the image grabbed before.",
   "HELP [ <topic> ]\n"
   "    The HELP command gives help info.",
   "HITK [ <key> ... ]\n"
@@ -907,12 +1011,19 @@ const char *HelpPages[] = {
   "    List all available devices. Each device is listed with its name and\n"
   "    whether it is currently the primary device ('P') or it implements a\n"
   "    decoder ('D') and can be used as output device.",
-  "LSTE [ <channel> ] [ now | next | at <time> ]\n"
+  "LSTE [ <channel>[,<channel>...] ] [ now | next | at <time> |\n"
+  "    [ from <time> ] [ to <time> ] ] [ since <state> ]\n"
   "    List EPG data. Without any parameters all data of all channels is\n"
-  "    listed. If a channel is given (either by number or by channel ID),\n"
-  "    only data for that channel is listed. 'now', 'next', or 'at <time>'\n"
-  "    restricts the returned data to present events, following events, or\n"
-  "    events at the given time (which must be in time_t form).",
+  "    listed. If channels are given (either by number or by channel ID,\n"
+  "    separated by commas), only data for these channels is listed. 'now',\n"
+  "    'next', or 'at <time>' restricts the returned data to present events,\n"
+  "    following events, or events at the given time (which must be in time_t\n"
+  "    form). 'from <time>' and 'to <time>' restrict it to the events that end\n"
+  "    at or after, and start at or before the given times, respectively.\n"
+  "    With 'since <state>' only the data of channels whose schedules have been\n"
+  "    modified since the given state is listed, and the final line contains\n"
+  "    the current state (as in '215 End of EPG data; state 1234'). Use\n"
+  "    'since 0' to get all data together with the initial state.",
   "LSTR [ <id> [ path ] ]\n"
   "    List recordings. Without option, all recordings are listed. Otherwise\n"
   "    the information for the given recording is listed. If a recording\n"
@@ -920,12 +1031,19 @@ const char *HelpPages[] = {
   "    recording's directory is listed.\n"
   "    Note that the ids of the recordings are not necessarily given in\n"
   "    numeric order.",
-  "LSTT [ <id> ] [ id ]\n"
+  "LSTT [ <id> ] [ id ] [ since <state> ]\n"
   "    List timers. Without option, all timers are listed. Otherwise\n"
   "    only the timer with the given id is listed. If the keyword 'id' is\n"
   "    given, the channels will be listed with their unique channel ids\n"
   "    instead of their numbers. This command lists only the timers that are\n"
-  "    defined locally on this VDR, not any remote timers from other VDRs.",
+  "    defined locally on this VDR, not any remote timers from other VDRs.\n"
+  "    With 'since' only the timers that have been added, modified or deleted\n"
+  "    since the given state are listed, where a deleted timer is listed by\n"
+  "    its id only. The last line reads 'State <state> delta' and contains the\n"
+  "    state to use with the next 'since'. If the given state is unknown (as\n"
+  "    is the case with 0 or after reconnecting), all timers are listed and\n"
+  "    the last line reads 'State <state> full'. The state refers to what\n"
+  "    has been sent over the current connection.",
   "MESG <message>\n"
   "    Displays the given message on the OSD. The message will be queued\n"
   "    and displayed whenever this is suitable.\n",
@@ -1010,8 +1128,29 @@ const char *HelpPages[] = {
   "SCAN\n"
   "    Forces an EPG scan. If this is a single DVB device system, the scan\n"
   "    will be done on the primary device unless it is currently recording.",
-  "STAT disk\n"
-  "    Return information about disk usage (total, free, percent).",
+  "SRCE <text>\n"
+  "    Search EPG data. Lists all events that contain all the words of the\n"
+  "    given text in their title, short text or description, in the same\n"
+  "    format as LSTE. Words are compared without regard to case.",
+  "STAT disk | startup | plugins | threads | buffers | memory | metrics | locks [ on | off ]\n"
+  "    Return information about disk usage (total, free, percent), or the\n"
+  "    duration of the phases of VDR's startup. For each phase one line with\n"
+  "    its begin, end and duration (in milliseconds since the program has been\n"
+  "    started) and its name is returned. 'plugins' returns one line per plugin\n"
+  "    with its state (started, deferred or stopped) and the number of calls to\n"
+  "    and the time spent in its MainThreadHook(). 'threads' returns one line\n"
+  "    per thread with its id, name, CPU time and number of context switches.\n"
+  "    'buffers' returns one line per ring buffer with its size, high water\n"
+  "    mark, the number of bytes put into and taken out of it, overflows and\n"
+  "    the time its producer and consumer have waited. 'memory' returns the\n"
+  "    memory budget, and one line per buffer or cache with its priority, its\n"
+  "    minimum, preferred, maximum and granted size (in KB) and its name.\n"
+  "    'metrics' returns the runtime metrics of devices, recordings, ring\n"
+  "    buffers and locks in the OpenMetrics text format. 'locks' returns the results of the lock\n"
+  "    profiler: histograms of the wait and hold times of the global locks and\n"
+  "    of all mutexes, and the call sites with the longest waits and holds.\n"
+  "    'locks on' discards any previous results and starts profiling, 'locks off'\n"
+  "    stops it. Profiling slows down locking somewhat.",
   "UPDT <settings>\n"
   "    Updates a timer. Settings must be in the same format as returned\n"
   "    by the LSTT command. If a timer with the same channel, day, start\n"
@@ -1085,7 +1224,149 @@ const char *GetHelpPage(const char *Cmd, const char **p)
 
 static cString grabImageDir;
 
+// --- cGrabCache ------------------------------------------------------------
+
+#define GRABCACHETIME 1000 // ms for which a grabbed image is reused by further GRAB commands with the same parameters
+
+class cGrabCache {
+private:
+  cMutex mutex;
+  uchar *image;
+  int imageSize;
+  bool jpeg;
+  int quality;
+  int sizeX;
+  int sizeY;
+  int channel;
+  cTimeMs timeout;
+  cDynamicBuffer *base64;
+  void Clear(void);
+public:
+  cGrabCache(void);
+  ~cGrabCache();
+  void Lock(void) { mutex.Lock(); }
+  void Unlock(void) { mutex.Unlock(); }
+  const uchar *Image(int &Size, bool Jpeg, int Quality, int SizeX, int SizeY);
+       ///< Returns the current frame of the primary device, grabbed with the given
+       ///< parameters (see cDevice::GrabImage()), or NULL if grabbing failed.
+       ///< If the same image has been requested less than GRABCACHETIME ms ago,
+       ///< and the channel hasn't been switched since, no new image is grabbed.
+       ///< The cache must be locked as long as the result is used.
+  const uchar *Base64(int &Size);
+       ///< Returns the image most recently returned by Image() in base 64 encoding,
+       ///< as a sequence of "216-" reply lines.
+  };
+
+static cGrabCache GrabCache;
+
+cGrabCache::cGrabCache(void)
+{
+  image = NULL;
+  imageSize = 0;
+  jpeg = true;
+  quality = sizeX = sizeY = -1;
+  channel = 0;
+  base64 = NULL;
+}
+
+cGrabCache::~cGrabCache()
+{
+  Clear();
+}
+
+void cGrabCache::Clear(void)
+{
+  free(image);
+  image = NULL;
+  imageSize = 0;
+  DELETENULL(base64);
+}
+
+const uchar *cGrabCache::Image(int &Size, bool Jpeg, int Quality, int SizeX, int SizeY)
+{
+  int Channel = cDevice::CurrentChannel();
+  if (!image || timeout.TimedOut() || Jpeg != jpeg || Quality != quality || SizeX != sizeX || SizeY != sizeY || Channel != channel) {
+     Clear();
+     image = cDevice::PrimaryDevice()->GrabImage(imageSize, Jpeg, Quality, SizeX, SizeY);
+     if (!image)
+        return NULL;
+     jpeg = Jpeg;
+     quality = Quality;
+     sizeX = SizeX;
+     sizeY = SizeY;
+     channel = Channel;
+     timeout.Set(GRABCACHETIME);
+     }
+  Size = imageSize;
+  return image;
+}
+
+const uchar *cGrabCache::Base64(int &Size)
+{
+  if (!base64) {
+     base64 = new cDynamicBuffer((imageSize + 2) / 3 * 4 / 64 * 70 + 70);
+     cBase64Encoder Base64(image, imageSize);
+     while (const char *l = Base64.NextLine()) {
+           base64->Append((const uchar *)"216-", 4);
+           base64->Append((const uchar *)l, strlen(l));
+           base64->Append((const uchar *)"\r\n", 2);
+           }
+     }
+  Size = base64->Length();
+  return base64->Data();
+}
+
+// --- cSVDRPTimersLock ------------------------------------------------------
+
+class cSVDRPTimersLock {
+private:
+  cStateKey stateKey;
+  cTimers *timers;
+  bool locked;
+public:
+  cSVDRPTimersLock(cTimers *BatchTimers, bool ExplicitModify = false);
+       ///< Obtains a write lock on the timers, unless BatchTimers is given, in
+       ///< which case the lock is already held by the batch that is being committed.
+       ///< If ExplicitModify is true, SetExplicitModify() is called on the timers
+       ///< when the lock is obtained here.
+  ~cSVDRPTimersLock();
+  cTimers *Timers(void) { return timers; }
+  };
+
+cSVDRPTimersLock::cSVDRPTimersLock(cTimers *BatchTimers, bool ExplicitModify)
+{
+  timers = BatchTimers;
+  locked = !timers;
+  if (locked) {
+     timers = cTimers::GetTimersWrite(stateKey);
+     if (ExplicitModify)
+        timers->SetExplicitModify();
+     }
+}
+
+cSVDRPTimersLock::~cSVDRPTimersLock()
+{
+  if (locked)
+     stateKey.Remove();
+}
+
+#define LOCK_SVDRP_TIMERS_WRITE(ExplicitModify) \
+cSVDRPTimersLock Timers_Lock(batchTimers, ExplicitModify); \
+cTimers *Timers = Timers_Lock.Timers();
+
+class cSVDRPServer;
+
+class cSVDRPServerTask : public cTask {
+private:
+  cSVDRPServer *server;
+protected:
+  virtual void Action(void) override;
+public:
+  cSVDRPServerTask(cSVDRPServer *Server) { server = Server; }
+  };
+
 class cSVDRPServer {
+  friend class cSVDRPServerTask;
 private:
   int socket;
   cIpAddress clientIpAddress;
@@ -1096,13 +1377,42 @@ private:
   int length;
   char *cmdLine;
   time_t lastActivity;
+  cMutex mutex; // protects the following members, which are also accessed by the task
+  cDynamicBuffer *output; // data that could not be written to the socket without blocking
+  int outputSent;
+  cStringList commands; // commands that have been received, but not yet executed
+  bool closeRequested;
+  cSVDRPServerTask task; // executes the commands, so that a long running one doesn't hold up other connections
+  cStringList *batch; // commands collected between BEGN and COMT
+  cStringList *sentTimers; // the timers as last sent in reply to 'LSTT SINCE'
+  int timersState; // the state of sentTimers
+#ifdef ZLIB
+  z_stream *deflater; // compresses all output after a COMP command
+#endif
+  cTimers *batchTimers; // the timers, while a batch is being committed
+  bool ExecuteCommand(void);
+       ///< Executes the next command that has been received and returns true, or
+       ///< returns false if there is none.
   void Close(bool SendReply = false, bool Timeout = false);
-  bool Send(const char *s);
+  bool Send(const char *s, bool Sync = true);
+  bool Send(const char *Data, int Length, bool Sync = true);
+       ///< Sends the given Data to the client. If output is compressed, Sync
+       ///< tells whether the compressed data shall be flushed, so that the client
+       ///< can decompress everything sent so far.
+  bool Write(const char *Data, int Length);
+  bool Flush(void);
+  bool OutputPending(void);
   void Reply(int Code, const char *fmt, ...) __attribute__ ((format (printf, 3, 4)));
   void PrintHelpTopics(const char **hp);
+  void ListTimerChanges(int State, bool UseChannelId);
+  void CmdABRT(const char *Option);
   void CmdAUDI(const char *Option);
+  void CmdBEGN(const char *Option);
   void CmdCHAN(const char *Option);
+  void CmdCHKT(const char *Option);
   void CmdCLRE(const char *Option);
+  void CmdCOMP(const char *Option);
+  void CmdCOMT(const char *Option);
   void CmdCONN(const char *Option);
   void CmdDELC(const char *Option);
   void CmdDELR(const char *Option);
@@ -1130,8 +1440,10 @@ private:
   void CmdPOLL(const char *Option);
   void CmdPRIM(const char *Option);
   void CmdPUTE(const char *Option);
+  void CmdQUIT(const char *Option);
   void CmdREMO(const char *Option);
   void CmdSCAN(const char *Option);
+  void CmdSRCE(const char *Option);
   void CmdSTAT(const char *Option);
   void CmdUPDT(const char *Option);
   void CmdUPDR(const char *Option);
@@ -1142,12 +1454,22 @@ public:
   ~cSVDRPServer();
   const char *ClientName(void) const { return clientName; }
   bool HasConnection(void) { return file.IsOpen(); }
+  bool Busy(void);
+       ///< Returns true if there are commands waiting to be executed.
   bool Process(void);
   };
 
 static cPoller SVDRPServerPoller;
+static cWakeup SVDRPServerWakeup; // wakes up the server handler when a task has produced output or finished a command
+
+void cSVDRPServerTask::Action(void)
+{
+  while (Running() && server->ExecuteCommand())
+        ;
+}
 
 cSVDRPServer::cSVDRPServer(int Socket, const cIpAddress *ClientIpAddress)
+:task(this)
 {
   socket = Socket;
   clientIpAddress = *ClientIpAddress;
@@ -1157,6 +1479,20 @@ cSVDRPServer::cSVDRPServer(int Socket, const cIpAddress *ClientIpAddress)
   length = BUFSIZ;
   cmdLine = MALLOC(char, length);
   lastActivity = time(NULL);
+  output = NULL;
+  outputSent = 0;
+  closeRequested = false;
+  batch = NULL;
+  batchTimers = NULL;
+  sentTimers = NULL;
+  timersState = 0;
+#ifdef ZLIB
+  deflater = NULL;
+#endif
+  // make it non-blocking, so that a slow client doesn't hold up the server:
+  int Flags = fcntl(socket, F_GETFL, 0);
+  if (Flags < 0 || fcntl(socket, F_SETFL, Flags | O_NONBLOCK) < 0)
+     LOG_ERROR;
   if (file.Open(socket)) {
      time_t now = time(NULL);
      Reply(220, "%s SVDRP VideoDiskRecorder %s; %s; %s", Setup.SVDRPHostName, VDRVERSION, *TimeToString(now), cCharSetConv::SystemCharacterTable() ? cCharSetConv::SystemCharacterTable() : "UTF-8");
@@ -1169,34 +1505,161 @@ cSVDRPServer::~cSVDRPServer()
 {
   Close(true);
   free(cmdLine);
+  delete output;
   dsyslog("SVDRP %s < %s server destroyed", Setup.SVDRPHostName, *clientName);
 }
 
 void cSVDRPServer::Close(bool SendReply, bool Timeout)
 {
+  task.Cancel(true);
   if (file.IsOpen()) {
      if (SendReply) {
         Reply(221, "%s closing connection%s", Setup.SVDRPHostName, Timeout ? " (timeout)" : "");
         }
+     // give any pending output a chance to get through:
+     while (output && cPoller(file, true).Poll(SVDRPFlushTimeout)) {
+           if (!Flush())
+              break;
+           }
      isyslog("SVDRP %s < %s connection closed", Setup.SVDRPHostName, *clientName);
      SVDRPServerPoller.Del(file, false);
+     SVDRPServerPoller.Del(file, true);
      file.Close();
      DELETENULL(PUTEhandler);
      }
+  DELETENULL(output);
+  commands.Clear();
+  DELETENULL(batch);
+  DELETENULL(sentTimers);
+#ifdef ZLIB
+  if (deflater) {
+     deflateEnd(deflater);
+     DELETENULL(deflater);
+     }
+#endif
   close(socket);
 }
 
-bool cSVDRPServer::Send(const char *s)
+bool cSVDRPServer::Send(const char *s, bool Sync)
 {
   dbgsvdrp("> S %s: %s", *clientName, s); // terminating newline is already in the string!
-  if (safe_write(file, s, strlen(s)) < 0) {
-     LOG_ERROR;
-     Close();
+  return Send(s, strlen(s), Sync);
+}
+
+bool cSVDRPServer::Send(const char *Data, int Length, bool Sync)
+{
+#ifdef ZLIB
+  if (deflater) {
+     cMutexLock MutexLock(&mutex);
+     uchar Buffer[KILOBYTE(16)];
+     deflater->next_in = (Bytef *)Data;
+     deflater->avail_in = Length;
+     do {
+        deflater->next_out = Buffer;
+        deflater->avail_out = sizeof(Buffer);
+        if (deflate(deflater, Sync ? Z_SYNC_FLUSH : Z_NO_FLUSH) == Z_STREAM_ERROR) {
+           esyslog("SVDRP %s < %s ERROR: compression failed", Setup.SVDRPHostName, *clientName);
+           closeRequested = true;
+           SVDRPServerWakeup.Signal();
+           return false;
+           }
+        int n = sizeof(Buffer) - deflater->avail_out;
+        if (n > 0 && !Write((const char *)Buffer, n))
+           return false;
+        } while (deflater->avail_out == 0);
+     return true;
+     }
+#endif
+  return Write(Data, Length);
+}
+
+bool cSVDRPServer::Write(const char *Data, int Length)
+{
+  cMutexLock MutexLock(&mutex);
+  if (!file.IsOpen() || closeRequested)
      return false;
+  if (!output) {
+     // nothing is pending, so we can try to write directly:
+     while (Length > 0) {
+           int w = write(file, Data, Length);
+           if (w < 0) {
+              if (errno == EINTR)
+                 continue;
+              if (errno == EAGAIN)
+                 break;
+              LOG_ERROR;
+              closeRequested = true; // the connection is closed by the server handler
+              SVDRPServerWakeup.Signal();
+              return false;
+              }
+           Data += w;
+           Length -= w;
+           }
+     if (Length == 0)
+        return true;
+     output = new cDynamicBuffer(Length);
+     outputSent = 0;
+     SVDRPServerWakeup.Signal(); // so that the server handler waits until it can write the rest
      }
+  output->Append((const uchar *)Data, Length);
   return true;
 }
 
+bool cSVDRPServer::Flush(void)
+{
+  cMutexLock MutexLock(&mutex);
+  while (output) {
+        int w = write(file, output->Data() + outputSent, output->Length() - outputSent);
+        if (w < 0) {
+           if (errno == EINTR)
+              continue;
+           if (errno == EAGAIN)
+              break;
+           LOG_ERROR;
+           DELETENULL(output);
+           closeRequested = true;
+           return false;
+           }
+        outputSent += w;
+        lastActivity = time(NULL);
+        if (outputSent >= output->Length())
+           DELETENULL(output);
+        }
+  return true;
+}
+
+bool cSVDRPServer::ExecuteCommand(void)
+{
+  mutex.Lock();
+  char *Cmd = NULL;
+  if (commands.Size() && !closeRequested) {
+     Cmd = commands[0];
+     commands.Remove(0);
+     }
+  mutex.Unlock();
+  if (!Cmd)
+     return false;
+  Execute(Cmd);
+  free(Cmd);
+  mutex.Lock();
+  lastActivity = time(NULL);
+  mutex.Unlock();
+  SVDRPServerWakeup.Signal();
+  return true;
+}
+
+bool cSVDRPServer::OutputPending(void)
+{
+  cMutexLock MutexLock(&mutex);
+  return output != NULL;
+}
+
+bool cSVDRPServer::Busy(void)
+{
+  cMutexLock MutexLock(&mutex);
+  return commands.Size() > 0;
+}
+
 void cSVDRPServer::Reply(int Code, const char *fmt, ...)
 {
   if (file.IsOpen()) {
@@ -1213,7 +1676,7 @@ void cSVDRPServer::Reply(int Code, const char *fmt, ...)
                  char cont = ' ';
                  if (Code < 0 || n && *(n + 1)) // trailing newlines don't count!
                     cont = '-';
-                 if (!Send(cString::sprintf("%03d%c%s\r\n", abs(Code), cont, s)))
+                 if (!Send(cString::sprintf("%03d%c%s\r\n", abs(Code), cont, s), cont == ' '))
                     break;
                  s = n ? n + 1 : NULL;
                  }
@@ -1258,6 +1721,17 @@ void cSVDRPServer::PrintHelpTopics(const char **hp)
       }
 }
 
+void cSVDRPServer::CmdABRT(const char *Option)
+{
+  if (batch) {
+     int n = batch->Size();
+     DELETENULL(batch);
+     Reply(250, "Batch of %d command%s aborted", n, n == 1 ? "" : "s");
+     }
+  else
+     Reply(550, "No batch has been started");
+}
+
 void cSVDRPServer::CmdAUDI(const char *Option)
 {
   if (*Option) {
@@ -1297,6 +1771,16 @@ void cSVDRPServer::CmdAUDI(const char *Option)
      }
 }
 
+void cSVDRPServer::CmdBEGN(const char *Option)
+{
+  if (!batch) {
+     batch = new cStringList;
+     Reply(250, "Batch started");
+     }
+  else
+     Reply(550, "Batch has already been started");
+}
+
 void cSVDRPServer::CmdCHAN(const char *Option)
 {
   LOCK_CHANNELS_READ;
@@ -1359,6 +1843,26 @@ void cSVDRPServer::CmdCHAN(const char *Option)
      Reply(550, "Unable to find channel \"%d\"", cDevice::CurrentChannel());
 }
 
+void cSVDRPServer::CmdCHKT(const char *Option)
+{
+  int Days = TIMERCONFLICTDAYS;
+  if (*Option) {
+     if (!isnumber(Option) || (Days = strtol(Option, NULL, 10)) <= 0) {
+        Reply(501, "Invalid number of days \"%s\"", Option);
+        return;
+        }
+     }
+  static cTimerConflicts TimerConflicts; // keeps the result in case nothing has changed
+  LOCK_TIMERS_READ;
+  LOCK_CHANNELS_READ;
+  if (TimerConflicts.Check(Timers, Days)) {
+     for (const cTimerConflict *tc = TimerConflicts.First(); tc; tc = TimerConflicts.Next(tc))
+         Reply(TimerConflicts.Next(tc) ? -250 : 250, "%d %lld %lld %lld", tc->TimerId(), (long long)tc->Start(), (long long)tc->Stop(), (long long)tc->ConflictStart());
+     }
+  else
+     Reply(250, "No timer conflicts");
+}
+
 void cSVDRPServer::CmdCLRE(const char *Option)
 {
   if (*Option) {
@@ -1424,6 +1928,70 @@ void cSVDRPServer::CmdCLRE(const char *Option)
      }
 }
 
+void cSVDRPServer::CmdCOMP(const char *Option)
+{
+#ifdef ZLIB
+  if (!*Option)
+     Reply(250, "deflate");
+  else if (strcasecmp(Option, "DEFLATE") == 0) {
+     if (!deflater) {
+        z_stream *z = new z_stream;
+        memset(z, 0, sizeof(*z));
+        if (deflateInit2(z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+           Reply(250, "Compression enabled"); // this is the last reply sent uncompressed
+           deflater = z;
+           }
+        else {
+           delete z;
+           Reply(451, "Can't initialize compression");
+           }
+        }
+     else
+        Reply(550, "Compression is already enabled");
+     }
+  else
+     Reply(501, "Unknown compression method: \"%s\"", Option);
+#else
+  Reply(550, "Compression not supported");
+#endif
+}
+
+static bool IsBatchCommand(const char *Line)
+{
+  static const char *BatchCommands[] = { "CHKT", "DELT", "LSTT", "MODT", "NEWT", "NEXT", "UPDT", NULL };
+  Line = skipspace(Line);
+  for (const char **c = BatchCommands; *c; c++) {
+      if (strncasecmp(Line, *c, 4) == 0 && (!Line[4] || isspace(Line[4])))
+         return true;
+      }
+  return false;
+}
+
+void cSVDRPServer::CmdCOMT(const char *Option)
+{
+  if (batch) {
+     cStringList *Batch = batch;
+     batch = NULL;
+     int n = Batch->Size();
+     cStateKey StateKey;
+     batchTimers = cTimers::GetTimersWrite(StateKey);
+     for (int i = 0; i < n; i++) {
+         char *Line = (*Batch)[i];
+         if (IsBatchCommand(Line))
+            Execute(Line);
+         else
+            Reply(550, "Command not allowed in a batch: \"%s\"", skipspace(Line));
+         }
+     batchTimers = NULL;
+     StateKey.Remove();
+     delete Batch;
+     isyslog("SVDRP %s < %s committed batch of %d command%s", Setup.SVDRPHostName, *clientName, n, n == 1 ? "" : "s");
+     Reply(250, "Batch of %d command%s committed", n, n == 1 ? "" : "s");
+     }
+  else
+     Reply(550, "No batch has been started");
+}
+
 void cSVDRPServer::CmdCONN(const char *Option)
 {
   if (*Option) {
@@ -1545,8 +2113,7 @@ void cSVDRPServer::CmdDELT(const char *Option)
 {
   if (*Option) {
      if (isnumber(Option)) {
-        LOCK_TIMERS_WRITE;
-        Timers->SetExplicitModify();
+        LOCK_SVDRP_TIMERS_WRITE(true);
         if (cTimer *Timer = Timers->GetById(strtol(Option, NULL, 10))) {
            if (Timer->Recording()) {
               Timer->Skip();
@@ -1600,12 +2167,21 @@ void cSVDRPServer::CmdGRAB(const char *Option)
 {
   const char *FileName = NULL;
   bool Jpeg = true;
+  bool Binary = false;
   int Quality = -1, SizeX = -1, SizeY = -1;
   if (*Option) {
      char buf[strlen(Option) + 1];
      char *p = strcpy(buf, Option);
      const char *delim = " \t";
      char *strtok_next;
+     // binary transfer:
+     char *b = p + strlen(p);
+     while (b > p && isspace(*(b - 1)))
+           b--;
+     if (b - p > 6 && strncasecmp(b - 6, "BINARY", 6) == 0 && isspace(*(b - 7))) {
+        Binary = true;
+        *(b - 7) = 0;
+        }
      FileName = strtok_r(p, delim, &strtok_next);
      // image type:
      const char *Extension = strrchr(FileName, '.');
@@ -1696,9 +2272,9 @@ void cSVDRPServer::CmdGRAB(const char *Option)
            }
         }
      // actual grabbing:
+     GrabCache.Lock();
      int ImageSize;
-     uchar *Image = cDevice::PrimaryDevice()->GrabImage(ImageSize, Jpeg, Quality, SizeX, SizeY);
-     if (Image) {
+     if (const uchar *Image = GrabCache.Image(ImageSize, Jpeg, Quality, SizeX, SizeY)) {
         if (FileName) {
            int fd = open(FileName, O_WRONLY | O_CREAT | O_NOFOLLOW | O_TRUNC, DEFFILEMODE);
            if (fd >= 0) {
@@ -1717,17 +2293,21 @@ void cSVDRPServer::CmdGRAB(const char *Option)
               Reply(451, "Can't open '%s'", FileName);
               }
            }
+        else if (Binary) {
+           Reply(-216, "%d bytes of image data follow", ImageSize);
+           Send((const char *)Image, ImageSize, false);
+           Reply(216, "Grabbed image %s", Option);
+           }
         else {
-           cBase64Encoder Base64(Image, ImageSize);
-           const char *s;
-           while ((s = Base64.NextLine()) != NULL)
-                 Reply(-216, "%s", s);
+           int Size;
+           const uchar *Data = GrabCache.Base64(Size);
+           Send((const char *)Data, Size, false);
            Reply(216, "Grabbed image %s", Option);
            }
-        free(Image);
         }
      else
         Reply(451, "Grab image failed");
+     GrabCache.Unlock();
      }
   else
      Reply(501, "Missing filename");
@@ -1802,7 +2382,7 @@ void cSVDRPServer::CmdHITK(const char *Option)
 
 void cSVDRPServer::CmdLSTC(const char *Option)
 {
-  LOCK_CHANNELS_READ;
+  USE_CHANNELS_SNAPSHOT; // the reply may take a while, so we don't hold the channels lock
   bool WithChannelIds = startswith(Option, ":ids") && (Option[4] == ' ' || Option[4] == 0);
   if (WithChannelIds)
      Option = skipspace(Option + 4);
@@ -1860,83 +2440,127 @@ void cSVDRPServer::CmdLSTD(const char *Option)
      Reply(550, "No devices found");
 }
 
+static bool ParseTime(const char *s, time_t &Time)
+{
+  if (s && isnumber(s)) {
+     Time = strtol(s, NULL, 10);
+     return true;
+     }
+  return false;
+}
+
 void cSVDRPServer::CmdLSTE(const char *Option)
 {
-  LOCK_CHANNELS_READ;
-  LOCK_SCHEDULES_READ;
-  const cSchedule* Schedule = NULL;
-  eDumpMode DumpMode = dmAll;
-  time_t AtTime = 0;
-  if (*Option) {
-     char buf[strlen(Option) + 1];
-     strcpy(buf, Option);
-     const char *delim = " \t";
-     char *strtok_next;
-     char *p = strtok_r(buf, delim, &strtok_next);
-     while (p && DumpMode == dmAll) {
-           if (strcasecmp(p, "NOW") == 0)
-              DumpMode = dmPresent;
-           else if (strcasecmp(p, "NEXT") == 0)
-              DumpMode = dmFollowing;
-           else if (strcasecmp(p, "AT") == 0) {
-              DumpMode = dmAtTime;
-              if ((p = strtok_r(NULL, delim, &strtok_next)) != NULL) {
-                 if (isnumber(p))
-                    AtTime = strtol(p, NULL, 10);
-                 else {
-                    Reply(501, "Invalid time");
-                    return;
-                    }
-                 }
-              else {
-                 Reply(501, "Missing time");
-                 return;
-                 }
-              }
-           else if (!Schedule) {
-              const cChannel* Channel = NULL;
-              if (isnumber(p))
-                 Channel = Channels->GetByNumber(strtol(Option, NULL, 10));
-              else
-                 Channel = Channels->GetByChannelID(tChannelID::FromString(Option));
-              if (Channel) {
-                 Schedule = Schedules->GetSchedule(Channel);
-                 if (!Schedule) {
-                    Reply(550, "No schedule found");
-                    return;
+  char *Data = NULL;
+  size_t Size = 0;
+  int State = 0;
+  bool Since = false;
+  {
+    LOCK_CHANNELS_READ;
+    LOCK_SCHEDULES_READ;
+    cVector<const cSchedule *> SelectedSchedules;
+    bool ChannelsGiven = false;
+    eDumpMode DumpMode = dmAll;
+    time_t AtTime = 0;
+    time_t EndTime = std::numeric_limits<time_t>::max();
+    if (*Option) {
+       char buf[strlen(Option) + 1];
+       strcpy(buf, Option);
+       const char *delim = " \t";
+       char *strtok_next;
+       char *p = strtok_r(buf, delim, &strtok_next);
+       while (p) {
+             if (strcasecmp(p, "NOW") == 0 && DumpMode == dmAll)
+                DumpMode = dmPresent;
+             else if (strcasecmp(p, "NEXT") == 0 && DumpMode == dmAll)
+                DumpMode = dmFollowing;
+             else if (strcasecmp(p, "AT") == 0 && DumpMode == dmAll) {
+                DumpMode = dmAtTime;
+                if ((p = strtok_r(NULL, delim, &strtok_next)) == NULL) {
+                   Reply(501, "Missing time");
+                   return;
+                   }
+                if (!ParseTime(p, AtTime)) {
+                   Reply(501, "Invalid time");
+                   return;
+                   }
+                }
+             else if ((strcasecmp(p, "FROM") == 0 || strcasecmp(p, "TO") == 0) && (DumpMode == dmAll || DumpMode == dmBetween)) {
+                DumpMode = dmBetween;
+                bool From = strcasecmp(p, "FROM") == 0;
+                if ((p = strtok_r(NULL, delim, &strtok_next)) == NULL) {
+                   Reply(501, "Missing time");
+                   return;
+                   }
+                if (!ParseTime(p, From ? AtTime : EndTime)) {
+                   Reply(501, "Invalid time");
+                   return;
+                   }
+                }
+             else if (strcasecmp(p, "SINCE") == 0 && !Since) {
+                Since = true;
+                if ((p = strtok_r(NULL, delim, &strtok_next)) == NULL || !isnumber(p)) {
+                   Reply(501, "Missing or invalid state");
+                   return;
+                   }
+                State = strtol(p, NULL, 10);
+                if (State > cSchedule::LastModified())
+                   State = 0; // VDR has been restarted since the client got this state
+                }
+             else if (!ChannelsGiven) {
+                ChannelsGiven = true;
+                char *channel_next;
+                for (char *c = strtok_r(p, ",", &channel_next); c; c = strtok_r(NULL, ",", &channel_next)) {
+                    const cChannel* Channel = NULL;
+                    if (isnumber(c))
+                       Channel = Channels->GetByNumber(strtol(c, NULL, 10));
+                    else
+                       Channel = Channels->GetByChannelID(tChannelID::FromString(c));
+                    if (!Channel) {
+                       Reply(550, "Channel \"%s\" not defined", c);
+                       return;
+                       }
+                    if (const cSchedule *Schedule = Schedules->GetSchedule(Channel))
+                       SelectedSchedules.Append(Schedule);
                     }
-                 }
-              else {
-                 Reply(550, "Channel \"%s\" not defined", p);
-                 return;
-                 }
-              }
-           else {
-              Reply(501, "Unknown option: \"%s\"", p);
-              return;
-              }
-           p = strtok_r(NULL, delim, &strtok_next);
-           }
-     }
-  int fd = dup(file);
-  if (fd) {
-     FILE *f = fdopen(fd, "w");
-     if (f) {
-        if (Schedule)
-           Schedule->Dump(Channels, f, "215-", DumpMode, AtTime);
-        else
-           Schedules->Dump(f, "215-", DumpMode, AtTime);
-        fflush(f);
+                if (!SelectedSchedules.Size()) {
+                   Reply(550, "No schedule found");
+                   return;
+                   }
+                }
+             else {
+                Reply(501, "Unknown option: \"%s\"", p);
+                return;
+                }
+             p = strtok_r(NULL, delim, &strtok_next);
+             }
+       }
+    if (!ChannelsGiven) {
+       for (const cSchedule *Schedule = Schedules->First(); Schedule; Schedule = Schedules->Next(Schedule))
+           SelectedSchedules.Append(Schedule);
+       }
+    // The data is dumped into memory and sent after releasing the locks, so that a slow
+    // client doesn't keep others from modifying the schedules:
+    FILE *f = open_memstream(&Data, &Size);
+    if (!f) {
+       Reply(451, "Can't open memory stream");
+       return;
+       }
+    for (int i = 0; i < SelectedSchedules.Size(); i++) {
+        if (!Since || SelectedSchedules[i]->ModifiedSince(State))
+           SelectedSchedules[i]->Dump(Channels, f, "215-", DumpMode, AtTime, EndTime);
+        }
+    fclose(f);
+    State = cSchedule::LastModified();
+  }
+  bool Ok = Send(Data, Size, false);
+  free(Data);
+  if (Ok) {
+     if (Since)
+        Reply(215, "End of EPG data; state %d", State);
+     else
         Reply(215, "End of EPG data");
-        fclose(f);
-        }
-     else {
-        Reply(451, "Can't open file connection");
-        close(fd);
-        }
      }
-  else
-     Reply(451, "Can't dup stream descriptor");
 }
 
 void cSVDRPServer::CmdLSTR(const char *Option)
@@ -1998,9 +2622,56 @@ void cSVDRPServer::CmdLSTR(const char *Option)
      Reply(550, "No recordings available");
 }
 
+void cSVDRPServer::ListTimerChanges(int State, bool UseChannelId)
+{
+  cStringList *Current = new cStringList;
+  {
+    LOCK_TIMERS_READ;
+    for (const cTimer *Timer = Timers->First(); Timer; Timer = Timers->Next(Timer)) {
+        if (!Timer->Remote())
+           Current->Append(strdup(cString::sprintf("%d %s", Timer->Id(), *Timer->ToText(UseChannelId))));
+        }
+  }
+  Current->SortNumerically();
+  // Only the differences to what has been sent before are listed, unless the
+  // client doesn't know the state of that data:
+  cStringList *Sent = (sentTimers && State == timersState) ? sentTimers : NULL;
+  int il = 0;
+  int ir = 0;
+  int Changes = 0;
+  while (ir < Current->Size() || Sent && il < Sent->Size()) {
+        int nl = (Sent && il < Sent->Size()) ? atoi((*Sent)[il]) : INT_MAX;
+        int nr = (ir < Current->Size()) ? atoi((*Current)[ir]) : INT_MAX;
+        if (nl < nr) {
+           Reply(-250, "%d", nl); // deleted
+           il++;
+           Changes++;
+           }
+        else if (nr < nl) {
+           Reply(-250, "%s", (*Current)[ir]); // new
+           ir++;
+           Changes++;
+           }
+        else {
+           if (strcmp((*Sent)[il], (*Current)[ir]) != 0) {
+              Reply(-250, "%s", (*Current)[ir]); // modified
+              Changes++;
+              }
+           il++;
+           ir++;
+           }
+        }
+  if (!Sent || Changes)
+     timersState++;
+  delete sentTimers;
+  sentTimers = Current;
+  Reply(250, "State %d %s", timersState, Sent ? "delta" : "full");
+}
+
 void cSVDRPServer::CmdLSTT(const char *Option)
 {
   int Id = 0;
+  int Since = -1;
   bool UseChannelId = false;
   if (*Option) {
      char buf[strlen(Option) + 1];
@@ -2013,6 +2684,15 @@ void cSVDRPServer::CmdLSTT(const char *Option)
               Id = strtol(p, NULL, 10);
            else if (strcasecmp(p, "ID") == 0)
               UseChannelId = true;
+           else if (strcasecmp(p, "SINCE") == 0) {
+              p = strtok_r(NULL, delim, &strtok_next);
+              if (p && isnumber(p))
+                 Since = strtol(p, NULL, 10);
+              else {
+                 Reply(501, "Missing state after \"since\"");
+                 return;
+                 }
+              }
            else {
               Reply(501, "Unknown option: \"%s\"", p);
               return;
@@ -2020,6 +2700,13 @@ void cSVDRPServer::CmdLSTT(const char *Option)
            p = strtok_r(NULL, delim, &strtok_next);
            }
      }
+  if (Since >= 0) {
+     if (Id)
+        Reply(501, "Option \"since\" can't be used with a timer id");
+     else
+        ListTimerChanges(Since, UseChannelId);
+     return;
+     }
   LOCK_TIMERS_READ;
   if (Id) {
      for (const cTimer *Timer = Timers->First(); Timer; Timer = Timers->Next(Timer)) {
@@ -2108,8 +2795,7 @@ void cSVDRPServer::CmdMODT(const char *Option)
      int Id = strtol(Option, &tail, 10);
      if (tail && tail != Option) {
         tail = skipspace(tail);
-        LOCK_TIMERS_WRITE;
-        Timers->SetExplicitModify();
+        LOCK_SVDRP_TIMERS_WRITE(true);
         if (cTimer *Timer = Timers->GetById(Id)) {
            bool IsRecording = Timer->HasFlags(tfRecording);
            cTimer t = *Timer;
@@ -2278,7 +2964,7 @@ void cSVDRPServer::CmdNEWT(const char *Option)
   if (*Option) {
      cTimer *Timer = new cTimer;
      if (Timer->Parse(Option)) {
-        LOCK_TIMERS_WRITE;
+        LOCK_SVDRP_TIMERS_WRITE(false);
         const cTimer *t = Timers->GetTimer(Timer);
         if (!t || t->IsPatternTimer() || Timer->IsPatternTimer()) {
            Timer->ClrFlags(tfRecording);
@@ -2351,8 +3037,18 @@ void cSVDRPServer::CmdPLAY(const char *Option)
               cControl::Shutdown();
               if (*option) {
                  int pos = 0;
-                 if (strcasecmp(option, "BEGIN") != 0)
+                 if (strcasecmp(option, "BEGIN") != 0) {
                     pos = HMSFToIndex(option, FramesPerSecond);
+                    // Use the recording's time index (if it has one) for the full seconds:
+                    int Seconds = FramesPerSecond > 0 ? pos / FramesPerSecond : 0;
+                    cIndexFile Index(FileName, false, IsPesRecording);
+                    if (Index.Ok()) {
+                       cTimeIndexFile TimeIndex(FileName, &Index, IsPesRecording, false);
+                       int i = TimeIndex.GetIndex(Seconds);
+                       if (i >= 0)
+                          pos = i + pos - SecondsToFrames(Seconds, FramesPerSecond);
+                       }
+                    }
                  cResumeFile Resume(FileName, IsPesRecording);
                  if (pos <= 0)
                     Resume.Delete();
@@ -2535,6 +3231,13 @@ void cSVDRPServer::CmdPUTE(const char *Option)
      }
 }
 
+void cSVDRPServer::CmdQUIT(const char *Option)
+{
+  Reply(221, "%s closing connection", Setup.SVDRPHostName);
+  cMutexLock MutexLock(&mutex);
+  closeRequested = true; // the connection is closed by the server handler, once the reply has been sent
+}
+
 void cSVDRPServer::CmdREMO(const char *Option)
 {
   if (*Option) {
@@ -2559,6 +3262,50 @@ void cSVDRPServer::CmdSCAN(const char *Option)
   Reply(250, "EPG scan triggered");
 }
 
+void cSVDRPServer::CmdSRCE(const char *Option)
+{
+  if (!*Option) {
+     Reply(501, "Missing search text");
+     return;
+     }
+  LOCK_CHANNELS_READ;
+  LOCK_SCHEDULES_READ;
+  cVector<const cEvent *> Events;
+  Schedules->Search(Option, Events);
+  if (!Events.Size()) {
+     Reply(550, "No matching events found");
+     return;
+     }
+  int fd = dup(file);
+  if (fd) {
+     FILE *f = fdopen(fd, "w");
+     if (f) {
+        const cSchedule *Schedule = NULL;
+        for (int i = 0; i < Events.Size(); i++) {
+            const cEvent *Event = Events[i];
+            if (Event->Schedule() != Schedule) {
+               if (Schedule)
+                  fprintf(f, "215-c\n");
+               Schedule = Event->Schedule();
+               const cChannel *Channel = Channels->GetByChannelID(Schedule->ChannelID(), true);
+               fprintf(f, "215-C %s %s\n", *Schedule->ChannelID().ToString(), Channel ? Channel->Name() : "");
+               }
+            Event->Dump(f, "215-");
+            }
+        fprintf(f, "215-c\n");
+        fflush(f);
+        Reply(215, "End of EPG data");
+        fclose(f);
+        }
+     else {
+        Reply(451, "Can't open file connection");
+        close(fd);
+        }
+     }
+  else
+     Reply(451, "Can't dup stream descriptor");
+}
+
 void cSVDRPServer::CmdSTAT(const char *Option)
 {
   if (*Option) {
@@ -2567,6 +3314,77 @@ void cSVDRPServer::CmdSTAT(const char *Option)
         int Percent = cVideoDirectory::VideoDiskSpace(&FreeMB, &UsedMB);
         Reply(250, "%dMB %dMB %d%%", FreeMB + UsedMB, FreeMB, Percent);
         }
+     else if (strcasecmp(Option, "STARTUP") == 0) {
+        cStringList Lines;
+        cStartupTimes::Report(Lines);
+        if (Lines.Size()) {
+           for (int i = 0; i < Lines.Size(); i++)
+               Reply(i < Lines.Size() - 1 ? -250 : 250, "%s", Lines[i]);
+           }
+        else
+           Reply(550, "No startup times recorded");
+        }
+     else if (strcasecmp(Option, "PLUGINS") == 0) {
+        cStringList Lines;
+        cPluginManager::GetStatistics(Lines);
+        if (Lines.Size()) {
+           for (int i = 0; i < Lines.Size(); i++)
+               Reply(i < Lines.Size() - 1 ? -250 : 250, "%s", Lines[i]);
+           }
+        else
+           Reply(550, "No plugins loaded");
+        }
+     else if (strcasecmp(Option, "THREADS") == 0) {
+        cStringList Lines;
+        cThreadStatistics::Report(Lines);
+        if (Lines.Size()) {
+           for (int i = 0; i < Lines.Size(); i++)
+               Reply(i < Lines.Size() - 1 ? -250 : 250, "%s", Lines[i]);
+           }
+        else
+           Reply(550, "No thread statistics available");
+        }
+     else if (strcasecmp(Option, "BUFFERS") == 0) {
+        cStringList Lines;
+        cRingBuffer::GetStatistics(Lines);
+        if (Lines.Size()) {
+           for (int i = 0; i < Lines.Size(); i++)
+               Reply(i < Lines.Size() - 1 ? -250 : 250, "%s", Lines[i]);
+           }
+        else
+           Reply(550, "No ring buffers in use");
+        }
+     else if (strcasecmp(Option, "MEMORY") == 0) {
+        cStringList Lines;
+        cMemoryBudget::GetStatistics(Lines);
+        for (int i = 0; i < Lines.Size(); i++)
+            Reply(i < Lines.Size() - 1 ? -250 : 250, "%s", Lines[i]);
+        }
+     else if (strncasecmp(Option, "LOCKS", 5) == 0 && (!Option[5] || isspace(Option[5]))) {
+        const char *Switch = skipspace(Option + 5);
+        if (strcasecmp(Switch, "ON") == 0) {
+           cLockProfiler::SetActive(true);
+           Reply(250, "Lock profiler activated");
+           }
+        else if (strcasecmp(Switch, "OFF") == 0) {
+           cLockProfiler::SetActive(false);
+           Reply(250, "Lock profiler deactivated");
+           }
+        else if (*Switch)
+           Reply(501, "Invalid Option \"%s\"", Option);
+        else {
+           cStringList Lines;
+           cLockProfiler::Report(Lines);
+           for (int i = 0; i < Lines.Size(); i++)
+               Reply(i < Lines.Size() - 1 ? -250 : 250, "%s", Lines[i]);
+           }
+        }
+     else if (strcasecmp(Option, "METRICS") == 0) {
+        cStringList Lines;
+        cMetrics::Report(Lines);
+        for (int i = 0; i < Lines.Size(); i++)
+            Reply(i < Lines.Size() - 1 ? -250 : 250, "%s", Lines[i]);
+        }
      else
         Reply(501, "Invalid Option \"%s\"", Option);
      }
@@ -2579,7 +3397,7 @@ void cSVDRPServer::CmdUPDT(const char *Option)
   if (*Option) {
      cTimer *Timer = new cTimer;
      if (Timer->Parse(Option)) {
-        LOCK_TIMERS_WRITE;
+        LOCK_SVDRP_TIMERS_WRITE(false);
         if (cTimer *t = Timers->GetTimer(Timer)) {
            bool IsRecording = t->HasFlags(tfRecording);
            t->Parse(Option);
@@ -2651,6 +3469,7 @@ void cSVDRPServer::Execute(char *Cmd)
      }
   // skip leading whitespace:
   Cmd = skipspace(Cmd);
+  cString Line(batch ? Cmd : NULL);
   // find the end of the command word:
   char *s = Cmd;
   while (*s && !isspace(*s))
@@ -2658,9 +3477,18 @@ void cSVDRPServer::Execute(char *Cmd)
   if (*s)
      *s++ = 0;
   s = skipspace(s);
-  if      (CMD("AUDI"))  CmdAUDI(s);
+  if (batch && !CMD("ABRT") && !CMD("BEGN") && !CMD("COMT") && !CMD("QUIT")) {
+     batch->Append(strdup(Line));
+     return;
+     }
+  if      (CMD("ABRT"))  CmdABRT(s);
+  else if (CMD("AUDI"))  CmdAUDI(s);
+  else if (CMD("BEGN"))  CmdBEGN(s);
   else if (CMD("CHAN"))  CmdCHAN(s);
+  else if (CMD("CHKT"))  CmdCHKT(s);
   else if (CMD("CLRE"))  CmdCLRE(s);
+  else if (CMD("COMP"))  CmdCOMP(s);
+  else if (CMD("COMT"))  CmdCOMT(s);
   else if (CMD("CONN"))  CmdCONN(s);
   else if (CMD("DELC"))  CmdDELC(s);
   else if (CMD("DELR"))  CmdDELR(s);
@@ -2690,18 +3518,27 @@ void cSVDRPServer::Execute(char *Cmd)
   else if (CMD("PUTE"))  CmdPUTE(s);
   else if (CMD("REMO"))  CmdREMO(s);
   else if (CMD("SCAN"))  CmdSCAN(s);
+  else if (CMD("SRCE"))  CmdSRCE(s);
   else if (CMD("STAT"))  CmdSTAT(s);
   else if (CMD("UPDR"))  CmdUPDR(s);
   else if (CMD("UPDT"))  CmdUPDT(s);
   else if (CMD("VOLU"))  CmdVOLU(s);
-  else if (CMD("QUIT"))  Close(true);
+  else if (CMD("QUIT"))  CmdQUIT(s);
   else                   Reply(500, "Command unrecognized: \"%s\"", Cmd);
+  cRemote::Wakeup(); // the command may have modified timers, channels etc.
 }
 
 bool cSVDRPServer::Process(void)
 {
   if (file.IsOpen()) {
-     while (file.Ready(false)) {
+     mutex.Lock();
+     bool CloseRequested = closeRequested;
+     mutex.Unlock();
+     if (CloseRequested || !Flush()) {
+        Close();
+        return false;
+        }
+     while (file.IsOpen() && !OutputPending()) { // no new commands are read while a reply is still pending
            unsigned char c;
            int r = safe_read(file, &c, 1);
            if (r > 0) {
@@ -2713,7 +3550,10 @@ bool cSVDRPServer::Process(void)
                  cmdLine[numChars] = 0;
                  // showtime!
                  dbgsvdrp("< S %s: %s\n", *clientName, cmdLine);
-                 Execute(cmdLine);
+                 mutex.Lock();
+                 commands.Append(strdup(cmdLine));
+                 mutex.Unlock();
+                 task.Start();
                  numChars = 0;
                  if (length > BUFSIZ) {
                     free(cmdLine); // let's not tie up too much memory
@@ -2751,15 +3591,26 @@ bool cSVDRPServer::Process(void)
                  }
               lastActivity = time(NULL);
               }
-           else if (r <= 0) {
+           else if (r < 0 && errno == EAGAIN)
+              break; // the socket is non-blocking, so we're done if there's nothing more to read
+           else {
               isyslog("SVDRP %s < %s lost connection to client", Setup.SVDRPHostName, *clientName);
               Close();
               }
            }
-     if (Setup.SVDRPTimeout && time(NULL) - lastActivity > Setup.SVDRPTimeout) {
+     if (Busy() && !task.Active())
+        task.Start(); // the task may have been about to end when the last command was added
+     mutex.Lock();
+     time_t LastActivity = lastActivity;
+     mutex.Unlock();
+     if (Setup.SVDRPTimeout && time(NULL) - LastActivity > Setup.SVDRPTimeout && !task.Active()) {
         isyslog("SVDRP %s < %s timeout on connection", Setup.SVDRPHostName, *clientName);
         Close(true, true);
         }
+     else if (OutputPending())
+        SVDRPServerPoller.Add(file, true);
+     else
+        SVDRPServerPoller.Del(file, true);
      }
   return file.IsOpen();
 }
@@ -2783,7 +3634,8 @@ private:
   cSocket tcpSocket;
   cVector<cSVDRPServer *> serverConnections;
   void HandleServerConnection(void);
-  void ProcessConnections(void);
+  bool ProcessConnections(void);
+       ///< Returns true if any of the connections has commands waiting to be executed.
 protected:
   virtual void Action(void) override;
 public:
@@ -2815,8 +3667,9 @@ void cSVDRPServerHandler::WaitUntilReady(void)
         cCondWait::SleepMs(10);
 }
 
-void cSVDRPServerHandler::ProcessConnections(void)
+bool cSVDRPServerHandler::ProcessConnections(void)
 {
+  bool Busy = false;
   for (int i = 0; i < serverConnections.Size(); i++) {
       if (!serverConnections[i]->Process()) {
          if (SVDRPClientHandler)
@@ -2825,7 +3678,10 @@ void cSVDRPServerHandler::ProcessConnections(void)
          serverConnections.Remove(i);
          i--;
          }
+      else
+         Busy |= serverConnections[i]->Busy();
       }
+  return Busy;
 }
 
 void cSVDRPServerHandler::HandleServerConnection(void)
@@ -2839,12 +3695,16 @@ void cSVDRPServerHandler::Action(void)
 {
   if (tcpSocket.Listen()) {
      SVDRPServerPoller.Add(tcpSocket.Socket(), false);
+     SVDRPServerPoller.Add(SVDRPServerWakeup.Fd(), false);
      ready = true;
+     bool Busy = false;
      while (Running()) {
-           SVDRPServerPoller.Poll(1000);
+           SVDRPServerPoller.Poll(Busy ? 100 : 1000);
+           SVDRPServerWakeup.Clear();
            HandleServerConnection();
-           ProcessConnections();
+           Busy = ProcessConnections();
            }
+     SVDRPServerPoller.Del(SVDRPServerWakeup.Fd(), false);
      SVDRPServerPoller.Del(tcpSocket.Socket(), false);
      tcpSocket.Close();
      }
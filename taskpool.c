@@ -0,0 +1,201 @@
+/*
+ * taskpool.c: A pool of threads for background tasks
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#include "taskpool.h"
+#include <unistd.h>
+
+#define TASKPOOLIDLETIME  60 // seconds an idle worker thread waits for new tasks before it ends
+
+// --- cTaskPoolWorker -------------------------------------------------------
+
+class cTaskPoolWorker : public cThread, public cListObject {
+protected:
+  virtual void Action(void) override;
+public:
+  cTaskPoolWorker(void);
+  virtual ~cTaskPoolWorker() override;
+  void Stop(void) { Cancel(-1); }
+  };
+
+cTaskPoolWorker::cTaskPoolWorker(void)
+:cThread("task pool worker", true)
+{
+}
+
+cTaskPoolWorker::~cTaskPoolWorker()
+{
+  Cancel(-1);
+  cTaskPool::mutex.Lock();
+  cTaskPool::taskQueued.Broadcast();
+  cTaskPool::mutex.Unlock();
+  Cancel(3);
+}
+
+void cTaskPoolWorker::Action(void)
+{
+  cTaskPool::mutex.Lock();
+  while (Running()) {
+        cTask *Task = cTaskPool::queue.First();
+        if (!Task) {
+           cTaskPool::idleWorkers++;
+           bool Signaled = cTaskPool::taskQueued.TimedWait(cTaskPool::mutex, TASKPOOLIDLETIME * 1000);
+           cTaskPool::idleWorkers--;
+           if (!Signaled && !cTaskPool::queue.First())
+              break;
+           continue;
+           }
+        cTaskPool::queue.Del(Task, false);
+        Task->queued = false;
+        Task->busy = true;
+        cTaskPool::mutex.Unlock();
+        Task->Action();
+        cTaskPool::mutex.Lock();
+        Task->busy = false;
+        cTaskPool::taskDone.Broadcast();
+        if (Task->autoDelete) {
+           cTaskPool::mutex.Unlock();
+           delete Task; // nobody else is allowed to access this task
+           cTaskPool::mutex.Lock();
+           }
+        }
+  cTaskPool::activeWorkers--;
+  cTaskPool::mutex.Unlock();
+}
+
+// --- cTaskPool -------------------------------------------------------------
+
+cMutex cTaskPool::mutex;
+cCondVar cTaskPool::taskQueued;
+cCondVar cTaskPool::taskDone;
+cList<cTask> cTaskPool::queue;
+int cTaskPool::maxThreads = 0;
+int cTaskPool::activeWorkers = 0;
+int cTaskPool::idleWorkers = 0;
+bool cTaskPool::shutDown = false;
+
+static cList<cTaskPoolWorker> TaskPoolWorkers; // must be destroyed before the above variables
+
+void cTaskPool::SetMaxThreads(int MaxThreads)
+{
+  cMutexLock MutexLock(&mutex);
+  maxThreads = MaxThreads;
+}
+
+void cTaskPool::StartWorker(void)
+{
+  // mutex must be locked!
+  if (!maxThreads)
+     maxThreads = max(int(sysconf(_SC_NPROCESSORS_ONLN)), 2);
+  if (idleWorkers >= queue.Count() || activeWorkers >= maxThreads)
+     return;
+  cTaskPoolWorker *Worker = TaskPoolWorkers.First();
+  while (Worker && Worker->Active()) // a worker that has just timed out may not have ended yet
+        Worker = TaskPoolWorkers.Next(Worker);
+  if (!Worker) {
+     Worker = new cTaskPoolWorker;
+     TaskPoolWorkers.Add(Worker);
+     }
+  if (Worker->Start())
+     activeWorkers++;
+}
+
+void cTaskPool::Shutdown(void)
+{
+  mutex.Lock();
+  shutDown = true;
+  while (cTask *Task = queue.First())
+        Task->Cancel(false);
+  for (cTaskPoolWorker *Worker = TaskPoolWorkers.First(); Worker; Worker = TaskPoolWorkers.Next(Worker))
+      Worker->Stop();
+  taskQueued.Broadcast();
+  mutex.Unlock();
+  TaskPoolWorkers.Clear(); // waits for the workers to end
+}
+
+// --- cTask -----------------------------------------------------------------
+
+cTask::cTask(int Priority)
+{
+  priority = Priority;
+  autoDelete = false;
+  queued = false;
+  busy = false;
+  cancelled = false;
+}
+
+cTask::~cTask()
+{
+  autoDelete = false; // we're already being deleted
+  Cancel(true);
+}
+
+bool cTask::Running(void)
+{
+  return !cancelled && !cTaskPool::shutDown;
+}
+
+bool cTask::Start(bool AutoDelete)
+{
+  cMutexLock MutexLock(&cTaskPool::mutex);
+  if (cTaskPool::shutDown) {
+     if (AutoDelete)
+        delete this;
+     return false;
+     }
+  if (!queued && !busy) {
+     autoDelete = AutoDelete;
+     cancelled = false;
+     cTask *t = cTaskPool::queue.First();
+     while (t && t->priority >= priority)
+           t = cTaskPool::queue.Next(t);
+     if (t)
+        cTaskPool::queue.Ins(this, t);
+     else
+        cTaskPool::queue.Add(this);
+     queued = true;
+     if (cTaskPool::idleWorkers)
+        cTaskPool::taskQueued.Broadcast();
+     cTaskPool::StartWorker();
+     }
+  return true;
+}
+
+bool cTask::Active(void)
+{
+  cMutexLock MutexLock(&cTaskPool::mutex);
+  return queued || busy;
+}
+
+void cTask::Wait(void)
+{
+  cMutexLock MutexLock(&cTaskPool::mutex);
+  while (queued || busy)
+        cTaskPool::taskDone.Wait(cTaskPool::mutex);
+}
+
+void cTask::Cancel(bool Wait)
+{
+  cMutexLock MutexLock(&cTaskPool::mutex);
+  if (queued) {
+     cTaskPool::queue.Del(this, false);
+     queued = false;
+     cTaskPool::taskDone.Broadcast();
+     if (autoDelete) {
+        delete this;
+        return;
+        }
+     }
+  if (busy) {
+     cancelled = true;
+     if (Wait) {
+        while (busy)
+              cTaskPool::taskDone.Wait(cTaskPool::mutex);
+        }
+     }
+}
@@ -0,0 +1,88 @@
+/*
+ * taskpool.h: A pool of threads for background tasks
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#ifndef __TASKPOOL_H
+#define __TASKPOOL_H
+
+#include "thread.h"
+#include "tools.h"
+
+// cTask is a piece of work that is executed by one of the threads of the
+// cTaskPool, instead of creating a thread of its own. This avoids the overhead
+// of creating and destroying threads for short lived background activities,
+// and makes sure the number of threads doing background work is limited.
+
+enum eTaskPriority { tpLow = 0, tpNormal = 1, tpHigh = 2 };
+
+class cTask : public cListObject {
+  friend class cTaskPool;
+  friend class cTaskPoolWorker;
+private:
+  int priority;
+  bool autoDelete;
+  bool queued;
+  bool busy;
+  bool cancelled;
+protected:
+  virtual void Action(void) = 0;
+       ///< A derived cTask class must implement the code it wants to
+       ///< execute in this function. If this takes a while, it must check
+       ///< Running() repeatedly to see whether it's time to stop.
+  bool Running(void);
+       ///< Returns false if a derived cTask object shall leave its Action()
+       ///< function.
+public:
+  cTask(int Priority = tpNormal);
+       ///< Creates a new task with the given Priority. Tasks with a higher
+       ///< priority are executed before those with a lower one.
+  virtual ~cTask();
+       ///< Cancels the task and waits until it has ended if it is currently
+       ///< being executed.
+  bool Start(bool AutoDelete = false);
+       ///< Submits this task to the cTaskPool. If the task is already queued or
+       ///< being executed, nothing happens. If AutoDelete is true, the task object
+       ///< will be deleted after it has been executed (or cancelled), and the
+       ///< caller must not access it any more after this call.
+       ///< Returns false if the task pool has already been shut down.
+  bool Active(void);
+       ///< Returns true if this task is waiting to be executed or is currently
+       ///< being executed.
+  void Wait(void);
+       ///< Waits until this task has been executed (or cancelled). Must not be
+       ///< called for a task that has been started with AutoDelete.
+  void Cancel(bool Wait = true);
+       ///< Cancels this task. If it is still waiting to be executed, it is
+       ///< removed from the queue. If it is currently being executed, Running()
+       ///< will return false, and if Wait is true, this function waits until
+       ///< the task's Action() function has returned.
+  };
+
+class cTaskPool {
+  friend class cTask;
+  friend class cTaskPoolWorker;
+private:
+  static cMutex mutex;
+  static cCondVar taskQueued;
+  static cCondVar taskDone;
+  static cList<cTask> queue;
+  static int maxThreads;
+  static int activeWorkers;
+  static int idleWorkers;
+  static bool shutDown;
+  static void StartWorker(void);
+public:
+  static void SetMaxThreads(int MaxThreads);
+       ///< Sets the maximum number of threads that execute tasks in parallel.
+       ///< By default this is the number of CPUs (at least 2).
+  static void Shutdown(void);
+       ///< Cancels all tasks, waits for the ones being executed to end and
+       ///< stops all threads of the task pool.
+  };
+
+#endif //__TASKPOOL_H
@@ -14,14 +14,18 @@
 #include <execinfo.h>
 #include <linux/unistd.h>
 #include <malloc.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <sys/eventfd.h>
 #include <sys/prctl.h>
 #include <sys/resource.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include "config.h"
+#include "metrics.h"
 #include "tools.h"
 
 #define ABORT { dsyslog("ABORT!"); cBackTrace::BackTrace(); abort(); }
@@ -106,6 +110,42 @@ void cCondWait::Signal(void)
   pthread_mutex_unlock(&mutex);
 }
 
+// --- cWakeup ---------------------------------------------------------------
+
+cWakeup::cWakeup(void)
+{
+  fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0)
+     LOG_ERROR;
+}
+
+cWakeup::~cWakeup()
+{
+  if (fd >= 0)
+     close(fd);
+}
+
+void cWakeup::Signal(void)
+{
+  uint64_t One = 1;
+  if (write(fd, &One, sizeof(One)) < 0 && errno != EAGAIN)
+     LOG_ERROR;
+}
+
+bool cWakeup::Clear(void)
+{
+  uint64_t Count;
+  return read(fd, &Count, sizeof(Count)) == sizeof(Count);
+}
+
+bool cWakeup::Wait(int TimeoutMs)
+{
+  if (Clear())
+     return true;
+  cPoller Poller(fd);
+  return Poller.Poll(TimeoutMs ? TimeoutMs : -1) && Clear();
+}
+
 // --- cCondVar --------------------------------------------------------------
 
 cCondVar::cCondVar(void)
@@ -125,7 +165,9 @@ void cCondVar::Wait(cMutex &Mutex)
      int locked = Mutex.locked;
      Mutex.locked = 0; // have to clear the locked count here, as pthread_cond_wait
                        // does an implicit unlock of the mutex
+     Mutex.ProfileRelease();
      pthread_cond_wait(&cond, &Mutex.mutex);
+     Mutex.ProfileAcquire();
      Mutex.locked = locked;
      }
 }
@@ -140,8 +182,10 @@ bool cCondVar::TimedWait(cMutex &Mutex, int TimeoutMs)
         int locked = Mutex.locked;
         Mutex.locked = 0; // have to clear the locked count here, as pthread_cond_timedwait
                           // does an implicit unlock of the mutex.
+        Mutex.ProfileRelease();
         if (pthread_cond_timedwait(&cond, &Mutex.mutex, &abstime) == ETIMEDOUT)
            r = false;
+        Mutex.ProfileAcquire();
         Mutex.locked = locked;
         }
      }
@@ -206,9 +250,12 @@ void cRwLock::Unlock(void)
 
 // --- cMutex ----------------------------------------------------------------
 
+static std::atomic_int MutexHistograms[2][LOCKPROFILEBUCKETS]; // the wait and hold times of all mutexes
+
 cMutex::cMutex(void)
 {
   locked = 0;
+  lockTime = 0;
   pthread_mutexattr_t attr;
   pthread_mutexattr_init(&attr);
   pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK_NP);
@@ -220,21 +267,132 @@ cMutex::~cMutex()
   pthread_mutex_destroy(&mutex);
 }
 
+void cMutex::ProfileAcquire(void)
+{
+  lockTime = cLockProfiler::Active() ? cTimeMs::NowUs() : 0;
+}
+
+void cMutex::ProfileRelease(void)
+{
+  if (lockTime) {
+     cLockProfiler::Record(MutexHistograms[1], "cMutex", true, cTimeMs::NowUs() - lockTime);
+     lockTime = 0;
+     }
+}
+
 void cMutex::Lock(void)
 {
-  pthread_mutex_lock(&mutex);
+  if (cLockProfiler::Active()) {
+     if (pthread_mutex_trylock(&mutex) == EBUSY) {
+        uint64_t Start = cTimeMs::NowUs();
+        if (pthread_mutex_lock(&mutex) != EDEADLK) // locking it again in the same thread doesn't wait
+           cLockProfiler::Record(MutexHistograms[0], "cMutex", false, cTimeMs::NowUs() - Start);
+        }
+     if (!locked)
+        ProfileAcquire();
+     }
+  else
+     pthread_mutex_lock(&mutex);
   locked++;
 }
 
 void cMutex::Unlock(void)
 {
-  if (!--locked)
+  if (!--locked) {
+     ProfileRelease();
      pthread_mutex_unlock(&mutex);
+     }
+}
+
+// --- cReaderBiasedRwLock --------------------------------------------------
+
+#define RWLOCKINHIBIT  9 // the reader bias is restored after this many times of the time it took to revoke it
+
+cReaderBiasedRwLock::cReaderBiasedRwLock(void)
+{
+  readerBias = true;
+  writers = 0;
+  inhibitUntil = 0;
+  for (int i = 0; i < RWLOCKSLOTS; i++)
+      slots[i].readers = 0;
+}
+
+bool cReaderBiasedRwLock::Drain(uint64_t Deadline)
+{
+  for (int i = 0; i < RWLOCKSLOTS; i++) {
+      for (int n = 0; slots[i].readers > 0; n++) {
+          if (Deadline && cTimeMs::Now() >= Deadline)
+             return false;
+          if (n < 100)
+             sched_yield();
+          else
+             cCondWait::SleepMs(1);
+          }
+      }
+  return true;
+}
+
+bool cReaderBiasedRwLock::Lock(bool Write, int TimeoutMs, int &Slot)
+{
+  Slot = -1;
+  if (Write) {
+     uint64_t Start = cTimeMs::Now();
+     uint64_t Deadline = TimeoutMs ? Start + TimeoutMs : 0;
+     biasMutex.Lock();
+     writers++;
+     readerBias = false; // from now on new readers take the slow path
+     biasMutex.Unlock();
+     if (Drain(Deadline)) {
+        uint64_t Now = cTimeMs::Now();
+        inhibitUntil = Now + RWLOCKINHIBIT * (Now - Start);
+        if (!Deadline || Now < Deadline) {
+           if (rwLock.Lock(true, Deadline ? int(Deadline - Now) : 0))
+              return true;
+           }
+        }
+     writers--;
+     return false;
+     }
+  if (readerBias) {
+     int s = sched_getcpu();
+     if (s < 0)
+        s = cThread::ThreadId();
+     s %= RWLOCKSLOTS;
+     slots[s].readers++;
+     if (readerBias) { // a writer that revokes the bias after this point will wait for us
+        Slot = s;
+        return true;
+        }
+     slots[s].readers--;
+     }
+  if (!rwLock.Lock(false, TimeoutMs))
+     return false;
+  // Holding a read lock means there is no active writer, but there may be
+  // writers waiting, or this thread may hold the write lock itself:
+  if (!readerBias && writers == 0 && cTimeMs::Now() >= inhibitUntil) {
+     cMutexLock MutexLock(&biasMutex);
+     if (writers == 0)
+        readerBias = true;
+     }
+  return true;
+}
+
+void cReaderBiasedRwLock::Unlock(bool Write, int Slot)
+{
+  if (Slot >= 0)
+     slots[Slot].readers--;
+  else {
+     rwLock.Unlock();
+     if (Write)
+        writers--;
+     }
 }
 
 // --- cThread ---------------------------------------------------------------
 
 tThreadId cThread::mainThreadId = 0;
+cThread *cThread::threads = NULL;
+cMutex cThread::threadsMutex;
 
 cThread::cThread(const char *Description, bool LowPriority)
 {
@@ -245,14 +403,42 @@ cThread::cThread(const char *Description, bool LowPriority)
   if (Description)
      SetDescription("%s", Description);
   lowPriority = LowPriority;
+  registered = false;
+  nextThread = NULL;
 }
 
 cThread::~cThread()
 {
   Cancel(); // just in case the derived class didn't call it
+  Unregister();
   free(description);
 }
 
+void cThread::Register(void)
+{
+  cMutexLock MutexLock(&threadsMutex);
+  if (!registered) {
+     nextThread = threads;
+     threads = this;
+     registered = true;
+     }
+}
+
+void cThread::Unregister(void)
+{
+  if (registered) { // only threads that have ever been started are registered
+     cMutexLock MutexLock(&threadsMutex);
+     for (cThread **t = &threads; *t; t = &(*t)->nextThread) {
+         if (*t == this) {
+            *t = nextThread;
+            break;
+            }
+         }
+     nextThread = NULL;
+     registered = false;
+     }
+}
+
 void cThread::SetPriority(int Priority)
 {
   if (setpriority(PRIO_PROCESS, 0, Priority) < 0)
@@ -291,7 +477,11 @@ void *cThread::StartThread(cThread *Thread)
      Thread->SetPriority(19);
      Thread->SetIOPriority(7);
      }
+  if (Thread->description)
+     ThreadProfiles.Apply(Thread->description);
+  cThreadStatistics::Register(Thread->childThreadId, Thread->description);
   Thread->Action();
+  cThreadStatistics::Unregister(Thread->childThreadId);
   if (Thread->description)
      dsyslog("%s thread ended (pid=%d, tid=%d)", Thread->description, getpid(), Thread->childThreadId);
   Thread->running = false;
@@ -316,6 +506,7 @@ bool cThread::Start(void)
         active = running = true;
         if (pthread_create(&childTid, NULL, (void *(*) (void *))&StartThread, (void *)this) == 0) {
            pthread_detach(childTid); // auto-reap
+           Register();
            }
         else {
            LOG_ERROR;
@@ -371,6 +562,41 @@ void cThread::Cancel(int WaitSeconds)
      }
 }
 
+void cThread::CancelAll(int WaitSeconds)
+{
+  tThreadId Self = ThreadId();
+  cTimeMs Duration;
+  cTimeMs t(WaitSeconds * 1000);
+  int Stopped = 0;
+  cMutexLock MutexLock(&threadsMutex);
+  for (cThread *Thread = threads; Thread; Thread = Thread->nextThread) {
+      if (Thread->active && Thread->childThreadId != Self) {
+         Thread->running = false;
+         Stopped++;
+         }
+      }
+  for (;;) {
+      int Remaining = 0;
+      for (cThread *Thread = threads; Thread; Thread = Thread->nextThread) {
+          if (Thread->childThreadId != Self && Thread->Active())
+             Remaining++;
+          }
+      if (!Remaining)
+         break;
+      if (t.TimedOut()) {
+         for (cThread *Thread = threads; Thread; Thread = Thread->nextThread) {
+             if (Thread->childThreadId != Self && Thread->Active())
+                esyslog("ERROR: %s thread %d won't end (waited %d seconds)", Thread->description ? Thread->description : "", Thread->childThreadId, WaitSeconds);
+             }
+         break;
+         }
+      threadsMutex.Unlock(); // lets threads that end delete other threads
+      cCondWait::SleepMs(10);
+      threadsMutex.Lock();
+      }
+  dsyslog("stopped %d threads in %d ms", Stopped, int(Duration.Elapsed()));
+}
+
 tThreadId cThread::ThreadId(void)
 {
   return syscall(__NR_gettid);
@@ -384,6 +610,164 @@ void cThread::SetMainThreadId(void)
      esyslog("ERROR: attempt to set main thread id to %d while it already is %d", ThreadId(), mainThreadId);
 }
 
+// --- cThreadStatistics -----------------------------------------------------
+
+#define THREADSLOGGED  10 // maximum number of threads listed by cThreadStatistics::Log()
+
+class cThreadEntry : public cListObject {
+public:
+  tThreadId threadId;
+  cString description;
+  cThreadEntry(tThreadId ThreadId, const char *Description) : description(Description) { threadId = ThreadId; }
+  };
+
+class cThreadSample : public cListObject {
+public:
+  tThreadId threadId;
+  cString name;
+  int userTime;   // ms
+  int systemTime; // ms
+  int voluntary;
+  int involuntary;
+  int CpuTime(void) const { return userTime + systemTime; }
+  virtual int Compare(const cListObject &ListObject) const override { return ((cThreadSample *)&ListObject)->CpuTime() - CpuTime(); }
+  };
+
+static cMutex ThreadStatisticsMutex;
+static cList<cThreadEntry> ThreadEntries;
+
+void cThreadStatistics::Register(tThreadId ThreadId, const char *Description)
+{
+  cMutexLock MutexLock(&ThreadStatisticsMutex);
+  ThreadEntries.Add(new cThreadEntry(ThreadId, Description ? Description : "unnamed"));
+}
+
+void cThreadStatistics::Unregister(tThreadId ThreadId)
+{
+  cMutexLock MutexLock(&ThreadStatisticsMutex);
+  for (cThreadEntry *e = ThreadEntries.First(); e; e = ThreadEntries.Next(e)) {
+      if (e->threadId == ThreadId) {
+         ThreadEntries.Del(e);
+         break;
+         }
+      }
+}
+
+static bool ReadThreadSample(cThreadSample *Sample)
+{
+  static long ClockTicks = sysconf(_SC_CLK_TCK);
+  char buffer[512];
+  // CPU times from the 14th and 15th field of 'stat' (the name in field 2 may contain blanks):
+  FILE *f = fopen(cString::sprintf("/proc/self/task/%d/stat", Sample->threadId), "r");
+  if (!f)
+     return false; // the thread has ended in the meantime
+  bool Ok = false;
+  if (fgets(buffer, sizeof(buffer), f)) {
+     char *b = strchr(buffer, '(');
+     char *e = strrchr(buffer, ')');
+     unsigned long UserTicks, SystemTicks;
+     if (b && e && sscanf(e + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &UserTicks, &SystemTicks) == 2) {
+        *e = 0;
+        Sample->name = b + 1;
+        Sample->userTime = int(UserTicks * 1000 / ClockTicks);
+        Sample->systemTime = int(SystemTicks * 1000 / ClockTicks);
+        Ok = true;
+        }
+     }
+  fclose(f);
+  // Context switches from 'status':
+  Sample->voluntary = Sample->involuntary = 0;
+  if (Ok && (f = fopen(cString::sprintf("/proc/self/task/%d/status", Sample->threadId), "r")) != NULL) {
+     while (fgets(buffer, sizeof(buffer), f)) {
+           if (sscanf(buffer, "voluntary_ctxt_switches: %d", &Sample->voluntary) == 1)
+              continue;
+           sscanf(buffer, "nonvoluntary_ctxt_switches: %d", &Sample->involuntary);
+           }
+     fclose(f);
+     }
+  return Ok;
+}
+
+static void ReadThreadSamples(cList<cThreadSample> &Samples)
+{
+  cReadDir d("/proc/self/task");
+  struct dirent *e;
+  while ((e = d.Next()) != NULL) {
+        cThreadSample *Sample = new cThreadSample;
+        Sample->threadId = atoi(e->d_name);
+        if (Sample->threadId > 0 && ReadThreadSample(Sample))
+           Samples.Add(Sample);
+        else
+           delete Sample;
+        }
+  cMutexLock MutexLock(&ThreadStatisticsMutex);
+  for (cThreadSample *s = Samples.First(); s; s = Samples.Next(s)) {
+      if (s->threadId == getpid())
+         s->name = "main";
+      else {
+         for (cThreadEntry *e = ThreadEntries.First(); e; e = ThreadEntries.Next(e)) {
+             if (e->threadId == s->threadId) {
+                s->name = e->description;
+                break;
+                }
+             }
+         }
+      }
+}
+
+void cThreadStatistics::Report(cStringList &Lines)
+{
+  cList<cThreadSample> Samples;
+  ReadThreadSamples(Samples);
+  Samples.Sort();
+  for (cThreadSample *s = Samples.First(); s; s = Samples.Next(s))
+      Lines.Append(strdup(cString::sprintf("%7d %-24s cpu %9d ms (user %9d, system %9d), context switches %9d voluntary, %9d involuntary", s->threadId, *s->name, s->CpuTime(), s->userTime, s->systemTime, s->voluntary, s->involuntary)));
+}
+
+void cThreadStatistics::Log(void)
+{
+  static cList<cThreadSample> Previous;
+  static time_t LastLog = 0;
+  cList<cThreadSample> Samples;
+  ReadThreadSamples(Samples);
+  // Turn the totals into the amounts used since the previous call:
+  cList<cThreadSample> Deltas;
+  for (cThreadSample *s = Samples.First(); s; s = Samples.Next(s)) {
+      cThreadSample *Delta = new cThreadSample;
+      Delta->threadId = s->threadId;
+      Delta->name = s->name;
+      Delta->userTime = s->userTime;
+      Delta->systemTime = s->systemTime;
+      Delta->voluntary = s->voluntary;
+      Delta->involuntary = s->involuntary;
+      for (cThreadSample *p = Previous.First(); p; p = Previous.Next(p)) {
+          if (p->threadId == s->threadId) {
+             Delta->userTime -= p->userTime;
+             Delta->systemTime -= p->systemTime;
+             Delta->voluntary -= p->voluntary;
+             Delta->involuntary -= p->involuntary;
+             break;
+             }
+          }
+      Deltas.Add(Delta);
+      }
+  Deltas.Sort();
+  time_t Now = time(NULL);
+  if (LastLog)
+     dsyslog("thread statistics for the last %d seconds:", int(Now - LastLog));
+  else
+     dsyslog("thread statistics since program start:");
+  int n = 0;
+  for (cThreadSample *s = Deltas.First(); s && n < THREADSLOGGED && s->CpuTime() > 0; s = Deltas.Next(s), n++)
+      dsyslog("  %7d %-24s cpu %7d ms, context switches %7d voluntary, %7d involuntary", s->threadId, *s->name, s->CpuTime(), s->voluntary, s->involuntary);
+  Previous.Clear();
+  while (cThreadSample *s = Samples.First()) {
+        Samples.Del(s, false);
+        Previous.Add(s);
+        }
+  LastLog = Now;
+}
+
 // --- cMutexLock ------------------------------------------------------------
 
 cMutexLock::cMutexLock(cMutex *Mutex)
@@ -555,6 +939,153 @@ cString cBackTrace::GetCaller(int Level, bool Mangled)
   return Caller;
 }
 
+// --- cLockProfiler ---------------------------------------------------------
+
+#define LOCKPROFILEFRAMES     12 // the number of stack frames recorded for a call site
+#define LOCKPROFILESHOWFRAMES  4 // the number of stack frames listed for a call site
+#define LOCKPROFILECALLSITES 512 // the maximum number of call sites
+#define LOCKPROFILEREPORT     15 // the number of call sites listed by Report()
+
+struct tLockCallSite {
+  const char *lock;
+  uint32_t hash;
+  int numFrames;
+  void *frames[LOCKPROFILEFRAMES];
+  int count[2];     // waits, holds
+  uint64_t time[2]; // us
+  uint64_t max[2];  // us
+  };
+
+std::atomic_bool cLockProfiler::active(false);
+
+// This is a plain pthread mutex, because a cMutex would profile itself:
+static pthread_mutex_t LockCallSitesMutex = PTHREAD_MUTEX_INITIALIZER;
+static tLockCallSite LockCallSites[LOCKPROFILECALLSITES];
+static int NumLockCallSites = 0;
+static int DroppedLockCallSites = 0;
+
+static int LockProfileBucket(uint64_t Time)
+{
+  int Bucket = 0;
+  for (uint64_t Limit = 10; Bucket < LOCKPROFILEBUCKETS - 1 && Time >= Limit; Limit *= 10)
+      Bucket++;
+  return Bucket;
+}
+
+static cString LockProfileHistogram(const std::atomic_int *Histogram)
+{
+  static const char *Limits[LOCKPROFILEBUCKETS] = { "<10us", "<100us", "<1ms", "<10ms", "<100ms", "<1s", ">=1s" };
+  cString s = "";
+  for (int i = 0; i < LOCKPROFILEBUCKETS; i++)
+      s = cString::sprintf("%s %s:%d", *s, Limits[i], Histogram[i].load());
+  return s;
+}
+
+void cLockProfiler::SetActive(bool On)
+{
+  if (On && !active) {
+     for (int h = 0; h < 2; h++) {
+         for (int i = 0; i < LOCKPROFILEBUCKETS; i++)
+             MutexHistograms[h][i] = 0;
+         }
+     cStateLock::ProfileClear();
+     pthread_mutex_lock(&LockCallSitesMutex);
+     NumLockCallSites = DroppedLockCallSites = 0;
+     pthread_mutex_unlock(&LockCallSitesMutex);
+     }
+  if (On != active)
+     isyslog("lock profiler %s", On ? "activated" : "deactivated");
+  active = On;
+}
+
+void cLockProfiler::Record(std::atomic_int *Histogram, const char *Lock, bool Hold, uint64_t Time)
+{
+  Histogram[LockProfileBucket(Time)]++;
+  if (Time >= LOCKPROFILESLOW) {
+     void *Frames[LOCKPROFILEFRAMES];
+     int n = backtrace(Frames, LOCKPROFILEFRAMES);
+     uint32_t Hash = 0;
+     for (int i = 0; i < n; i++)
+         Hash = Hash * 31 + uint32_t(uintptr_t(Frames[i]) ^ (uintptr_t(Frames[i]) >> 32));
+     if (!Lock)
+        Lock = "unnamed";
+     pthread_mutex_lock(&LockCallSitesMutex);
+     tLockCallSite *CallSite = NULL;
+     for (int i = 0; i < NumLockCallSites; i++) {
+         if (LockCallSites[i].hash == Hash && LockCallSites[i].lock == Lock) {
+            CallSite = &LockCallSites[i];
+            break;
+            }
+         }
+     if (!CallSite && NumLockCallSites < LOCKPROFILECALLSITES) {
+        CallSite = &LockCallSites[NumLockCallSites++];
+        memset(CallSite, 0, sizeof(*CallSite));
+        CallSite->lock = Lock;
+        CallSite->hash = Hash;
+        CallSite->numFrames = n;
+        memcpy(CallSite->frames, Frames, n * sizeof(void *));
+        }
+     if (CallSite) {
+        CallSite->count[Hold]++;
+        CallSite->time[Hold] += Time;
+        if (Time > CallSite->max[Hold])
+           CallSite->max[Hold] = Time;
+        }
+     else
+        DroppedLockCallSites++;
+     pthread_mutex_unlock(&LockCallSitesMutex);
+     }
+}
+
+static bool IsLockingFrame(const char *Symbol)
+{
+  // The frames of the locking functions themselves are of no interest:
+  static const char *Locking[] = { "13cLockProfiler", "10cStateLock", "9cStateKey", "6cMutex", "8cCondVar", "10cMutexLock", "11cThreadLock", NULL };
+  for (const char **l = Locking; *l; l++) {
+      if (strstr(Symbol, *l))
+         return true;
+      }
+  return false;
+}
+
+void cLockProfiler::Report(cStringList &Lines)
+{
+  Lines.Append(strdup(cString::sprintf("lock profiler is %s", active ? "active" : "inactive")));
+  cStateLock::ProfileReport(Lines);
+  Lines.Append(strdup(cString::sprintf("%-12s wait%s", "cMutex", *LockProfileHistogram(MutexHistograms[0]))));
+  Lines.Append(strdup(cString::sprintf("%-12s hold%s", "cMutex", *LockProfileHistogram(MutexHistograms[1]))));
+  // Take a copy of the call sites, because resolving their symbols takes a while:
+  tLockCallSite *CallSites = MALLOC(tLockCallSite, LOCKPROFILECALLSITES);
+  pthread_mutex_lock(&LockCallSitesMutex);
+  int NumCallSites = NumLockCallSites;
+  int Dropped = DroppedLockCallSites;
+  memcpy(CallSites, LockCallSites, NumCallSites * sizeof(tLockCallSite));
+  pthread_mutex_unlock(&LockCallSitesMutex);
+  qsort(CallSites, NumCallSites, sizeof(tLockCallSite), [](const void *a, const void *b) -> int {
+    uint64_t ta = ((const tLockCallSite *)a)->time[0] + ((const tLockCallSite *)a)->time[1];
+    uint64_t tb = ((const tLockCallSite *)b)->time[0] + ((const tLockCallSite *)b)->time[1];
+    return ta < tb ? 1 : ta > tb ? -1 : 0;
+    });
+  Lines.Append(strdup(cString::sprintf("call sites with waits or holds of at least %d us: %d%s", LOCKPROFILESLOW, NumCallSites, Dropped ? *cString::sprintf(" (%d events not recorded)", Dropped) : "")));
+  for (int i = 0; i < NumCallSites && i < LOCKPROFILEREPORT; i++) {
+      tLockCallSite *cs = &CallSites[i];
+      Lines.Append(strdup(cString::sprintf("%-12s %6d waits (total %7d ms, max %6d ms), %6d holds (total %7d ms, max %6d ms)", cs->lock,
+        cs->count[0], int(cs->time[0] / 1000), int(cs->max[0] / 1000),
+        cs->count[1], int(cs->time[1] / 1000), int(cs->max[1] / 1000))));
+      if (char **s = backtrace_symbols(cs->frames, cs->numFrames)) {
+         int Shown = 0;
+         for (int f = 1; f < cs->numFrames && Shown < LOCKPROFILESHOWFRAMES; f++) { // 0 is Record() itself
+             if (!Shown && IsLockingFrame(s[f]))
+                continue;
+             Lines.Append(strdup(cString::sprintf("    %s", *cBackTrace::Demangle(s[f]))));
+             Shown++;
+             }
+         free(s);
+         }
+      }
+  free(CallSites);
+}
+
 // --- cStateLockLog ---------------------------------------------------------
 
 #ifdef DEBUG_LOCKSEQ
@@ -713,6 +1244,14 @@ static cStateLockLog StateLockLog;
 
 // --- cStateLock ------------------------------------------------------------
 
+cStateLock *cStateLock::stateLocks = NULL;
+
+static cMutex &StateLocksMutex(void)
+{
+  static cMutex Mutex; // state locks are global objects, so this must not depend on the order of static initialization
+  return Mutex;
+}
+
 cStateLock::cStateLock(const char *Name)
 {
   name = Name;
@@ -720,6 +1259,96 @@ cStateLock::cStateLock(const char *Name)
   state = 0;
   explicitModify = emDisabled;
   syncStateKey = NULL;
+  locks = 0;
+  waitTime = 0;
+  maxWaitTime = 0;
+  writeHoldTime = 0;
+  for (int h = 0; h < 2; h++) {
+      for (int i = 0; i < LOCKPROFILEBUCKETS; i++)
+          histograms[h][i] = 0;
+      }
+  cMutexLock MutexLock(&StateLocksMutex());
+  nextStateLock = stateLocks;
+  stateLocks = this;
+}
+
+cStateLock::~cStateLock()
+{
+  cMutexLock MutexLock(&StateLocksMutex());
+  for (cStateLock **sl = &stateLocks; *sl; sl = &(*sl)->nextStateLock) {
+      if (*sl == this) {
+         *sl = nextStateLock;
+         break;
+         }
+      }
+}
+
+bool cStateLock::Reported(void) const
+{
+  if (!name)
+     return false; // the locks of lists that are not global objects have no name
+  for (cStateLock *sl = nextStateLock; sl; sl = sl->nextStateLock) { // older locks come later in the list
+      if (sl->name && strcmp(sl->name, name) == 0)
+         return false;
+      }
+  return true;
+}
+
+void cStateLock::ProfileReport(cStringList &Lines)
+{
+  cMutexLock MutexLock(&StateLocksMutex());
+  for (cStateLock *sl = stateLocks; sl; sl = sl->nextStateLock) {
+      if (sl->Reported()) {
+         Lines.Append(strdup(cString::sprintf("%-12s wait%s", sl->name, *LockProfileHistogram(sl->histograms[0]))));
+         Lines.Append(strdup(cString::sprintf("%-12s hold%s", sl->name, *LockProfileHistogram(sl->histograms[1]))));
+         }
+      }
+}
+
+void cStateLock::ProfileClear(void)
+{
+  cMutexLock MutexLock(&StateLocksMutex());
+  for (cStateLock *sl = stateLocks; sl; sl = sl->nextStateLock) {
+      for (int h = 0; h < 2; h++) {
+          for (int i = 0; i < LOCKPROFILEBUCKETS; i++)
+              sl->histograms[h][i] = 0;
+          }
+      }
+}
+
+void cStateLock::AddMetrics(cMetrics &Metrics)
+{
+  cMutexLock MutexLock(&StateLocksMutex());
+  Metrics.Family("vdr_lock_acquisitions", "counter", "Calls to cStateLock::Lock()");
+  for (cStateLock *sl = stateLocks; sl; sl = sl->nextStateLock) {
+      if (sl->Reported())
+         Metrics.Add(sl->locks, cMetrics::Label("lock", sl->name));
+      }
+  Metrics.Family("vdr_lock_wait_seconds", "counter", "Time spent waiting for a state lock");
+  for (cStateLock *sl = stateLocks; sl; sl = sl->nextStateLock) {
+      if (sl->Reported())
+         Metrics.Add(sl->waitTime / 1000000.0, cMetrics::Label("lock", sl->name));
+      }
+  Metrics.Family("vdr_lock_max_wait_seconds", "gauge", "Longest single wait for a state lock");
+  for (cStateLock *sl = stateLocks; sl; sl = sl->nextStateLock) {
+      if (sl->Reported())
+         Metrics.Add(sl->maxWaitTime / 1000000.0, cMetrics::Label("lock", sl->name));
+      }
+  Metrics.Family("vdr_lock_write_hold_seconds", "counter", "Time a state lock has been held for writing");
+  for (cStateLock *sl = stateLocks; sl; sl = sl->nextStateLock) {
+      if (sl->Reported())
+         Metrics.Add(sl->writeHoldTime / 1000000.0, cMetrics::Label("lock", sl->name));
+      }
+}
+
+uint64_t cStateLock::WriteHoldTime(const char *Name)
+{
+  cMutexLock MutexLock(&StateLocksMutex());
+  for (cStateLock *sl = stateLocks; sl; sl = sl->nextStateLock) {
+      if (sl->name && strcmp(sl->name, Name) == 0 && sl->Reported())
+         return sl->writeHoldTime;
+      }
+  return 0;
 }
 
 bool cStateLock::Lock(cStateKey &StateKey, bool Write, int TimeoutMs)
@@ -731,24 +1360,36 @@ bool cStateLock::Lock(cStateKey &StateKey, bool Write, int TimeoutMs)
      ABORT;
      return false;
      }
-  if (rwLock.Lock(Write, TimeoutMs)) {
+  uint64_t WaitStart = cTimeMs::NowUs();
+  bool Locked = rwLock.Lock(Write, TimeoutMs, StateKey.readerSlot);
+  uint64_t Wait = cTimeMs::NowUs() - WaitStart;
+  locks++;
+  waitTime += Wait;
+  if (Wait > maxWaitTime)
+     maxWaitTime = Wait;
+  bool Profile = cLockProfiler::Active();
+  if (Profile)
+     cLockProfiler::Record(histograms[0], name, false, Wait);
+  if (Locked) {
      dbglockseq(name, true, Write);
      StateKey.stateLock = this;
      if (Write) {
         dbglocking("%5d %-12s %10p   locked write\n", cThread::ThreadId(), name, &StateKey);
         threadId = cThread::ThreadId();
         StateKey.write = true;
+        StateKey.lockTime = cTimeMs::NowUs();
         return true;
         }
      else if (state != StateKey.state) {
         dbglocking("%5d %-12s %10p   locked read\n", cThread::ThreadId(), name, &StateKey);
+        StateKey.lockTime = Profile ? cTimeMs::NowUs() : 0;
         return true;
         }
      else {
         dbglocking("%5d %-12s %10p   state unchanged\n", cThread::ThreadId(), name, &StateKey);
         StateKey.stateLock = NULL;
         dbglockseq(name, false, false);
-        rwLock.Unlock();
+        rwLock.Unlock(false, StateKey.readerSlot);
         }
      }
   else if (TimeoutMs) {
@@ -786,14 +1427,23 @@ void cStateLock::Unlock(cStateKey &StateKey, bool IncState)
      }
   StateKey.state = state;
   StateKey.stateLock = NULL;
-  if (StateKey.write) {
+  bool Write = StateKey.write;
+  if (Write) {
      StateKey.write = false;
      threadId = 0;
      explicitModify = emDisabled;
      syncStateKey = NULL;
      }
+  if (StateKey.lockTime) {
+     uint64_t Hold = cTimeMs::NowUs() - StateKey.lockTime;
+     if (Write)
+        writeHoldTime += Hold;
+     if (cLockProfiler::Active())
+        cLockProfiler::Record(histograms[1], name, true, Hold);
+     StateKey.lockTime = 0;
+     }
   dbglockseq(name, false, false);
-  rwLock.Unlock();
+  rwLock.Unlock(Write, StateKey.readerSlot);
 }
 
 void cStateLock::SetSyncStateKey(cStateKey &StateKey)
@@ -848,7 +1498,9 @@ cStateKey::cStateKey(bool IgnoreFirst)
 {
   stateLock = NULL;
   write = false;
+  readerSlot = -1;
   state = 0;
+  lockTime = 0;
   if (!IgnoreFirst)
      Reset();
 }
@@ -930,6 +1582,69 @@ bool cIoThrottle::Engaged(void)
   return count > 0;
 }
 
+// --- cIoBudget -------------------------------------------------------------
+
+#define IOBUDGETRATEINTERVAL 1000 // ms over which the recordings' write rate is measured
+#define IOBUDGETMINPERCENT     10 // background jobs always get at least this percentage of the limit
+
+cMutex cIoBudget::mutex;
+int cIoBudget::limit = 0;
+int64_t cIoBudget::credit = 0;
+int64_t cIoBudget::recorded = 0;
+int64_t cIoBudget::recordingRate = 0;
+uint64_t cIoBudget::lastRefill = 0;
+uint64_t cIoBudget::rateStart = 0;
+
+int64_t cIoBudget::Budget(void)
+{
+  if (limit <= 0 || recordingRate == 0 && recorded == 0)
+     return 0; // no limit, or no recording needs any bandwidth
+  int64_t Limit = int64_t(limit) * MEGABYTE(1);
+  return max(Limit - recordingRate, Limit * IOBUDGETMINPERCENT / 100);
+}
+
+void cIoBudget::Update(void)
+{
+  uint64_t Now = cTimeMs::Now();
+  if (Now - rateStart >= IOBUDGETRATEINTERVAL) {
+     recordingRate = rateStart ? recorded * 1000 / int64_t(Now - rateStart) : 0;
+     recorded = 0;
+     rateStart = Now;
+     }
+  if (int64_t Rate = Budget())
+     credit = min(credit + Rate * int64_t(Now - lastRefill) / 1000, Rate); // at most one second's worth
+  else
+     credit = 0;
+  lastRefill = Now;
+}
+
+void cIoBudget::SetLimit(int MBps)
+{
+  cMutexLock MutexLock(&mutex);
+  limit = MBps;
+}
+
+void cIoBudget::Recorded(int Bytes)
+{
+  cMutexLock MutexLock(&mutex);
+  recorded += Bytes;
+}
+
+void cIoBudget::Consumed(int Bytes)
+{
+  cMutexLock MutexLock(&mutex);
+  Update();
+  if (Budget())
+     credit -= Bytes;
+}
+
+bool cIoBudget::Exhausted(void)
+{
+  cMutexLock MutexLock(&mutex);
+  Update();
+  return credit < 0;
+}
+
 // --- cPipe -----------------------------------------------------------------
 
 // cPipe::Open() and cPipe::Close() are based on code originally received from
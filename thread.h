@@ -10,7 +10,9 @@
 #ifndef __THREAD_H
 #define __THREAD_H
 
+#include <atomic>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <sys/types.h>
 
@@ -39,6 +41,59 @@ public:
        ///< Signals a caller of Wait() that the condition it is waiting for is met.
   };
 
+class cWakeup {
+private:
+  int fd;
+public:
+  cWakeup(void);
+  ~cWakeup();
+  int Fd(void) const { return fd; }
+       ///< Returns a file handle that becomes readable when Signal() has been
+       ///< called. This can be added to the file handles a thread waits for with
+       ///< poll() or epoll_wait(), so that it can be woken up without having to
+       ///< periodically check for changes.
+  void Signal(void);
+       ///< Wakes up a thread that waits for Fd() (or in Wait()).
+  bool Clear(void);
+       ///< Resets the signaled state and returns true if Signal() has been called
+       ///< since the last call to Clear() (or Wait()). This must be called when
+       ///< Fd() has become readable.
+  bool Wait(int TimeoutMs = 0);
+       ///< Waits at most TimeoutMs milliseconds for a call to Signal(), or
+       ///< forever if TimeoutMs is 0.
+       ///< Returns true if Signal() has been called, false if the given
+       ///< timeout has expired.
+  };
+
+// cLockProfiler measures how long threads wait for and hold cStateLocks and
+// cMutexes. It is off by default, and can be switched on and off at runtime
+// (see the SVDRP command STAT LOCKS). While it is active, the wait and hold
+// times of each named state lock (and of all mutexes together) are counted in
+// histograms, and every wait or hold that takes longer than LOCKPROFILESLOW
+// microseconds is attributed to its call site (identified by its backtrace), so
+// that the worst offenders can be listed.
+
+#define LOCKPROFILEBUCKETS     7 // <10us, <100us, <1ms, <10ms, <100ms, <1s, >=1s
+#define LOCKPROFILESLOW     1000 // us
+
+class cStringList;
+
+class cLockProfiler {
+private:
+  static std::atomic_bool active;
+public:
+  static bool Active(void) { return active.load(std::memory_order_relaxed); }
+  static void SetActive(bool On);
+       ///< Switches profiling on or off. Switching it on discards all previous
+       ///< results.
+  static void Record(std::atomic_int *Histogram, const char *Lock, bool Hold, uint64_t Time);
+       ///< Records in the given Histogram that Lock has been waited for (or held,
+       ///< if Hold is true) for Time microseconds.
+  static void Report(cStringList &Lines);
+       ///< Appends the histograms of all locks and the call sites with the longest
+       ///< total wait and hold times to Lines.
+  };
+
 class cMutex;
 
 class cCondVar {
@@ -69,6 +124,9 @@ class cMutex {
 private:
   pthread_mutex_t mutex;
   int locked;
+  uint64_t lockTime; // when the lock profiler is active, the time this mutex has been locked
+  void ProfileAcquire(void);
+  void ProfileRelease(void);
 public:
   cMutex(void);
   ~cMutex();
@@ -76,6 +134,36 @@ public:
   void Unlock(void);
   };
 
+#define RWLOCKSLOTS 64 // number of reader slots of a cReaderBiasedRwLock (should be at least the number of CPUs)
+
+class cReaderBiasedRwLock {
+private:
+  struct alignas(64) tReaderSlot { // each slot has a cache line of its own
+    std::atomic_int readers;
+    };
+  cRwLock rwLock;
+  cMutex biasMutex;
+  std::atomic_bool readerBias;
+  std::atomic_int writers;
+  std::atomic<uint64_t> inhibitUntil;
+  tReaderSlot slots[RWLOCKSLOTS];
+  bool Drain(uint64_t Deadline);
+public:
+  cReaderBiasedRwLock(void);
+  bool Lock(bool Write, int TimeoutMs, int &Slot);
+       ///< Works like cRwLock::Lock(). As long as no thread tries to obtain a
+       ///< write lock, read locks are obtained by merely incrementing a counter in
+       ///< one of several reader slots (selected by the CPU the caller is running on),
+       ///< so that readers on different CPUs don't contend for the same memory.
+       ///< A writer first revokes this "reader bias", waits until all readers have
+       ///< left their slots, and then obtains the underlying cRwLock. The reader
+       ///< bias is restored by a later reader, after a period of time proportional
+       ///< to how long the revocation took.
+       ///< Slot returns the reader slot that has been used to obtain a read lock,
+       ///< or -1, and must be given to the matching call to Unlock().
+  void Unlock(bool Write, int Slot);
+  };
+
 class cThread {
   friend class cThreadLock;
 private:
@@ -86,7 +174,13 @@ private:
   cMutex mutex;
   char *description;
   bool lowPriority;
+  bool registered;
+  cThread *nextThread;
+  static cThread *threads;
+  static cMutex threadsMutex;
   static tThreadId mainThreadId;
+  void Register(void);
+  void Unregister(void);
   static void *StartThread(cThread *Thread);
 protected:
   void SetPriority(int Priority);
@@ -127,11 +221,42 @@ public:
        ///< If the thread is already running, nothing happens.
   bool Active(void);
        ///< Checks whether the thread is still alive.
+  static void CancelAll(int WaitSeconds);
+       ///< Tells all threads that have been started through cThread (except for
+       ///< the calling one) to stop at once, and then waits up to WaitSeconds
+       ///< seconds for all of them to end. This way stopping the program takes
+       ///< as long as the slowest thread needs to end, instead of the sum of
+       ///< all of them. Threads that don't end in time are not killed here,
+       ///< this is left to the Cancel() call of their owner.
   static tThreadId ThreadId(void);
   static tThreadId IsMainThread(void) { return ThreadId() == mainThreadId; }
   static void SetMainThreadId(void);
   };
 
+// cThreadStatistics keeps track of all running cThread objects and reports the
+// resources (CPU time and context switches) each thread of the program has used,
+// as provided by the kernel in /proc/self/task. Threads that have not been
+// started through cThread (like the main thread) are reported with the name
+// given to them by the kernel.
+
+class cStringList;
+
+class cThreadStatistics {
+  friend class cThread;
+private:
+  static void Register(tThreadId ThreadId, const char *Description);
+  static void Unregister(tThreadId ThreadId);
+public:
+  static void Report(cStringList &Lines);
+       ///< Appends one line for each thread of the program to Lines, containing
+       ///< its id and name, the CPU time it has used so far (in milliseconds),
+       ///< and the number of voluntary and involuntary context switches. The
+       ///< threads are sorted by descending CPU time.
+  static void Log(void);
+       ///< Logs the threads that have used the most CPU time since the previous
+       ///< call to this function.
+  };
+
 // cMutexLock can be used to easily set a lock on mutex and make absolutely
 // sure that it will be unlocked when the block will be left. Several locks can
 // be stacked, so a function that makes many calls to another function which uses
@@ -167,17 +292,29 @@ public:
 #define LOCK_THREAD cThreadLock ThreadLock(this)
 
 class cStateKey;
+class cMetrics;
 
 class cStateLock {
   friend class cStateKey;
 private:
   enum { emDisabled = 0, emArmed, emEnabled };
+  static cStateLock *stateLocks;
+  cStateLock *nextStateLock;
+  std::atomic<uint64_t> locks;
+  std::atomic<uint64_t> waitTime; // the total time spent waiting for this lock (in microseconds)
+  std::atomic<uint64_t> maxWaitTime; // the longest single wait for this lock (in microseconds)
+  std::atomic<uint64_t> writeHoldTime; // the total time write locks have been held (in microseconds)
+  std::atomic_int histograms[2][LOCKPROFILEBUCKETS]; // wait and hold times, if the lock profiler is active
   const char *name;
   tThreadId threadId;
-  cRwLock rwLock;
+  cReaderBiasedRwLock rwLock;
   int state;
   int explicitModify;
   cStateKey *syncStateKey;
+  bool Reported(void) const;
+       ///< Returns true if this lock is to be included in reports, which is the case
+       ///< if it has a name and is the oldest lock with that name (other locks with
+       ///< the same name belong to temporary copies of a global list).
   void Unlock(cStateKey &StateKey, bool IncState = true);
        ///< Releases a lock that has been obtained by a previous call to Lock()
        ///< with the given StateKey. If this was a write-lock, and IncState is true,
@@ -185,6 +322,7 @@ private:
        ///< of the lock will be copied to the StateKey's state.
 public:
   cStateLock(const char *Name = NULL);
+  ~cStateLock();
   bool Lock(cStateKey &StateKey, bool Write = false, int TimeoutMs = 0);
        ///< Tries to get a lock and returns true if successful.
        ///< If TimoutMs is not 0, it waits for the given number of milliseconds
@@ -228,6 +366,16 @@ public:
        ///< Sets this lock to have its state incremented when the current write lock
        ///< state key is removed. Must have called SetExplicitModify() before calling
        ///< this function.
+  static void AddMetrics(cMetrics &Metrics);
+       ///< Adds the number of calls to Lock(), the total and maximum time spent
+       ///< waiting in them, and the total time write locks have been held, of all
+       ///< named state locks to Metrics.
+  static uint64_t WriteHoldTime(const char *Name);
+       ///< Returns the total time (in microseconds) write locks have been held on
+       ///< the state lock with the given Name (as in "5 Schedules").
+  static void ProfileReport(cStringList &Lines);
+       ///< Appends the lock profiler's histograms of all named state locks to Lines.
+  static void ProfileClear(void);
   };
 
 class cStateKey {
@@ -235,8 +383,10 @@ class cStateKey {
 private:
   cStateLock *stateLock;
   bool write;
+  int readerSlot;
   int state;
   bool timedOut;
+  uint64_t lockTime; // the time a write lock (or, if the lock profiler is active, any lock) has been obtained
 public:
   cStateKey(bool IgnoreFirst = false);
        ///< Sets up a new state key. If IgnoreFirst is true, the first use
@@ -286,6 +436,32 @@ public:
        ///< Returns true if any I/O throttling object is currently active.
   };
 
+class cIoBudget {
+private:
+  static cMutex mutex;
+  static int limit;
+  static int64_t credit;
+  static int64_t recorded;
+  static int64_t recordingRate;
+  static uint64_t lastRefill;
+  static uint64_t rateStart;
+  static int64_t Budget(void);
+  static void Update(void);
+public:
+  static void SetLimit(int MBps);
+       ///< Sets the total disk bandwidth (in MB/s) that background jobs and
+       ///< recordings may use together. While recordings are writing data, the
+       ///< budget for background jobs is what's left after subtracting their
+       ///< write rate. 0 means no limit.
+  static void Recorded(int Bytes);
+       ///< Tells the I/O budget that a recording has written the given number of Bytes.
+  static void Consumed(int Bytes);
+       ///< Tells the I/O budget that a background job has written the given number of Bytes.
+  static bool Exhausted(void);
+       ///< Returns true if background jobs have used up their current budget and
+       ///< should wait a while before writing any more data.
+  };
+
 // cPipe implements a pipe that closes all unnecessary file descriptors in
 // the child process.
 
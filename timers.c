@@ -1007,11 +1007,10 @@ bool cTimer::SetEventFromSchedule(const cSchedules *Schedules)
            CalcStartStopTime(startTime, stopTime);
            time_t TimeFrameBegin = startTime - EPGLIMITBEFORE;
            time_t TimeFrameEnd   = stopTime  + EPGLIMITAFTER;
-           for (const cEvent *e = Schedule->Events()->First(); e; e = Schedule->Events()->Next(e)) {
-               if (e->EndTime() < TimeFrameBegin)
-                  continue; // skip events way before the timer starts
-               if (e->StartTime() > TimeFrameEnd)
-                  break; // the rest is way after the timer ends
+           cVector<const cEvent *> Events;
+           Schedule->GetEventsBetween(TimeFrameBegin, TimeFrameEnd, Events);
+           for (int i = 0; i < Events.Size(); i++) {
+               const cEvent *e = Events[i];
                int overlap = 0;
                Matches(e, &overlap);
                if (overlap && overlap >= Overlap) {
@@ -1172,6 +1171,7 @@ cTimers::cTimers(void)
 :cConfig<cTimer>("1 Timers")
 {
   lastDeleteExpired = 0;
+  SetSaveInBackground(true);
 }
 
 bool cTimers::Load(const char *FileName)
@@ -1579,3 +1579,260 @@ cSortedTimers::cSortedTimers(const cTimers *Timers)
       Append(Timer);
   Sort(CompareTimers);
 }
+
+// --- Timer conflicts -------------------------------------------------------
+
+cTimerConflict::cTimerConflict(int TimerId, time_t Start, time_t Stop, time_t ConflictStart)
+{
+  timerId = TimerId;
+  start = Start;
+  stop = Stop;
+  conflictStart = ConflictStart;
+}
+
+// A recording of one occurrence of a timer:
+
+class cConflictRecording {
+public:
+  int timerId;
+  const cChannel *channel;
+  int priority;
+  time_t start;
+  time_t stop;
+  time_t lost; // the time from which on this recording can't be done (0 = no conflict)
+  cConflictRecording(int TimerId, const cChannel *Channel, int Priority, time_t Start, time_t Stop) {
+    timerId = TimerId;
+    channel = Channel;
+    priority = Priority;
+    start = Start;
+    stop = Stop;
+    lost = 0;
+    }
+  };
+
+// The model of a device, with the recordings that are currently assigned to it:
+
+class cConflictDevice {
+public:
+  cDevice *device;
+  int camSlot; // the index of the CAM slot currently used by this device (-1 = none)
+  int usable;  // the number of recordings this device could basically be used for
+  cVector<cConflictRecording *> recordings;
+  cConflictDevice(cDevice *Device) { device = Device; camSlot = -1; usable = 0; }
+  const cChannel *Transponder(void) const { return recordings.Size() ? recordings[0]->channel : NULL; }
+  int MaxPriority(void) const;
+  void Expire(time_t Time, int *CamDevice);
+  };
+
+int cConflictDevice::MaxPriority(void) const
+{
+  int Priority = IDLEPRIORITY;
+  for (int i = 0; i < recordings.Size(); i++)
+      Priority = max(Priority, recordings[i]->priority);
+  return Priority;
+}
+
+void cConflictDevice::Expire(time_t Time, int *CamDevice)
+{
+  for (int i = recordings.Size(); i-- > 0; ) {
+      if (recordings[i]->stop <= Time)
+         recordings.Remove(i);
+      }
+  if (!recordings.Size() && camSlot >= 0) {
+     CamDevice[camSlot] = -1;
+     camSlot = -1;
+     }
+}
+
+static bool SameTransponder(const cChannel *Channel1, const cChannel *Channel2)
+{
+  return Channel1->Source() == Channel2->Source() && ISTRANSPONDER(Channel1->Transponder(), Channel2->Transponder());
+}
+
+static int CompareConflictRecordings(const void *a, const void *b)
+{
+  const cConflictRecording *r1 = *(const cConflictRecording **)a;
+  const cConflictRecording *r2 = *(const cConflictRecording **)b;
+  if (r1->start != r2->start)
+     return r1->start < r2->start ? -1 : 1;
+  if (r1->priority != r2->priority)
+     return r2->priority - r1->priority; // higher priorities first
+  return r1->timerId - r2->timerId;
+}
+
+cTimerConflicts::cTimerConflicts(void)
+{
+  checksum = 0;
+}
+
+bool cTimerConflicts::Check(const cTimers *Timers, int Days)
+{
+  time_t Now = time(NULL);
+  time_t Limit = Now + Days * SECSINDAY;
+  // Collect all recordings within the given time frame:
+  cVector<cConflictRecording *> Recordings;
+  for (const cTimer *Timer = Timers->First(); Timer; Timer = Timers->Next(Timer)) {
+      if (!Timer->Local() || !Timer->HasFlags(tfActive) || Timer->IsPatternTimer() || !Timer->Channel())
+         continue;
+      if (Timer->HasFlags(tfVps) && Timer->Event()) {
+         if (Timer->Event()->EndTime() > Now && Timer->Event()->StartTime() < Limit)
+            Recordings.Append(new cConflictRecording(Timer->Id(), Timer->Channel(), Timer->Priority(), Timer->Event()->StartTime(), Timer->Event()->EndTime()));
+         continue;
+         }
+      time_t t = Now;
+      while (t < Limit) {
+            time_t Start, Stop;
+            Timer->CalcStartStopTime(Start, Stop, t);
+            if (!Stop || Start >= Limit || Stop <= t)
+               break;
+            Recordings.Append(new cConflictRecording(Timer->Id(), Timer->Channel(), Timer->Priority(), Start, Stop));
+            if (Timer->IsSingleEvent())
+               break;
+            t = Stop;
+            }
+      }
+  Recordings.Sort(CompareConflictRecordings);
+  // Check whether anything has changed since the last call:
+  int NumCamSlots = CamSlots.Count();
+  uint32_t Crc = 0xFFFFFFFF;
+  for (int i = 0; i < Recordings.Size(); i++) {
+      const cConflictRecording *r = Recordings[i];
+      tChannelID ChannelID = r->channel->GetChannelID();
+      int Ca = r->channel->Ca();
+      time_t Times[2] = { r->start, r->stop };
+      Crc = SI::CRC32::crc32((const char *)&r->timerId, sizeof(r->timerId), Crc);
+      Crc = SI::CRC32::crc32((const char *)&r->priority, sizeof(r->priority), Crc);
+      Crc = SI::CRC32::crc32((const char *)Times, sizeof(Times), Crc);
+      Crc = SI::CRC32::crc32((const char *)&ChannelID, sizeof(ChannelID), Crc);
+      Crc = SI::CRC32::crc32((const char *)&Ca, sizeof(Ca), Crc);
+      }
+  for (cCamSlot *CamSlot = CamSlots.First(); CamSlot; CamSlot = CamSlots.Next(CamSlot)) {
+      bool Ready = CamSlot->ModuleStatus() == msReady;
+      Crc = SI::CRC32::crc32((const char *)&Ready, sizeof(Ready), Crc);
+      }
+  if (Crc == checksum && checksum) {
+     for (int i = 0; i < Recordings.Size(); i++)
+         delete Recordings[i];
+     return Count() > 0;
+     }
+  checksum = Crc;
+  Clear();
+  // Set up the models of the devices and CAM slots:
+  cVector<cConflictDevice *> Devices;
+  for (int i = 0; i < cDevice::NumDevices(); i++) {
+      if (cDevice *Device = cDevice::GetDevice(i)) {
+         cConflictDevice *cd = new cConflictDevice(Device);
+         for (int j = 0; j < Recordings.Size(); j++) {
+             if (Device->ProvidesTransponder(Recordings[j]->channel))
+                cd->usable++;
+             }
+         Devices.Append(cd);
+         }
+      }
+  int CamDevice[NumCamSlots + 1]; // the device a CAM slot is currently used with (-1 = none), +1 to avoid a zero sized array
+  for (int i = 0; i < NumCamSlots; i++)
+      CamDevice[i] = -1;
+  // Assign the recordings to the devices in the sequence of their start times:
+  for (int i = 0; i < Recordings.Size(); i++) {
+      cConflictRecording *r = Recordings[i];
+      const cChannel *Channel = r->channel;
+      bool Encrypted = Channel->Ca() >= CA_ENCRYPTED_MIN;
+      int Device = -1;
+      int CamSlot = -1;
+      int Preempt = -1;
+      int PreemptPriority = r->priority;
+      uint32_t Impact = 0xFFFFFFFF;
+      for (int d = 0; d < Devices.Size(); d++) {
+          cConflictDevice *cd = Devices[d];
+          cd->Expire(r->start, CamDevice);
+          if (Channel->Ca() && Channel->Ca() <= CA_DVB_MAX && Channel->Ca() != cd->device->DeviceNumber() + 1)
+             continue; // a specific card was requested, but not this one
+          if (!cd->device->ProvidesTransponder(Channel))
+             continue;
+          // Find a CAM slot for this device, if necessary:
+          int cs = -1;         // the CAM slot to use, if the device is free (or made free)
+          bool CamOk = true;   // the device can decrypt the channel with its current CAM slot
+          if (Encrypted && !cd->device->HasInternalCam()) {
+             CamOk = false;
+             for (cCamSlot *s = CamSlots.First(); s; s = CamSlots.Next(s)) {
+                 if (!s->IsMasterSlot() || s->ModuleStatus() != msReady || !s->ProvidesCa(Channel->Caids()) || !s->Assign(cd->device, true))
+                    continue;
+                 if (s->Index() == cd->camSlot)
+                    CamOk = true;
+                 if (s->MtdActive() || CamDevice[s->Index()] < 0 || CamDevice[s->Index()] == d || s->Index() == cd->camSlot) {
+                    if (cs < 0 || s->Index() == cd->camSlot)
+                       cs = s->Index();
+                    }
+                 }
+             if (cs < 0)
+                continue; // no CAM can decrypt this channel with this device
+             if (cd->camSlot < 0 && cs >= 0)
+                CamOk = true; // the device doesn't use a CAM, yet, so it can take this one
+             }
+          const cChannel *Transponder = cd->Transponder();
+          if (!Transponder || SameTransponder(Transponder, Channel) && CamOk) {
+             // Put together the "impact" of using this device, similar to cDevice::GetDevice():
+             uint32_t imp = 0;
+             imp <<= 1; imp |= Transponder == NULL;                                    // prefer devices that already receive this transponder
+             imp <<= 16; imp |= min(cd->usable, 0xFFFF);                               // prefer the devices that are useful for the fewest other recordings
+             imp <<= 5; imp |= constrain(cd->device->NumProvidedSystems(), 1, 32) - 1; // avoid cards which support multiple delivery systems
+             imp <<= 1; imp |= !Encrypted && cd->device->HasCi();                      // avoid cards with Common Interface for FTA channels
+             imp <<= 1; imp |= cd->device->IsPrimaryDevice();                          // avoid the primary device
+             if (imp < Impact) {
+                Impact = imp;
+                Device = d;
+                CamSlot = cs;
+                }
+             }
+          else if (Device < 0 && cd->MaxPriority() < PreemptPriority) {
+             // This device could be used if the recordings on it were interrupted:
+             bool CamFree = !Encrypted || cd->device->HasInternalCam() || cs >= 0;
+             if (CamFree) {
+                PreemptPriority = cd->MaxPriority();
+                Preempt = d;
+                }
+             }
+          }
+      if (Device < 0 && Preempt >= 0) {
+         cConflictDevice *cd = Devices[Preempt];
+         for (int j = 0; j < cd->recordings.Size(); j++) {
+             if (!cd->recordings[j]->lost)
+                cd->recordings[j]->lost = r->start;
+             }
+         cd->recordings.Clear();
+         if (cd->camSlot >= 0)
+            CamDevice[cd->camSlot] = -1;
+         cd->camSlot = -1;
+         Device = Preempt;
+         if (Encrypted && !cd->device->HasInternalCam()) {
+            // Find the CAM slot again, now that the device has been made free:
+            for (cCamSlot *s = CamSlots.First(); s; s = CamSlots.Next(s)) {
+                if (s->IsMasterSlot() && s->ModuleStatus() == msReady && s->ProvidesCa(Channel->Caids()) && s->Assign(cd->device, true) && (s->MtdActive() || CamDevice[s->Index()] < 0)) {
+                   CamSlot = s->Index();
+                   break;
+                   }
+                }
+            }
+         }
+      if (Device >= 0) {
+         cConflictDevice *cd = Devices[Device];
+         if (CamSlot >= 0 && cd->camSlot < 0) {
+            cd->camSlot = CamSlot;
+            if (!CamSlots.Get(CamSlot)->MtdActive())
+               CamDevice[CamSlot] = Device;
+            }
+         cd->recordings.Append(r);
+         }
+      else
+         r->lost = r->start;
+      }
+  for (int i = 0; i < Recordings.Size(); i++) {
+      cConflictRecording *r = Recordings[i];
+      if (r->lost)
+         Add(new cTimerConflict(r->timerId, r->start, r->stop, max(r->lost, r->start)));
+      delete r;
+      }
+  for (int i = 0; i < Devices.Size(); i++)
+      delete Devices[i];
+  return Count() > 0;
+}
@@ -280,4 +280,50 @@ public:
   cSortedTimers(const cTimers *Timers);
   };
 
+// --- Timer conflicts -------------------------------------------------------
+
+#define TIMERCONFLICTDAYS 7 // default number of days to check for timer conflicts
+
+class cTimerConflict : public cListObject {
+  friend class cTimerConflicts;
+private:
+  int timerId;
+  time_t start;
+  time_t stop;
+  time_t conflictStart;
+public:
+  cTimerConflict(int TimerId, time_t Start, time_t Stop, time_t ConflictStart);
+  int TimerId(void) const { return timerId; }
+  time_t Start(void) const { return start; }
+       ///< The start time of the affected occurrence of the timer.
+  time_t Stop(void) const { return stop; }
+       ///< The stop time of the affected occurrence of the timer.
+  time_t ConflictStart(void) const { return conflictStart; }
+       ///< The time from which on this timer can't record, either because there is
+       ///< no free device (or CAM) at its start time, or because a timer with
+       ///< a higher priority needs its device at that time. If this is the same as
+       ///< Start(), the timer can't record at all.
+  };
+
+class cTimerConflicts : public cList<cTimerConflict> {
+private:
+  uint32_t checksum;
+public:
+  cTimerConflicts(void);
+  bool Check(const cTimers *Timers, int Days = TIMERCONFLICTDAYS);
+       ///< Checks all active local timers for conflicts within the next Days days.
+       ///< Every recording is assigned to a device that can receive its channel,
+       ///< taking into account that a device can record several channels of the
+       ///< same transponder, and that an encrypted channel needs a CAM that can
+       ///< decrypt it (which, unless it is capable of MTD, can only be used with
+       ///< one device at a time). If several timers compete for the same device,
+       ///< the one with the higher priority wins, as it would when actually recording.
+       ///< Afterwards this list contains one entry for each occurrence of a timer
+       ///< that can't be fully recorded, sorted by their start times.
+       ///< If nothing relevant has changed since the previous call of this function
+       ///< on this object, the previous result is kept.
+       ///< The caller must hold a lock on the timers and the channels.
+       ///< Returns true if there are any conflicts.
+  };
+
 #endif //__TIMERS_H
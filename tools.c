@@ -18,8 +18,19 @@ extern "C" {
 #include <jpeglib.h>
 #undef boolean
 }
+#include <linux/fs.h>
 #include <locale.h>
 #include <stdlib.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define USE_IOURING
+#include <linux/io_uring.h>
+#endif
+#endif
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/vfs.h>
 #include <time.h>
@@ -809,6 +820,14 @@ uint64_t cTimeMs::Now(void)
   return 0;
 }
 
+uint64_t cTimeMs::NowUs(void)
+{
+  struct timespec tp;
+  if (clock_gettime(CLOCK_MONOTONIC, &tp) == 0)
+     return uint64_t(tp.tv_sec) * 1000000 + tp.tv_nsec / 1000;
+  return Now() * 1000;
+}
+
 void cTimeMs::Set(int Ms)
 {
   if (Ms >= 0) {
@@ -837,6 +856,54 @@ void cTimeMs::Reset(void)
   Set(end - begin);
 }
 
+// --- cLatencyHistogram -----------------------------------------------------
+
+cLatencyHistogram::cLatencyHistogram(void)
+{
+  Reset();
+}
+
+void cLatencyHistogram::Reset(void)
+{
+  for (int i = 0; i < LATENCYBUCKETS; i++)
+      buckets[i] = 0;
+  max = 0;
+}
+
+void cLatencyHistogram::Add(uint64_t Latency)
+{
+  int i = 0;
+  while (i < LATENCYBUCKETS - 1 && Latency >= (uint64_t(1) << i))
+        i++;
+  buckets[i]++;
+  uint64_t m = max;
+  while (Latency > m && !max.compare_exchange_weak(m, Latency))
+        ;
+}
+
+uint64_t cLatencyHistogram::Count(void) const
+{
+  uint64_t n = 0;
+  for (int i = 0; i < LATENCYBUCKETS; i++)
+      n += buckets[i];
+  return n;
+}
+
+uint64_t cLatencyHistogram::Percentile(double Percent) const
+{
+  uint64_t n = Count();
+  if (!n)
+     return 0;
+  uint64_t Wanted = uint64_t(ceil(n * Percent / 100));
+  uint64_t Sum = 0;
+  for (int i = 0; i < LATENCYBUCKETS; i++) {
+      Sum += buckets[i];
+      if (Sum >= Wanted)
+         return min(uint64_t(1) << i, Max());
+      }
+  return Max();
+}
+
 // --- UTF-8 support ---------------------------------------------------------
 
 static uint SystemToUtf8[128] = { 0 };
@@ -1105,50 +1172,70 @@ const char *cCharSetConv::Convert(const char *From, char *To, size_t ToLength)
 
 // --- cString ---------------------------------------------------------------
 
+void cString::Set(const char *S, int Length)
+{
+  if (Length < CSTRING_SHORT)
+     s = buf;
+  else
+     s = MALLOC(char, Length + 1);
+  memcpy(s, S, Length);
+  s[Length] = 0;
+}
+
+void cString::Take(cString &String)
+{
+  if (String.IsShort()) {
+     s = buf;
+     strcpy(buf, String.buf);
+     }
+  else
+     s = String.s;
+  String.s = NULL;
+}
+
 cString::cString(const char *S, bool TakePointer)
 {
-  s = TakePointer ? (char *)S : S ? strdup(S) : NULL;
+  s = NULL;
+  if (TakePointer)
+     s = (char *)S;
+  else if (S)
+     Set(S, strlen(S));
 }
 
 cString::cString(const char *S, const char *To)
 {
-  if (!S)
-     s = NULL;
-  else if (!To)
-     s = strdup(S);
-  else {
-     int l = To - S;
-     s = MALLOC(char, l + 1);
-     strncpy(s, S, l);
-     s[l] = 0;
-     }
+  s = NULL;
+  if (S)
+     Set(S, To ? To - S : strlen(S));
 }
 
 cString::cString(const cString &String)
 {
-  s = String.s ? strdup(String.s) : NULL;
+  s = NULL;
+  if (String.s)
+     Set(String.s, strlen(String.s));
 }
 
 cString::~cString()
 {
-  free(s);
+  Free();
 }
 
 cString &cString::operator=(const cString &String)
 {
   if (this == &String)
      return *this;
-  free(s);
-  s = String.s ? strdup(String.s) : NULL;
+  Free();
+  if (String.s)
+     Set(String.s, strlen(String.s));
   return *this;
 }
 
 cString &cString::operator=(cString &&String)
 {
   if (this != &String) {
-     free(s);
-     s = String.s;
-     String.s = NULL;
+     Free();
+     Take(String);
      }
   return *this;
 }
@@ -1157,8 +1244,13 @@ cString &cString::operator=(const char *String)
 {
   if (s == String)
     return *this;
-  free(s);
-  s = String ? strdup(String) : NULL;
+  if (String && s && String >= s && String < s + strlen(s)) {
+     cString t(String); // String points into our own buffer
+     return *this = std::move(t);
+     }
+  Free();
+  if (String)
+     Set(String, strlen(String));
   return *this;
 }
 
@@ -1167,7 +1259,20 @@ cString &cString::Append(const char *String)
   if (String) {
      int l1 = s ? strlen(s) : 0;
      int l2 = strlen(String);
-     if (char *p = (char *)realloc(s, l1 + l2 + 1)) {
+     if (!s || IsShort()) {
+        if (l1 + l2 < CSTRING_SHORT) {
+           s = buf;
+           memmove(s + l1, String, l2 + 1);
+           }
+        else if (char *p = MALLOC(char, l1 + l2 + 1)) {
+           memcpy(p, s, l1);
+           memcpy(p + l1, String, l2 + 1);
+           s = p;
+           }
+        else
+           esyslog("ERROR: out of memory");
+        }
+     else if (char *p = (char *)realloc(s, l1 + l2 + 1)) {
         s = p;
         strcpy(s + l1, String);
         }
@@ -1180,15 +1285,8 @@ cString &cString::Append(const char *String)
 cString &cString::Append(char c)
 {
   if (c) {
-     int l1 = s ? strlen(s) : 0;
-     int l2 = 1;
-     if (char *p = (char *)realloc(s, l1 + l2 + 1)) {
-        s = p;
-        *(s + l1) = c;
-        *(s + l1 + 1) = 0;
-        }
-     else
-        esyslog("ERROR: out of memory");
+     char t[2] = { c, 0 };
+     Append(t);
      }
   return *this;
 }
@@ -1213,23 +1311,32 @@ cString cString::sprintf(const char *fmt, ...)
 {
   va_list ap;
   va_start(ap, fmt);
-  char *buffer;
-  if (!fmt || vasprintf(&buffer, fmt, ap) < 0) {
-     esyslog("error in vasprintf('%s', ...)", fmt);
-     buffer = strdup("???");
-     }
+  cString s = vsprintf(fmt, ap);
   va_end(ap);
-  return cString(buffer, true);
+  return s;
 }
 
 cString cString::vsprintf(const char *fmt, va_list &ap)
 {
+  cString s;
+  if (fmt) {
+     // Try the internal buffer first, to avoid a heap allocation for short strings:
+     va_list aq;
+     va_copy(aq, ap);
+     int l = vsnprintf(s.buf, sizeof(s.buf), fmt, aq);
+     va_end(aq);
+     if (l >= 0 && l < CSTRING_SHORT) {
+        s.s = s.buf;
+        return s;
+        }
+     }
   char *buffer;
   if (!fmt || vasprintf(&buffer, fmt, ap) < 0) {
      esyslog("error in vasprintf('%s', ...)", fmt);
      buffer = strdup("???");
      }
-  return cString(buffer, true);
+  s.s = buffer;
+  return s;
 }
 
 cString WeekDayName(int WeekDay)
@@ -1500,12 +1607,27 @@ int cBitStream::GetBit(void)
 
 uint32_t cBitStream::GetBits(int n)
 {
-  uint32_t r = 0;
-  while (n--)
-        r |= GetBit() << n;
+  uint32_t r = PeekBits(n);
+  if (index < length)
+     index = min(index + n, length);
   return r;
 }
 
+uint32_t cBitStream::PeekBits(int n) const
+{
+  if (n <= 0)
+     return 0;
+  uint64_t r = 0;
+  int Bits = (index & 7) + n;
+  int Bytes = (Bits + 7) / 8;
+  for (int i = 0, p = index >> 3; i < Bytes; i++, p++)
+      r = (r << 8) | (p * 8 < length ? data[p] : 0xFF);
+  r >>= Bytes * 8 - Bits;
+  if (index + n > length) // bits beyond the end are 1
+     r |= (uint64_t(1) << min(index + n - length, n)) - 1;
+  return uint32_t(r & ((uint64_t(1) << n) - 1));
+}
+
 void cBitStream::ByteAlign(void)
 {
   int n = index % 8;
@@ -1563,10 +1685,78 @@ char *cReadLine::Read(FILE *f)
 
 cPoller::cPoller(int FileHandle, bool Out)
 {
+  pfd = fixedPfd;
+  readyPfd = fixedPfd + MinPollFiles;
   numFileHandles = 0;
+  maxFileHandles = MinPollFiles;
+  numReady = 0;
+  epollFd = -1;
+  epollEvents = NULL;
+  maxEpollEvents = 0;
   Add(FileHandle, Out);
 }
 
+cPoller::~cPoller()
+{
+  if (pfd != fixedPfd)
+     free(pfd);
+  free(epollEvents);
+  if (epollFd >= 0)
+     close(epollFd);
+}
+
+bool cPoller::Grow(void)
+{
+  // pfd and readyPfd are kept in one block of memory:
+  int NewMax = maxFileHandles * 2;
+  pollfd *p = MALLOC(pollfd, 2 * NewMax);
+  if (!p) {
+     esyslog("ERROR: can't allocate file handles in cPoller");
+     return false;
+     }
+  memcpy(p, pfd, numFileHandles * sizeof(pollfd));
+  if (pfd != fixedPfd)
+     free(pfd);
+  pfd = p;
+  readyPfd = p + NewMax;
+  maxFileHandles = NewMax;
+  numReady = 0;
+  return true;
+}
+
+void cPoller::EpollUpdate(int FileHandle)
+{
+  // epoll only allows one entry per file handle, so the events of the input
+  // and output entries of FileHandle are combined:
+  uint32_t Events = 0;
+  for (int i = 0; i < numFileHandles; i++) {
+      if (pfd[i].fd == FileHandle)
+         Events |= pfd[i].events == POLLOUT ? EPOLLOUT : EPOLLIN;
+      }
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = Events;
+  ev.data.u64 = (uint64_t(Events) << 32) | uint32_t(FileHandle); // so that Poll() knows which entries FileHandle has
+  if (!Events)
+     epoll_ctl(epollFd, EPOLL_CTL_DEL, FileHandle, &ev); // fails harmlessly if FileHandle has already been closed
+  else if (epoll_ctl(epollFd, EPOLL_CTL_MOD, FileHandle, &ev) < 0) {
+     if (errno != ENOENT || epoll_ctl(epollFd, EPOLL_CTL_ADD, FileHandle, &ev) < 0)
+        LOG_ERROR;
+     }
+}
+
+bool cPoller::EpollStart(void)
+{
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd < 0) {
+     LOG_ERROR;
+     return false;
+     }
+  for (int i = 0; i < numFileHandles; i++)
+      EpollUpdate(pfd[i].fd);
+  return true;
+}
+
 bool cPoller::Add(int FileHandle, bool Out)
 {
   if (FileHandle >= 0) {
@@ -1574,14 +1764,17 @@ bool cPoller::Add(int FileHandle, bool Out)
          if (pfd[i].fd == FileHandle && pfd[i].events == (Out ? POLLOUT : POLLIN))
             return true;
          }
-     if (numFileHandles < MaxPollFiles) {
+     if (numFileHandles < maxFileHandles || Grow()) {
         pfd[numFileHandles].fd = FileHandle;
         pfd[numFileHandles].events = Out ? POLLOUT : POLLIN;
         pfd[numFileHandles].revents = 0;
         numFileHandles++;
+        if (epollFd >= 0)
+           EpollUpdate(FileHandle);
+        else if (numFileHandles > MaxPollFiles)
+           EpollStart(); // if this fails we simply continue with poll()
         return true;
         }
-     esyslog("ERROR: too many file handles in cPoller");
      }
   return false;
 }
@@ -1594,6 +1787,8 @@ void cPoller::Del(int FileHandle, bool Out)
             if (i < numFileHandles - 1)
                memmove(&pfd[i], &pfd[i + 1], (numFileHandles - i - 1) * sizeof(pollfd));
             numFileHandles--;
+            if (epollFd >= 0)
+               EpollUpdate(FileHandle);
             }
          }
      }
@@ -1601,16 +1796,61 @@ void cPoller::Del(int FileHandle, bool Out)
 
 bool cPoller::Poll(int TimeoutMs)
 {
+  numReady = 0;
   if (numFileHandles) {
      if (TimeoutMs == 0)
         TimeoutMs = 1; // can't let it be 0, otherwise poll() returns immediately, even if no file descriptors are ready
-     if (poll(pfd, numFileHandles, TimeoutMs) != 0)
+     if (epollFd >= 0) {
+        if (maxEpollEvents < maxFileHandles) {
+           free(epollEvents);
+           epollEvents = MALLOC(epoll_event, maxFileHandles);
+           maxEpollEvents = epollEvents ? maxFileHandles : 0;
+           }
+        int n = epoll_wait(epollFd, epollEvents, maxEpollEvents, TimeoutMs);
+        for (int i = 0; i < n && numReady < maxFileHandles - 1; i++) {
+            int FileHandle = int(epollEvents[i].data.u64 & 0xFFFFFFFF);
+            uint32_t Registered = epollEvents[i].data.u64 >> 32;
+            uint32_t Events = epollEvents[i].events;
+            if (Events & (EPOLLERR | EPOLLHUP))
+               Events |= Registered; // errors are reported for every entry of the file handle, like poll() does
+            if (Registered & Events & EPOLLIN) {
+               readyPfd[numReady].fd = FileHandle;
+               readyPfd[numReady].events = POLLIN;
+               readyPfd[numReady++].revents = POLLIN;
+               }
+            if (Registered & Events & EPOLLOUT) {
+               readyPfd[numReady].fd = FileHandle;
+               readyPfd[numReady].events = POLLOUT;
+               readyPfd[numReady++].revents = POLLOUT;
+               }
+            }
+        return n != 0; // returns true even in case of an error, to let the caller
+                       // access the file and thus see the error code
+        }
+     int n = poll(pfd, numFileHandles, TimeoutMs);
+     if (n > 0) {
+        for (int i = 0; i < numFileHandles; i++) {
+            if (pfd[i].revents)
+               readyPfd[numReady++] = pfd[i];
+            }
+        }
+     if (n != 0)
         return true; // returns true even in case of an error, to let the caller
                      // access the file and thus see the error code
      }
   return false;
 }
 
+int cPoller::Ready(int Index, bool *Out) const
+{
+  if (Index >= 0 && Index < numReady) {
+     if (Out)
+        *Out = readyPfd[Index].events == POLLOUT;
+     return readyPfd[Index].fd;
+     }
+  return -1;
+}
+
 // --- cReadDir --------------------------------------------------------------
 
 cReadDir::cReadDir(const char *Directory)
@@ -1810,6 +2050,424 @@ bool cSafeFile::Close(void)
   return result;
 }
 
+// --- I/O buffers -----------------------------------------------------------
+
+// Buffers used for O_DIRECT (and io_uring) writes must be aligned to the logical
+// block size of the device. Since a recording opens a new file every few GB, the
+// buffers are kept in a small pool instead of being allocated for every file.
+
+#define IOBUFFER_ALIGN  KILOBYTE(4) // covers devices with 512 and 4096 byte sectors
+#define IOBUFFER_SIZE   MEGABYTE(1)
+#define IOBUFFER_POOL   8
+
+static cMutex IoBufferMutex;
+static uchar *IoBufferPool[IOBUFFER_POOL] = { NULL };
+static int IoBufferPoolCount = 0;
+
+static uchar *GetIoBuffer(void)
+{
+  cMutexLock MutexLock(&IoBufferMutex);
+  if (IoBufferPoolCount > 0)
+     return IoBufferPool[--IoBufferPoolCount];
+  void *p;
+  if (posix_memalign(&p, IOBUFFER_ALIGN, IOBUFFER_SIZE) == 0)
+     return (uchar *)p;
+  esyslog("ERROR: can't allocate I/O buffer");
+  return NULL;
+}
+
+static void PutIoBuffer(uchar *Buffer)
+{
+  if (Buffer) {
+     cMutexLock MutexLock(&IoBufferMutex);
+     if (IoBufferPoolCount < IOBUFFER_POOL)
+        IoBufferPool[IoBufferPoolCount++] = Buffer;
+     else
+        free(Buffer);
+     }
+}
+
+// --- Large buffers ---------------------------------------------------------
+
+// The big ring buffers for TS data are allocated directly with mmap(), so that
+// they can use huge pages (which saves TLB misses when streaming through many
+// megabytes of data) and can be bound to the NUMA node of the device they serve.
+
+#define HUGEPAGESIZE  MEGABYTE(2)
+
+#define MPOL_PREFERRED_  1      // from <numaif.h>, which is only available with libnuma
+#define MPOL_MF_MOVE_    (1 << 1)
+
+static size_t LargeBufferLength(size_t Size)
+{
+  if (Size >= size_t(HUGEPAGESIZE))
+     return (Size + HUGEPAGESIZE - 1) / HUGEPAGESIZE * HUGEPAGESIZE;
+  return Size;
+}
+
+uchar *AllocLargeBuffer(size_t Size)
+{
+  size_t Length = LargeBufferLength(Size);
+  void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (Size >= size_t(HUGEPAGESIZE))
+     p = mmap(NULL, Length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0); // fails if there are not enough reserved huge pages
+#endif
+  if (p == MAP_FAILED) {
+     p = mmap(NULL, Length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+     if (p == MAP_FAILED) {
+        LOG_ERROR;
+        return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+     if (Length >= size_t(HUGEPAGESIZE))
+        madvise(p, Length, MADV_HUGEPAGE);
+#endif
+     }
+  return (uchar *)p;
+}
+
+void FreeLargeBuffer(uchar *Buffer, size_t Size)
+{
+  if (Buffer)
+     munmap(Buffer, LargeBufferLength(Size));
+}
+
+bool SetLargeBufferNode(uchar *Buffer, size_t Size, int Node)
+{
+#ifdef SYS_mbind
+  if (Buffer && Node >= 0) {
+     unsigned long Mask[4] = { 0 };
+     const int Bits = sizeof(Mask[0]) * 8;
+     if (Node < int(sizeof(Mask) * 8)) {
+        Mask[Node / Bits] = 1UL << (Node % Bits);
+        if (syscall(SYS_mbind, Buffer, LargeBufferLength(Size), MPOL_PREFERRED_, Mask, sizeof(Mask) * 8 + 1, MPOL_MF_MOVE_) == 0)
+           return true;
+        if (errno != ENOSYS && errno != EPERM)
+           LOG_ERROR;
+        }
+     }
+#endif
+  return false;
+}
+
+// --- cIoUringWriter --------------------------------------------------------
+
+// Writes data asynchronously through io_uring. The data is copied into a few
+// staging buffers, which are written at explicit file offsets, so the caller
+// only has to wait if all of them are still in flight. Every IOURING_SYNCDELTA
+// bytes a datasync plus a POSIX_FADV_DONTNEED of the synced range is queued,
+// which keeps the recording data out of the page cache without any blocking
+// fdatasync() in the caller's thread.
+
+#ifdef USE_IOURING
+
+#define IOURING_ENTRIES    16
+#define IOURING_BUFFERS     4
+#define IOURING_SYNCDELTA  MEGABYTE(32)
+#define IOURING_SYNC       (~uint64_t(0)) // user_data of the datasync and fadvise requests
+
+class cIoUringWriter {
+private:
+  int fd;
+  int ringFd;
+  void *sqRing, *cqRing;
+  size_t sqRingSize, cqRingSize;
+  io_uring_sqe *sqes;
+  size_t sqesSize;
+  unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  io_uring_cqe *cqes;
+  struct tBuffer {
+    uchar *data;
+    int fill;
+    int done;  // bytes already written in case of a short write
+    off_t pos; // file offset of data[0]
+    bool busy;
+    } buffers[IOURING_BUFFERS];
+  int current;
+  int inFlight;
+  int error;
+  off_t offset;
+  off_t synced;
+  cIoUringWriter(int Fd, off_t Offset);
+  bool Setup(void);
+  io_uring_sqe *GetSqe(void);
+  bool Submit(int WaitFor);
+  void QueueWrite(int Index);
+  void QueueSync(void);
+  int GetBuffer(void);
+  void HandleCompletions(void);
+public:
+  ~cIoUringWriter();
+  static cIoUringWriter *Create(int Fd, off_t Offset);
+       ///< Creates an io_uring writer for the given file handle, which will be written
+       ///< to starting at Offset. Returns NULL if the kernel doesn't support io_uring
+       ///< (or not all the operations needed).
+  ssize_t Write(const void *Data, size_t Size);
+  bool Flush(bool Pad = false);
+       ///< Writes all pending data and waits until all requests have been completed.
+       ///< If Pad is true, the last write is padded to a multiple of IOBUFFER_ALIGN
+       ///< (as required for O_DIRECT) and the file is truncated to its actual size
+       ///< afterwards. No further data can be written with O_DIRECT after that.
+  off_t Offset(void) { return offset; }
+  void SetOffset(off_t Offset) { offset = synced = Offset; }
+  };
+
+cIoUringWriter::cIoUringWriter(int Fd, off_t Offset)
+{
+  fd = Fd;
+  ringFd = -1;
+  sqRing = cqRing = MAP_FAILED;
+  sqRingSize = cqRingSize = 0;
+  sqes = (io_uring_sqe *)MAP_FAILED;
+  sqesSize = 0;
+  memset(buffers, 0, sizeof(buffers));
+  current = -1;
+  inFlight = 0;
+  error = 0;
+  offset = synced = Offset;
+}
+
+cIoUringWriter::~cIoUringWriter()
+{
+  if (ringFd >= 0) {
+     Flush();
+     close(ringFd);
+     }
+  if (sqes != MAP_FAILED)
+     munmap(sqes, sqesSize);
+  if (cqRing != MAP_FAILED && cqRing != sqRing)
+     munmap(cqRing, cqRingSize);
+  if (sqRing != MAP_FAILED)
+     munmap(sqRing, sqRingSize);
+  for (int i = 0; i < IOURING_BUFFERS; i++)
+      PutIoBuffer(buffers[i].data);
+}
+
+cIoUringWriter *cIoUringWriter::Create(int Fd, off_t Offset)
+{
+  cIoUringWriter *Writer = new cIoUringWriter(Fd, Offset);
+  if (Writer->Setup())
+     return Writer;
+  delete Writer;
+  return NULL;
+}
+
+bool cIoUringWriter::Setup(void)
+{
+  io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  ringFd = syscall(__NR_io_uring_setup, IOURING_ENTRIES, &p);
+  if (ringFd < 0)
+     return false;
+  if (!(p.features & IORING_FEAT_FAST_POLL)) // implies IORING_OP_WRITE and IORING_OP_FADVISE (Linux 5.7)
+     return false;
+  sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+     sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+  sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  if (sqRing == MAP_FAILED)
+     return false;
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+     cqRing = sqRing;
+  else {
+     cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+     if (cqRing == MAP_FAILED)
+        return false;
+     }
+  sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+  sqes = (io_uring_sqe *)mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+     return false;
+  sqHead  = (unsigned *)((char *)sqRing + p.sq_off.head);
+  sqTail  = (unsigned *)((char *)sqRing + p.sq_off.tail);
+  sqMask  = (unsigned *)((char *)sqRing + p.sq_off.ring_mask);
+  sqArray = (unsigned *)((char *)sqRing + p.sq_off.array);
+  cqHead  = (unsigned *)((char *)cqRing + p.cq_off.head);
+  cqTail  = (unsigned *)((char *)cqRing + p.cq_off.tail);
+  cqMask  = (unsigned *)((char *)cqRing + p.cq_off.ring_mask);
+  cqes    = (io_uring_cqe *)((char *)cqRing + p.cq_off.cqes);
+  for (int i = 0; i < IOURING_BUFFERS; i++) {
+      if (!(buffers[i].data = GetIoBuffer()))
+         return false;
+      }
+  return true;
+}
+
+io_uring_sqe *cIoUringWriter::GetSqe(void)
+{
+  unsigned Tail = *sqTail;
+  if (Tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) > *sqMask)
+     return NULL; // can't happen, since we have less requests in flight than entries
+  unsigned Index = Tail & *sqMask;
+  io_uring_sqe *sqe = &sqes[Index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqArray[Index] = Index;
+  __atomic_store_n(sqTail, Tail + 1, __ATOMIC_RELEASE);
+  inFlight++;
+  return sqe;
+}
+
+bool cIoUringWriter::Submit(int WaitFor)
+{
+  unsigned ToSubmit = *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+  if (ToSubmit || WaitFor) {
+     if (syscall(__NR_io_uring_enter, ringFd, ToSubmit, WaitFor, WaitFor ? IORING_ENTER_GETEVENTS : 0, NULL, 0) < 0 && errno != EINTR) {
+        LOG_ERROR;
+        return false;
+        }
+     }
+  return true;
+}
+
+void cIoUringWriter::QueueWrite(int Index)
+{
+  tBuffer &b = buffers[Index];
+  if (io_uring_sqe *sqe = GetSqe()) {
+     sqe->opcode = IORING_OP_WRITE;
+     sqe->fd = fd;
+     sqe->addr = (uintptr_t)(b.data + b.done);
+     sqe->len = b.fill - b.done;
+     sqe->off = b.pos + b.done;
+     sqe->user_data = Index;
+     b.busy = true;
+     }
+}
+
+void cIoUringWriter::QueueSync(void)
+{
+  // The datasync waits for all previous writes (IOSQE_IO_DRAIN), and the fadvise
+  // is only executed after the datasync has finished (IOSQE_IO_LINK):
+  if (io_uring_sqe *sqe = GetSqe()) {
+     sqe->opcode = IORING_OP_FSYNC;
+     sqe->fd = fd;
+     sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+     sqe->flags = IOSQE_IO_DRAIN | IOSQE_IO_LINK;
+     sqe->user_data = IOURING_SYNC;
+     }
+  if (io_uring_sqe *sqe = GetSqe()) {
+     sqe->opcode = IORING_OP_FADVISE;
+     sqe->fd = fd;
+     sqe->off = synced;
+     sqe->len = offset - synced;
+     sqe->fadvise_advice = POSIX_FADV_DONTNEED;
+     sqe->user_data = IOURING_SYNC;
+     }
+  synced = offset;
+}
+
+void cIoUringWriter::HandleCompletions(void)
+{
+  unsigned Head = *cqHead;
+  while (Head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        io_uring_cqe *cqe = &cqes[Head & *cqMask];
+        inFlight--;
+        if (cqe->user_data == IOURING_SYNC) {
+           if (cqe->res < 0 && cqe->res != -ECANCELED)
+              esyslog("ERROR: io_uring datasync/fadvise failed: %s", strerror(-cqe->res));
+           }
+        else if (cqe->user_data < IOURING_BUFFERS) {
+           int Index = cqe->user_data;
+           tBuffer &b = buffers[Index];
+           b.busy = false;
+           if (cqe->res <= 0) {
+              error = cqe->res < 0 ? -cqe->res : EIO;
+              esyslog("ERROR: io_uring write failed: %s", strerror(error));
+              b.fill = b.done = 0;
+              }
+           else if ((b.done += cqe->res) < b.fill)
+              QueueWrite(Index); // short write, so we write the rest
+           else
+              b.fill = b.done = 0;
+           }
+        Head++;
+        __atomic_store_n(cqHead, Head, __ATOMIC_RELEASE);
+        }
+}
+
+int cIoUringWriter::GetBuffer(void)
+{
+  for (;;) {
+      HandleCompletions();
+      for (int i = 0; i < IOURING_BUFFERS; i++) {
+          if (!buffers[i].busy) {
+             buffers[i].fill = buffers[i].done = 0;
+             buffers[i].pos = offset;
+             return i;
+             }
+          }
+      // all buffers are in flight, so we have to wait:
+      if (!Submit(1))
+         return -1;
+      }
+}
+
+ssize_t cIoUringWriter::Write(const void *Data, size_t Size)
+{
+  HandleCompletions();
+  if (error) {
+     errno = error;
+     error = 0;
+     return -1;
+     }
+  const uchar *p = (const uchar *)Data;
+  size_t n = Size;
+  while (n > 0) {
+        if (current < 0 && (current = GetBuffer()) < 0)
+           return -1;
+        tBuffer &b = buffers[current];
+        int c = min(n, size_t(IOBUFFER_SIZE - b.fill));
+        memcpy(b.data + b.fill, p, c);
+        b.fill += c;
+        offset += c;
+        p += c;
+        n -= c;
+        if (b.fill == IOBUFFER_SIZE) {
+           QueueWrite(current);
+           current = -1;
+           if (offset - synced >= IOURING_SYNCDELTA)
+              QueueSync();
+           if (!Submit(0))
+              return -1;
+           }
+        }
+  return Size;
+}
+
+bool cIoUringWriter::Flush(bool Pad)
+{
+  bool Padded = false;
+  if (current >= 0) {
+     tBuffer &b = buffers[current];
+     if (b.fill) {
+        if (Pad && b.fill % IOBUFFER_ALIGN) {
+           int Fill = b.fill;
+           b.fill = (Fill + IOBUFFER_ALIGN - 1) / IOBUFFER_ALIGN * IOBUFFER_ALIGN;
+           memset(b.data + Fill, 0, b.fill - Fill);
+           Padded = true;
+           }
+        QueueWrite(current);
+        }
+     current = -1;
+     }
+  while (inFlight > 0) {
+        if (!Submit(1))
+           return false;
+        HandleCompletions();
+        }
+  if (Padded && ftruncate(fd, offset) < 0)
+     error = errno;
+  if (error) {
+     errno = error;
+     error = 0;
+     return false;
+     }
+  return true;
+}
+#endif // USE_IOURING
+
 // --- cUnbufferedFile -------------------------------------------------------
 
 #ifndef USE_FADVISE_READ
@@ -1824,6 +2482,13 @@ bool cSafeFile::Close(void)
 cUnbufferedFile::cUnbufferedFile(void)
 {
   fd = -1;
+  ioUringWriter = NULL;
+  directIo = false;
+  directBuffer = NULL;
+  directFill = 0;
+  preallocExtent = 0;
+  preallocEnd = 0;
+  writePos = 0;
 }
 
 cUnbufferedFile::~cUnbufferedFile()
@@ -1849,9 +2514,112 @@ int cUnbufferedFile::Open(const char *FileName, int Flags, mode_t Mode)
   return fd;
 }
 
+bool cUnbufferedFile::UseIoUring(void)
+{
+#ifdef USE_IOURING
+  if (fd >= 0 && !ioUringWriter) {
+     off_t Offset = lseek(fd, 0, SEEK_CUR);
+     if (Offset >= 0)
+        ioUringWriter = cIoUringWriter::Create(fd, Offset);
+     }
+#endif
+  return ioUringWriter != NULL;
+}
+
+bool cUnbufferedFile::UseDirectIo(void)
+{
+  if (fd >= 0 && !directIo) {
+     off_t Offset = lseek(fd, 0, SEEK_CUR);
+     int Flags = fcntl(fd, F_GETFL);
+     if (Offset >= 0 && Offset % IOBUFFER_ALIGN == 0 && Flags >= 0 && fcntl(fd, F_SETFL, Flags | O_DIRECT) == 0) {
+        curpos = Offset;
+        directFill = 0;
+        directIo = true;
+        }
+     }
+  return directIo;
+}
+
+bool cUnbufferedFile::Preallocate(off_t Extent)
+{
+  if (fd >= 0 && Extent > 0 && !preallocExtent) {
+     off_t Offset = lseek(fd, 0, SEEK_CUR);
+     if (Offset >= 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, Offset, Extent) == 0) {
+        writePos = Offset;
+        preallocEnd = Offset + Extent;
+        preallocExtent = Extent;
+        }
+     }
+  return preallocExtent > 0;
+}
+
+void cUnbufferedFile::ReleasePreallocated(void)
+{
+  if (preallocExtent) {
+     // Whatever has been reserved beyond the end of the file is given back by
+     // "truncating" the file to its actual size:
+     struct stat st;
+     if (fstat(fd, &st) < 0 || ftruncate(fd, st.st_size) < 0)
+        LOG_ERROR;
+     preallocExtent = 0;
+     }
+}
+
+bool cUnbufferedFile::WriteDirect(int Size)
+{
+  off_t Offset = curpos - directFill;
+  for (;;) {
+      ssize_t r = pwrite(fd, directBuffer, Size, Offset);
+      if (r == Size)
+         return true;
+      if (r < 0 && errno == EINTR)
+         continue;
+      if (r >= 0)
+         errno = EIO; // a partial write can't be continued with O_DIRECT
+      return false;
+      }
+}
+
+void cUnbufferedFile::FlushPending(void)
+{
+  bool Flushed = false;
+#ifdef USE_IOURING
+  if (ioUringWriter) {
+     if (!ioUringWriter->Flush(directIo))
+        LOG_ERROR;
+     curpos = ioUringWriter->Offset();
+     Flushed = true;
+     }
+#endif
+  if (directIo) {
+     if (directFill) {
+        // the last block is padded and the file is truncated to its actual size:
+        int Size = (directFill + IOBUFFER_ALIGN - 1) / IOBUFFER_ALIGN * IOBUFFER_ALIGN;
+        memset(directBuffer + directFill, 0, Size - directFill);
+        if (!WriteDirect(Size) || ftruncate(fd, curpos) < 0)
+           LOG_ERROR;
+        directFill = 0;
+        }
+     PutIoBuffer(directBuffer);
+     directBuffer = NULL;
+     int Flags = fcntl(fd, F_GETFL);
+     if (Flags < 0 || fcntl(fd, F_SETFL, Flags & ~O_DIRECT) < 0)
+        LOG_ERROR;
+     directIo = false;
+     Flushed = true;
+     }
+  if (Flushed)
+     curpos = lseek(fd, curpos, SEEK_SET);
+}
+
 int cUnbufferedFile::Close(void)
 {
   if (fd >= 0) {
+     FlushPending();
+     ReleasePreallocated();
+#ifdef USE_IOURING
+     DELETENULL(ioUringWriter);
+#endif
 #if USE_FADVISE_READ || USE_FADVISE_WRITE
      if (totwritten)    // if we wrote anything make sure the data has hit the disk before
         fdatasync(fd);  // calling fadvise, as this is our last chance to un-cache it.
@@ -1878,6 +2646,12 @@ void cUnbufferedFile::SetReadAhead(size_t ra)
   readahead = ra;
 }
 
+void cUnbufferedFile::Prefetch(off_t Offset, size_t Size)
+{
+  if (fd >= 0)
+     posix_fadvise(fd, Offset, Size, POSIX_FADV_WILLNEED);
+}
+
 int cUnbufferedFile::FadviseDrop(off_t Offset, off_t Len)
 {
   // rounding up the window to make sure that not PAGE_SIZE-aligned data gets freed.
@@ -1886,6 +2660,21 @@ int cUnbufferedFile::FadviseDrop(off_t Offset, off_t Len)
 
 off_t cUnbufferedFile::Seek(off_t Offset, int Whence)
 {
+  if (preallocExtent) {
+     FlushPending();
+     ReleasePreallocated();
+     }
+#ifdef USE_IOURING
+  if (ioUringWriter) {
+     FlushPending();
+     curpos = lseek(fd, Offset, Whence);
+     if (curpos >= 0)
+        ioUringWriter->SetOffset(curpos);
+     return curpos;
+     }
+#endif
+  if (directIo)
+     FlushPending();
   if (Whence == SEEK_SET && Offset == curpos)
      return curpos;
   curpos = lseek(fd, Offset, Whence);
@@ -1895,6 +2684,22 @@ off_t cUnbufferedFile::Seek(off_t Offset, int Whence)
 ssize_t cUnbufferedFile::Read(void *Data, size_t Size)
 {
   if (fd >= 0) {
+     if (preallocExtent) {
+        FlushPending();
+        ReleasePreallocated();
+        }
+#ifdef USE_IOURING
+     if (ioUringWriter) {
+        FlushPending();
+        ssize_t bytesRead = safe_read(fd, Data, Size);
+        if (bytesRead > 0)
+           curpos += bytesRead;
+        ioUringWriter->SetOffset(curpos);
+        return bytesRead;
+        }
+#endif
+     if (directIo)
+        FlushPending();
 #if USE_FADVISE_READ
      off_t jumped = curpos-lastpos; // nonzero means we're not at the last offset
      if ((cachedstart < cachedend) && (curpos < cachedstart || curpos > cachedend)) {
@@ -1950,9 +2755,52 @@ ssize_t cUnbufferedFile::Read(void *Data, size_t Size)
   return -1;
 }
 
+void cUnbufferedFile::ExtendPreallocation(size_t Size)
+{
+  if (preallocExtent) {
+     writePos += Size;
+     while (writePos > preallocEnd) {
+           if (fallocate(fd, FALLOC_FL_KEEP_SIZE, preallocEnd, preallocExtent) < 0) {
+              // most likely the disk is full, so we just carry on without preallocation:
+              dsyslog("preallocation failed: %m");
+              ReleasePreallocated();
+              break;
+              }
+           preallocEnd += preallocExtent;
+           }
+     }
+}
+
 ssize_t cUnbufferedFile::Write(const void *Data, size_t Size)
 {
   if (fd >=0) {
+     ExtendPreallocation(Size);
+#ifdef USE_IOURING
+     if (ioUringWriter)
+        return ioUringWriter->Write(Data, Size);
+#endif
+     if (directIo) {
+        const uchar *p = (const uchar *)Data;
+        size_t n = Size;
+        while (n > 0) {
+              if (!directBuffer && !(directBuffer = GetIoBuffer())) {
+                 errno = ENOMEM;
+                 return -1;
+                 }
+              int c = min(n, size_t(IOBUFFER_SIZE - directFill));
+              memcpy(directBuffer + directFill, p, c);
+              directFill += c;
+              curpos += c;
+              p += c;
+              n -= c;
+              if (directFill == IOBUFFER_SIZE) {
+                 if (!WriteDirect(IOBUFFER_SIZE))
+                    return -1;
+                 directFill = 0;
+                 }
+              }
+        return Size;
+        }
      ssize_t bytesWritten = safe_write(fd, Data, Size);
 #if USE_FADVISE_WRITE
      if (bytesWritten > 0) {
@@ -2001,6 +2849,102 @@ ssize_t cUnbufferedFile::Write(const void *Data, size_t Size)
   return -1;
 }
 
+bool cUnbufferedFile::CopyRange(int Source, off_t Offset, size_t Size)
+{
+  size_t Copied = 0;
+  while (Copied < Size) {
+        ssize_t r = copy_file_range(Source, &Offset, fd, NULL, Size - Copied, 0);
+        if (r > 0) {
+           Copied += r;
+           ExtendPreallocation(r);
+           }
+        else if (r < 0 && errno == EINTR)
+           continue;
+        else if (r < 0 && !Copied && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP))
+           break; // not supported here, so we do it the traditional way
+        else {
+           if (r == 0)
+              errno = EIO; // premature end of source file
+           return false;
+           }
+        }
+  if (Copied < Size) {
+     uchar *Buffer = GetIoBuffer();
+     if (!Buffer) {
+        errno = ENOMEM;
+        return false;
+        }
+     while (Copied < Size) {
+           ssize_t r = pread(Source, Buffer, min(Size - Copied, size_t(IOBUFFER_SIZE)), Offset);
+           if (r < 0 && errno == EINTR)
+              continue;
+           if (r <= 0 || Write(Buffer, r) != r) {
+              if (r == 0)
+                 errno = EIO;
+              PutIoBuffer(Buffer);
+              return false;
+              }
+           Offset += r;
+           Copied += r;
+           }
+     PutIoBuffer(Buffer);
+     }
+  return true;
+}
+
+ssize_t cUnbufferedFile::Copy(cUnbufferedFile *Source, off_t Offset, size_t Size)
+{
+  if (fd >= 0 && Source && Source->fd >= 0) {
+     // Any data still pending in our own buffers must be written first, since
+     // the data is copied to the current position of the file descriptor:
+     FlushPending();
+     off_t Pos = lseek(fd, 0, SEEK_CUR);
+     if (Pos < 0)
+        return -1;
+     size_t Rest = Size;
+     // File systems like btrfs and XFS can share the data blocks between the two files,
+     // provided the source and destination offsets are equally aligned to the block size:
+     struct stat st;
+     if (fstat(fd, &st) == 0 && st.st_blksize > 0 && (Offset - Pos) % st.st_blksize == 0) {
+        off_t BlockSize = st.st_blksize;
+        off_t Head = (BlockSize - Offset % BlockSize) % BlockSize;
+        off_t Length = (off_t(Rest) - Head) / BlockSize * BlockSize;
+        if (Length > 0) {
+           if (!CopyRange(Source->fd, Offset, Head))
+              return -1;
+           FlushPending();
+           Offset += Head;
+           Rest -= Head;
+           Pos += Head;
+           file_clone_range Range = { Source->fd, __u64(Offset), __u64(Length), __u64(Pos) };
+           if (ioctl(fd, FICLONERANGE, &Range) == 0) {
+              if (preallocExtent) {
+                 // the cloned blocks need no preallocation:
+                 writePos += Length;
+                 preallocEnd = max(preallocEnd, writePos);
+                 }
+              Offset += Length;
+              Rest -= Length;
+              Pos += Length;
+              if (lseek(fd, Pos, SEEK_SET) < 0)
+                 return -1;
+              }
+           }
+        }
+     if (!CopyRange(Source->fd, Offset, Rest))
+        return -1;
+     FlushPending();
+     curpos = lseek(fd, 0, SEEK_CUR);
+#ifdef USE_IOURING
+     if (ioUringWriter)
+        ioUringWriter->SetOffset(curpos);
+#endif
+     return Size;
+     }
+  errno = EBADF;
+  return -1;
+}
+
 cUnbufferedFile *cUnbufferedFile::Create(const char *FileName, int Flags, mode_t Mode)
 {
   cUnbufferedFile *File = new cUnbufferedFile;
@@ -2308,33 +3252,62 @@ const cListObject *cListBase::Get(int Index) const
   return object;
 }
 
-static int CompareListObjects(const void *a, const void *b)
-{
-  const cListObject *la = *(const cListObject **)a;
-  const cListObject *lb = *(const cListObject **)b;
-  return la->Compare(*lb);
-}
-
 void cListBase::Sort(void)
 {
-  int n = Count();
-  cListObject **a = MALLOC(cListObject *, n);
-  if (a == NULL)
+  // Bottom-up merge sort, which is stable and needs no additional memory:
+  cListObject *list = objects;
+  if (!list || !list->next)
      return;
-  cListObject *object = objects;
-  int i = 0;
-  while (object && i < n) {
-        a[i++] = object;
-        object = object->Next();
-        }
-  qsort(a, n, sizeof(cListObject *), CompareListObjects);
-  objects = lastObject = NULL;
-  for (i = 0; i < n; i++) {
-      a[i]->Unlink();
-      count--;
-      Add(a[i]);
+  for (const cListObject *p = list; p->next; p = p->next) {
+      if (p->Compare(*p->next) > 0) {
+         list = NULL;
+         break;
+         }
       }
-  free(a);
+  if (list)
+     return; // already sorted
+  list = objects;
+  cListObject *tail = NULL;
+  for (int k = 1; ; k *= 2) {
+      cListObject *p = list;
+      list = tail = NULL;
+      int Merges = 0;
+      while (p) {
+            Merges++;
+            cListObject *q = p;
+            int pSize = 0;
+            while (q && pSize < k) {
+                  pSize++;
+                  q = q->next;
+                  }
+            int qSize = k;
+            while (pSize > 0 || (qSize > 0 && q)) {
+                  cListObject *e;
+                  if (pSize > 0 && (qSize == 0 || !q || p->Compare(*q) <= 0)) {
+                     e = p;
+                     p = p->next;
+                     pSize--;
+                     }
+                  else {
+                     e = q;
+                     q = q->next;
+                     qSize--;
+                     }
+                  if (tail)
+                     tail->next = e;
+                  else
+                     list = e;
+                  e->prev = tail;
+                  tail = e;
+                  }
+            p = q;
+            }
+      tail->next = NULL;
+      if (Merges <= 1)
+         break;
+      }
+  objects = list;
+  lastObject = tail;
 }
 
 // --- cDynamicBuffer --------------------------------------------------------
@@ -2377,68 +3350,126 @@ void cDynamicBuffer::Append(const uchar *Data, int Length)
 
 // --- cHashBase -------------------------------------------------------------
 
+// This is an open addressing hash with linear probing. It is kept at most half
+// full, so that the probe sequences remain short, and there is always at least
+// one unused entry that terminates them.
+
 cHashBase::cHashBase(int Size, bool OwnObjects)
 {
-  size = Size;
+  hashTable = NULL;
+  size = 0;
+  used = 0;
+  initialSize = max(Size, 4);
   ownObjects = OwnObjects;
-  hashTable = (cList<cHashObject>**)calloc(size, sizeof(cList<cHashObject>*));
 }
 
 cHashBase::~cHashBase(void)
 {
   Clear();
-  free(hashTable);
 }
 
-void cHashBase::Add(cListObject *Object, unsigned int Id)
+void cHashBase::Resize(int Size)
 {
-  unsigned int hash = hashfn(Id);
-  if (!hashTable[hash])
-     hashTable[hash] = new cList<cHashObject>;
-  hashTable[hash]->Add(new cHashObject(Object, Id));
+  tHashEntry *OldTable = hashTable;
+  int OldSize = size;
+  hashTable = (tHashEntry *)calloc(Size, sizeof(tHashEntry));
+  if (!hashTable) {
+     esyslog("ERROR: out of memory");
+     hashTable = OldTable;
+     return;
+     }
+  size = Size;
+  // Start right after an unused entry, so that objects with the same Id keep their order:
+  int Start = 0;
+  while (Start < OldSize && OldTable[Start].object)
+        Start++;
+  for (int n = 0; n < OldSize; n++) {
+      int i = (Start + 1 + n) & (OldSize - 1);
+      if (OldTable[i].object) {
+         unsigned int h = hashfn(OldTable[i].id);
+         while (hashTable[h].object)
+               h = (h + 1) & (size - 1);
+         hashTable[h] = OldTable[i];
+         }
+      }
+  free(OldTable);
 }
 
-void cHashBase::Del(cListObject *Object, unsigned int Id)
+int cHashBase::Find(unsigned int Id, const cListObject *After) const
 {
-  cList<cHashObject> *list = hashTable[hashfn(Id)];
-  if (list) {
-     for (cHashObject *hob = list->First(); hob; hob = list->Next(hob)) {
-         if (hob->object == Object) {
-            list->Del(hob);
-            break;
+  if (size) {
+     for (unsigned int h = hashfn(Id); hashTable[h].object; h = (h + 1) & (size - 1)) {
+         if (hashTable[h].id == Id) {
+            if (!After)
+               return h;
+            if (hashTable[h].object == After)
+               After = NULL;
             }
          }
      }
+  return -1;
 }
 
-void cHashBase::Clear(void)
+void cHashBase::Add(cListObject *Object, unsigned int Id)
 {
-  for (int i = 0; i < size; i++) {
-      if (ownObjects) {
-         cList<cHashObject> *list = hashTable[i];
-         if (list) {
-            for (cHashObject *hob = list->First(); hob; hob = list->Next(hob))
-                delete hob->object;
-            }
-         }
-      delete hashTable[i];
-      hashTable[i] = NULL;
+  if (2 * (used + 1) > size) {
+     int NewSize = size ? 2 * size : 4;
+     while (NewSize < 2 * initialSize && !size)
+           NewSize *= 2;
+     Resize(NewSize);
+     if (2 * (used + 1) > size)
+        return;
+     }
+  unsigned int h = hashfn(Id);
+  while (hashTable[h].object)
+        h = (h + 1) & (size - 1);
+  hashTable[h].id = Id;
+  hashTable[h].object = Object;
+  used++;
+}
+
+void cHashBase::Del(cListObject *Object, unsigned int Id)
+{
+  if (!size)
+     return;
+  unsigned int i = hashfn(Id);
+  while (hashTable[i].object && hashTable[i].object != Object)
+        i = (i + 1) & (size - 1);
+  if (!hashTable[i].object)
+     return;
+  // Move any following entries of the probe sequence into the gap, unless
+  // this would put them in front of their home position:
+  for (unsigned int j = (i + 1) & (size - 1); hashTable[j].object; j = (j + 1) & (size - 1)) {
+      unsigned int k = hashfn(hashTable[j].id);
+      if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+         continue;
+      hashTable[i] = hashTable[j];
+      i = j;
       }
+  hashTable[i].object = NULL;
+  used--;
 }
 
-cListObject *cHashBase::Get(unsigned int Id) const
+void cHashBase::Clear(void)
 {
-  cList<cHashObject> *list = hashTable[hashfn(Id)];
-  if (list) {
-     for (cHashObject *hob = list->First(); hob; hob = list->Next(hob)) {
-         if (hob->id == Id)
-            return hob->object;
-         }
+  if (ownObjects) {
+     for (int i = 0; i < size; i++)
+         delete hashTable[i].object;
      }
-  return NULL;
+  free(hashTable);
+  hashTable = NULL;
+  size = 0;
+  used = 0;
+}
+
+cListObject *cHashBase::Get(unsigned int Id) const
+{
+  int i = Find(Id, NULL);
+  return i >= 0 ? hashTable[i].object : NULL;
 }
 
-cList<cHashObject> *cHashBase::GetList(unsigned int Id) const
+cListObject *cHashBase::GetNext(unsigned int Id, const cListObject *Object) const
 {
-  return hashTable[hashfn(Id)];
+  int i = Find(Id, Object);
+  return i >= 0 ? hashTable[i].object : NULL;
 }
@@ -175,14 +175,21 @@ public:
   static void SetSystemCharacterTable(const char *CharacterTable);
   };
 
+#define CSTRING_SHORT 24 // strings shorter than this are stored inside the cString object
+
 class cString {
 private:
-  char *s;
+  char *s; // points to buf for short strings, otherwise to a heap allocated buffer
+  char buf[CSTRING_SHORT];
+  bool IsShort(void) const { return s == buf; }
+  void Set(const char *S, int Length);
+  void Free(void) { if (!IsShort()) free(s); s = NULL; }
+  void Take(cString &String);
 public:
   cString(const char *S = NULL, bool TakePointer = false);
   cString(const char *S, const char *To); ///< Copies S up to To (exclusive). To must be a valid pointer into S. If To is NULL, everything is copied.
   cString(const cString &String);
-  cString(cString &&String): s(String.s) { String.s = NULL; }
+  cString(cString &&String) { Take(String); }
   virtual ~cString();
   operator const void * () const { return s; } // to catch cases where operator*() should be used
   operator const char * () const { return s; } // for use in (const char *) context
@@ -345,6 +352,19 @@ cString ShortDateString(time_t t);
     ///< Converts the given time to a string of the form "dd.mm.yy".
 cString TimeString(time_t t);
     ///< Converts the given time to a string of the form "hh:mm".
+uchar *AllocLargeBuffer(size_t Size);
+    ///< Allocates a buffer of the given Size for bulk stream data. Buffers of at
+    ///< least 2 MB are taken from the explicitly reserved huge pages, if the system
+    ///< has any left, and otherwise from anonymous memory that is marked for
+    ///< transparent huge pages. The memory is only committed when it is first used.
+    ///< Returns NULL in case of an error. The buffer must be released with
+    ///< FreeLargeBuffer(), using the same Size.
+void FreeLargeBuffer(uchar *Buffer, size_t Size);
+bool SetLargeBufferNode(uchar *Buffer, size_t Size, int Node);
+    ///< Makes the pages of the given Buffer (as returned by AllocLargeBuffer())
+    ///< preferably come from the given NUMA Node, and moves the ones that are
+    ///< already in use there. Does nothing if Node is negative.
+    ///< Returns true if the policy has been set.
 uchar *RgbToJpeg(uchar *Mem, int Width, int Height, int &Size, int Quality = 100);
     ///< Converts the given Memory to a JPEG image and returns a pointer
     ///< to the resulting image. Mem must point to a data block of exactly
@@ -391,6 +411,9 @@ public:
   ~cBitStream() {}
   int GetBit(void);
   uint32_t GetBits(int n);
+  uint32_t PeekBits(int n) const;
+       ///< Returns the next n bits (n <= 32) without advancing the index.
+       ///< Bits beyond the end of the stream are returned as 1.
   void ByteAlign(void);
   void WordAlign(void);
   bool SetLength(int Length);
@@ -413,6 +436,9 @@ public:
       ///< If Ms is negative the timer is not initialized with the current
       ///< time.
   static uint64_t Now(void);
+  static uint64_t NowUs(void);
+      ///< Returns the time of the monotonic clock in microseconds. This is meant
+      ///< for measuring short durations, not for timers.
   void Set(int Ms = 0);
       ///< Sets the timer. Call Elapsed() to get the number of milliseconds
       ///< since the timer has been set. If Ms is greater than 0, TimedOut() returns
@@ -434,6 +460,29 @@ public:
       ///< to specify the value again.
   };
 
+#define LATENCYBUCKETS 32 // bucket i counts latencies below 2^i microseconds
+
+class cLatencyHistogram {
+private:
+  std::atomic<uint64_t> buckets[LATENCYBUCKETS];
+  std::atomic<uint64_t> max;
+public:
+  cLatencyHistogram(void);
+  void Reset(void);
+  void Add(uint64_t Latency);
+      ///< Counts the given Latency (in microseconds). This may be called from
+      ///< several threads at the same time.
+  uint64_t Count(void) const;
+      ///< Returns the number of latencies counted since the last call to Reset().
+  uint64_t Percentile(double Percent) const;
+      ///< Returns the latency (in microseconds) that the given Percent of all
+      ///< counted latencies are below. Since the latencies are only counted in
+      ///< buckets of powers of two, this is the upper limit of the bucket that
+      ///< contains the requested percentile (but never more than Max()).
+  uint64_t Max(void) const { return max; }
+      ///< Returns the highest latency counted since the last call to Reset().
+  };
+
 class cReadLine {
 private:
   size_t size;
@@ -446,14 +495,43 @@ public:
 
 class cPoller {
 private:
-  enum { MaxPollFiles = 64 };
-  pollfd pfd[MaxPollFiles];
+  enum { MinPollFiles = 4 };  // the number of file handles that fit without allocating memory
+  enum { MaxPollFiles = 64 }; // above this number of file handles epoll is used instead of poll()
+  pollfd fixedPfd[2 * MinPollFiles];
+  pollfd *pfd;      // the file handles to poll
+  pollfd *readyPfd; // the ones that were ready in the last call to Poll()
   int numFileHandles;
+  int maxFileHandles;
+  int numReady;
+  int epollFd;
+  struct epoll_event *epollEvents;
+  int maxEpollEvents;
+  bool Grow(void);
+  void EpollUpdate(int FileHandle);
+  bool EpollStart(void);
+  cPoller(const cPoller &Poller); // not copyable
+  cPoller &operator=(const cPoller &Poller);
 public:
   cPoller(int FileHandle = -1, bool Out = false);
+  ~cPoller();
   bool Add(int FileHandle, bool Out);
+       ///< Adds the given FileHandle, to be polled for input or (if Out is true)
+       ///< output. There is no limit to the number of file handles. A poller with
+       ///< more than a few dozen of them switches to epoll, so that its cost
+       ///< depends on the number of ready file handles rather than the total.
   void Del(int FileHandle, bool Out);
   bool Poll(int TimeoutMs = 0);
+       ///< Waits at most TimeoutMs for any of the file handles to become ready.
+       ///< Returns true if at least one of them is ready, or in case of an error
+       ///< (so that the caller will access the file and thus see the error code).
+  int NumReady(void) const { return numReady; }
+       ///< Returns the number of file handles that were found to be ready in the
+       ///< last call to Poll(). A file handle that was added for both input and
+       ///< output may appear twice.
+  int Ready(int Index, bool *Out = NULL) const;
+       ///< Returns the Index'th file handle (0..NumReady() - 1) that was ready in
+       ///< the last call to Poll(). If Out is given, it is set to true if this is
+       ///< the file handle's entry for output.
   };
 
 class cReadDir {
@@ -504,6 +582,8 @@ public:
 /// cUnbufferedFile is used for large files that are mainly written or read
 /// in a streaming manner, and thus should not be cached.
 
+class cIoUringWriter;
+
 class cUnbufferedFile {
 private:
   int fd;
@@ -516,16 +596,66 @@ private:
   size_t readahead;
   size_t written;
   size_t totwritten;
+  cIoUringWriter *ioUringWriter;
+  bool directIo;
+  uchar *directBuffer;
+  int directFill;
+  off_t preallocExtent;
+  off_t preallocEnd;
+  off_t writePos;
   int FadviseDrop(off_t Offset, off_t Len);
+  bool WriteDirect(int Size);
+  void FlushPending(void);
+  void ReleasePreallocated(void);
+  void ExtendPreallocation(size_t Size);
+  bool CopyRange(int Source, off_t Offset, size_t Size);
 public:
   cUnbufferedFile(void);
   ~cUnbufferedFile();
   int Open(const char *FileName, int Flags, mode_t Mode = DEFFILEMODE);
   int Close(void);
+  bool UseIoUring(void);
+       ///< Makes all subsequent calls to Write() queue the data for asynchronous
+       ///< writing through io_uring, so that the caller doesn't block on disk latency
+       ///< (unless the data is produced faster than the disk can take it).
+       ///< Write errors are reported by a later call to Write() or Close().
+       ///< Calls to Seek() and Read() wait until all pending data has been written.
+       ///< Must be called after Open(). Returns false if io_uring is not available,
+       ///< in which case the file continues to be written synchronously.
+  bool UseDirectIo(void);
+       ///< Makes all subsequent calls to Write() bypass the page cache (O_DIRECT).
+       ///< The data is collected in aligned buffers and written in full blocks; the
+       ///< last block is padded when the file is closed, and the file is then
+       ///< truncated to its actual size. A call to Seek() or Read() ends direct I/O
+       ///< for this file. Must be called after Open() and before any data has been
+       ///< written, and may be combined with UseIoUring(). Returns false if the
+       ///< file system doesn't support O_DIRECT.
+  bool Preallocate(off_t Extent);
+       ///< Makes Write() reserve disk space in chunks of Extent bytes ahead of the
+       ///< data written so far (using fallocate() with FALLOC_FL_KEEP_SIZE), so that
+       ///< the file system can lay out the file in large contiguous extents. Any space
+       ///< that is still reserved beyond the end of the file is released by Close().
+       ///< A call to Seek() or Read() ends preallocation for this file. Must be
+       ///< called after Open() and before any data has been written. Returns false
+       ///< if the file system doesn't support fallocate().
   void SetReadAhead(size_t ra);
+  void Prefetch(off_t Offset, size_t Size);
+       ///< Asks the kernel to read Size bytes at the given Offset into the page cache
+       ///< in the background (POSIX_FADV_WILLNEED), so that a later Read() of this data
+       ///< doesn't have to wait for the disk, or for the network in case of remote
+       ///< file systems.
   off_t Seek(off_t Offset, int Whence);
   ssize_t Read(void *Data, size_t Size);
   ssize_t Write(const void *Data, size_t Size);
+  ssize_t Copy(cUnbufferedFile *Source, off_t Offset, size_t Size);
+       ///< Appends Size bytes of the given Source file, starting at Offset, to this
+       ///< file. Where the file system supports it (like btrfs and XFS) and the source
+       ///< and destination positions are equally aligned to the block size, the data
+       ///< blocks are shared between the two files (FICLONERANGE). Anything else is
+       ///< copied using copy_file_range(), so that it doesn't have to pass through user
+       ///< space, or through a buffer if the file system doesn't support that either.
+       ///< Any data that has been written with Write() before is flushed first, which
+       ///< ends direct I/O for this file. Returns Size on success, -1 in case of an error.
   static cUnbufferedFile *Create(const char *FileName, int Flags, mode_t Mode = DEFFILEMODE);
   };
 
@@ -542,6 +672,7 @@ public:
 
 class cListObject {
   friend class cListGarbageCollector;
+  friend class cListBase;
 private:
   cListObject *prev, *next;
   cListObject(const cListObject &ListObject) { abort(); } // no copy constructor!
@@ -896,35 +1027,40 @@ public:
   int Length(void) { return used; }
   };
 
-class cHashObject : public cListObject {
-  friend class cHashBase;
-private:
-  unsigned int id;
-  cListObject *object;
-public:
-  cHashObject(cListObject *Object, unsigned int Id) { object = Object; id = Id; }
-  cListObject *Object(void) { return object; }
-  };
-
 class cHashBase {
 private:
-  cList<cHashObject> **hashTable;
-  int size;
+  struct tHashEntry {
+    unsigned int id;
+    cListObject *object; // NULL if this entry is unused
+    };
+  tHashEntry *hashTable;
+  int size; // always a power of 2 (or 0, if the table has not been allocated yet)
+  int used;
+  int initialSize;
   bool ownObjects;
-  unsigned int hashfn(unsigned int Id) const { return Id % size; }
+  unsigned int hashfn(unsigned int Id) const { unsigned int h = Id * 2654435769u; return (h ^ (h >> 16)) & (size - 1); }
+  int Find(unsigned int Id, const cListObject *After) const;
+  void Resize(int Size);
 protected:
   cHashBase(int Size, bool OwnObjects);
-       ///< Creates a new hash of the given Size. If OwnObjects is true, the
+       ///< Creates a new hash for about Size objects. The hash grows automatically
+       ///< if more objects are added. If OwnObjects is true, the
        ///< hash takes ownership of the objects given in the calls to Add(),
        ///< and deletes them when Clear() is called or the hash is destroyed
        ///< (unless the object has been removed from the hash by calling Del()).
 public:
   virtual ~cHashBase();
   void Add(cListObject *Object, unsigned int Id);
+       ///< Adds the given Object with the given Id. There may be several objects
+       ///< with the same Id.
   void Del(cListObject *Object, unsigned int Id);
   void Clear(void);
   cListObject *Get(unsigned int Id) const;
-  cList<cHashObject> *GetList(unsigned int Id) const;
+       ///< Returns the first object with the given Id, or NULL if there is none.
+  cListObject *GetNext(unsigned int Id, const cListObject *Object) const;
+       ///< Returns the object with the given Id that follows the given Object, or
+       ///< NULL if there is none. Object must have been returned by a previous call
+       ///< to Get() or GetNext() with the same Id.
   };
 
 #define HASHSIZE 512
@@ -933,6 +1069,7 @@ template<class T> class cHash : public cHashBase {
 public:
   cHash(int Size = HASHSIZE, bool OwnObjects = false) : cHashBase(Size, OwnObjects) {}
   T *Get(unsigned int Id) const { return (T *)cHashBase::Get(Id); }
+  T *GetNext(unsigned int Id, const T *Object) const { return (T *)cHashBase::GetNext(Id, Object); }
 };
 
 #endif //__TOOLS_H
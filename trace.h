@@ -0,0 +1,51 @@
+/*
+ * trace.h: Static tracepoints
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+// VDR_TRACE(Probe, Args...) marks a static tracepoint (a "USDT probe") with
+// the given name and up to 12 integer or pointer arguments. If the systemtap
+// header <sys/sdt.h> is available, every probe compiles into a single 'nop'
+// instruction plus a note in the ELF file, so it costs practically nothing
+// as long as nobody is tracing. Tools like bpftrace, perf or systemtap can
+// attach to the probes of the running VDR process, as in
+//
+//   bpftrace -e 'usdt:/usr/local/bin/vdr:vdr:device_batch { @[arg0] = sum(arg1); }'
+//
+// Without <sys/sdt.h> (or when building with NO_USDT=1) the probes are
+// compiled out completely. Probe arguments must not have side effects.
+//
+// Available probes (provider "vdr"):
+//
+// device_batch      device number, TS packets, mask of receivers getting data
+// receiver_receive  device number, receiver slot, receiver, received, scrambled
+// section_read      device number, pid, table id, section length
+// eit_apply         table id, service id, section number, schedule modified
+// recorder_frame    recorder, independent, previous errors, missing frames
+// recorder_write    recorder writer, bytes written, index entries
+// index_write       index, file number, file offset, independent
+// player_submit     frame index, bytes left, bytes played, video only
+// tuner_tune        adapter, frontend, channel number, transponder
+// tuner_status      adapter, frontend, old status, new status
+// osd_render        osd, x, y, width, height of the rendered area
+// osd_flush         osd (asynchronous flushes only)
+
+#if !defined(NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define VDR_TRACE(Probe, ...) STAP_PROBEV(vdr, Probe, __VA_ARGS__)
+#endif
+#endif
+
+#ifndef VDR_TRACE
+#define VDR_TRACE(Probe, ...)
+#endif
+
+#endif //__TRACE_H
@@ -9,25 +9,138 @@
 
 #include "transfer.h"
 
+// --- cGopCache -------------------------------------------------------------
+
+cMutex cGopCache::gopCachesMutex;
+cVector<cGopCache *> cGopCache::gopCaches;
+
+cGopCache::cGopCache(const cChannel *Channel)
+:cReceiver(Channel, MINPRIORITY)
+,frameDetector(Channel->Vpid(), Channel->Vtype())
+{
+  buffer = NULL;
+  size = 0;
+  length = 0;
+  analyzed = 0;
+  independent = false;
+  SetMultiPacket(true);
+  cMutexLock MutexLock(&gopCachesMutex);
+  gopCaches.Append(this);
+}
+
+cGopCache::~cGopCache()
+{
+  Detach();
+  {
+    cMutexLock MutexLock(&gopCachesMutex);
+    gopCaches.RemoveElement(this);
+  }
+  free(buffer);
+}
+
+void cGopCache::Clear(void)
+{
+  length = 0;
+  analyzed = 0;
+  independent = false;
+}
+
+void cGopCache::Receive(const uchar *Data, int Length)
+{
+  cMutexLock MutexLock(&mutex);
+  if (length + Length > MAXGOPCACHESIZE)
+     Clear(); // this GOP is too long, so let's wait for the next one
+  if (length + Length > size) {
+     int NewSize = max(length + Length, min(max(size * 2, int(MEGABYTE(1))), int(MAXGOPCACHESIZE)));
+     if (uchar *NewBuffer = (uchar *)realloc(buffer, NewSize)) {
+        buffer = NewBuffer;
+        size = NewSize;
+        }
+     else {
+        esyslog("ERROR: out of memory");
+        Clear();
+        return;
+        }
+     }
+  memcpy(buffer + length, Data, Length);
+  length += Length;
+  while (analyzed < length) {
+        int n = frameDetector.Analyze(buffer + analyzed, length - analyzed, false);
+        if (n <= 0)
+           break;
+        if (frameDetector.IndependentFrame()) {
+           // A new GOP starts here, so we drop everything before it:
+           length -= analyzed;
+           memmove(buffer, buffer + analyzed, length);
+           analyzed = 0;
+           independent = true;
+           }
+        analyzed += n;
+        }
+}
+
+uchar *cGopCache::GetData(int &Length)
+{
+  cMutexLock MutexLock(&mutex);
+  if (independent && length) {
+     if (uchar *Data = MALLOC(uchar, length)) {
+        memcpy(Data, buffer, length);
+        Length = length;
+        return Data;
+        }
+     }
+  return NULL;
+}
+
+uchar *cGopCache::GetData(const cDevice *Device, tChannelID ChannelID, int &Length)
+{
+  cMutexLock MutexLock(&gopCachesMutex);
+  for (int i = 0; i < gopCaches.Size(); i++) {
+      cGopCache *GopCache = gopCaches[i];
+      if (GopCache->Device() == Device && GopCache->ChannelID() == ChannelID)
+         return GopCache->GetData(Length);
+      }
+  return NULL;
+}
+
 // --- cTransfer -------------------------------------------------------------
 
-cTransfer::cTransfer(const cChannel *Channel)
+#define MAXPENDINGSIZE  (2 * MAXGOPCACHESIZE) // max. number of bytes to keep until the player is attached
+
+cTransfer::cTransfer(const cChannel *Channel, cDevice *ReceiverDevice)
 :cReceiver(Channel, TRANSFERPRIORITY)
 {
   lastErrorReport = 0;
   numLostPackets = 0;
+  batchLength = 0;
+  receiverDevice = ReceiverDevice;
+  pending = NULL;
+  pendingLength = 0;
   patPmtGenerator.SetChannel(Channel);
+  SetMultiPacket(true);
 }
 
 cTransfer::~cTransfer()
 {
   cReceiver::Detach();
   cPlayer::Detach();
+  free(pending);
 }
 
 void cTransfer::Activate(bool On)
 {
   if (On) {
+     if (receiverDevice && !cReceiver::IsAttached() && !cPlayer::IsAttached()) {
+        // We're being attached to the receiving device, and the player will be
+        // attached later. If the beginning of the current GOP has been cached,
+        // we take it (no packets can get lost here, because the device doesn't
+        // deliver any data while a receiver is being attached):
+        free(pending);
+        pending = cGopCache::GetData(receiverDevice, ChannelID(), pendingLength);
+        if (pending)
+           dsyslog("transfer starts with %d bytes of cached data", pendingLength);
+        return;
+        }
      PlayTs(patPmtGenerator.GetPat(), TS_SIZE);
      int Index = 0;
      while (uchar *pmt = patPmtGenerator.GetPmt(Index))
@@ -37,24 +150,41 @@ void cTransfer::Activate(bool On)
      cPlayer::Detach();
 }
 
-#define MAXRETRIES    20 // max. number of retries for a single TS packet
-#define RETRYWAIT      5 // time (in ms) between two retries
+#define MAXRETRYTIME 100 // max. time (in ms) to try getting TS packets into the device
+#define RETRYWAIT      5 // max. time (in ms) between two retries
+#define BATCHTIME      5 // max. time (in ms) to collect TS packets before handing them to the device
 #define ERRORDELTA    60 // seconds before reporting lost TS packets again
 
-void cTransfer::Receive(const uchar *Data, int Length)
+void cTransfer::Play(const uchar *Data, int Length)
 {
-  if (cPlayer::IsAttached()) {
-     // Transfer Mode means "live tv", so there's no point in doing any additional
-     // buffering here. The TS packets *must* get through here! However, every
-     // now and then there may be conditions where the packet just can't be
-     // handled when offered the first time, so that's why we try several times:
-     for (int i = 0; i < MAXRETRIES; i++) {
-         if (PlayTs(Data, Length) > 0)
-            return;
-         cCondWait::SleepMs(RETRYWAIT);
-         }
+  // The TS packets *must* get through here! However, every now and then there may
+  // be conditions where they just can't be handled when offered the first time,
+  // so that's why we wait for the device and try again:
+  cTimeMs Timeout(MAXRETRYTIME);
+  bool Polled = false;
+  while (Length > 0) {
+        int w = PlayTs(Data, Length);
+        if (w > 0) {
+           Data += w;
+           Length -= w;
+           Timeout.Set(MAXRETRYTIME);
+           Polled = false;
+           }
+        else if (Timeout.TimedOut())
+           break;
+        else {
+           // If the device can tell when it's ready to accept more data, we wait for
+           // that (but not again if it didn't take any data right after saying so):
+           cTimeMs Wait(RETRYWAIT);
+           cPoller Poller;
+           Polled = !Polled && DevicePoll(Poller, RETRYWAIT);
+           if (!Polled && !Wait.TimedOut())
+              cCondWait::SleepMs(RETRYWAIT - int(Wait.Elapsed()));
+           }
+        }
+  if (Length > 0) {
      DeviceClear();
-     numLostPackets++;
+     numLostPackets += (Length + TS_SIZE - 1) / TS_SIZE;
      if (time(NULL) - lastErrorReport > ERRORDELTA) {
         esyslog("ERROR: %d TS packet(s) not accepted in Transfer Mode", numLostPackets);
         numLostPackets = 0;
@@ -63,6 +193,56 @@ void cTransfer::Receive(const uchar *Data, int Length)
      }
 }
 
+void cTransfer::Receive(const uchar *Data, int Length)
+{
+  if (pending) {
+     if (cPlayer::IsAttached()) {
+        Play(pending, pendingLength);
+        free(pending);
+        pending = NULL;
+        pendingLength = 0;
+        }
+     else {
+        // Keep the live data seamlessly following the cached data until the player is attached:
+        uchar *NewPending = pendingLength + Length <= MAXPENDINGSIZE ? (uchar *)realloc(pending, pendingLength + Length) : NULL;
+        if (NewPending) {
+           pending = NewPending;
+           memcpy(pending + pendingLength, Data, Length);
+           pendingLength += Length;
+           }
+        else {
+           free(pending);
+           pending = NULL;
+           pendingLength = 0;
+           }
+        return;
+        }
+     }
+  if (cPlayer::IsAttached()) {
+     // Handing every single TS packet to the device costs a lot of CPU time (especially
+     // with output devices that pass them on to a decoder library), so we collect them
+     // here and hand them over in larger batches. Since Transfer Mode means "live tv",
+     // they are kept for at most BATCHTIME ms:
+     if (!batchLength && Length >= TRANSFERBATCHSIZE) {
+        Play(Data, Length); // no need to copy this
+        return;
+        }
+     while (Length > 0) {
+           if (!batchLength)
+              batchTimer.Set();
+           int n = min(Length, TRANSFERBATCHSIZE - batchLength);
+           memcpy(batch + batchLength, Data, n);
+           batchLength += n;
+           Data += n;
+           Length -= n;
+           if (batchLength == TRANSFERBATCHSIZE || batchTimer.Elapsed() >= BATCHTIME) {
+              Play(batch, batchLength);
+              batchLength = 0;
+              }
+           }
+     }
+}
+
 // --- cTransferControl ------------------------------------------------------
 
 cDevice *cTransferControl::receiverDevice = NULL;
@@ -70,7 +250,7 @@ cDevice *cTransferControl::receiverDevice = NULL;
 cTransferControl::cTransferControl(cDevice *ReceiverDevice, const cChannel *Channel)
 :cControl(NULL, true)
 {
-  transfer = new cTransfer(Channel);
+  transfer = new cTransfer(Channel, ReceiverDevice);
   SetPlayer(transfer);
   ReceiverDevice->AttachReceiver(transfer);
   receiverDevice = ReceiverDevice;
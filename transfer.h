@@ -14,16 +14,67 @@
 #include "receiver.h"
 #include "remux.h"
 
+#define TRANSFERBATCHSIZE (32 * TS_SIZE) // max. number of bytes to collect before handing them to the device
+#define MAXGOPCACHESIZE   MEGABYTE(8)     // max. number of bytes a cGopCache holds
+
+// A cGopCache receives a channel that is not (yet) being watched and keeps the
+// TS packets since the most recent independent frame. When a cTransfer is
+// started for this channel on the same device, it takes over this data, so the
+// decoder can show a picture right away instead of waiting for the next
+// independent frame. A cGopCache has the lowest possible priority, so it never
+// keeps a device from being used for anything else.
+
+class cGopCache : public cReceiver {
+private:
+  static cMutex gopCachesMutex;
+  static cVector<cGopCache *> gopCaches;
+  cMutex mutex;
+  cFrameDetector frameDetector;
+  uchar *buffer;
+  int size;
+  int length;
+  int analyzed;
+  bool independent; // the buffer starts with an independent frame
+  void Clear(void);
+  uchar *GetData(int &Length);
+protected:
+  virtual void Receive(const uchar *Data, int Length) override;
+public:
+  cGopCache(const cChannel *Channel);
+       ///< Creates a cache for the given Channel, which must have a video PID.
+       ///< The cache needs to be attached to a device to receive any data.
+  virtual ~cGopCache() override;
+  static uchar *GetData(const cDevice *Device, tChannelID ChannelID, int &Length);
+       ///< If a cGopCache for the given ChannelID is attached to Device, and it
+       ///< holds data that starts with an independent frame, a copy of that data
+       ///< is returned, and Length is set to its size. The caller must free() it.
+       ///< Otherwise NULL is returned.
+       ///< In order not to lose any TS packets between the cached data and the
+       ///< live stream, this must be called while the caller's receiver is being
+       ///< attached to Device (i.e. from its Activate() function).
+  };
+
 class cTransfer : public cReceiver, public cPlayer {
 private:
   time_t lastErrorReport;
   int numLostPackets;
   cPatPmtGenerator patPmtGenerator;
+  uchar batch[TRANSFERBATCHSIZE];
+  int batchLength;
+  cTimeMs batchTimer;
+  cDevice *receiverDevice;
+  uchar *pending; // cached and received data that waits for the player to be attached
+  int pendingLength;
+  void Play(const uchar *Data, int Length);
 protected:
   virtual void Activate(bool On) override;
   virtual void Receive(const uchar *Data, int Length) override;
 public:
-  cTransfer(const cChannel *Channel);
+  cTransfer(const cChannel *Channel, cDevice *ReceiverDevice = NULL);
+       ///< Creates a transfer for the given Channel. If ReceiverDevice is given,
+       ///< it must be the device this transfer will be attached to as a receiver.
+       ///< In that case the data of a cGopCache for this channel on that device
+       ///< (if any) will be replayed before the live stream.
   virtual ~cTransfer() override;
   };
 
@@ -48,6 +48,7 @@
 #include "device.h"
 #include "diseqc.h"
 #include "dvbdevice.h"
+#include "eit.h"
 #include "eitscan.h"
 #include "epg.h"
 #include "i18n.h"
@@ -65,25 +66,32 @@
 #include "skinsttng.h"
 #include "sourceparams.h"
 #include "sources.h"
+#include "startup.h"
 #include "status.h"
+#include "streamer.h"
 #include "svdrp.h"
+#include "taskpool.h"
 #include "themes.h"
 #include "timers.h"
 #include "tools.h"
 #include "transfer.h"
 #include "videodir.h"
+#include "zapahead.h"
 
 #define MINCHANNELWAIT        10 // seconds to wait between failed channel switchings
 #define ACTIVITYTIMEOUT       60 // seconds before starting housekeeping
 #define MEMCLEANUPDELTA     3600 // seconds between memory cleanups
+#define THREADSTATSDELTA    3600 // seconds between logging thread statistics
 #define SHUTDOWNWAIT         300 // seconds to wait in user prompt before automatic shutdown
 #define SHUTDOWNRETRY        360 // seconds before trying again to shut down
 #define SHUTDOWNFORCEPROMPT    5 // seconds to wait in user prompt to allow forcing shutdown
 #define SHUTDOWNCANCELPROMPT   5 // seconds to wait in user prompt to allow canceling shutdown
+#define THREADSTOPTIMEOUT      3 // seconds to wait for all threads to end when exiting
 #define RESTARTCANCELPROMPT    5 // seconds to wait in user prompt before restarting on SIGHUP
 #define MANUALSTART          600 // seconds the next timer must be in the future to assume manual start
 #define CHANNELSAVEDELTA     600 // seconds before saving channels.conf after automatic modifications
 #define DEVICEREADYTIMEOUT    30 // seconds to wait until all devices are ready
+#define DEFERREDSTARTTIMEOUT  30 // seconds after startup at which deferred plugins are started at the latest
 #define MENUTIMEOUT          120 // seconds of user inactivity after which an OSD display is closed
 #define TIMERCHECKDELTA        5 // seconds between checks for timers that need to see their channel
 #define TIMERDEVICETIMEOUT     8 // seconds before a device used for timer check may be reused
@@ -219,17 +227,20 @@ int main(int argc, char *argv[])
 #define DEFAULTPLUGINDIR PLUGINDIR
 #define DEFAULTLOCDIR LOCDIR
 #define DEFAULTEPGDATAFILENAME "epg.data"
+#define DEFAULTPAUSEDIR "/dev/shm/vdr"
 
   bool StartedAsRoot = false;
   const char *VdrUser = NULL;
   bool UserDump = false;
   int SVDRPport = DEFAULTSVDRPPORT;
+  int StreamPort = 0;
   const char *AudioCommand = NULL;
   const char *VideoDirectory = DEFAULTVIDEODIR;
   const char *ConfigDirectory = NULL;
   const char *CacheDirectory = NULL;
   const char *ResourceDirectory = NULL;
   const char *LocaleDirectory = DEFAULTLOCDIR;
+  const char *PauseDirectory = DEFAULTPAUSEDIR;
   const char *EpgDataFileName = DEFAULTEPGDATAFILENAME;
   bool DisplayHelp = false;
   bool DisplayVersion = false;
@@ -277,6 +288,7 @@ int main(int argc, char *argv[])
       { "device",   required_argument, NULL, 'D' },
       { "dirnames", required_argument, NULL, 'd' | 0x100 },
       { "edit",     required_argument, NULL, 'e' | 0x100 },
+      { "eitdump",  required_argument, NULL, 'E' | 0x100 },
       { "epgfile",  required_argument, NULL, 'E' },
       { "filesize", required_argument, NULL, 'f' | 0x100 },
       { "genindex", required_argument, NULL, 'g' | 0x100 },
@@ -289,6 +301,7 @@ int main(int argc, char *argv[])
       { "log",      required_argument, NULL, 'l' },
       { "mute",     no_argument,       NULL, 'm' },
       { "no-kbd",   no_argument,       NULL, 'n' | 0x100 },
+      { "pausedir", required_argument, NULL, 'p' | 0x100 },
       { "plugin",   required_argument, NULL, 'P' },
       { "port",     required_argument, NULL, 'p' },
       { "record",   required_argument, NULL, 'r' },
@@ -296,6 +309,7 @@ int main(int argc, char *argv[])
       { "showargs", optional_argument, NULL, 's' | 0x200 },
       { "shutdown", required_argument, NULL, 's' },
       { "split",    no_argument,       NULL, 's' | 0x100 },
+      { "stream",   required_argument, NULL, 's' | 0x300 },
       { "terminal", required_argument, NULL, 't' },
       { "updindex", required_argument, NULL, 'u' | 0x200 },
       { "user",     required_argument, NULL, 'u' },
@@ -387,6 +401,9 @@ int main(int argc, char *argv[])
                     return CutRecording(optarg) ? 0 : 2;
           case 'E': EpgDataFileName = (*optarg != '-' ? optarg : NULL);
                     break;
+          case 'E' | 0x100:
+                    cEitFilter::SetDumpFileName(optarg);
+                    break;
           case 'f' | 0x100:
                     Setup.MaxVideoFileSize = StrToNum(optarg) / MEGABYTE(1);
                     if (Setup.MaxVideoFileSize < MINVIDEOFILESIZE)
@@ -463,6 +480,9 @@ int main(int argc, char *argv[])
                        return 2;
                        }
                     break;
+          case 'p' | 0x100:
+                    PauseDirectory = optarg;
+                    break;
           case 'P': PluginManager.AddPlugin(optarg);
                     break;
           case 'r': cRecordingUserCommand::SetCommand(optarg);
@@ -475,6 +495,14 @@ int main(int argc, char *argv[])
           case 's' | 0x100:
                     Setup.SplitEditedFiles = 1;
                     break;
+          case 's' | 0x300:
+                    if (isnumber(optarg))
+                       StreamPort = atoi(optarg);
+                    else {
+                       fprintf(stderr, "vdr: invalid port number: %s\n", optarg);
+                       return 2;
+                       }
+                    break;
           case 's' | 0x200: {
                     const char *ArgsDir = optarg ? optarg : DEFAULTARGSDIR;
                     cArgs Args(argv[0]);
@@ -560,6 +588,8 @@ int main(int argc, char *argv[])
                "                           empty (as in \",,1\" to only set ENC), the defaults\n"
                "                           apply\n"
                "            --edit=REC     cut recording REC and exit\n"
+               "            --eitdump=FILE append all received EIT sections to FILE (for\n"
+               "                           replaying them with 'vdr-benchepg')\n"
                "  -E FILE,  --epgfile=FILE write the EPG data into the given FILE (default is\n"
                "                           '%s' in the cache directory)\n"
                "                           '-E-' disables this\n"
@@ -586,6 +616,9 @@ int main(int argc, char *argv[])
                "                           %s)\n"
                "  -m,       --mute         mute audio of the primary DVB device at startup\n"
                "            --no-kbd       don't use the keyboard as an input device\n"
+               "            --pausedir=DIR keep the buffer for pausing live video in DIR,\n"
+               "                           which should be on a tmpfs (default: %s); only\n"
+               "                           used if a pause buffer size is set up\n"
                "  -p PORT,  --port=PORT    use PORT for SVDRP (default: %d)\n"
                "                           0 turns off SVDRP\n"
                "  -P OPT,   --plugin=OPT   load a plugin defined by the given options\n"
@@ -597,6 +630,8 @@ int main(int argc, char *argv[])
                "                           useful in conjunction with --edit)\n"
                "            --showargs[=DIR] print the arguments read from DIR and exit\n"
                "                           (default: %s)\n"
+               "            --stream=PORT  stream live channels and recordings via HTTP on\n"
+               "                           PORT (default: off)\n"
                "  -t TTY,   --terminal=TTY controlling tty\n"
                "  -u USER,  --user=USER    run as user USER; only applicable if started as\n"
                "                           root; USER can be a user name or a numerical id\n"
@@ -617,6 +652,7 @@ int main(int argc, char *argv[])
                DEFAULTPLUGINDIR,
                LIRC_DEVICE,
                DEFAULTLOCDIR,
+               DEFAULTPAUSEDIR,
                DEFAULTSVDRPPORT,
                DEFAULTRESDIR,
                DEFAULTARGSDIR,
@@ -761,20 +797,35 @@ int main(int argc, char *argv[])
 
   // Configuration data:
 
+  uint64_t StartupBegin = cStartupTimes::Now();
+  ThreadProfiles.Load(AddDirectory(ConfigDirectory, "threads.conf"), true);
   Setup.Load(AddDirectory(ConfigDirectory, "setup.conf"));
   Sources.Load(AddDirectory(ConfigDirectory, "sources.conf"), true, true);
   Diseqcs.Load(AddDirectory(ConfigDirectory, "diseqc.conf"), true, Setup.DiSEqC);
   Scrs.Load(AddDirectory(ConfigDirectory, "scr.conf"), true);
+  CamResponsesLoad(AddDirectory(ConfigDirectory, "camresponses.conf"), true);
+
+  // DVB interfaces are probed while the rest of the configuration is read:
+
+  cDvbDevice::StartInitialize();
+
+  cStartupTimes::Add("read setup", StartupBegin);
+  StartupBegin = cStartupTimes::Now();
   cChannels::Load(AddDirectory(ConfigDirectory, "channels.conf"), false, true);
+  cStartupTimes::Add("read channels", StartupBegin);
+  StartupBegin = cStartupTimes::Now();
   cTimers::Load(AddDirectory(ConfigDirectory, "timers.conf"));
+  cStartupTimes::Add("read timers", StartupBegin);
+  StartupBegin = cStartupTimes::Now();
   Commands.Load(AddDirectory(ConfigDirectory, "commands.conf"));
   RecordingCommands.Load(AddDirectory(ConfigDirectory, "reccmds.conf"));
   SVDRPhosts.Load(AddDirectory(ConfigDirectory, "svdrphosts.conf"), true);
+  MulticastStreams.Load(AddDirectory(ConfigDirectory, "multicast.conf"), true);
   Keys.Load(AddDirectory(ConfigDirectory, "remote.conf"));
   KeyMacros.Load(AddDirectory(ConfigDirectory, "keymacros.conf"), true);
   Folders.Load(AddDirectory(ConfigDirectory, "folders.conf"));
-  CamResponsesLoad(AddDirectory(ConfigDirectory, "camresponses.conf"), true);
   DoneRecordingsPattern.Load(AddDirectory(CacheDirectory, "donerecs.data"));
+  cStartupTimes::Add("read other configuration files", StartupBegin);
 
   if (!*cFont::GetFontFileName(Setup.FontOsd)) {
      const char *msg = "no fonts available - OSD will not show any text!";
@@ -784,6 +835,8 @@ int main(int argc, char *argv[])
 
   // Recordings:
 
+  cRecordings::SetCacheFileName(AddDirectory(CacheDirectory, "recordings.cache"));
+  cRecordControls::SetPauseDirectory(PauseDirectory);
   cRecordings::Update();
 
   // EPG data:
@@ -805,7 +858,9 @@ int main(int argc, char *argv[])
 
   // DVB interfaces:
 
-  cDvbDevice::Initialize();
+  StartupBegin = cStartupTimes::Now();
+  cDvbDevice::WaitInitialize();
+  cStartupTimes::Add("wait for DVB devices", StartupBegin);
   cDvbDevice::BondDevices(Setup.DeviceBondings);
 
   // Initialize plugins:
@@ -897,10 +952,12 @@ int main(int argc, char *argv[])
 
   // Channel:
 
+  StartupBegin = cStartupTimes::Now();
   if (!cDevice::WaitForAllDevicesReady(DEVICEREADYTIMEOUT))
      dsyslog("not all devices ready after %d seconds", DEVICEREADYTIMEOUT);
   if (!CamSlots.WaitForAllCamSlotsReady(DEVICEREADYTIMEOUT))
      dsyslog("not all CAM slots ready after %d seconds", DEVICEREADYTIMEOUT);
+  cStartupTimes::Add("wait for devices and CAMs ready", StartupBegin);
   if (*Setup.InitialChannel) {
      LOCK_CHANNELS_READ;
      if (isnumber(Setup.InitialChannel)) { // for compatibility with old setup.conf files
@@ -957,6 +1014,10 @@ int main(int argc, char *argv[])
 
   SetSVDRPPorts(SVDRPport, DEFAULTSVDRPPORT);
   StartSVDRPHandler();
+  StartStreamServer(StreamPort);
+  StartMulticastStreams();
+
+  cStartupTimes::Mark("main loop");
 
   // Main program loop:
 
@@ -971,6 +1032,11 @@ int main(int argc, char *argv[])
 
         time_t Now = time(NULL);
 
+        // Start plugins that wait for the first picture:
+        static time_t DeferredStartTimeout = Now + DEFERREDSTARTTIMEOUT;
+        if (cDevice::PrimaryDevice()->HasProgramme() || !cDevice::PrimaryDevice()->HasDecoder() || Now > DeferredStartTimeout)
+           PluginManager.StartDeferredPlugins();
+
         // Make sure we have a visible programme in case device usage has changed:
         if (!EITScanner.Active() && cDevice::PrimaryDevice()->HasDecoder()) {
            static time_t lastTime = 0;
@@ -1086,6 +1152,8 @@ int main(int argc, char *argv[])
            }
         if (Now - LastChannelChanged >= Setup.ZapTimeout && LastChannel != PreviousChannel[PreviousChannelIndex])
            PreviousChannel[PreviousChannelIndex ^= 1] = LastChannel;
+        // Pre-tune neighbouring channels:
+        ZapAhead.Process();
         {
           // Timers and Recordings:
           static cStateKey TimersStateKey;
@@ -1598,6 +1666,13 @@ int main(int argc, char *argv[])
 
         ReportEpgBugFixStats();
 
+        // Thread statistics:
+        static time_t LastThreadStats = Now;
+        if (Now - LastThreadStats >= THREADSTATSDELTA) {
+           cThreadStatistics::Log();
+           LastThreadStats = Now;
+           }
+
         // Main thread hooks of plugins:
         PluginManager.MainThreadHook();
         }
@@ -1614,13 +1689,20 @@ Exit:
   signal(SIGPIPE, SIG_DFL);
   signal(SIGALRM, SIG_DFL);
 
+  // Stop all threads at once, so that the following cleanup doesn't have to
+  // wait for each of them in turn:
+  cThread::CancelAll(THREADSTOPTIMEOUT);
+  StopMulticastStreams();
+  StopStreamServer();
   StopSVDRPHandler();
   ChannelCamRelations.Save();
   cRecordControls::Shutdown();
   PluginManager.StopPlugins();
   RecordingsHandler.DelAll();
+  cTaskPool::Shutdown();
   delete Menu;
   cControl::Shutdown();
+  ZapAhead.Shutdown();
   delete Interface;
   cOsdProvider::Shutdown();
   Remotes.Clear();
@@ -1632,6 +1714,7 @@ Exit:
      Setup.CurrentVolume  = cDevice::CurrentVolume();
      Setup.Save();
      }
+  ConfigSaver.Flush();
   cDevice::Shutdown();
   cPositioner::DestroyPositioner();
   cVideoDirectory::Destroy();
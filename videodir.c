@@ -19,9 +19,238 @@
 #include "recording.h"
 #include "tools.h"
 
+// --- cMultiVideoDirectory -------------------------------------------------
+
+#define MINVOLUMEFREEMB      1024 // MB that must be free on a volume to put a new file there
+#define WRITELOADTIMEOUT       60 // seconds after which a file that hasn't been written to no longer counts as "active"
+
+class cVideoVolume : public cListObject {
+public:
+  cString name;
+  dev_t device;
+  int activeFiles;
+  int freeMB;
+  cVideoVolume(const char *Name, dev_t Device) { name = Name; device = Device; activeFiles = 0; freeMB = 0; }
+  bool IsBetterThan(const cVideoVolume *Volume) const;
+  };
+
+bool cVideoVolume::IsBetterThan(const cVideoVolume *Volume) const
+{
+  bool Full = freeMB < MINVOLUMEFREEMB;
+  if (Full != (Volume->freeMB < MINVOLUMEFREEMB))
+     return !Full;
+  if (!Full && activeFiles != Volume->activeFiles)
+     return activeFiles < Volume->activeFiles;
+  return freeMB > Volume->freeMB;
+}
+
+class cVideoVolumeFile : public cListObject {
+public:
+  cString fileName; // the name of the file in the video directory
+  cVideoVolume *volume; // the volume the file actually resides on
+  time_t registered;
+  cVideoVolumeFile(const char *FileName, cVideoVolume *Volume) { fileName = FileName; volume = Volume; registered = time(NULL); }
+  };
+
+class cMultiVideoDirectory : public cVideoDirectory {
+private:
+  cList<cVideoVolume> volumes; // the first volume is the video directory itself
+  cList<cVideoVolumeFile> activeFiles; // files that have recently been registered for writing
+  cMutex registerMutex;
+  void CountActiveFiles(const char *FileName);
+  cMultiVideoDirectory(void) {}
+public:
+  static bool Create(void);
+      ///< Checks whether the name of the video directory ends with '0', and
+      ///< whether there are further directories with the same name, ending
+      ///< in '1', '2' etc. If so, new recording files are distributed over all
+      ///< of these directories ("volumes"), and true is returned.
+  virtual int FreeMB(int *UsedMB = NULL) override;
+  virtual bool Register(const char *FileName) override;
+  virtual bool Remove(const char *Name) override;
+  virtual void Cleanup(const char *IgnoreFiles[] = NULL) override;
+  virtual void CleanupDirectory(const char *DirName, const char *IgnoreFiles[] = NULL) override;
+  virtual bool Contains(const char *Name) override;
+  };
+
+static bool RemoveEmptyDirectory(const char *DirName, const char *IgnoreFiles[])
+{
+  // Removes DirName if it contains nothing but files listed in IgnoreFiles.
+  // Unlike RemoveEmptyDirectories() this doesn't descend into subdirectories.
+  cReadDir d(DirName);
+  if (!d.Ok())
+     return false;
+  struct dirent *e;
+  while ((e = d.Next()) != NULL) {
+        if (!IgnoreFiles || !StrInArray(IgnoreFiles, e->d_name))
+           return false;
+        }
+  for (const char **f = IgnoreFiles; f && *f; f++) {
+      cString FileName = AddDirectory(DirName, *f);
+      if (access(FileName, F_OK) == 0) {
+         dsyslog("removing %s", *FileName);
+         if (remove(FileName) < 0) {
+            LOG_ERROR_STR(*FileName);
+            return false;
+            }
+         }
+      }
+  dsyslog("removing %s", DirName);
+  if (remove(DirName) < 0) {
+     LOG_ERROR_STR(DirName);
+     return false;
+     }
+  return true;
+}
+
+static void RemoveEmptyParentDirectories(const char *BaseName, const char *DirName, const char *IgnoreFiles[])
+{
+  char *s = strdup(AddDirectory(BaseName, DirName));
+  size_t l = strlen(BaseName);
+  while (strlen(s) > l && RemoveEmptyDirectory(s, IgnoreFiles)) {
+        char *p = strrchr(s, '/');
+        if (!p)
+           break;
+        *p = 0;
+        }
+  free(s);
+}
+
+bool cMultiVideoDirectory::Create(void)
+{
+  const char *Name = cVideoDirectory::Name();
+  int l = Name ? strlen(Name) : 0;
+  if (l < 2 || Name[l - 1] != '0' || isdigit(Name[l - 2]))
+     return false;
+  cString Prefix(Name, Name + l - 1);
+  cMultiVideoDirectory *VideoDirectory = new cMultiVideoDirectory;
+  for (int i = 0; ; i++) {
+      cString VolumeName = cString::sprintf("%s%d", *Prefix, i);
+      struct stat st;
+      if (stat(VolumeName, &st) != 0 || !S_ISDIR(st.st_mode))
+         break;
+      VideoDirectory->volumes.Add(new cVideoVolume(VolumeName, st.st_dev));
+      }
+  if (VideoDirectory->volumes.Count() > 1) {
+     for (const cVideoVolume *v = VideoDirectory->volumes.First(); v; v = VideoDirectory->volumes.Next(v))
+         isyslog("video directory volume %s", *v->name);
+     return true;
+     }
+  delete VideoDirectory; // this also resets 'current'
+  return false;
+}
+
+void cMultiVideoDirectory::CountActiveFiles(const char *FileName)
+{
+  for (cVideoVolume *v = volumes.First(); v; v = volumes.Next(v))
+      v->activeFiles = 0;
+  // The previous file of the recording FileName belongs to doesn't count,
+  // otherwise a recording would hop to a different volume with every file:
+  int l = strrchr(FileName, '/') - FileName + 1;
+  time_t Now = time(NULL);
+  for (cVideoVolumeFile *f = activeFiles.First(); f; ) {
+      cVideoVolumeFile *Next = activeFiles.Next(f);
+      time_t LastWritten = f->registered;
+      struct stat st;
+      if (stat(f->fileName, &st) == 0)
+         LastWritten = max(LastWritten, st.st_mtime);
+      if (Now - LastWritten <= WRITELOADTIMEOUT) {
+         if (strncmp(f->fileName, FileName, l) != 0 || strchr(f->fileName + l, '/'))
+            f->volume->activeFiles++;
+         }
+      else
+         activeFiles.Del(f);
+      f = Next;
+      }
+}
+
+int cMultiVideoDirectory::FreeMB(int *UsedMB)
+{
+  int Free = 0;
+  int Used = 0;
+  for (const cVideoVolume *v = volumes.First(); v; v = volumes.Next(v)) {
+      bool Counted = false;
+      for (const cVideoVolume *p = volumes.First(); p != v; p = volumes.Next(p)) {
+          if (p->device == v->device) {
+             Counted = true; // don't count the same file system more than once
+             break;
+             }
+          }
+      if (!Counted) {
+         int u;
+         Free += FreeDiskSpaceMB(v->name, &u);
+         Used += u;
+         }
+      }
+  if (UsedMB)
+     *UsedMB = Used;
+  return Free;
+}
+
+bool cMultiVideoDirectory::Register(const char *FileName)
+{
+  if (!cVideoDirectory::Register(FileName))
+     return false;
+  struct stat st;
+  if (lstat(FileName, &st) == 0)
+     return true; // the file already exists, so we leave it where it is
+  cMutexLock MutexLock(&registerMutex);
+  // Select the volume with the fewest files currently being written to, and
+  // the most free space among those. This spreads concurrent recordings over
+  // the available disks:
+  CountActiveFiles(FileName);
+  cVideoVolume *Volume = NULL;
+  for (cVideoVolume *v = volumes.First(); v; v = volumes.Next(v)) {
+      v->freeMB = FreeDiskSpaceMB(v->name);
+      if (!Volume || v->IsBetterThan(Volume))
+         Volume = v;
+      }
+  if (Volume != volumes.First()) {
+     cString ActualFileName = cString::sprintf("%s%s", *Volume->name, FileName + strlen(Name()));
+     if (!MakeDirs(ActualFileName))
+        return false;
+     dsyslog("creating symlink from %s to %s", FileName, *ActualFileName);
+     if (symlink(ActualFileName, FileName) < 0) {
+        LOG_ERROR_STR(FileName);
+        return false;
+        }
+     }
+  activeFiles.Add(new cVideoVolumeFile(FileName, Volume));
+  return true;
+}
+
+bool cMultiVideoDirectory::Remove(const char *Name)
+{
+  return RemoveFileOrDir(Name, true);
+}
+
+void cMultiVideoDirectory::Cleanup(const char *IgnoreFiles[])
+{
+  for (const cVideoVolume *v = volumes.First(); v; v = volumes.Next(v))
+      RemoveEmptyDirectories(v->name, false, IgnoreFiles);
+}
+
+void cMultiVideoDirectory::CleanupDirectory(const char *DirName, const char *IgnoreFiles[])
+{
+  for (const cVideoVolume *v = volumes.First(); v; v = volumes.Next(v))
+      RemoveEmptyParentDirectories(v->name, DirName, IgnoreFiles);
+}
+
+bool cMultiVideoDirectory::Contains(const char *Name)
+{
+  for (const cVideoVolume *v = volumes.First(); v; v = volumes.Next(v)) {
+      if (EntriesOnSameFileSystem(v->name, Name))
+         return true;
+      }
+  return false;
+}
+
+// --- cVideoDirectory -------------------------------------------------------
+
 cMutex cVideoDirectory::mutex;
 cString cVideoDirectory::name;
 cVideoDirectory *cVideoDirectory::current = NULL;
+cStringList cVideoDirectory::changedDirectories;
 
 cVideoDirectory::cVideoDirectory(void)
 {
@@ -41,14 +270,17 @@ cVideoDirectory::~cVideoDirectory()
 cVideoDirectory *cVideoDirectory::Current(void)
 {
   mutex.Lock();
-  if (!current)
-     new cVideoDirectory;
+  if (!current) {
+     if (!cMultiVideoDirectory::Create())
+        new cVideoDirectory;
+     }
   mutex.Unlock();
   return current;
 }
 
 void cVideoDirectory::Destroy(void)
 {
+  cVideoDiskUsage::Stop();
   delete current;
 }
 
@@ -117,6 +349,11 @@ void cVideoDirectory::Cleanup(const char *IgnoreFiles[])
   RemoveEmptyDirectories(Name(), false, IgnoreFiles);
 }
 
+void cVideoDirectory::CleanupDirectory(const char *DirName, const char *IgnoreFiles[])
+{
+  RemoveEmptyParentDirectories(Name(), DirName, IgnoreFiles);
+}
+
 bool cVideoDirectory::Contains(const char *Name)
 {
   return EntriesOnSameFileSystem(this->Name(), Name);
@@ -129,41 +366,51 @@ cUnbufferedFile *cVideoDirectory::OpenVideoFile(const char *FileName, int Flags)
   return NULL;
 }
 
+void cVideoDirectory::DirectoryChanged(const char *FileName)
+{
+  // Remembers the directory FileName is in (relative to the video directory),
+  // so that RemoveEmptyVideoDirectories() can check whether it has become empty:
+  const char *VideoDir = Name();
+  int l = VideoDir ? strlen(VideoDir) : 0;
+  if (l && strncmp(FileName, VideoDir, l) == 0 && FileName[l] == '/') {
+     const char *p = strrchr(FileName, '/');
+     if (p > FileName + l) {
+        cString DirName(FileName + l + 1, p);
+        cMutexLock MutexLock(&mutex);
+        if (changedDirectories.Find(DirName) < 0)
+           changedDirectories.Append(strdup(DirName));
+        }
+     }
+}
+
 bool cVideoDirectory::RenameVideoFile(const char *OldName, const char *NewName)
 {
+  DirectoryChanged(OldName);
   return Current()->Rename(OldName, NewName);
 }
 
 bool cVideoDirectory::MoveVideoFile(const char *FromName, const char *ToName)
 {
+  DirectoryChanged(FromName);
   return Current()->Move(FromName, ToName);
 }
 
 bool cVideoDirectory::RemoveVideoFile(const char *FileName)
 {
+  DirectoryChanged(FileName);
   return Current()->Remove(FileName);
 }
 
 bool cVideoDirectory::VideoFileSpaceAvailable(int SizeMB)
 {
-  return Current()->FreeMB() >= SizeMB;
+  return cVideoDiskUsage::AvailableMB() >= SizeMB;
 }
 
 int cVideoDirectory::VideoDiskSpace(int *FreeMB, int *UsedMB)
 {
-  int used = 0;
-  int free = Current()->FreeMB(&used);
-  LOCK_DELETEDRECORDINGS_READ;
-  int deleted = DeletedRecordings->TotalFileSizeMB();
-  if (deleted > used)
-     deleted = used; // let's not get beyond 100%
-  free += deleted;
-  used -= deleted;
-  if (FreeMB)
-     *FreeMB = free;
-  if (UsedMB)
-     *UsedMB = used;
-  return (free + used) ? round(double(used) * 100 / (free + used)) : 0;
+  cVideoDiskUsage::AssertSynced();
+  cMutexLock MutexLock(&cVideoDiskUsage::mutex);
+  return cVideoDiskUsage::DiskSpace(FreeMB, UsedMB);
 }
 
 cString cVideoDirectory::PrefixVideoFileName(const char *FileName, char Prefix)
@@ -188,7 +435,15 @@ cString cVideoDirectory::PrefixVideoFileName(const char *FileName, char Prefix)
 
 void cVideoDirectory::RemoveEmptyVideoDirectories(const char *IgnoreFiles[])
 {
-  Current()->Cleanup(IgnoreFiles);
+  cStringList DirNames;
+  mutex.Lock();
+  for (int i = 0; i < changedDirectories.Size(); i++)
+      DirNames.Append(strdup(changedDirectories[i]));
+  changedDirectories.Clear();
+  mutex.Unlock();
+  cVideoDirectory *VideoDirectory = Current();
+  for (int i = 0; i < DirNames.Size(); i++)
+      VideoDirectory->CleanupDirectory(DirNames[i], IgnoreFiles);
 }
 
 bool cVideoDirectory::IsOnVideoDirectoryFileSystem(const char *FileName)
@@ -196,34 +451,192 @@ bool cVideoDirectory::IsOnVideoDirectoryFileSystem(const char *FileName)
   return Current()->Contains(FileName);
 }
 
+// --- cVideoDiskUsageThread -------------------------------------------------
+
+#define DISKSPACESYNC    60 // seconds between synchronizing with the actual disk usage
+
+class cVideoDiskUsageThread : public cThread {
+private:
+  cCondWait condWait;
+protected:
+  virtual void Action(void) override;
+public:
+  cVideoDiskUsageThread(void);
+  virtual ~cVideoDiskUsageThread() override;
+  void Trigger(void) { condWait.Signal(); }
+  };
+
+cVideoDiskUsageThread::cVideoDiskUsageThread(void)
+:cThread("video disk usage", true)
+{
+}
+
+cVideoDiskUsageThread::~cVideoDiskUsageThread()
+{
+  Cancel(-1);
+  condWait.Signal();
+  Cancel(3);
+}
+
+void cVideoDiskUsageThread::Action(void)
+{
+  while (Running()) {
+        condWait.Wait(DISKSPACESYNC * 1000);
+        if (Running())
+           cVideoDiskUsage::Sync();
+        }
+}
+
+static cVideoDiskUsageThread *VideoDiskUsageThread = NULL;
+
 // --- cVideoDiskUsage -------------------------------------------------------
 
-#define DISKSPACECHEK     5 // seconds between disk space checks
 #define MB_PER_MINUTE 25.75 // this is just an estimate!
 
+cMutex cVideoDiskUsage::mutex;
 int cVideoDiskUsage::state = 0;
-time_t cVideoDiskUsage::lastChecked = 0;
+bool cVideoDiskUsage::synced = false;
 int cVideoDiskUsage::usedPercent = 0;
 int cVideoDiskUsage::freeMB = 0;
 int cVideoDiskUsage::freeMinutes = 0;
+int cVideoDiskUsage::availableMB = 0;
+int cVideoDiskUsage::usedMB = 0;
+int cVideoDiskUsage::deletedMB = 0;
+double cVideoDiskUsage::mbPerMinute = MB_PER_MINUTE;
+off_t cVideoDiskUsage::written = 0;
 
-bool cVideoDiskUsage::HasChanged(int &State)
+void cVideoDiskUsage::Start(void)
+{
+  // mutex must be locked!
+  if (!VideoDiskUsageThread) {
+     VideoDiskUsageThread = new cVideoDiskUsageThread;
+     VideoDiskUsageThread->Start();
+     }
+}
+
+void cVideoDiskUsage::Stop(void)
+{
+  cVideoDiskUsageThread *Thread;
+  {
+    cMutexLock MutexLock(&mutex);
+    Thread = VideoDiskUsageThread;
+    VideoDiskUsageThread = NULL;
+  }
+  delete Thread; // this waits for the thread to end, so mutex must not be locked
+}
+
+void cVideoDiskUsage::AssertSynced(void)
+{
+  mutex.Lock();
+  bool Synced = synced;
+  mutex.Unlock();
+  if (!Synced)
+     Sync();
+}
+
+int cVideoDiskUsage::DiskSpace(int *FreeMB, int *UsedMB)
+{
+  // mutex must be locked!
+  int used = usedMB;
+  int free = availableMB;
+  int deleted = deletedMB;
+  if (deleted > used)
+     deleted = used; // let's not get beyond 100%
+  free += deleted;
+  used -= deleted;
+  if (FreeMB)
+     *FreeMB = free;
+  if (UsedMB)
+     *UsedMB = used;
+  return (free + used) ? round(double(used) * 100 / (free + used)) : 0;
+}
+
+void cVideoDiskUsage::Calculate(void)
+{
+  // mutex must be locked!
+  int FreeMB;
+  int UsedPercent = DiskSpace(&FreeMB);
+  if (FreeMB != freeMB || UsedPercent != usedPercent) {
+     usedPercent = UsedPercent;
+     freeMB = FreeMB;
+     freeMinutes = int(double(FreeMB) / mbPerMinute);
+     state++;
+     }
+}
+
+void cVideoDiskUsage::Sync(void)
 {
-  if (time(NULL) - lastChecked > DISKSPACECHEK) {
-     int FreeMB;
-     int UsedPercent = cVideoDirectory::VideoDiskSpace(&FreeMB);
-     if (FreeMB != freeMB) {
-        usedPercent = UsedPercent;
-        freeMB = FreeMB;
-        LOCK_RECORDINGS_READ;
-        double MBperMinute = Recordings->MBperMinute();
-        if (MBperMinute <= 0)
-           MBperMinute = MB_PER_MINUTE;
-        freeMinutes = int(double(FreeMB) / MBperMinute);
-        state++;
+  // This accesses the disk and may take a while, so the mutex is only
+  // locked when the results are stored:
+  int Used = 0;
+  int Free = cVideoDirectory::Current()->FreeMB(&Used);
+  int Deleted;
+  double MBperMinute;
+  {
+    LOCK_DELETEDRECORDINGS_READ;
+    Deleted = DeletedRecordings->TotalFileSizeMB();
+  }
+  {
+    LOCK_RECORDINGS_READ;
+    MBperMinute = Recordings->MBperMinute();
+    if (MBperMinute <= 0)
+       MBperMinute = MB_PER_MINUTE;
+  }
+  cMutexLock MutexLock(&mutex);
+  availableMB = Free;
+  usedMB = Used;
+  deletedMB = Deleted;
+  mbPerMinute = MBperMinute;
+  written = 0;
+  synced = true;
+  Calculate();
+  Start();
+}
+
+void cVideoDiskUsage::ForceCheck(void)
+{
+  cMutexLock MutexLock(&mutex);
+  if (VideoDiskUsageThread)
+     VideoDiskUsageThread->Trigger();
+}
+
+void cVideoDiskUsage::Written(off_t Bytes)
+{
+  cMutexLock MutexLock(&mutex);
+  if (synced) {
+     written += Bytes;
+     int MB = written / MEGABYTE(1);
+     if (MB) {
+        written -= MEGABYTE(off_t(MB));
+        availableMB = max(availableMB - MB, 0);
+        usedMB += MB;
+        Calculate();
         }
-     lastChecked = time(NULL);
      }
+}
+
+void cVideoDiskUsage::Removed(int MB)
+{
+  cMutexLock MutexLock(&mutex);
+  if (synced) {
+     availableMB += MB;
+     usedMB = max(usedMB - MB, 0);
+     deletedMB = max(deletedMB - MB, 0);
+     Calculate();
+     }
+}
+
+int cVideoDiskUsage::AvailableMB(void)
+{
+  AssertSynced();
+  cMutexLock MutexLock(&mutex);
+  return availableMB;
+}
+
+bool cVideoDiskUsage::HasChanged(int &State)
+{
+  AssertSynced();
+  cMutexLock MutexLock(&mutex);
   if (State != state) {
      State = state;
      return true;
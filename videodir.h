@@ -14,11 +14,14 @@
 #include "tools.h"
 
 class cVideoDirectory {
+  friend class cVideoDiskUsage;
 private:
   static cMutex mutex;
   static cString name;
   static cVideoDirectory *current;
+  static cStringList changedDirectories;
   static cVideoDirectory *Current(void);
+  static void DirectoryChanged(const char *FileName);
 public:
   cVideoDirectory(void);
   virtual ~cVideoDirectory();
@@ -61,6 +64,12 @@ public:
       ///< are ignored when checking whether a directory is empty. These are
       ///< typically "dot files", like e.g. ".sort".
       ///< The default implementation calls RemoveEmptyDirectories().
+  virtual void CleanupDirectory(const char *DirName, const char *IgnoreFiles[] = NULL);
+      ///< Removes the directory DirName if it is empty, and then each of its
+      ///< parent directories below the video directory, as long as they are
+      ///< empty, too. DirName is relative to the video directory. Only the
+      ///< directories on this path are checked, not any other directories in
+      ///< the video directory. IgnoreFiles has the same meaning as in Cleanup().
   virtual bool Contains(const char *Name);
       ///< Checks whether the directory Name is on the same file system as the
       ///< video directory. Name is the full path name of a recording's '*.rec'
@@ -79,18 +88,40 @@ public:
   static bool RemoveVideoFile(const char *FileName);
   static bool VideoFileSpaceAvailable(int SizeMB);
   static int VideoDiskSpace(int *FreeMB = NULL, int *UsedMB = NULL); // returns the used disk space in percent
+      ///< VideoFileSpaceAvailable() and VideoDiskSpace() use the values cached
+      ///< by cVideoDiskUsage, so they can be called frequently without actually
+      ///< accessing the disk.
   static cString PrefixVideoFileName(const char *FileName, char Prefix);
   static void RemoveEmptyVideoDirectories(const char *IgnoreFiles[] = NULL);
+      ///< Removes the directories that have become empty because recordings
+      ///< have been removed from or moved out of them (through RemoveVideoFile(),
+      ///< RenameVideoFile() or MoveVideoFile()) since the last call to this
+      ///< function. Instead of walking the whole video directory, only these
+      ///< directories and their parents are checked (see CleanupDirectory()).
   static bool IsOnVideoDirectoryFileSystem(const char *FileName);
   };
 
 class cVideoDiskUsage {
+  friend class cVideoDirectory;
+  friend class cVideoDiskUsageThread;
 private:
+  static cMutex mutex;
   static int state;
-  static time_t lastChecked;
+  static bool synced;
   static int usedPercent;
   static int freeMB;
   static int freeMinutes;
+  static int availableMB; // as reported by cVideoDirectory::FreeMB()
+  static int usedMB;
+  static int deletedMB;
+  static double mbPerMinute;
+  static off_t written;
+  static int DiskSpace(int *FreeMB = NULL, int *UsedMB = NULL);
+  static void Calculate(void);
+  static void AssertSynced(void);
+  static void Sync(void);
+  static void Start(void);
+  static void Stop(void);
 public:
   static bool HasChanged(int &State);
     ///< Returns true if the usage of the video disk space has changed since the last
@@ -98,11 +129,22 @@ public:
     ///< initialize State to -1, and it will be set to the current internal state
     ///< value of the video disk usage checker upon return. Future calls with the same
     ///< State variable can then quickly check for changes.
-  static void ForceCheck(void) { lastChecked = 0; }
+  static void ForceCheck(void);
     ///< To avoid unnecessary load, the video disk usage is only actually checked
-    ///< every DISKSPACECHEK seconds. Calling ForceCheck() makes sure that the next call
-    ///< to HasChanged() will check the disk usage immediately. This is useful in case
-    ///< some files have been deleted and the result shall be displayed instantly.
+    ///< every DISKSPACESYNC seconds by a background thread. In between, it is updated
+    ///< with the amounts of data reported through Written() and Removed().
+    ///< Calling ForceCheck() makes the background thread check the disk usage
+    ///< immediately. This is useful in case some files have been deleted and the
+    ///< result shall be displayed as soon as possible.
+  static void Written(off_t Bytes);
+    ///< Tells the video disk usage checker that the given number of Bytes has been
+    ///< written to a recording in the video directory.
+  static void Removed(int MB);
+    ///< Tells the video disk usage checker that a "deleted" recording with the given
+    ///< size (in MB) has been removed from the video directory.
+  static int AvailableMB(void);
+    ///< Returns the amount of free space (in MB) in the video directory, not counting
+    ///< the space that would become available by removing "deleted" recordings.
   static cString String(void);
     ///< Returns a localized string of the form "Disk nn%  -  hh:mm free".
     ///< This function is mainly for use in skins that want to retain the display of the
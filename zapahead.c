@@ -0,0 +1,176 @@
+/*
+ * zapahead.c: Pre-tuning of neighbouring channels
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#include "zapahead.h"
+#include "channels.h"
+#include "config.h"
+#include "device.h"
+#include "eitscan.h"
+#include "positioner.h"
+#include "transfer.h"
+
+#define ZAPAHEADCACHETIMEOUT  60 // seconds after the last channel switch until GOP caches are given up
+
+// --- cZapAhead -------------------------------------------------------------
+
+cZapAhead ZapAhead;
+
+cZapAhead::cZapAhead(void)
+{
+  lastChannel = 0;
+  lastChange = 0;
+}
+
+static bool MayZapAhead(cDevice *Device, const cChannel *Channel)
+{
+  if (Device == cDevice::ActualDevice() || Device->Priority() > IDLEPRIORITY)
+     return false;
+  if (Device->CamSlot() || Device->HasCi())
+     return false; // we don't want to hold a CAM
+  if (Channel->Ca() && Channel->Ca() <= CA_DVB_MAX && Channel->Ca() != Device->DeviceNumber() + 1)
+     return false; // a specific card was requested, but not this one
+  if (!Device->ProvidesTransponder(Channel) || !Device->MaySwitchTransponder(Channel))
+     return false;
+  if (const cPositioner *Positioner = Device->Positioner()) {
+     if (Positioner->LastLongitude() != cSource::Position(Channel->Source()))
+        return false; // let's not move the dish just in case
+     }
+  return true;
+}
+
+void cZapAhead::DeleteGopCaches(const cVector<const cChannel *> *Keep)
+{
+  for (int i = 0; i < gopCaches.Size(); i++) {
+      cGopCache *GopCache = gopCaches[i];
+      bool Delete = !Keep || !GopCache->IsAttached(); // a detached cache's device has been taken for something else
+      if (!Delete) {
+         Delete = true;
+         for (int t = 0; t < Keep->Size(); t++) {
+             if (GopCache->ChannelID() == (*Keep)[t]->GetChannelID()) {
+                Delete = false;
+                break;
+                }
+             }
+         }
+      if (Delete) {
+         delete GopCache;
+         gopCaches.Remove(i--);
+         }
+      }
+}
+
+void cZapAhead::Process(void)
+{
+  if (!Setup.ZapAhead) {
+     DeleteGopCaches();
+     lastChannel = 0;
+     return;
+     }
+  int Current = cDevice::CurrentChannel();
+  if (Current == lastChannel) {
+     if (gopCaches.Size() && time(NULL) - lastChange > ZAPAHEADCACHETIMEOUT)
+        DeleteGopCaches(); // zapping has apparently ended, so let's free the devices for the EIT scanner
+     return;
+     }
+  if (EITScanner.Active())
+     return;
+  cDevice *PrimaryDevice = cDevice::PrimaryDevice();
+  if (PrimaryDevice->Replaying() && !PrimaryDevice->Transferring())
+     return; // not watching live
+  lastChannel = Current;
+  lastChange = time(NULL);
+  // Collect the neighbouring channels, the nearest ones first:
+  cVector<const cChannel *> Targets;
+  LOCK_CHANNELS_READ;
+  int Up = Current;
+  int Down = Current;
+  for (int i = 0; i < min(Setup.ZapAhead, MAXZAPAHEAD); i++) {
+      if (const cChannel *Channel = Channels->GetByNumber(Up + 1, 1)) {
+         Up = Channel->Number();
+         Targets.Append(Channel);
+         }
+      if (const cChannel *Channel = Channels->GetByNumber(Down - 1, -1)) {
+         Down = Channel->Number();
+         Targets.Append(Channel);
+         }
+      }
+  // Caches for channels that are no longer targets make their devices available again:
+  DeleteGopCaches(&Targets);
+  // Devices that are already tuned to one of the targets stay where they are:
+  cVector<const cDevice *> Used;
+  cVector<const cChannel *> Untuned;
+  for (int i = 0; i < Targets.Size(); i++) {
+      bool Tuned = false;
+      for (int d = 0; d < cDevice::NumDevices(); d++) {
+          const cDevice *Device = cDevice::GetDevice(d);
+          if (Device && Device->IsTunedToTransponder(Targets[i])) {
+             Used.Append(Device);
+             Tuned = true;
+             break;
+             }
+          }
+      if (!Tuned)
+         Untuned.Append(Targets[i]);
+      }
+  // Tune the remaining targets, as long as there are idle devices:
+  for (int i = 0; i < Untuned.Size(); i++) {
+      const cChannel *Channel = Untuned[i];
+      bool Tuned = false;
+      for (int d = 0; d < cDevice::NumDevices(); d++) {
+          const cDevice *Device = cDevice::GetDevice(d);
+          if (Device && Device->IsTunedToTransponder(Channel)) {
+             Tuned = true; // a previous target is on the same transponder
+             break;
+             }
+          }
+      if (Tuned)
+         continue;
+      for (int d = 0; d < cDevice::NumDevices(); d++) {
+          cDevice *Device = cDevice::GetDevice(d);
+          if (Device && Used.IndexOf(Device) < 0 && MayZapAhead(Device, Channel)) {
+             dsyslog("zap ahead: device %d tunes to channel %d (%s)", Device->DeviceNumber() + 1, Channel->Number(), Channel->Name());
+             Device->SwitchChannel(Channel, false);
+             Used.Append(Device);
+             break;
+             }
+          }
+      }
+  // Keep the current GOP of every (unencrypted) target with video:
+  for (int i = 0; i < Targets.Size(); i++) {
+      const cChannel *Channel = Targets[i];
+      if (!Channel->Vpid() || Channel->Ca() >= CA_ENCRYPTED_MIN)
+         continue;
+      bool Cached = false;
+      for (int c = 0; c < gopCaches.Size(); c++) {
+          if (gopCaches[c]->ChannelID() == Channel->GetChannelID()) {
+             Cached = true;
+             break;
+             }
+          }
+      if (Cached)
+         continue;
+      for (int d = 0; d < cDevice::NumDevices(); d++) {
+          cDevice *Device = cDevice::GetDevice(d);
+          if (Device && Used.IndexOf(Device) >= 0 && Device->IsTunedToTransponder(Channel) && !Device->CamSlot()) {
+             cGopCache *GopCache = new cGopCache(Channel);
+             if (Device->AttachReceiver(GopCache))
+                gopCaches.Append(GopCache);
+             else
+                delete GopCache;
+             break;
+             }
+          }
+      }
+}
+
+void cZapAhead::Shutdown(void)
+{
+  DeleteGopCaches();
+  lastChannel = 0;
+}
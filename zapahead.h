@@ -0,0 +1,49 @@
+/*
+ * zapahead.h: Pre-tuning of neighbouring channels
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * $Id$
+ */
+
+#ifndef __ZAPAHEAD_H
+#define __ZAPAHEAD_H
+
+#include <time.h>
+#include "tools.h"
+
+#define MAXZAPAHEAD  5 // maximum number of channels pre-tuned in each direction
+
+// cZapAhead tunes idle devices to the transponders of the channels next to
+// the one currently being watched, so that zapping up or down can use an
+// already locked device (with the PAT/PMT of its transponder already parsed)
+// in Transfer Mode, instead of having to wait for the tuner.
+// Only devices that are completely unused and have no CAM are used for this.
+// Since such devices have the lowest possible priority, they are taken away
+// from zap ahead by any timer or other request that needs a device.
+// For channels with video a cGopCache is attached, so that Transfer Mode
+// can start with the most recent independent frame.
+
+class cChannel;
+class cGopCache;
+
+class cZapAhead {
+private:
+  int lastChannel;
+  time_t lastChange;
+  cVector<cGopCache *> gopCaches;
+  void DeleteGopCaches(const cVector<const cChannel *> *Keep = NULL);
+public:
+  cZapAhead(void);
+  void Process(void);
+       ///< Checks whether the live channel has changed, and if so, tunes idle
+       ///< devices to the transponders of the Setup.ZapAhead channels above and
+       ///< below the current one. This is to be called from the main thread.
+  void Shutdown(void);
+       ///< Releases all devices used for zapping ahead.
+  };
+
+extern cZapAhead ZapAhead;
+
+#endif //__ZAPAHEAD_H